@@ -1,38 +1,117 @@
-// a sketch to generate a PWM square wave voltage (0V - 5V) from pin 9
+// a sketch to generate a PWM square wave voltage (0V - 5V) from pin 3
 // then read voltage from analog pin A0 from Macbook
 // this is just an example to test serial data input to the Mac
 // I will use this stream to test a ring buffer data structure
 // A0 reads input voltage (square wave)
+// A0..A(NUM_CHANNELS-1) are sampled together as one frame, FRAMES_PER_PACKET
+// frames are sent as one packet (see include/serial_protocol.h on the host):
+//   [sync 0xA55A][seq u16][channels u8][version u8][frames u16]
+//   [channels*frames x int16 ADC code][CRC-16/CCITT-FALSE of seq..codes]
+// all fields little endian (native on the AVR)
+// frames are sampled by the Timer1 compare interrupt at exactly SAMPLE_RATE_HZ
+// (crystal accuracy), so seq * FRAMES_PER_PACKET is the index of the first
+// sample of a packet; the host recovers the rate and fills gaps from it
+// (include/sample_clock.h)
 // Author: Catherine Bernaciak, PhD
 // Date: Mar 2025
 
-const int pwmPin = 9;         // PWM output pin, 490 Hz default
+const int pwmPin = 3;         // PWM output pin, Timer2, 490 Hz default (pin 9 would need Timer1)
 const int dutyCycle = 127;    // duty cycle of 50% (0->255)
-const int srcPin = A0; 
+#define NUM_CHANNELS 1        // must match the host's channel count (max 6 on an Uno)
+#define FRAMES_PER_PACKET 32  // packet size, must match the host
+#define SAMPLE_RATE_HZ 250    // must match the host's SAMPLE_RATE_HZ
+#define TIMER1_PRESCALE 64    // 16 MHz / 64 = 250 kHz timer clock
+const int srcPins[] = {A0, A1, A2, A3, A4, A5};
+
+#define PROTO_SYNC 0xA55A
+#define PROTO_VERSION 1
+#define HEADER_SIZE 8
+#define PACKET_SIZE (HEADER_SIZE + 2 * NUM_CHANNELS * FRAMES_PER_PACKET + 2)
+
+// two packets: the interrupt fills one while loop() sends the other
+byte packets[2][PACKET_SIZE];
+volatile byte ready = 0;      // bit i set: packets[i] is complete and not sent yet
+byte filling = 0;             // packet the interrupt is filling (interrupt only)
+int frame = 0;                // frames in the packet being filled (interrupt only)
+uint16_t seq = 0;             // packets sampled so far, sent or not (interrupt only)
+
+// CRC-16/CCITT-FALSE, same as serial_crc16() on the host
+uint16_t crc16(const byte *data, int len) {
+   uint16_t crc = 0xFFFF;
+   for (int i = 0; i < len; i++) {
+      crc ^= (uint16_t)data[i] << 8;
+      for (int bit = 0; bit < 8; bit++) {
+         crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+   }
+   return crc;
+}
+
+void put_u16(byte *b, uint16_t v) {
+   b[0] = v & 0xFF;
+   b[1] = v >> 8;
+}
 
 // this function executed only once when arduino starts or resets
 // must be here, even if empty
 void setup() {
 
    // start serial communication at 115200 baud rate
-   Serial.begin(115200); 
-   // configure pin 9 as output
-   pinMode(pwmPin, OUTPUT);    
-   // generate 50% duty cycle square wave from pin 9
-   analogWrite(pwmPin, dutyCycle); 
+   Serial.begin(115200);
+   // configure pin 3 as output
+   pinMode(pwmPin, OUTPUT);
+   // generate 50% duty cycle square wave from pin 3
+   analogWrite(pwmPin, dutyCycle);
+
+   // Timer1 in CTC mode: compare interrupt every 1/SAMPLE_RATE_HZ seconds
+   noInterrupts();
+   TCCR1A = 0;
+   TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10); // CTC on OCR1A, clock / 64
+   TCNT1 = 0;
+   OCR1A = F_CPU / TIMER1_PRESCALE / SAMPLE_RATE_HZ - 1;
+   TIMSK1 = _BV(OCIE1A);
+   interrupts();
 }
+
+// one frame per tick: the sample time is set by the timer, not by how long
+// loop() or the serial port take
+ISR(TIMER1_COMPA_vect) {
+   // read the ADC code from each channel, 10-bit (0..1023), ~112 us each
+   // the host converts codes to volts: code*(5.0/1023.0)
+   byte *packet = packets[filling];
+   byte *codes = packet + HEADER_SIZE + 2 * NUM_CHANNELS * frame;
+   for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+      put_u16(codes + 2 * ch, analogRead(srcPins[ch]));
+   }
+   if (++frame < FRAMES_PER_PACKET) return;
+   frame = 0;
+
+   // packet full: header now, the CRC is left to loop()
+   put_u16(packet, PROTO_SYNC);
+   put_u16(packet + 2, seq++);
+   packet[4] = NUM_CHANNELS;
+   packet[5] = PROTO_VERSION;
+   put_u16(packet + 6, FRAMES_PER_PACKET);
+   // the other packet still waiting for the serial port: this one is
+   // overwritten, and its sequence number never arrives (a gap on the host)
+   byte other = filling ^ 1;
+   if (ready & (1 << other)) return;
+   ready |= 1 << filling;
+   filling = other;
+}
+
 // every sketch must have loop() function
 // runs continuously after setup() has finished
 void loop() {
 
-   // read the voltage from A0
-   int sensorValue1 = analogRead(srcPin);
-   // convert the sensor reading to voltage value
-   // divide by 1023 bc arduino has 10-bit ADC (2^10 = 1024) starting at value 0
-   float voltage1 = sensorValue1*(5.0/1023.0);
-   // send voltage reading to the serial monitor
-   //Serial.println(voltage1); // sends as string terminated with \r\n
-   Serial.write((byte*)&voltage1, sizeof(voltage1));
-   delayMicroseconds(5);
-   Serial.flush();
+   for (byte i = 0; i < 2; i++) {
+      if (!(ready & (1 << i))) continue;
+      byte *packet = packets[i];
+      put_u16(packet + PACKET_SIZE - 2, crc16(packet + 2, PACKET_SIZE - 4));
+      Serial.write(packet, PACKET_SIZE); // queued, no flush per packet
+      noInterrupts();
+      ready &= ~(1 << i);
+      interrupts();
+   }
 }
+// TODO: notes for flashing arduino, hardware setup
@@ -0,0 +1,111 @@
+ /*
+ * @file arena.h
+ * @brief Startup-time arena: every buffer of the pipeline in one
+ * page-aligned region, laid out once, then sealed.
+ *
+ * The arena reserves a virtual region with mmap() and hands out pieces of
+ * it in allocation order (bump allocation), each one starting on its own
+ * cache line, so two stages' buffers never share a line and the layout is
+ * the same on every run. Nothing is freed piece by piece: the whole region
+ * is unmapped by arena_destroy().
+ *
+ * arena_seal() ends the startup phase: it touches every page in use so
+ * none faults later on a real-time thread, optionally mlock()s them so
+ * they are never paged out, and from then on arena_alloc() fails. Pages
+ * reserved but never allocated are never touched and cost no memory.
+ *
+ * The `*_init_arena()` functions of the ring buffers, DSP engines and
+ * pipeline stages place their storage in an arena; their `*_destroy()`
+ * functions then leave it to arena_destroy(). Passing a NULL arena to them
+ * (or to arena_alloc()/arena_free()) means the heap, which is what the
+ * plain `*_init()` functions do. Storage made by the OS frameworks on macOS
+ * (vDSP FFT and biquadm setups, mirrored mappings) stays outside.
+ *
+ * Usage:
+ * - `arena_init()` with an upper bound of what startup needs
+ * - `*_init_arena()` for every ring, engine and stage, or `arena_alloc()`
+ * - `arena_seal()` before the threads start
+ * - `arena_destroy()` after every user is destroyed
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "spsc_ring_buffer.h" // RB_CACHE_LINE_SIZE
+
+#define ARENA_ALIGN RB_CACHE_LINE_SIZE
+
+typedef struct {
+   uint8_t *base;           // page aligned
+   size_t reserved;         // bytes mapped, a page multiple
+   size_t used;             // bytes handed out, including alignment
+   size_t page_size;
+   bool sealed;             // arena_alloc() fails from now on
+   bool locked;             // pages in use are mlock()ed
+   uint64_t allocations;
+   uint64_t refused;        // allocations that did not fit or came after the seal
+} arena;
+
+/**
+ * @brief Reserve the region of an arena.
+ *
+ * @param a Pointer to the arena.
+ * @param reserve_bytes Upper bound of what will be allocated, rounded up to pages.
+ * @return true on success, false if the size is 0 or the mapping failed.
+ */
+bool arena_init(arena *a, size_t reserve_bytes);
+
+/**
+ * @brief Allocate zeroed, ARENA_ALIGN-aligned memory.
+ *
+ * @param a Pointer to the arena, NULL = heap (calloc()).
+ * @param bytes Number of bytes, > 0.
+ * @return the memory, NULL if it does not fit or the arena is sealed.
+ */
+void *arena_alloc(arena *a, size_t bytes);
+
+/**
+ * @brief Release memory from arena_alloc(): free() for the heap, nothing for
+ * an arena (its memory goes with arena_destroy()).
+ *
+ * @param a The arena passed to arena_alloc(), may be NULL.
+ * @param p The memory, may be NULL.
+ * @return void
+ */
+void arena_free(arena *a, void *p);
+
+/**
+ * @brief End the startup phase: prefault the pages in use and optionally
+ * lock them in memory. The arena is sealed even if locking is refused
+ * (RLIMIT_MEMLOCK); the pages are prefaulted either way.
+ *
+ * @param a Pointer to the arena.
+ * @param lock mlock() the pages in use.
+ * @return true on success, false if locking was asked for and refused.
+ */
+bool arena_seal(arena *a, bool lock);
+
+/**
+ * @brief Bytes handed out so far.
+ *
+ * @param a Pointer to the arena.
+ * @return bytes in use, including alignment padding.
+ */
+size_t arena_used(const arena *a);
+
+/**
+ * @brief Unlock and unmap the region.
+ *
+ * @param a Pointer to the arena.
+ * @return void
+ */
+void arena_destroy(arena *a);
+
+#endif
@@ -0,0 +1,154 @@
+ /*
+ * @file connectivity.h
+ * @brief Coherence and phase locking between electrode pairs, from the
+ * spectra the spectral engines already computed.
+ *
+ * Every hop, each channel's dsp_spectral engine leaves the FFT of its last
+ * window in its scratch (dsp_fft_power()). The connectivity engine reads
+ * those spectra, no FFT of its own, and accumulates per bin of its band:
+ *
+ *   Sxx[ch]     = <|X_ch|^2>                auto spectra
+ *   Sxy[pair]   = <X_a conj(X_b)>           cross spectra (complex)
+ *   Pxy[pair]   = <X_a conj(X_b) / |...|>   unit phasors of the cross spectra
+ *
+ * where <> is either the mean of the last `averages` windows (Welch,
+ * sliding: the oldest window's terms are subtracted from running sums) or
+ * an exponential average with weight alpha for the newest window. From
+ * those, for pair (a, b) and bin k:
+ *
+ *   coherence  |Sxy|^2 / (Sxx[a] Sxx[b])   in [0, 1], 1 = linearly related
+ *   PLV        |Pxy|                        in [0, 1], 1 = constant phase lag
+ *
+ * Cost is O(pairs * bins) per hop, only for the configured pairs and bin
+ * range: a 19-channel 10-20 montage has 171 pairs, 171 * 129 bins is about
+ * 22k complex multiply-adds per hop. Both measures are ratios, so the
+ * backend's FFT gain (DSP_FFT_GAIN) and the PSD scaling cancel out.
+ *
+ * Usage:
+ * - `conn_init()` with the montage's pairs (NULL = all of them) and bins
+ * - `conn_update()` after every multi-channel frame, on the thread that
+ *   runs the engines (e.g. after each dsp_spectral_bank_process() frame)
+ * - `conn_coherence()`, `conn_plv()` on the same thread
+ * - `conn_destroy()`
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dsp.h"
+
+typedef enum {
+   CONN_AVERAGE_WELCH = 0,        // mean of the last `averages` windows
+   CONN_AVERAGE_EXPONENTIAL       // weight alpha for the newest window
+} conn_average;
+
+typedef struct {
+   int a;
+   int b;
+} conn_pair;
+
+typedef struct {
+   int num_channels;
+   int num_pairs;
+   conn_pair *pairs;
+   int first_bin;           // analyzed bins [first_bin, first_bin + num_bins)
+   int num_bins;
+   int fft_bins;            // fft_size/2 + 1 of the engines
+   conn_average average;
+   int averages;            // Welch
+   float alpha;             // exponential
+   // one window's terms, then their averages, laid out as
+   // [auto: num_channels][cross re, cross im, phase re, phase im: num_pairs] x num_bins
+   int stride;              // floats per window
+   float *spectra;          // num_channels * 2 * num_bins, the band of each channel's window (re, im)
+   float *terms;
+   float *mean;             // exponential averages
+   double *sum;             // Welch running sums
+   float *history;          // Welch: averages * stride, the windows in the sums
+   int history_next;
+   int history_count;
+   uint64_t windows;        // windows accumulated since init or reset
+} conn_engine;
+
+/**
+ * @brief Initialize a connectivity engine.
+ *
+ * @param e Pointer to the engine.
+ * @param num_channels Channels of the engines it reads, >= 2.
+ * @param fft_size FFT size of those engines.
+ * @param pairs Channel pairs (a != b, both < num_channels), NULL = all
+ *        num_channels * (num_channels - 1) / 2 pairs.
+ * @param num_pairs Number of pairs (ignored if pairs is NULL).
+ * @param first_bin First bin analyzed.
+ * @param num_bins Bins analyzed, 0 = up to Nyquist.
+ * @param average Averaging mode.
+ * @param averages Welch: windows averaged, 1..DSP_MAX_AVERAGES.
+ * @param alpha Exponential: weight of the newest window, (0, 1].
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool conn_init(conn_engine *e, int num_channels, int fft_size, const conn_pair *pairs, int num_pairs,
+               int first_bin, int num_bins, conn_average average, int averages, float alpha);
+
+/**
+ * @brief Accumulate the latest window of every channel.
+ *
+ * @param e Pointer to the engine.
+ * @param engines num_channels spectral engines (e.g. a bank's), each right
+ *        after analyzing the same window position.
+ * @return void
+ */
+void conn_update(conn_engine *e, const dsp_spectral *engines);
+
+/**
+ * @brief Magnitude-squared coherence of one pair.
+ *
+ * @param e Pointer to the engine.
+ * @param pair Index into the engine's pairs.
+ * @param out num_bins values, out[k] for bin first_bin + k.
+ * @return true on success, false if no window was accumulated yet.
+ */
+bool conn_coherence(const conn_engine *e, int pair, float *out);
+
+/**
+ * @brief Phase-locking value of one pair.
+ *
+ * @param e Pointer to the engine.
+ * @param pair Index into the engine's pairs.
+ * @param out num_bins values, out[k] for bin first_bin + k.
+ * @return true on success, false if no window was accumulated yet.
+ */
+bool conn_plv(const conn_engine *e, int pair, float *out);
+
+/**
+ * @brief Index of the pair (a, b) or (b, a).
+ *
+ * @param e Pointer to the engine.
+ * @param a Channel.
+ * @param b Channel.
+ * @return the pair index, -1 if the engine does not compute it.
+ */
+int conn_pair_index(const conn_engine *e, int a, int b);
+
+/**
+ * @brief Forget all accumulated windows (e.g. after a gap in the input).
+ *
+ * @param e Pointer to the engine.
+ * @return void
+ */
+void conn_reset(conn_engine *e);
+
+/**
+ * @brief Free the engine's buffers.
+ *
+ * @param e Pointer to the engine.
+ * @return void
+ */
+void conn_destroy(conn_engine *e);
+
+#endif
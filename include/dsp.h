@@ -1 +1,759 @@
-// DSP function prototypes
+ /*
+ * @file dsp.h
+ * @brief Streaming spectral analysis (FFT, power spectral density).
+ *
+ * Spectral engine:
+ * - An FFT setup (vDSP_create_fftsetup() on macOS, twiddle and bit reversal
+ *   tables for the portable radix-2 FFT elsewhere) and a window table
+ *   (rectangular, Hann, Blackman) are built once per engine at init.
+ * - The engine consumes hop-sized chunks from an spsc_ring_buffer: it peeks
+ *   one FFT window in place, computes its periodogram and releases only hop
+ *   samples, so consecutive windows overlap by fft_size - hop (Welch).
+ * - Each output PSD frame is the mean of the last `averages` periodograms,
+ *   written into a buffer preallocated by the caller.
+ * - After init nothing is allocated and no setup is rebuilt. The `*_arena()`
+ *   variants of the init functions place the tables and scratch in an arena
+ *   (arena.h) instead of the heap.
+ *
+ * PSD frames are one-sided densities in V^2/Hz, fft_size/2 + 1 bins from DC
+ * to Nyquist, bin k at k * sample_rate / fft_size Hz.
+ *
+ * Usage:
+ * - `dsp_spectral_init()` once per size/window
+ * - `dsp_spectral_process()` from the consumer thread of the ring, or
+ *   `dsp_spectral_window()` with samples from elsewhere
+ * - `dsp_spectral_destroy()`
+ *
+ * Spectral bank (multi-channel montages):
+ * - One engine per channel in lockstep, one PSD frame of num_channels *
+ *   num_bins floats per hop (channel 0's bins first). The first engine owns
+ *   the FFT setup and the window, the others share them read-only
+ *   (dsp_spectral_init_shared()), so 64 channels build one setup, not 64.
+ * - With a work_pool, each hop is split into tasks of DSP_BANK_TASK_CHANNELS
+ *   channels (window, FFT, PSD and Welch average of each), run in parallel
+ *   and written straight into their slice of the output frame. Every task
+ *   touches only its own channels' scratch and history, nothing is shared
+ *   but the read-only tables.
+ *
+ * Band tracker (neurofeedback):
+ * - A sliding DFT over only the bins inside the configured bands (e.g.
+ *   delta/theta/alpha/beta), updated in O(bins) per sample, so band powers
+ *   follow the input with one sample of latency instead of one FFT hop.
+ * - `dsp_band_tracker_push()` runs on one thread; any number of threads call
+ *   `dsp_band_tracker_read()`, which never blocks the pushing thread
+ *   (sequence lock: readers retry, the writer never waits).
+ *
+ * Biquad cascade (preprocessing):
+ * - Second-order sections designed at init (RBJ cookbook): line-noise notch,
+ *   Butterworth high/low-pass for the EEG band.
+ * - Filters interleaved frames as stored in mc_ring_buffer, all channels of
+ *   a frame at once: vDSP_biquadm() on macOS, NEON lanes of 4 channels on
+ *   other arm64 targets, a scalar loop over channels (auto-vectorized)
+ *   elsewhere.
+ * - The filter state is one contiguous struct-of-arrays block, per section
+ *   z1[lanes] then z2[lanes]: 32 channels x 6 sections is 1.5 KB, in L1
+ *   (vDSP keeps the equivalent state inside its biquadm setup).
+ *
+ * Decimation chain (infra-low-frequency analysis):
+ * - Each stage is a linear-phase FIR low-pass followed by downsampling by its
+ *   factor, computed in polyphase form: only every factor-th output is
+ *   evaluated (vDSP_desamp() on macOS), taps/factor MACs per input sample.
+ * - Stages run in series (e.g. 2x, 2x, 2x = fs/2, fs/4, fs/8) and each one
+ *   writes its substream to its own spsc_ring_buffer, so a spectral engine
+ *   at the stage's rate can consume it on another thread. A 0.01 Hz bin at
+ *   250 Hz needs a 25000 point FFT; after 64x decimation it needs 391.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef DSP_H
+#define DSP_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "arena.h"
+#include "ring_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "work_pool.h"
+
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#define DSP_FFT_GAIN 2.0f        // vDSP_fft_zrip() returns 2 * X
+#else
+#define DSP_FFT_GAIN 1.0f
+#endif
+
+#define DSP_MIN_FFT_SIZE 8
+#define DSP_MAX_AVERAGES 64
+#define DSP_BANK_TASK_CHANNELS 4 // channels per parallel task of a spectral bank
+#define DSP_MAX_BANDS 8
+// pole radius of the sliding DFT resonators, < 1 so rounding errors decay
+#define DSP_SDFT_DAMPING 0.999999
+#define DSP_MAX_SECTIONS 16
+#define DSP_NOTCH_Q 30.0f        // -3 dB width = f0 / Q, 50 Hz -> 1.7 Hz
+#define DSP_MAX_DECIM_FACTOR 16
+#define DSP_MAX_DECIM_STAGES 8
+#define DSP_DECIM_TAPS_PER_FACTOR 16 // taps = 16 * factor + 1
+#define DSP_DECIM_BLOCK 1024     // input samples processed per step
+
+typedef enum {
+   DSP_WINDOW_RECT = 0,
+   DSP_WINDOW_HANN,
+   DSP_WINDOW_BLACKMAN
+} dsp_window_type;
+
+// FFT tables for one size, read-only after dsp_fft_setup_init()
+typedef struct {
+   int n;                   // real FFT size, power of two
+   int log2n;
+#if defined(__APPLE__)
+   FFTSetup vdsp;
+#else
+   // n/2-point complex FFT of the even/odd packed input
+   int *bitrev;             // n/2 entries
+   float *twiddle_re;       // n/4 entries, e^(-2 pi i k / (n/2))
+   float *twiddle_im;
+   float *split_re;         // n/2 entries, e^(-2 pi i k / n) for the real split
+   float *split_im;
+   arena *arena;            // storage of the tables, NULL = heap
+#endif
+} dsp_fft_setup;
+
+typedef struct {
+   dsp_fft_setup fft;
+   int fft_size;
+   int hop;
+   int num_bins;            // fft_size/2 + 1
+   float sample_rate;
+   dsp_window_type window_type;
+   float *window;           // fft_size coefficients
+   float psd_scale;         // 1 / (sample_rate * sum(window^2))
+   // scratch
+   float *frame;            // fft_size, windowed samples
+   float *re;               // fft_size/2, packed spectrum of the last window (dsp_fft_power())
+   float *im;               // fft_size/2
+   // Welch average over the last `averages` periodograms
+   int averages;
+   int history_next;        // slot for the next periodogram
+   int history_count;       // periodograms in history (<= averages)
+   float *history;          // averages * num_bins
+   bool shared_tables;      // fft and window belong to another engine
+   arena *arena;            // storage of the buffers, NULL = heap
+} dsp_spectral;
+
+typedef struct {
+   int num_channels;
+   int num_bins;
+   int fft_size;
+   int hop;
+   dsp_spectral *engines;   // engines[0] owns the tables
+   ring_buffer_span *spans; // 2 per channel, the window being analyzed
+   float *out;              // frame being written
+   work_pool *pool;         // NULL = all channels on the calling thread
+   arena *arena;            // storage of engines and spans, NULL = heap
+} dsp_spectral_bank;
+
+// normalized second-order section (a0 = 1):
+// y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+typedef struct {
+   float b0, b1, b2, a1, a2;
+} dsp_biquad;
+
+// cascade of biquads applied to every channel of interleaved frames
+typedef struct {
+   int num_channels;
+   int num_sections;
+   int lanes;               // num_channels rounded up to a multiple of 4
+   // coefficients, struct-of-arrays: b0[num_sections], b1[...], ..., a2[...]
+   float coeffs[5 * DSP_MAX_SECTIONS];
+   // transposed direct form II state: section s uses
+   // state[(2s) * lanes + ch] (z1) and state[(2s + 1) * lanes + ch] (z2),
+   // NULL on macOS where the vDSP setup holds the state
+   float *state;
+   arena *arena;            // storage of state and pointers, NULL = heap
+#if defined(__APPLE__)
+   vDSP_biquadm_Setup setup;
+   const float **in_ptrs;   // per channel pointers for vDSP_biquadm()
+   float **out_ptrs;
+#endif
+} dsp_biquad_cascade;
+
+// FIR low-pass + downsample by factor
+typedef struct {
+   int factor;
+   int taps;
+   float *coeffs;           // taps, symmetric (Blackman windowed sinc)
+   // delay line: taps - 1 samples of history followed by the current block
+   float *work;
+   int work_len;            // samples in work
+   int next;                // start in work of the next output's window
+   arena *arena;            // storage of coeffs and work, NULL = heap
+} dsp_decimator;
+
+typedef struct {
+   dsp_decimator dec;
+   float sample_rate;       // output rate of this stage
+   spsc_ring_buffer *ring;  // output substream (the chain is its producer)
+   float *out;              // DSP_DECIM_BLOCK scratch outputs
+   uint64_t dropped;        // samples the ring did not accept
+} dsp_decim_stage;
+
+typedef struct {
+   float sample_rate;       // input rate
+   int num_stages;
+   dsp_decim_stage stages[DSP_MAX_DECIM_STAGES];
+   arena *arena;            // storage of stage buffers and rings, NULL = heap
+} dsp_decim_chain;
+
+// frequency band [lo_hz, hi_hz): adjacent bands share no bin
+typedef struct {
+   float lo_hz;
+   float hi_hz;
+} dsp_band;
+
+// classic EEG bands: delta, theta, alpha, beta
+#define DSP_NUM_EEG_BANDS 4
+extern const dsp_band dsp_eeg_bands[DSP_NUM_EEG_BANDS];
+
+typedef struct {
+   int window;              // DFT length N in samples
+   float sample_rate;
+   int num_bands;
+   int band_first[DSP_MAX_BANDS]; // first tracked bin of each band
+   int band_bins[DSP_MAX_BANDS];  // number of tracked bins of each band
+   // one resonator per tracked bin (pusher thread only)
+   int num_bins;
+   double *coef_re;         // r * e^(2 pi i k / N)
+   double *coef_im;
+   double *state_re;        // X_k of the last N samples
+   double *state_im;
+   float *bin_scale;        // |X_k|^2 -> V^2: 2 / N^2, 1 / N^2 for DC and Nyquist
+   double damping_n;        // r^N, applied to the sample leaving the window
+   float *history;          // last N samples
+   int history_pos;
+   uint64_t samples;
+   // published band powers in V^2 (sequence lock, odd = write in progress)
+   atomic_uint seq;
+   _Atomic float power[DSP_MAX_BANDS];
+   _Atomic uint64_t power_samples;
+} dsp_band_tracker;
+
+/**
+ * @brief Build the FFT tables for a real FFT of size n.
+ *
+ * @param f Pointer to the setup.
+ * @param n FFT size, a power of two >= DSP_MIN_FFT_SIZE.
+ * @return true on success, false if n is invalid or allocation failed.
+ */
+bool dsp_fft_setup_init(dsp_fft_setup *f, int n);
+
+/**
+ * @brief Same as dsp_fft_setup_init(), the portable tables in an arena
+ * (the vDSP setup on macOS is made by the framework).
+ *
+ * @param f Pointer to the setup.
+ * @param n FFT size.
+ * @param a Arena for the tables, NULL = heap.
+ * @return true on success, false if n is invalid or allocation failed.
+ */
+bool dsp_fft_setup_init_arena(dsp_fft_setup *f, int n, arena *a);
+
+/**
+ * @brief Free the FFT tables.
+ *
+ * @param f Pointer to the setup.
+ * @return void
+ */
+void dsp_fft_setup_destroy(dsp_fft_setup *f);
+
+/**
+ * @brief Squared magnitude |X[k]|^2 of the DFT of n real samples, k = 0..n/2.
+ * re and im are left holding the spectrum, packed and scaled by
+ * DSP_FFT_GAIN: re[0] = X[0], im[0] = X[n/2] (both real), re[k] + i im[k]
+ * = X[k] for k = 1..n/2-1.
+ *
+ * @param f FFT setup for size n.
+ * @param in n real samples.
+ * @param re n/2 floats, real parts of the packed spectrum on return.
+ * @param im n/2 floats, imaginary parts of the packed spectrum on return.
+ * @param power Output, n/2 + 1 floats.
+ * @return void
+ */
+void dsp_fft_power(const dsp_fft_setup *f, const float *in, float *re, float *im, float *power);
+
+/**
+ * @brief Fill a window table.
+ *
+ * @param type Window shape.
+ * @param n Number of coefficients.
+ * @param out n coefficients (periodic form, suited to overlapping frames).
+ * @return void
+ */
+void dsp_window_fill(dsp_window_type type, int n, float *out);
+
+/**
+ * @brief Initialize a spectral engine.
+ *
+ * @param s Pointer to the engine.
+ * @param fft_size Window length, a power of two >= DSP_MIN_FFT_SIZE.
+ * @param hop Samples between window starts, 1..fft_size (fft_size/2 = 50% overlap).
+ * @param window Window shape.
+ * @param averages Periodograms averaged per output frame, 1..DSP_MAX_AVERAGES.
+ * @param sample_rate Sample rate in Hz.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_spectral_init(dsp_spectral *s, int fft_size, int hop, dsp_window_type window,
+                       int averages, float sample_rate);
+
+/**
+ * @brief Same as dsp_spectral_init(), the tables and scratch in an arena.
+ *
+ * @param s Pointer to the engine.
+ * @param fft_size Window length.
+ * @param hop Samples between window starts.
+ * @param window Window shape.
+ * @param averages Periodograms averaged per output frame.
+ * @param sample_rate Sample rate in Hz.
+ * @param a Arena for the buffers, NULL = heap.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_spectral_init_arena(dsp_spectral *s, int fft_size, int hop, dsp_window_type window,
+                             int averages, float sample_rate, arena *a);
+
+/**
+ * @brief Initialize an engine that shares the FFT setup and the window of
+ * another one. Only its scratch and Welch history are its own; it must be
+ * destroyed before the engine it shares with.
+ *
+ * @param s Pointer to the engine.
+ * @param tables Initialized engine whose size, hop, window and rate are used.
+ * @param averages Periodograms averaged per output frame, 1..DSP_MAX_AVERAGES.
+ * @return true on success, false if averages is invalid or allocation failed.
+ */
+bool dsp_spectral_init_shared(dsp_spectral *s, const dsp_spectral *tables, int averages);
+
+/**
+ * @brief Consume the ring buffer in hops and write PSD frames (consumer thread only).
+ *
+ * Stops when fewer than fft_size samples are buffered or max_frames frames
+ * are written. The ring must hold at least fft_size values.
+ *
+ * @param s Pointer to the engine.
+ * @param in Ring buffer the samples come from.
+ * @param psd_out max_frames * num_bins floats.
+ * @param max_frames Maximum number of PSD frames to write.
+ * @return number of PSD frames written.
+ */
+int dsp_spectral_process(dsp_spectral *s, spsc_ring_buffer *in, float *psd_out, int max_frames);
+
+/**
+ * @brief Analyze one window of fft_size samples given as up to two pieces
+ * (e.g. the two spans of a ring buffer peek) and write one PSD frame.
+ *
+ * @param s Pointer to the engine.
+ * @param a First a_len samples.
+ * @param a_len Length of a, 0..fft_size.
+ * @param b Remaining fft_size - a_len samples (unused if a_len == fft_size).
+ * @param psd_out num_bins floats.
+ * @return void
+ */
+void dsp_spectral_window(dsp_spectral *s, const float *a, int a_len, const float *b,
+                         float *psd_out);
+
+/**
+ * @brief Forget the Welch history (e.g. after a gap in the input).
+ *
+ * @param s Pointer to the engine.
+ * @return void
+ */
+void dsp_spectral_reset(dsp_spectral *s);
+
+/**
+ * @brief Frequency of a PSD bin in Hz.
+ *
+ * @param s Pointer to the engine.
+ * @param bin Bin index 0..num_bins-1.
+ * @return frequency in Hz.
+ */
+float dsp_spectral_bin_hz(const dsp_spectral *s, int bin);
+
+/**
+ * @brief Free the engine's tables and buffers.
+ *
+ * @param s Pointer to the engine.
+ * @return void
+ */
+void dsp_spectral_destroy(dsp_spectral *s);
+
+/**
+ * @brief Initialize a bank of num_channels engines sharing one FFT setup,
+ * see dsp_spectral_init() for the analysis parameters.
+ *
+ * @param b Pointer to the bank.
+ * @param num_channels Channels, >= 1.
+ * @param fft_size Window length.
+ * @param hop Samples between windows.
+ * @param window Window shape.
+ * @param averages Periodograms averaged per output frame.
+ * @param sample_rate Sample rate in Hz.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_spectral_bank_init(dsp_spectral_bank *b, int num_channels, int fft_size, int hop,
+                            dsp_window_type window, int averages, float sample_rate);
+
+/**
+ * @brief Same as dsp_spectral_bank_init(), every engine's buffers in an arena.
+ *
+ * @param b Pointer to the bank.
+ * @param num_channels Channels, >= 1.
+ * @param fft_size Window length.
+ * @param hop Samples between windows.
+ * @param window Window shape.
+ * @param averages Periodograms averaged per output frame.
+ * @param sample_rate Sample rate in Hz.
+ * @param a Arena for the buffers, NULL = heap.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_spectral_bank_init_arena(dsp_spectral_bank *b, int num_channels, int fft_size, int hop,
+                                  dsp_window_type window, int averages, float sample_rate, arena *a);
+
+/**
+ * @brief Run the channels of each hop on a pool's threads.
+ *
+ * @param b Pointer to the bank.
+ * @param pool Pool used by dsp_spectral_bank_process(), NULL = calling thread only.
+ * @return void
+ */
+void dsp_spectral_bank_set_pool(dsp_spectral_bank *b, work_pool *pool);
+
+/**
+ * @brief Consume one ring per channel in hops and write multi-channel PSD
+ * frames (consumer thread of the rings only). The rings are fed in
+ * lockstep: a frame is written when every channel holds fft_size samples.
+ *
+ * @param b Pointer to the bank.
+ * @param in num_channels rings, each holding at least fft_size values.
+ * @param psd_out max_frames * num_channels * num_bins floats,
+ *        psd_out[(frame * num_channels + ch) * num_bins + k].
+ * @param max_frames Maximum number of PSD frames to write.
+ * @return number of PSD frames written.
+ */
+int dsp_spectral_bank_process(dsp_spectral_bank *b, spsc_ring_buffer *const *in, float *psd_out,
+                              int max_frames);
+
+/**
+ * @brief Forget the Welch history of every channel.
+ *
+ * @param b Pointer to the bank.
+ * @return void
+ */
+void dsp_spectral_bank_reset(dsp_spectral_bank *b);
+
+/**
+ * @brief Free the engines and buffers (not the pool).
+ *
+ * @param b Pointer to the bank.
+ * @return void
+ */
+void dsp_spectral_bank_destroy(dsp_spectral_bank *b);
+
+/**
+ * @brief Design a notch (band-stop) section.
+ *
+ * @param out Designed section.
+ * @param sample_rate Sample rate in Hz.
+ * @param f0 Notch frequency in Hz, 0 < f0 < sample_rate/2.
+ * @param q Quality factor, f0 / -3 dB bandwidth.
+ * @return true on success, false if an argument is invalid.
+ */
+bool dsp_biquad_notch(dsp_biquad *out, float sample_rate, float f0, float q);
+
+/**
+ * @brief Design a low-pass section.
+ *
+ * @param out Designed section.
+ * @param sample_rate Sample rate in Hz.
+ * @param fc Cutoff in Hz, 0 < fc < sample_rate/2.
+ * @param q Quality factor (0.7071 = Butterworth second order).
+ * @return true on success, false if an argument is invalid.
+ */
+bool dsp_biquad_lowpass(dsp_biquad *out, float sample_rate, float fc, float q);
+
+/**
+ * @brief Design a high-pass section.
+ *
+ * @param out Designed section.
+ * @param sample_rate Sample rate in Hz.
+ * @param fc Cutoff in Hz, 0 < fc < sample_rate/2.
+ * @param q Quality factor (0.7071 = Butterworth second order).
+ * @return true on success, false if an argument is invalid.
+ */
+bool dsp_biquad_highpass(dsp_biquad *out, float sample_rate, float fc, float q);
+
+/**
+ * @brief Initialize a cascade with the given sections, state zeroed.
+ *
+ * @param c Pointer to the cascade.
+ * @param num_channels Channels per frame.
+ * @param sections Sections, applied in order.
+ * @param num_sections Number of sections, 1..DSP_MAX_SECTIONS.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_biquad_cascade_init(dsp_biquad_cascade *c, int num_channels, const dsp_biquad *sections,
+                             int num_sections);
+
+/**
+ * @brief Same as dsp_biquad_cascade_init(), the state in an arena (the
+ * biquadm setup on macOS is made by the framework).
+ *
+ * @param c Pointer to the cascade.
+ * @param num_channels Channels per frame.
+ * @param sections Sections, applied in order.
+ * @param num_sections Number of sections, 1..DSP_MAX_SECTIONS.
+ * @param a Arena for the state, NULL = heap.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_biquad_cascade_init_arena(dsp_biquad_cascade *c, int num_channels, const dsp_biquad *sections,
+                                   int num_sections, arena *a);
+
+/**
+ * @brief Initialize the EEG preprocessing cascade: notch at the line
+ * frequency (and its harmonics below 0.9 Nyquist), then 4th order
+ * Butterworth high-pass at lo_hz and low-pass at hi_hz.
+ *
+ * @param c Pointer to the cascade.
+ * @param num_channels Channels per frame.
+ * @param sample_rate Sample rate in Hz.
+ * @param line_hz Line frequency (50 or 60), 0 = no notch.
+ * @param lo_hz Pass band low edge in Hz.
+ * @param hi_hz Pass band high edge in Hz, below sample_rate/2.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_biquad_cascade_init_eeg(dsp_biquad_cascade *c, int num_channels, float sample_rate,
+                                 float line_hz, float lo_hz, float hi_hz);
+
+/**
+ * @brief Same as dsp_biquad_cascade_init_eeg(), the state in an arena.
+ *
+ * @param c Pointer to the cascade.
+ * @param num_channels Channels per frame.
+ * @param sample_rate Sample rate in Hz.
+ * @param line_hz Line frequency (50 or 60), 0 = no notch.
+ * @param lo_hz Pass band low edge in Hz.
+ * @param hi_hz Pass band high edge in Hz, below sample_rate/2.
+ * @param a Arena for the state, NULL = heap.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_biquad_cascade_init_eeg_arena(dsp_biquad_cascade *c, int num_channels, float sample_rate,
+                                       float line_hz, float lo_hz, float hi_hz, arena *a);
+
+/**
+ * @brief Filter interleaved frames (num_frames * num_channels floats).
+ *
+ * @param c Pointer to the cascade.
+ * @param in Input frames.
+ * @param out Output frames, may be the same as in.
+ * @param num_frames Number of frames.
+ * @return void
+ */
+void dsp_biquad_cascade_process(dsp_biquad_cascade *c, const float *in, float *out, int num_frames);
+
+/**
+ * @brief Zero the filter state (e.g. after a gap in the input).
+ *
+ * @param c Pointer to the cascade.
+ * @return void
+ */
+void dsp_biquad_cascade_reset(dsp_biquad_cascade *c);
+
+/**
+ * @brief Free the cascade's state.
+ *
+ * @param c Pointer to the cascade.
+ * @return void
+ */
+void dsp_biquad_cascade_destroy(dsp_biquad_cascade *c);
+
+/**
+ * @brief Initialize a decimator: FIR low-pass with its cutoff at 80% of the
+ * output Nyquist frequency, DSP_DECIM_TAPS_PER_FACTOR * factor + 1 taps,
+ * delay line zeroed.
+ *
+ * @param d Pointer to the decimator.
+ * @param factor Downsampling factor, 2..DSP_MAX_DECIM_FACTOR.
+ * @return true on success, false if factor is invalid or allocation failed.
+ */
+bool dsp_decimator_init(dsp_decimator *d, int factor);
+
+/**
+ * @brief dsp_decimator_init() with the coefficients and delay line in an arena.
+ *
+ * @param d Pointer to the decimator.
+ * @param factor Downsampling factor, 2..DSP_MAX_DECIM_FACTOR.
+ * @param a Arena, NULL for the heap.
+ * @return true on success, false if factor is invalid or the arena is full.
+ */
+bool dsp_decimator_init_arena(dsp_decimator *d, int factor, arena *a);
+
+/**
+ * @brief Filter and downsample a block of samples.
+ *
+ * The first output corresponds to the first input ever pushed; output m is
+ * the filtered input m * factor, delayed by (taps - 1) / 2 input samples.
+ * After N inputs in total, ceil(N / factor) outputs have been produced.
+ *
+ * @param d Pointer to the decimator.
+ * @param in Input samples.
+ * @param n Number of input samples, at most DSP_DECIM_BLOCK.
+ * @param out Output, at least n / factor + 1 floats.
+ * @return number of outputs written.
+ */
+int dsp_decimator_process(dsp_decimator *d, const float *in, int n, float *out);
+
+/**
+ * @brief Zero the delay line.
+ *
+ * @param d Pointer to the decimator.
+ * @return void
+ */
+void dsp_decimator_reset(dsp_decimator *d);
+
+/**
+ * @brief Free the decimator's buffers.
+ *
+ * @param d Pointer to the decimator.
+ * @return void
+ */
+void dsp_decimator_destroy(dsp_decimator *d);
+
+/**
+ * @brief Initialize a chain of decimation stages in series, each with its
+ * own output ring buffer.
+ *
+ * @param c Pointer to the chain.
+ * @param sample_rate Input rate in Hz.
+ * @param factors Factor of each stage relative to the previous one.
+ * @param num_stages Number of stages, 1..DSP_MAX_DECIM_STAGES.
+ * @param ring_capacity Capacity of each output ring in samples.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool dsp_decim_chain_init(dsp_decim_chain *c, float sample_rate, const int *factors,
+                          int num_stages, int ring_capacity);
+
+/**
+ * @brief dsp_decim_chain_init() with every stage's buffers and output ring
+ * in an arena.
+ *
+ * @param c Pointer to the chain.
+ * @param sample_rate Input rate in Hz.
+ * @param factors Factor of each stage relative to the previous one.
+ * @param num_stages Number of stages, 1..DSP_MAX_DECIM_STAGES.
+ * @param ring_capacity Capacity of each output ring in samples.
+ * @param a Arena, NULL for the heap.
+ * @return true on success, false if an argument is invalid or the arena is full.
+ */
+bool dsp_decim_chain_init_arena(dsp_decim_chain *c, float sample_rate, const int *factors,
+                                int num_stages, int ring_capacity, arena *a);
+
+/**
+ * @brief Push input samples through all stages (producer of every stage ring).
+ *
+ * @param c Pointer to the chain.
+ * @param x Input samples.
+ * @param n Number of samples.
+ * @return void
+ */
+void dsp_decim_chain_push(dsp_decim_chain *c, const float *x, int n);
+
+/**
+ * @brief Output ring of a stage, consumed e.g. by dsp_spectral_process().
+ *
+ * @param c Pointer to the chain.
+ * @param stage Stage index.
+ * @return the stage's ring.
+ */
+spsc_ring_buffer *dsp_decim_chain_ring(dsp_decim_chain *c, int stage);
+
+/**
+ * @brief Sample rate of a stage's output.
+ *
+ * @param c Pointer to the chain.
+ * @param stage Stage index.
+ * @return rate in Hz.
+ */
+float dsp_decim_chain_rate(const dsp_decim_chain *c, int stage);
+
+/**
+ * @brief Free all stages and their rings.
+ *
+ * @param c Pointer to the chain.
+ * @return void
+ */
+void dsp_decim_chain_destroy(dsp_decim_chain *c);
+
+/**
+ * @brief Initialize a band tracker.
+ *
+ * Bin k (k * sample_rate / window Hz) belongs to a band when it lies within
+ * [lo_hz, hi_hz); bands may overlap.
+ *
+ * @param t Pointer to the tracker.
+ * @param window DFT length in samples; frequency resolution is sample_rate / window.
+ * @param sample_rate Sample rate in Hz.
+ * @param bands Bands to track.
+ * @param num_bands Number of bands, 1..DSP_MAX_BANDS.
+ * @return true on success, false if an argument is invalid, a band holds no
+ * bin, or allocation failed.
+ */
+bool dsp_band_tracker_init(dsp_band_tracker *t, int window, float sample_rate,
+                           const dsp_band *bands, int num_bands);
+
+/**
+ * @brief Feed samples and publish the band powers of the last window samples
+ * (pusher thread only, O(tracked bins) per sample, never blocks).
+ *
+ * @param t Pointer to the tracker.
+ * @param x Samples.
+ * @param n Number of samples.
+ * @return void
+ */
+void dsp_band_tracker_push(dsp_band_tracker *t, const float *x, int n);
+
+/**
+ * @brief Read a consistent snapshot of the published band powers (any thread).
+ *
+ * @param t Pointer to the tracker.
+ * @param power_out num_bands floats, mean square in V^2 of each band.
+ * @param samples_out Samples pushed when the snapshot was published, may be NULL.
+ * @return number of bands written.
+ */
+int dsp_band_tracker_read(const dsp_band_tracker *t, float *power_out, uint64_t *samples_out);
+
+/**
+ * @brief Free the tracker's buffers.
+ *
+ * @param t Pointer to the tracker.
+ * @return void
+ */
+void dsp_band_tracker_destroy(dsp_band_tracker *t);
+
+/**
+ * @brief Band powers from PSD frames, for every channel: the densities of
+ * the bins within [lo_hz, hi_hz) times the bin width.
+ *
+ * @param psd num_channels * num_bins densities in V^2/Hz, channel 0's bins first.
+ * @param num_channels Channels in the frame.
+ * @param num_bins Bins per channel, DC first.
+ * @param bin_hz Bin width in Hz.
+ * @param bands Bands to integrate.
+ * @param num_bands Number of bands.
+ * @param power_out num_channels * num_bands powers in V^2, channel 0's bands first.
+ * @return void
+ */
+void dsp_psd_band_powers(const float *psd, int num_channels, int num_bins, float bin_hz,
+                         const dsp_band *bands, int num_bands, float *power_out);
+
+#endif
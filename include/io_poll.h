@@ -0,0 +1,98 @@
+ /*
+ * @file io_poll.h
+ * @brief Readiness notification for a small set of file descriptors.
+ *
+ * The serial reader sleeps here until a device has data, instead of
+ * blocking in read() for a few bytes at a time. Several descriptors can be
+ * watched by one thread (e.g. several acquisition boards).
+ *
+ * Platform notes:
+ * - macOS: kqueue with EVFILT_READ. poll() does not work on tty devices on
+ *   macOS. NOTE_LOWAT sets how many bytes must be buffered before a wakeup.
+ * - Elsewhere: poll(). The low-water mark is not supported by poll(); for a
+ *   tty, VMIN (with VTIME = 0) has the same effect.
+ *
+ * Usage:
+ * - `io_poller_init()`, then `io_poller_add()` for every descriptor
+ * - `io_poller_wait()` returns the user data of the ready descriptors
+ * - `io_poller_remove()` a descriptor that hung up, it would be ready forever
+ * - `io_poller_close()` when done
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef IO_POLL_H
+#define IO_POLL_H
+
+#include <stdbool.h>
+
+#if !defined(__APPLE__)
+#include <poll.h>
+#endif
+
+#define IO_POLLER_MAX_FDS 16
+
+typedef struct {
+#if defined(__APPLE__)
+   int kq;
+   int watched[IO_POLLER_MAX_FDS];
+#else
+   struct pollfd fds[IO_POLLER_MAX_FDS];
+#endif
+   void *udata[IO_POLLER_MAX_FDS];
+   int num_fds;
+} io_poller;
+
+/**
+ * @brief Initialize an empty poller.
+ *
+ * @param p Pointer to the poller.
+ * @return true on success, false if the kernel queue could not be created.
+ */
+bool io_poller_init(io_poller *p);
+
+/**
+ * @brief Watch a descriptor for input.
+ *
+ * A descriptor that hangs up or fails is also reported as ready, the
+ * following read() returns 0 or -1.
+ *
+ * @param p Pointer to the poller.
+ * @param fd Descriptor to watch.
+ * @param low_water Bytes wanted before a wakeup (kqueue only), <= 1 for any data.
+ * @param udata Returned by io_poller_wait() when fd is ready.
+ * @return true on success, false if full or the kernel refused.
+ */
+bool io_poller_add(io_poller *p, int fd, int low_water, void *udata);
+
+/**
+ * @brief Stop watching a descriptor.
+ *
+ * @param p Pointer to the poller.
+ * @param fd Descriptor passed to io_poller_add().
+ * @return true on success, false if fd is not watched.
+ */
+bool io_poller_remove(io_poller *p, int fd);
+
+/**
+ * @brief Wait until at least one descriptor is ready or the timeout expires.
+ *
+ * @param p Pointer to the poller.
+ * @param timeout_ms Longest wait, < 0 waits forever.
+ * @param ready Filled in with the udata of up to max_ready ready descriptors.
+ * @param max_ready Size of ready.
+ * @return number of ready descriptors, 0 on timeout, -1 on error.
+ */
+int io_poller_wait(io_poller *p, int timeout_ms, void **ready, int max_ready);
+
+/**
+ * @brief Release the poller (the watched descriptors stay open).
+ *
+ * @param p Pointer to the poller.
+ * @return void
+ */
+void io_poller_close(io_poller *p);
+
+#endif
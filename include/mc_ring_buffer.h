@@ -0,0 +1,275 @@
+ /*
+ * @file mc_ring_buffer.h
+ * @brief Multi-channel ring buffer of fixed-width sample frames.
+ *
+ * This header provides a ring buffer for full electrode montages (e.g. the
+ * 19 channels of the 10-20 system). Each entry is one frame: one float per
+ * channel, taken at the same sample time, stored interleaved
+ * (frame 0 ch 0, frame 0 ch 1, ..., frame 1 ch 0, ...).
+ *
+ * Design:
+ * - Built on spsc_ring_buffer, so one producer and one consumer thread can
+ *   share it without locks. A whole block of frames is published with one
+ *   atomic store, instead of one atomic per channel with separate buffers.
+ * - Frames are never split: every write/read/reserve/peek moves whole frames.
+ * - Consumers get per-channel (planar) views without copying: a channel of a
+ *   peeked window is a strided span (ptr, stride = num_channels, len), which
+ *   vDSP routines take directly. mc_ring_buffer_read_planar() copies the
+ *   channels out into separate contiguous arrays when that is needed.
+ * - Raw acquisition rings can hold int16 ADC codes instead of floats
+ *   (mc_ring_buffer_init_i16()): half the memory and memory traffic on the
+ *   ingest edge, converted to floats only when the consumer reads frames.
+ *
+ * Usage:
+ * - Initialize using `mc_ring_buffer_init()`, or `mc_ring_buffer_init_arena()`
+ *   to place the ring and its storage in an arena
+ * - Producer: `mc_ring_buffer_write_frames()` or reserve/commit
+ *   (`mc_ring_buffer_write_codes()` for an int16 ring)
+ * - Consumer: `mc_ring_buffer_read_frames()`, `mc_ring_buffer_read_planar()`,
+ *   or `mc_ring_buffer_peek()` + `mc_ring_buffer_channel()` + `mc_ring_buffer_release()`
+ *   (`mc_ring_buffer_read_codes()` for an int16 ring's codes as they are)
+ * - Free memory with `mc_ring_buffer_destroy()` (the struct too) or
+ *   `mc_ring_buffer_deinit()` for an embedded struct
+ *
+ * Application:
+ * - Real-time multi-channel EEG data buffering between the serial reader and DSP
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef MC_RING_BUFFER_H
+#define MC_RING_BUFFER_H
+
+#include <stdbool.h>
+#include "ring_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "arena.h"
+
+// What the ring stores per channel and frame.
+typedef enum {
+   MC_SAMPLE_F32 = 0,      // float32_t values
+   MC_SAMPLE_I16           // int16_t codes (raw ADC samples), floats = code * scale on read
+} mc_sample_type;
+
+typedef struct {
+   spsc_ring_buffer *ring; // stores max_num_frames * num_channels values
+   int num_channels;
+   int max_num_frames;
+   mc_sample_type sample_type;
+   float scale;            // MC_SAMPLE_I16: float value of one code
+   arena *arena;           // holds ring and its storage, NULL = heap
+} mc_ring_buffer;
+
+// A contiguous run of interleaved frames in the buffer storage.
+typedef struct {
+   float32_t *frames;
+   int num_frames;
+} mc_frame_span;
+
+// A window of frames, split in two where it wraps around the storage.
+typedef struct {
+   mc_frame_span spans[2];
+   int num_channels;
+} mc_ring_buffer_view;
+
+// One channel of a frame span: ptr[0], ptr[stride], ..., ptr[(len-1)*stride]
+typedef struct {
+   float32_t *ptr;
+   int stride;
+   int len;
+} mc_channel_span;
+
+/**
+ * @brief Initialize a multi-channel ring buffer.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_channels Number of channels per frame.
+ * @param capacity Maximum number of frames to store.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool mc_ring_buffer_init(mc_ring_buffer *rb, int num_channels, int capacity);
+
+/**
+ * @brief Initialize a multi-channel ring buffer whose spsc ring and storage
+ * are allocated from an arena (cache line aligned, nothing on the heap).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_channels Number of channels per frame.
+ * @param capacity Maximum number of frames to store.
+ * @param a Arena, NULL = same as mc_ring_buffer_init().
+ * @return true on success, false if an argument is invalid or the arena is full.
+ */
+bool mc_ring_buffer_init_arena(mc_ring_buffer *rb, int num_channels, int capacity, arena *a);
+
+/**
+ * @brief Initialize a multi-channel ring buffer of int16 codes.
+ *
+ * The producer writes codes (mc_ring_buffer_write_codes()), the consumer
+ * reads floats: mc_ring_buffer_read_frames() and mc_ring_buffer_read_planar()
+ * convert code * scale as they copy out. The in-place views (reserve, peek)
+ * and mc_ring_buffer_write_frames() are for float rings only.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_channels Number of channels per frame.
+ * @param capacity Maximum number of frames to store.
+ * @param scale Float value of one code (e.g. volts per ADC step).
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool mc_ring_buffer_init_i16(mc_ring_buffer *rb, int num_channels, int capacity, float scale);
+
+/**
+ * @brief Same as mc_ring_buffer_init_i16(), the ring and its storage in an arena.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_channels Number of channels per frame.
+ * @param capacity Maximum number of frames to store.
+ * @param scale Float value of one code.
+ * @param a Arena, NULL = heap.
+ * @return true on success, false if an argument is invalid or the arena is full.
+ */
+bool mc_ring_buffer_init_i16_arena(mc_ring_buffer *rb, int num_channels, int capacity, float scale,
+                                   arena *a);
+
+/**
+ * @brief Set the overflow policy, see spsc_ring_buffer_set_overflow_policy().
+ *
+ * Drop counters count values, divide by num_channels for frames.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param policy The overflow policy.
+ * @param timeout_us Longest wait for RB_OVERFLOW_BLOCK, < 0 waits forever.
+ * @return true on success, false if the policy is unknown.
+ */
+bool mc_ring_buffer_set_overflow_policy(mc_ring_buffer *rb,
+                                        ring_buffer_overflow_policy policy,
+                                        int timeout_us);
+
+/**
+ * @brief Write interleaved frames (producer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param frames num_frames * num_channels interleaved values.
+ * @param num_frames Number of frames to write.
+ * @return number of frames written.
+ */
+int mc_ring_buffer_write_frames(mc_ring_buffer *rb, const float32_t *frames, int num_frames);
+
+/**
+ * @brief Write interleaved frames of int16 codes (producer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance, from mc_ring_buffer_init_i16().
+ * @param codes num_frames * num_channels interleaved codes.
+ * @param num_frames Number of frames to write.
+ * @return number of frames written, 0 for a float ring.
+ */
+int mc_ring_buffer_write_codes(mc_ring_buffer *rb, const int16_t *codes, int num_frames);
+
+/**
+ * @brief Read interleaved frames (consumer thread only), an int16 ring's
+ * codes converted to code * scale.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param frames Storage for num_frames * num_channels values.
+ * @param num_frames Maximum number of frames to read.
+ * @return number of frames read.
+ */
+int mc_ring_buffer_read_frames(mc_ring_buffer *rb, float32_t *frames, int num_frames);
+
+/**
+ * @brief Read interleaved frames of an int16 ring as they are, without
+ * converting (consumer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance, from mc_ring_buffer_init_i16().
+ * @param codes Storage for num_frames * num_channels codes.
+ * @param num_frames Maximum number of frames to read.
+ * @return number of frames read, 0 for a float ring.
+ */
+int mc_ring_buffer_read_codes(mc_ring_buffer *rb, int16_t *codes, int num_frames);
+
+/**
+ * @brief Read frames and split them into one contiguous array per channel
+ * (consumer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param channels num_channels pointers, each to storage for num_frames values.
+ * @param num_frames Maximum number of frames to read.
+ * @return number of frames read.
+ */
+int mc_ring_buffer_read_planar(mc_ring_buffer *rb, float32_t **channels, int num_frames);
+
+/**
+ * @brief Reserve space for up to num_frames frames to be written in place
+ * (producer thread only), see spsc_ring_buffer_reserve().
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_frames Maximum number of frames to reserve.
+ * @param view Filled in with up to two runs of free frames.
+ * @return number of frames reserved, 0 for an int16 ring.
+ */
+int mc_ring_buffer_reserve(mc_ring_buffer *rb, int num_frames, mc_ring_buffer_view *view);
+
+/**
+ * @brief Publish frames written into reserved space (producer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_frames Number of frames written.
+ * @return true on success, false if more than the free space.
+ */
+bool mc_ring_buffer_commit(mc_ring_buffer *rb, int num_frames);
+
+/**
+ * @brief Look at up to num_frames of the oldest frames in place (consumer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_frames Maximum number of frames wanted.
+ * @param view Filled in with up to two runs of frames.
+ * @return number of frames available in the view, 0 for an int16 ring.
+ */
+int mc_ring_buffer_peek(mc_ring_buffer *rb, int num_frames, mc_ring_buffer_view *view);
+
+/**
+ * @brief Hand peeked frames back to the producer (consumer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param num_frames Number of frames consumed.
+ * @return true on success, see spsc_ring_buffer_release().
+ */
+bool mc_ring_buffer_release(mc_ring_buffer *rb, int num_frames);
+
+/**
+ * @brief Planar view of one channel in one span of a view.
+ *
+ * @param view View from mc_ring_buffer_peek() or mc_ring_buffer_reserve().
+ * @param span Index of the span, 0 or 1.
+ * @param channel Channel index.
+ * @return strided span of that channel's samples.
+ */
+mc_channel_span mc_ring_buffer_channel(const mc_ring_buffer_view *view, int span, int channel);
+
+/**
+ * @brief Number of frames currently stored (snapshot).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return number of stored frames.
+ */
+int mc_ring_buffer_num_frames(mc_ring_buffer *rb);
+
+/**
+ * @brief Free the ring, not the struct itself.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return void
+ */
+void mc_ring_buffer_deinit(mc_ring_buffer *rb);
+
+/**
+ * @brief Free the allocated memory, including the struct itself.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return void
+ */
+void mc_ring_buffer_destroy(mc_ring_buffer *rb);
+
+#endif
@@ -0,0 +1,218 @@
+ /*
+ * @file metrics.h
+ * @brief Built-in counters, ring high-water marks and latency histograms,
+ * compiled in with EEG_METRICS (`make METRICS=1`) and out otherwise.
+ *
+ * Every instrumented thread owns one metrics_slot: a cache-line-aligned
+ * block of counters and a latency histogram that only it stores to, with
+ * a relaxed load and store (no locked read-modify-write, no line shared
+ * with another writer). The first METRICS_ADD() of a thread claims a slot
+ * for it; METRICS_THREAD() claims one under a name first, pipeline stages
+ * do that with their stage name.
+ *
+ * Counted where it happens:
+ * - ring_buffer and spsc_ring_buffer: values in and out, values dropped by
+ *   the overflow policy, and each ring's occupancy high-water mark (a field
+ *   of the ring, stored by its producer)
+ * - serial_reader: read() calls and bytes, io_poller waits (kevent/poll)
+ * - pipeline stages: time spent in every step that did work, and
+ *   serial_reader's drains, in power-of-two tick buckets. Ticks are
+ *   mach_absolute_time() on macOS (no conversion on the hot path, the
+ *   timebase is applied on export) and CLOCK_MONOTONIC ns elsewhere.
+ *
+ * metrics_export() writes one JSON line per slot and per watched ring, with
+ * counters as rates over the time since the previous export and latency
+ * percentiles of that interval (upper bounds of their buckets):
+ *
+ *   {"t_s":2.001,"thread":"ingest","samples_in_per_s":2000.0,...,
+ *    "latency_count":250,"latency_p50_us":64.0,"latency_p99_us":256.0,...}
+ *   {"t_s":2.001,"ring":"raw","capacity":32768,"high_water":96}
+ *
+ * Without EEG_METRICS the macros expand to nothing and neither the slots
+ * nor the ring fields exist.
+ *
+ * Usage:
+ * - `METRICS_THREAD("name")` at the start of a thread (optional)
+ * - `METRICS_ADD()`, `METRICS_HIGH_WATER()`, `METRICS_TIMER_START()` /
+ *   `METRICS_TIMER_STOP()` on the instrumented paths
+ * - `METRICS_WATCH_RING()` for every ring to report
+ * - `METRICS_EXPORT_START()` / `METRICS_EXPORT_STOP()` run the exporter thread
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef METRICS_H
+#define METRICS_H
+
+#ifdef EEG_METRICS
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "spsc_ring_buffer.h" // RB_CACHE_LINE_SIZE
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#define METRICS_MAX_SLOTS 32         // threads, later ones share an unreported slot
+#define METRICS_MAX_RINGS 16
+#define METRICS_NAME_LEN 16
+#define METRICS_LATENCY_BUCKETS 40   // bucket i: below 2^i ticks
+
+typedef enum {
+   METRIC_SAMPLES_IN = 0,     // values written into ring buffers
+   METRIC_SAMPLES_OUT,        // values read or released from ring buffers
+   METRIC_DROPS,              // values rejected or overwritten by the overflow policy
+   METRIC_READ_CALLS,         // read() on the serial port
+   METRIC_BYTES_READ,
+   METRIC_WAIT_CALLS,         // kevent()/poll() in io_poller_wait()
+   METRIC_NUM_COUNTERS
+} metrics_counter;
+
+typedef uint64_t metrics_ticks;
+
+// one thread's counters, stored only by that thread
+typedef struct {
+   _Alignas(RB_CACHE_LINE_SIZE) char name[METRICS_NAME_LEN];
+   _Atomic uint64_t counters[METRIC_NUM_COUNTERS];
+   _Atomic uint64_t latency[METRICS_LATENCY_BUCKETS];
+   _Atomic uint64_t latency_count;
+   _Atomic uint64_t latency_max; // ticks, since the start
+} metrics_slot;
+
+// slot of the calling thread, NULL until its first metric
+extern _Thread_local metrics_slot *metrics_current;
+
+/**
+ * @brief Claim a slot for the calling thread.
+ *
+ * @param name Reported name, e.g. the pipeline stage.
+ * @return the slot (a shared, unreported one after METRICS_MAX_SLOTS).
+ */
+metrics_slot *metrics_thread(const char *name);
+
+/**
+ * @brief Report a ring's high-water mark in every export. Call before the
+ * exporter starts.
+ *
+ * @param name Reported name.
+ * @param high_water The ring's high_water field.
+ * @param capacity The ring's capacity in values.
+ * @return true on success, false if METRICS_MAX_RINGS are watched.
+ */
+bool metrics_watch_ring(const char *name, const atomic_uint *high_water, unsigned int capacity);
+
+/**
+ * @brief The slot claimed under a name, for tests and tools.
+ *
+ * @param name Slot name.
+ * @return the first slot with that name, NULL if there is none.
+ */
+const metrics_slot *metrics_find(const char *name);
+
+/**
+ * @brief Write one JSON line per slot and watched ring. Not reentrant: one
+ * thread exports (the exporter thread when it runs).
+ *
+ * @param out Output stream.
+ * @return void
+ */
+void metrics_export(FILE *out);
+
+/**
+ * @brief Start a thread calling metrics_export() every interval_ms.
+ *
+ * @param out Output stream, e.g. a .jsonl file.
+ * @param interval_ms Export period.
+ * @return true on success, false if it runs already or cannot start.
+ */
+bool metrics_export_start(FILE *out, int interval_ms);
+
+/**
+ * @brief Stop the exporter thread after a last export.
+ *
+ * @return void
+ */
+void metrics_export_stop(void);
+
+/**
+ * @brief Latency bucket upper bound in microseconds.
+ *
+ * @param bucket Bucket index.
+ * @return 2^bucket ticks in microseconds.
+ */
+double metrics_bucket_us(int bucket);
+
+static inline metrics_slot *metrics_self(void){
+   metrics_slot *slot = metrics_current;
+   return slot ? slot : metrics_thread("thread");
+}
+
+static inline void metrics_add(metrics_counter counter, uint64_t n){
+   _Atomic uint64_t *c = &metrics_self()->counters[counter];
+   atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// single writer: the ring's producer
+static inline void metrics_high_water(atomic_uint *high_water, unsigned int level){
+   if(level > atomic_load_explicit(high_water, memory_order_relaxed)){
+      atomic_store_explicit(high_water, level, memory_order_relaxed);
+   }
+}
+
+static inline metrics_ticks metrics_now(void){
+#if defined(__APPLE__)
+   return mach_absolute_time();
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void metrics_latency(metrics_ticks ticks){
+   metrics_slot *slot = metrics_self();
+   int bucket = ticks ? 64 - __builtin_clzll(ticks) : 0; // smallest i with ticks < 2^i
+   if(bucket >= METRICS_LATENCY_BUCKETS) bucket = METRICS_LATENCY_BUCKETS - 1;
+   _Atomic uint64_t *b = &slot->latency[bucket];
+   atomic_store_explicit(b, atomic_load_explicit(b, memory_order_relaxed) + 1, memory_order_relaxed);
+   atomic_store_explicit(&slot->latency_count,
+                         atomic_load_explicit(&slot->latency_count, memory_order_relaxed) + 1,
+                         memory_order_relaxed);
+   if(ticks > atomic_load_explicit(&slot->latency_max, memory_order_relaxed)){
+      atomic_store_explicit(&slot->latency_max, ticks, memory_order_relaxed);
+   }
+}
+
+#define METRICS_THREAD(name) ((void)metrics_thread(name))
+#define METRICS_ADD(counter, n) metrics_add((counter), (uint64_t)(n))
+#define METRICS_HIGH_WATER_INIT(hw) atomic_init((hw), 0)
+#define METRICS_HIGH_WATER(hw, level) metrics_high_water((hw), (unsigned int)(level))
+#define METRICS_TIMER_START(t) metrics_ticks t = metrics_now()
+#define METRICS_TIMER_STOP(t) metrics_latency(metrics_now() - (t))
+#define METRICS_WATCH_RING(name, hw, capacity) ((void)metrics_watch_ring((name), (hw), (unsigned int)(capacity)))
+#define METRICS_EXPORT_START(out, interval_ms) ((void)metrics_export_start((out), (interval_ms)))
+#define METRICS_EXPORT_STOP() metrics_export_stop()
+
+#else // metrics compiled out, arguments are not evaluated
+
+#define METRICS_THREAD(name) ((void)0)
+#define METRICS_ADD(counter, n) ((void)0)
+#define METRICS_HIGH_WATER_INIT(hw) ((void)0)
+#define METRICS_HIGH_WATER(hw, level) ((void)0)
+#define METRICS_TIMER_START(t) ((void)0)
+#define METRICS_TIMER_STOP(t) ((void)0)
+#define METRICS_WATCH_RING(name, hw, capacity) ((void)0)
+#define METRICS_EXPORT_START(out, interval_ms) ((void)0)
+#define METRICS_EXPORT_STOP() ((void)0)
+
+#endif
+
+#endif
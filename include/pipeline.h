@@ -0,0 +1,304 @@
+ /*
+ * @file pipeline.h
+ * @brief Multi-stage runtime: one thread per stage, ring buffers in between.
+ *
+ * A pipeline is a linear chain of stages (e.g. serial ingest -> filter ->
+ * spectral -> output). Each stage runs on its own thread with its own QoS
+ * class and passes data downstream through an mc_ring_buffer; the overflow
+ * policy of each ring is the backpressure policy of that edge:
+ *
+ *   ingest -> filter    RB_OVERFLOW_OVERWRITE  ingestion never waits, the
+ *                                              oldest frames are dropped
+ *   filter -> spectral  RB_OVERFLOW_BLOCK      the filter waits (bounded)
+ *   spectral -> output  RB_OVERFLOW_REJECT     a slow consumer loses frames
+ *
+ * Latency: next to each data ring, a stage publishes timestamps into a
+ * stamp queue (single producer / single consumer, like the rings). A stamp
+ * says "the output up to frame F contains data ingested at time T". The
+ * next stage pops the stamps of the input it has consumed and forwards the
+ * ingest time with its own output, so every stage measures the latency
+ * from ingestion to its own output.
+ *
+ * Tracing: with a trace callback (`pipeline_stage_set_trace()`) a stage
+ * also reports every stamped batch it passes on: when the upstream stage
+ * wrote the data, when this stage read it and when it wrote its output,
+ * so the time in the ring and the stage's own work can be told apart
+ * (tests/bench_latency.c). Without one no extra clock is read.
+ *
+ * Stages are either
+ * - step stages: `step()` is called in a loop and returns the number of
+ *   frames it consumed; 0 means idle and the thread sleeps idle_us, or
+ * - run stages: `run()` owns the thread (e.g. serial_reader()) and returns
+ *   once the stage's stop flag (`pipeline_stage_stop_flag()`) is set.
+ *
+ * Scheduling: besides its QoS class, a stage can take a real-time policy
+ * and a CPU mask (rt_sched.h, `pipeline_stage_set_sched()`), applied by
+ * the stage thread itself. Every
+ * stage keeps a histogram of its scheduling latency: step stages measure
+ * how much later than idle_us they wake up from their idle sleep, run
+ * stages report the lateness of their own timed waits through
+ * `pipeline_stage_wakeup()`. `pipeline_report_jitter()` prints the
+ * distributions.
+ *
+ * Stages stop in data flow order: a stage is told to stop only after its
+ * upstream thread has exited, then it drains what is left in its input.
+ *
+ * Usage:
+ * - `pipeline_init()`, `pipeline_add_stage()` in data flow order
+ * - `pipeline_start()`, then `pipeline_report()` periodically and
+ *   `pipeline_report_jitter()` now and then
+ * - `pipeline_stop()` stops and joins the stage threads, first to last
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "rt_sched.h"
+#include "spsc_ring_buffer.h" // RB_CACHE_LINE_SIZE
+
+#define PIPELINE_MAX_STAGES 8
+#define PIPELINE_NAME_LEN 16
+#define PIPELINE_STAMP_QUEUE_SIZE 1024 // power of two
+#define PIPELINE_IDLE_US 500          // default sleep of an idle step stage
+
+// maps to QoS classes on macOS: the scheduler keeps interactive and
+// user-initiated work on P-cores, utility and background go to E-cores
+typedef enum {
+   PIPELINE_QOS_DEFAULT = 0,     // inherit
+   PIPELINE_QOS_USER_INTERACTIVE,
+   PIPELINE_QOS_USER_INITIATED,
+   PIPELINE_QOS_UTILITY,
+   PIPELINE_QOS_BACKGROUND
+} pipeline_qos;
+
+typedef struct {
+   uint64_t frame;        // output frames written so far, including this batch
+   uint64_t ingest_ns;    // ingest time of the newest data in the batch
+   uint64_t ready_ns;     // time the batch was written to the ring
+} pipeline_stamp;
+
+// one stamped batch passed on by a stage, see pipeline_stage_set_trace()
+typedef struct {
+   uint64_t frame;        // output frames written so far, including this batch
+   uint64_t ingest_ns;    // ingest time of the newest data in the batch
+   uint64_t ready_ns;     // upstream wrote that data to this stage's input ring
+   uint64_t consumed_ns;  // this stage read it (ingest: = ingest_ns)
+   uint64_t produced_ns;  // this stage wrote its output (ingest: = ingest_ns)
+} pipeline_trace;
+
+// called on the stage thread, must be short
+typedef void (*pipeline_trace_fn)(const pipeline_trace *trace, void *ctx);
+
+// stamp queue of one edge (producer: upstream stage, consumer: downstream stage)
+typedef struct {
+   atomic_uint head;
+   char pad_head[RB_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+   atomic_uint tail;
+   char pad_tail[RB_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+   pipeline_stamp items[PIPELINE_STAMP_QUEUE_SIZE];
+} pipeline_stamp_queue;
+
+// counters written by the stage thread, read by pipeline_report()
+typedef struct {
+   _Atomic uint64_t frames_in;
+   _Atomic uint64_t frames_out;
+   _Atomic uint64_t dropped;         // output frames the downstream ring did not take
+   _Atomic uint64_t latency_count;
+   _Atomic uint64_t latency_sum_ns;
+   _Atomic uint64_t latency_max_ns;  // since the last report
+} pipeline_stats;
+
+typedef struct pipeline_stage pipeline_stage;
+
+// returns the number of frames consumed, 0 when there was nothing to do
+typedef int (*pipeline_step_fn)(pipeline_stage *stage, void *ctx);
+
+typedef struct {
+   const char *name;
+   pipeline_qos qos;
+   int idle_us;             // 0 = PIPELINE_IDLE_US
+   pipeline_step_fn step;   // either step ...
+   void *(*run)(void *ctx); // ... or run
+   void *ctx;
+} pipeline_stage_config;
+
+struct pipeline_stage {
+   char name[PIPELINE_NAME_LEN];
+   pipeline_qos qos;
+   int idle_us;
+   pipeline_step_fn step;
+   void *(*run)(void *ctx);
+   void *ctx;
+   rt_sched_policy sched;           // zero = QoS class only
+   atomic_bool sched_ok;            // false if the thread's policy was refused
+   atomic_bool stop;
+   pipeline_stamp_queue *in_stamps;  // previous stage's output stamps, NULL for the first
+   pipeline_stamp_queue out_stamps;
+   // owned by the stage thread
+   uint64_t out_frames;
+   uint64_t pending_ns;             // ingest time of consumed input not yet passed on
+   uint64_t pending_ready_ns;       // ... when it was written to the input ring
+   uint64_t pending_consumed_ns;    // ... when it was read, traced stages only
+   bool have_pending;
+   pipeline_trace_fn trace;         // NULL = no tracing
+   void *trace_ctx;
+   pipeline_stats stats;
+   rt_jitter jitter;                // scheduling latency, since the start
+   // owned by pipeline_report()
+   uint64_t reported_in, reported_out, reported_dropped;
+   uint64_t reported_latency_count, reported_latency_sum_ns;
+   pthread_t thread;
+   bool started;
+};
+
+typedef struct {
+   pipeline_stage stages[PIPELINE_MAX_STAGES];
+   int num_stages;
+   bool running;
+   uint64_t report_ns;      // time of the last report
+} pipeline;
+
+/**
+ * @brief Initialize an empty pipeline.
+ *
+ * @param p Pointer to the pipeline.
+ * @return void
+ */
+void pipeline_init(pipeline *p);
+
+/**
+ * @brief Append a stage; its input is the output of the previous stage.
+ *
+ * @param p Pointer to the pipeline (not running).
+ * @param config name, QoS, and either step or run.
+ * @return the stage, or NULL if the pipeline is full or the config invalid.
+ */
+pipeline_stage *pipeline_add_stage(pipeline *p, const pipeline_stage_config *config);
+
+/**
+ * @brief Start one thread per stage, last stage first so consumers are up
+ * before data arrives.
+ *
+ * @param p Pointer to the pipeline.
+ * @return true on success, false if a thread could not be created (the
+ * started ones are stopped again).
+ */
+bool pipeline_start(pipeline *p);
+
+/**
+ * @brief Stop and join the stage threads in data flow order; each stage
+ * drains its input after its upstream stage has exited.
+ *
+ * @param p Pointer to the pipeline.
+ * @return void
+ */
+void pipeline_stop(pipeline *p);
+
+/**
+ * @brief Set the scheduling policy of a stage, applied when its thread
+ * starts. Call before pipeline_start().
+ *
+ * @param stage The stage.
+ * @param policy Real-time policy and CPU mask, see rt_sched.h.
+ * @return void
+ */
+void pipeline_stage_set_sched(pipeline_stage *stage, const rt_sched_policy *policy);
+
+/**
+ * @brief Report every stamped batch the stage passes on to a callback,
+ * on the stage thread. Call before pipeline_start().
+ *
+ * @param stage The stage.
+ * @param fn Callback, NULL = none.
+ * @param ctx Passed to fn.
+ * @return void
+ */
+void pipeline_stage_set_trace(pipeline_stage *stage, pipeline_trace_fn fn, void *ctx);
+
+/**
+ * @brief Stop flag of a stage, for run stages.
+ *
+ * @param stage The stage.
+ * @return the flag, set by pipeline_stop().
+ */
+const atomic_bool *pipeline_stage_stop_flag(pipeline_stage *stage);
+
+/**
+ * @brief Monotonic clock used for stamps and wakeups.
+ *
+ * @return nanoseconds since an arbitrary start.
+ */
+uint64_t pipeline_now_ns(void);
+
+/**
+ * @brief Record the scheduling latency of a run stage that was due to wake
+ * up at expected_ns (e.g. the end of a wait that timed out).
+ *
+ * @param stage The calling stage.
+ * @param expected_ns pipeline_now_ns() time the thread should have run.
+ * @return void
+ */
+void pipeline_stage_wakeup(pipeline_stage *stage, uint64_t expected_ns);
+
+/**
+ * @brief Record frames entering the pipeline now (first stage only).
+ *
+ * @param stage The ingest stage.
+ * @param frames Frames written to the stage's output ring.
+ * @param dropped Frames the ring did not take.
+ * @return void
+ */
+void pipeline_stage_ingested(pipeline_stage *stage, int frames, int dropped);
+
+/**
+ * @brief Record input consumed up to an absolute input frame position
+ * (frames read plus frames the input ring dropped by overwriting).
+ *
+ * @param stage The calling stage.
+ * @param frames Frames consumed by this call.
+ * @param position Input frames consumed or dropped so far.
+ * @return void
+ */
+void pipeline_stage_consumed(pipeline_stage *stage, int frames, uint64_t position);
+
+/**
+ * @brief Record output frames written downstream; measures the latency of
+ * the consumed input and passes its ingest time on.
+ *
+ * @param stage The calling stage.
+ * @param frames Frames written to the output ring (0 = output still pending).
+ * @param dropped Frames the output ring did not take.
+ * @return void
+ */
+void pipeline_stage_produced(pipeline_stage *stage, int frames, int dropped);
+
+/**
+ * @brief Print one line per stage with rates, drops and latency since the
+ * last report. Call from a non real-time thread.
+ *
+ * @param p Pointer to the pipeline.
+ * @param out Output stream.
+ * @return void
+ */
+void pipeline_report(pipeline *p, FILE *out);
+
+/**
+ * @brief Print one line per stage with its scheduling policy and the
+ * percentiles of its scheduling latency since the start.
+ *
+ * @param p Pointer to the pipeline.
+ * @param out Output stream.
+ * @return void
+ */
+void pipeline_report_jitter(pipeline *p, FILE *out);
+
+#endif
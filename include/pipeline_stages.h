@@ -0,0 +1,264 @@
+ /*
+ * @file pipeline_stages.h
+ * @brief Step stages of the EEG pipeline: filter, spectral, output.
+ *
+ * Each stage reads from an input mc_ring_buffer on its own thread (see
+ * pipeline.h) and writes to an output ring:
+ *
+ * - filter_stage: biquad cascade (notch + band-pass) over interleaved frames,
+ *   frames in, frames out.
+ * - spectral_stage: a dsp_spectral_bank, one engine per channel; every hop
+ *   it writes one PSD frame of num_channels * num_bins floats (channel 0's
+ *   bins first) to an output ring whose "channels" are those floats. With a
+ *   work_pool attached large montages analyze their channels in parallel,
+ *   with a viz_state it also publishes the samples and PSD frames to the
+ *   renderer.
+ * - output_stage: hands each PSD frame to a callback (visualization,
+ *   feedback) on its own thread. With stream sinks attached it also
+ *   publishes the frame and its EEG band powers to other processes.
+ *   The filter stage can publish the raw frames the same way.
+ *
+ * The stages allocate everything in init (on the heap, or in an arena with
+ * the `*_init_arena()` variants) and report consumption, output and drops
+ * to the pipeline for rates and latency.
+ *
+ * Usage:
+ * - `*_stage_init()` with the rings of the edges around the stage
+ * - `pipeline_add_stage()` with `*_stage_step` and the stage as ctx
+ * - `*_stage_destroy()` after `pipeline_stop()`
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef PIPELINE_STAGES_H
+#define PIPELINE_STAGES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dsp.h"
+#include "mc_ring_buffer.h"
+#include "pipeline.h"
+#include "stream_sink.h"
+#include "visualization.h"
+
+#define PIPELINE_CHUNK_FRAMES 256 // frames a stage reads per step
+
+typedef struct {
+   mc_ring_buffer *in;
+   mc_ring_buffer *out;
+   dsp_biquad_cascade cascade;
+   float *frames;           // PIPELINE_CHUNK_FRAMES frames
+   const stream_sinks *raw_sinks; // raw frames published here, NULL = none
+   uint64_t consumed;       // frames read from in
+   arena *arena;            // storage of the buffers, NULL = heap
+} filter_stage;
+
+typedef struct {
+   mc_ring_buffer *in;
+   mc_ring_buffer *out;     // num_channels * num_bins floats per frame
+   int num_channels;
+   int num_bins;
+   dsp_spectral_bank bank;  // one engine per channel
+   spsc_ring_buffer **windows; // per channel samples not yet analyzed
+   float **planar;          // per channel PIPELINE_CHUNK_FRAMES scratch
+   float *psd;              // one output frame
+   viz_state *viz;          // NULL = no visualization
+   uint64_t consumed;
+   arena *arena;            // storage of the buffers, NULL = heap
+} spectral_stage;
+
+// called on the output thread with one PSD frame, psd[ch * num_bins + k]
+typedef void (*output_stage_fn)(const float *psd, int num_channels, int num_bins, void *ctx);
+
+typedef struct {
+   mc_ring_buffer *in;
+   int num_channels;
+   int num_bins;
+   float *psd;              // one input frame
+   float *band_power;       // num_channels * DSP_NUM_EEG_BANDS
+   const stream_sinks *sinks; // band powers and PSD frames published here, NULL = none
+   float bin_hz;
+   output_stage_fn fn;
+   void *fn_ctx;
+   uint64_t consumed;
+   arena *arena;            // storage of the buffers, NULL = heap
+} output_stage;
+
+/**
+ * @brief Initialize a filter stage with the EEG preprocessing cascade.
+ *
+ * @param f Pointer to the stage.
+ * @param in Input frames.
+ * @param out Output frames, same number of channels.
+ * @param sample_rate Sample rate in Hz.
+ * @param line_hz Line frequency to notch out, 0 = none.
+ * @param lo_hz Pass band low edge in Hz.
+ * @param hi_hz Pass band high edge in Hz.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool filter_stage_init(filter_stage *f, mc_ring_buffer *in, mc_ring_buffer *out,
+                       float sample_rate, float line_hz, float lo_hz, float hi_hz);
+
+/**
+ * @brief Same as filter_stage_init(), every buffer in an arena.
+ *
+ * @param f Pointer to the stage.
+ * @param in Input frames.
+ * @param out Output frames, same number of channels.
+ * @param sample_rate Sample rate in Hz.
+ * @param line_hz Line frequency to notch out, 0 = none.
+ * @param lo_hz Pass band low edge in Hz.
+ * @param hi_hz Pass band high edge in Hz.
+ * @param a Arena for the buffers, NULL = heap.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool filter_stage_init_arena(filter_stage *f, mc_ring_buffer *in, mc_ring_buffer *out,
+                             float sample_rate, float line_hz, float lo_hz, float hi_hz, arena *a);
+
+/**
+ * @brief pipeline_step_fn of the filter stage, ctx is the filter_stage.
+ */
+int filter_stage_step(pipeline_stage *stage, void *ctx);
+
+/**
+ * @brief Publish every chunk of raw frames (before filtering) to a set of
+ * sinks, from the filter thread. Call before the pipeline starts.
+ *
+ * @param f Pointer to the stage.
+ * @param raw Sinks of the filter thread, NULL = none.
+ * @return void
+ */
+void filter_stage_set_sinks(filter_stage *f, const stream_sinks *raw);
+
+/**
+ * @brief Free the filter stage.
+ *
+ * @param f Pointer to the stage.
+ * @return void
+ */
+void filter_stage_destroy(filter_stage *f);
+
+/**
+ * @brief Initialize a spectral stage, see dsp_spectral_init() for the
+ * analysis parameters.
+ *
+ * @param s Pointer to the stage.
+ * @param in Input frames.
+ * @param out PSD frames, in->num_channels * (fft_size/2 + 1) channels.
+ * @param fft_size Window length.
+ * @param hop Samples between windows.
+ * @param window Window shape.
+ * @param averages Periodograms averaged per PSD frame.
+ * @param sample_rate Sample rate in Hz.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool spectral_stage_init(spectral_stage *s, mc_ring_buffer *in, mc_ring_buffer *out,
+                         int fft_size, int hop, dsp_window_type window, int averages,
+                         float sample_rate);
+
+/**
+ * @brief Same as spectral_stage_init(), every buffer (engines, per-channel
+ * rings, scratch) in an arena.
+ *
+ * @param s Pointer to the stage.
+ * @param in Input frames.
+ * @param out PSD frames, in->num_channels * (fft_size/2 + 1) channels.
+ * @param fft_size Window length.
+ * @param hop Samples between windows.
+ * @param window Window shape.
+ * @param averages Periodograms averaged per PSD frame.
+ * @param sample_rate Sample rate in Hz.
+ * @param a Arena for the buffers, NULL = heap.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool spectral_stage_init_arena(spectral_stage *s, mc_ring_buffer *in, mc_ring_buffer *out,
+                               int fft_size, int hop, dsp_window_type window, int averages,
+                               float sample_rate, arena *a);
+
+/**
+ * @brief pipeline_step_fn of the spectral stage, ctx is the spectral_stage.
+ */
+int spectral_stage_step(pipeline_stage *stage, void *ctx);
+
+/**
+ * @brief Publish the stage's input samples and PSD frames to a renderer,
+ * one snapshot per step. Call before the pipeline starts.
+ *
+ * @param s Pointer to the stage.
+ * @param viz State with the stage's num_channels and num_bins, NULL = none.
+ * @return true on success, false if the layouts differ.
+ */
+bool spectral_stage_set_viz(spectral_stage *s, viz_state *viz);
+
+/**
+ * @brief Analyze the channels of each hop on a pool's threads. Call before
+ * the pipeline starts; the pool must outlive the stage's thread.
+ *
+ * @param s Pointer to the stage.
+ * @param pool Worker pool, NULL = the stage thread only.
+ * @return void
+ */
+void spectral_stage_set_pool(spectral_stage *s, work_pool *pool);
+
+/**
+ * @brief Free the spectral stage.
+ *
+ * @param s Pointer to the stage.
+ * @return void
+ */
+void spectral_stage_destroy(spectral_stage *s);
+
+/**
+ * @brief Initialize an output stage.
+ *
+ * @param o Pointer to the stage.
+ * @param in PSD frames of num_channels * num_bins floats.
+ * @param num_channels Channels per PSD frame.
+ * @param fn Callback for every PSD frame.
+ * @param fn_ctx Passed to fn.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool output_stage_init(output_stage *o, mc_ring_buffer *in, int num_channels,
+                       output_stage_fn fn, void *fn_ctx);
+
+/**
+ * @brief Same as output_stage_init(), the frame buffer in an arena.
+ *
+ * @param o Pointer to the stage.
+ * @param in PSD frames of num_channels * num_bins floats.
+ * @param num_channels Channels per PSD frame.
+ * @param fn Callback for every PSD frame.
+ * @param fn_ctx Passed to fn.
+ * @param a Arena for the buffer, NULL = heap.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool output_stage_init_arena(output_stage *o, mc_ring_buffer *in, int num_channels,
+                             output_stage_fn fn, void *fn_ctx, arena *a);
+
+/**
+ * @brief pipeline_step_fn of the output stage, ctx is the output_stage.
+ */
+int output_stage_step(pipeline_stage *stage, void *ctx);
+
+/**
+ * @brief Publish every PSD frame and its band powers (dsp_eeg_bands) to a
+ * set of sinks, from the output thread. Call before the pipeline starts.
+ *
+ * @param o Pointer to the stage.
+ * @param sinks Sinks of the output thread, NULL = none.
+ * @param bin_hz Width of a PSD bin in Hz.
+ * @return void
+ */
+void output_stage_set_sinks(output_stage *o, const stream_sinks *sinks, float bin_hz);
+
+/**
+ * @brief Free the output stage.
+ *
+ * @param o Pointer to the stage.
+ * @return void
+ */
+void output_stage_destroy(output_stage *o);
+
+#endif
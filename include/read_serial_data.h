@@ -1 +1,125 @@
-// maybe use this if serial reader functions need sharing. 
+// maybe use this if serial reader functions need sharing.
+
+// include guard
+#ifndef READ_SERIAL_DATA_H
+#define READ_SERIAL_DATA_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "mc_ring_buffer.h"
+#include "pipeline.h"
+#include "recording.h"
+#include "sample_clock.h"
+#include "serial_protocol.h"
+#include "telemetry.h"
+
+// latency/throughput knobs of the serial port, applied by setup_serial()
+// and by serial_reader()
+typedef struct {
+   // bytes the driver buffers before the reader wakes up (termios VMIN, and
+   // the kqueue low-water mark on macOS). 1 = lowest latency, one packet =
+   // one wakeup per packet, larger = fewer wakeups
+   int vmin;
+   // longest wait for more bytes in 0.1 s units (termios VTIME); the reader
+   // also drains after this long without a wakeup. 0 = 100 ms idle wait
+   int vtime;
+} serial_tuning;
+
+// arguments for the serial reader thread
+typedef struct {
+   int fd;               // open, configured serial port
+   int num_channels;     // channels per frame, must match the firmware's NUM_CHANNELS
+   int frames_per_packet; // frames per packet, must match the firmware's FRAMES_PER_PACKET:
+                          // packets with another count are logged and dropped
+   mc_ring_buffer *ring; // frames are written here (reader is the only producer): the
+                         // ADC codes for an int16 ring (scale SERIAL_VOLTS_PER_CODE), volts otherwise
+   serial_tuning tuning;
+   const atomic_bool *stop; // reader returns soon after *stop is set, NULL = never
+   telemetry_channel *telemetry; // sample statistics and errors, NULL = none
+   pipeline_stage *stage;   // ingest stage: rates, ingest timestamps, wakeup jitter, NULL = none
+   recorder *recorder;      // every packet's frames are also recorded, NULL = none
+   sample_clock *clock;     // gap fill and sample rate recovery, NULL = none (gaps stay gaps)
+   // filled in by the reader, final once the thread has exited
+   uint64_t frames_read;
+   uint64_t frames_filled;  // interpolated over sequence gaps, not counted in frames_read
+   uint64_t packets_lost;
+   uint64_t crc_errors;
+} serial_reader_args;
+
+/**
+ * @brief Serial reader thread: waits for input with kqueue/poll, drains all
+ * buffered bytes with large reads, parses packets (see serial_protocol.h),
+ * and writes the frames to the ring, as ADC codes or converted to volts.
+ * With a sample clock, short sequence gaps are filled with interpolated
+ * frames (not recorded) and the board's sample rate is estimated from one
+ * timestamp per read(). Nothing is printed on this thread, see telemetry.h.
+ *
+ * Returns when *stop is set, or when the device hangs up or fails.
+ *
+ * @param arg Pointer to a serial_reader_args.
+ * @return NULL
+ */
+void *serial_reader(void *arg);
+
+#define SERIAL_MAX_DEVICES 8          // boards one multi-device reader can merge
+#define SERIAL_ALIGN_SLIP_FRAMES 0.75 // boards further apart than this (in frames) are realigned
+
+// one board of a multi-device reader
+typedef struct {
+   int fd;               // open, configured serial port
+   int num_channels;     // channels per frame of this board
+   int frames_per_packet; // frames per packet of this board, others are dropped
+   // filled in by the reader, final once the thread has exited
+   sample_clock clock;   // the board's sequence tracking and rate fit
+   uint64_t frames_read;
+   uint64_t packets_lost;
+   uint64_t crc_errors;
+} serial_device;
+
+// arguments for the multi-device reader thread
+typedef struct {
+   serial_device devices[SERIAL_MAX_DEVICES];
+   int num_devices;
+   double sample_rate;   // nominal rate, the same firmware on every board
+   int max_fill_frames;  // longest gap filled per board, see sample_clock_init()
+   int queue_frames;     // frames a board can get ahead of the slowest one
+   mc_ring_buffer *ring; // aligned frames, device 0's channels first: the sum of
+                         // the boards' channels, codes or volts as for serial_reader
+   serial_tuning tuning;
+   const atomic_bool *stop; // reader returns soon after *stop is set, NULL = never
+   telemetry_channel *telemetry; // all boards' statistics and errors, NULL = none
+   pipeline_stage *stage;   // ingest stage of the aligned stream, NULL = none
+   recorder *recorder;      // aligned frames are also recorded, NULL = none
+   // filled in by the reader, final once the thread has exited
+   uint64_t frames_aligned;
+   uint64_t frames_slipped; // dropped from a board that was ahead of the others
+} serial_multi_reader_args;
+
+/**
+ * @brief Multi-device reader thread: one event loop for several serial
+ * ports, no thread per board. Each board's packets are parsed, gap-filled
+ * and queued as in serial_reader(), with its own sample clock. The head
+ * of every queue is put on the host time axis by that clock; boards more
+ * than SERIAL_ALIGN_SLIP_FRAMES apart lose their oldest frames until they
+ * line up (a later start, or a crystal running fast), then frames are
+ * merged into one multi-channel stream while every board has some.
+ *
+ * Returns when *stop is set, when every device has hung up, or on invalid
+ * arguments (a ring whose channels are not the sum of the boards').
+ *
+ * @param arg Pointer to a serial_multi_reader_args.
+ * @return NULL
+ */
+void *serial_multi_reader(void *arg);
+
+/**
+ * @brief Configure the serial port for raw 8N1 binary input.
+ *
+ * @param fd Open serial port.
+ * @param tuning VMIN/VTIME settings.
+ * @return void
+ */
+void setup_serial(int fd, const serial_tuning *tuning);
+
+#endif
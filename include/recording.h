@@ -0,0 +1,227 @@
+ /*
+ * @file recording.h
+ * @brief Session recording: a writer thread appending fixed-size chunks of
+ * frames to a file, and a memory-mapped reader with a chunk index.
+ *
+ * File layout (host byte order, little endian on every supported machine):
+ *
+ *   recording_header                      64 bytes
+ *   chunk 0 .. chunk N-1                  chunk_size bytes each
+ *     recording_chunk_header              32 bytes
+ *     frames_per_chunk * num_channels     float volts, interleaved
+ *   recording_index_entry[N]              16 bytes each (footer)
+ *   recording_trailer                     24 bytes, at the end of the file
+ *
+ * Every chunk holds contiguous frames: after frames were dropped (the
+ * recorder's ring was full) or at the end, a chunk is closed early and
+ * num_frames says how many of its slots are valid. first_frame counts
+ * dropped frames too, so gaps are visible. Timestamps are CLOCK_MONOTONIC
+ * times of the chunk's first frame, taken on the producer thread when its
+ * packet arrived.
+ *
+ * Because chunks have a fixed size, chunk i starts at
+ * header_size + i * chunk_size. The index footer adds the timestamps and
+ * frame positions of all chunks in one place, so a seek is a binary search
+ * over N * 16 bytes instead of touching every chunk. A file whose recorder
+ * never closed (crash, power loss) has no footer; the reader then rebuilds
+ * the index from the chunk headers.
+ *
+ * The producer only copies frames into a lock-free ring and a stamp
+ * (frame, time, sequence number) into a queue; write() happens on the
+ * recorder's own thread, so recording adds no I/O to the acquisition thread.
+ *
+ * Usage:
+ * - Writer: `recorder_open()`, `recorder_push()` with every packet's frames,
+ *   `recorder_close()` writes the last chunk and the index
+ * - Reader: `recording_open()` maps the file, `recording_seek()` finds a
+ *   time, `recording_chunk()` returns a chunk's frames in place,
+ *   `recording_close()` unmaps it
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mc_ring_buffer.h"
+
+#define RECORDING_MAGIC "EEGREC01"      // 8 bytes, no terminator in the file
+#define RECORDING_INDEX_MAGIC "EEGIDX01"
+#define RECORDING_VERSION 1
+#define RECORDING_CHUNK_MAGIC 0x4B4E4843u // "CHNK"
+#define RECORDER_STAMP_QUEUE_SIZE 4096    // packets in flight, power of two
+#define RECORDER_IDLE_US 1000             // writer sleep when there is nothing to do
+
+typedef struct {
+   char magic[8];              // RECORDING_MAGIC
+   uint32_t version;
+   uint32_t header_size;       // offset of chunk 0
+   uint32_t num_channels;
+   uint32_t frames_per_chunk;
+   float sample_rate;
+   uint32_t chunk_size;        // bytes per chunk, header included
+   uint64_t start_ns;          // CLOCK_MONOTONIC at the start, timestamps are on this clock
+   uint64_t start_unix_ns;     // wall clock at the start
+   uint8_t reserved[16];
+} recording_header;
+
+typedef struct {
+   uint32_t magic;             // RECORDING_CHUNK_MAGIC
+   uint32_t num_frames;        // valid frames, at most frames_per_chunk
+   uint64_t first_frame;       // frame index since the start, dropped frames included
+   uint64_t timestamp_ns;      // arrival of the first frame
+   uint16_t first_seq;         // packet sequence number of the first frame
+   uint16_t reserved16;
+   uint32_t reserved32;
+} recording_chunk_header;
+
+typedef struct {
+   uint64_t timestamp_ns;
+   uint64_t first_frame;
+} recording_index_entry;
+
+typedef struct {
+   uint64_t index_offset;
+   uint64_t num_chunks;
+   char magic[8];              // RECORDING_INDEX_MAGIC
+} recording_trailer;
+
+// one pushed packet, queued next to its frames
+typedef struct {
+   uint64_t first_frame;
+   uint64_t timestamp_ns;
+   uint32_t num_frames;
+   uint16_t seq;
+} recorder_stamp;
+
+typedef struct {
+   int fd;
+   int num_channels;
+   int frames_per_chunk;
+   float sample_rate;
+   size_t chunk_size;
+   mc_ring_buffer *ring;       // frames from the producer
+   recorder_stamp *stamps;     // RECORDER_STAMP_QUEUE_SIZE packets
+   atomic_uint stamp_head;
+   char pad_head[RB_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+   atomic_uint stamp_tail;
+   char pad_tail[RB_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+   // owned by the producer
+   uint64_t next_frame;
+   // owned by the writer thread
+   uint8_t *chunk;             // chunk being filled
+   int chunk_frames;
+   uint64_t chunk_next_frame;  // frame that continues the chunk
+   recording_index_entry *index;
+   uint64_t num_chunks;
+   uint64_t index_capacity;
+   uint64_t offset;            // file offset of the next chunk
+   // counters, readable from any thread
+   _Atomic uint64_t frames_dropped;
+   _Atomic uint64_t frames_written;
+   atomic_bool write_error;
+   atomic_bool stop;
+   pthread_t thread;
+   bool started;
+} recorder;
+
+typedef struct {
+   const uint8_t *map;
+   size_t size;
+   const recording_header *header;
+   const recording_index_entry *index;
+   recording_index_entry *owned_index; // rebuilt index of an unfinished file
+   uint64_t num_chunks;
+   bool finalized;             // false if the footer was missing
+} recording;
+
+// a frame in a recording
+typedef struct {
+   uint64_t chunk;
+   uint32_t frame;             // offset in the chunk
+} recording_pos;
+
+/**
+ * @brief Create a recording and start its writer thread.
+ *
+ * @param r Pointer to the recorder.
+ * @param path File to create (truncated if it exists).
+ * @param num_channels Channels per frame.
+ * @param sample_rate Sample rate in Hz.
+ * @param frames_per_chunk Frames per chunk.
+ * @param ring_frames Frames the producer can be ahead of the writer.
+ * @return true on success, false if an argument is invalid, the file
+ * cannot be created or allocation failed.
+ */
+bool recorder_open(recorder *r, const char *path, int num_channels, float sample_rate,
+                   int frames_per_chunk, int ring_frames);
+
+/**
+ * @brief Queue one packet of frames (producer thread, never blocks). A
+ * packet that does not fit is dropped whole and leaves a gap.
+ *
+ * @param r Pointer to the recorder.
+ * @param frames num_frames interleaved frames.
+ * @param num_frames Frames in the packet.
+ * @param seq Packet sequence number.
+ * @return true if queued, false if dropped.
+ */
+bool recorder_push(recorder *r, const float *frames, int num_frames, uint16_t seq);
+
+/**
+ * @brief Write what is queued, the last chunk and the index footer, stop
+ * the writer thread and close the file.
+ *
+ * @param r Pointer to the recorder.
+ * @return true if everything was written, false after a write error.
+ */
+bool recorder_close(recorder *r);
+
+/**
+ * @brief Map a recording read-only.
+ *
+ * @param r Pointer to the reader.
+ * @param path Recording file.
+ * @return true on success, false if the file cannot be mapped or is not a
+ * recording.
+ */
+bool recording_open(recording *r, const char *path);
+
+/**
+ * @brief A chunk and its frames, in place in the mapping.
+ *
+ * @param r Pointer to the reader.
+ * @param chunk Chunk index, < r->num_chunks.
+ * @param frames Set to the chunk's interleaved frames.
+ * @return the chunk header, NULL if the chunk does not exist.
+ */
+const recording_chunk_header *recording_chunk(const recording *r, uint64_t chunk,
+                                              const float **frames);
+
+/**
+ * @brief Find the frame recorded at a time, by binary search of the index.
+ *
+ * @param r Pointer to the reader.
+ * @param t_ns Time since the start of the recording.
+ * @param pos Set to the last frame recorded at or before t_ns (the first
+ * frame if t_ns is earlier, the first frame after a gap that contains t_ns).
+ * @return true if found, false if t_ns is after the end of the recording.
+ */
+bool recording_seek(const recording *r, uint64_t t_ns, recording_pos *pos);
+
+/**
+ * @brief Unmap a recording.
+ *
+ * @param r Pointer to the reader.
+ * @return void
+ */
+void recording_close(recording *r);
+
+#endif
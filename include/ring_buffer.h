@@ -7,10 +7,16 @@
  * in constant time. The buffer automatically wraps around when it reaches the end.
  *
  * Usage:
- * - Initialize using `ring_buffer_init()`
- * - Write using `ring_buffer_write()`
- * - Read using `ring_buffer_read()`
- * - Free memory with `ring_buffer_destroy()`
+ * - Initialize using `ring_buffer_init()`, `ring_buffer_init_pow2()` for mask
+ *   instead of modulo wrapping, `ring_buffer_init_mirrored()` so every
+ *   window is one contiguous span, or `ring_buffer_init_with_storage()` on
+ *   memory the caller provides (e.g. from an arena, see arena.h)
+ * - Write using `ring_buffer_write()`, or `ring_buffer_write_n()` for blocks
+ * - Read using `ring_buffer_read()`, or `ring_buffer_read_n()` for blocks
+ * - Or work in place: `ring_buffer_reserve()`/`ring_buffer_commit()` to produce
+ *   and `ring_buffer_peek()`/`ring_buffer_release()` to consume
+ * - Free memory with `ring_buffer_destroy()`, which frees the struct too, or
+ *   `ring_buffer_deinit()` for a struct embedded in another one or on the stack
  *
  * Functions returning `bool` will indicate:
  * - `true` = success or positive condition
@@ -28,18 +34,48 @@
 #define RING_BUFFER_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#ifdef EEG_METRICS
+#include <stdatomic.h>
+#endif
 
 // Custom typedef to make float size explicit
 typedef float float32_t;
 
+// What a write does when the buffer is full
+typedef enum {
+   RB_OVERFLOW_REJECT = 0, // write fails, newest values are lost (default)
+   RB_OVERFLOW_OVERWRITE,  // oldest values are dropped, freshest data is kept
+   RB_OVERFLOW_BLOCK       // writer waits up to a timeout (spsc_ring_buffer only)
+} ring_buffer_overflow_policy;
+
 typedef struct {
    float32_t *buffer;
    int head;
    int tail; 
    int curr_num_values; 
    int max_num_values;
+   size_t mirror_bytes; // size of one copy if storage is mirrored, 0 if malloc'd
+   bool external_storage; // buffer belongs to the caller (ring_buffer_init_with_storage())
+   bool pow2;           // capacity is a power of two, indices wrap with index_mask
+   int index_mask;      // max_num_values - 1 when pow2 
+   ring_buffer_overflow_policy overflow_policy;
+   uint64_t num_overwritten; // values dropped from the head to make room
+   uint64_t num_rejected;    // values a write could not store
+#ifdef EEG_METRICS
+   atomic_uint high_water;   // most values ever stored, see metrics.h
+#endif
 } ring_buffer;
 
+// A contiguous piece of the buffer storage. A window that wraps around
+// the end of the storage is described by two spans, the second one
+// starting at index 0. Unused spans have len 0.
+typedef struct {
+   float32_t *ptr;
+   int len;
+} ring_buffer_span;
+
 /**
  * @brief Initialize a ring buffer.
  * 
@@ -51,12 +87,74 @@ typedef struct {
 */
 bool ring_buffer_init(ring_buffer *rb, int capacity);  
 
+/**
+ * @brief Initialize a ring buffer whose capacity is a power of two.
+ *
+ * Same as ring_buffer_init(), but head and tail wrap with a bit mask
+ * instead of the integer division in `% max_num_values`.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param capacity Maximum number of values to store, must be a power of two.
+ * @return true on success, false if capacity is not a power of two or allocation failed.
+*/
+bool ring_buffer_init_pow2(ring_buffer *rb, int capacity);
+
+/**
+ * @brief Initialize a ring buffer with mirrored storage.
+ *
+ * The storage is mapped twice back-to-back (see vm_mirror.h), so
+ * rb->buffer[i + max_num_values] is the same memory as rb->buffer[i].
+ * Reserved and peeked windows are then always a single span, and any
+ * window of up to max_num_values values starting at head is contiguous.
+ * The capacity is rounded up to a whole number of pages, check
+ * rb->max_num_values for the actual capacity. If that is a power of two
+ * the mask fast path of ring_buffer_init_pow2() is used as well.
+ * Free with ring_buffer_destroy().
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param capacity Minimum number of values to store in the buffer.
+ * @return true on success, false if capacity is invalid or mapping failed.
+*/
+bool ring_buffer_init_mirrored(ring_buffer *rb, int capacity);
+
+/**
+ * @brief Initialize a ring buffer on storage provided by the caller.
+ *
+ * Allocates nothing: rb can be embedded in another struct or on the stack
+ * and the storage can come from an arena. The storage must outlive the
+ * buffer; ring_buffer_deinit() and ring_buffer_destroy() do not free it.
+ * A power-of-two capacity uses the mask fast path of ring_buffer_init_pow2().
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param storage capacity floats.
+ * @param capacity Maximum number of values to store in the buffer.
+ * @return true on success, false if storage is NULL or capacity is invalid.
+*/
+bool ring_buffer_init_with_storage(ring_buffer *rb, float32_t *storage, int capacity);
+
+/**
+ * @brief Choose what happens when writing to a full buffer.
+ *
+ * Call after any of the init functions, which default to RB_OVERFLOW_REJECT.
+ * With RB_OVERFLOW_OVERWRITE, ring_buffer_write(), ring_buffer_write_n() and
+ * ring_buffer_reserve() drop the oldest values to make room and count them in
+ * num_overwritten. Values a write could not store are counted in num_rejected.
+ * RB_OVERFLOW_BLOCK needs a second thread to drain the buffer, so it is only
+ * supported by spsc_ring_buffer.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param policy RB_OVERFLOW_REJECT or RB_OVERFLOW_OVERWRITE.
+ * @return true on success, false if the policy is not supported.
+ */
+bool ring_buffer_set_overflow_policy(ring_buffer *rb, ring_buffer_overflow_policy policy);
+
 /**
  * @brief Write a float value into the ring buffer.
  *
  * @param rb Pointer to the ring buffer instance.
  * @param value The float value to be written into the buffer.
- * @return true on successful write, false if the buffer is full.
+ * @return true on successful write, false if the buffer is full
+ *         (never false with RB_OVERFLOW_OVERWRITE).
  */
 bool ring_buffer_write(ring_buffer *rb, float32_t value);  
 
@@ -69,6 +167,79 @@ bool ring_buffer_write(ring_buffer *rb, float32_t value);
  */
 bool ring_buffer_read(ring_buffer *rb, float *result);               
 
+/**
+ * @brief Write a block of float values into the ring buffer.
+ *
+ * Copies as many of the n values as fit, using at most two memcpy calls
+ * (up to the end of the storage, then from the start after wrapping).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param values Pointer to the values to be written.
+ * @param n Number of values to write.
+ * @return number of values written, 0 if the buffer is full.
+ */
+int ring_buffer_write_n(ring_buffer *rb, const float32_t *values, int n);
+
+/**
+ * @brief Read a block of float values from the ring buffer.
+ *
+ * Copies up to n values, oldest first, using at most two memcpy calls.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param result Pointer to storage for at least n values.
+ * @param n Maximum number of values to read.
+ * @return number of values read, 0 if the buffer is empty.
+ */
+int ring_buffer_read_n(ring_buffer *rb, float32_t *result, int n);
+
+/**
+ * @brief Reserve space for up to n values to be written in place.
+ *
+ * Fills spans with up to two pieces of free storage at the tail, the
+ * caller writes directly into them (e.g. with read() or a DSP kernel)
+ * and then calls ring_buffer_commit(). The new values are not visible
+ * to readers until the commit. In overwrite mode the oldest values are
+ * dropped here, even if nothing is committed.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Maximum number of values to reserve.
+ * @param spans Array of two spans that is filled in.
+ * @return number of values reserved (sum of both span lengths).
+ */
+int ring_buffer_reserve(ring_buffer *rb, int n, ring_buffer_span spans[2]);
+
+/**
+ * @brief Commit n values written into the spans from ring_buffer_reserve().
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Number of values to commit, at most the number reserved.
+ * @return true on success, false if n is more than the free space.
+ */
+bool ring_buffer_commit(ring_buffer *rb, int n);
+
+/**
+ * @brief Look at up to n of the oldest values without copying them.
+ *
+ * Fills spans with up to two pieces of storage starting at the head. The
+ * values stay in the buffer and the spans stay valid until
+ * ring_buffer_release() is called.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Maximum number of values to peek at.
+ * @param spans Array of two spans that is filled in.
+ * @return number of values available in the spans.
+ */
+int ring_buffer_peek(ring_buffer *rb, int n, ring_buffer_span spans[2]);
+
+/**
+ * @brief Release n values seen through ring_buffer_peek().
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Number of values to drop from the head.
+ * @return true on success, false if n is more than the stored values.
+ */
+bool ring_buffer_release(ring_buffer *rb, int n);
+
 /**
  * @brief Check if the ring buffer is empty.
  *
@@ -86,7 +257,16 @@ bool ring_buffer_empty(ring_buffer *rb);
 bool ring_buffer_full(ring_buffer *rb);                
 
 /**
- * @brief Free the allocated memory from the ring buffer.
+ * @brief Free the storage of the ring buffer, not the struct itself.
+ *
+ * @param rb Pointer to the ringBuffer instance.
+ * @return void
+ */
+void ring_buffer_deinit(ring_buffer *rb);
+
+/**
+ * @brief Free the allocated memory from the ring buffer, including the
+ * struct itself (which must come from malloc()).
  *
  * @param rb Pointer to the ringBuffer instance.
  * @return void 
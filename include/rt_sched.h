@@ -0,0 +1,121 @@
+ /*
+ * @file rt_sched.h
+ * @brief Real-time scheduling, core pinning and wakeup jitter histograms.
+ *
+ * A scheduling policy is applied by a thread to itself, typically first
+ * thing in a pipeline stage thread (see pipeline_stage_config.sched):
+ *
+ * - macOS: THREAD_TIME_CONSTRAINT_POLICY via thread_policy_set(). The
+ *   thread declares its period, the CPU time it needs per period and the
+ *   deadline; the scheduler then runs it ahead of QoS-class threads (GUI
+ *   included) and keeps it on a P-core. Apple Silicon has no core pinning,
+ *   cpu_mask is ignored there.
+ * - Linux: SCHED_FIFO at `priority` and the CPU affinity in cpu_mask.
+ *
+ * A zero-initialized policy changes nothing. Real-time policies can be
+ * refused (SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO); the thread
+ * then keeps running with its previous policy and rt_sched_apply() says so.
+ *
+ * The jitter histogram collects scheduling latencies (how late a thread
+ * got the CPU after it should have woken up) in power-of-two microsecond
+ * buckets, written by one thread and read by any other.
+ *
+ * Usage:
+ * - `rt_sched_apply()` on the thread to configure
+ * - `rt_jitter_init()`, `rt_jitter_record()` on the measured thread,
+ *   `rt_jitter_read()` and `rt_jitter_percentile_us()` elsewhere
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef RT_SCHED_H
+#define RT_SCHED_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RT_SCHED_DEFAULT_PRIORITY 80 // SCHED_FIFO priority when priority is 0
+#define RT_JITTER_BUCKETS 20         // bucket i < 2^i us, the last one open ended
+
+typedef struct {
+   bool realtime;           // time-constraint (macOS) / SCHED_FIFO (Linux)
+   uint32_t period_us;      // nominal wakeup period, 0 = aperiodic
+   uint32_t computation_us; // CPU time needed per wakeup
+   uint32_t constraint_us;  // longest time from wakeup to done, >= computation_us
+   int priority;            // SCHED_FIFO 1..99, 0 = RT_SCHED_DEFAULT_PRIORITY
+   uint64_t cpu_mask;       // CPUs the thread may run on (Linux), 0 = any
+} rt_sched_policy;
+
+typedef struct {
+   _Atomic uint64_t buckets[RT_JITTER_BUCKETS];
+   _Atomic uint64_t count;
+   _Atomic uint64_t sum_ns;
+   _Atomic uint64_t max_ns;
+} rt_jitter;
+
+// plain copy of a histogram, see rt_jitter_read()
+typedef struct {
+   uint64_t buckets[RT_JITTER_BUCKETS];
+   uint64_t count;
+   uint64_t sum_ns;
+   uint64_t max_ns;
+} rt_jitter_snapshot;
+
+/**
+ * @brief Apply a scheduling policy to the calling thread.
+ *
+ * @param policy The policy, NULL or zero-initialized = leave as is.
+ * @return true if every requested setting was applied, false if one was
+ * invalid or refused (the others are still applied).
+ */
+bool rt_sched_apply(const rt_sched_policy *policy);
+
+/**
+ * @brief Human-readable name of a policy for reports, e.g. "time-constraint"
+ * or "fifo".
+ *
+ * @param policy The policy.
+ * @return a static string.
+ */
+const char *rt_sched_name(const rt_sched_policy *policy);
+
+/**
+ * @brief Initialize an empty histogram.
+ *
+ * @param j Pointer to the histogram.
+ * @return void
+ */
+void rt_jitter_init(rt_jitter *j);
+
+/**
+ * @brief Record one scheduling latency (single writer).
+ *
+ * @param j Pointer to the histogram.
+ * @param latency_ns Latency in nanoseconds.
+ * @return void
+ */
+void rt_jitter_record(rt_jitter *j, uint64_t latency_ns);
+
+/**
+ * @brief Copy a histogram, from any thread.
+ *
+ * @param j Pointer to the histogram.
+ * @param out The copy.
+ * @return void
+ */
+void rt_jitter_read(const rt_jitter *j, rt_jitter_snapshot *out);
+
+/**
+ * @brief Upper bound of the bucket holding a percentile.
+ *
+ * @param s Histogram copy.
+ * @param percentile 0..100.
+ * @return the bucket's upper bound in microseconds (the maximum for the
+ * open-ended last bucket), 0 for an empty histogram.
+ */
+uint64_t rt_jitter_percentile_us(const rt_jitter_snapshot *s, double percentile);
+
+#endif
@@ -0,0 +1,142 @@
+ /*
+ * @file sample_clock.h
+ * @brief Sample clock recovery and gap fill for the ingest path.
+ *
+ * The firmware samples on a timer interrupt and numbers its packets, so the
+ * sequence number of a packet times the frames per packet is the index of
+ * its first sample on the board's clock. The sample clock turns that into:
+ *
+ * - Gap detection: a jump in the sequence numbers is a run of frames that
+ *   were sampled but never arrived. Up to max_fill_frames of them are
+ *   replaced by a straight line from the last frame before the gap to the
+ *   first one after it, so everything downstream keeps a uniform sample
+ *   grid. Longer gaps are resyncs: nothing is filled, the index still
+ *   moves past the frames lost. A sequence going backwards (the board was
+ *   reset) is a resync that also restarts the rate fit.
+ * - Rate recovery: once per batch of packets (one read()), not per sample,
+ *   the reader pairs the index just past the last frame received with one
+ *   host timestamp. An exponentially weighted least-squares line through
+ *   these pairs gives the nanoseconds per sample, i.e. the board's true
+ *   rate in host time. USB and scheduling delays only ever make a batch
+ *   late, which moves the line but not its slope.
+ *
+ * All state belongs to the reader thread; read the estimate from another
+ * thread only after the reader has exited.
+ *
+ * Usage:
+ * - `sample_clock_init()` with the firmware's nominal rate and the longest gap to fill
+ * - `sample_clock_packet()` for every packet, fill what it returns with `sample_clock_fill_codes()`
+ * - `sample_clock_observe()` once per batch with a host timestamp
+ * - `sample_clock_rate()` / `sample_clock_drift_ppm()` for the estimate,
+ *   `sample_clock_time_ns()` to put a sample on the host time axis
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SAMPLE_CLOCK_MIN_OBSERVATIONS 8    // batches before the estimate replaces the nominal rate
+#define SAMPLE_CLOCK_ALPHA (1.0 / 512.0)   // weight of a new batch once the fit has settled
+
+typedef struct {
+   double nominal_rate;      // Hz, what the firmware is configured for
+   int max_fill_frames;      // longest gap filled, longer ones are resyncs
+   // sequence tracking
+   bool have_seq;            // false until the first packet
+   uint16_t next_seq;
+   uint64_t next_index;      // sample index of the next frame expected
+   // weighted fit of host time (y, ns) against sample index (x), both
+   // relative to the first observation of the current run
+   uint64_t observations;
+   uint64_t origin_index;
+   uint64_t origin_ns;
+   double mean_x, mean_y;
+   double var_x, cov_xy;
+   // statistics
+   uint64_t gaps;            // gaps filled
+   uint64_t frames_filled;
+   uint64_t resyncs;         // gaps too long to fill, or the sequence went backwards
+} sample_clock;
+
+/**
+ * @brief Initialize a sample clock.
+ *
+ * @param c Pointer to the clock.
+ * @param nominal_rate Firmware sample rate in Hz, > 0.
+ * @param max_fill_frames Longest gap in frames to fill, 0 = detect only.
+ * @return true on success, false on invalid arguments.
+ */
+bool sample_clock_init(sample_clock *c, double nominal_rate, int max_fill_frames);
+
+/**
+ * @brief Account for one packet, in arrival order.
+ *
+ * @param c Pointer to the clock.
+ * @param seq Sequence number of the packet.
+ * @param num_frames Frames in the packet.
+ * @return number of frames missing right before this packet that should be
+ * filled in, 0 for none (no gap, the first packet, or a resync).
+ */
+int sample_clock_packet(sample_clock *c, uint16_t seq, int num_frames);
+
+/**
+ * @brief Add one timestamp to the rate fit: the frames before
+ * c->next_index had all arrived at now_ns. Call once per batch.
+ *
+ * @param c Pointer to the clock.
+ * @param now_ns Host time, e.g. pipeline_now_ns().
+ * @return void
+ */
+void sample_clock_observe(sample_clock *c, uint64_t now_ns);
+
+/**
+ * @brief Estimated sample rate in host time.
+ *
+ * @param c Pointer to the clock.
+ * @return samples per second, the nominal rate until SAMPLE_CLOCK_MIN_OBSERVATIONS batches.
+ */
+double sample_clock_rate(const sample_clock *c);
+
+/**
+ * @brief Host time of a sample on the fitted line, e.g. to line up the
+ * samples of several boards. Like the fit this includes the mean transport
+ * delay of the board.
+ *
+ * @param c Pointer to the clock.
+ * @param index Sample index, see c->next_index.
+ * @param time_ns Set to the host time in ns.
+ * @return true on success, false before the first observation of the run.
+ */
+bool sample_clock_time_ns(const sample_clock *c, uint64_t index, uint64_t *time_ns);
+
+/**
+ * @brief Deviation of the estimate from the nominal rate.
+ *
+ * @param c Pointer to the clock.
+ * @return parts per million, > 0 if the board samples faster than nominal.
+ */
+double sample_clock_drift_ppm(const sample_clock *c);
+
+/**
+ * @brief Interpolate frames of a gap between two known frames, in pieces
+ * of any size: frames first .. first + num_frames - 1 of gap_frames.
+ *
+ * @param before Frame before the gap, num_channels codes.
+ * @param after Frame after the gap, num_channels codes.
+ * @param num_channels Channels per frame.
+ * @param gap_frames Frames in the whole gap.
+ * @param first First frame of the gap to make.
+ * @param num_frames Frames to make.
+ * @param out Storage for num_frames * num_channels interleaved codes.
+ * @return void
+ */
+void sample_clock_fill_codes(const int16_t *before, const int16_t *after, int num_channels,
+                             int gap_frames, int first, int num_frames, int16_t *out);
+
+#endif
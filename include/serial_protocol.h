@@ -0,0 +1,142 @@
+ /*
+ * @file serial_protocol.h
+ * @brief Framed binary packet format between the firmware and serial_reader.
+ *
+ * Each packet carries many samples so the firmware makes one Serial.write()
+ * per packet and the host one read() per packet. All fields little endian:
+ *
+ *   offset  size  field
+ *   0       2     sync word 0xA55A (bytes 0x5A 0xA5)
+ *   2       2     sequence number, +1 per packet, wraps at 65536
+ *   4       1     number of channels per frame (1..SERIAL_PROTO_MAX_CHANNELS)
+ *   5       1     protocol version (SERIAL_PROTO_VERSION)
+ *   6       2     number of frames in the packet (1..SERIAL_PROTO_MAX_FRAMES)
+ *   8       2*N   N = channels * frames int16 ADC codes, interleaved by frame
+ *   8+2N    2     CRC-16/CCITT-FALSE of bytes 2 .. 8+2N-1
+ *
+ * The parser is fed arbitrary chunks of the byte stream. It finds the sync
+ * word, checks the header and CRC, and on any mismatch drops one byte and
+ * searches again, so a lost or corrupted byte costs at most the packets it
+ * touches. Gaps in the sequence numbers count lost packets.
+ *
+ * Usage:
+ * - Firmware: build packets with the same layout (see firmware/arduino_read)
+ * - Host: `serial_parser_init()`, then `serial_parser_feed()` with every chunk read
+ * - Convert codes with `serial_code_to_volts()`, or keep them in an int16
+ *   mc_ring_buffer scaled by SERIAL_VOLTS_PER_CODE
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef SERIAL_PROTOCOL_H
+#define SERIAL_PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERIAL_PROTO_SYNC 0xA55A
+#define SERIAL_PROTO_VERSION 1
+#define SERIAL_PROTO_HEADER_SIZE 8
+#define SERIAL_PROTO_CRC_SIZE 2
+#define SERIAL_PROTO_MAX_CHANNELS 255   // channel count is one byte
+#define SERIAL_PROTO_MAX_CODES 4096     // channels * frames per packet
+#define SERIAL_PROTO_MAX_FRAMES SERIAL_PROTO_MAX_CODES
+#define SERIAL_PROTO_MAX_PACKET \
+   (SERIAL_PROTO_HEADER_SIZE + 2 * SERIAL_PROTO_MAX_CODES + SERIAL_PROTO_CRC_SIZE)
+
+// ADC scale of the Arduino Uno: 10-bit codes, 5 V reference
+#define SERIAL_ADC_VREF 5.0f
+#define SERIAL_ADC_MAX_CODE 1023
+#define SERIAL_VOLTS_PER_CODE (SERIAL_ADC_VREF / SERIAL_ADC_MAX_CODE)
+
+// A decoded packet
+typedef struct {
+   uint16_t seq;
+   int num_channels;
+   int num_frames;
+   int16_t codes[SERIAL_PROTO_MAX_CODES]; // num_frames * num_channels, interleaved
+} serial_packet;
+
+// Called by serial_parser_feed() for every valid packet
+typedef void (*serial_packet_fn)(const serial_packet *pkt, void *ctx);
+
+typedef struct {
+   uint8_t buf[SERIAL_PROTO_MAX_PACKET]; // staging for a partially received packet
+   size_t len;
+   bool have_seq;                        // false until the first packet
+   uint16_t next_seq;
+   serial_packet pkt;                    // decoded packet handed to the callback
+   // statistics
+   uint64_t packets_ok;
+   uint64_t packets_lost;                // sequence gaps
+   uint64_t frames_lost;                 // sequence gaps * frames of the packet after the gap
+   uint64_t crc_errors;
+   uint64_t bytes_skipped;               // bytes dropped while searching for a sync word
+} serial_parser;
+
+/**
+ * @brief Total size in bytes of a packet.
+ *
+ * @param num_channels Channels per frame.
+ * @param num_frames Frames in the packet.
+ * @return packet size, header + codes + CRC.
+ */
+size_t serial_packet_size(int num_channels, int num_frames);
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, no reflection).
+ *
+ * @param data Bytes to check.
+ * @param len Number of bytes.
+ * @return the CRC.
+ */
+uint16_t serial_crc16(const uint8_t *data, size_t len);
+
+/**
+ * @brief Encode a packet (used by tests and host-side simulators).
+ *
+ * @param out Storage for serial_packet_size(num_channels, num_frames) bytes.
+ * @param seq Sequence number.
+ * @param num_channels Channels per frame.
+ * @param num_frames Frames in the packet.
+ * @param codes num_channels * num_frames interleaved ADC codes.
+ * @return bytes written, 0 if the sizes are out of range.
+ */
+size_t serial_packet_encode(uint8_t *out, uint16_t seq, int num_channels, int num_frames,
+                            const int16_t *codes);
+
+/**
+ * @brief Reset a parser and its statistics.
+ *
+ * @param p Pointer to the parser.
+ * @return void
+ */
+void serial_parser_init(serial_parser *p);
+
+/**
+ * @brief Feed received bytes, calls fn for every complete valid packet.
+ *
+ * @param p Pointer to the parser.
+ * @param data Received bytes.
+ * @param len Number of bytes.
+ * @param fn Packet callback.
+ * @param ctx Passed through to fn.
+ * @return number of packets delivered.
+ */
+int serial_parser_feed(serial_parser *p, const uint8_t *data, size_t len,
+                       serial_packet_fn fn, void *ctx);
+
+/**
+ * @brief Convert an ADC code to volts.
+ *
+ * @param code ADC code.
+ * @return voltage.
+ */
+static inline float serial_code_to_volts(int16_t code){
+   return code * SERIAL_VOLTS_PER_CODE;
+}
+
+#endif
@@ -0,0 +1,179 @@
+ /*
+ * @file serial_source.h
+ * @brief Byte sources for serial_reader: a real tty, a pty-backed synthetic
+ * generator and a capture file replay.
+ *
+ * Every source hands serial_reader one readable descriptor
+ * (`serial_source.fd` -> `serial_reader_args.fd`), so the same reader,
+ * parser and ring code runs no matter where the bytes come from:
+ *
+ * - tty: the acquisition board's serial port, configured by setup_serial().
+ * - synth: a generator thread writes protocol packets into the master side
+ *   of a pseudo terminal; the reader reads the slave side, configured by
+ *   setup_serial() like a real port. Content is a seeded sine mix plus
+ *   noise, so two runs with the same config produce the same bytes. Faults
+ *   on request: packets written in bursts, sequence gaps, corrupted bytes,
+ *   and a hang-up (disconnect) after the last packet.
+ * - replay: a capture of the raw byte stream (e.g. `cat /dev/cu.usbmodem*`)
+ *   is written into a pipe at the rate it was recorded, or any multiple of
+ *   it; at maximum speed the reader reads the file directly.
+ * - recording: a session file (recording.h) is re-encoded into packets,
+ *   starting at any time in the session, at the recorded timing (chunk
+ *   timestamps) or a multiple of it. The packets are the recorded ones:
+ *   frames_per_packet frames each, across chunk boundaries, with their
+ *   recorded sequence numbers, so packets lost while recording are lost on
+ *   replay too. A start time inside a packet starts at that packet; only
+ *   frames missing from the recording leave a shorter one.
+ *
+ * Timing is paced against absolute deadlines (packet k is due at
+ * k * frames_per_packet / sample_rate / speed after the start), so sleeping
+ * late never accumulates drift. speed 10..100 runs the full ingest path at
+ * 10..100x real time without a board attached.
+ *
+ * Usage:
+ * - `serial_source_open_tty()`, `serial_source_open_synth()`,
+ *   `serial_source_open_replay()` or `serial_source_open_recording()`
+ * - run serial_reader() with `args.fd = source.fd`; it returns on the
+ *   hang-up / end of file when the source is finite
+ * - `serial_source_close()` stops the feeder thread and closes everything
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef SERIAL_SOURCE_H
+#define SERIAL_SOURCE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "read_serial_data.h"
+
+#define SERIAL_SYNTH_MAX_TONES 4
+#define SERIAL_SOURCE_DRAIN_MS 1000     // longest wait for the reader before a hang-up
+
+typedef enum {
+   SERIAL_SOURCE_TTY = 0,
+   SERIAL_SOURCE_SYNTH,
+   SERIAL_SOURCE_REPLAY,
+   SERIAL_SOURCE_RECORDING
+} serial_source_kind;
+
+typedef struct {
+   int num_channels;
+   int frames_per_packet;
+   float sample_rate;         // Hz, sets the packet period
+   float speed;               // 1 = real time, 0 = as fast as the reader takes bytes
+   uint64_t num_packets;      // 0 = until closed, else hang up after the last one
+   uint32_t seed;             // noise generator seed, 0 is replaced by 1
+   // signal, the same on every channel but scaled by 1 + 0.25 * channel
+   int num_tones;
+   float tone_hz[SERIAL_SYNTH_MAX_TONES];
+   float tone_v[SERIAL_SYNTH_MAX_TONES]; // amplitude in volts
+   float offset_v;            // DC level, e.g. mid-scale of the ADC
+   float noise_v;             // peak amplitude of the noise
+   // faults, 0 = off
+   int burst_packets;         // packets held back and written with one write()
+   int drop_every;            // every Nth sequence number is never sent
+   int corrupt_every;         // every Nth packet has one payload byte flipped
+} serial_synth_config;
+
+typedef struct {
+   int num_channels;          // of the recording, sets the pace
+   int frames_per_packet;
+   float sample_rate;
+   float speed;               // 1 = recorded rate, 0 = maximum (file read directly)
+} serial_replay_config;
+
+typedef struct {
+   int frames_per_packet;     // packet size of the recorded stream
+   float speed;               // 1 = recorded timing, 0 = as fast as the reader takes bytes
+   uint64_t start_ns;         // where to start, time since the start of the recording
+} serial_recording_config;
+
+typedef struct {
+   serial_source_kind kind;
+   int fd;                    // read by serial_reader
+   int feed_fd;               // written by the feeder thread (pty master, pipe), -1 = none
+   int file_fd;               // capture read by the replay thread, -1 = none
+   serial_synth_config synth;
+   serial_replay_config replay;
+   serial_recording_config rec_config;
+   recording rec;             // mapped session of a recording source
+   recording_pos rec_start;
+   pthread_t thread;
+   bool thread_started;
+   atomic_bool stop;
+   // written by the feeder thread, final after serial_source_close()
+   _Atomic uint64_t packets_sent;
+   _Atomic uint64_t bytes_sent;
+} serial_source;
+
+/**
+ * @brief Open and configure a serial port.
+ *
+ * @param s The source.
+ * @param path Device path, e.g. /dev/cu.usbmodem11301.
+ * @param tuning VMIN/VTIME settings for setup_serial().
+ * @return true on success, false if the device cannot be opened.
+ */
+bool serial_source_open_tty(serial_source *s, const char *path, const serial_tuning *tuning);
+
+/**
+ * @brief Open a pseudo terminal and start the packet generator on it.
+ *
+ * @param s The source.
+ * @param config Packet layout, rate, signal and faults.
+ * @return true on success, false if the config is invalid or the pty or
+ * thread cannot be created.
+ */
+bool serial_source_open_synth(serial_source *s, const serial_synth_config *config);
+
+/**
+ * @brief Replay a capture of the raw serial byte stream.
+ *
+ * @param s The source.
+ * @param path Capture file.
+ * @param config Packet layout and rate of the recording, replay speed.
+ * @return true on success, false if the file cannot be opened or the
+ * config is invalid.
+ */
+bool serial_source_open_replay(serial_source *s, const char *path,
+                               const serial_replay_config *config);
+
+/**
+ * @brief Replay a session recording through the serial protocol.
+ *
+ * @param s The source.
+ * @param path Recording file (see recording.h).
+ * @param config Packet size, speed and start time.
+ * @return true on success, false if the file is not a recording, the start
+ * time is past its end or the config is invalid.
+ */
+bool serial_source_open_recording(serial_source *s, const char *path,
+                                  const serial_recording_config *config);
+
+/**
+ * @brief Voltage the generator sends for one sample (before quantization),
+ * for checking what the reader received.
+ *
+ * @param config Generator config.
+ * @param frame Frame index since the start.
+ * @param channel Channel index.
+ * @return the noise-free voltage.
+ */
+float serial_synth_clean_v(const serial_synth_config *config, uint64_t frame, int channel);
+
+/**
+ * @brief Stop the feeder thread and close all descriptors. Call after
+ * serial_reader() has returned: on its own for a finite source, after its
+ * stop flag was set otherwise.
+ *
+ * @param s The source.
+ * @return void
+ */
+void serial_source_close(serial_source *s);
+
+#endif
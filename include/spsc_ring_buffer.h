@@ -0,0 +1,403 @@
+ /*
+ * @file spsc_ring_buffer.h
+ * @brief Lock-free single-producer/single-consumer ring buffer for real-time data streams.
+ *
+ * This header provides a thread-safe variant of the ring buffer in ring_buffer.h.
+ * Exactly one thread may write (the producer, e.g. serial_reader()) and exactly one
+ * thread may read (the consumer, e.g. the DSP stage) at the same time, without any
+ * mutex.
+ *
+ * Differences to ring_buffer:
+ * - There is no shared curr_num_values counter. The fill level is derived from
+ *   head and tail, so each index is only ever stored by one thread.
+ * - head is owned by the consumer, tail is owned by the producer. They are published
+ *   with release stores and observed with acquire loads.
+ * - head and tail are kept on separate cache lines so the producer and consumer
+ *   do not invalidate each other's line on every sample (false sharing).
+ * - Indices run from 0 to 2*capacity-1, which lets a full buffer (tail - head == capacity)
+ *   be told apart from an empty one (tail == head) without wasting a slot.
+ * - With a power-of-two capacity (spsc_ring_buffer_init_pow2()) head and tail are
+ *   free-running unsigned counters instead: fill level is tail - head and the slot
+ *   is index & (capacity - 1), with no compares on the index path.
+ * - The overflow policy (see ring_buffer_overflow_policy) decides what a write to a
+ *   full buffer does: fail, drop the oldest values, or wait for the consumer.
+ *   Dropped and rejected values are counted so they can be alarmed on.
+ * - Values are float32_t, or int16_t for rings made by spsc_ring_buffer_init_i16()
+ *   (raw ADC codes, half the bytes). The index logic is the same for both; the
+ *   float functions refuse an int16 ring and the `_i16` ones a float ring
+ *   (false, 0 values or empty spans).
+ *
+ * Usage:
+ * - Initialize using `spsc_ring_buffer_init()`, `spsc_ring_buffer_init_pow2()` for
+ *   free-running masked indices, `spsc_ring_buffer_init_mirrored()` so every
+ *   window is one contiguous span, or `spsc_ring_buffer_init_with_storage()` on
+ *   caller memory (an embedded struct, storage from an arena)
+ * - Write using `spsc_ring_buffer_write()` or `spsc_ring_buffer_write_n()` (producer thread only)
+ * - Read using `spsc_ring_buffer_read()` or `spsc_ring_buffer_read_n()` (consumer thread only)
+ * - Or work in place: `spsc_ring_buffer_reserve()`/`spsc_ring_buffer_commit()` on the
+ *   producer and `spsc_ring_buffer_peek()`/`spsc_ring_buffer_release()` on the consumer
+ * - Free memory with `spsc_ring_buffer_destroy()` once both threads are done
+ *   (`spsc_ring_buffer_deinit()` for a struct that was not malloc'd)
+ *
+ * Functions returning `bool` will indicate:
+ * - `true` = success or positive condition
+ * - `false` = failure or negative condition
+ *
+ * Application:
+ * - Real-time EEG data buffering between the serial reader and DSP threads
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include "ring_buffer.h"
+
+// Apple M-series cores use 128 byte cache lines, most other targets use 64
+#if defined(__APPLE__) && defined(__aarch64__)
+#define RB_CACHE_LINE_SIZE 128
+#else
+#define RB_CACHE_LINE_SIZE 64
+#endif
+
+typedef struct {
+   // consumer cache line: head is stored by the consumer (and by the
+   // producer only in RB_OVERFLOW_OVERWRITE mode, with compare-and-swap)
+   atomic_uint head;
+   unsigned int tail_cache;  // consumer's last observed value of tail
+   unsigned int peek_head;   // head seen by the last peek, checked by release
+   char pad_head[RB_CACHE_LINE_SIZE - 3*sizeof(unsigned int)];
+
+   // producer cache line: tail and the drop counters are only stored by the producer
+   atomic_uint tail;
+   unsigned int head_cache;  // producer's last observed value of head
+   _Atomic uint64_t num_overwritten; // values dropped from the head to make room
+   _Atomic uint64_t num_rejected;    // values a write could not store
+#ifdef EEG_METRICS
+   atomic_uint high_water;           // most values ever stored, see metrics.h
+   char pad_tail[RB_CACHE_LINE_SIZE - 3*sizeof(unsigned int) - 2*sizeof(uint64_t)];
+#else
+   char pad_tail[RB_CACHE_LINE_SIZE - 2*sizeof(unsigned int) - 2*sizeof(uint64_t)];
+#endif
+
+   // read-only after initialization
+   union {
+      float32_t *buffer;
+      int16_t *codes;   // int16 rings, same storage
+   };
+   int value_size;      // bytes per value: sizeof(float32_t), or sizeof(int16_t) for an int16 ring
+   int max_num_values;
+   size_t mirror_bytes; // size of one copy if storage is mirrored, 0 if malloc'd
+   bool external_storage; // buffer belongs to the caller (spsc_ring_buffer_init_with_storage())
+   bool pow2;           // free-running indices, slot = index & index_mask
+   unsigned int index_mask;
+   ring_buffer_overflow_policy overflow_policy;
+   int block_timeout_us; // RB_OVERFLOW_BLOCK: longest wait for room, < 0 waits forever
+} spsc_ring_buffer;
+
+// A contiguous piece of an int16 ring's storage, see ring_buffer_span.
+typedef struct {
+   int16_t *ptr;
+   int len;
+} ring_buffer_span_i16;
+
+/**
+ * @brief Initialize an SPSC ring buffer.
+ *
+ * Allocates memory for a new ring buffer with the specified capacity.
+ * Must be called before the producer and consumer threads are started.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param capacity Maximum number of values to store in the buffer.
+ * @return true on success, false if capacity is invalid or allocation failed.
+*/
+bool spsc_ring_buffer_init(spsc_ring_buffer *rb, int capacity);
+
+/**
+ * @brief Initialize an SPSC ring buffer whose capacity is a power of two.
+ *
+ * head and tail become free-running counters that wrap naturally at
+ * 2^32, slots are found with a bit mask.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param capacity Maximum number of values to store, must be a power of two.
+ * @return true on success, false if capacity is not a power of two or allocation failed.
+*/
+bool spsc_ring_buffer_init_pow2(spsc_ring_buffer *rb, int capacity);
+
+/**
+ * @brief Initialize an SPSC ring buffer with mirrored storage.
+ *
+ * Same as ring_buffer_init_mirrored(): the storage is mapped twice so
+ * reserve/peek always return one span, a vDSP kernel can run on a window
+ * that wraps. The capacity is rounded up to whole pages, check
+ * rb->max_num_values. If that is a power of two the free-running index
+ * scheme of spsc_ring_buffer_init_pow2() is used as well.
+ * Free with spsc_ring_buffer_destroy().
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param capacity Minimum number of values to store in the buffer.
+ * @return true on success, false if capacity is invalid or mapping failed.
+*/
+bool spsc_ring_buffer_init_mirrored(spsc_ring_buffer *rb, int capacity);
+
+/**
+ * @brief Initialize an SPSC ring buffer on storage provided by the caller.
+ *
+ * Same as ring_buffer_init_with_storage(): nothing is allocated and the
+ * storage is never freed by the buffer. A power-of-two capacity uses the
+ * free-running index scheme of spsc_ring_buffer_init_pow2(). Place the
+ * struct on a cache line boundary (e.g. from an arena) so its producer and
+ * consumer lines do not straddle their neighbours.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param storage capacity floats.
+ * @param capacity Maximum number of values to store in the buffer.
+ * @return true on success, false if storage is NULL or capacity is invalid.
+*/
+bool spsc_ring_buffer_init_with_storage(spsc_ring_buffer *rb, float32_t *storage, int capacity);
+
+/**
+ * @brief Initialize an SPSC ring buffer of int16_t values (e.g. ADC codes).
+ *
+ * A power-of-two capacity uses the free-running index scheme of
+ * spsc_ring_buffer_init_pow2(). Use the `_i16` functions to move values,
+ * spsc_ring_buffer_commit()/spsc_ring_buffer_release() and the size and
+ * policy functions as for a float ring.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param capacity Maximum number of values to store in the buffer.
+ * @return true on success, false if capacity is invalid or allocation failed.
+*/
+bool spsc_ring_buffer_init_i16(spsc_ring_buffer *rb, int capacity);
+
+/**
+ * @brief Initialize an SPSC ring buffer of int16_t values on caller storage,
+ * see spsc_ring_buffer_init_with_storage().
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param storage capacity values.
+ * @param capacity Maximum number of values to store in the buffer.
+ * @return true on success, false if storage is NULL or capacity is invalid.
+*/
+bool spsc_ring_buffer_init_i16_with_storage(spsc_ring_buffer *rb, int16_t *storage, int capacity);
+
+/**
+ * @brief Choose what happens when the producer writes to a full buffer.
+ *
+ * Call after init and before the threads start. The default is RB_OVERFLOW_REJECT.
+ * - RB_OVERFLOW_OVERWRITE: write, write_n and reserve move head forward with a
+ *   compare-and-swap to drop the oldest values, so the consumer always sees the
+ *   freshest data. The consumer then also advances head with compare-and-swap,
+ *   and spsc_ring_buffer_release() returns false if the peeked window was dropped
+ *   while it was being used.
+ * - RB_OVERFLOW_BLOCK: write and write_n wait (yielding) until there is room or
+ *   timeout_us microseconds have passed, whatever did not fit is rejected.
+ *   reserve never waits.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param policy The overflow policy.
+ * @param timeout_us Longest wait for RB_OVERFLOW_BLOCK, < 0 waits forever. Ignored otherwise.
+ * @return true on success, false if the policy is unknown.
+ */
+bool spsc_ring_buffer_set_overflow_policy(spsc_ring_buffer *rb,
+                                          ring_buffer_overflow_policy policy,
+                                          int timeout_us);
+
+/**
+ * @brief Number of values dropped from the head by RB_OVERFLOW_OVERWRITE (any thread).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return total count since init.
+ */
+uint64_t spsc_ring_buffer_num_overwritten(spsc_ring_buffer *rb);
+
+/**
+ * @brief Number of values writes could not store (any thread).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return total count since init.
+ */
+uint64_t spsc_ring_buffer_num_rejected(spsc_ring_buffer *rb);
+
+/**
+ * @brief Write a float value into the ring buffer (producer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param value The float value to be written into the buffer.
+ * @return true on successful write, false if the buffer is full (after the
+ *         timeout with RB_OVERFLOW_BLOCK, never with RB_OVERFLOW_OVERWRITE).
+ */
+bool spsc_ring_buffer_write(spsc_ring_buffer *rb, float32_t value);
+
+/**
+ * @brief Read a value from the ring buffer (consumer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param result Pointer to the float value that's read.
+ * @return true is float value read, false if empty
+ */
+bool spsc_ring_buffer_read(spsc_ring_buffer *rb, float32_t *result);
+
+/**
+ * @brief Write a block of float values into the ring buffer (producer thread only).
+ *
+ * Copies as many of the n values as fit with at most two memcpy calls and
+ * publishes them all with a single release store of tail.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param values Pointer to the values to be written.
+ * @param n Number of values to write.
+ * @return number of values written, 0 if the buffer is full.
+ */
+int spsc_ring_buffer_write_n(spsc_ring_buffer *rb, const float32_t *values, int n);
+
+/**
+ * @brief Read a block of float values from the ring buffer (consumer thread only).
+ *
+ * Copies up to n values, oldest first, with at most two memcpy calls and
+ * releases the slots with a single release store of head.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param result Pointer to storage for at least n values.
+ * @param n Maximum number of values to read.
+ * @return number of values read, 0 if the buffer is empty.
+ */
+int spsc_ring_buffer_read_n(spsc_ring_buffer *rb, float32_t *result, int n);
+
+/**
+ * @brief spsc_ring_buffer_write_n() for an int16 ring (producer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance, from spsc_ring_buffer_init_i16().
+ * @param values Pointer to the values to be written.
+ * @param n Number of values to write.
+ * @return number of values written, 0 if the buffer is full.
+ */
+int spsc_ring_buffer_write_n_i16(spsc_ring_buffer *rb, const int16_t *values, int n);
+
+/**
+ * @brief spsc_ring_buffer_read_n() for an int16 ring (consumer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance, from spsc_ring_buffer_init_i16().
+ * @param result Pointer to storage for at least n values.
+ * @param n Maximum number of values to read.
+ * @return number of values read, 0 if the buffer is empty.
+ */
+int spsc_ring_buffer_read_n_i16(spsc_ring_buffer *rb, int16_t *result, int n);
+
+/**
+ * @brief Reserve space for up to n values to be written in place (producer thread only).
+ *
+ * Fills spans (see ring_buffer_span) with up to two pieces of free storage
+ * at the tail. The producer writes directly into them, e.g. read() from the
+ * serial port, and publishes with spsc_ring_buffer_commit(). The consumer
+ * cannot see the values before the commit. In overwrite mode the oldest
+ * values are dropped here, even if nothing is committed.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Maximum number of values to reserve.
+ * @param spans Array of two spans that is filled in.
+ * @return number of values reserved (sum of both span lengths).
+ */
+int spsc_ring_buffer_reserve(spsc_ring_buffer *rb, int n, ring_buffer_span spans[2]);
+
+/**
+ * @brief Publish n values written into reserved spans (producer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Number of values to commit, at most the number reserved.
+ * @return true on success, false if n is more than the free space.
+ */
+bool spsc_ring_buffer_commit(spsc_ring_buffer *rb, int n);
+
+/**
+ * @brief Look at up to n of the oldest values in place (consumer thread only).
+ *
+ * Fills spans with up to two pieces of storage starting at the head. The
+ * producer will not overwrite them until spsc_ring_buffer_release(), so a
+ * DSP kernel can run directly on the spans.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Maximum number of values to peek at.
+ * @param spans Array of two spans that is filled in.
+ * @return number of values available in the spans.
+ */
+int spsc_ring_buffer_peek(spsc_ring_buffer *rb, int n, ring_buffer_span spans[2]);
+
+/**
+ * @brief spsc_ring_buffer_peek() for an int16 ring (consumer thread only),
+ * hand the values back with spsc_ring_buffer_release().
+ *
+ * @param rb Pointer to the ring buffer instance, from spsc_ring_buffer_init_i16().
+ * @param n Maximum number of values to peek at.
+ * @param spans Array of two spans that is filled in.
+ * @return number of values available in the spans.
+ */
+int spsc_ring_buffer_peek_i16(spsc_ring_buffer *rb, int n, ring_buffer_span_i16 spans[2]);
+
+/**
+ * @brief Hand n peeked values back to the producer (consumer thread only).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @param n Number of values to drop from the head.
+ * @return true on success, false if n is more than the stored values, or
+ *         with RB_OVERFLOW_OVERWRITE if the producer dropped the peeked window
+ *         in the meantime (its contents may be overwritten, peek again).
+ */
+bool spsc_ring_buffer_release(spsc_ring_buffer *rb, int n);
+
+/**
+ * @brief Number of values currently stored in the ring buffer.
+ *
+ * When called while the other thread is active, this is a snapshot that may
+ * already be stale when it returns. It is exact from the producer's point of
+ * view as an upper bound and from the consumer's point of view as a lower bound.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return number of stored values.
+ */
+int spsc_ring_buffer_size(spsc_ring_buffer *rb);
+
+/**
+ * @brief Check if the ring buffer is empty (snapshot, see spsc_ring_buffer_size()).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return true if the buffer is empty, false otherwise.
+ */
+bool spsc_ring_buffer_empty(spsc_ring_buffer *rb);
+
+/**
+ * @brief Check if the ring buffer is full (snapshot, see spsc_ring_buffer_size()).
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return true if the buffer is full, false otherwise.
+ */
+bool spsc_ring_buffer_full(spsc_ring_buffer *rb);
+
+/**
+ * @brief Free the storage of the ring buffer, not the struct itself.
+ * Neither thread may touch the buffer after this call.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return void
+ */
+void spsc_ring_buffer_deinit(spsc_ring_buffer *rb);
+
+/**
+ * @brief Free the allocated memory from the ring buffer.
+ *
+ * Same contract as ring_buffer_destroy(): the struct itself is freed as well.
+ * Neither thread may touch the buffer after this call.
+ *
+ * @param rb Pointer to the ring buffer instance.
+ * @return void
+ */
+void spsc_ring_buffer_destroy(spsc_ring_buffer *rb);
+
+#endif
@@ -0,0 +1,266 @@
+ /*
+ * @file stream_sink.h
+ * @brief Output sinks for downstream consumers: a shared-memory ring for
+ * local processes and a batched UDP sender for other machines.
+ *
+ * The neurofeedback side consumes band powers, PSD frames and optionally
+ * raw samples in real time, in another process or on another host. Every
+ * message is one stream_header followed by float values:
+ *
+ * - STREAM_BAND_POWER: num_channels * num_bands powers in V^2, channel 0's
+ *   bands first (see dsp_psd_band_powers())
+ * - STREAM_PSD: one PSD frame, num_channels * num_bins densities in V^2/Hz
+ * - STREAM_RAW: interleaved frames in volts, num_values / num_channels of them
+ *
+ * Each kind has its own sequence number, incremented for every message
+ * published, also for those dropped because a sink was full. A consumer
+ * sees a drop as a jump in seq, no acknowledgements or handshakes. Fields
+ * and values are in host byte order (little endian on every supported
+ * platform, arm64 and x86-64).
+ *
+ * Shared memory (stream_shm): a POSIX shm object holding an SPSC ring of
+ * fixed-size slots; the producer builds a message in place in the slot
+ * (reserve/commit) and the consumer reads it in place (peek/release), so
+ * the values are never copied through a socket or pipe. The producer never
+ * waits: with the ring full the message is dropped. The ring is indexed by
+ * offsets, not pointers (the two processes map it at different addresses),
+ * so it is its own small ring rather than a spsc_ring_buffer.
+ *
+ * UDP (stream_udp): messages are cut into datagrams of at most
+ * STREAM_UDP_DATAGRAM_BYTES (no IP fragmentation on Ethernet), each with
+ * the message's header, first_value and count giving its part. Datagrams
+ * are queued and sent in batches, sendmmsg() on Linux (one system call per
+ * batch), send() per datagram on the connected socket elsewhere (macOS has
+ * no public sendmmsg()).
+ * The socket is non-blocking: a datagram the kernel does not take is
+ * counted as dropped.
+ *
+ * A sink belongs to one producing thread; use one per stage that publishes.
+ *
+ * Usage:
+ * - producer: `stream_shm_create()` and/or `stream_udp_open()`, bundled in
+ *   a `stream_sinks` for `stream_sinks_publish()`, or `stream_shm_reserve()` /
+ *   `stream_shm_commit()` to fill a slot in place
+ * - `stream_udp_flush()` once per step, sends what is queued
+ * - local consumer: `stream_shm_open()`, `stream_shm_peek()` / `stream_shm_release()`
+ * - network consumer: `stream_decode()` on every datagram received
+ * - `stream_shm_close()` / `stream_udp_close()`
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef STREAM_SINK_H
+#define STREAM_SINK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "spsc_ring_buffer.h" // RB_CACHE_LINE_SIZE
+
+#define STREAM_MAGIC 0x53474545u       // "EEGS"
+#define STREAM_VERSION 1
+#define STREAM_SHM_NAME_LEN 64
+#define STREAM_UDP_DATAGRAM_BYTES 1472 // 1500 byte Ethernet MTU - IPv4 - UDP headers
+#define STREAM_UDP_MAX_BATCH 64        // datagrams per sendmmsg()
+
+typedef enum {
+   STREAM_BAND_POWER = 0,
+   STREAM_PSD,
+   STREAM_RAW,
+   STREAM_NUM_KINDS
+} stream_kind;
+
+// precedes the values of every message, in a slot or a datagram
+typedef struct {
+   uint32_t magic;           // STREAM_MAGIC
+   uint8_t version;          // STREAM_VERSION
+   uint8_t kind;             // stream_kind
+   uint16_t num_channels;
+   uint32_t seq;             // per kind, +1 per message published (dropped ones too)
+   uint32_t num_values;      // values of the whole message
+   uint32_t first_value;     // first value in this datagram, 0 in shared memory
+   uint32_t count;           // values following this header
+   uint64_t time_ns;         // publication time, pipeline_now_ns()
+} stream_header;
+
+#define STREAM_UDP_MAX_VALUES ((STREAM_UDP_DATAGRAM_BYTES - sizeof(stream_header)) / sizeof(float))
+
+// the shared object: this control block, then num_slots slots of slot_bytes
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t num_slots;       // power of two
+   uint32_t slot_values;     // largest message in values
+   uint32_t slot_bytes;      // stream_header + slot_values floats, cache line multiple
+   uint32_t seq[STREAM_NUM_KINDS]; // next seq of each kind (producer)
+   _Alignas(RB_CACHE_LINE_SIZE) _Atomic uint64_t head; // messages committed (producer)
+   _Alignas(RB_CACHE_LINE_SIZE) _Atomic uint64_t tail; // messages released (consumer)
+   _Alignas(RB_CACHE_LINE_SIZE) uint8_t slots[];
+} stream_shm_region;
+
+typedef struct {
+   char name[STREAM_SHM_NAME_LEN];
+   stream_shm_region *region;
+   size_t bytes;             // mapped
+   bool owner;               // created it: unlinks the name on close
+   bool reserved;            // a slot is being filled (producer)
+   uint64_t published;       // messages committed (producer)
+   uint64_t dropped;         // messages dropped, ring full (producer)
+} stream_shm;
+
+typedef struct {
+   int fd;
+   int queued;               // datagrams waiting for stream_udp_flush()
+   uint8_t *buffers;         // STREAM_UDP_MAX_BATCH datagrams
+   size_t lengths[STREAM_UDP_MAX_BATCH];
+   uint32_t seq[STREAM_NUM_KINDS];
+   uint64_t datagrams_sent;
+   uint64_t datagrams_dropped; // not taken by the kernel
+   uint64_t send_calls;        // system calls, batching = datagrams_sent / send_calls
+} stream_udp;
+
+// the sinks one producing thread publishes to, either may be NULL
+typedef struct {
+   stream_shm *shm;
+   stream_udp *udp;
+} stream_sinks;
+
+/**
+ * @brief Create (or replace) a shared-memory ring, as its producer.
+ *
+ * @param s Pointer to the sink.
+ * @param name POSIX shm name, "/eeg" style, shorter than STREAM_SHM_NAME_LEN.
+ * @param num_slots Messages the ring holds, rounded up to a power of two.
+ * @param slot_values Largest message in values.
+ * @return true on success, false on invalid arguments or if the object could not be created.
+ */
+bool stream_shm_create(stream_shm *s, const char *name, int num_slots, int slot_values);
+
+/**
+ * @brief Map an existing shared-memory ring, as its consumer.
+ *
+ * @param s Pointer to the sink.
+ * @param name Name given to stream_shm_create().
+ * @return true on success, false if there is no such ring or it is not one.
+ */
+bool stream_shm_open(stream_shm *s, const char *name);
+
+/**
+ * @brief Start a message in the next free slot (producer). Takes the
+ * kind's next sequence number even if the message is dropped.
+ *
+ * @param s Pointer to the sink.
+ * @param kind Message kind.
+ * @param num_channels Channels of the message.
+ * @param num_values Values of the message, at most slot_values.
+ * @param time_ns Publication time.
+ * @return num_values floats to fill in place, NULL if the ring is full or
+ * num_values is too large (the message is dropped).
+ */
+float *stream_shm_reserve(stream_shm *s, stream_kind kind, int num_channels, int num_values,
+                          uint64_t time_ns);
+
+/**
+ * @brief Make the reserved message visible to the consumer.
+ *
+ * @param s Pointer to the sink.
+ * @return void
+ */
+void stream_shm_commit(stream_shm *s);
+
+/**
+ * @brief Oldest message not released yet (consumer), read in place.
+ *
+ * @param s Pointer to the sink.
+ * @param values Set to the message's values.
+ * @return its header, NULL if the ring is empty.
+ */
+const stream_header *stream_shm_peek(stream_shm *s, const float **values);
+
+/**
+ * @brief Hand the slot returned by stream_shm_peek() back to the producer.
+ *
+ * @param s Pointer to the sink.
+ * @return void
+ */
+void stream_shm_release(stream_shm *s);
+
+/**
+ * @brief Unmap the ring; the producer also removes its name.
+ *
+ * @param s Pointer to the sink.
+ * @return void
+ */
+void stream_shm_close(stream_shm *s);
+
+/**
+ * @brief Open a non-blocking UDP socket sending to host:port.
+ *
+ * @param u Pointer to the sink.
+ * @param host IPv4 address or host name.
+ * @param port Destination port.
+ * @return true on success, false if the address does not resolve or the socket fails.
+ */
+bool stream_udp_open(stream_udp *u, const char *host, int port);
+
+/**
+ * @brief Queue one message as one or more datagrams, flushing whenever the
+ * batch is full.
+ *
+ * @param u Pointer to the sink.
+ * @param kind Message kind.
+ * @param num_channels Channels of the message.
+ * @param values Values of the message.
+ * @param num_values Number of values.
+ * @param time_ns Publication time.
+ * @return void
+ */
+void stream_udp_send(stream_udp *u, stream_kind kind, int num_channels, const float *values,
+                     int num_values, uint64_t time_ns);
+
+/**
+ * @brief Send the queued datagrams, one batch.
+ *
+ * @param u Pointer to the sink.
+ * @return datagrams the kernel took.
+ */
+int stream_udp_flush(stream_udp *u);
+
+/**
+ * @brief Flush and close the socket.
+ *
+ * @param u Pointer to the sink.
+ * @return void
+ */
+void stream_udp_close(stream_udp *u);
+
+/**
+ * @brief Check a received datagram and locate its values.
+ *
+ * @param buf Datagram.
+ * @param len Its length in bytes.
+ * @param header Set to the header.
+ * @param values Set to header->count values inside buf (unaligned, copy before use).
+ * @return true for a well-formed datagram of this version, false otherwise.
+ */
+bool stream_decode(const uint8_t *buf, size_t len, stream_header *header, const uint8_t **values);
+
+/**
+ * @brief Publish one message to every sink in the set (a copy into the shm
+ * slot, datagrams queued for UDP). Call stream_udp_flush() after the step.
+ *
+ * @param sinks Sinks of the calling thread.
+ * @param kind Message kind.
+ * @param num_channels Channels of the message.
+ * @param values Values of the message.
+ * @param num_values Number of values.
+ * @param time_ns Publication time.
+ * @return void
+ */
+void stream_sinks_publish(const stream_sinks *sinks, stream_kind kind, int num_channels,
+                          const float *values, int num_values, uint64_t time_ns);
+
+#endif
@@ -0,0 +1,210 @@
+ /*
+ * @file telemetry.h
+ * @brief Asynchronous, rate-limited diagnostics for the real-time threads.
+ *
+ * Real-time threads must not call printf(): stdio takes a lock and the
+ * terminal can be far slower than the sample stream. Instead every
+ * producing thread gets a telemetry_channel, a lock-free single-producer
+ * queue of fixed-size records. Pushing a record is a few stores and never
+ * blocks; when the queue is full the record is dropped and counted.
+ *
+ * One low-priority telemetry thread drains all channels, aggregates them
+ * and prints one summary line per channel and interval:
+ *
+ *   [telemetry] serial: 1000.0 samples/s, V min 0.00 max 4.99 mean 2.50,
+ *               packets lost 0, crc errors 0, overflow 0, dropped 0, filled 0
+ *
+ * Counters are per interval, dropped too: telemetry records lost since the
+ * previous summary.
+ *
+ * Log messages are printed as they arrive, at most
+ * TELEMETRY_MAX_LOGS_PER_INTERVAL per interval; the rest are counted as
+ * suppressed.
+ *
+ * Usage:
+ * - `telemetry_init()`, then `telemetry_channel_open()` for every producer thread
+ * - `telemetry_start()` starts the telemetry thread
+ * - Producers: `telemetry_samples()`, `telemetry_count()`, `telemetry_log()`
+ * - `telemetry_stop()` prints what is left and joins the thread
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "spsc_ring_buffer.h" // RB_CACHE_LINE_SIZE
+
+#define TELEMETRY_QUEUE_SIZE 256    // records per channel, power of two
+#define TELEMETRY_MAX_CHANNELS 8
+#define TELEMETRY_MESSAGE_LEN 96
+#define TELEMETRY_NAME_LEN 16
+#define TELEMETRY_MAX_LOGS_PER_INTERVAL 10
+
+// drop/error counters a producer can report
+typedef enum {
+   TELEMETRY_PACKETS_LOST = 0,
+   TELEMETRY_CRC_ERRORS,
+   TELEMETRY_OVERFLOW,        // frames the ring buffer rejected or overwrote
+   TELEMETRY_FRAMES_FILLED,   // frames interpolated over sequence gaps
+   TELEMETRY_NUM_COUNTERS
+} telemetry_counter;
+
+typedef enum {
+   TELEMETRY_RECORD_SAMPLES = 0,
+   TELEMETRY_RECORD_COUNTER,
+   TELEMETRY_RECORD_MESSAGE
+} telemetry_record_kind;
+
+typedef struct {
+   telemetry_record_kind kind;
+   telemetry_counter counter;  // TELEMETRY_RECORD_COUNTER
+   uint32_t count;             // samples in the block, or counter increment
+   float min, max;             // TELEMETRY_RECORD_SAMPLES
+   double sum;
+   char text[TELEMETRY_MESSAGE_LEN]; // TELEMETRY_RECORD_MESSAGE
+} telemetry_record;
+
+// aggregate of one channel over one interval, owned by the telemetry thread
+typedef struct {
+   uint64_t samples;
+   float min, max;
+   double sum;
+   uint64_t counters[TELEMETRY_NUM_COUNTERS];
+} telemetry_window;
+
+typedef struct {
+   // consumer (telemetry thread)
+   atomic_uint head;
+   char pad_head[RB_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+   // producer
+   atomic_uint tail;
+   _Atomic uint64_t dropped;   // records lost because the queue was full
+   char pad_tail[RB_CACHE_LINE_SIZE - sizeof(atomic_uint) - sizeof(uint64_t)];
+   telemetry_record records[TELEMETRY_QUEUE_SIZE];
+   char name[TELEMETRY_NAME_LEN];
+   telemetry_window window;
+   uint64_t reported_dropped;  // dropped as of the last summary
+} telemetry_channel;
+
+typedef struct {
+   telemetry_channel *channels[TELEMETRY_MAX_CHANNELS];
+   int num_channels;
+   FILE *out;
+   int interval_ms;
+   pthread_t thread;
+   bool running;
+   atomic_bool stop;
+   uint64_t window_start_ns;   // start of the current summary interval
+   // rate limit of log lines, telemetry thread only
+   int logs_this_interval;
+   uint64_t logs_suppressed;
+} telemetry;
+
+/**
+ * @brief Initialize telemetry without starting the thread.
+ *
+ * @param t Pointer to the telemetry instance.
+ * @param out Where summaries and messages go (e.g. stderr).
+ * @param interval_ms Time between summaries.
+ * @return true on success, false if an argument is invalid.
+ */
+bool telemetry_init(telemetry *t, FILE *out, int interval_ms);
+
+/**
+ * @brief Create the queue for one producer thread (call before telemetry_start()).
+ *
+ * @param t Pointer to the telemetry instance.
+ * @param name Shown in the summaries, truncated to TELEMETRY_NAME_LEN - 1.
+ * @return the channel, NULL if TELEMETRY_MAX_CHANNELS are open or allocation failed.
+ */
+telemetry_channel *telemetry_channel_open(telemetry *t, const char *name);
+
+/**
+ * @brief Start the low-priority telemetry thread.
+ *
+ * @param t Pointer to the telemetry instance.
+ * @return true on success.
+ */
+bool telemetry_start(telemetry *t);
+
+/**
+ * @brief Stop the thread, print the remaining records and a final summary,
+ * and free the channels.
+ *
+ * @param t Pointer to the telemetry instance.
+ * @return void
+ */
+void telemetry_stop(telemetry *t);
+
+/**
+ * @brief Report a block of sample values (producer thread of ch only).
+ *
+ * Only min, max, sum and count of the block are queued.
+ *
+ * @param ch Telemetry channel, NULL is allowed and ignored.
+ * @param values Sample values.
+ * @param n Number of values.
+ * @return void
+ */
+void telemetry_samples(telemetry_channel *ch, const float *values, int n);
+
+/**
+ * @brief telemetry_samples() for raw integer codes (producer thread of ch only):
+ * min, max and sum are taken over the codes, only those three are scaled.
+ *
+ * @param ch Telemetry channel, NULL is allowed and ignored.
+ * @param codes Sample codes.
+ * @param n Number of codes.
+ * @param scale Value of one code (e.g. volts per ADC step).
+ * @return void
+ */
+void telemetry_codes(telemetry_channel *ch, const int16_t *codes, int n, float scale);
+
+/**
+ * @brief Add to one of the drop/error counters (producer thread of ch only).
+ *
+ * @param ch Telemetry channel, NULL is allowed and ignored.
+ * @param counter Which counter.
+ * @param n Increment.
+ * @return void
+ */
+void telemetry_count(telemetry_channel *ch, telemetry_counter counter, uint64_t n);
+
+/**
+ * @brief Queue a message (producer thread of ch only). Formatting happens
+ * on the calling thread, so keep it for rare events.
+ *
+ * @param ch Telemetry channel, NULL is allowed and ignored.
+ * @param fmt printf-style format.
+ * @return void
+ */
+void telemetry_log(telemetry_channel *ch, const char *fmt, ...)
+   __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Records dropped because the channel's queue was full.
+ *
+ * @param ch Telemetry channel.
+ * @return number of dropped records.
+ */
+uint64_t telemetry_dropped(telemetry_channel *ch);
+
+/**
+ * @brief Drain all channels and print due summaries once. Used by the
+ * telemetry thread; callable directly when the thread is not running.
+ *
+ * @param t Pointer to the telemetry instance.
+ * @param force_summary Print the summaries even if the interval is not over.
+ * @return void
+ */
+void telemetry_poll(telemetry *t, bool force_summary);
+
+#endif
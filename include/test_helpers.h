@@ -3,6 +3,8 @@
  * @brief define macro for testing or using the ring_buffer_destroy() function
  *
  * This macro should be used whenever ring_buffer_destroy() is called
+ * (SPSC_SAFE_DESTROY for spsc_ring_buffer_destroy(), MC_SAFE_DESTROY for
+ * mc_ring_buffer_destroy())
  *
  * Author: Catherine Bernaciak PhD 
  * Date: March 2025 
@@ -24,4 +26,20 @@
        } \
    } while (0)
 
+#define SPSC_SAFE_DESTROY(rb_ptr)    \
+   do {                         \
+       if ((rb_ptr) != NULL){   \
+           spsc_ring_buffer_destroy(rb_ptr); \
+           rb_ptr = NULL;       \
+       } \
+   } while (0)
+
+#define MC_SAFE_DESTROY(rb_ptr)    \
+   do {                         \
+       if ((rb_ptr) != NULL){   \
+           mc_ring_buffer_destroy(rb_ptr); \
+           rb_ptr = NULL;       \
+       } \
+   } while (0)
+
 #endif
@@ -1 +1,305 @@
-// Visualization function prototypes
+ /*
+ * @file visualization.h
+ * @brief Lock-free hand-off from the DSP thread to the renderer: a
+ * triple-buffered snapshot of the waveform and spectrogram history, and the
+ * Metal renderer that draws it (macOS, built with `make METAL=1`).
+ *
+ * The producer (the spectral stage, which sees the filtered samples and
+ * makes the PSD frames) pushes samples and PSD frames into its own history
+ * rings and publishes every step. Publishing brings the back snapshot up to
+ * date and swaps it with the middle one in one atomic exchange; the
+ * renderer swaps the middle one with its front snapshot when a newer one is
+ * there. Neither side waits for the other and the renderer never sees a
+ * snapshot that is being written. A renderer slower than the DSP skips
+ * snapshots, never data: every snapshot holds whole history rings.
+ *
+ * All rings have power-of-two capacities and index by absolute position: a
+ * sample pushed as frame i is at i & (wave_capacity - 1) in every snapshot
+ * and in the renderer's GPU buffer, so bringing anything up to date is
+ * copying the positions it has not seen yet (viz_ring_delta()), at most two
+ * memcpy per channel, never a whole history. Capacities are twice the drawn
+ * windows so that the positions written for the next frame are never the
+ * ones the GPU still draws from the frame before.
+ *
+ * Snapshot layout, planar per channel:
+ *
+ *   wave[ch * wave_capacity + (frame & (wave_capacity - 1))]          volts
+ *   psd[(ch * psd_capacity + (row & (psd_capacity - 1))) * num_bins + k] V^2/Hz
+ *   lod[l][(ch * lod_capacity[l] + (b & (lod_capacity[l] - 1))) * 2]  min, max
+ *
+ * Long histories are drawn from a min/max pyramid: level l holds one (min,
+ * max) pair per VIZ_LOD_FACTOR^(l + 1) frames, bucket b covering frames
+ * [b * size, (b + 1) * size). The pyramid is updated as samples are pushed
+ * (a bucket is written when it completes and folded into the next level),
+ * the open bucket of every level is written at position lod_end[l] on
+ * publish so the newest samples are drawn at every zoom. viz_lod_level()
+ * picks the coarsest level with at least one bucket per pixel: a window of
+ * any length costs between pixels and VIZ_LOD_FACTOR * pixels buckets, and
+ * a one-sample spike still widens its bucket's min/max at every level.
+ *
+ * The Metal renderer keeps both in persistent objects: the waveform in one
+ * shared MTLBuffer, the spectrogram in a 2D texture array (one
+ * slice per channel, one texel row per PSD frame). A frame uploads only the
+ * new samples and rows; the shaders read the rings starting at the oldest
+ * drawn position, so the spectrogram scrolls by moving that offset (repeat
+ * addressing wraps it) and a 60/120 Hz redraw copies no history on the CPU.
+ *
+ * Usage:
+ * - `viz_state_init()` once with the layout of the pipeline
+ * - Producer thread: `viz_push_wave()`, `viz_push_psd()`, then `viz_publish()`
+ *   (or `spectral_stage_set_viz()` to have the spectral stage do it)
+ * - Renderer thread: `viz_acquire()` and `viz_ring_delta()` for what is new,
+ *   `viz_lod_level()` and `viz_lod_window()` for the buckets of a zoom
+ * - macOS: `viz_metal_create()` with a CAMetalLayer, `viz_metal_start()` for
+ *   a render thread or `viz_metal_draw()` from the host's display callback
+ * - `viz_state_destroy()` after both threads stopped
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef VISUALIZATION_H
+#define VISUALIZATION_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define VIZ_NUM_SNAPSHOTS 3
+#define VIZ_FRESH 4u   // flag next to the middle snapshot's index: not acquired yet
+#define VIZ_LOD_FACTOR 4         // frames per level 0 bucket, buckets per bucket of the next level
+#define VIZ_LOD_MAX_LEVELS 10
+#define VIZ_LOD_TOP_BUCKETS 256  // no coarser level once one holds the history in this many
+
+// one published view of the history, written only while it is the back snapshot
+typedef struct {
+   float *wave;            // num_channels * wave_capacity, see layout above
+   float *psd;             // num_channels * psd_capacity * num_bins
+   uint64_t wave_end;      // frames pushed before this snapshot
+   uint64_t psd_end;       // PSD frames pushed before this snapshot
+   float *lod[VIZ_LOD_MAX_LEVELS];        // num_channels * lod_capacity[l] * 2
+   uint64_t lod_end[VIZ_LOD_MAX_LEVELS];  // complete buckets, the open one follows
+   uint64_t sequence;      // publish count, 1 for the first
+   uint64_t published_ns;  // CLOCK_MONOTONIC at publish
+} viz_snapshot;
+
+typedef struct {
+   int num_channels;
+   int num_bins;
+   int wave_frames;        // drawn waveform window
+   int psd_rows;           // drawn spectrogram history
+   int wave_capacity;      // power of two >= 2 * wave_frames
+   int psd_capacity;       // power of two >= 2 * psd_rows
+   int history_frames;     // longest window drawn from the pyramid
+   int lod_levels;         // 0 without a pyramid
+   int lod_capacity[VIZ_LOD_MAX_LEVELS]; // power of two >= 2 * (history buckets + 1)
+   float sample_rate;
+   float bin_hz;
+
+   // producer's history, the snapshots are brought up to date from these
+   float *wave;
+   float *psd;
+   uint64_t wave_end;
+   uint64_t psd_end;
+   float *lod[VIZ_LOD_MAX_LEVELS];
+   uint64_t lod_end[VIZ_LOD_MAX_LEVELS];
+   float *lod_open;        // [level][channel] (min, max) of the open buckets
+   int lod_fill[VIZ_LOD_MAX_LEVELS];     // inputs folded into the open bucket
+   uint64_t sequence;
+
+   viz_snapshot snapshots[VIZ_NUM_SNAPSHOTS];
+   unsigned int back;      // producer's
+   atomic_uint middle;     // index | VIZ_FRESH
+   unsigned int front;     // renderer's
+} viz_state;
+
+// contiguous ring positions [first, first + count) holding absolute positions from start
+typedef struct {
+   int first;
+   int count;
+   uint64_t start;
+} viz_range;
+
+// buckets of one level drawn for a window ending at the snapshot's newest frame
+typedef struct {
+   int level;
+   int bucket_frames;      // frames per bucket
+   uint64_t first;         // first bucket position, ring index first & (lod_capacity - 1)
+   int count;              // buckets, the last one may be open
+} viz_lod_span;
+
+/**
+ * @brief Initialize the shared state, allocating the history and the
+ * snapshots.
+ *
+ * @param v Pointer to the state.
+ * @param num_channels Channels per sample frame.
+ * @param num_bins Bins per channel and PSD frame (fft_size/2 + 1).
+ * @param wave_frames Waveform frames drawn, at least 2.
+ * @param psd_rows PSD frames drawn in the spectrogram, at least 1.
+ * @param history_frames Longest window drawn from the min/max pyramid,
+ *        0 = no pyramid.
+ * @param sample_rate Sample rate in Hz, for the axes.
+ * @param bin_hz Width of one PSD bin in Hz, for the axes.
+ * @return true on success, false if an argument is invalid or allocation failed.
+ */
+bool viz_state_init(viz_state *v, int num_channels, int num_bins, int wave_frames, int psd_rows,
+                    int history_frames, float sample_rate, float bin_hz);
+
+/**
+ * @brief Append samples to the waveform history (producer thread).
+ *
+ * @param v Pointer to the state.
+ * @param planar num_channels pointers to n samples each.
+ * @param n Frames.
+ * @return void
+ */
+void viz_push_wave(viz_state *v, float *const *planar, int n);
+
+/**
+ * @brief Append one PSD frame to the spectrogram history (producer thread).
+ *
+ * @param v Pointer to the state.
+ * @param psd num_channels * num_bins values, psd[ch * num_bins + k].
+ * @return void
+ */
+void viz_push_psd(viz_state *v, const float *psd);
+
+/**
+ * @brief Publish what was pushed so far (producer thread). Copies only what
+ * the back snapshot has not seen, then swaps it in without waiting.
+ *
+ * @param v Pointer to the state.
+ * @return void
+ */
+void viz_publish(viz_state *v);
+
+/**
+ * @brief The newest published snapshot (renderer thread). It stays valid
+ * and unchanged until the next viz_acquire().
+ *
+ * @param v Pointer to the state.
+ * @return the snapshot, sequence 0 before the first publish.
+ */
+const viz_snapshot *viz_acquire(viz_state *v);
+
+/**
+ * @brief Ring ranges holding the positions [seen, end) that are still in a
+ * ring of the given capacity, at most the last capacity ones.
+ *
+ * @param seen Positions already copied, e.g. last frame's wave_end.
+ * @param end Positions available, e.g. the snapshot's wave_end.
+ * @param capacity Ring capacity, a power of two.
+ * @param ranges Up to two ranges, in position order.
+ * @return the number of ranges, 0 if there is nothing new.
+ */
+int viz_ring_delta(uint64_t seen, uint64_t end, int capacity, viz_range ranges[2]);
+
+/**
+ * @brief Pyramid level for a zoom: the coarsest whose buckets are no
+ * longer than span_frames / pixels.
+ *
+ * @param v Pointer to the state.
+ * @param span_frames Frames across the plot.
+ * @param pixels Plot width in pixels.
+ * @return the level, -1 for raw samples (less than VIZ_LOD_FACTOR frames per
+ * pixel and the span fits wave_frames).
+ */
+int viz_lod_level(const viz_state *v, uint64_t span_frames, int pixels);
+
+/**
+ * @brief Buckets of a level covering the last span_frames of a snapshot
+ * (at most history_frames and what the ring still holds).
+ *
+ * @param v Pointer to the state.
+ * @param s Snapshot from viz_acquire().
+ * @param level Pyramid level, 0..lod_levels - 1.
+ * @param span_frames Frames across the plot.
+ * @param out The buckets.
+ * @return true on success, false if the level does not exist.
+ */
+bool viz_lod_window(const viz_state *v, const viz_snapshot *s, int level, uint64_t span_frames,
+                    viz_lod_span *out);
+
+/**
+ * @brief Latest PSD frame of one channel in a snapshot.
+ *
+ * @param v Pointer to the state.
+ * @param s Snapshot from viz_acquire().
+ * @param channel Channel index.
+ * @return num_bins values, NULL if no PSD frame was published yet.
+ */
+const float *viz_latest_psd(const viz_state *v, const viz_snapshot *s, int channel);
+
+/**
+ * @brief Free the history and the snapshots.
+ *
+ * @param v Pointer to the state.
+ * @return void
+ */
+void viz_state_destroy(viz_state *v);
+
+#if defined(__APPLE__) && defined(EEG_METAL)
+
+typedef struct viz_metal viz_metal;
+
+/**
+ * @brief Create the Metal renderer: pipelines, the waveform MTLBuffer and
+ * the spectrogram texture, sized from the state.
+ *
+ * @param v Shared state, outlives the renderer.
+ * @param layer The CAMetalLayer to draw into (owned by the host's window).
+ * @return the renderer, NULL if there is no Metal device or setup failed.
+ */
+viz_metal *viz_metal_create(viz_state *v, void *layer);
+
+/**
+ * @brief Upload what is new in the latest snapshot and draw one frame.
+ * Called from one thread only (the render thread if it runs).
+ *
+ * @param m Pointer to the renderer.
+ * @return true if a frame was submitted, false if no drawable was available.
+ */
+bool viz_metal_draw(viz_metal *m);
+
+/**
+ * @brief Set the time span across the waveform plot (any thread). Raw
+ * samples are drawn while they fit and are dense enough, the pyramid level
+ * matching span_frames / drawable width otherwise.
+ *
+ * @param m Pointer to the renderer.
+ * @param span_frames Frames across the plot, up to history_frames.
+ * @return void
+ */
+void viz_metal_set_span(viz_metal *m, uint64_t span_frames);
+
+/**
+ * @brief Start a render thread drawing fps frames per second (60 or 120 for
+ * ProMotion displays) at user-interactive QoS.
+ *
+ * @param m Pointer to the renderer.
+ * @param fps Frames per second.
+ * @return true on success, false if it runs already or cannot start.
+ */
+bool viz_metal_start(viz_metal *m, int fps);
+
+/**
+ * @brief Stop and join the render thread.
+ *
+ * @param m Pointer to the renderer.
+ * @return void
+ */
+void viz_metal_stop(viz_metal *m);
+
+/**
+ * @brief Wait for the GPU and free the renderer (stops its thread first).
+ *
+ * @param m Pointer to the renderer.
+ * @return void
+ */
+void viz_metal_destroy(viz_metal *m);
+
+#endif
+
+#endif
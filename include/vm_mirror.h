@@ -0,0 +1,61 @@
+ /*
+ * @file vm_mirror.h
+ * @brief Virtual memory mirroring for ring buffer storage.
+ *
+ * Maps the same physical pages twice, back-to-back, so that byte i and
+ * byte i + size of the mapping refer to the same memory. A ring buffer
+ * stored in such a mapping can hand out any window of up to its capacity
+ * as one contiguous pointer, even when the window wraps around the end.
+ *
+ * Platform notes:
+ * - macOS: vm_allocate() reserves 2*size, the upper half is replaced by a
+ *   vm_remap() of the lower half.
+ * - Linux: a memfd_create() file of size bytes is mmap()ed twice into a
+ *   2*size PROT_NONE reservation.
+ *
+ * Sizes must be a multiple of vm_mirror_page_size().
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef VM_MIRROR_H
+#define VM_MIRROR_H
+
+#include <stddef.h>
+
+/**
+ * @brief System page size in bytes (16 KB on Apple silicon, usually 4 KB on Linux).
+ *
+ * @return page size in bytes.
+ */
+size_t vm_mirror_page_size(void);
+
+/**
+ * @brief Round a byte count up to a multiple of the page size.
+ *
+ * @param bytes Number of bytes wanted.
+ * @return bytes rounded up to the next page multiple.
+ */
+size_t vm_mirror_round_up(size_t bytes);
+
+/**
+ * @brief Allocate a mirrored mapping.
+ *
+ * @param size Size of one copy in bytes, must be a page multiple.
+ * @return base address of a 2*size region whose halves alias each other,
+ *         or NULL on failure.
+ */
+void *vm_mirror_alloc(size_t size);
+
+/**
+ * @brief Release a mapping from vm_mirror_alloc().
+ *
+ * @param base Address returned by vm_mirror_alloc().
+ * @param size The size passed to vm_mirror_alloc().
+ * @return void
+ */
+void vm_mirror_free(void *base, size_t size);
+
+#endif
@@ -0,0 +1,92 @@
+ /*
+ * @file work_pool.h
+ * @brief Fork-join worker pool: run count independent tasks in parallel and
+ * return when all of them are done.
+ *
+ * work_pool_apply() is a parallel for loop: task i is fn(ctx, i), the tasks
+ * run on the pool's threads and on the calling thread, in any order.
+ *
+ * - macOS: dispatch_apply_f() with DISPATCH_APPLY_AUTO, so GCD sizes the
+ *   width to the free cores and runs the tasks at the caller's QoS (the
+ *   spectral stage's utility class may use E-cores); no threads are owned.
+ * - Elsewhere: num_threads pthreads wait on a condition variable for the
+ *   next job. Tasks are claimed from one atomic counter, so a thread that
+ *   finishes early takes the next unclaimed task (self-scheduling) and a
+ *   slow core never holds tasks another one could run.
+ *
+ * A job allocates nothing. Submitting is one lock/broadcast, so tasks
+ * should be at least a few microseconds of work (e.g. a group of channels,
+ * not one sample).
+ *
+ * Usage:
+ * - `work_pool_init()` once
+ * - `work_pool_apply()` from one thread at a time
+ * - `work_pool_destroy()` stops and joins the threads
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+// include guard
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WORK_POOL_MAX_THREADS 64
+
+// task i of a job
+typedef void (*work_pool_fn)(void *ctx, int index);
+
+typedef struct {
+   int num_threads;         // workers besides the calling thread, 0 = run inline
+#if !defined(__APPLE__)
+   pthread_t threads[WORK_POOL_MAX_THREADS];
+   pthread_mutex_t lock;
+   pthread_cond_t start;    // workers wait for the next job
+   pthread_cond_t done;     // the caller waits for the workers to leave the job
+   uint64_t generation;     // jobs submitted, under lock
+   int active;              // workers inside the current job, under lock
+   bool stop;
+   // current job, written under lock while no worker is active
+   work_pool_fn fn;
+   void *ctx;
+   int count;
+   atomic_int next;         // next unclaimed task
+#endif
+} work_pool;
+
+/**
+ * @brief Initialize a pool.
+ *
+ * @param p Pointer to the pool.
+ * @param num_threads Worker threads besides the caller, -1 = one per online
+ *        CPU minus one, clamped to WORK_POOL_MAX_THREADS. Ignored on macOS
+ *        (GCD picks the width).
+ * @return true on success, false if a thread cannot be created.
+ */
+bool work_pool_init(work_pool *p, int num_threads);
+
+/**
+ * @brief Run fn(ctx, i) for i in [0, count) and wait for all of them.
+ *
+ * @param p Pointer to the pool, NULL = run the tasks on the calling thread.
+ * @param count Number of tasks.
+ * @param fn Task function, must be safe to run concurrently for different i.
+ * @param ctx Passed to fn.
+ * @return void
+ */
+void work_pool_apply(work_pool *p, int count, work_pool_fn fn, void *ctx);
+
+/**
+ * @brief Stop and join the worker threads.
+ *
+ * @param p Pointer to the pool.
+ * @return void
+ */
+void work_pool_destroy(work_pool *p);
+
+#endif
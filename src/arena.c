@@ -0,0 +1,82 @@
+/**
+ * arena.c
+ *
+ * Implementation of the startup-time arena.
+ *
+ * Notes:
+ * - The region is an anonymous private mapping, so it starts zeroed and
+ *   every allocation is zero without a memset (nothing is ever reused).
+ * - Prefaulting writes one byte per page back to itself: a read alone
+ *   would map the shared zero page and still fault on the first write.
+ * - Use with arena.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t round_up(size_t n, size_t to){
+   return (n + to - 1) / to * to;
+}
+
+bool arena_init(arena *a, size_t reserve_bytes){
+   memset(a, 0, sizeof(*a));
+   if(reserve_bytes == 0) return false;
+   long page = sysconf(_SC_PAGESIZE);
+   a->page_size = page > 0 ? (size_t)page : 4096;
+   a->reserved = round_up(reserve_bytes, a->page_size);
+   void *p = mmap(NULL, a->reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+   if(p == MAP_FAILED){
+      a->reserved = 0;
+      return false;
+   }
+   a->base = p;
+   return true;
+}
+
+void *arena_alloc(arena *a, size_t bytes){
+   if(!a) return calloc(1, bytes);
+   size_t start = round_up(a->used, ARENA_ALIGN);
+   if(a->sealed || bytes == 0 || start > a->reserved || bytes > a->reserved - start){
+      a->refused++;
+      return NULL;
+   }
+   a->used = start + bytes;
+   a->allocations++;
+   return a->base + start;
+}
+
+void arena_free(arena *a, void *p){
+   if(!a) free(p);
+}
+
+bool arena_seal(arena *a, bool lock){
+   a->sealed = true;
+   size_t bytes = round_up(a->used, a->page_size);
+   for(size_t off = 0; off < bytes; off += a->page_size){
+      volatile uint8_t *page = a->base + off;
+      *page = *page;
+   }
+   if(!lock || bytes == 0) return true;
+   a->locked = mlock(a->base, bytes) == 0;
+   return a->locked;
+}
+
+size_t arena_used(const arena *a){
+   return a->used;
+}
+
+void arena_destroy(arena *a){
+   if(!a->base) return;
+   if(a->locked) munlock(a->base, round_up(a->used, a->page_size));
+   munmap(a->base, a->reserved);
+   a->base = NULL;
+   a->reserved = 0;
+   a->used = 0;
+   a->locked = false;
+}
@@ -0,0 +1,223 @@
+/**
+ * connectivity.c
+ *
+ * Implementation of the coherence / phase-locking engine.
+ *
+ * Notes:
+ * - conn_update() first copies the analyzed band of every channel's packed
+ *   spectrum (DC in re[0], Nyquist in im[0]) into contiguous re/im rows, so
+ *   the per-pair loops run over plain arrays the compiler vectorizes.
+ * - Welch sums are kept in double: each window is added once and
+ *   subtracted once, so after hours of streaming the rounding left in a sum
+ *   is still far below the terms of one window.
+ * - A cross spectrum of exactly 0 (silent channel) has no phase; its unit
+ *   phasor counts as 0, which lowers the PLV instead of making it NaN.
+ * - Use with connectivity.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "connectivity.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool conn_init(conn_engine *e, int num_channels, int fft_size, const conn_pair *pairs, int num_pairs,
+               int first_bin, int num_bins, conn_average average, int averages, float alpha){
+   if(num_channels < 2 || fft_size < DSP_MIN_FFT_SIZE || (fft_size & (fft_size - 1)) != 0) return false;
+   int fft_bins = fft_size / 2 + 1;
+   if(num_bins == 0) num_bins = fft_bins - first_bin;
+   if(first_bin < 0 || num_bins < 1 || first_bin + num_bins > fft_bins) return false;
+   if(average == CONN_AVERAGE_WELCH){
+      if(averages < 1 || averages > DSP_MAX_AVERAGES) return false;
+   } else if(average == CONN_AVERAGE_EXPONENTIAL){
+      if(!(alpha > 0.0f && alpha <= 1.0f)) return false;
+   } else {
+      return false;
+   }
+   if(pairs){
+      if(num_pairs < 1) return false;
+      for(int p = 0; p < num_pairs; p++){
+         if(pairs[p].a < 0 || pairs[p].b < 0 || pairs[p].a >= num_channels ||
+            pairs[p].b >= num_channels || pairs[p].a == pairs[p].b){
+            return false;
+         }
+      }
+   } else {
+      num_pairs = num_channels * (num_channels - 1) / 2;
+   }
+
+   memset(e, 0, sizeof(*e));
+   e->num_channels = num_channels;
+   e->num_pairs = num_pairs;
+   e->first_bin = first_bin;
+   e->num_bins = num_bins;
+   e->fft_bins = fft_bins;
+   e->average = average;
+   e->averages = averages;
+   e->alpha = alpha;
+   e->stride = (num_channels + 4 * num_pairs) * num_bins;
+   e->pairs = malloc(sizeof(conn_pair) * num_pairs);
+   e->spectra = malloc(sizeof(float) * 2 * num_channels * num_bins);
+   e->terms = malloc(sizeof(float) * e->stride);
+   if(average == CONN_AVERAGE_WELCH){
+      e->sum = calloc(e->stride, sizeof(double));
+      e->history = malloc(sizeof(float) * (size_t)averages * e->stride);
+   } else {
+      e->mean = malloc(sizeof(float) * e->stride);
+   }
+   if(!e->pairs || !e->spectra || !e->terms ||
+      (average == CONN_AVERAGE_WELCH ? (!e->sum || !e->history) : !e->mean)){
+      conn_destroy(e);
+      return false;
+   }
+   if(pairs){
+      memcpy(e->pairs, pairs, sizeof(conn_pair) * num_pairs);
+   } else {
+      int p = 0;
+      for(int a = 0; a < num_channels; a++){
+         for(int b = a + 1; b < num_channels; b++) e->pairs[p++] = (conn_pair){ a, b };
+      }
+   }
+   conn_reset(e);
+   return true;
+}
+
+// the analyzed band of one packed spectrum as contiguous re/im rows
+static void gather_band(const conn_engine *e, const dsp_spectral *s, float *re, float *im){
+   int m = e->fft_bins - 1;
+   for(int k = 0; k < e->num_bins; k++){
+      int bin = e->first_bin + k;
+      if(bin == 0){
+         re[k] = s->re[0];
+         im[k] = 0.0f;
+      } else if(bin == m){
+         re[k] = s->im[0];
+         im[k] = 0.0f;
+      } else {
+         re[k] = s->re[bin];
+         im[k] = s->im[bin];
+      }
+   }
+}
+
+// this window's auto spectra, cross spectra and their unit phasors
+static void window_terms(conn_engine *e){
+   int nb = e->num_bins;
+   for(int ch = 0; ch < e->num_channels; ch++){
+      const float *re = e->spectra + (size_t)ch * 2 * nb;
+      const float *im = re + nb;
+      float *sxx = e->terms + (size_t)ch * nb;
+      for(int k = 0; k < nb; k++) sxx[k] = re[k] * re[k] + im[k] * im[k];
+   }
+   for(int p = 0; p < e->num_pairs; p++){
+      const float *a_re = e->spectra + (size_t)e->pairs[p].a * 2 * nb;
+      const float *a_im = a_re + nb;
+      const float *b_re = e->spectra + (size_t)e->pairs[p].b * 2 * nb;
+      const float *b_im = b_re + nb;
+      float *t = e->terms + (size_t)(e->num_channels + 4 * p) * nb;
+      for(int k = 0; k < nb; k++){
+         // X_a conj(X_b)
+         float x = a_re[k] * b_re[k] + a_im[k] * b_im[k];
+         float y = a_im[k] * b_re[k] - a_re[k] * b_im[k];
+         float mag = sqrtf(x * x + y * y);
+         float inv = mag > 0.0f ? 1.0f / mag : 0.0f;
+         t[k] = x;
+         t[nb + k] = y;
+         t[2 * nb + k] = x * inv;
+         t[3 * nb + k] = y * inv;
+      }
+   }
+}
+
+void conn_update(conn_engine *e, const dsp_spectral *engines){
+   int nb = e->num_bins;
+   for(int ch = 0; ch < e->num_channels; ch++){
+      float *re = e->spectra + (size_t)ch * 2 * nb;
+      gather_band(e, &engines[ch], re, re + nb);
+   }
+   window_terms(e);
+
+   if(e->average == CONN_AVERAGE_WELCH){
+      float *slot = e->history + (size_t)e->history_next * e->stride;
+      if(e->history_count == e->averages){
+         // the oldest window leaves the sums as the newest one enters
+         for(int i = 0; i < e->stride; i++) e->sum[i] += (double)e->terms[i] - slot[i];
+      } else {
+         for(int i = 0; i < e->stride; i++) e->sum[i] += e->terms[i];
+         e->history_count++;
+      }
+      memcpy(slot, e->terms, sizeof(float) * e->stride);
+      e->history_next = (e->history_next + 1) % e->averages;
+   } else if(e->windows == 0){
+      memcpy(e->mean, e->terms, sizeof(float) * e->stride);
+   } else {
+      float alpha = e->alpha;
+      for(int i = 0; i < e->stride; i++) e->mean[i] += alpha * (e->terms[i] - e->mean[i]);
+   }
+   e->windows++;
+}
+
+// averaged term i (Welch sums are divided by the window count)
+static double average_at(const conn_engine *e, size_t i){
+   if(e->average == CONN_AVERAGE_WELCH) return e->sum[i] / e->history_count;
+   return e->mean[i];
+}
+
+bool conn_coherence(const conn_engine *e, int pair, float *out){
+   if(e->windows == 0 || pair < 0 || pair >= e->num_pairs) return false;
+   int nb = e->num_bins;
+   size_t a = (size_t)e->pairs[pair].a * nb;
+   size_t b = (size_t)e->pairs[pair].b * nb;
+   size_t c = (size_t)(e->num_channels + 4 * pair) * nb;
+   for(int k = 0; k < nb; k++){
+      double x = average_at(e, c + k);
+      double y = average_at(e, c + nb + k);
+      double den = average_at(e, a + k) * average_at(e, b + k);
+      double coh = den > 0.0 ? (x * x + y * y) / den : 0.0;
+      out[k] = (float)(coh < 1.0 ? coh : 1.0);
+   }
+   return true;
+}
+
+bool conn_plv(const conn_engine *e, int pair, float *out){
+   if(e->windows == 0 || pair < 0 || pair >= e->num_pairs) return false;
+   int nb = e->num_bins;
+   size_t c = (size_t)(e->num_channels + 4 * pair) * nb;
+   for(int k = 0; k < nb; k++){
+      double x = average_at(e, c + 2 * nb + k);
+      double y = average_at(e, c + 3 * nb + k);
+      double plv = sqrt(x * x + y * y);
+      out[k] = (float)(plv < 1.0 ? plv : 1.0);
+   }
+   return true;
+}
+
+int conn_pair_index(const conn_engine *e, int a, int b){
+   for(int p = 0; p < e->num_pairs; p++){
+      if((e->pairs[p].a == a && e->pairs[p].b == b) || (e->pairs[p].a == b && e->pairs[p].b == a)) return p;
+   }
+   return -1;
+}
+
+void conn_reset(conn_engine *e){
+   if(e->sum) memset(e->sum, 0, sizeof(double) * e->stride);
+   e->history_next = 0;
+   e->history_count = 0;
+   e->windows = 0;
+}
+
+void conn_destroy(conn_engine *e){
+   free(e->pairs);
+   free(e->spectra);
+   free(e->terms);
+   free(e->mean);
+   free(e->sum);
+   free(e->history);
+   e->pairs = NULL;
+   e->spectra = NULL;
+   e->terms = e->mean = e->history = NULL;
+   e->sum = NULL;
+   e->num_pairs = 0;
+}
@@ -1 +1,975 @@
-// DSP functions (e.g., filters, FFT)
+/**
+ * dsp.c
+ *
+ * DSP functions: FFT, windows, the streaming PSD engine, biquad filters,
+ * decimation and the band tracker.
+ *
+ * Notes:
+ * - A real FFT of size n is computed as an n/2-point complex FFT of the
+ *   even/odd samples packed as (re, im), followed by a split step. On macOS
+ *   that is vDSP_ctoz() + vDSP_fft_zrip(), elsewhere a radix-2 FFT with
+ *   tables built in dsp_fft_setup_init().
+ * - vDSP_fft_zrip() returns 2*X, the power is scaled back by 1/4.
+ * - The band tracker's sliding DFT keeps its resonators in double precision
+ *   and damps them by DSP_SDFT_DAMPING per sample, so rounding errors decay
+ *   instead of accumulating over hours of streaming.
+ * - A spectral bank runs DSP_BANK_TASK_CHANNELS channels per task so that
+ *   a 64-channel hop is 16 tasks of several FFTs each: enough to balance
+ *   the cores, few enough that submitting them costs little next to them.
+ *   The peeks and releases stay on the calling thread (the rings' consumer).
+ * - All buffers are allocated in the init functions; the process functions
+ *   only touch preallocated memory.
+ * - Use with dsp.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "dsp.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__ARM_NEON) && !defined(__APPLE__)
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static bool is_pow2(int n){
+   return n > 0 && (n & (n - 1)) == 0;
+}
+
+static int log2_int(int n){
+   int l = 0;
+   while((1 << l) < n) l++;
+   return l;
+}
+
+/****************************** FFT ******************************/
+
+bool dsp_fft_setup_init(dsp_fft_setup *f, int n){
+   return dsp_fft_setup_init_arena(f, n, NULL);
+}
+
+#if defined(__APPLE__)
+
+bool dsp_fft_setup_init_arena(dsp_fft_setup *f, int n, arena *a){
+   (void)a;
+   if(!is_pow2(n) || n < DSP_MIN_FFT_SIZE) return false;
+   f->n = n;
+   f->log2n = log2_int(n);
+   f->vdsp = vDSP_create_fftsetup(f->log2n, kFFTRadix2);
+   return f->vdsp != NULL;
+}
+
+void dsp_fft_setup_destroy(dsp_fft_setup *f){
+   if(f->vdsp) vDSP_destroy_fftsetup(f->vdsp);
+   f->vdsp = NULL;
+}
+
+void dsp_fft_power(const dsp_fft_setup *f, const float *in, float *re, float *im, float *power){
+   int m = f->n / 2;
+   DSPSplitComplex split = { re, im };
+   vDSP_ctoz((const DSPComplex *)in, 2, &split, 1, m);
+   vDSP_fft_zrip(f->vdsp, &split, 1, f->log2n, kFFTDirection_Forward);
+
+   // packed format: DC in re[0], Nyquist in im[0], both real
+   power[0] = 0.25f * re[0] * re[0];
+   power[m] = 0.25f * im[0] * im[0];
+   DSPSplitComplex rest = { re + 1, im + 1 };
+   vDSP_zvmags(&rest, 1, power + 1, 1, m - 1);
+   float quarter = 0.25f;
+   vDSP_vsmul(power + 1, 1, &quarter, power + 1, 1, m - 1);
+}
+
+#else
+
+bool dsp_fft_setup_init_arena(dsp_fft_setup *f, int n, arena *a){
+   if(!is_pow2(n) || n < DSP_MIN_FFT_SIZE) return false;
+   int m = n / 2;
+   f->n = n;
+   f->log2n = log2_int(n);
+   f->arena = a;
+   f->bitrev = arena_alloc(a, sizeof(int) * m);
+   f->twiddle_re = arena_alloc(a, sizeof(float) * (m / 2));
+   f->twiddle_im = arena_alloc(a, sizeof(float) * (m / 2));
+   f->split_re = arena_alloc(a, sizeof(float) * m);
+   f->split_im = arena_alloc(a, sizeof(float) * m);
+   if(!f->bitrev || !f->twiddle_re || !f->twiddle_im || !f->split_re || !f->split_im){
+      dsp_fft_setup_destroy(f);
+      return false;
+   }
+
+   int bits = f->log2n - 1;
+   for(int i = 0; i < m; i++){
+      int r = 0;
+      for(int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+      f->bitrev[i] = r;
+   }
+   for(int k = 0; k < m / 2; k++){
+      double a = -2.0 * M_PI * k / m;
+      f->twiddle_re[k] = (float)cos(a);
+      f->twiddle_im[k] = (float)sin(a);
+   }
+   for(int k = 0; k < m; k++){
+      double a = -2.0 * M_PI * k / n;
+      f->split_re[k] = (float)cos(a);
+      f->split_im[k] = (float)sin(a);
+   }
+   return true;
+}
+
+void dsp_fft_setup_destroy(dsp_fft_setup *f){
+   arena_free(f->arena, f->bitrev);
+   arena_free(f->arena, f->twiddle_re);
+   arena_free(f->arena, f->twiddle_im);
+   arena_free(f->arena, f->split_re);
+   arena_free(f->arena, f->split_im);
+   f->bitrev = NULL;
+   f->twiddle_re = f->twiddle_im = NULL;
+   f->split_re = f->split_im = NULL;
+}
+
+/**
+ * In-place radix-2 decimation-in-time FFT of m = n/2 complex points.
+ */
+static void fft_complex(const dsp_fft_setup *f, float *re, float *im){
+   int m = f->n / 2;
+   for(int size = 2; size <= m; size <<= 1){
+      int half = size >> 1;
+      int step = m / size;
+      for(int start = 0; start < m; start += size){
+         for(int k = 0; k < half; k++){
+            float wr = f->twiddle_re[k * step];
+            float wi = f->twiddle_im[k * step];
+            int top = start + k;
+            int bot = top + half;
+            float tr = wr * re[bot] - wi * im[bot];
+            float ti = wr * im[bot] + wi * re[bot];
+            re[bot] = re[top] - tr;
+            im[bot] = im[top] - ti;
+            re[top] += tr;
+            im[top] += ti;
+         }
+      }
+   }
+}
+
+/**
+ * X[k] from Z[k] = a + ib and Z[m - k] = c + id.
+ */
+static inline void split_bin(const dsp_fft_setup *f, float a, float b, float c, float d, int k,
+                             float *x_re, float *x_im){
+   float even_re = 0.5f * (a + c);
+   float even_im = 0.5f * (b - d);
+   float odd_re = 0.5f * (b + d);
+   float odd_im = -0.5f * (a - c);
+   float wr = f->split_re[k];
+   float wi = f->split_im[k];
+   *x_re = even_re + wr * odd_re - wi * odd_im;
+   *x_im = even_im + wr * odd_im + wi * odd_re;
+}
+
+void dsp_fft_power(const dsp_fft_setup *f, const float *in, float *re, float *im, float *power){
+   int m = f->n / 2;
+   // pack even samples as real, odd as imaginary, in bit reversed order
+   for(int j = 0; j < m; j++){
+      int r = f->bitrev[j];
+      re[r] = in[2 * j];
+      im[r] = in[2 * j + 1];
+   }
+   fft_complex(f, re, im);
+
+   // split Z into the spectrum of the real input, in place: bins k and m - k
+   // both depend on Z[k] and Z[m - k], so they are computed together
+   float dc = re[0] + im[0];
+   float nyquist = re[0] - im[0];
+   re[0] = dc;
+   im[0] = nyquist;
+   power[0] = dc * dc;
+   power[m] = nyquist * nyquist;
+   for(int k = 1; k <= m / 2; k++){
+      float x_re, x_im, y_re, y_im;
+      split_bin(f, re[k], im[k], re[m - k], im[m - k], k, &x_re, &x_im);
+      split_bin(f, re[m - k], im[m - k], re[k], im[k], m - k, &y_re, &y_im);
+      re[k] = x_re;
+      im[k] = x_im;
+      re[m - k] = y_re;
+      im[m - k] = y_im;
+      power[k] = x_re * x_re + x_im * x_im;
+      power[m - k] = y_re * y_re + y_im * y_im;
+   }
+}
+
+#endif
+
+/**************************** Windows ****************************/
+
+void dsp_window_fill(dsp_window_type type, int n, float *out){
+#if defined(__APPLE__)
+   switch(type){
+      case DSP_WINDOW_HANN: vDSP_hann_window(out, (vDSP_Length)n, vDSP_HANN_DENORM); return;
+      case DSP_WINDOW_BLACKMAN: vDSP_blkman_window(out, (vDSP_Length)n, 0); return;
+      default: break;
+   }
+#endif
+   for(int i = 0; i < n; i++){
+      double x = 2.0 * M_PI * i / n;
+      switch(type){
+         case DSP_WINDOW_HANN: out[i] = (float)(0.5 - 0.5 * cos(x)); break;
+         case DSP_WINDOW_BLACKMAN: out[i] = (float)(0.42 - 0.5 * cos(x) + 0.08 * cos(2.0 * x)); break;
+         default: out[i] = 1.0f; break;
+      }
+   }
+}
+
+/************************ Spectral engine ************************/
+
+// per-engine buffers: windowed frame, FFT scratch, Welch history
+static bool spectral_alloc_scratch(dsp_spectral *s, int averages){
+   s->averages = averages;
+   s->frame = arena_alloc(s->arena, sizeof(float) * s->fft_size);
+   s->re = arena_alloc(s->arena, sizeof(float) * (s->fft_size / 2));
+   s->im = arena_alloc(s->arena, sizeof(float) * (s->fft_size / 2));
+   s->history = arena_alloc(s->arena, sizeof(float) * averages * s->num_bins);
+   return s->frame && s->re && s->im && s->history;
+}
+
+bool dsp_spectral_init(dsp_spectral *s, int fft_size, int hop, dsp_window_type window,
+                       int averages, float sample_rate){
+   return dsp_spectral_init_arena(s, fft_size, hop, window, averages, sample_rate, NULL);
+}
+
+bool dsp_spectral_init_arena(dsp_spectral *s, int fft_size, int hop, dsp_window_type window,
+                             int averages, float sample_rate, arena *a){
+   if(hop < 1 || hop > fft_size) return false;
+   if(averages < 1 || averages > DSP_MAX_AVERAGES) return false;
+   if(!(sample_rate > 0.0f)) return false;
+   if(window != DSP_WINDOW_RECT && window != DSP_WINDOW_HANN && window != DSP_WINDOW_BLACKMAN){
+      return false;
+   }
+   memset(s, 0, sizeof(*s));
+   s->arena = a;
+   if(!dsp_fft_setup_init_arena(&s->fft, fft_size, a)) return false;
+
+   s->fft_size = fft_size;
+   s->hop = hop;
+   s->num_bins = fft_size / 2 + 1;
+   s->sample_rate = sample_rate;
+   s->window_type = window;
+   s->window = arena_alloc(a, sizeof(float) * fft_size);
+   if(!s->window || !spectral_alloc_scratch(s, averages)){
+      dsp_spectral_destroy(s);
+      return false;
+   }
+
+   dsp_window_fill(window, fft_size, s->window);
+   double energy = 0.0;
+   for(int i = 0; i < fft_size; i++) energy += (double)s->window[i] * s->window[i];
+   s->psd_scale = (float)(1.0 / (sample_rate * energy));
+   dsp_spectral_reset(s);
+   return true;
+}
+
+bool dsp_spectral_init_shared(dsp_spectral *s, const dsp_spectral *tables, int averages){
+   if(averages < 1 || averages > DSP_MAX_AVERAGES) return false;
+   memset(s, 0, sizeof(*s));
+   s->fft = tables->fft;
+   s->fft_size = tables->fft_size;
+   s->hop = tables->hop;
+   s->num_bins = tables->num_bins;
+   s->sample_rate = tables->sample_rate;
+   s->window_type = tables->window_type;
+   s->window = tables->window;
+   s->psd_scale = tables->psd_scale;
+   s->shared_tables = true;
+   s->arena = tables->arena;
+   if(!spectral_alloc_scratch(s, averages)){
+      dsp_spectral_destroy(s);
+      return false;
+   }
+   dsp_spectral_reset(s);
+   return true;
+}
+
+void dsp_spectral_reset(dsp_spectral *s){
+   s->history_next = 0;
+   s->history_count = 0;
+}
+
+/**
+ * frame[i] = x[i] * window[i] for a piece of the window starting at offset.
+ */
+static void apply_window(dsp_spectral *s, const float *x, int offset, int len){
+   if(len <= 0) return;
+#if defined(__APPLE__)
+   vDSP_vmul(x, 1, s->window + offset, 1, s->frame + offset, 1, (vDSP_Length)len);
+#else
+   for(int i = 0; i < len; i++) s->frame[offset + i] = x[i] * s->window[offset + i];
+#endif
+}
+
+void dsp_spectral_window(dsp_spectral *s, const float *a, int a_len, const float *b,
+                         float *psd_out){
+   int n = s->fft_size;
+   int m = n / 2;
+   if(a_len > n) a_len = n;
+   apply_window(s, a, 0, a_len);
+   apply_window(s, b, a_len, n - a_len);
+
+   // periodogram into the next history slot
+   float *p = s->history + (size_t)s->history_next * s->num_bins;
+   dsp_fft_power(&s->fft, s->frame, s->re, s->im, p);
+   // one-sided density: bins other than DC and Nyquist carry both halves
+   float scale = s->psd_scale;
+   p[0] *= scale;
+   p[m] *= scale;
+   for(int k = 1; k < m; k++) p[k] *= 2.0f * scale;
+
+   s->history_next = (s->history_next + 1) % s->averages;
+   if(s->history_count < s->averages) s->history_count++;
+
+   // Welch: mean of the periodograms in history
+   if(s->history_count == 1){
+      memcpy(psd_out, p, sizeof(float) * s->num_bins);
+      return;
+   }
+   float inv = 1.0f / s->history_count;
+   for(int k = 0; k < s->num_bins; k++){
+      float sum = 0.0f;
+      for(int h = 0; h < s->history_count; h++) sum += s->history[(size_t)h * s->num_bins + k];
+      psd_out[k] = sum * inv;
+   }
+}
+
+int dsp_spectral_process(dsp_spectral *s, spsc_ring_buffer *in, float *psd_out, int max_frames){
+   int frames = 0;
+   while(frames < max_frames){
+      ring_buffer_span spans[2];
+      if(spsc_ring_buffer_peek(in, s->fft_size, spans) < s->fft_size) break;
+      float *out = psd_out + (size_t)frames * s->num_bins;
+      dsp_spectral_window(s, spans[0].ptr, spans[0].len, spans[1].ptr, out);
+      // keep fft_size - hop samples for the next, overlapping window
+      if(!spsc_ring_buffer_release(in, s->hop)){
+         // overwrite mode dropped part of this window: discard it and restart the average
+         dsp_spectral_reset(s);
+         continue;
+      }
+      frames++;
+   }
+   return frames;
+}
+
+float dsp_spectral_bin_hz(const dsp_spectral *s, int bin){
+   return bin * s->sample_rate / s->fft_size;
+}
+
+void dsp_spectral_destroy(dsp_spectral *s){
+   if(!s->shared_tables){
+      dsp_fft_setup_destroy(&s->fft);
+      arena_free(s->arena, s->window);
+   }
+   memset(&s->fft, 0, sizeof(s->fft));
+   arena_free(s->arena, s->frame);
+   arena_free(s->arena, s->re);
+   arena_free(s->arena, s->im);
+   arena_free(s->arena, s->history);
+   s->window = s->frame = s->re = s->im = s->history = NULL;
+}
+
+/************************* Spectral bank *************************/
+
+bool dsp_spectral_bank_init(dsp_spectral_bank *b, int num_channels, int fft_size, int hop,
+                            dsp_window_type window, int averages, float sample_rate){
+   return dsp_spectral_bank_init_arena(b, num_channels, fft_size, hop, window, averages, sample_rate,
+                                       NULL);
+}
+
+bool dsp_spectral_bank_init_arena(dsp_spectral_bank *b, int num_channels, int fft_size, int hop,
+                                  dsp_window_type window, int averages, float sample_rate, arena *a){
+   if(num_channels < 1) return false;
+   memset(b, 0, sizeof(*b));
+   b->arena = a;
+   b->engines = arena_alloc(a, sizeof(dsp_spectral) * num_channels);
+   b->spans = arena_alloc(a, sizeof(ring_buffer_span) * 2 * (size_t)num_channels);
+   if(!b->engines || !b->spans ||
+      !dsp_spectral_init_arena(&b->engines[0], fft_size, hop, window, averages, sample_rate, a)){
+      dsp_spectral_bank_destroy(b);
+      return false;
+   }
+   b->num_channels = 1;
+   for(int ch = 1; ch < num_channels; ch++){
+      if(!dsp_spectral_init_shared(&b->engines[ch], &b->engines[0], averages)){
+         dsp_spectral_bank_destroy(b);
+         return false;
+      }
+      b->num_channels++;
+   }
+   b->num_bins = b->engines[0].num_bins;
+   b->fft_size = fft_size;
+   b->hop = hop;
+   return true;
+}
+
+void dsp_spectral_bank_set_pool(dsp_spectral_bank *b, work_pool *pool){
+   b->pool = pool;
+}
+
+// one task: the window of DSP_BANK_TASK_CHANNELS channels into their slice of b->out
+static void bank_task(void *ctx, int index){
+   dsp_spectral_bank *b = (dsp_spectral_bank *)ctx;
+   int first = index * DSP_BANK_TASK_CHANNELS;
+   int last = first + DSP_BANK_TASK_CHANNELS;
+   if(last > b->num_channels) last = b->num_channels;
+   for(int ch = first; ch < last; ch++){
+      const ring_buffer_span *sp = b->spans + (size_t)ch * 2;
+      dsp_spectral_window(&b->engines[ch], sp[0].ptr, sp[0].len, sp[1].ptr,
+                          b->out + (size_t)ch * b->num_bins);
+   }
+}
+
+int dsp_spectral_bank_process(dsp_spectral_bank *b, spsc_ring_buffer *const *in, float *psd_out,
+                              int max_frames){
+   int tasks = (b->num_channels + DSP_BANK_TASK_CHANNELS - 1) / DSP_BANK_TASK_CHANNELS;
+   int frames = 0;
+   while(frames < max_frames){
+      bool ready = true;
+      for(int ch = 0; ch < b->num_channels && ready; ch++){
+         ready = spsc_ring_buffer_peek(in[ch], b->fft_size, b->spans + (size_t)ch * 2) >= b->fft_size;
+      }
+      if(!ready) break;
+      b->out = psd_out + (size_t)frames * b->num_channels * b->num_bins;
+      work_pool_apply(b->pool, tasks, bank_task, b);
+      // keep fft_size - hop samples of every channel for the next window
+      bool dropped = false;
+      for(int ch = 0; ch < b->num_channels; ch++){
+         if(!spsc_ring_buffer_release(in[ch], b->hop)) dropped = true;
+      }
+      if(dropped){
+         // overwrite mode dropped part of this window: discard it and restart the averages
+         dsp_spectral_bank_reset(b);
+         continue;
+      }
+      frames++;
+   }
+   return frames;
+}
+
+void dsp_spectral_bank_reset(dsp_spectral_bank *b){
+   for(int ch = 0; ch < b->num_channels; ch++) dsp_spectral_reset(&b->engines[ch]);
+}
+
+void dsp_spectral_bank_destroy(dsp_spectral_bank *b){
+   // the shared engines go first, engines[0] owns their tables
+   for(int ch = b->num_channels - 1; ch >= 0; ch--) dsp_spectral_destroy(&b->engines[ch]);
+   arena_free(b->arena, b->engines);
+   arena_free(b->arena, b->spans);
+   b->engines = NULL;
+   b->spans = NULL;
+   b->num_channels = 0;
+}
+
+/**************************** Filters ****************************/
+
+// RBJ audio EQ cookbook, normalized by a0
+static bool biquad_design(dsp_biquad *out, float sample_rate, float f, float q, int type){
+   if(!(sample_rate > 0.0f) || !(f > 0.0f) || !(f < 0.5f * sample_rate) || !(q > 0.0f)) return false;
+   double w0 = 2.0 * M_PI * f / sample_rate;
+   double cw = cos(w0);
+   double alpha = sin(w0) / (2.0 * q);
+   double a0 = 1.0 + alpha;
+   double b0, b1, b2;
+   switch(type){
+      case 0: b0 = 1.0; b1 = -2.0 * cw; b2 = 1.0; break;                          // notch
+      case 1: b0 = 0.5 * (1.0 - cw); b1 = 1.0 - cw; b2 = b0; break;              // low-pass
+      default: b0 = 0.5 * (1.0 + cw); b1 = -(1.0 + cw); b2 = b0; break;          // high-pass
+   }
+   out->b0 = (float)(b0 / a0);
+   out->b1 = (float)(b1 / a0);
+   out->b2 = (float)(b2 / a0);
+   out->a1 = (float)(-2.0 * cw / a0);
+   out->a2 = (float)((1.0 - alpha) / a0);
+   return true;
+}
+
+bool dsp_biquad_notch(dsp_biquad *out, float sample_rate, float f0, float q){
+   return biquad_design(out, sample_rate, f0, q, 0);
+}
+
+bool dsp_biquad_lowpass(dsp_biquad *out, float sample_rate, float fc, float q){
+   return biquad_design(out, sample_rate, fc, q, 1);
+}
+
+bool dsp_biquad_highpass(dsp_biquad *out, float sample_rate, float fc, float q){
+   return biquad_design(out, sample_rate, fc, q, 2);
+}
+
+bool dsp_biquad_cascade_init(dsp_biquad_cascade *c, int num_channels, const dsp_biquad *sections,
+                             int num_sections){
+   return dsp_biquad_cascade_init_arena(c, num_channels, sections, num_sections, NULL);
+}
+
+bool dsp_biquad_cascade_init_arena(dsp_biquad_cascade *c, int num_channels, const dsp_biquad *sections,
+                                   int num_sections, arena *a){
+   if(num_channels < 1 || !sections || num_sections < 1 || num_sections > DSP_MAX_SECTIONS) return false;
+   memset(c, 0, sizeof(*c));
+   c->arena = a;
+   c->num_channels = num_channels;
+   c->num_sections = num_sections;
+   c->lanes = (num_channels + 3) & ~3;
+   for(int s = 0; s < num_sections; s++){
+      c->coeffs[0 * DSP_MAX_SECTIONS + s] = sections[s].b0;
+      c->coeffs[1 * DSP_MAX_SECTIONS + s] = sections[s].b1;
+      c->coeffs[2 * DSP_MAX_SECTIONS + s] = sections[s].b2;
+      c->coeffs[3 * DSP_MAX_SECTIONS + s] = sections[s].a1;
+      c->coeffs[4 * DSP_MAX_SECTIONS + s] = sections[s].a2;
+   }
+
+#if defined(__APPLE__)
+   // every channel uses the same sections (5 doubles each, per section and channel)
+   double *coeffs = malloc(sizeof(double) * 5 * num_sections * num_channels);
+   c->in_ptrs = arena_alloc(a, sizeof(float *) * num_channels);
+   c->out_ptrs = arena_alloc(a, sizeof(float *) * num_channels);
+   if(!coeffs || !c->in_ptrs || !c->out_ptrs){
+      free(coeffs);
+      dsp_biquad_cascade_destroy(c);
+      return false;
+   }
+   for(int s = 0; s < num_sections; s++){
+      for(int ch = 0; ch < num_channels; ch++){
+         double *k = coeffs + 5 * ((size_t)s * num_channels + ch);
+         k[0] = sections[s].b0; k[1] = sections[s].b1; k[2] = sections[s].b2;
+         k[3] = sections[s].a1; k[4] = sections[s].a2;
+      }
+   }
+   c->setup = vDSP_biquadm_CreateSetup(coeffs, (vDSP_Length)num_sections, (vDSP_Length)num_channels);
+   free(coeffs);
+   if(!c->setup){
+      dsp_biquad_cascade_destroy(c);
+      return false;
+   }
+#else
+   // one cache line aligned block, z1/z2 of each section back to back
+   size_t bytes = sizeof(float) * 2 * (size_t)num_sections * c->lanes;
+   bytes = (bytes + RB_CACHE_LINE_SIZE - 1) / RB_CACHE_LINE_SIZE * RB_CACHE_LINE_SIZE;
+   c->state = a ? arena_alloc(a, bytes) : aligned_alloc(RB_CACHE_LINE_SIZE, bytes);
+   if(!c->state){
+      dsp_biquad_cascade_destroy(c);
+      return false;
+   }
+   dsp_biquad_cascade_reset(c);
+#endif
+   return true;
+}
+
+bool dsp_biquad_cascade_init_eeg(dsp_biquad_cascade *c, int num_channels, float sample_rate,
+                                 float line_hz, float lo_hz, float hi_hz){
+   return dsp_biquad_cascade_init_eeg_arena(c, num_channels, sample_rate, line_hz, lo_hz, hi_hz, NULL);
+}
+
+bool dsp_biquad_cascade_init_eeg_arena(dsp_biquad_cascade *c, int num_channels, float sample_rate,
+                                       float line_hz, float lo_hz, float hi_hz, arena *a){
+   // 4th order Butterworth = two sections with these Q
+   const float butterworth_q[2] = { 0.54119610f, 1.30656296f };
+   if(!(lo_hz > 0.0f) || !(hi_hz > lo_hz) || !(line_hz >= 0.0f)) return false;
+   dsp_biquad sections[DSP_MAX_SECTIONS];
+   int n = 0;
+   for(int h = 1; line_hz > 0.0f && h * line_hz < 0.45f * sample_rate && n < DSP_MAX_SECTIONS - 4; h++){
+      if(!dsp_biquad_notch(&sections[n++], sample_rate, h * line_hz, DSP_NOTCH_Q)) return false;
+   }
+   for(int i = 0; i < 2; i++){
+      if(!dsp_biquad_highpass(&sections[n++], sample_rate, lo_hz, butterworth_q[i])) return false;
+   }
+   for(int i = 0; i < 2; i++){
+      if(!dsp_biquad_lowpass(&sections[n++], sample_rate, hi_hz, butterworth_q[i])) return false;
+   }
+   return dsp_biquad_cascade_init_arena(c, num_channels, sections, n, a);
+}
+
+#if !defined(__APPLE__)
+/**
+ * One section over channels [begin, end) of one frame, transposed direct form II.
+ */
+static inline void biquad_lanes_scalar(const float *k, float *z1, float *z2, float *x,
+                                       int begin, int end){
+   const float b0 = k[0 * DSP_MAX_SECTIONS], b1 = k[1 * DSP_MAX_SECTIONS], b2 = k[2 * DSP_MAX_SECTIONS];
+   const float a1 = k[3 * DSP_MAX_SECTIONS], a2 = k[4 * DSP_MAX_SECTIONS];
+   for(int ch = begin; ch < end; ch++){
+      float in = x[ch];
+      float y = b0 * in + z1[ch];
+      z1[ch] = b1 * in - a1 * y + z2[ch];
+      z2[ch] = b2 * in - a2 * y;
+      x[ch] = y;
+   }
+}
+#endif
+
+void dsp_biquad_cascade_process(dsp_biquad_cascade *c, const float *in, float *out, int num_frames){
+   if(num_frames <= 0) return;
+   int nch = c->num_channels;
+#if defined(__APPLE__)
+   // channel ch is every nch-th float starting at ch
+   for(int ch = 0; ch < nch; ch++){
+      c->in_ptrs[ch] = in + ch;
+      c->out_ptrs[ch] = out + ch;
+   }
+   vDSP_biquadm(c->setup, c->in_ptrs, (vDSP_Stride)nch, c->out_ptrs, (vDSP_Stride)nch,
+                (vDSP_Length)num_frames);
+#else
+   if(in != out) memcpy(out, in, sizeof(float) * (size_t)num_frames * nch);
+   int lanes = c->lanes;
+#if defined(__ARM_NEON)
+   int vec_end = nch & ~3;
+#else
+   int vec_end = 0;
+#endif
+   for(int f = 0; f < num_frames; f++){
+      float *x = out + (size_t)f * nch;
+      for(int s = 0; s < c->num_sections; s++){
+         float *z1 = c->state + (size_t)(2 * s) * lanes;
+         float *z2 = z1 + lanes;
+         const float *k = c->coeffs + s;
+#if defined(__ARM_NEON)
+         const float32x4_t b0 = vdupq_n_f32(k[0 * DSP_MAX_SECTIONS]);
+         const float32x4_t b1 = vdupq_n_f32(k[1 * DSP_MAX_SECTIONS]);
+         const float32x4_t b2 = vdupq_n_f32(k[2 * DSP_MAX_SECTIONS]);
+         const float32x4_t a1 = vdupq_n_f32(k[3 * DSP_MAX_SECTIONS]);
+         const float32x4_t a2 = vdupq_n_f32(k[4 * DSP_MAX_SECTIONS]);
+         for(int ch = 0; ch < vec_end; ch += 4){
+            float32x4_t v = vld1q_f32(x + ch);
+            float32x4_t s1 = vld1q_f32(z1 + ch);
+            float32x4_t s2 = vld1q_f32(z2 + ch);
+            float32x4_t y = vfmaq_f32(s1, b0, v);
+            s1 = vfmsq_f32(vfmaq_f32(s2, b1, v), a1, y);
+            s2 = vfmsq_f32(vmulq_f32(b2, v), a2, y);
+            vst1q_f32(z1 + ch, s1);
+            vst1q_f32(z2 + ch, s2);
+            vst1q_f32(x + ch, y);
+         }
+#endif
+         biquad_lanes_scalar(k, z1, z2, x, vec_end, nch);
+      }
+   }
+#endif
+}
+
+void dsp_biquad_cascade_reset(dsp_biquad_cascade *c){
+#if defined(__APPLE__)
+   if(c->setup) vDSP_biquadm_ResetState(c->setup);
+#else
+   if(c->state) memset(c->state, 0, sizeof(float) * 2 * (size_t)c->num_sections * c->lanes);
+#endif
+}
+
+void dsp_biquad_cascade_destroy(dsp_biquad_cascade *c){
+#if defined(__APPLE__)
+   if(c->setup) vDSP_biquadm_DestroySetup(c->setup);
+   arena_free(c->arena, c->in_ptrs);
+   arena_free(c->arena, c->out_ptrs);
+   c->setup = NULL;
+   c->in_ptrs = NULL;
+   c->out_ptrs = NULL;
+#endif
+   arena_free(c->arena, c->state);
+   c->state = NULL;
+}
+
+/*************************** Decimation ***************************/
+
+bool dsp_decimator_init(dsp_decimator *d, int factor){
+   return dsp_decimator_init_arena(d, factor, NULL);
+}
+
+bool dsp_decimator_init_arena(dsp_decimator *d, int factor, arena *a){
+   if(factor < 2 || factor > DSP_MAX_DECIM_FACTOR) return false;
+   memset(d, 0, sizeof(*d));
+   d->arena = a;
+   d->factor = factor;
+   d->taps = DSP_DECIM_TAPS_PER_FACTOR * factor + 1;
+   d->coeffs = arena_alloc(a, sizeof(float) * d->taps);
+   d->work = arena_alloc(a, sizeof(float) * (d->taps - 1 + DSP_DECIM_BLOCK));
+   if(!d->coeffs || !d->work){
+      dsp_decimator_destroy(d);
+      return false;
+   }
+
+   // windowed sinc, cutoff at 80% of the output Nyquist (cycles per input sample)
+   double fc = 0.4 / factor;
+   double center = 0.5 * (d->taps - 1);
+   double sum = 0.0;
+   for(int i = 0; i < d->taps; i++){
+      double t = i - center;
+      double sinc = t == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+      double x = 2.0 * M_PI * i / (d->taps - 1);
+      double w = 0.42 - 0.5 * cos(x) + 0.08 * cos(2.0 * x);
+      d->coeffs[i] = (float)(sinc * w);
+      sum += sinc * w;
+   }
+   // unity gain at DC
+   for(int i = 0; i < d->taps; i++) d->coeffs[i] = (float)(d->coeffs[i] / sum);
+   dsp_decimator_reset(d);
+   return true;
+}
+
+void dsp_decimator_reset(dsp_decimator *d){
+   memset(d->work, 0, sizeof(float) * (d->taps - 1));
+   d->work_len = d->taps - 1;
+   d->next = 0;
+}
+
+int dsp_decimator_process(dsp_decimator *d, const float *in, int n, float *out){
+   if(n <= 0) return 0;
+   if(n > DSP_DECIM_BLOCK) n = DSP_DECIM_BLOCK;
+   memcpy(d->work + d->work_len, in, sizeof(float) * n);
+   d->work_len += n;
+
+   int count = 0;
+   if(d->work_len - d->next >= d->taps) count = (d->work_len - d->taps - d->next) / d->factor + 1;
+   const float *x = d->work + d->next;
+#if defined(__APPLE__)
+   // out[m] = sum_p x[m * factor + p] * coeffs[p] (coefficients are symmetric)
+   vDSP_desamp(x, (vDSP_Stride)d->factor, d->coeffs, out, (vDSP_Length)count, (vDSP_Length)d->taps);
+#else
+   for(int m = 0; m < count; m++){
+      const float *w = x + (size_t)m * d->factor;
+      float acc = 0.0f;
+      for(int p = 0; p < d->taps; p++) acc += w[p] * d->coeffs[p];
+      out[m] = acc;
+   }
+#endif
+   d->next += count * d->factor;
+
+   // keep the history the next window needs (fewer than taps samples)
+   int keep = d->work_len - d->next;
+   memmove(d->work, d->work + d->next, sizeof(float) * keep);
+   d->work_len = keep;
+   d->next = 0;
+   return count;
+}
+
+void dsp_decimator_destroy(dsp_decimator *d){
+   arena_free(d->arena, d->coeffs);
+   arena_free(d->arena, d->work);
+   d->coeffs = NULL;
+   d->work = NULL;
+}
+
+bool dsp_decim_chain_init(dsp_decim_chain *c, float sample_rate, const int *factors,
+                          int num_stages, int ring_capacity){
+   return dsp_decim_chain_init_arena(c, sample_rate, factors, num_stages, ring_capacity, NULL);
+}
+
+bool dsp_decim_chain_init_arena(dsp_decim_chain *c, float sample_rate, const int *factors,
+                                int num_stages, int ring_capacity, arena *a){
+   if(!(sample_rate > 0.0f) || !factors || num_stages < 1 || num_stages > DSP_MAX_DECIM_STAGES) return false;
+   if(ring_capacity <= 0) return false;
+   memset(c, 0, sizeof(*c));
+   c->arena = a;
+   c->sample_rate = sample_rate;
+   float rate = sample_rate;
+   for(int i = 0; i < num_stages; i++){
+      dsp_decim_stage *st = &c->stages[i];
+      if(!dsp_decimator_init_arena(&st->dec, factors[i], a)){
+         dsp_decim_chain_destroy(c);
+         return false;
+      }
+      c->num_stages = i + 1;
+      rate /= factors[i];
+      st->sample_rate = rate;
+      st->out = arena_alloc(a, sizeof(float) * DSP_DECIM_BLOCK);
+      st->ring = arena_alloc(a, sizeof(spsc_ring_buffer));
+      bool ok = st->out && st->ring;
+      if(ok && a){
+         float *storage = arena_alloc(a, sizeof(float) * (size_t)ring_capacity);
+         ok = storage && spsc_ring_buffer_init_with_storage(st->ring, storage, ring_capacity);
+      } else if(ok){
+         ok = spsc_ring_buffer_init(st->ring, ring_capacity);
+      }
+      if(!ok){
+         arena_free(a, st->ring);
+         st->ring = NULL;
+         dsp_decim_chain_destroy(c);
+         return false;
+      }
+   }
+   return true;
+}
+
+void dsp_decim_chain_push(dsp_decim_chain *c, const float *x, int n){
+   for(int pos = 0; pos < n; pos += DSP_DECIM_BLOCK){
+      const float *in = x + pos;
+      int len = n - pos < DSP_DECIM_BLOCK ? n - pos : DSP_DECIM_BLOCK;
+      // each stage feeds the next with its output block
+      for(int i = 0; i < c->num_stages && len > 0; i++){
+         dsp_decim_stage *st = &c->stages[i];
+         len = dsp_decimator_process(&st->dec, in, len, st->out);
+         int written = spsc_ring_buffer_write_n(st->ring, st->out, len);
+         st->dropped += (uint64_t)(len - written);
+         in = st->out;
+      }
+   }
+}
+
+spsc_ring_buffer *dsp_decim_chain_ring(dsp_decim_chain *c, int stage){
+   return c->stages[stage].ring;
+}
+
+float dsp_decim_chain_rate(const dsp_decim_chain *c, int stage){
+   return c->stages[stage].sample_rate;
+}
+
+void dsp_decim_chain_destroy(dsp_decim_chain *c){
+   for(int i = 0; i < c->num_stages; i++){
+      dsp_decim_stage *st = &c->stages[i];
+      dsp_decimator_destroy(&st->dec);
+      arena_free(c->arena, st->out);
+      if(c->arena) spsc_ring_buffer_deinit(st->ring); // storage and struct belong to the arena
+      else spsc_ring_buffer_destroy(st->ring);        // frees the struct as well
+      st->out = NULL;
+      st->ring = NULL;
+   }
+   c->num_stages = 0;
+}
+
+/************************* Band tracker **************************/
+
+const dsp_band dsp_eeg_bands[DSP_NUM_EEG_BANDS] = {
+   { 0.5f, 4.0f },   // delta
+   { 4.0f, 8.0f },   // theta
+   { 8.0f, 13.0f },  // alpha
+   { 13.0f, 30.0f }  // beta
+};
+
+bool dsp_band_tracker_init(dsp_band_tracker *t, int window, float sample_rate,
+                           const dsp_band *bands, int num_bands){
+   if(window < 2 || !(sample_rate > 0.0f)) return false;
+   if(!bands || num_bands < 1 || num_bands > DSP_MAX_BANDS) return false;
+   memset(t, 0, sizeof(*t));
+   t->window = window;
+   t->sample_rate = sample_rate;
+   t->num_bands = num_bands;
+
+   // bins k = 0..N/2 inside each band, upper edge excluded so adjacent bands
+   // (alpha 8-13, beta 13-30) don't both count the 13 Hz bin
+   double resolution = (double)sample_rate / window;
+   int first_bin[DSP_MAX_BANDS];
+   for(int b = 0; b < num_bands; b++){
+      if(!(bands[b].lo_hz <= bands[b].hi_hz)) return false;
+      int first = (int)ceil(bands[b].lo_hz / resolution - 1e-9);
+      int last = (int)ceil(bands[b].hi_hz / resolution - 1e-9) - 1;
+      if(first < 0) first = 0;
+      if(last > window / 2) last = window / 2;
+      if(last < first) return false;
+      first_bin[b] = first;
+      t->band_first[b] = t->num_bins;
+      t->band_bins[b] = last - first + 1;
+      t->num_bins += last - first + 1;
+   }
+
+   t->coef_re = malloc(sizeof(double) * t->num_bins);
+   t->coef_im = malloc(sizeof(double) * t->num_bins);
+   t->state_re = calloc(t->num_bins, sizeof(double));
+   t->state_im = calloc(t->num_bins, sizeof(double));
+   t->bin_scale = malloc(sizeof(float) * t->num_bins);
+   t->history = calloc(window, sizeof(float));
+   if(!t->coef_re || !t->coef_im || !t->state_re || !t->state_im || !t->bin_scale || !t->history){
+      dsp_band_tracker_destroy(t);
+      return false;
+   }
+
+   double n2 = (double)window * window;
+   for(int b = 0; b < num_bands; b++){
+      for(int j = 0; j < t->band_bins[b]; j++){
+         int k = first_bin[b] + j;
+         int i = t->band_first[b] + j;
+         double a = 2.0 * M_PI * k / window;
+         t->coef_re[i] = DSP_SDFT_DAMPING * cos(a);
+         t->coef_im[i] = DSP_SDFT_DAMPING * sin(a);
+         bool edge = k == 0 || 2 * k == window;
+         t->bin_scale[i] = (float)((edge ? 1.0 : 2.0) / n2);
+      }
+   }
+   t->damping_n = pow(DSP_SDFT_DAMPING, window);
+   atomic_init(&t->seq, 0);
+   for(int b = 0; b < DSP_MAX_BANDS; b++) atomic_init(&t->power[b], 0.0f);
+   atomic_init(&t->power_samples, 0);
+   return true;
+}
+
+void dsp_band_tracker_push(dsp_band_tracker *t, const float *x, int n){
+   if(n <= 0) return;
+   for(int s = 0; s < n; s++){
+      // S_k <- r e^(i 2 pi k / N) (S_k + x[n] - r^N x[n - N])
+      double delta = x[s] - t->damping_n * t->history[t->history_pos];
+      t->history[t->history_pos] = x[s];
+      if(++t->history_pos == t->window) t->history_pos = 0;
+      for(int i = 0; i < t->num_bins; i++){
+         double re = t->state_re[i] + delta;
+         double im = t->state_im[i];
+         t->state_re[i] = re * t->coef_re[i] - im * t->coef_im[i];
+         t->state_im[i] = re * t->coef_im[i] + im * t->coef_re[i];
+      }
+   }
+   t->samples += (uint64_t)n;
+
+   // publish: odd sequence while the values change, readers retry
+   unsigned int seq = atomic_load_explicit(&t->seq, memory_order_relaxed);
+   atomic_store_explicit(&t->seq, seq + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+   for(int b = 0; b < t->num_bands; b++){
+      double power = 0.0;
+      for(int j = 0; j < t->band_bins[b]; j++){
+         int i = t->band_first[b] + j;
+         power += t->bin_scale[i] * (t->state_re[i] * t->state_re[i] + t->state_im[i] * t->state_im[i]);
+      }
+      atomic_store_explicit(&t->power[b], (float)power, memory_order_relaxed);
+   }
+   atomic_store_explicit(&t->power_samples, t->samples, memory_order_relaxed);
+   atomic_store_explicit(&t->seq, seq + 2, memory_order_release);
+}
+
+int dsp_band_tracker_read(const dsp_band_tracker *t, float *power_out, uint64_t *samples_out){
+   uint64_t samples;
+   unsigned int before, after;
+   do {
+      before = atomic_load_explicit(&t->seq, memory_order_acquire);
+      for(int b = 0; b < t->num_bands; b++){
+         power_out[b] = atomic_load_explicit(&t->power[b], memory_order_relaxed);
+      }
+      samples = atomic_load_explicit(&t->power_samples, memory_order_relaxed);
+      atomic_thread_fence(memory_order_acquire);
+      after = atomic_load_explicit(&t->seq, memory_order_relaxed);
+   } while((before & 1u) || before != after);
+   if(samples_out) *samples_out = samples;
+   return t->num_bands;
+}
+
+void dsp_band_tracker_destroy(dsp_band_tracker *t){
+   free(t->coef_re);
+   free(t->coef_im);
+   free(t->state_re);
+   free(t->state_im);
+   free(t->bin_scale);
+   free(t->history);
+   t->coef_re = t->coef_im = t->state_re = t->state_im = NULL;
+   t->bin_scale = t->history = NULL;
+}
+
+void dsp_psd_band_powers(const float *psd, int num_channels, int num_bins, float bin_hz,
+                         const dsp_band *bands, int num_bands, float *power_out){
+   for(int b = 0; b < num_bands; b++){
+      // same bin membership as the band tracker
+      int first = (int)ceil(bands[b].lo_hz / bin_hz - 1e-9);
+      int last = (int)ceil(bands[b].hi_hz / bin_hz - 1e-9) - 1;
+      if(first < 0) first = 0;
+      if(last > num_bins - 1) last = num_bins - 1;
+      for(int ch = 0; ch < num_channels; ch++){
+         const float *p = psd + (size_t)ch * num_bins;
+         double sum = 0.0;
+         for(int k = first; k <= last; k++) sum += p[k];
+         power_out[ch * num_bands + b] = (float)(sum * bin_hz);
+      }
+   }
+}
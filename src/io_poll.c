@@ -0,0 +1,131 @@
+/**
+ * io_poll.c
+ *
+ * Implementation of the descriptor poller: kqueue on macOS, poll() elsewhere.
+ *
+ * Notes:
+ * - EINTR is treated as a timeout, the caller just waits again.
+ * - Use with io_poll.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "io_poll.h"
+#include "metrics.h"
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+#if defined(__APPLE__)
+
+bool io_poller_init(io_poller *p){
+   p->num_fds = 0;
+   p->kq = kqueue();
+   return p->kq != -1;
+}
+
+bool io_poller_add(io_poller *p, int fd, int low_water, void *udata){
+   if(p->num_fds >= IO_POLLER_MAX_FDS) return false;
+   struct kevent change;
+   if(low_water > 1){
+      EV_SET(&change, fd, EVFILT_READ, EV_ADD, NOTE_LOWAT, low_water, udata);
+   } else {
+      EV_SET(&change, fd, EVFILT_READ, EV_ADD, 0, 0, udata);
+   }
+   if(kevent(p->kq, &change, 1, NULL, 0, NULL) == -1) return false;
+   p->watched[p->num_fds] = fd;
+   p->udata[p->num_fds++] = udata;
+   return true;
+}
+
+bool io_poller_remove(io_poller *p, int fd){
+   for(int i = 0; i < p->num_fds; i++){
+      if(p->watched[i] != fd) continue;
+      // the filter is gone already if fd was closed, that is fine too
+      struct kevent change;
+      EV_SET(&change, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+      kevent(p->kq, &change, 1, NULL, 0, NULL);
+      p->num_fds--;
+      p->watched[i] = p->watched[p->num_fds];
+      p->udata[i] = p->udata[p->num_fds];
+      return true;
+   }
+   return false;
+}
+
+int io_poller_wait(io_poller *p, int timeout_ms, void **ready, int max_ready){
+   struct kevent events[IO_POLLER_MAX_FDS];
+   struct timespec ts;
+   struct timespec *tsp = NULL;
+   if(timeout_ms >= 0){
+      ts.tv_sec = timeout_ms / 1000;
+      ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+      tsp = &ts;
+   }
+   if(max_ready > IO_POLLER_MAX_FDS) max_ready = IO_POLLER_MAX_FDS;
+   METRICS_ADD(METRIC_WAIT_CALLS, 1);
+   int n = kevent(p->kq, NULL, 0, events, max_ready, tsp);
+   if(n == -1) return errno == EINTR ? 0 : -1;
+   for(int i = 0; i < n; i++) ready[i] = events[i].udata;
+   return n;
+}
+
+void io_poller_close(io_poller *p){
+   if(p->kq != -1) close(p->kq);
+   p->kq = -1;
+   p->num_fds = 0;
+}
+
+#else
+
+bool io_poller_init(io_poller *p){
+   p->num_fds = 0;
+   return true;
+}
+
+bool io_poller_add(io_poller *p, int fd, int low_water, void *udata){
+   (void)low_water; // no low-water mark for poll(), see io_poll.h
+   if(p->num_fds >= IO_POLLER_MAX_FDS) return false;
+   p->fds[p->num_fds].fd = fd;
+   p->fds[p->num_fds].events = POLLIN;
+   p->fds[p->num_fds].revents = 0;
+   p->udata[p->num_fds] = udata;
+   p->num_fds++;
+   return true;
+}
+
+bool io_poller_remove(io_poller *p, int fd){
+   for(int i = 0; i < p->num_fds; i++){
+      if(p->fds[i].fd != fd) continue;
+      p->num_fds--;
+      p->fds[i] = p->fds[p->num_fds];
+      p->udata[i] = p->udata[p->num_fds];
+      return true;
+   }
+   return false;
+}
+
+int io_poller_wait(io_poller *p, int timeout_ms, void **ready, int max_ready){
+   METRICS_ADD(METRIC_WAIT_CALLS, 1);
+   int n = poll(p->fds, (nfds_t)p->num_fds, timeout_ms);
+   if(n == -1) return errno == EINTR ? 0 : -1;
+   int count = 0;
+   for(int i = 0; i < p->num_fds && count < max_ready; i++){
+      if(p->fds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)){
+         ready[count++] = p->udata[i];
+      }
+   }
+   return count;
+}
+
+void io_poller_close(io_poller *p){
+   p->num_fds = 0;
+}
+
+#endif
@@ -1 +1,444 @@
-// main - App entry point (e.g., for real-time pipeline)
+// main - App entry point: serial ingest -> filter -> spectral -> output pipeline
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "read_serial_data.h"
+#include "mc_ring_buffer.h"
+#include "serial_protocol.h"
+#include "telemetry.h"
+#include "pipeline.h"
+#include "pipeline_stages.h"
+#include "rt_sched.h"
+#include "serial_source.h"
+#include "metrics.h"
+#include "arena.h"
+#include "sample_clock.h"
+#include "stream_sink.h"
+
+#define SERIAL_PORT "/dev/cu.usbmodem11301"
+#define NUM_CHANNELS 1           // default, must match the firmware (override with argv[1])
+#define FRAMES_PER_PACKET 32     // default, must match the firmware (override with argv[2])
+#define SERIAL_VTIME 1           // default 0.1 s, see serial_tuning (override with argv[4])
+#define RING_CAPACITY_FRAMES 4096
+#define TELEMETRY_INTERVAL_MS 1000
+#define SAMPLE_RATE_HZ 250.0f    // must match the firmware's sampling rate
+#define LINE_FREQ_HZ 60.0f       // mains frequency to notch out (50 in Europe)
+#define BAND_LO_HZ 0.5f
+#define BAND_HI_HZ 45.0f
+#define FFT_SIZE 256             // ~1 Hz bins at 250 Hz
+#define FFT_HOP 64               // 75% overlap, one PSD frame every 0.26 s
+#define PSD_AVERAGES 4
+#define PSD_RING_FRAMES 16
+#define FILTER_BLOCK_TIMEOUT_US 10000
+#define INGEST_COMPUTATION_US 500 // CPU time to drain and parse one wakeup's bytes
+#define INGEST_CONSTRAINT_US 2000 // deadline after the wakeup
+#define JITTER_REPORT_INTERVAL_S 10
+#define SYNTH_OFFSET_V 2.5f      // mid-scale of the ADC
+#define SYNTH_NOISE_V 0.05f
+#define RECORD_CHUNK_FRAMES 256  // ~1 s per chunk at 250 Hz
+#define RECORD_RING_FRAMES 8192
+#define METRICS_INTERVAL_MS 1000
+#define SPECTRAL_POOL_MIN_CHANNELS 16 // montages analyzed on a worker pool from this size
+#define PIPELINE_ARENA_BYTES (64u << 20) // virtual reserve, only the pages in use are touched
+#define GAP_FILL_MAX_FRAMES 250  // interpolate over lost packets up to 1 s at 250 Hz
+#define ALIGN_QUEUE_FRAMES 1024  // ~4 s a board can get ahead of the others
+#define STREAM_SHM_SLOTS 64      // ~16 s of PSD frames and band powers at one hop per 0.26 s
+#define STREAM_RAW_SHM_SLOTS 64  // raw chunks, up to PIPELINE_CHUNK_FRAMES frames each
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig){
+   (void)sig;
+   running = 0;
+}
+
+// output stage callback: the visualization/feedback consumer of the PSD frames
+typedef struct {
+   telemetry_channel *telemetry;
+   float bin_hz;
+} psd_output;
+
+static void on_psd(const float *psd, int num_channels, int num_bins, void *ctx){
+   psd_output *out = (psd_output *)ctx;
+   (void)num_channels;
+   // dominant frequency of channel 0, skipping DC
+   int peak = 1;
+   for(int k = 2; k < num_bins; k++) if(psd[k] > psd[peak]) peak = k;
+   telemetry_log(out->telemetry, "channel 0 peak %.1f Hz", peak * out->bin_hz);
+}
+
+// copies the file name of "<prefix><file>[@speed]" into path
+static bool spec_path(const char *spec, size_t prefix, const char *at, char *path, size_t size){
+   size_t len = at ? (size_t)(at - spec) - prefix : strlen(spec + prefix);
+   if(len == 0 || len >= size) return false;
+   memcpy(path, spec + prefix, len);
+   path[len] = '\0';
+   return true;
+}
+
+// source spec: a tty path, "synth[@speed]", "replay:<capture>[@speed]" or
+// "recording:<session>[@speed]", speed 1 = real time (default), 0 = as fast as possible;
+// device is the source's position in the list, each synthetic board gets its own noise
+static bool open_source(serial_source *src, const char *spec, int device, int num_channels,
+                        int frames_per_packet, const serial_tuning *tuning){
+   const char *at = strrchr(spec, '@');
+   float speed = at ? strtof(at + 1, NULL) : 1.0f;
+   if(strncmp(spec, "synth", 5) == 0 && (spec[5] == '\0' || spec[5] == '@')){
+      // alpha-dominant test signal with some theta and line noise
+      serial_synth_config cfg;
+      memset(&cfg, 0, sizeof(cfg));
+      cfg.num_channels = num_channels;
+      cfg.frames_per_packet = frames_per_packet;
+      cfg.sample_rate = SAMPLE_RATE_HZ;
+      cfg.speed = speed;
+      cfg.seed = (uint32_t)device + 1;
+      cfg.num_tones = 3;
+      cfg.tone_hz[0] = 10.0f;
+      cfg.tone_v[0] = 0.5f;
+      cfg.tone_hz[1] = 6.0f;
+      cfg.tone_v[1] = 0.2f;
+      cfg.tone_hz[2] = LINE_FREQ_HZ;
+      cfg.tone_v[2] = 0.1f;
+      cfg.offset_v = SYNTH_OFFSET_V;
+      cfg.noise_v = SYNTH_NOISE_V;
+      return serial_source_open_synth(src, &cfg);
+   }
+   char path[PATH_MAX];
+   if(strncmp(spec, "replay:", 7) == 0){
+      serial_replay_config cfg = { num_channels, frames_per_packet, SAMPLE_RATE_HZ, speed };
+      return spec_path(spec, 7, at, path, sizeof(path)) && serial_source_open_replay(src, path, &cfg);
+   }
+   if(strncmp(spec, "recording:", 10) == 0){
+      serial_recording_config cfg = { frames_per_packet, speed, 0 };
+      return spec_path(spec, 10, at, path, sizeof(path)) && serial_source_open_recording(src, path, &cfg);
+   }
+   return serial_source_open_tty(src, spec, tuning);
+}
+
+static void print_clock(int device, const sample_clock *clock){
+   fprintf(stderr, "sample clock %d: %.3f Hz (%+.0f ppm vs %.0f Hz), %llu gaps filled (%llu frames), "
+           "%llu resyncs\n", device, sample_clock_rate(clock), sample_clock_drift_ppm(clock),
+           (double)SAMPLE_RATE_HZ, (unsigned long long)clock->gaps,
+           (unsigned long long)clock->frames_filled, (unsigned long long)clock->resyncs);
+}
+
+// the sinks of one publishing stage: $EEG_STREAM_SHM (shm name, suffix appended) and/or
+// $EEG_STREAM_UDP ("host:port"), each stage with its own ring and socket
+static bool open_sinks(stream_sinks *sinks, stream_shm *shm, stream_udp *udp, const char *suffix,
+                       int num_slots, int slot_values){
+   sinks->shm = NULL;
+   sinks->udp = NULL;
+   const char *shm_name = getenv("EEG_STREAM_SHM");
+   if(shm_name){
+      char name[STREAM_SHM_NAME_LEN];
+      if(snprintf(name, sizeof(name), "%s%s", shm_name, suffix) >= (int)sizeof(name) ||
+         !stream_shm_create(shm, name, num_slots, slot_values)) return false;
+      sinks->shm = shm;
+   }
+   const char *udp_dest = getenv("EEG_STREAM_UDP");
+   if(udp_dest){
+      char host[256];
+      const char *colon = strrchr(udp_dest, ':');
+      size_t len = colon ? (size_t)(colon - udp_dest) : 0;
+      if(len == 0 || len >= sizeof(host)) return false;
+      memcpy(host, udp_dest, len);
+      host[len] = '\0';
+      if(!stream_udp_open(udp, host, atoi(colon + 1))) return false;
+      sinks->udp = udp;
+   }
+   return true;
+}
+
+static void close_sinks(stream_sinks *sinks){
+   if(sinks->shm) stream_shm_close(sinks->shm);
+   if(sinks->udp){
+      fprintf(stderr, "stream udp: %llu datagrams in %llu calls, %llu dropped\n",
+              (unsigned long long)sinks->udp->datagrams_sent,
+              (unsigned long long)sinks->udp->send_calls,
+              (unsigned long long)sinks->udp->datagrams_dropped);
+      stream_udp_close(sinks->udp);
+   }
+}
+
+int main(int argc, char **argv){
+
+   // channels per frame, must match NUM_CHANNELS in the firmware
+   int num_channels = NUM_CHANNELS;
+   if(argc > 1) num_channels = atoi(argv[1]);
+   int frames_per_packet = FRAMES_PER_PACKET;
+   if(argc > 2) frames_per_packet = atoi(argv[2]);
+   if(num_channels < 1 || num_channels > SERIAL_PROTO_MAX_CHANNELS ||
+      frames_per_packet < 1 || num_channels * frames_per_packet > SERIAL_PROTO_MAX_CODES){
+      fprintf(stderr, "usage: eeg_app [num_channels 1..%d] [frames_per_packet] [vmin] [vtime] "
+              "[ingest_cpu] [source[,source...]] [record_file], at most %d codes per packet\n", SERIAL_PROTO_MAX_CHANNELS,
+              SERIAL_PROTO_MAX_CODES);
+      return 1;
+   }
+
+   // wake up once per packet by default, VMIN is a byte so at most 255
+   serial_tuning tuning;
+   size_t packet_size = serial_packet_size(num_channels, frames_per_packet);
+   tuning.vmin = packet_size < 255 ? (int)packet_size : 255;
+   tuning.vtime = SERIAL_VTIME;
+   if(argc > 3) tuning.vmin = atoi(argv[3]);
+   if(argc > 4) tuning.vtime = atoi(argv[4]);
+   if(tuning.vmin < 0 || tuning.vmin > 255 || tuning.vtime < 0 || tuning.vtime > 255){
+      fprintf(stderr, "vmin and vtime must be 0..255\n");
+      return 1;
+   }
+   // CPU to pin the acquisition thread to (Linux), -1 = any
+   int ingest_cpu = -1;
+   if(argc > 5) ingest_cpu = atoi(argv[5]);
+   if(ingest_cpu < -1 || ingest_cpu > 63){
+      fprintf(stderr, "ingest_cpu must be -1..63\n");
+      return 1;
+   }
+
+   // the boards' serial ports, or synthetic/replayed streams without a board:
+   // a comma-separated list, each board with num_channels channels
+   char source_list[4096];
+   snprintf(source_list, sizeof(source_list), "%s", argc > 6 ? argv[6] : SERIAL_PORT);
+   serial_source sources[SERIAL_MAX_DEVICES];
+   int num_devices = 0;
+   char *save = NULL;
+   for(char *spec = strtok_r(source_list, ",", &save); spec; spec = strtok_r(NULL, ",", &save)){
+      if(num_devices == SERIAL_MAX_DEVICES){
+         fprintf(stderr, "at most %d sources\n", SERIAL_MAX_DEVICES);
+         return 1;
+      }
+      if(!open_source(&sources[num_devices], spec, num_devices, num_channels, frames_per_packet, &tuning)){
+         perror("Error opening serial source");
+         return 1;
+      }
+      printf("fd = %d\n", sources[num_devices].fd);
+      num_devices++;
+   }
+   if(num_devices == 0){
+      fprintf(stderr, "no source given\n");
+      return 1;
+   }
+   // the aligned stream of all boards, board 0's channels first
+   int total_channels = num_channels * num_devices;
+
+   // every ring, engine and stage buffer in one region, sealed before the threads start
+   arena pipeline_arena;
+   if(!arena_init(&pipeline_arena, PIPELINE_ARENA_BYTES)){
+      perror("Failed to reserve the pipeline arena");
+      return 1;
+   }
+
+   // rings between the stages, each with the backpressure policy of its edge
+   int num_bins = FFT_SIZE / 2 + 1;
+   mc_ring_buffer *raw = arena_alloc(&pipeline_arena, sizeof(mc_ring_buffer));
+   mc_ring_buffer *filtered = arena_alloc(&pipeline_arena, sizeof(mc_ring_buffer));
+   mc_ring_buffer *spectra = arena_alloc(&pipeline_arena, sizeof(mc_ring_buffer));
+   // raw frames stay 2-byte ADC codes until the filter stage reads them as volts
+   if(!raw || !filtered || !spectra ||
+      !mc_ring_buffer_init_i16_arena(raw, total_channels, RING_CAPACITY_FRAMES, SERIAL_VOLTS_PER_CODE,
+                                     &pipeline_arena) ||
+      !mc_ring_buffer_init_arena(filtered, total_channels, RING_CAPACITY_FRAMES, &pipeline_arena) ||
+      !mc_ring_buffer_init_arena(spectra, total_channels * num_bins, PSD_RING_FRAMES, &pipeline_arena)){
+      fprintf(stderr, "Failed to allocate ring buffers\n");
+      return 1;
+   }
+   // ingestion never waits for compute: drop the oldest raw frames
+   mc_ring_buffer_set_overflow_policy(raw, RB_OVERFLOW_OVERWRITE, 0);
+   // the filter may wait a little for the spectral stage, then drops
+   mc_ring_buffer_set_overflow_policy(filtered, RB_OVERFLOW_BLOCK, FILTER_BLOCK_TIMEOUT_US);
+   // a slow display loses PSD frames rather than stalling the analysis
+   mc_ring_buffer_set_overflow_policy(spectra, RB_OVERFLOW_REJECT, 0);
+
+   // diagnostics are printed by a low-priority thread, one summary per interval
+   telemetry tm;
+   telemetry_init(&tm, stderr, TELEMETRY_INTERVAL_MS);
+
+   filter_stage filter;
+   spectral_stage spectral;
+   output_stage output;
+   psd_output psd_out = { telemetry_channel_open(&tm, "output"), SAMPLE_RATE_HZ / FFT_SIZE };
+   if(!filter_stage_init_arena(&filter, raw, filtered, SAMPLE_RATE_HZ, LINE_FREQ_HZ, BAND_LO_HZ,
+                               BAND_HI_HZ, &pipeline_arena) ||
+      !spectral_stage_init_arena(&spectral, filtered, spectra, FFT_SIZE, FFT_HOP, DSP_WINDOW_HANN,
+                                 PSD_AVERAGES, SAMPLE_RATE_HZ, &pipeline_arena) ||
+      !output_stage_init_arena(&output, spectra, total_channels, on_psd, &psd_out, &pipeline_arena)){
+      fprintf(stderr, "Failed to set up the processing stages\n");
+      return 1;
+   }
+   // large montages: the channels of each hop run in parallel, one FFT setup for all
+   work_pool spectral_pool;
+   bool use_pool = total_channels >= SPECTRAL_POOL_MIN_CHANNELS;
+   if(use_pool){
+      if(!work_pool_init(&spectral_pool, -1)){
+         perror("Failed to create spectral worker threads");
+         return 1;
+      }
+      spectral_stage_set_pool(&spectral, &spectral_pool);
+   }
+   // band powers and PSD frames for the neurofeedback side, raw frames too with $EEG_STREAM_RAW
+   stream_shm out_shm, raw_shm;
+   stream_udp out_udp, raw_udp;
+   stream_sinks out_sinks, raw_sinks = { NULL, NULL };
+   if(!open_sinks(&out_sinks, &out_shm, &out_udp, "", STREAM_SHM_SLOTS, total_channels * num_bins) ||
+      (getenv("EEG_STREAM_RAW") &&
+       !open_sinks(&raw_sinks, &raw_shm, &raw_udp, "_raw", STREAM_RAW_SHM_SLOTS,
+                   total_channels * PIPELINE_CHUNK_FRAMES))){
+      perror("Failed to open the output streams");
+      return 1;
+   }
+   if(out_sinks.shm || out_sinks.udp) output_stage_set_sinks(&output, &out_sinks, SAMPLE_RATE_HZ / FFT_SIZE);
+   if(raw_sinks.shm || raw_sinks.udp) filter_stage_set_sinks(&filter, &raw_sinks);
+
+   // one thread per stage: ingest and output on P-cores, analysis may go to E-cores
+   // the acquisition thread is real-time, woken once per packet, so neither an
+   // E-core nor the GUI can delay draining the port
+   rt_sched_policy ingest_sched = {0};
+   ingest_sched.realtime = true;
+   ingest_sched.period_us = (uint32_t)(frames_per_packet * 1e6f / SAMPLE_RATE_HZ);
+   ingest_sched.computation_us = INGEST_COMPUTATION_US;
+   ingest_sched.constraint_us = INGEST_CONSTRAINT_US;
+   ingest_sched.cpu_mask = ingest_cpu >= 0 ? (uint64_t)1 << ingest_cpu : 0;
+
+   pipeline *pl = malloc(sizeof(pipeline));
+   if(!pl){
+      fprintf(stderr, "Failed to allocate pipeline\n");
+      return 1;
+   }
+   pipeline_init(pl);
+   // one board: a plain reader; several: one thread multiplexing all ports into the aligned stream
+   serial_reader_args reader_args = {0};
+   serial_multi_reader_args *multi_args = calloc(1, sizeof(serial_multi_reader_args));
+   if(!multi_args){
+      fprintf(stderr, "Failed to allocate reader arguments\n");
+      return 1;
+   }
+   bool multi = num_devices > 1;
+   pipeline_stage_config ingest_cfg = { "ingest", PIPELINE_QOS_USER_INTERACTIVE, 0, NULL, serial_reader, &reader_args };
+   if(multi){
+      ingest_cfg.run = serial_multi_reader;
+      ingest_cfg.ctx = multi_args;
+   }
+   pipeline_stage_config filter_cfg = { "filter", PIPELINE_QOS_USER_INITIATED, 0, filter_stage_step, NULL, &filter };
+   pipeline_stage_config spectral_cfg = { "spectral", PIPELINE_QOS_UTILITY, 0, spectral_stage_step, NULL, &spectral };
+   pipeline_stage_config output_cfg = { "output", PIPELINE_QOS_USER_INTERACTIVE, 0, output_stage_step, NULL, &output };
+   pipeline_stage *ingest = pipeline_add_stage(pl, &ingest_cfg);
+   pipeline_stage_set_sched(ingest, &ingest_sched);
+   pipeline_add_stage(pl, &filter_cfg);
+   pipeline_add_stage(pl, &spectral_cfg);
+   pipeline_add_stage(pl, &output_cfg);
+
+   reader_args.fd = sources[0].fd;
+   reader_args.num_channels = num_channels;
+   reader_args.frames_per_packet = frames_per_packet;
+   reader_args.ring = raw;
+   reader_args.tuning = tuning;
+   reader_args.stop = pipeline_stage_stop_flag(ingest);
+   reader_args.telemetry = telemetry_channel_open(&tm, "serial");
+   reader_args.stage = ingest;
+   // sequence gaps filled on the sample grid, board rate estimated per read()
+   sample_clock clock;
+   sample_clock_init(&clock, SAMPLE_RATE_HZ, GAP_FILL_MAX_FRAMES);
+   reader_args.clock = &clock;
+   // several boards: each gets its own clock in the reader, the streams are merged on them
+   for(int d = 0; d < num_devices; d++){
+      multi_args->devices[d].fd = sources[d].fd;
+      multi_args->devices[d].num_channels = num_channels;
+      multi_args->devices[d].frames_per_packet = frames_per_packet;
+   }
+   multi_args->num_devices = num_devices;
+   multi_args->sample_rate = SAMPLE_RATE_HZ;
+   multi_args->max_fill_frames = GAP_FILL_MAX_FRAMES;
+   multi_args->queue_frames = ALIGN_QUEUE_FRAMES;
+   multi_args->ring = raw;
+   multi_args->tuning = tuning;
+   multi_args->stop = reader_args.stop;
+   multi_args->telemetry = reader_args.telemetry;
+   multi_args->stage = ingest;
+   // session recording on its own writer thread, raw frames as they arrive
+   recorder rec;
+   if(argc > 7){
+      if(!recorder_open(&rec, argv[7], total_channels, SAMPLE_RATE_HZ, RECORD_CHUNK_FRAMES,
+                        RECORD_RING_FRAMES)){
+         perror("Failed to create recording");
+         return 1;
+      }
+      reader_args.recorder = &rec;
+      multi_args->recorder = &rec;
+   }
+   // built with METRICS=1: JSON lines to $EEG_METRICS_FILE, stderr if unset
+   METRICS_WATCH_RING("raw", &raw->ring->high_water, raw->ring->max_num_values);
+   METRICS_WATCH_RING("filtered", &filtered->ring->high_water, filtered->ring->max_num_values);
+   METRICS_WATCH_RING("spectra", &spectra->ring->high_water, spectra->ring->max_num_values);
+#ifdef EEG_METRICS
+   const char *metrics_path = getenv("EEG_METRICS_FILE");
+   FILE *metrics_out = metrics_path ? fopen(metrics_path, "w") : stderr;
+   if(!metrics_out || !metrics_export_start(metrics_out, METRICS_INTERVAL_MS)){
+      perror("Failed to start metrics export");
+      return 1;
+   }
+#endif
+   if(!telemetry_start(&tm)){
+      perror("Failed to create telemetry thread");
+      return 1;
+   }
+   // prefault and lock the stage buffers: no page fault or swap-in on the stage threads
+   bool locked = arena_seal(&pipeline_arena, true);
+   fprintf(stderr, "arena: %zu KB in %llu buffers%s\n", arena_used(&pipeline_arena) / 1024,
+           (unsigned long long)pipeline_arena.allocations,
+           locked ? ", locked" : ", not locked (RLIMIT_MEMLOCK), prefaulted only");
+   if(!pipeline_start(pl)){
+      perror("Failed to create pipeline threads");
+      return 1;
+   }
+
+   // run until Ctrl-C, one rate/latency report per second, scheduling jitter now and then
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+   for (int seconds = 1; running; seconds++) {
+      sleep(1);
+      pipeline_report(pl, stderr);
+      if(seconds % JITTER_REPORT_INTERVAL_S == 0) pipeline_report_jitter(pl, stderr);
+   }
+
+   pipeline_stop(pl);
+   if(multi){
+      for(int d = 0; d < num_devices; d++) print_clock(d, &multi_args->devices[d].clock);
+      fprintf(stderr, "aligned %llu frames of %d boards, %llu frames slipped\n",
+              (unsigned long long)multi_args->frames_aligned, num_devices,
+              (unsigned long long)multi_args->frames_slipped);
+   } else {
+      print_clock(0, &clock);
+   }
+   if(reader_args.recorder){
+      if(atomic_load(&rec.frames_dropped) > 0){
+         fprintf(stderr, "recording dropped %llu frames\n",
+                 (unsigned long long)atomic_load(&rec.frames_dropped));
+      }
+      if(!recorder_close(&rec)) fprintf(stderr, "recording %s is incomplete\n", argv[7]);
+   }
+   pipeline_report_jitter(pl, stderr);
+   METRICS_EXPORT_STOP();
+#ifdef EEG_METRICS
+   if(metrics_out != stderr) fclose(metrics_out);
+#endif
+   telemetry_stop(&tm);
+   filter_stage_destroy(&filter);
+   spectral_stage_destroy(&spectral);
+   if(use_pool) work_pool_destroy(&spectral_pool);
+   output_stage_destroy(&output);
+   close_sinks(&out_sinks);
+   close_sinks(&raw_sinks);
+   free(pl);
+   free(multi_args);
+   mc_ring_buffer_deinit(raw);
+   mc_ring_buffer_deinit(filtered);
+   mc_ring_buffer_deinit(spectra);
+   arena_destroy(&pipeline_arena);
+   for(int d = 0; d < num_devices; d++) serial_source_close(&sources[d]);
+   return 0;
+}
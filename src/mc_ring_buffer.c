@@ -0,0 +1,369 @@
+/**
+ * mc_ring_buffer.c
+ *
+ * Implementation of the multi-channel ring buffer on top of spsc_ring_buffer.
+ *
+ * Notes:
+ * - The underlying buffer holds max_num_frames * num_channels floats. Every
+ *   operation moves a multiple of num_channels values, so the fill level,
+ *   the free space and every span boundary stay frame aligned.
+ * - Overwrite mode drops whole frames for the same reason.
+ * - An int16 ring stores the ADC codes as they arrive, half the bytes of
+ *   floats. Reading frames converts them on the way out, in one pass per
+ *   span: vDSP_vflt16() + vDSP_vsmul() on macOS (strided per channel for
+ *   read_planar()), a loop the compiler vectorizes elsewhere.
+ * - Use with mc_ring_buffer.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "mc_ring_buffer.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#endif
+
+// frames per peek/release step in read_planar(), releases space to the producer early
+#define MC_PLANAR_CHUNK 1024
+
+/**
+ * Allocates the spsc ring of either sample type, from an arena or the heap.
+ */
+static bool mc_init(mc_ring_buffer *rb, int num_channels, int capacity, arena *a,
+                    mc_sample_type type, float scale){
+   if(num_channels <= 0 || capacity <= 0) return false;
+   if(capacity > INT_MAX / num_channels) return false;
+   int values = num_channels * capacity;
+   bool codes = type == MC_SAMPLE_I16;
+
+   rb->ring = arena_alloc(a, sizeof(spsc_ring_buffer));
+   if(!rb->ring) return false;
+   bool ok;
+   if(a){
+      void *storage = arena_alloc(a, (codes ? sizeof(int16_t) : sizeof(float32_t)) * (size_t)values);
+      ok = storage && (codes ? spsc_ring_buffer_init_i16_with_storage(rb->ring, storage, values)
+                             : spsc_ring_buffer_init_with_storage(rb->ring, storage, values));
+   } else {
+      ok = codes ? spsc_ring_buffer_init_i16(rb->ring, values) : spsc_ring_buffer_init(rb->ring, values);
+   }
+   if(!ok){
+      arena_free(a, rb->ring);
+      rb->ring = NULL;
+      return false;
+   }
+   rb->num_channels = num_channels;
+   rb->max_num_frames = capacity;
+   rb->sample_type = type;
+   rb->scale = scale;
+   rb->arena = a;
+   return true;
+}
+
+/**
+ * Allocates a multi-channel ring buffer.
+ *
+ * rb is pointer to the ring buffer instance.
+ * num_channels is the number of values per frame.
+ * capacity is the maximum number of frames.
+ * returns true on success, false otherwise
+ */
+bool mc_ring_buffer_init(mc_ring_buffer *rb, int num_channels, int capacity){
+   return mc_init(rb, num_channels, capacity, NULL, MC_SAMPLE_F32, 1.0f);
+}
+
+/**
+ * Places the spsc ring and its storage in an arena.
+ *
+ * rb is pointer to the ring buffer instance.
+ * a is the arena, NULL for the heap.
+ * returns true on success, false otherwise
+ */
+bool mc_ring_buffer_init_arena(mc_ring_buffer *rb, int num_channels, int capacity, arena *a){
+   return mc_init(rb, num_channels, capacity, a, MC_SAMPLE_F32, 1.0f);
+}
+
+/**
+ * Allocates a multi-channel ring buffer of int16 codes.
+ *
+ * rb is pointer to the ring buffer instance.
+ * scale is the float value of one code, applied when frames are read.
+ * returns true on success, false otherwise
+ */
+bool mc_ring_buffer_init_i16(mc_ring_buffer *rb, int num_channels, int capacity, float scale){
+   return mc_init(rb, num_channels, capacity, NULL, MC_SAMPLE_I16, scale);
+}
+
+/**
+ * Places an int16 ring and its storage in an arena.
+ *
+ * rb is pointer to the ring buffer instance.
+ * a is the arena, NULL for the heap.
+ * returns true on success, false otherwise
+ */
+bool mc_ring_buffer_init_i16_arena(mc_ring_buffer *rb, int num_channels, int capacity, float scale,
+                                   arena *a){
+   return mc_init(rb, num_channels, capacity, a, MC_SAMPLE_I16, scale);
+}
+
+/**
+ * out[i * out_stride] = codes[i * stride] * scale for n values.
+ */
+static void mc_codes_to_float(const int16_t *codes, int stride, float scale, float32_t *out,
+                              int out_stride, int n){
+   if(n <= 0) return;
+#if defined(__APPLE__)
+   vDSP_vflt16(codes, stride, out, out_stride, (vDSP_Length)n);
+   vDSP_vsmul(out, out_stride, &scale, out, out_stride, (vDSP_Length)n);
+#else
+   for(int i = 0; i < n; i++) out[(size_t)i * out_stride] = codes[(size_t)i * stride] * scale;
+#endif
+}
+
+bool mc_ring_buffer_set_overflow_policy(mc_ring_buffer *rb,
+                                        ring_buffer_overflow_policy policy,
+                                        int timeout_us){
+   return spsc_ring_buffer_set_overflow_policy(rb->ring, policy, timeout_us);
+}
+
+/**
+ * Write num_frames interleaved frames. Producer only.
+ * returns the number of frames written.
+ */
+int mc_ring_buffer_write_frames(mc_ring_buffer *rb, const float32_t *frames, int num_frames){
+   if(num_frames <= 0 || rb->sample_type != MC_SAMPLE_F32) return 0;
+   if(num_frames > rb->max_num_frames){
+      // the ring would drop or reject the excess anyway, keep it frame aligned
+      if(rb->ring->overflow_policy == RB_OVERFLOW_OVERWRITE){
+         frames += (size_t)(num_frames - rb->max_num_frames) * rb->num_channels;
+      }
+      num_frames = rb->max_num_frames;
+   }
+   return spsc_ring_buffer_write_n(rb->ring, frames, num_frames * rb->num_channels)
+          / rb->num_channels;
+}
+
+/**
+ * Write num_frames interleaved frames of int16 codes. Producer only.
+ * returns the number of frames written.
+ */
+int mc_ring_buffer_write_codes(mc_ring_buffer *rb, const int16_t *codes, int num_frames){
+   if(num_frames <= 0 || rb->sample_type != MC_SAMPLE_I16) return 0;
+   if(num_frames > rb->max_num_frames){
+      if(rb->ring->overflow_policy == RB_OVERFLOW_OVERWRITE){
+         codes += (size_t)(num_frames - rb->max_num_frames) * rb->num_channels;
+      }
+      num_frames = rb->max_num_frames;
+   }
+   return spsc_ring_buffer_write_n_i16(rb->ring, codes, num_frames * rb->num_channels)
+          / rb->num_channels;
+}
+
+/**
+ * Peek up to num_frames frames of an int16 ring and convert them with
+ * convert(), then release them; repeats a window the producer overwrote.
+ * returns the number of frames read.
+ */
+static int mc_read_codes(mc_ring_buffer *rb, int num_frames,
+                         void (*convert)(const mc_ring_buffer *rb, const int16_t *codes, int num_frames,
+                                         int out, void *dst),
+                         void *dst){
+   int nch = rb->num_channels;
+   while(1){
+      ring_buffer_span_i16 spans[2];
+      int n = spsc_ring_buffer_peek_i16(rb->ring, num_frames * nch, spans) / nch;
+      if(n == 0) return 0;
+      int first = spans[0].len / nch;
+      convert(rb, spans[0].ptr, first, 0, dst);
+      convert(rb, spans[1].ptr, n - first, first, dst);
+      // in overwrite mode the producer may have dropped part of the window
+      if(spsc_ring_buffer_release(rb->ring, n * nch)) return n;
+   }
+}
+
+// interleaved frames, frame f of the run goes to frame out + f
+static void convert_interleaved(const mc_ring_buffer *rb, const int16_t *codes, int num_frames,
+                                int out, void *dst){
+   float32_t *frames = (float32_t *)dst + (size_t)out * rb->num_channels;
+   mc_codes_to_float(codes, 1, rb->scale, frames, 1, num_frames * rb->num_channels);
+}
+
+// the codes as they are, frame f of the run goes to frame out + f
+static void convert_copy(const mc_ring_buffer *rb, const int16_t *codes, int num_frames,
+                         int out, void *dst){
+   int16_t *frames = (int16_t *)dst + (size_t)out * rb->num_channels;
+   memcpy(frames, codes, sizeof(int16_t) * (size_t)num_frames * (size_t)rb->num_channels);
+}
+
+// destination of read_planar(): one array per channel, filled from frame first
+typedef struct {
+   float32_t **channels;
+   int first;
+} mc_planar_dst;
+
+// one array per channel: deinterleave and convert in the same pass
+static void convert_planar(const mc_ring_buffer *rb, const int16_t *codes, int num_frames,
+                           int out, void *dst){
+   const mc_planar_dst *p = (const mc_planar_dst *)dst;
+   for(int c = 0; c < rb->num_channels; c++){
+      mc_codes_to_float(codes + c, rb->num_channels, rb->scale, p->channels[c] + p->first + out, 1,
+                        num_frames);
+   }
+}
+
+/**
+ * Read up to num_frames interleaved frames. Consumer only.
+ * returns the number of frames read.
+ */
+int mc_ring_buffer_read_frames(mc_ring_buffer *rb, float32_t *frames, int num_frames){
+   if(num_frames <= 0) return 0;
+   if(num_frames > rb->max_num_frames) num_frames = rb->max_num_frames;
+   if(rb->sample_type == MC_SAMPLE_I16) return mc_read_codes(rb, num_frames, convert_interleaved, frames);
+   return spsc_ring_buffer_read_n(rb->ring, frames, num_frames * rb->num_channels)
+          / rb->num_channels;
+}
+
+/**
+ * Read up to num_frames interleaved frames of an int16 ring as codes.
+ * Consumer only.
+ * returns the number of frames read, 0 for a float ring.
+ */
+int mc_ring_buffer_read_codes(mc_ring_buffer *rb, int16_t *codes, int num_frames){
+   if(num_frames <= 0 || rb->sample_type != MC_SAMPLE_I16) return 0;
+   if(num_frames > rb->max_num_frames) num_frames = rb->max_num_frames;
+   return mc_read_codes(rb, num_frames, convert_copy, codes);
+}
+
+/**
+ * Read up to num_frames frames into one array per channel. Consumer only.
+ *
+ * Works on the peeked window in place (no intermediate copy): for each
+ * frame the channels are read sequentially and scattered to the outputs.
+ * returns the number of frames read.
+ */
+int mc_ring_buffer_read_planar(mc_ring_buffer *rb, float32_t **channels, int num_frames){
+   int total = 0;
+   int nch = rb->num_channels;
+   if(rb->sample_type == MC_SAMPLE_I16){
+      while(total < num_frames){
+         int want = num_frames - total;
+         if(want > MC_PLANAR_CHUNK) want = MC_PLANAR_CHUNK;
+         mc_planar_dst dst = { channels, total };
+         int n = mc_read_codes(rb, want, convert_planar, &dst);
+         if(n == 0) break;
+         total += n;
+      }
+      return total;
+   }
+   while(total < num_frames){
+      int want = num_frames - total;
+      if(want > MC_PLANAR_CHUNK) want = MC_PLANAR_CHUNK;
+
+      mc_ring_buffer_view view;
+      int n = mc_ring_buffer_peek(rb, want, &view);
+      if(n == 0) break;
+
+      int out = total;
+      for(int s = 0; s < 2; s++){
+         const float32_t *frame = view.spans[s].frames;
+         for(int f = 0; f < view.spans[s].num_frames; f++, out++, frame += nch){
+            for(int c = 0; c < nch; c++){
+               channels[c][out] = frame[c];
+            }
+         }
+      }
+      // in overwrite mode the producer may have dropped part of the window
+      if(!mc_ring_buffer_release(rb, n)) continue;
+      total += n;
+   }
+   return total;
+}
+
+/**
+ * Convert float spans of the underlying ring into frame spans.
+ */
+static void mc_view_from_spans(mc_ring_buffer *rb, const ring_buffer_span spans[2],
+                               mc_ring_buffer_view *view){
+   for(int s = 0; s < 2; s++){
+      view->spans[s].frames = spans[s].ptr;
+      view->spans[s].num_frames = spans[s].len / rb->num_channels;
+   }
+   view->num_channels = rb->num_channels;
+}
+
+int mc_ring_buffer_reserve(mc_ring_buffer *rb, int num_frames, mc_ring_buffer_view *view){
+   if(num_frames < 0 || rb->sample_type != MC_SAMPLE_F32) num_frames = 0;
+   if(num_frames > rb->max_num_frames) num_frames = rb->max_num_frames;
+   ring_buffer_span spans[2];
+   int n = spsc_ring_buffer_reserve(rb->ring, num_frames * rb->num_channels, spans);
+   mc_view_from_spans(rb, spans, view);
+   return n / rb->num_channels;
+}
+
+bool mc_ring_buffer_commit(mc_ring_buffer *rb, int num_frames){
+   if(num_frames < 0 || num_frames > rb->max_num_frames) return false;
+   return spsc_ring_buffer_commit(rb->ring, num_frames * rb->num_channels);
+}
+
+int mc_ring_buffer_peek(mc_ring_buffer *rb, int num_frames, mc_ring_buffer_view *view){
+   if(num_frames < 0 || rb->sample_type != MC_SAMPLE_F32) num_frames = 0;
+   if(num_frames > rb->max_num_frames) num_frames = rb->max_num_frames;
+   ring_buffer_span spans[2];
+   int n = spsc_ring_buffer_peek(rb->ring, num_frames * rb->num_channels, spans);
+   mc_view_from_spans(rb, spans, view);
+   return n / rb->num_channels;
+}
+
+bool mc_ring_buffer_release(mc_ring_buffer *rb, int num_frames){
+   if(num_frames < 0 || num_frames > rb->max_num_frames) return false;
+   return spsc_ring_buffer_release(rb->ring, num_frames * rb->num_channels);
+}
+
+/**
+ * Strided view of one channel: the channel's first sample in the span,
+ * samples num_channels floats apart.
+ */
+mc_channel_span mc_ring_buffer_channel(const mc_ring_buffer_view *view, int span, int channel){
+   mc_channel_span ch;
+   ch.ptr = view->spans[span].frames + channel;
+   ch.stride = view->num_channels;
+   ch.len = view->spans[span].num_frames;
+   return ch;
+}
+
+int mc_ring_buffer_num_frames(mc_ring_buffer *rb){
+   return spsc_ring_buffer_size(rb->ring) / rb->num_channels;
+}
+
+/**
+ * Free the ring, keep the struct.
+ *
+ * rb is pointer to the ring buffer instance.
+ * return void
+ */
+void mc_ring_buffer_deinit(mc_ring_buffer *rb){
+   if (!rb) return;
+
+   if(rb->arena){
+      spsc_ring_buffer_deinit(rb->ring); // storage and struct belong to the arena
+   } else {
+      spsc_ring_buffer_destroy(rb->ring); // frees the spsc struct too
+   }
+   rb->ring = NULL; // safety
+}
+
+/**
+ * Free the allocated memory from the ring buffer, struct included.
+ *
+ * rb is pointer to the ring buffer instance.
+ * return void
+ */
+void mc_ring_buffer_destroy(mc_ring_buffer *rb){
+   if (!rb) return; // if already null, nothing to do
+
+   mc_ring_buffer_deinit(rb);
+   free(rb);
+}
@@ -0,0 +1,228 @@
+/**
+ * metrics.c
+ *
+ * Implementation of the metrics slots, the ring registry and the JSON
+ * lines exporter.
+ *
+ * Notes:
+ * - Slots are claimed with one atomic increment and published with a
+ *   release store of their ready flag, the exporter only reads ready slots.
+ * - The exporter keeps a copy of every slot's counters and histogram from
+ *   the previous export (it is the only thread touching them), so rates
+ *   and percentiles are per interval while the slots only ever grow.
+ * - The exporter thread runs at the priority of the telemetry thread (QoS
+ *   utility on macOS, SCHED_IDLE on Linux).
+ * - Compiles to nothing without EEG_METRICS.
+ * - Use with metrics.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // SCHED_IDLE
+#endif
+
+#include "metrics.h"
+
+#ifdef EEG_METRICS
+
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__APPLE__)
+#include <pthread/qos.h>
+#endif
+
+typedef struct {
+   char name[METRICS_NAME_LEN];
+   const atomic_uint *high_water;
+   unsigned int capacity;
+} metrics_ring;
+
+// what the previous export saw of a slot, owned by the exporting thread
+typedef struct {
+   uint64_t counters[METRIC_NUM_COUNTERS];
+   uint64_t latency[METRICS_LATENCY_BUCKETS];
+} metrics_prev;
+
+_Thread_local metrics_slot *metrics_current = NULL;
+
+static metrics_slot slots[METRICS_MAX_SLOTS];
+static atomic_bool slot_ready[METRICS_MAX_SLOTS];
+static atomic_uint num_claimed = 0;
+static metrics_slot overflow_slot; // threads beyond METRICS_MAX_SLOTS, not exported
+
+static metrics_ring rings[METRICS_MAX_RINGS];
+static atomic_int num_rings = 0;
+
+static metrics_prev prev[METRICS_MAX_SLOTS];
+static _Atomic uint64_t start_ns = 0; // first slot claimed, t_s = 0
+static uint64_t prev_ns = 0;
+
+static struct {
+   FILE *out;
+   int interval_ms;
+   pthread_t thread;
+   bool running;
+   atomic_bool stop;
+} exporter;
+
+static uint64_t metrics_clock_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// nanoseconds per tick
+static double metrics_tick_ns(void){
+#if defined(__APPLE__)
+   mach_timebase_info_data_t tb;
+   mach_timebase_info(&tb);
+   return (double)tb.numer / (double)tb.denom;
+#else
+   return 1.0;
+#endif
+}
+
+metrics_slot *metrics_thread(const char *name){
+   uint64_t unset = 0;
+   atomic_compare_exchange_strong(&start_ns, &unset, metrics_clock_ns());
+   unsigned int i = atomic_fetch_add(&num_claimed, 1);
+   metrics_slot *slot = i < METRICS_MAX_SLOTS ? &slots[i] : &overflow_slot;
+   if(i < METRICS_MAX_SLOTS){
+      strncpy(slot->name, name, METRICS_NAME_LEN - 1);
+      slot->name[METRICS_NAME_LEN - 1] = '\0';
+      atomic_store_explicit(&slot_ready[i], true, memory_order_release);
+   }
+   metrics_current = slot;
+   return slot;
+}
+
+bool metrics_watch_ring(const char *name, const atomic_uint *high_water, unsigned int capacity){
+   int i = atomic_load(&num_rings);
+   if(i == METRICS_MAX_RINGS) return false;
+   strncpy(rings[i].name, name, METRICS_NAME_LEN - 1);
+   rings[i].name[METRICS_NAME_LEN - 1] = '\0';
+   rings[i].high_water = high_water;
+   rings[i].capacity = capacity;
+   atomic_store(&num_rings, i + 1);
+   return true;
+}
+
+const metrics_slot *metrics_find(const char *name){
+   unsigned int n = atomic_load(&num_claimed);
+   if(n > METRICS_MAX_SLOTS) n = METRICS_MAX_SLOTS;
+   for(unsigned int i = 0; i < n; i++){
+      if(atomic_load_explicit(&slot_ready[i], memory_order_acquire) &&
+         strncmp(slots[i].name, name, METRICS_NAME_LEN) == 0) return &slots[i];
+   }
+   return NULL;
+}
+
+double metrics_bucket_us(int bucket){
+   return (double)(1ull << bucket) * metrics_tick_ns() * 1e-3;
+}
+
+// upper bound of the bucket holding the p-th fraction of the interval's latencies
+static double interval_percentile_us(const uint64_t *delta, uint64_t count, double p){
+   uint64_t rank = (uint64_t)(p * (double)count);
+   if(rank >= count) rank = count - 1;
+   uint64_t seen = 0;
+   for(int i = 0; i < METRICS_LATENCY_BUCKETS; i++){
+      seen += delta[i];
+      if(seen > rank) return metrics_bucket_us(i);
+   }
+   return metrics_bucket_us(METRICS_LATENCY_BUCKETS - 1);
+}
+
+static const char *counter_names[METRIC_NUM_COUNTERS] = {
+   "samples_in", "samples_out", "drops", "read_calls", "bytes_read", "wait_calls"
+};
+
+void metrics_export(FILE *out){
+   uint64_t now = metrics_clock_ns();
+   uint64_t start = atomic_load(&start_ns);
+   if(start == 0) start = now;
+   if(prev_ns == 0) prev_ns = start;
+   double seconds = (now - prev_ns) * 1e-9;
+   if(seconds <= 0.0) seconds = 1e-9;
+   double t_s = (now - start) * 1e-9;
+   prev_ns = now;
+
+   unsigned int n = atomic_load(&num_claimed);
+   if(n > METRICS_MAX_SLOTS) n = METRICS_MAX_SLOTS;
+   for(unsigned int i = 0; i < n; i++){
+      if(!atomic_load_explicit(&slot_ready[i], memory_order_acquire)) continue;
+      metrics_slot *slot = &slots[i];
+      metrics_prev *last = &prev[i];
+      fprintf(out, "{\"t_s\":%.3f,\"thread\":\"%s\"", t_s, slot->name);
+      for(int c = 0; c < METRIC_NUM_COUNTERS; c++){
+         uint64_t v = atomic_load_explicit(&slot->counters[c], memory_order_relaxed);
+         fprintf(out, ",\"%s_per_s\":%.1f", counter_names[c], (v - last->counters[c]) / seconds);
+         last->counters[c] = v;
+      }
+      uint64_t delta[METRICS_LATENCY_BUCKETS];
+      uint64_t count = 0;
+      for(int b = 0; b < METRICS_LATENCY_BUCKETS; b++){
+         uint64_t v = atomic_load_explicit(&slot->latency[b], memory_order_relaxed);
+         delta[b] = v - last->latency[b];
+         last->latency[b] = v;
+         count += delta[b];
+      }
+      fprintf(out, ",\"latency_count\":%llu", (unsigned long long)count);
+      if(count > 0){
+         fprintf(out, ",\"latency_p50_us\":%.1f,\"latency_p99_us\":%.1f,\"latency_p999_us\":%.1f",
+                 interval_percentile_us(delta, count, 0.5),
+                 interval_percentile_us(delta, count, 0.99),
+                 interval_percentile_us(delta, count, 0.999));
+      }
+      uint64_t max = atomic_load_explicit(&slot->latency_max, memory_order_relaxed);
+      fprintf(out, ",\"latency_max_us\":%.1f}\n", max * metrics_tick_ns() * 1e-3);
+   }
+
+   int num = atomic_load(&num_rings);
+   for(int i = 0; i < num; i++){
+      unsigned int hw = atomic_load_explicit(rings[i].high_water, memory_order_relaxed);
+      fprintf(out, "{\"t_s\":%.3f,\"ring\":\"%s\",\"capacity\":%u,\"high_water\":%u}\n",
+              t_s, rings[i].name, rings[i].capacity, hw);
+   }
+   fflush(out);
+}
+
+static void *exporter_thread(void *arg){
+   (void)arg;
+#if defined(__APPLE__)
+   pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined(__linux__)
+   struct sched_param param = { .sched_priority = 0 };
+   pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+   struct timespec tick = { exporter.interval_ms / 1000, (long)(exporter.interval_ms % 1000) * 1000000L };
+   while(!atomic_load(&exporter.stop)){
+      nanosleep(&tick, NULL);
+      metrics_export(exporter.out);
+   }
+   return NULL;
+}
+
+bool metrics_export_start(FILE *out, int interval_ms){
+   if(exporter.running || !out || interval_ms <= 0) return false;
+   exporter.out = out;
+   exporter.interval_ms = interval_ms;
+   atomic_store(&exporter.stop, false);
+   if(pthread_create(&exporter.thread, NULL, exporter_thread, NULL) != 0) return false;
+   exporter.running = true;
+   return true;
+}
+
+void metrics_export_stop(void){
+   if(!exporter.running) return;
+   atomic_store(&exporter.stop, true);
+   pthread_join(exporter.thread, NULL);
+   exporter.running = false;
+   metrics_export(exporter.out);
+}
+
+#endif
@@ -0,0 +1,322 @@
+/**
+ * pipeline.c
+ *
+ * Implementation of the pipeline runtime: stage threads, stamp queues and
+ * per-stage statistics.
+ *
+ * Notes:
+ * - Stamp queues have free-running head/tail counters with a power-of-two
+ *   size, like the telemetry queues. A full queue drops the stamp: latency
+ *   is then measured on fewer batches, data is never held back.
+ * - On Linux the QoS class maps to a nice value of the stage thread, the
+ *   closest unprivileged equivalent; negative values need privileges and
+ *   are left at the default.
+ * - The scheduling policy is applied after the QoS class: on macOS a
+ *   time-constraint thread is no longer scheduled by its QoS class.
+ * - Use with pipeline.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // syscall(SYS_gettid)
+#endif
+
+#include "pipeline.h"
+#include "metrics.h"
+#include <string.h>
+#include <time.h>
+
+#if defined(__APPLE__)
+#include <pthread/qos.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define PIPELINE_STAMP_MASK (PIPELINE_STAMP_QUEUE_SIZE - 1)
+
+_Static_assert((PIPELINE_STAMP_QUEUE_SIZE & PIPELINE_STAMP_MASK) == 0,
+               "PIPELINE_STAMP_QUEUE_SIZE must be a power of two");
+
+uint64_t pipeline_now_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/************************** Stamp queue **************************/
+
+static void stamps_init(pipeline_stamp_queue *q){
+   atomic_init(&q->head, 0);
+   atomic_init(&q->tail, 0);
+}
+
+// producer side, drops the stamp when the queue is full
+static void stamps_push(pipeline_stamp_queue *q, uint64_t frame, uint64_t ingest_ns, uint64_t ready_ns){
+   unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+   unsigned int head = atomic_load_explicit(&q->head, memory_order_acquire);
+   if(tail - head == PIPELINE_STAMP_QUEUE_SIZE) return;
+   q->items[tail & PIPELINE_STAMP_MASK].frame = frame;
+   q->items[tail & PIPELINE_STAMP_MASK].ingest_ns = ingest_ns;
+   q->items[tail & PIPELINE_STAMP_MASK].ready_ns = ready_ns;
+   atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+}
+
+// consumer side: pops the stamps up to position, the newest one in *newest
+static bool stamps_pop_until(pipeline_stamp_queue *q, uint64_t position, pipeline_stamp *newest){
+   unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+   unsigned int tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+   bool found = false;
+   while(head != tail && q->items[head & PIPELINE_STAMP_MASK].frame <= position){
+      *newest = q->items[head & PIPELINE_STAMP_MASK];
+      found = true;
+      head++;
+   }
+   atomic_store_explicit(&q->head, head, memory_order_release);
+   return found;
+}
+
+/***************************** Stats *****************************/
+
+static void stat_add(_Atomic uint64_t *counter, uint64_t n){
+   // single writer per counter: a plain load/store pair is enough
+   atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                         memory_order_relaxed);
+}
+
+static void stat_max(_Atomic uint64_t *counter, uint64_t v){
+   // the reporter resets the maximum concurrently, so compare-and-swap
+   uint64_t old = atomic_load_explicit(counter, memory_order_relaxed);
+   while(v > old && !atomic_compare_exchange_weak_explicit(counter, &old, v, memory_order_relaxed,
+                                                           memory_order_relaxed)){
+   }
+}
+
+static void stats_init(pipeline_stats *s){
+   atomic_init(&s->frames_in, 0);
+   atomic_init(&s->frames_out, 0);
+   atomic_init(&s->dropped, 0);
+   atomic_init(&s->latency_count, 0);
+   atomic_init(&s->latency_sum_ns, 0);
+   atomic_init(&s->latency_max_ns, 0);
+}
+
+void pipeline_stage_ingested(pipeline_stage *stage, int frames, int dropped){
+   if(dropped > 0) stat_add(&stage->stats.dropped, (uint64_t)dropped);
+   if(frames <= 0) return;
+   stage->out_frames += (uint64_t)frames;
+   stat_add(&stage->stats.frames_in, (uint64_t)(frames + (dropped > 0 ? dropped : 0)));
+   stat_add(&stage->stats.frames_out, (uint64_t)frames);
+   uint64_t now = pipeline_now_ns();
+   if(stage->trace){
+      pipeline_trace t = { stage->out_frames, now, now, now, now };
+      stage->trace(&t, stage->trace_ctx);
+   }
+   stamps_push(&stage->out_stamps, stage->out_frames, now, now);
+}
+
+void pipeline_stage_wakeup(pipeline_stage *stage, uint64_t expected_ns){
+   uint64_t now = pipeline_now_ns();
+   rt_jitter_record(&stage->jitter, now > expected_ns ? now - expected_ns : 0);
+}
+
+void pipeline_stage_consumed(pipeline_stage *stage, int frames, uint64_t position){
+   if(frames > 0) stat_add(&stage->stats.frames_in, (uint64_t)frames);
+   if(!stage->in_stamps) return;
+   pipeline_stamp newest = {0};
+   if(stamps_pop_until(stage->in_stamps, position, &newest)){
+      stage->pending_ns = newest.ingest_ns;
+      stage->pending_ready_ns = newest.ready_ns;
+      if(stage->trace) stage->pending_consumed_ns = pipeline_now_ns();
+      stage->have_pending = true;
+   }
+}
+
+void pipeline_stage_produced(pipeline_stage *stage, int frames, int dropped){
+   if(dropped > 0) stat_add(&stage->stats.dropped, (uint64_t)dropped);
+   if(frames <= 0) return;
+   stage->out_frames += (uint64_t)frames;
+   stat_add(&stage->stats.frames_out, (uint64_t)frames);
+   if(!stage->have_pending) return;
+
+   uint64_t now = pipeline_now_ns();
+   uint64_t latency = now - stage->pending_ns;
+   stat_add(&stage->stats.latency_count, 1);
+   stat_add(&stage->stats.latency_sum_ns, latency);
+   stat_max(&stage->stats.latency_max_ns, latency);
+   if(stage->trace){
+      pipeline_trace t = { stage->out_frames, stage->pending_ns, stage->pending_ready_ns,
+                           stage->pending_consumed_ns, now };
+      stage->trace(&t, stage->trace_ctx);
+   }
+   stamps_push(&stage->out_stamps, stage->out_frames, stage->pending_ns, now);
+   stage->have_pending = false;
+}
+
+/**************************** Threads ****************************/
+
+static void apply_qos(pipeline_qos qos){
+#if defined(__APPLE__)
+   qos_class_t cls;
+   switch(qos){
+      case PIPELINE_QOS_USER_INTERACTIVE: cls = QOS_CLASS_USER_INTERACTIVE; break;
+      case PIPELINE_QOS_USER_INITIATED: cls = QOS_CLASS_USER_INITIATED; break;
+      case PIPELINE_QOS_UTILITY: cls = QOS_CLASS_UTILITY; break;
+      case PIPELINE_QOS_BACKGROUND: cls = QOS_CLASS_BACKGROUND; break;
+      default: return;
+   }
+   pthread_set_qos_class_self_np(cls, 0);
+#elif defined(__linux__)
+   int nice_value;
+   switch(qos){
+      case PIPELINE_QOS_UTILITY: nice_value = 5; break;
+      case PIPELINE_QOS_BACKGROUND: nice_value = 10; break;
+      default: return;
+   }
+   setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice_value);
+#else
+   (void)qos;
+#endif
+}
+
+static void *stage_thread(void *arg){
+   pipeline_stage *stage = (pipeline_stage *)arg;
+   METRICS_THREAD(stage->name);
+   apply_qos(stage->qos);
+   if(!rt_sched_apply(&stage->sched)) atomic_store(&stage->sched_ok, false);
+   if(stage->run) return stage->run(stage->ctx);
+
+   struct timespec idle = { 0, (long)stage->idle_us * 1000L };
+   while(!atomic_load_explicit(&stage->stop, memory_order_acquire)){
+      METRICS_TIMER_START(busy);
+      if(stage->step(stage, stage->ctx) == 0){
+         // anything past idle_us is time spent waiting for the CPU
+         uint64_t due = pipeline_now_ns() + (uint64_t)stage->idle_us * 1000u;
+         nanosleep(&idle, NULL);
+         pipeline_stage_wakeup(stage, due);
+      } else {
+         METRICS_TIMER_STOP(busy);
+      }
+   }
+   // upstream has exited before the flag was set: drain what it left
+   while(stage->step(stage, stage->ctx) > 0){
+   }
+   return NULL;
+}
+
+void pipeline_init(pipeline *p){
+   p->num_stages = 0;
+   p->running = false;
+   p->report_ns = pipeline_now_ns();
+}
+
+pipeline_stage *pipeline_add_stage(pipeline *p, const pipeline_stage_config *config){
+   if(p->running || p->num_stages == PIPELINE_MAX_STAGES) return NULL;
+   if(!config || !config->name || (config->step == NULL) == (config->run == NULL)) return NULL;
+
+   pipeline_stage *stage = &p->stages[p->num_stages];
+   memset(stage, 0, sizeof(*stage));
+   strncpy(stage->name, config->name, PIPELINE_NAME_LEN - 1);
+   stage->qos = config->qos;
+   stage->idle_us = config->idle_us > 0 ? config->idle_us : PIPELINE_IDLE_US;
+   stage->step = config->step;
+   stage->run = config->run;
+   stage->ctx = config->ctx;
+   atomic_init(&stage->sched_ok, true);
+   atomic_init(&stage->stop, false);
+   stage->in_stamps = p->num_stages > 0 ? &p->stages[p->num_stages - 1].out_stamps : NULL;
+   stamps_init(&stage->out_stamps);
+   stats_init(&stage->stats);
+   rt_jitter_init(&stage->jitter);
+   p->num_stages++;
+   return stage;
+}
+
+bool pipeline_start(pipeline *p){
+   if(p->running || p->num_stages == 0) return false;
+   for(int i = 0; i < p->num_stages; i++) atomic_store(&p->stages[i].stop, false);
+   p->running = true;
+   p->report_ns = pipeline_now_ns();
+   for(int i = p->num_stages - 1; i >= 0; i--){
+      pipeline_stage *stage = &p->stages[i];
+      if(pthread_create(&stage->thread, NULL, stage_thread, stage) != 0){
+         pipeline_stop(p);
+         return false;
+      }
+      stage->started = true;
+   }
+   return true;
+}
+
+void pipeline_stop(pipeline *p){
+   if(!p->running) return;
+   for(int i = 0; i < p->num_stages; i++){
+      atomic_store_explicit(&p->stages[i].stop, true, memory_order_release);
+      if(p->stages[i].started) pthread_join(p->stages[i].thread, NULL);
+      p->stages[i].started = false;
+   }
+   p->running = false;
+}
+
+void pipeline_stage_set_sched(pipeline_stage *stage, const rt_sched_policy *policy){
+   stage->sched = *policy;
+}
+
+void pipeline_stage_set_trace(pipeline_stage *stage, pipeline_trace_fn fn, void *ctx){
+   stage->trace = fn;
+   stage->trace_ctx = ctx;
+}
+
+const atomic_bool *pipeline_stage_stop_flag(pipeline_stage *stage){
+   return &stage->stop;
+}
+
+void pipeline_report(pipeline *p, FILE *out){
+   uint64_t now = pipeline_now_ns();
+   double seconds = (now - p->report_ns) * 1e-9;
+   if(seconds <= 0.0) seconds = 1e-9;
+   p->report_ns = now;
+   for(int i = 0; i < p->num_stages; i++){
+      pipeline_stage *stage = &p->stages[i];
+      pipeline_stats *s = &stage->stats;
+      uint64_t in = atomic_load_explicit(&s->frames_in, memory_order_relaxed);
+      uint64_t produced = atomic_load_explicit(&s->frames_out, memory_order_relaxed);
+      uint64_t dropped = atomic_load_explicit(&s->dropped, memory_order_relaxed);
+      uint64_t count = atomic_load_explicit(&s->latency_count, memory_order_relaxed);
+      uint64_t sum = atomic_load_explicit(&s->latency_sum_ns, memory_order_relaxed);
+      uint64_t max = atomic_exchange_explicit(&s->latency_max_ns, 0, memory_order_relaxed);
+
+      uint64_t lat_count = count - stage->reported_latency_count;
+      double mean_ms = lat_count ? (sum - stage->reported_latency_sum_ns) * 1e-6 / lat_count : 0.0;
+      fprintf(out, "[pipeline] %s: %.1f frames/s in, %.1f out, dropped %llu, "
+              "latency mean %.2f ms max %.2f ms\n", stage->name,
+              (in - stage->reported_in) / seconds, (produced - stage->reported_out) / seconds,
+              (unsigned long long)(dropped - stage->reported_dropped), mean_ms, max * 1e-6);
+
+      stage->reported_in = in;
+      stage->reported_out = produced;
+      stage->reported_dropped = dropped;
+      stage->reported_latency_count = count;
+      stage->reported_latency_sum_ns = sum;
+   }
+   fflush(out);
+}
+
+void pipeline_report_jitter(pipeline *p, FILE *out){
+   for(int i = 0; i < p->num_stages; i++){
+      pipeline_stage *stage = &p->stages[i];
+      rt_jitter_snapshot s;
+      rt_jitter_read(&stage->jitter, &s);
+      bool refused = !atomic_load(&stage->sched_ok);
+      fprintf(out, "[jitter] %s (%s%s): %llu wakeups, p50 < %llu us, p99 < %llu us, "
+              "p99.9 < %llu us, max %.3f ms\n", stage->name, rt_sched_name(&stage->sched),
+              refused ? ", refused" : "", (unsigned long long)s.count,
+              (unsigned long long)rt_jitter_percentile_us(&s, 50.0),
+              (unsigned long long)rt_jitter_percentile_us(&s, 99.0),
+              (unsigned long long)rt_jitter_percentile_us(&s, 99.9), s.max_ns * 1e-6);
+   }
+   fflush(out);
+}
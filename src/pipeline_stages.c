@@ -0,0 +1,253 @@
+/**
+ * pipeline_stages.c
+ *
+ * Filter, spectral and output stages of the EEG pipeline.
+ *
+ * Notes:
+ * - The position passed to pipeline_stage_consumed() counts frames the input
+ *   ring overwrote as consumed, so stamps stay aligned with the data when
+ *   the ingest edge drops frames.
+ * - The spectral stage deinterleaves each chunk into one small ring per
+ *   channel (produced and consumed on the stage thread) and runs the
+ *   channels' engines in lockstep, one PSD frame per hop. With a pool the
+ *   stage thread still owns the rings; only the per-channel analysis runs
+ *   on the workers.
+ * - Sinks publish before the stage's own work on the same data: the raw
+ *   frames before filtering, band powers and PSD before the callback.
+ * - The `*_init_arena()` variants place every buffer of a stage, the small
+ *   per-channel rings included, in the arena; destroy then frees nothing
+ *   the arena owns.
+ * - Use with pipeline_stages.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "pipeline_stages.h"
+#include <stdlib.h>
+#include <string.h>
+
+// input frames consumed so far, including frames the ring overwrote
+static uint64_t input_position(mc_ring_buffer *in, uint64_t consumed){
+   return consumed + spsc_ring_buffer_num_overwritten(in->ring) / (uint64_t)in->num_channels;
+}
+
+/***************************** Filter *****************************/
+
+bool filter_stage_init(filter_stage *f, mc_ring_buffer *in, mc_ring_buffer *out,
+                       float sample_rate, float line_hz, float lo_hz, float hi_hz){
+   return filter_stage_init_arena(f, in, out, sample_rate, line_hz, lo_hz, hi_hz, NULL);
+}
+
+bool filter_stage_init_arena(filter_stage *f, mc_ring_buffer *in, mc_ring_buffer *out,
+                             float sample_rate, float line_hz, float lo_hz, float hi_hz, arena *a){
+   if(!in || !out || in->num_channels != out->num_channels) return false;
+   memset(f, 0, sizeof(*f));
+   f->in = in;
+   f->out = out;
+   f->arena = a;
+   if(!dsp_biquad_cascade_init_eeg_arena(&f->cascade, in->num_channels, sample_rate, line_hz, lo_hz,
+                                         hi_hz, a)){
+      return false;
+   }
+   f->frames = arena_alloc(a, sizeof(float) * PIPELINE_CHUNK_FRAMES * in->num_channels);
+   if(!f->frames){
+      dsp_biquad_cascade_destroy(&f->cascade);
+      return false;
+   }
+   return true;
+}
+
+int filter_stage_step(pipeline_stage *stage, void *ctx){
+   filter_stage *f = (filter_stage *)ctx;
+   int n = mc_ring_buffer_read_frames(f->in, f->frames, PIPELINE_CHUNK_FRAMES);
+   if(n == 0) return 0;
+   f->consumed += (uint64_t)n;
+   pipeline_stage_consumed(stage, n, input_position(f->in, f->consumed));
+   if(f->raw_sinks){
+      int nch = f->in->num_channels;
+      stream_sinks_publish(f->raw_sinks, STREAM_RAW, nch, f->frames, n * nch, pipeline_now_ns());
+      if(f->raw_sinks->udp) stream_udp_flush(f->raw_sinks->udp);
+   }
+
+   dsp_biquad_cascade_process(&f->cascade, f->frames, f->frames, n);
+   int written = mc_ring_buffer_write_frames(f->out, f->frames, n);
+   pipeline_stage_produced(stage, written, n - written);
+   return n;
+}
+
+void filter_stage_set_sinks(filter_stage *f, const stream_sinks *raw){
+   f->raw_sinks = raw;
+}
+
+void filter_stage_destroy(filter_stage *f){
+   dsp_biquad_cascade_destroy(&f->cascade);
+   arena_free(f->arena, f->frames);
+   f->frames = NULL;
+}
+
+/**************************** Spectral ****************************/
+
+bool spectral_stage_init(spectral_stage *s, mc_ring_buffer *in, mc_ring_buffer *out,
+                         int fft_size, int hop, dsp_window_type window, int averages,
+                         float sample_rate){
+   return spectral_stage_init_arena(s, in, out, fft_size, hop, window, averages, sample_rate, NULL);
+}
+
+// one per-channel window ring: always room for one chunk on top of a partial window
+static spsc_ring_buffer *window_ring_create(int capacity, arena *a){
+   if(!a){
+      spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+      if(rb && !spsc_ring_buffer_init(rb, capacity)){
+         free(rb);
+         rb = NULL;
+      }
+      return rb;
+   }
+   spsc_ring_buffer *rb = arena_alloc(a, sizeof(spsc_ring_buffer));
+   float32_t *storage = arena_alloc(a, sizeof(float32_t) * capacity);
+   if(!rb || !storage || !spsc_ring_buffer_init_with_storage(rb, storage, capacity)) return NULL;
+   return rb;
+}
+
+bool spectral_stage_init_arena(spectral_stage *s, mc_ring_buffer *in, mc_ring_buffer *out,
+                               int fft_size, int hop, dsp_window_type window, int averages,
+                               float sample_rate, arena *a){
+   if(!in || !out || fft_size < DSP_MIN_FFT_SIZE) return false;
+   int nch = in->num_channels;
+   int bins = fft_size / 2 + 1;
+   if(out->num_channels != nch * bins) return false;
+   memset(s, 0, sizeof(*s));
+   s->in = in;
+   s->out = out;
+   s->num_channels = nch;
+   s->num_bins = bins;
+   s->arena = a;
+   s->windows = arena_alloc(a, sizeof(spsc_ring_buffer *) * nch);
+   s->planar = arena_alloc(a, sizeof(float *) * nch);
+   s->psd = arena_alloc(a, sizeof(float) * nch * bins);
+   if(!s->windows || !s->planar || !s->psd ||
+      !dsp_spectral_bank_init_arena(&s->bank, nch, fft_size, hop, window, averages, sample_rate, a)){
+      spectral_stage_destroy(s);
+      return false;
+   }
+   for(int ch = 0; ch < nch; ch++){
+      s->planar[ch] = arena_alloc(a, sizeof(float) * PIPELINE_CHUNK_FRAMES);
+      s->windows[ch] = window_ring_create(fft_size + PIPELINE_CHUNK_FRAMES, a);
+      if(!s->planar[ch] || !s->windows[ch]){
+         spectral_stage_destroy(s);
+         return false;
+      }
+   }
+   return true;
+}
+
+int spectral_stage_step(pipeline_stage *stage, void *ctx){
+   spectral_stage *s = (spectral_stage *)ctx;
+   int n = mc_ring_buffer_read_planar(s->in, s->planar, PIPELINE_CHUNK_FRAMES);
+   if(n == 0) return 0;
+   s->consumed += (uint64_t)n;
+   pipeline_stage_consumed(stage, n, input_position(s->in, s->consumed));
+
+   for(int ch = 0; ch < s->num_channels; ch++){
+      spsc_ring_buffer_write_n(s->windows[ch], s->planar[ch], n);
+   }
+   if(s->viz) viz_push_wave(s->viz, s->planar, n);
+   while(dsp_spectral_bank_process(&s->bank, s->windows, s->psd, 1) == 1){
+      int written = mc_ring_buffer_write_frames(s->out, s->psd, 1);
+      pipeline_stage_produced(stage, written, 1 - written);
+      if(s->viz) viz_push_psd(s->viz, s->psd);
+   }
+   if(s->viz) viz_publish(s->viz);
+   return n;
+}
+
+bool spectral_stage_set_viz(spectral_stage *s, viz_state *viz){
+   if(viz && (viz->num_channels != s->num_channels || viz->num_bins != s->num_bins)) return false;
+   s->viz = viz;
+   return true;
+}
+
+void spectral_stage_set_pool(spectral_stage *s, work_pool *pool){
+   dsp_spectral_bank_set_pool(&s->bank, pool);
+}
+
+void spectral_stage_destroy(spectral_stage *s){
+   dsp_spectral_bank_destroy(&s->bank);
+   for(int ch = 0; ch < s->num_channels; ch++){
+      if(s->windows && s->arena){
+         spsc_ring_buffer_deinit(s->windows[ch]);
+      } else if(s->windows){
+         spsc_ring_buffer_destroy(s->windows[ch]); // frees the struct as well
+      }
+      if(s->planar) arena_free(s->arena, s->planar[ch]);
+   }
+   arena_free(s->arena, s->windows);
+   arena_free(s->arena, s->planar);
+   arena_free(s->arena, s->psd);
+   s->windows = NULL;
+   s->planar = NULL;
+   s->psd = NULL;
+   s->num_channels = 0;
+}
+
+/***************************** Output *****************************/
+
+bool output_stage_init(output_stage *o, mc_ring_buffer *in, int num_channels,
+                       output_stage_fn fn, void *fn_ctx){
+   return output_stage_init_arena(o, in, num_channels, fn, fn_ctx, NULL);
+}
+
+bool output_stage_init_arena(output_stage *o, mc_ring_buffer *in, int num_channels,
+                             output_stage_fn fn, void *fn_ctx, arena *a){
+   if(!in || !fn || num_channels < 1 || in->num_channels % num_channels != 0) return false;
+   memset(o, 0, sizeof(*o));
+   o->in = in;
+   o->num_channels = num_channels;
+   o->num_bins = in->num_channels / num_channels;
+   o->fn = fn;
+   o->fn_ctx = fn_ctx;
+   o->arena = a;
+   o->psd = arena_alloc(a, sizeof(float) * in->num_channels);
+   o->band_power = arena_alloc(a, sizeof(float) * num_channels * DSP_NUM_EEG_BANDS);
+   if(!o->psd || !o->band_power){
+      arena_free(a, o->psd);
+      arena_free(a, o->band_power);
+      o->psd = o->band_power = NULL;
+      return false;
+   }
+   return true;
+}
+
+void output_stage_set_sinks(output_stage *o, const stream_sinks *sinks, float bin_hz){
+   o->sinks = sinks;
+   o->bin_hz = bin_hz;
+}
+
+int output_stage_step(pipeline_stage *stage, void *ctx){
+   output_stage *o = (output_stage *)ctx;
+   if(mc_ring_buffer_read_frames(o->in, o->psd, 1) == 0) return 0;
+   o->consumed++;
+   pipeline_stage_consumed(stage, 1, input_position(o->in, o->consumed));
+   // downstream consumers first, the callback may take longer
+   if(o->sinks){
+      uint64_t now = pipeline_now_ns();
+      dsp_psd_band_powers(o->psd, o->num_channels, o->num_bins, o->bin_hz, dsp_eeg_bands,
+                          DSP_NUM_EEG_BANDS, o->band_power);
+      stream_sinks_publish(o->sinks, STREAM_BAND_POWER, o->num_channels, o->band_power,
+                           o->num_channels * DSP_NUM_EEG_BANDS, now);
+      stream_sinks_publish(o->sinks, STREAM_PSD, o->num_channels, o->psd,
+                           o->num_channels * o->num_bins, now);
+      if(o->sinks->udp) stream_udp_flush(o->sinks->udp);
+   }
+   o->fn(o->psd, o->num_channels, o->num_bins, o->fn_ctx);
+   pipeline_stage_produced(stage, 1, 0);
+   return 1;
+}
+
+void output_stage_destroy(output_stage *o){
+   arena_free(o->arena, o->psd);
+   arena_free(o->arena, o->band_power);
+   o->psd = NULL;
+   o->band_power = NULL;
+}
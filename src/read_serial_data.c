@@ -1,40 +1,409 @@
-//TODO: take main function out of here and put in main.c
+// serial reader thread and serial port setup
+// main() is in main.c
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <termios.h>
+#include "read_serial_data.h"
+#include "mc_ring_buffer.h"
+#include "serial_protocol.h"
+#include "sample_clock.h"
+#include "io_poll.h"
+#include "telemetry.h"
+#include "pipeline.h"
+#include "metrics.h"
 
-#define SERIAL_PORT "/dev/cu.usbmodem11301"
 #define BAUD_RATE B115200
-#define FLOAT_SIZE sizeof(float)
+#define STAGING_SIZE 16384        // bytes drained per read(), several packets
+#define IDLE_TIMEOUT_MS 100       // wait when vtime is 0, bounds the stop latency
+#define MERGE_FRAMES 64           // frames merged per alignment check
+
+// one serial port: its parser, where its frames go and what was reported
+// (a single reader has one, a multi-device reader one per board)
+typedef struct {
+   int fd;
+   int num_channels;
+   int frames_per_packet;
+   bool open;                    // false after hang-up or a read error
+   bool queue;                   // ring is the board's alignment queue, not the output
+   mc_ring_buffer *ring;
+   sample_clock *clock;          // NULL = gaps stay gaps
+   telemetry_channel *telemetry;
+   pipeline_stage *stage;        // the output's ingest stage, NULL for a queue
+   recorder *recorder;           // NULL for a queue
+   serial_parser parser;
+   uint64_t packets_lost;        // parser counters already reported to telemetry
+   uint64_t crc_errors;
+   uint64_t overwritten;         // ring values overwritten, already reported
+   uint64_t resyncs;             // clock resyncs already seen
+   uint64_t frames_read;
+   uint64_t frames_filled;
+   int16_t last_frame[SERIAL_PROTO_MAX_CHANNELS]; // codes of the newest frame, start of a fill
+   int16_t fill[SERIAL_PROTO_MAX_CODES];
+   float frames[SERIAL_PROTO_MAX_CODES];
+} serial_port;
+
+static void port_init(serial_port *port, int fd, int num_channels, int frames_per_packet,
+                      mc_ring_buffer *ring, sample_clock *clock, telemetry_channel *telemetry){
+   memset(port, 0, sizeof(*port));
+   port->fd = fd;
+   port->num_channels = num_channels;
+   port->frames_per_packet = frames_per_packet;
+   port->open = true;
+   port->ring = ring;
+   port->clock = clock;
+   port->telemetry = telemetry;
+   port->overwritten = spsc_ring_buffer_num_overwritten(ring->ring);
+   serial_parser_init(&port->parser);
+}
+
+// frames of interleaved codes into a ring: as they are for an int16 ring,
+// in volts (through the scratch buffer volts) otherwise
+static int write_codes(mc_ring_buffer *ring, const int16_t *codes, int num_frames, float *volts){
+   if(ring->sample_type == MC_SAMPLE_I16) return mc_ring_buffer_write_codes(ring, codes, num_frames);
+   for(int i = 0; i < num_frames * ring->num_channels; i++) volts[i] = serial_code_to_volts(codes[i]);
+   return mc_ring_buffer_write_frames(ring, volts, num_frames);
+}
+
+// interpolate a gap of gap_frames between port->last_frame and after into the
+// ring, in pieces of the staging size; returns the frames written
+static int write_fill(serial_port *port, int gap_frames, const int16_t *after){
+   int nch = port->num_channels;
+   int chunk = SERIAL_PROTO_MAX_CODES / nch;
+   int written = 0;
+   for(int first = 0; first < gap_frames; first += chunk){
+      int n = gap_frames - first < chunk ? gap_frames - first : chunk;
+      sample_clock_fill_codes(port->last_frame, after, nch, gap_frames, first, n, port->fill);
+      written += write_codes(port->ring, port->fill, n, port->frames);
+   }
+   return written;
+}
+
+// empties the alignment queue of a board (the reader is both its ends)
+static void discard_queue(serial_port *port){
+   while(mc_ring_buffer_read_codes(port->ring, port->fill, SERIAL_PROTO_MAX_CODES / port->num_channels) > 0){}
+}
+
+// called for every valid packet: queue the frames (codes as they are for an
+// int16 ring, volts otherwise), no stdio here, diagnostics go to the telemetry channel
+static void on_packet(const serial_packet *pkt, void *ctx){
+   serial_port *port = (serial_port *)ctx;
+   telemetry_channel *tm = port->telemetry;
+   if(pkt->num_channels != port->num_channels){
+      telemetry_log(tm, "packet %u has %d channels, expected %d",
+                    pkt->seq, pkt->num_channels, port->num_channels);
+      return;
+   }
+   if(pkt->num_frames != port->frames_per_packet){
+      telemetry_log(tm, "packet %u has %d frames, expected %d",
+                    pkt->seq, pkt->num_frames, port->frames_per_packet);
+      return;
+   }
+   int num_codes = pkt->num_channels * pkt->num_frames;
+   bool codes_ring = port->ring->sample_type == MC_SAMPLE_I16;
+   // frames missed before this packet go in first, so the ring stays on the sample grid
+   int gap = port->clock ? sample_clock_packet(port->clock, pkt->seq, pkt->num_frames) : 0;
+   // a queue holds one contiguous run of sample indices: a resync starts a new one
+   if(port->queue && port->clock->resyncs != port->resyncs){
+      discard_queue(port);
+      port->resyncs = port->clock->resyncs;
+   }
+   int filled = gap > 0 ? write_fill(port, gap, pkt->codes) : 0;
+   if(port->clock){
+      memcpy(port->last_frame, pkt->codes + num_codes - pkt->num_channels,
+             sizeof(int16_t) * (size_t)pkt->num_channels);
+   }
+   // volts only where they are needed: a float ring or the recording
+   if(!codes_ring || port->recorder){
+      for(int i = 0; i < num_codes; i++){
+         port->frames[i] = serial_code_to_volts(pkt->codes[i]);
+      }
+   }
+   int wanted = gap + pkt->num_frames;
+   int written = filled + (codes_ring ? mc_ring_buffer_write_codes(port->ring, pkt->codes, pkt->num_frames)
+                                      : mc_ring_buffer_write_frames(port->ring, port->frames, pkt->num_frames));
+   port->frames_read += (uint64_t)pkt->num_frames;
+   port->frames_filled += (uint64_t)gap;
+   telemetry_codes(tm, pkt->codes, num_codes, SERIAL_VOLTS_PER_CODE);
+   telemetry_count(tm, TELEMETRY_FRAMES_FILLED, (uint64_t)gap);
+   if(port->stage) pipeline_stage_ingested(port->stage, written, wanted - written);
+   if(port->recorder) recorder_push(port->recorder, port->frames, pkt->num_frames, pkt->seq);
+
+   // frames rejected by a full ring, or written over the oldest ones
+   uint64_t overwritten = spsc_ring_buffer_num_overwritten(port->ring->ring);
+   uint64_t overflow = (uint64_t)(wanted - written)
+                       + (overwritten - port->overwritten) / (uint64_t)port->num_channels;
+   port->overwritten = overwritten;
+   telemetry_count(tm, TELEMETRY_OVERFLOW, overflow);
+
+   if(port->parser.packets_lost != port->packets_lost){
+      telemetry_count(tm, TELEMETRY_PACKETS_LOST, port->parser.packets_lost - port->packets_lost);
+      telemetry_log(tm, "lost %llu packets before seq %u",
+                    (unsigned long long)(port->parser.packets_lost - port->packets_lost), pkt->seq);
+      port->packets_lost = port->parser.packets_lost;
+   }
+   if(port->parser.crc_errors != port->crc_errors){
+      telemetry_count(tm, TELEMETRY_CRC_ERRORS, port->parser.crc_errors - port->crc_errors);
+      port->crc_errors = port->parser.crc_errors;
+   }
+}
+
+/**
+ * Read everything the driver has buffered for one port, in STAGING_SIZE
+ * chunks, and feed it to the port's parser. Partial packets stay in the
+ * parser for the next call.
+ * returns 1 if the device is still open, 0 on end of file or error.
+ */
+static int drain(serial_port *port, uint8_t *staging){
+   while(1){
+      ssize_t bytes_read = read(port->fd, staging, STAGING_SIZE);
+      METRICS_ADD(METRIC_READ_CALLS, 1);
+      if(bytes_read > 0){
+         // one timestamp per read() for the sample clock, not one per sample
+         uint64_t now = port->clock ? pipeline_now_ns() : 0;
+         METRICS_ADD(METRIC_BYTES_READ, bytes_read);
+         if(serial_parser_feed(&port->parser, staging, (size_t)bytes_read, on_packet, port) > 0 && port->clock){
+            sample_clock_observe(port->clock, now);
+         }
+         if(bytes_read < STAGING_SIZE) return 1; // drained
+         continue;
+      }
+      if(bytes_read == 0) return 0;              // hang up
+      if(errno == EAGAIN || errno == EWOULDBLOCK) return 1;
+      if(errno == EINTR) continue;
+      return 0;
+   }
+}
+
+/**
+ * The event loop of a reader thread: one poller for every port, drains the
+ * ready ones (all of them after a timeout), then calls after(ctx).
+ * returns when *stop is set, when every port has hung up, or on a poller failure.
+ */
+static void reader_loop(serial_port *ports, int num_ports, uint8_t *staging, const serial_tuning *tuning,
+                        const atomic_bool *stop, pipeline_stage *stage,
+                        void (*after)(void *ctx), void *ctx){
+   io_poller poller;
+   if(!io_poller_init(&poller)){
+      perror("serial_reader: cannot watch serial port");
+      return;
+   }
+   for(int p = 0; p < num_ports; p++){
+      // reads never block: the poller says when there is data, drain() takes all of it
+      int flags = fcntl(ports[p].fd, F_GETFL);
+      if(flags != -1) fcntl(ports[p].fd, F_SETFL, flags | O_NONBLOCK);
+      if(!io_poller_add(&poller, ports[p].fd, tuning->vmin, &ports[p])){
+         perror("serial_reader: cannot watch serial port");
+         io_poller_close(&poller);
+         return;
+      }
+   }
+   // vtime bounds how long bytes below the low-water mark can wait
+   int timeout_ms = tuning->vtime > 0 ? tuning->vtime * 100 : IDLE_TIMEOUT_MS;
+
+   int open = num_ports;
+   while (open > 0 && (!stop || !atomic_load_explicit(stop, memory_order_relaxed))) {
+      void *ready[IO_POLLER_MAX_FDS];
+      uint64_t due = stage ? pipeline_now_ns() + (uint64_t)timeout_ms * 1000000u : 0;
+      int n = io_poller_wait(&poller, timeout_ms, ready, IO_POLLER_MAX_FDS);
+      if(n < 0){
+         perror("serial_reader: wait failed");
+         break;
+      }
+      // a timed-out wait shows how late the thread got the CPU back
+      if(n == 0 && stage) pipeline_stage_wakeup(stage, due);
+      // on timeout drain every port anyway, picks up tails shorter than the low-water mark
+      METRICS_TIMER_START(busy);
+      for(int i = 0; i < (n > 0 ? n : num_ports); i++){
+         serial_port *port = n > 0 ? (serial_port *)ready[i] : &ports[i];
+         if(!port->open || drain(port, staging)) continue;
+         port->open = false;
+         io_poller_remove(&poller, port->fd);
+         open--;
+      }
+      if(after) after(ctx);
+      if(n > 0) METRICS_TIMER_STOP(busy);
+   }
+   io_poller_close(&poller);
+}
+
+// state of a single reader
+typedef struct {
+   serial_port port;
+   uint8_t staging[STAGING_SIZE];
+} serial_reader_state;
 
 void *serial_reader(void *arg){
-   while (1) {
-
-      int fd = *(int *)arg;  // cast void* back to int* 
-      char buffer[FLOAT_SIZE];
-      int bytes_read;
-      //int test_counter = 0;  
-      //int test_max_counter = 100;  
-
-      // read 4 bytes of binary data from serial port
-      bytes_read = read(fd, buffer, FLOAT_SIZE);
-      if(bytes_read == FLOAT_SIZE){ 
-         //test_counter++;
-         float voltage;
-         memcpy(&voltage, buffer, FLOAT_SIZE);
-         printf("Voltage: %.2f\n", voltage);  // print incoming data
+   serial_reader_args *args = (serial_reader_args *)arg;
+   args->frames_read = 0;
+   args->frames_filled = 0;
+
+   serial_reader_state *st = malloc(sizeof(serial_reader_state));
+   if(!st){
+      perror("serial_reader: cannot allocate state");
+      return NULL;
+   }
+   serial_port *port = &st->port;
+   port_init(port, args->fd, args->num_channels, args->frames_per_packet, args->ring,
+             args->clock, args->telemetry);
+   port->stage = args->stage;
+   port->recorder = args->recorder;
+
+   reader_loop(port, 1, st->staging, &args->tuning, args->stop, args->stage, NULL, NULL);
+
+   args->frames_read = port->frames_read;
+   args->frames_filled = port->frames_filled;
+   args->packets_lost = port->parser.packets_lost;
+   args->crc_errors = port->parser.crc_errors;
+   free(st);
+   return NULL;
+}
+
+// state of a multi-device reader: a port and an alignment queue per board
+typedef struct {
+   serial_multi_reader_args *args;
+   serial_port ports[SERIAL_MAX_DEVICES];
+   mc_ring_buffer queues[SERIAL_MAX_DEVICES];
+   int num_channels;             // of an aligned frame, all boards
+   uint16_t seq;                 // merges pushed to the recorder
+   int16_t *codes;               // MERGE_FRAMES frames of one board
+   int16_t *merged;              // MERGE_FRAMES aligned frames
+   float *volts;                 // the same in volts, for a float ring or the recorder
+   uint8_t staging[STAGING_SIZE];
+} serial_multi_state;
+
+/**
+ * Merge the boards' queues into the output ring while every board has
+ * frames. The oldest frame of each queue is put on the host time axis by
+ * the board's clock; when they are more than SERIAL_ALIGN_SLIP_FRAMES
+ * apart, the oldest of them is dropped (its board started earlier, or
+ * runs faster), else up to MERGE_FRAMES frames of every board become
+ * aligned frames, board 0's channels first.
+ */
+static void merge_queues(void *ctx){
+   serial_multi_state *st = (serial_multi_state *)ctx;
+   serial_multi_reader_args *args = st->args;
+   int num_devices = args->num_devices;
+   double slip_ns = SERIAL_ALIGN_SLIP_FRAMES * 1e9 / args->sample_rate;
+   while(1){
+      int n = MERGE_FRAMES;
+      int earliest = 0;
+      uint64_t first_ns = 0, last_ns = 0;
+      for(int d = 0; d < num_devices; d++){
+         int avail = mc_ring_buffer_num_frames(&st->queues[d]);
+         uint64_t head_ns;
+         sample_clock *clock = &args->devices[d].clock;
+         if(avail == 0 || !sample_clock_time_ns(clock, clock->next_index - (uint64_t)avail, &head_ns)) return;
+         if(avail < n) n = avail;
+         if(d == 0 || head_ns < first_ns){
+            first_ns = head_ns;
+            earliest = d;
+         }
+         if(d == 0 || head_ns > last_ns) last_ns = head_ns;
+      }
+      if((double)(last_ns - first_ns) > slip_ns){
+         mc_ring_buffer_read_codes(&st->queues[earliest], st->codes, 1);
+         args->frames_slipped++;
+         continue;
+      }
+      int offset = 0;
+      for(int d = 0; d < num_devices; d++){
+         int nch = args->devices[d].num_channels;
+         mc_ring_buffer_read_codes(&st->queues[d], st->codes, n);
+         for(int f = 0; f < n; f++){
+            memcpy(st->merged + (size_t)f * st->num_channels + offset, st->codes + (size_t)f * nch,
+                   sizeof(int16_t) * (size_t)nch);
+         }
+         offset += nch;
+      }
+      int written = write_codes(args->ring, st->merged, n, st->volts);
+      args->frames_aligned += (uint64_t)n;
+      if(args->stage) pipeline_stage_ingested(args->stage, written, n - written);
+      telemetry_count(args->telemetry, TELEMETRY_OVERFLOW, (uint64_t)(n - written));
+      if(args->recorder){
+         if(args->ring->sample_type == MC_SAMPLE_I16){
+            for(int i = 0; i < n * st->num_channels; i++) st->volts[i] = serial_code_to_volts(st->merged[i]);
+         }
+         recorder_push(args->recorder, st->volts, n, st->seq++);
+      }
+   }
+}
+
+// also for a state half made: queues not made yet are still zeroed
+static void multi_state_free(serial_multi_state *st){
+   for(int d = 0; d < SERIAL_MAX_DEVICES; d++) mc_ring_buffer_deinit(&st->queues[d]);
+   free(st->codes);
+   free(st->merged);
+   free(st->volts);
+   free(st);
+}
+
+void *serial_multi_reader(void *arg){
+   serial_multi_reader_args *args = (serial_multi_reader_args *)arg;
+   args->frames_aligned = 0;
+   args->frames_slipped = 0;
+   int num_devices = args->num_devices;
+   int num_channels = 0;
+   bool valid = num_devices >= 1 && num_devices <= SERIAL_MAX_DEVICES && args->queue_frames > 0;
+   for(int d = 0; valid && d < num_devices; d++){
+      serial_device *dev = &args->devices[d];
+      valid = dev->num_channels >= 1 && dev->num_channels <= SERIAL_PROTO_MAX_CHANNELS &&
+              sample_clock_init(&dev->clock, args->sample_rate, args->max_fill_frames);
+      num_channels += dev->num_channels;
+   }
+   if(!valid || args->ring->num_channels != num_channels){
+      fprintf(stderr, "serial_multi_reader: invalid devices or ring channel count\n");
+      return NULL;
+   }
+
+   serial_multi_state *st = calloc(1, sizeof(serial_multi_state));
+   if(!st){
+      perror("serial_multi_reader: cannot allocate state");
+      return NULL;
+   }
+   st->args = args;
+   st->num_channels = num_channels;
+   st->codes = malloc(sizeof(int16_t) * MERGE_FRAMES * SERIAL_PROTO_MAX_CHANNELS);
+   st->merged = malloc(sizeof(int16_t) * MERGE_FRAMES * (size_t)num_channels);
+   st->volts = malloc(sizeof(float) * MERGE_FRAMES * (size_t)num_channels);
+   bool ok = st->codes && st->merged && st->volts;
+   for(int d = 0; d < num_devices; d++){
+      serial_device *dev = &args->devices[d];
+      // a board that gets ahead loses its oldest frames, never the newest
+      ok = ok && mc_ring_buffer_init_i16(&st->queues[d], dev->num_channels, args->queue_frames,
+                                         SERIAL_VOLTS_PER_CODE) &&
+           mc_ring_buffer_set_overflow_policy(&st->queues[d], RB_OVERFLOW_OVERWRITE, 0);
+      if(!ok){
+         perror("serial_multi_reader: cannot allocate queues");
+         multi_state_free(st);
+         return NULL;
       }
-      //if(test_counter==test_max_counter) break;
+      serial_port *port = &st->ports[d];
+      port_init(port, dev->fd, dev->num_channels, dev->frames_per_packet, &st->queues[d],
+                &dev->clock, args->telemetry);
+      port->queue = true;
+   }
+
+   reader_loop(st->ports, num_devices, st->staging, &args->tuning, args->stop, args->stage,
+               merge_queues, st);
+
+   for(int d = 0; d < num_devices; d++){
+      serial_device *dev = &args->devices[d];
+      dev->frames_read = st->ports[d].frames_read;
+      dev->packets_lost = st->ports[d].parser.packets_lost;
+      dev->crc_errors = st->ports[d].parser.crc_errors;
    }
+   multi_state_free(st);
    return NULL;
 }
-void setup_serial(int fd){
+
+void setup_serial(int fd, const serial_tuning *tuning){
    // to find all settings: find / -name 'termios.h'
    // struct to hold serial port settings
    struct termios tty;
@@ -60,9 +429,13 @@ void setup_serial(int fd){
    //printf("c_cflag with size bits cleared = %lx\n", tty.c_cflag);
    tty.c_cflag |= CS8;          // set 8 data bits
    //printf("c_cflag with 8 data bits = %lx\n", tty.c_cflag);
+#if defined(CCTS_OFLOW)
    tty.c_cflag &= ~CCTS_OFLOW;  // disable CTS signals (only need for UART)
    //printf("c_cflag without CTS signals = 0x%lx\n", tty.c_cflag);
    tty.c_cflag &= ~CRTS_IFLOW;  // disable RTS signals (only need for UART)
+#else
+   tty.c_cflag &= ~CRTSCTS;     // Linux name for both CTS and RTS flow control
+#endif
    //printf("c_cflag without RTS signals = 0x%lx\n", tty.c_cflag);
    tty.c_cflag |= CREAD;        // enable receiver 
    //printf("c_cflag with receiver enabled = 0x%lx\n", tty.c_cflag);
@@ -74,6 +447,7 @@ void setup_serial(int fd){
    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
    //printf("c_iflag after SW flow control disabled = %lx\n", tty.c_iflag);
    tty.c_iflag &= ~(INLCR | ICRNL);
+   tty.c_iflag &= ~ISTRIP;      // keep the 8th bit, the packets are binary
    //printf("c_iflag after turning off LF and CR conversions = %lx\n", tty.c_iflag);
 
    // c_oflag = 32-bit unsigned long for SW output processing
@@ -83,14 +457,15 @@ void setup_serial(int fd){
    // c_lflag = 32-bit unsigned long local flags 
    //printf("c_lflag = %lx\n", tty.c_lflag);
    tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);  // raw input, no echo, no canonical mode
+   tty.c_lflag &= ~IEXTEN;      // BSD/macOS handle ^V and ^O even without ICANON
    
    // c_cc[] array for special control characters
    //printf("c_cc[VMIN] = %d\n", tty.c_cc[VMIN]); 
-   tty.c_cc[VMIN] = 1; // minimum of 1 character to read 
+   tty.c_cc[VMIN] = (cc_t)tuning->vmin; // minimum characters to read, see serial_tuning
    //printf("c_cc[VMIN] after change = %d\n", tty.c_cc[VMIN]); 
 
    //printf("c_cc[VTIME] = %d\n", tty.c_cc[VTIME]); 
-   tty.c_cc[VTIME] = 10; // wait 1s before timeout, unit is 0.1 seconds 
+   tty.c_cc[VTIME] = (cc_t)tuning->vtime; // inter-byte timeout, unit is 0.1 seconds 
    //printf("c_cc[VTIME] = %d\n", tty.c_cc[VTIME]); 
 
    tcflush(fd, TCIFLUSH); // flush buffer - discard unprocessed or unread data 
@@ -101,46 +476,3 @@ void setup_serial(int fd){
    }
 
 }
-
-int main(){
-
-   // O_RDWR = open serial port for read and write
-   // O_NOCTTY = don't let serial port be a controlling terminal 
-   // meaning if data comes in it can't affect the program
-   // O_RDWR | O_NOCTTY is a bitmask, so both of these things become true
-
-   // fd = file descriptor, a number that identifies the open file
-   // a file descriptor is a small integer that the OS uses to keep track
-   // of open files, devices, or sockets in a program. 
-   // fd = 0 (stdin, keyboard)
-   // fd = 1 (stdout, terminal output)
-   // fd = 2 (stderr, error output)
-   // fd = 3 (/dev/tty.usbserial, our serial port)
-
-   int fd = open(SERIAL_PORT, O_RDWR | O_NOCTTY);
-   printf("fd = %d\n", fd);
-   if (fd == -1) {
-      perror("Error opening serial port");
-      return 1;
-   }
-
-   // the serial port is denoted by fd and is configured with this call
-   setup_serial(fd);
-
-   // create separate thread for serial reading
-   pthread_t thread_id; // identifer to reference the thread
-  
-   if(pthread_create(&thread_id, NULL, serial_reader, &fd) != 0){
-      perror("Failed to create thread for serial reading");
-      return 1;
-   }
-
-   while (1) {
-      sleep(1);
-   }
-    
-
-    
-   close(fd);
-   return 0;
-}
@@ -0,0 +1,370 @@
+/**
+ * recording.c
+ *
+ * Implementation of the session recorder and the memory-mapped reader.
+ *
+ * Notes:
+ * - The stamp queue works like the pipeline's: free-running head/tail
+ *   counters, the producer publishes a stamp with a release store after
+ *   its frames are in the ring, so the writer always finds them there.
+ * - The writer fills one chunk in memory and writes it with a single
+ *   write(); unused frame slots of a partial chunk are zero.
+ * - After a write error the writer keeps draining (and discarding) so the
+ *   producer never sees a full ring because of a broken disk.
+ * - Use with recording.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "recording.h"
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RECORDER_STAMP_MASK (RECORDER_STAMP_QUEUE_SIZE - 1)
+
+_Static_assert((RECORDER_STAMP_QUEUE_SIZE & RECORDER_STAMP_MASK) == 0,
+               "RECORDER_STAMP_QUEUE_SIZE must be a power of two");
+_Static_assert(sizeof(recording_header) == 64, "recording_header is 64 bytes in the file");
+_Static_assert(sizeof(recording_chunk_header) == 32, "recording_chunk_header is 32 bytes in the file");
+_Static_assert(sizeof(recording_index_entry) == 16, "recording_index_entry is 16 bytes in the file");
+_Static_assert(sizeof(recording_trailer) == 24, "recording_trailer is 24 bytes in the file");
+
+static uint64_t clock_ns(clockid_t clock){
+   struct timespec ts;
+   clock_gettime(clock, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static bool write_all(int fd, const void *data, size_t len){
+   const uint8_t *p = (const uint8_t *)data;
+   while(len > 0){
+      ssize_t n = write(fd, p, len);
+      if(n < 0 && errno == EINTR) continue;
+      if(n <= 0) return false;
+      p += n;
+      len -= (size_t)n;
+   }
+   return true;
+}
+
+/**************************** Writer ****************************/
+
+static recording_chunk_header *chunk_header(recorder *r){
+   return (recording_chunk_header *)r->chunk;
+}
+
+static float *chunk_frames(recorder *r){
+   return (float *)(r->chunk + sizeof(recording_chunk_header));
+}
+
+// writes the chunk being filled (if any) and adds it to the index
+static void flush_chunk(recorder *r){
+   if(r->chunk_frames == 0) return;
+   recording_chunk_header *hdr = chunk_header(r);
+   hdr->num_frames = (uint32_t)r->chunk_frames;
+   size_t used = (size_t)r->chunk_frames * (size_t)r->num_channels * sizeof(float);
+   memset((uint8_t *)chunk_frames(r) + used, 0, r->chunk_size - sizeof(recording_chunk_header) - used);
+
+   if(r->num_chunks == r->index_capacity){
+      uint64_t capacity = r->index_capacity ? r->index_capacity * 2 : 256;
+      recording_index_entry *index = realloc(r->index, capacity * sizeof(recording_index_entry));
+      if(!index) atomic_store(&r->write_error, true);
+      else {
+         r->index = index;
+         r->index_capacity = capacity;
+      }
+   }
+   if(!atomic_load(&r->write_error)){
+      if(write_all(r->fd, r->chunk, r->chunk_size)){
+         r->index[r->num_chunks].timestamp_ns = hdr->timestamp_ns;
+         r->index[r->num_chunks].first_frame = hdr->first_frame;
+         r->num_chunks++;
+         r->offset += r->chunk_size;
+         atomic_fetch_add_explicit(&r->frames_written, (uint64_t)r->chunk_frames, memory_order_relaxed);
+      } else {
+         atomic_store(&r->write_error, true);
+      }
+   }
+   r->chunk_frames = 0;
+}
+
+// moves one queued packet from the ring into chunks, false if none is queued
+static bool drain_packet(recorder *r){
+   unsigned int head = atomic_load_explicit(&r->stamp_head, memory_order_relaxed);
+   unsigned int tail = atomic_load_explicit(&r->stamp_tail, memory_order_acquire);
+   if(head == tail) return false;
+   recorder_stamp st = r->stamps[head & RECORDER_STAMP_MASK];
+
+   // a gap closes the chunk, chunks only hold contiguous frames
+   if(r->chunk_frames > 0 && st.first_frame != r->chunk_next_frame) flush_chunk(r);
+   uint32_t done = 0;
+   while(done < st.num_frames){
+      if(r->chunk_frames == 0){
+         recording_chunk_header *hdr = chunk_header(r);
+         hdr->magic = RECORDING_CHUNK_MAGIC;
+         hdr->first_frame = st.first_frame + done;
+         hdr->timestamp_ns = st.timestamp_ns + (uint64_t)(done * 1e9 / r->sample_rate);
+         hdr->first_seq = st.seq;
+      }
+      int room = r->frames_per_chunk - r->chunk_frames;
+      int n = (int)(st.num_frames - done) < room ? (int)(st.num_frames - done) : room;
+      float *dst = chunk_frames(r) + (size_t)r->chunk_frames * (size_t)r->num_channels;
+      mc_ring_buffer_read_frames(r->ring, dst, n);
+      r->chunk_frames += n;
+      done += (uint32_t)n;
+      r->chunk_next_frame = st.first_frame + done;
+      if(r->chunk_frames == r->frames_per_chunk) flush_chunk(r);
+   }
+   atomic_store_explicit(&r->stamp_head, head + 1, memory_order_release);
+   return true;
+}
+
+static void *recorder_thread(void *arg){
+   recorder *r = (recorder *)arg;
+   METRICS_THREAD("recorder");
+   struct timespec idle = { 0, RECORDER_IDLE_US * 1000L };
+   while(!atomic_load_explicit(&r->stop, memory_order_acquire)){
+      if(!drain_packet(r)) nanosleep(&idle, NULL);
+   }
+   // the producer has stopped: write everything it queued
+   while(drain_packet(r)){
+   }
+   flush_chunk(r);
+   return NULL;
+}
+
+bool recorder_open(recorder *r, const char *path, int num_channels, float sample_rate,
+                   int frames_per_chunk, int ring_frames){
+   memset(r, 0, sizeof(*r));
+   r->fd = -1;
+   if(num_channels < 1 || frames_per_chunk < 1 || sample_rate <= 0.0f || ring_frames < 1) return false;
+   r->num_channels = num_channels;
+   r->frames_per_chunk = frames_per_chunk;
+   r->sample_rate = sample_rate;
+   r->chunk_size = sizeof(recording_chunk_header) +
+                   (size_t)frames_per_chunk * (size_t)num_channels * sizeof(float);
+   atomic_init(&r->stamp_head, 0);
+   atomic_init(&r->stamp_tail, 0);
+   atomic_init(&r->frames_dropped, 0);
+   atomic_init(&r->frames_written, 0);
+   atomic_init(&r->write_error, false);
+   atomic_init(&r->stop, false);
+
+   r->ring = malloc(sizeof(mc_ring_buffer));
+   r->stamps = malloc(sizeof(recorder_stamp) * RECORDER_STAMP_QUEUE_SIZE);
+   r->chunk = calloc(1, r->chunk_size);
+   if(!r->ring || !r->stamps || !r->chunk || !mc_ring_buffer_init(r->ring, num_channels, ring_frames)){
+      free(r->ring);
+      r->ring = NULL;
+      recorder_close(r);
+      return false;
+   }
+   mc_ring_buffer_set_overflow_policy(r->ring, RB_OVERFLOW_REJECT, 0);
+
+   r->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if(r->fd == -1){
+      recorder_close(r);
+      return false;
+   }
+   recording_header hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, RECORDING_MAGIC, sizeof(hdr.magic));
+   hdr.version = RECORDING_VERSION;
+   hdr.header_size = sizeof(recording_header);
+   hdr.num_channels = (uint32_t)num_channels;
+   hdr.frames_per_chunk = (uint32_t)frames_per_chunk;
+   hdr.sample_rate = sample_rate;
+   hdr.chunk_size = (uint32_t)r->chunk_size;
+   hdr.start_ns = clock_ns(CLOCK_MONOTONIC);
+   hdr.start_unix_ns = clock_ns(CLOCK_REALTIME);
+   if(!write_all(r->fd, &hdr, sizeof(hdr))){
+      recorder_close(r);
+      return false;
+   }
+   r->offset = sizeof(hdr);
+
+   if(pthread_create(&r->thread, NULL, recorder_thread, r) != 0){
+      recorder_close(r);
+      return false;
+   }
+   r->started = true;
+   return true;
+}
+
+bool recorder_push(recorder *r, const float *frames, int num_frames, uint16_t seq){
+   if(num_frames <= 0) return true;
+   uint64_t first = r->next_frame;
+   r->next_frame += (uint64_t)num_frames;
+
+   // all or nothing, so the writer never sees half a packet
+   unsigned int tail = atomic_load_explicit(&r->stamp_tail, memory_order_relaxed);
+   unsigned int head = atomic_load_explicit(&r->stamp_head, memory_order_acquire);
+   int room = r->ring->max_num_frames - mc_ring_buffer_num_frames(r->ring);
+   if(tail - head == RECORDER_STAMP_QUEUE_SIZE || room < num_frames){
+      atomic_fetch_add_explicit(&r->frames_dropped, (uint64_t)num_frames, memory_order_relaxed);
+      return false;
+   }
+   mc_ring_buffer_write_frames(r->ring, frames, num_frames);
+   recorder_stamp *st = &r->stamps[tail & RECORDER_STAMP_MASK];
+   st->first_frame = first;
+   st->timestamp_ns = clock_ns(CLOCK_MONOTONIC);
+   st->num_frames = (uint32_t)num_frames;
+   st->seq = seq;
+   atomic_store_explicit(&r->stamp_tail, tail + 1, memory_order_release);
+   return true;
+}
+
+bool recorder_close(recorder *r){
+   if(r->started){
+      atomic_store_explicit(&r->stop, true, memory_order_release);
+      pthread_join(r->thread, NULL);
+      r->started = false;
+      // footer: index, then the trailer that points at it
+      recording_trailer trailer;
+      memset(&trailer, 0, sizeof(trailer));
+      trailer.index_offset = r->offset;
+      trailer.num_chunks = r->num_chunks;
+      memcpy(trailer.magic, RECORDING_INDEX_MAGIC, sizeof(trailer.magic));
+      if(!atomic_load(&r->write_error) &&
+         (!write_all(r->fd, r->index, r->num_chunks * sizeof(recording_index_entry)) ||
+          !write_all(r->fd, &trailer, sizeof(trailer)))){
+         atomic_store(&r->write_error, true);
+      }
+   }
+   bool ok = !atomic_load(&r->write_error);
+   if(r->fd != -1 && close(r->fd) != 0) ok = false;
+   r->fd = -1;
+   if(r->ring) mc_ring_buffer_destroy(r->ring);
+   free(r->stamps);
+   free(r->chunk);
+   free(r->index);
+   r->ring = NULL;
+   r->stamps = NULL;
+   r->chunk = NULL;
+   r->index = NULL;
+   return ok;
+}
+
+/**************************** Reader ****************************/
+
+static const recording_chunk_header *chunk_at(const recording *r, uint64_t chunk){
+   const recording_header *h = r->header;
+   return (const recording_chunk_header *)(r->map + h->header_size + chunk * h->chunk_size);
+}
+
+// no valid footer: take the whole chunks and their headers
+static bool rebuild_index(recording *r){
+   const recording_header *h = r->header;
+   uint64_t n = (r->size - h->header_size) / h->chunk_size;
+   r->owned_index = malloc((n ? n : 1) * sizeof(recording_index_entry));
+   if(!r->owned_index) return false;
+   uint64_t valid = 0;
+   while(valid < n && chunk_at(r, valid)->magic == RECORDING_CHUNK_MAGIC){
+      r->owned_index[valid].timestamp_ns = chunk_at(r, valid)->timestamp_ns;
+      r->owned_index[valid].first_frame = chunk_at(r, valid)->first_frame;
+      valid++;
+   }
+   r->index = r->owned_index;
+   r->num_chunks = valid;
+   r->finalized = false;
+   return true;
+}
+
+bool recording_open(recording *r, const char *path){
+   memset(r, 0, sizeof(*r));
+   int fd = open(path, O_RDONLY);
+   if(fd == -1) return false;
+   struct stat st;
+   if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(recording_header)){
+      close(fd);
+      return false;
+   }
+   void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd); // the mapping keeps the file
+   if(map == MAP_FAILED) return false;
+   r->map = (const uint8_t *)map;
+   r->size = (size_t)st.st_size;
+   r->header = (const recording_header *)r->map;
+
+   const recording_header *h = r->header;
+   if(memcmp(h->magic, RECORDING_MAGIC, sizeof(h->magic)) != 0 || h->version != RECORDING_VERSION ||
+      h->header_size < sizeof(recording_header) || h->num_channels < 1 || h->frames_per_chunk < 1 ||
+      h->chunk_size != sizeof(recording_chunk_header) +
+                       (size_t)h->frames_per_chunk * h->num_channels * sizeof(float) ||
+      h->header_size > r->size){
+      recording_close(r);
+      return false;
+   }
+
+   // the footer must point exactly between the last chunk and the trailer
+   bool footer = false;
+   if(r->size >= h->header_size + sizeof(recording_trailer)){
+      const recording_trailer *t = (const recording_trailer *)(r->map + r->size - sizeof(recording_trailer));
+      footer = memcmp(t->magic, RECORDING_INDEX_MAGIC, sizeof(t->magic)) == 0 &&
+               t->index_offset == h->header_size + t->num_chunks * h->chunk_size &&
+               t->index_offset + t->num_chunks * sizeof(recording_index_entry) ==
+                  r->size - sizeof(recording_trailer);
+      if(footer){
+         r->index = (const recording_index_entry *)(r->map + t->index_offset);
+         r->num_chunks = t->num_chunks;
+         r->finalized = true;
+      }
+   }
+   if(!footer && !rebuild_index(r)){
+      recording_close(r);
+      return false;
+   }
+   return true;
+}
+
+const recording_chunk_header *recording_chunk(const recording *r, uint64_t chunk,
+                                              const float **frames){
+   if(chunk >= r->num_chunks) return NULL;
+   const recording_chunk_header *hdr = chunk_at(r, chunk);
+   if(frames) *frames = (const float *)((const uint8_t *)hdr + sizeof(recording_chunk_header));
+   return hdr;
+}
+
+bool recording_seek(const recording *r, uint64_t t_ns, recording_pos *pos){
+   if(r->num_chunks == 0) return false;
+   uint64_t t = r->header->start_ns + t_ns;
+   // last chunk that starts at or before t
+   uint64_t lo = 0, hi = r->num_chunks;
+   while(hi - lo > 1){
+      uint64_t mid = lo + (hi - lo) / 2;
+      if(r->index[mid].timestamp_ns <= t) lo = mid;
+      else hi = mid;
+   }
+   pos->chunk = lo;
+   pos->frame = 0;
+   if(r->index[lo].timestamp_ns >= t) return true;
+
+   const recording_chunk_header *hdr = chunk_at(r, lo);
+   uint64_t offset = (uint64_t)((t - hdr->timestamp_ns) * 1e-9 * r->header->sample_rate);
+   if(offset < hdr->num_frames){
+      pos->frame = (uint32_t)offset;
+      return true;
+   }
+   // t falls after the chunk: in a gap or past the end
+   if(lo + 1 == r->num_chunks) return false;
+   pos->chunk = lo + 1;
+   return true;
+}
+
+void recording_close(recording *r){
+   if(r->map) munmap((void *)r->map, r->size);
+   free(r->owned_index);
+   r->map = NULL;
+   r->header = NULL;
+   r->index = NULL;
+   r->owned_index = NULL;
+   r->num_chunks = 0;
+}
@@ -5,14 +5,26 @@
  * This file provides the core logic for writing to and reading from the buffer.
  * 
  * Notes:
- * - Head and tail indices wrap around using modulo arithmetic.
- * - The buffer prevents overwrites when full (non-overwriting mode).
+ * - Head and tail indices wrap around using modulo arithmetic, or a bit
+ *   mask when the capacity is a power of two (ring_buffer_init_pow2()).
+ * - By default the buffer prevents overwrites when full (non-overwriting mode).
+ *   ring_buffer_set_overflow_policy() can switch it to overwrite-oldest, which
+ *   keeps the freshest data and bounds latency when the reader stalls.
+ * - Dropped and rejected values are counted per buffer.
+ * - With EEG_METRICS, values in/out/dropped go to the calling thread's
+ *   metrics slot and the fill level to the high-water mark (metrics.h).
+ * - Mirrored buffers are mapped twice back-to-back, so spans never split.
+ * - Buffers on caller storage (ring_buffer_init_with_storage()) never free
+ *   it; ring_buffer_deinit() releases what init allocated, destroy also
+ *   the struct.
  * - Use with ring_buffer.h to access the public API.
  *
  * Typical usage:
  *   - Initialize with ring_buffer_init()
- *   - Write with ring_buffer_write()
- *   - Read with ring_buffer_read()
+ *   - Write with ring_buffer_write() or ring_buffer_write_n()
+ *   - Read with ring_buffer_read() or ring_buffer_read_n()
+ *   - Or in place with ring_buffer_reserve()/ring_buffer_commit() and
+ *     ring_buffer_peek()/ring_buffer_release()
  *   - Destroy/free memory with ring_buffer_destroy()
  *
  * Author: Catherine Bernaciak PhD
@@ -20,8 +32,12 @@
  */
 
 #include "ring_buffer.h"
+#include "vm_mirror.h"
+#include "metrics.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 /**
  * Allocates memory for a new ring buffer with the specified capacity.
@@ -41,9 +57,101 @@ bool ring_buffer_init(ring_buffer *rb, int capacity){
    rb->head = 0;
    rb->tail = 0;
    rb->curr_num_values = 0;
+   rb->mirror_bytes = 0;
+   rb->external_storage = false;
+   rb->pow2 = false;
+   rb->index_mask = 0;
+   rb->overflow_policy = RB_OVERFLOW_REJECT;
+   rb->num_overwritten = 0;
+   rb->num_rejected = 0;
+   METRICS_HIGH_WATER_INIT(&rb->high_water);
    return true;
 }  
 
+/**
+ * Check that n is a power of two (n > 0).
+ */
+static bool is_pow2(int n){
+   return n > 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * Allocates memory for a new ring buffer with power-of-two capacity.
+ *
+ * rb is pointer to the ring buffer instance.
+ * capacity is maximum number of values to store, a power of two.
+ * returns true on success, false otherwise
+*/
+bool ring_buffer_init_pow2(ring_buffer *rb, int capacity){
+   if(!is_pow2(capacity)){
+      return false;
+   }
+   if(!ring_buffer_init(rb, capacity)) return false;
+   rb->pow2 = true;
+   rb->index_mask = capacity - 1;
+   return true;
+}
+
+/**
+ * Maps storage for at least capacity values twice back-to-back.
+ *
+ * rb is pointer to the ring buffer instance.
+ * capacity is rounded up so the storage is a whole number of pages.
+ * returns true on success, false otherwise
+*/
+bool ring_buffer_init_mirrored(ring_buffer *rb, int capacity){
+   if(capacity <= 0){
+      return false;
+   }
+   size_t bytes = vm_mirror_round_up(sizeof(float32_t)*(size_t)capacity);
+   if(bytes / sizeof(float32_t) > INT32_MAX) return false;
+
+   rb->buffer = vm_mirror_alloc(bytes);
+   if(!rb->buffer) return false;
+   rb->max_num_values = (int)(bytes / sizeof(float32_t));
+   rb->mirror_bytes = bytes;
+   rb->external_storage = false;
+   rb->pow2 = is_pow2(rb->max_num_values);
+   rb->index_mask = rb->pow2 ? rb->max_num_values - 1 : 0;
+
+   rb->head = 0;
+   rb->tail = 0;
+   rb->curr_num_values = 0;
+   rb->overflow_policy = RB_OVERFLOW_REJECT;
+   rb->num_overwritten = 0;
+   rb->num_rejected = 0;
+   METRICS_HIGH_WATER_INIT(&rb->high_water);
+   return true;
+}
+
+/**
+ * Uses capacity floats of caller storage, allocates nothing.
+ *
+ * rb is pointer to the ring buffer instance.
+ * storage is the caller's memory for capacity values.
+ * returns true on success, false otherwise
+*/
+bool ring_buffer_init_with_storage(ring_buffer *rb, float32_t *storage, int capacity){
+   if(!storage || capacity <= 0){
+      return false;
+   }
+   rb->buffer = storage;
+   rb->max_num_values = capacity;
+   rb->mirror_bytes = 0;
+   rb->external_storage = true;
+   rb->pow2 = is_pow2(capacity);
+   rb->index_mask = rb->pow2 ? capacity - 1 : 0;
+
+   rb->head = 0;
+   rb->tail = 0;
+   rb->curr_num_values = 0;
+   rb->overflow_policy = RB_OVERFLOW_REJECT;
+   rb->num_overwritten = 0;
+   rb->num_rejected = 0;
+   METRICS_HIGH_WATER_INIT(&rb->high_water);
+   return true;
+}
+
 /**
  * Check if the ring buffer is empty.
  *
@@ -64,6 +172,37 @@ bool ring_buffer_full(ring_buffer *rb){
    return(rb->curr_num_values == rb->max_num_values);
 }                
 
+/**
+ * Set what a write does when the buffer is full.
+ *
+ * rb is pointer to the ring buffer instance.
+ * policy is RB_OVERFLOW_REJECT or RB_OVERFLOW_OVERWRITE. Blocking
+ * makes no sense without a concurrent reader and is refused.
+ * returns true on success, false otherwise
+ */
+bool ring_buffer_set_overflow_policy(ring_buffer *rb, ring_buffer_overflow_policy policy){
+   if(policy != RB_OVERFLOW_REJECT && policy != RB_OVERFLOW_OVERWRITE){
+      return false;
+   }
+   rb->overflow_policy = policy;
+   return true;
+}
+
+/**
+ * In overwrite mode, drop the oldest values until n values fit.
+ * n must be at most max_num_values.
+ */
+static void ring_buffer_make_room(ring_buffer *rb, int n){
+   if(rb->overflow_policy != RB_OVERFLOW_OVERWRITE) return;
+   int drop = n - (rb->max_num_values - rb->curr_num_values);
+   if(drop <= 0) return;
+   rb->curr_num_values -= drop;
+   rb->head += drop;
+   if(rb->head >= rb->max_num_values) rb->head -= rb->max_num_values;
+   rb->num_overwritten += drop;
+   METRICS_ADD(METRIC_DROPS, drop);
+}
+
 /**
  * Write a float value to the tail of the ring buffer.
  *
@@ -75,13 +214,23 @@ bool ring_buffer_full(ring_buffer *rb){
 
 bool ring_buffer_write(ring_buffer *rb, float32_t value){
 
-   // test if buffer is full
-   if(ring_buffer_full(rb)){return false;}
-   // if not, add value to tail 
+   // test if buffer is full, in overwrite mode drop the oldest value
+   if(ring_buffer_full(rb)){
+      if(rb->overflow_policy != RB_OVERFLOW_OVERWRITE){
+         rb->num_rejected++;
+         METRICS_ADD(METRIC_DROPS, 1);
+         return false;
+      }
+      ring_buffer_make_room(rb, 1);
+   }
+   // add value to tail 
    rb->buffer[rb->tail] = value;
    rb->curr_num_values++;
+   METRICS_ADD(METRIC_SAMPLES_IN, 1);
+   METRICS_HIGH_WATER(&rb->high_water, rb->curr_num_values);
    // tail increments or wraps around
-   rb->tail = (rb->tail + 1) % rb->max_num_values; 
+   rb->tail = rb->pow2 ? (rb->tail + 1) & rb->index_mask
+                       : (rb->tail + 1) % rb->max_num_values; 
    return true;
 }
 
@@ -104,13 +253,183 @@ bool ring_buffer_read(ring_buffer *rb, float *result){
    // if not empty , return value from head
    *result = rb->buffer[rb->head];
    rb->curr_num_values--;
+   METRICS_ADD(METRIC_SAMPLES_OUT, 1);
    // head increments or wraps around
-   rb->head = (rb->head + 1) % rb->max_num_values;
+   rb->head = rb->pow2 ? (rb->head + 1) & rb->index_mask
+                       : (rb->head + 1) % rb->max_num_values;
+   return true;
+}
+
+/**
+ * Write a block of values to the tail of the ring buffer.
+ *
+ * rb is pointer to the ring buffer instance.
+ * values points to n values to be written. The copy is split into
+ * at most two contiguous segments around the end of the storage, so
+ * there is one full check and one wrap per block instead of per value.
+ * In overwrite mode the oldest values are dropped to make room, and if
+ * n is more than the capacity only the last max_num_values are kept.
+ * returns the number of values written (less than n if buffer fills).
+ */
+int ring_buffer_write_n(ring_buffer *rb, const float32_t *values, int n){
+   if(n <= 0) return 0;
+   if(rb->overflow_policy == RB_OVERFLOW_OVERWRITE && n > rb->max_num_values){
+      // the start of the block would be overwritten by its own end
+      rb->num_overwritten += n - rb->max_num_values;
+      METRICS_ADD(METRIC_DROPS, n - rb->max_num_values);
+      values += n - rb->max_num_values;
+      n = rb->max_num_values;
+   }
+   ring_buffer_make_room(rb, n);
+   int space = rb->max_num_values - rb->curr_num_values;
+   if(n > space){
+      rb->num_rejected += n - space;
+      METRICS_ADD(METRIC_DROPS, n - space);
+      n = space;
+   }
+   if(n == 0) return 0;
+
+   // first segment runs from tail up to the end of the storage
+   int first = rb->max_num_values - rb->tail;
+   if(first > n) first = n;
+   memcpy(rb->buffer + rb->tail, values, sizeof(float32_t)*first);
+   // second segment (if any) wraps around to the start
+   memcpy(rb->buffer, values + first, sizeof(float32_t)*(n - first));
+
+   rb->curr_num_values += n;
+   rb->tail += n;
+   if(rb->tail >= rb->max_num_values) rb->tail -= rb->max_num_values;
+   METRICS_ADD(METRIC_SAMPLES_IN, n);
+   METRICS_HIGH_WATER(&rb->high_water, rb->curr_num_values);
+   return n;
+}
+
+/**
+ * Read a block of values from the head of the ring buffer.
+ *
+ * rb is pointer to the ring buffer instance.
+ * result points to storage for at least n values, which are filled
+ * oldest first using at most two contiguous copies.
+ * returns the number of values read (less than n if buffer empties).
+ */
+int ring_buffer_read_n(ring_buffer *rb, float32_t *result, int n){
+   if(n > rb->curr_num_values) n = rb->curr_num_values;
+   if(n <= 0) return 0;
+
+   // first segment runs from head up to the end of the storage
+   int first = rb->max_num_values - rb->head;
+   if(first > n) first = n;
+   memcpy(result, rb->buffer + rb->head, sizeof(float32_t)*first);
+   // second segment (if any) wraps around to the start
+   memcpy(result + first, rb->buffer, sizeof(float32_t)*(n - first));
+
+   rb->curr_num_values -= n;
+   rb->head += n;
+   if(rb->head >= rb->max_num_values) rb->head -= rb->max_num_values;
+   METRICS_ADD(METRIC_SAMPLES_OUT, n);
+   return n;
+}
+
+/**
+ * Describe n values starting at storage index start as up to two spans.
+ */
+static void ring_buffer_spans(ring_buffer *rb, int start, int n, ring_buffer_span spans[2]){
+   // mirrored storage continues past the end, so one span is enough
+   int first = rb->mirror_bytes ? n : rb->max_num_values - start;
+   if(first > n) first = n;
+   spans[0].ptr = rb->buffer + start;
+   spans[0].len = first;
+   spans[1].ptr = rb->buffer;
+   spans[1].len = n - first;
+}
+
+/**
+ * Reserve free space at the tail for in-place writing.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the maximum number of values wanted.
+ * spans receives up to two pieces of free storage starting at tail.
+ * In overwrite mode the oldest values are dropped so n values fit, here
+ * and not at commit: abandoning the reservation does not bring them back.
+ * returns the number of values reserved, new values count from the commit.
+ */
+int ring_buffer_reserve(ring_buffer *rb, int n, ring_buffer_span spans[2]){
+   if(n > rb->max_num_values) n = rb->max_num_values;
+   if(n > 0) ring_buffer_make_room(rb, n);
+   int space = rb->max_num_values - rb->curr_num_values;
+   if(n > space) n = space;
+   if(n < 0) n = 0;
+   ring_buffer_spans(rb, rb->tail, n, spans);
+   return n;
+}
+
+/**
+ * Make n values written into reserved spans part of the buffer.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the number of values written, tail moves forward by n.
+ * returns true on success, false if n does not fit.
+ */
+bool ring_buffer_commit(ring_buffer *rb, int n){
+   if(n < 0 || n > rb->max_num_values - rb->curr_num_values) return false;
+   rb->curr_num_values += n;
+   rb->tail += n;
+   if(rb->tail >= rb->max_num_values) rb->tail -= rb->max_num_values;
+   METRICS_ADD(METRIC_SAMPLES_IN, n);
+   METRICS_HIGH_WATER(&rb->high_water, rb->curr_num_values);
+   return true;
+}
+
+/**
+ * Look at the oldest values in place.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the maximum number of values wanted.
+ * spans receives up to two pieces of storage starting at head.
+ * returns the number of values available, nothing changes until release.
+ */
+int ring_buffer_peek(ring_buffer *rb, int n, ring_buffer_span spans[2]){
+   if(n > rb->curr_num_values) n = rb->curr_num_values;
+   if(n < 0) n = 0;
+   ring_buffer_spans(rb, rb->head, n, spans);
+   return n;
+}
+
+/**
+ * Drop n values from the head after they were used in place.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the number of values consumed, head moves forward by n.
+ * returns true on success, false if fewer than n values are stored.
+ */
+bool ring_buffer_release(ring_buffer *rb, int n){
+   if(n < 0 || n > rb->curr_num_values) return false;
+   rb->curr_num_values -= n;
+   rb->head += n;
+   if(rb->head >= rb->max_num_values) rb->head -= rb->max_num_values;
+   METRICS_ADD(METRIC_SAMPLES_OUT, n);
    return true;
 }
 
 /**
- * Free the allocated memory from the ring buffer.
+ * Free the storage init allocated, keep the struct.
+ *
+ * rb is pointer to the ring buffer instance.
+ * return void
+ */
+void ring_buffer_deinit(ring_buffer *rb){
+   if (!rb) return;
+
+   if(rb->mirror_bytes){
+      vm_mirror_free(rb->buffer, rb->mirror_bytes);
+   } else if(!rb->external_storage){
+      free(rb->buffer);
+   }
+   rb->buffer = NULL; // safety
+}
+
+/**
+ * Free the allocated memory from the ring buffer, struct included.
  *
  * rb is pointer to the ring buffer instance.
  * return void 
@@ -118,8 +437,7 @@ bool ring_buffer_read(ring_buffer *rb, float *result){
 void ring_buffer_destroy(ring_buffer *rb){
    if (!rb) return; // if already null, nothing to do
 
-   free(rb->buffer);
-   rb->buffer = NULL; // safety
+   ring_buffer_deinit(rb);
    free(rb); 
    // can't set rb = NULL here bc NULL is passed in
    // setting rb = NULL is defined in a macro wherever
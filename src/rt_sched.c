@@ -0,0 +1,165 @@
+/**
+ * rt_sched.c
+ *
+ * Implementation of the scheduling policies and jitter histograms.
+ *
+ * Notes:
+ * - macOS takes the time-constraint parameters in Mach absolute time
+ *   units, converted from microseconds with mach_timebase_info() (1:1 on
+ *   Intel, 125:3 on Apple Silicon).
+ * - Linux applies SCHED_FIFO with pthread_setschedparam() and the affinity
+ *   with pthread_setaffinity_np(); both act on the calling thread only.
+ * - Histogram counters have a single writer, so recording is a relaxed
+ *   load/store per counter, no read-modify-write.
+ * - Use with rt_sched.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // pthread_setaffinity_np, cpu_set_t
+#endif
+
+#include "rt_sched.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#endif
+
+/*************************** Policies ***************************/
+
+#if defined(__APPLE__)
+static uint32_t us_to_mach(uint32_t us){
+   mach_timebase_info_data_t tb;
+   mach_timebase_info(&tb);
+   return (uint32_t)((uint64_t)us * 1000u * tb.denom / tb.numer);
+}
+
+static bool apply_realtime(const rt_sched_policy *policy){
+   uint32_t constraint = policy->constraint_us ? policy->constraint_us : policy->period_us;
+   if(policy->computation_us == 0 || constraint < policy->computation_us) return false;
+   thread_time_constraint_policy_data_t tc;
+   tc.period = us_to_mach(policy->period_us);
+   tc.computation = us_to_mach(policy->computation_us);
+   tc.constraint = us_to_mach(constraint);
+   tc.preemptible = TRUE;
+   kern_return_t kr = thread_policy_set(pthread_mach_thread_np(pthread_self()),
+                                        THREAD_TIME_CONSTRAINT_POLICY, (thread_policy_t)&tc,
+                                        THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+   return kr == KERN_SUCCESS;
+}
+
+static bool apply_affinity(uint64_t cpu_mask){
+   (void)cpu_mask; // no core pinning on Apple Silicon, placement follows the policy
+   return true;
+}
+#elif defined(__linux__)
+static bool apply_realtime(const rt_sched_policy *policy){
+   int priority = policy->priority ? policy->priority : RT_SCHED_DEFAULT_PRIORITY;
+   if(priority < sched_get_priority_min(SCHED_FIFO) || priority > sched_get_priority_max(SCHED_FIFO)){
+      return false;
+   }
+   struct sched_param param;
+   memset(&param, 0, sizeof(param));
+   param.sched_priority = priority;
+   return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+static bool apply_affinity(uint64_t cpu_mask){
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   for(int cpu = 0; cpu < 64; cpu++){
+      if(cpu_mask & ((uint64_t)1 << cpu)) CPU_SET(cpu, &set);
+   }
+   return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#else
+static bool apply_realtime(const rt_sched_policy *policy){
+   (void)policy;
+   return false;
+}
+
+static bool apply_affinity(uint64_t cpu_mask){
+   (void)cpu_mask;
+   return false;
+}
+#endif
+
+bool rt_sched_apply(const rt_sched_policy *policy){
+   if(!policy) return true;
+   bool ok = true;
+   if(policy->realtime && !apply_realtime(policy)) ok = false;
+   if(policy->cpu_mask && !apply_affinity(policy->cpu_mask)) ok = false;
+   return ok;
+}
+
+const char *rt_sched_name(const rt_sched_policy *policy){
+   if(!policy || !policy->realtime) return "default";
+#if defined(__APPLE__)
+   return "time-constraint";
+#elif defined(__linux__)
+   return "fifo";
+#else
+   return "unsupported";
+#endif
+}
+
+/**************************** Jitter ****************************/
+
+void rt_jitter_init(rt_jitter *j){
+   for(int i = 0; i < RT_JITTER_BUCKETS; i++) atomic_init(&j->buckets[i], 0);
+   atomic_init(&j->count, 0);
+   atomic_init(&j->sum_ns, 0);
+   atomic_init(&j->max_ns, 0);
+}
+
+static void counter_add(_Atomic uint64_t *counter, uint64_t n){
+   atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                         memory_order_relaxed);
+}
+
+void rt_jitter_record(rt_jitter *j, uint64_t latency_ns){
+   // bucket i holds [2^(i-1), 2^i) us, bucket 0 everything below 1 us
+   uint64_t us = latency_ns / 1000u;
+   int bucket = 0;
+   while(us != 0 && bucket < RT_JITTER_BUCKETS - 1){
+      us >>= 1;
+      bucket++;
+   }
+   counter_add(&j->buckets[bucket], 1);
+   counter_add(&j->count, 1);
+   counter_add(&j->sum_ns, latency_ns);
+   if(latency_ns > atomic_load_explicit(&j->max_ns, memory_order_relaxed)){
+      atomic_store_explicit(&j->max_ns, latency_ns, memory_order_relaxed);
+   }
+}
+
+void rt_jitter_read(const rt_jitter *j, rt_jitter_snapshot *out){
+   // count from the buckets, so the copy is consistent with itself
+   out->count = 0;
+   for(int i = 0; i < RT_JITTER_BUCKETS; i++){
+      out->buckets[i] = atomic_load_explicit(&j->buckets[i], memory_order_relaxed);
+      out->count += out->buckets[i];
+   }
+   out->sum_ns = atomic_load_explicit(&j->sum_ns, memory_order_relaxed);
+   out->max_ns = atomic_load_explicit(&j->max_ns, memory_order_relaxed);
+}
+
+uint64_t rt_jitter_percentile_us(const rt_jitter_snapshot *s, double percentile){
+   if(s->count == 0) return 0;
+   uint64_t rank = (uint64_t)(s->count * percentile / 100.0 + 0.999999);
+   if(rank < 1) rank = 1;
+   if(rank > s->count) rank = s->count;
+   uint64_t seen = 0;
+   for(int i = 0; i < RT_JITTER_BUCKETS - 1; i++){
+      seen += s->buckets[i];
+      if(seen >= rank) return (uint64_t)1 << i;
+   }
+   return (s->max_ns + 999u) / 1000u;
+}
@@ -0,0 +1,116 @@
+/**
+ * sample_clock.c
+ *
+ * Implementation of the sample clock recovery and gap fill.
+ *
+ * Notes:
+ * - The fit is updated with exponentially weighted means, variance and
+ *   covariance (West's incremental form), O(1) per batch. The weight is
+ *   1/n for the first batches, so they average plainly and the estimate
+ *   settles fast, then SAMPLE_CLOCK_ALPHA, so old batches fade out and a
+ *   drifting crystal (temperature) is followed.
+ * - x and y are kept relative to the first observation of the run, so the
+ *   doubles hold small numbers even after days of streaming.
+ * - A sequence delta of 32768 or more is taken as going backwards: with 16
+ *   bit sequence numbers a forward gap that long cannot be told apart.
+ * - Use with sample_clock.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "sample_clock.h"
+#include <math.h>
+#include <string.h>
+
+bool sample_clock_init(sample_clock *c, double nominal_rate, int max_fill_frames){
+   if(!(nominal_rate > 0.0) || max_fill_frames < 0) return false;
+   memset(c, 0, sizeof(*c));
+   c->nominal_rate = nominal_rate;
+   c->max_fill_frames = max_fill_frames;
+   return true;
+}
+
+int sample_clock_packet(sample_clock *c, uint16_t seq, int num_frames){
+   int fill = 0;
+   if(c->have_seq && seq != c->next_seq){
+      uint16_t lost = (uint16_t)(seq - c->next_seq);
+      if(lost >= 0x8000u){
+         // the board restarted: a new run of indices and a new fit
+         c->resyncs++;
+         c->next_index = 0;
+         c->observations = 0;
+      } else {
+         uint64_t missing = (uint64_t)lost * (uint64_t)num_frames;
+         if(missing <= (uint64_t)c->max_fill_frames){
+            fill = (int)missing;
+            c->gaps++;
+            c->frames_filled += missing;
+         } else {
+            c->resyncs++;
+         }
+         c->next_index += missing;
+      }
+   }
+   c->have_seq = true;
+   c->next_seq = (uint16_t)(seq + 1);
+   c->next_index += (uint64_t)num_frames;
+   return fill;
+}
+
+void sample_clock_observe(sample_clock *c, uint64_t now_ns){
+   if(c->observations == 0){
+      c->origin_index = c->next_index;
+      c->origin_ns = now_ns;
+      c->mean_x = c->mean_y = 0.0;
+      c->var_x = c->cov_xy = 0.0;
+   }
+   double x = (double)(c->next_index - c->origin_index);
+   double y = (double)(int64_t)(now_ns - c->origin_ns);
+   c->observations++;
+   double a = 1.0 / (double)c->observations;
+   if(a < SAMPLE_CLOCK_ALPHA) a = SAMPLE_CLOCK_ALPHA;
+   double dx = x - c->mean_x;
+   double dy = y - c->mean_y;
+   c->mean_x += a * dx;
+   c->mean_y += a * dy;
+   c->var_x = (1.0 - a) * (c->var_x + a * dx * dx);
+   c->cov_xy = (1.0 - a) * (c->cov_xy + a * dx * dy);
+}
+
+// slope of the fit in ns per sample, 0 until it has settled
+static double fitted_period(const sample_clock *c){
+   if(c->observations < SAMPLE_CLOCK_MIN_OBSERVATIONS || !(c->var_x > 0.0)) return 0.0;
+   double slope = c->cov_xy / c->var_x;
+   return slope > 0.0 ? slope : 0.0;
+}
+
+double sample_clock_rate(const sample_clock *c){
+   double period = fitted_period(c);
+   return period > 0.0 ? 1e9 / period : c->nominal_rate;
+}
+
+bool sample_clock_time_ns(const sample_clock *c, uint64_t index, uint64_t *time_ns){
+   if(c->observations == 0) return false;
+   double x = (double)(int64_t)(index - c->origin_index);
+   double period = fitted_period(c);
+   if(period == 0.0) period = 1e9 / c->nominal_rate;
+   double y = c->mean_y + period * (x - c->mean_x);
+   *time_ns = c->origin_ns + (uint64_t)(int64_t)llround(y);
+   return true;
+}
+
+double sample_clock_drift_ppm(const sample_clock *c){
+   return (sample_clock_rate(c) / c->nominal_rate - 1.0) * 1e6;
+}
+
+void sample_clock_fill_codes(const int16_t *before, const int16_t *after, int num_channels,
+                             int gap_frames, int first, int num_frames, int16_t *out){
+   for(int f = 0; f < num_frames; f++){
+      double t = (double)(first + f + 1) / (double)(gap_frames + 1);
+      for(int ch = 0; ch < num_channels; ch++){
+         double v = before[ch] + t * (after[ch] - before[ch]);
+         out[f * num_channels + ch] = (int16_t)lround(v);
+      }
+   }
+}
@@ -0,0 +1,188 @@
+/**
+ * serial_protocol.c
+ *
+ * Implementation of the framed serial packet format: CRC, encoder and the
+ * incremental, resynchronizing parser.
+ *
+ * Notes:
+ * - Fields are assembled byte by byte, so the code does not depend on host
+ *   endianness or on the alignment of the staging buffer.
+ * - The staging buffer only ever starts with a (possible) sync word. Bytes
+ *   in front of it are dropped and counted in bytes_skipped.
+ * - Use with serial_protocol.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "serial_protocol.h"
+#include <string.h>
+
+#define SYNC_LO (SERIAL_PROTO_SYNC & 0xFF)
+#define SYNC_HI (SERIAL_PROTO_SYNC >> 8)
+
+static uint16_t get_u16(const uint8_t *b){
+   return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static void put_u16(uint8_t *b, uint16_t v){
+   b[0] = (uint8_t)(v & 0xFF);
+   b[1] = (uint8_t)(v >> 8);
+}
+
+size_t serial_packet_size(int num_channels, int num_frames){
+   return SERIAL_PROTO_HEADER_SIZE + 2 * (size_t)num_channels * num_frames
+          + SERIAL_PROTO_CRC_SIZE;
+}
+
+uint16_t serial_crc16(const uint8_t *data, size_t len){
+   uint16_t crc = 0xFFFF;
+   for(size_t i = 0; i < len; i++){
+      crc ^= (uint16_t)data[i] << 8;
+      for(int bit = 0; bit < 8; bit++){
+         crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+      }
+   }
+   return crc;
+}
+
+/**
+ * Checks channel and frame counts against the protocol limits.
+ */
+static bool sizes_valid(int num_channels, int num_frames){
+   if(num_channels < 1 || num_channels > SERIAL_PROTO_MAX_CHANNELS) return false;
+   if(num_frames < 1 || num_frames > SERIAL_PROTO_MAX_FRAMES) return false;
+   return num_channels * num_frames <= SERIAL_PROTO_MAX_CODES;
+}
+
+size_t serial_packet_encode(uint8_t *out, uint16_t seq, int num_channels, int num_frames,
+                            const int16_t *codes){
+   if(!sizes_valid(num_channels, num_frames)) return 0;
+   int num_codes = num_channels * num_frames;
+
+   put_u16(out, SERIAL_PROTO_SYNC);
+   put_u16(out + 2, seq);
+   out[4] = (uint8_t)num_channels;
+   out[5] = SERIAL_PROTO_VERSION;
+   put_u16(out + 6, (uint16_t)num_frames);
+   uint8_t *payload = out + SERIAL_PROTO_HEADER_SIZE;
+   for(int i = 0; i < num_codes; i++){
+      put_u16(payload + 2 * i, (uint16_t)codes[i]);
+   }
+   size_t crc_offset = SERIAL_PROTO_HEADER_SIZE + 2 * (size_t)num_codes;
+   put_u16(out + crc_offset, serial_crc16(out + 2, crc_offset - 2));
+   return crc_offset + SERIAL_PROTO_CRC_SIZE;
+}
+
+void serial_parser_init(serial_parser *p){
+   p->len = 0;
+   p->have_seq = false;
+   p->next_seq = 0;
+   p->packets_ok = 0;
+   p->packets_lost = 0;
+   p->frames_lost = 0;
+   p->crc_errors = 0;
+   p->bytes_skipped = 0;
+}
+
+/**
+ * Drop the first n bytes of the staging buffer.
+ */
+static void parser_drop(serial_parser *p, size_t n){
+   memmove(p->buf, p->buf + n, p->len - n);
+   p->len -= n;
+}
+
+/**
+ * Drop bytes until the staging buffer starts with the sync word, or with
+ * its first byte as the last byte received.
+ */
+static void parser_seek_sync(serial_parser *p){
+   size_t i = 0;
+   while(i < p->len){
+      if(p->buf[i] == SYNC_LO && (i + 1 == p->len || p->buf[i + 1] == SYNC_HI)) break;
+      i++;
+   }
+   if(i > 0){
+      p->bytes_skipped += i;
+      parser_drop(p, i);
+   }
+}
+
+/**
+ * Give up on the candidate packet at the start of the buffer: skip its
+ * first sync byte so the search starts again right after it.
+ */
+static void parser_reject(serial_parser *p){
+   p->bytes_skipped++;
+   parser_drop(p, 1);
+}
+
+/**
+ * Decode the complete packet at the start of the staging buffer.
+ */
+static void parser_decode(serial_parser *p, int num_channels, int num_frames){
+   serial_packet *pkt = &p->pkt;
+   pkt->seq = get_u16(p->buf + 2);
+   pkt->num_channels = num_channels;
+   pkt->num_frames = num_frames;
+   const uint8_t *payload = p->buf + SERIAL_PROTO_HEADER_SIZE;
+   for(int i = 0; i < num_channels * num_frames; i++){
+      pkt->codes[i] = (int16_t)get_u16(payload + 2 * i);
+   }
+
+   if(p->have_seq && pkt->seq != p->next_seq){
+      uint16_t gap = (uint16_t)(pkt->seq - p->next_seq);
+      p->packets_lost += gap;
+      p->frames_lost += (uint64_t)gap * num_frames;
+   }
+   p->have_seq = true;
+   p->next_seq = (uint16_t)(pkt->seq + 1);
+   p->packets_ok++;
+}
+
+int serial_parser_feed(serial_parser *p, const uint8_t *data, size_t len,
+                       serial_packet_fn fn, void *ctx){
+   int delivered = 0;
+   while(1){
+      parser_seek_sync(p);
+
+      // how many bytes the packet at the start of the buffer needs
+      size_t need = SERIAL_PROTO_HEADER_SIZE;
+      int num_channels = 0;
+      int num_frames = 0;
+      if(p->len >= SERIAL_PROTO_HEADER_SIZE){
+         num_channels = p->buf[4];
+         num_frames = get_u16(p->buf + 6);
+         if(p->buf[5] != SERIAL_PROTO_VERSION || !sizes_valid(num_channels, num_frames)){
+            parser_reject(p); // not a header, the sync word was payload
+            continue;
+         }
+         need = serial_packet_size(num_channels, num_frames);
+      }
+
+      if(p->len < need){
+         if(len == 0) break;
+         size_t n = need - p->len;
+         if(n > len) n = len;
+         memcpy(p->buf + p->len, data, n);
+         p->len += n;
+         data += n;
+         len -= n;
+         continue;
+      }
+
+      // complete packet, check it before trusting the payload
+      size_t crc_offset = need - SERIAL_PROTO_CRC_SIZE;
+      if(serial_crc16(p->buf + 2, crc_offset - 2) != get_u16(p->buf + crc_offset)){
+         p->crc_errors++;
+         parser_reject(p);
+         continue;
+      }
+      parser_decode(p, num_channels, num_frames);
+      parser_drop(p, need);
+      if(fn) fn(&p->pkt, ctx);
+      delivered++;
+   }
+   return delivered;
+}
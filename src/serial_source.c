@@ -0,0 +1,445 @@
+/**
+ * serial_source.c
+ *
+ * Implementation of the tty, synthetic pty and replay byte sources.
+ *
+ * Notes:
+ * - The feeder threads write with O_NONBLOCK and retry after a short sleep
+ *   on a full buffer, so serial_source_close() can stop them even when the
+ *   reader has gone away. poll() on a pty is not reliable on macOS.
+ * - Before the synth source hangs up it waits until the reader has taken
+ *   every byte: closing the pty master discards unread slave input on
+ *   Linux. A pipe (replay) delivers its data before the end of file anyway.
+ * - Deadlines are absolute, computed from the packet index, so late wakeups
+ *   are made up by the following packets instead of stretching the run.
+ * - Use with serial_source.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // posix_openpt, ptsname
+#endif
+
+#include "serial_source.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include "serial_protocol.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SERIAL_SYNTH_MAX_BURST 64
+#define FEED_RETRY_US 200          // sleep when the reader's buffer is full
+#define DRAIN_POLL_US 1000
+#define DRAIN_QUIET_POLLS 3        // consecutive empty polls before the hang-up
+
+static uint64_t now_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// no clock_nanosleep() on macOS: sleep the time left to an absolute deadline
+static void sleep_until(uint64_t deadline_ns){
+   uint64_t now = now_ns();
+   if(deadline_ns <= now) return;
+   uint64_t left = deadline_ns - now;
+   struct timespec ts = { (time_t)(left / 1000000000u), (long)(left % 1000000000u) };
+   nanosleep(&ts, NULL);
+}
+
+static void sleep_us(long us){
+   struct timespec ts = { 0, us * 1000L };
+   nanosleep(&ts, NULL);
+}
+
+static void source_reset(serial_source *s, serial_source_kind kind){
+   memset(s, 0, sizeof(*s));
+   s->kind = kind;
+   s->fd = -1;
+   s->feed_fd = -1;
+   s->file_fd = -1;
+   atomic_init(&s->stop, false);
+   atomic_init(&s->packets_sent, 0);
+   atomic_init(&s->bytes_sent, 0);
+}
+
+// writes all of buf unless the source is stopped or the reader is gone
+static bool feed_all(serial_source *s, const uint8_t *buf, size_t len){
+   while(len > 0){
+      if(atomic_load_explicit(&s->stop, memory_order_relaxed)) return false;
+      ssize_t n = write(s->feed_fd, buf, len);
+      if(n > 0){
+         buf += n;
+         len -= (size_t)n;
+         atomic_fetch_add_explicit(&s->bytes_sent, (uint64_t)n, memory_order_relaxed);
+         continue;
+      }
+      if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+         sleep_us(FEED_RETRY_US);
+         continue;
+      }
+      if(n < 0 && errno == EINTR) continue;
+      return false;
+   }
+   return true;
+}
+
+static double packet_period_ns(int frames_per_packet, float sample_rate, float speed){
+   if(speed <= 0.0f) return 0.0;
+   return frames_per_packet * 1e9 / sample_rate / speed;
+}
+
+/****************************** tty ******************************/
+
+bool serial_source_open_tty(serial_source *s, const char *path, const serial_tuning *tuning){
+   source_reset(s, SERIAL_SOURCE_TTY);
+   // O_RDWR = open serial port for read and write
+   // O_NOCTTY = don't let serial port be a controlling terminal
+   // meaning if data comes in it can't affect the program
+   // O_RDWR | O_NOCTTY is a bitmask, so both of these things become true
+
+   // fd = file descriptor, a number that identifies the open file
+   // a file descriptor is a small integer that the OS uses to keep track
+   // of open files, devices, or sockets in a program.
+   // fd = 0 (stdin, keyboard)
+   // fd = 1 (stdout, terminal output)
+   // fd = 2 (stderr, error output)
+   // fd = 3 (/dev/tty.usbserial, our serial port)
+   s->fd = open(path, O_RDWR | O_NOCTTY);
+   if(s->fd == -1) return false;
+   setup_serial(s->fd, tuning);
+   return true;
+}
+
+/***************************** Synth *****************************/
+
+float serial_synth_clean_v(const serial_synth_config *config, uint64_t frame, int channel){
+   double t = (double)frame / config->sample_rate;
+   double v = 0.0;
+   for(int i = 0; i < config->num_tones; i++){
+      v += config->tone_v[i] * sin(2.0 * M_PI * config->tone_hz[i] * t);
+   }
+   return (float)(config->offset_v + v * (1.0 + 0.25 * channel));
+}
+
+static uint32_t xorshift32(uint32_t *state){
+   uint32_t x = *state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   *state = x;
+   return x;
+}
+
+static int16_t volts_to_code(float v){
+   float code = roundf(v * (SERIAL_ADC_MAX_CODE / SERIAL_ADC_VREF));
+   if(code < 0.0f) code = 0.0f;
+   if(code > SERIAL_ADC_MAX_CODE) code = SERIAL_ADC_MAX_CODE;
+   return (int16_t)code;
+}
+
+// waits until serial_reader has read everything, bounded by SERIAL_SOURCE_DRAIN_MS
+static void wait_for_drain(serial_source *s){
+   int quiet = 0;
+   for(int waited_us = 0; waited_us < SERIAL_SOURCE_DRAIN_MS * 1000; waited_us += DRAIN_POLL_US){
+      if(atomic_load_explicit(&s->stop, memory_order_relaxed)) return;
+      int pending = 0;
+      if(ioctl(s->fd, FIONREAD, &pending) != 0) return;
+      quiet = pending == 0 ? quiet + 1 : 0;
+      if(quiet == DRAIN_QUIET_POLLS) return;
+      sleep_us(DRAIN_POLL_US);
+   }
+}
+
+static void *synth_thread(void *arg){
+   serial_source *s = (serial_source *)arg;
+   const serial_synth_config *cfg = &s->synth;
+   int codes_per_packet = cfg->num_channels * cfg->frames_per_packet;
+   size_t packet_size = serial_packet_size(cfg->num_channels, cfg->frames_per_packet);
+   int burst = cfg->burst_packets > 1 ? cfg->burst_packets : 1;
+   uint8_t *out = malloc(packet_size * (size_t)burst);
+   int16_t *codes = malloc(sizeof(int16_t) * (size_t)codes_per_packet);
+   if(!out || !codes){
+      free(out);
+      free(codes);
+      return NULL;
+   }
+
+   uint32_t rng = cfg->seed ? cfg->seed : 1;
+   double period = packet_period_ns(cfg->frames_per_packet, cfg->sample_rate, cfg->speed);
+   uint64_t start = now_ns();
+   size_t pending = 0;
+   bool open = true;
+   for(uint64_t k = 0; open && (cfg->num_packets == 0 || k < cfg->num_packets); k++){
+      // the noise is drawn for dropped packets too, so faults do not change the rest
+      for(int f = 0; f < cfg->frames_per_packet; f++){
+         uint64_t frame = k * (uint64_t)cfg->frames_per_packet + (uint64_t)f;
+         for(int ch = 0; ch < cfg->num_channels; ch++){
+            float noise = ((xorshift32(&rng) >> 8) * (2.0f / 16777216.0f) - 1.0f) * cfg->noise_v;
+            codes[f * cfg->num_channels + ch] = volts_to_code(serial_synth_clean_v(cfg, frame, ch) + noise);
+         }
+      }
+      bool dropped = cfg->drop_every > 0 && (k + 1) % (uint64_t)cfg->drop_every == 0;
+      if(!dropped){
+         uint8_t *pkt = out + pending;
+         pending += serial_packet_encode(pkt, (uint16_t)k, cfg->num_channels, cfg->frames_per_packet, codes);
+         if(cfg->corrupt_every > 0 && (k + 1) % (uint64_t)cfg->corrupt_every == 0){
+            pkt[SERIAL_PROTO_HEADER_SIZE] ^= 0x01;
+         }
+         atomic_fetch_add_explicit(&s->packets_sent, 1, memory_order_relaxed);
+      }
+      bool last = cfg->num_packets != 0 && k + 1 == cfg->num_packets;
+      if((k + 1) % (uint64_t)burst == 0 || last){
+         // a burst goes out when its last packet is due
+         if(period > 0.0) sleep_until(start + (uint64_t)((k + 1) * period));
+         if(pending > 0) open = feed_all(s, out, pending);
+         pending = 0;
+      }
+   }
+   if(open) wait_for_drain(s);
+   // hang up: the reader sees end of file / EIO
+   close(s->feed_fd);
+   s->feed_fd = -1;
+   free(out);
+   free(codes);
+   return NULL;
+}
+
+bool serial_source_open_synth(serial_source *s, const serial_synth_config *config){
+   source_reset(s, SERIAL_SOURCE_SYNTH);
+   if(!config || config->num_channels < 1 || config->frames_per_packet < 1 ||
+      config->num_channels * config->frames_per_packet > SERIAL_PROTO_MAX_CODES ||
+      config->num_channels > SERIAL_PROTO_MAX_CHANNELS || config->sample_rate <= 0.0f ||
+      config->speed < 0.0f || config->num_tones < 0 || config->num_tones > SERIAL_SYNTH_MAX_TONES ||
+      config->burst_packets < 0 || config->burst_packets > SERIAL_SYNTH_MAX_BURST){
+      return false;
+   }
+   s->synth = *config;
+
+   s->feed_fd = posix_openpt(O_RDWR | O_NOCTTY);
+   if(s->feed_fd == -1) return false;
+   const char *slave = NULL;
+   if(grantpt(s->feed_fd) == 0 && unlockpt(s->feed_fd) == 0) slave = ptsname(s->feed_fd);
+   if(slave) s->fd = open(slave, O_RDWR | O_NOCTTY);
+   if(s->fd == -1){
+      serial_source_close(s);
+      return false;
+   }
+   // the slave is configured like the real port, raw 8N1
+   serial_tuning tuning = { 1, 0 };
+   setup_serial(s->fd, &tuning);
+   int flags = fcntl(s->feed_fd, F_GETFL);
+   if(flags != -1) fcntl(s->feed_fd, F_SETFL, flags | O_NONBLOCK);
+
+   if(pthread_create(&s->thread, NULL, synth_thread, s) != 0){
+      serial_source_close(s);
+      return false;
+   }
+   s->thread_started = true;
+   return true;
+}
+
+/***************************** Replay *****************************/
+
+static void *replay_thread(void *arg){
+   serial_source *s = (serial_source *)arg;
+   const serial_replay_config *cfg = &s->replay;
+   // one packet's worth of bytes per deadline keeps the recorded byte rate
+   size_t chunk = serial_packet_size(cfg->num_channels, cfg->frames_per_packet);
+   uint8_t *buf = malloc(chunk);
+   if(buf){
+      double period = packet_period_ns(cfg->frames_per_packet, cfg->sample_rate, cfg->speed);
+      uint64_t start = now_ns();
+      for(uint64_t k = 0; ; k++){
+         ssize_t n = read(s->file_fd, buf, chunk);
+         if(n < 0 && errno == EINTR) continue;
+         if(n <= 0) break;
+         sleep_until(start + (uint64_t)((k + 1) * period));
+         if(!feed_all(s, buf, (size_t)n)) break;
+         atomic_fetch_add_explicit(&s->packets_sent, 1, memory_order_relaxed);
+      }
+   }
+   free(buf);
+   // end of file for the reader once it has read the pipe empty
+   close(s->feed_fd);
+   s->feed_fd = -1;
+   return NULL;
+}
+
+bool serial_source_open_replay(serial_source *s, const char *path,
+                               const serial_replay_config *config){
+   source_reset(s, SERIAL_SOURCE_REPLAY);
+   if(!config || config->num_channels < 1 || config->frames_per_packet < 1 ||
+      config->sample_rate <= 0.0f || config->speed < 0.0f){
+      return false;
+   }
+   s->replay = *config;
+   s->file_fd = open(path, O_RDONLY);
+   if(s->file_fd == -1) return false;
+   if(config->speed == 0.0f){
+      // maximum speed: the reader takes the file as fast as it can read
+      s->fd = s->file_fd;
+      s->file_fd = -1;
+      return true;
+   }
+
+   int fds[2];
+   if(pipe(fds) != 0){
+      serial_source_close(s);
+      return false;
+   }
+   s->fd = fds[0];
+   s->feed_fd = fds[1];
+   int flags = fcntl(s->feed_fd, F_GETFL);
+   if(flags != -1) fcntl(s->feed_fd, F_SETFL, flags | O_NONBLOCK);
+   if(pthread_create(&s->thread, NULL, replay_thread, s) != 0){
+      serial_source_close(s);
+      return false;
+   }
+   s->thread_started = true;
+   return true;
+}
+
+/**************************** Recording ****************************/
+
+// sends one re-encoded packet once it is due, t_ns after the replay's start
+// on the recorded timing; false once the reader side is gone
+static bool send_recorded(serial_source *s, uint8_t *out, uint16_t seq, int nch, int n,
+                          const int16_t *codes, uint64_t start, uint64_t t_ns){
+   size_t len = serial_packet_encode(out, seq, nch, n, codes);
+   if(s->rec_config.speed > 0.0f) sleep_until(start + (uint64_t)(t_ns / s->rec_config.speed));
+   if(!feed_all(s, out, len)) return false;
+   atomic_fetch_add_explicit(&s->packets_sent, 1, memory_order_relaxed);
+   return true;
+}
+
+static void *recording_thread(void *arg){
+   serial_source *s = (serial_source *)arg;
+   const recording *rec = &s->rec;
+   int nch = (int)rec->header->num_channels;
+   uint64_t fpp = (uint64_t)s->rec_config.frames_per_packet;
+   double frame_ns = 1e9 / rec->header->sample_rate;
+   uint8_t *out = malloc(serial_packet_size(nch, (int)fpp));
+   int16_t *codes = malloc(sizeof(int16_t) * (size_t)nch * fpp);
+   bool open = out && codes;
+
+   // recorded packets hold fpp frames from frame 0: start at the one holding
+   // the start frame, which may begin in the previous chunk
+   uint64_t c = s->rec_start.chunk;
+   uint32_t f = s->rec_start.frame;
+   const float *frames;
+   const recording_chunk_header *hdr = recording_chunk(rec, c, &frames);
+   uint64_t back = (hdr->first_frame + f) % fpp;
+   while(back > 0){
+      if(f > 0){
+         uint32_t step = back < f ? (uint32_t)back : f;
+         f -= step;
+         back -= step;
+         continue;
+      }
+      if(c == 0) break;
+      const recording_chunk_header *prev = recording_chunk(rec, c - 1, &frames);
+      if(prev->first_frame + prev->num_frames != hdr->first_frame) break;
+      c--;
+      hdr = prev;
+      f = prev->num_frames;
+   }
+
+   uint64_t start = now_ns();
+   uint64_t t0 = hdr->timestamp_ns + (uint64_t)(f * frame_ns);
+   uint64_t t = 0;        // recorded time of the newest frame taken, since t0
+   uint64_t packet = 0;   // recorded packet being filled
+   uint16_t seq = 0;
+   int held = 0;          // its frames so far, carried across chunks
+   for(; open && c < rec->num_chunks; c++, f = 0){
+      hdr = recording_chunk(rec, c, &frames);
+      while(open && f < hdr->num_frames){
+         uint64_t at = hdr->first_frame + f;
+         // the chunk's first_seq numbers all its packets, so packets lost on
+         // the wire while recording are lost on replay too
+         if(held > 0 && at / fpp != packet){
+            // frames missing from the recording, send what there is
+            open = send_recorded(s, out, seq, nch, held, codes, start, t);
+            held = 0;
+            if(!open) break;
+         }
+         if(held == 0){
+            packet = at / fpp;
+            seq = (uint16_t)(hdr->first_seq + packet - hdr->first_frame / fpp);
+         }
+         uint64_t left = fpp - at % fpp;
+         int n = (uint64_t)(hdr->num_frames - f) < left ? (int)(hdr->num_frames - f) : (int)left;
+         int16_t *dst = codes + (size_t)held * (size_t)nch;
+         for(int i = 0; i < n * nch; i++) dst[i] = volts_to_code(frames[(size_t)f * nch + i]);
+         held += n;
+         f += (uint32_t)n;
+         // due when its last frame was recorded
+         t = hdr->timestamp_ns + (uint64_t)(f * frame_ns) - t0;
+         if((at + (uint64_t)n) % fpp != 0) break; // the rest is in the next chunk
+         open = send_recorded(s, out, seq, nch, held, codes, start, t);
+         held = 0;
+      }
+   }
+   // the recording ended inside a packet
+   if(open && held > 0) send_recorded(s, out, seq, nch, held, codes, start, t);
+   free(out);
+   free(codes);
+   close(s->feed_fd);
+   s->feed_fd = -1;
+   return NULL;
+}
+
+bool serial_source_open_recording(serial_source *s, const char *path,
+                                  const serial_recording_config *config){
+   source_reset(s, SERIAL_SOURCE_RECORDING);
+   if(!config || config->frames_per_packet < 1 || config->speed < 0.0f) return false;
+   s->rec_config = *config;
+   if(!recording_open(&s->rec, path)) return false;
+   int nch = (int)s->rec.header->num_channels;
+   if(nch > SERIAL_PROTO_MAX_CHANNELS || nch * config->frames_per_packet > SERIAL_PROTO_MAX_CODES ||
+      !recording_seek(&s->rec, config->start_ns, &s->rec_start)){
+      serial_source_close(s);
+      return false;
+   }
+
+   int fds[2];
+   if(pipe(fds) != 0){
+      serial_source_close(s);
+      return false;
+   }
+   s->fd = fds[0];
+   s->feed_fd = fds[1];
+   int flags = fcntl(s->feed_fd, F_GETFL);
+   if(flags != -1) fcntl(s->feed_fd, F_SETFL, flags | O_NONBLOCK);
+   if(pthread_create(&s->thread, NULL, recording_thread, s) != 0){
+      serial_source_close(s);
+      return false;
+   }
+   s->thread_started = true;
+   return true;
+}
+
+/****************************** Close ******************************/
+
+void serial_source_close(serial_source *s){
+   atomic_store(&s->stop, true);
+   if(s->thread_started) pthread_join(s->thread, NULL);
+   s->thread_started = false;
+   if(s->feed_fd != -1) close(s->feed_fd);
+   if(s->file_fd != -1) close(s->file_fd);
+   if(s->fd != -1) close(s->fd);
+   recording_close(&s->rec);
+   s->feed_fd = -1;
+   s->file_fd = -1;
+   s->fd = -1;
+}
@@ -0,0 +1,765 @@
+/**
+ * spsc_ring_buffer.c
+ *
+ * Implementation of a lock-free single-producer/single-consumer ring buffer
+ * for floating-point data streams shared between two threads.
+ *
+ * Notes:
+ * - head and tail run over [0, 2*capacity) so full and empty differ without
+ *   a shared counter. The storage slot of an index is index mod capacity.
+ * - Power-of-two buffers use free-running counters: unsigned subtraction gives
+ *   the fill level even across the 2^32 wrap, and the slot is a bit mask.
+ * - The producer stores tail with release order after writing the sample, the
+ *   consumer loads it with acquire order before reading the sample (and the
+ *   other way round for head). This is the only synchronization needed.
+ * - Each side caches the other side's index and only reloads it (touching the
+ *   other cache line) when the cached value says full/empty.
+ * - Mirrored buffers are mapped twice back-to-back, so spans never split.
+ * - Caller storage (spsc_ring_buffer_init_with_storage()) is never freed.
+ * - Block copies and spans work on bytes (value_size per value), so float
+ *   and int16 rings share one implementation of the index logic.
+ * - In overwrite mode the producer drops the oldest values by moving head with
+ *   a compare-and-swap. The consumer then advances head with a CAS too and
+ *   retries (or reports from release) if the producer got there first, so a
+ *   value that was overwritten while being read is never returned (unless the
+ *   producer laps the whole index range during a single read).
+ * - With EEG_METRICS, values in/out/dropped go to the calling thread's
+ *   metrics slot and the producer updates the high-water mark after every
+ *   publish. That costs a load of head per write (the consumer's line),
+ *   which the cached head cannot replace: it is only refreshed near full.
+ * - Use with spsc_ring_buffer.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "spsc_ring_buffer.h"
+#include "vm_mirror.h"
+#include "metrics.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+
+/**
+ * Number of values between head and tail, both in [0, 2*capacity).
+ */
+static inline unsigned int spsc_distance(const spsc_ring_buffer *rb,
+                                         unsigned int head, unsigned int tail){
+   if(rb->pow2) return tail - head;
+   return (tail >= head) ? tail - head
+                         : tail + 2u*(unsigned int)rb->max_num_values - head;
+}
+
+/**
+ * Advance an index by n <= capacity, wrapping at 2*capacity.
+ * A compare and subtract instead of the modulo used in ring_buffer.c.
+ */
+static inline unsigned int spsc_advance(const spsc_ring_buffer *rb,
+                                        unsigned int idx, unsigned int n){
+   idx += n;
+   if(rb->pow2) return idx;
+   if(idx >= 2u*(unsigned int)rb->max_num_values) idx -= 2u*(unsigned int)rb->max_num_values;
+   return idx;
+}
+
+/**
+ * Storage slot for an index in [0, 2*capacity).
+ */
+static inline unsigned int spsc_slot(const spsc_ring_buffer *rb, unsigned int idx){
+   if(rb->pow2) return idx & rb->index_mask;
+   unsigned int cap = (unsigned int)rb->max_num_values;
+   return (idx >= cap) ? idx - cap : idx;
+}
+
+/**
+ * Reset both indices and their cached copies.
+ */
+static void spsc_reset_indices(spsc_ring_buffer *rb){
+   atomic_init(&rb->head, 0);
+   atomic_init(&rb->tail, 0);
+   rb->head_cache = 0;
+   rb->tail_cache = 0;
+   rb->peek_head = 0;
+   atomic_init(&rb->num_overwritten, 0);
+   atomic_init(&rb->num_rejected, 0);
+   METRICS_HIGH_WATER_INIT(&rb->high_water);
+   rb->overflow_policy = RB_OVERFLOW_REJECT;
+   rb->block_timeout_us = 0;
+}
+
+/**
+ * Check that n is a power of two (n > 0).
+ */
+static bool is_pow2(int n){
+   return n > 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * Allocates memory for a new SPSC ring buffer with the specified capacity.
+ *
+ * rb is pointer to the ring buffer instance.
+ * capacity is maximum number of values to store in the buffer.
+ * returns true on success, false otherwise
+*/
+bool spsc_ring_buffer_init(spsc_ring_buffer *rb, int capacity){
+   if(capacity <= 0){
+      return false;
+   }
+   rb->max_num_values = capacity;
+   rb->buffer = malloc(sizeof(float32_t)*rb->max_num_values);
+   if(!rb->buffer) return false; // occurs if insufficient memory
+   rb->value_size = sizeof(float32_t);
+   rb->mirror_bytes = 0;
+   rb->external_storage = false;
+   rb->pow2 = false;
+   rb->index_mask = 0;
+
+   spsc_reset_indices(rb);
+   return true;
+}
+
+/**
+ * Allocates memory for a new SPSC ring buffer with power-of-two capacity.
+ *
+ * rb is pointer to the ring buffer instance.
+ * capacity is maximum number of values to store, a power of two.
+ * returns true on success, false otherwise
+*/
+bool spsc_ring_buffer_init_pow2(spsc_ring_buffer *rb, int capacity){
+   if(!is_pow2(capacity)){
+      return false;
+   }
+   if(!spsc_ring_buffer_init(rb, capacity)) return false;
+   rb->pow2 = true;
+   rb->index_mask = (unsigned int)capacity - 1;
+   return true;
+}
+
+/**
+ * Maps storage for at least capacity values twice back-to-back.
+ *
+ * rb is pointer to the ring buffer instance.
+ * capacity is rounded up so the storage is a whole number of pages.
+ * returns true on success, false otherwise
+*/
+bool spsc_ring_buffer_init_mirrored(spsc_ring_buffer *rb, int capacity){
+   if(capacity <= 0){
+      return false;
+   }
+   size_t bytes = vm_mirror_round_up(sizeof(float32_t)*(size_t)capacity);
+   if(bytes / sizeof(float32_t) > INT32_MAX) return false;
+
+   rb->buffer = vm_mirror_alloc(bytes);
+   if(!rb->buffer) return false;
+   rb->max_num_values = (int)(bytes / sizeof(float32_t));
+   rb->value_size = sizeof(float32_t);
+   rb->mirror_bytes = bytes;
+   rb->external_storage = false;
+   rb->pow2 = is_pow2(rb->max_num_values);
+   rb->index_mask = rb->pow2 ? (unsigned int)rb->max_num_values - 1 : 0;
+
+   spsc_reset_indices(rb);
+   return true;
+}
+
+/**
+ * Uses capacity floats of caller storage, allocates nothing.
+ *
+ * rb is pointer to the ring buffer instance.
+ * storage is the caller's memory for capacity values.
+ * returns true on success, false otherwise
+*/
+bool spsc_ring_buffer_init_with_storage(spsc_ring_buffer *rb, float32_t *storage, int capacity){
+   if(!storage || capacity <= 0){
+      return false;
+   }
+   rb->buffer = storage;
+   rb->value_size = sizeof(float32_t);
+   rb->max_num_values = capacity;
+   rb->mirror_bytes = 0;
+   rb->external_storage = true;
+   rb->pow2 = is_pow2(capacity);
+   rb->index_mask = rb->pow2 ? (unsigned int)capacity - 1 : 0;
+
+   spsc_reset_indices(rb);
+   return true;
+}
+
+/**
+ * Allocates an SPSC ring buffer of int16 values.
+ *
+ * rb is pointer to the ring buffer instance.
+ * capacity is maximum number of values to store in the buffer.
+ * returns true on success, false otherwise
+*/
+bool spsc_ring_buffer_init_i16(spsc_ring_buffer *rb, int capacity){
+   if(capacity <= 0){
+      return false;
+   }
+   int16_t *storage = malloc(sizeof(int16_t)*(size_t)capacity);
+   if(!spsc_ring_buffer_init_i16_with_storage(rb, storage, capacity)){
+      free(storage);
+      return false;
+   }
+   rb->external_storage = false;
+   return true;
+}
+
+/**
+ * Uses capacity int16 values of caller storage, allocates nothing.
+ *
+ * rb is pointer to the ring buffer instance.
+ * storage is the caller's memory for capacity values.
+ * returns true on success, false otherwise
+*/
+bool spsc_ring_buffer_init_i16_with_storage(spsc_ring_buffer *rb, int16_t *storage, int capacity){
+   if(!spsc_ring_buffer_init_with_storage(rb, (float32_t *)(void *)storage, capacity)) return false;
+   rb->value_size = sizeof(int16_t);
+   return true;
+}
+
+/**
+ * Number of values currently in the buffer.
+ *
+ * rb is pointer to the ring buffer instance.
+ * returns a snapshot of the fill level.
+ */
+int spsc_ring_buffer_size(spsc_ring_buffer *rb){
+   unsigned int head = atomic_load_explicit(&rb->head, memory_order_acquire);
+   unsigned int tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+   return (int)spsc_distance(rb, head, tail);
+}
+
+/**
+ * Check if the ring buffer is empty.
+ *
+ * rb is pointer to the ring buffer instance.
+ * return true if the buffer is empty, false otherwise.
+ */
+bool spsc_ring_buffer_empty(spsc_ring_buffer *rb){
+   return(spsc_ring_buffer_size(rb) == 0);
+}
+
+/**
+ * Check if the ring buffer is full.
+ *
+ * rb is pointer to the ring buffer instance.
+ * return true if the buffer is full, false otherwise.
+ */
+bool spsc_ring_buffer_full(spsc_ring_buffer *rb){
+   return(spsc_ring_buffer_size(rb) == rb->max_num_values);
+}
+
+/**
+ * Set the overflow policy. Call before the threads start.
+ *
+ * rb is pointer to the ring buffer instance.
+ * policy is one of ring_buffer_overflow_policy.
+ * timeout_us is the longest wait in RB_OVERFLOW_BLOCK mode, < 0 forever.
+ * returns true on success, false if policy is unknown.
+ */
+bool spsc_ring_buffer_set_overflow_policy(spsc_ring_buffer *rb,
+                                          ring_buffer_overflow_policy policy,
+                                          int timeout_us){
+   if(policy != RB_OVERFLOW_REJECT && policy != RB_OVERFLOW_OVERWRITE &&
+      policy != RB_OVERFLOW_BLOCK){
+      return false;
+   }
+   rb->overflow_policy = policy;
+   rb->block_timeout_us = timeout_us;
+   return true;
+}
+
+uint64_t spsc_ring_buffer_num_overwritten(spsc_ring_buffer *rb){
+   return atomic_load_explicit(&rb->num_overwritten, memory_order_relaxed);
+}
+
+uint64_t spsc_ring_buffer_num_rejected(spsc_ring_buffer *rb){
+   return atomic_load_explicit(&rb->num_rejected, memory_order_relaxed);
+}
+
+/**
+ * Add n to a producer-owned counter. Only the producer stores it, so a
+ * relaxed load and store is enough (no locked read-modify-write).
+ */
+static inline void spsc_count(_Atomic uint64_t *counter, uint64_t n){
+   atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                         memory_order_relaxed);
+   METRICS_ADD(METRIC_DROPS, n); // only the drop counters are counted here
+}
+
+// metrics after tail moved to tail_next with n new values, producer only
+#define SPSC_METRICS_PUBLISHED(rb, tail_next, n) do { \
+   METRICS_ADD(METRIC_SAMPLES_IN, n); \
+   METRICS_HIGH_WATER(&(rb)->high_water, spsc_distance((rb), \
+      atomic_load_explicit(&(rb)->head, memory_order_relaxed), (tail_next))); \
+} while(0)
+
+/**
+ * Monotonic clock in nanoseconds, only used while blocking. Full resolution
+ * so a timeout never ends early by the truncated fraction of a microsecond.
+ */
+static uint64_t spsc_now_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Find room for n <= capacity values at tail. Producer only.
+ *
+ * First uses the cached head, then reloads it, then applies the
+ * overflow policy: overwrite pushes head forward, block waits for the
+ * consumer, reject gives up.
+ * returns the free space, less than n if the policy could not make room.
+ */
+static unsigned int spsc_make_room(spsc_ring_buffer *rb, unsigned int tail, unsigned int n){
+   unsigned int cap = (unsigned int)rb->max_num_values;
+   unsigned int space = cap - spsc_distance(rb, rb->head_cache, tail);
+   if(space >= n) return space;
+
+   rb->head_cache = atomic_load_explicit(&rb->head, memory_order_acquire);
+   space = cap - spsc_distance(rb, rb->head_cache, tail);
+   if(space >= n) return space;
+
+   if(rb->overflow_policy == RB_OVERFLOW_OVERWRITE){
+      unsigned int head = rb->head_cache;
+      unsigned int drop = n - space;
+      // the consumer may advance head at the same time, a failed CAS
+      // reloads head and we only drop what is still missing
+      while(!atomic_compare_exchange_weak_explicit(&rb->head, &head,
+                                                   spsc_advance(rb, head, drop),
+                                                   memory_order_acq_rel,
+                                                   memory_order_acquire)){
+         space = cap - spsc_distance(rb, head, tail);
+         if(space >= n){
+            rb->head_cache = head;
+            return space;
+         }
+         drop = n - space;
+      }
+      spsc_count(&rb->num_overwritten, drop);
+      rb->head_cache = spsc_advance(rb, head, drop);
+      return n;
+   }
+
+   if(rb->overflow_policy == RB_OVERFLOW_BLOCK){
+      uint64_t deadline = spsc_now_ns() + (uint64_t)rb->block_timeout_us * 1000u;
+      while(space < n){
+         if(rb->block_timeout_us >= 0 && spsc_now_ns() >= deadline) break;
+         sched_yield();
+         rb->head_cache = atomic_load_explicit(&rb->head, memory_order_acquire);
+         space = cap - spsc_distance(rb, rb->head_cache, tail);
+      }
+   }
+   return space;
+}
+
+/**
+ * Current head from the consumer's side. In overwrite mode the producer
+ * can move head as well, so it has to be an acquire load.
+ */
+static inline unsigned int spsc_consumer_head(spsc_ring_buffer *rb){
+   if(rb->overflow_policy == RB_OVERFLOW_OVERWRITE){
+      return atomic_load_explicit(&rb->head, memory_order_acquire);
+   }
+   return atomic_load_explicit(&rb->head, memory_order_relaxed); // head is ours
+}
+
+/**
+ * Number of values from head, reloading tail if the cached copy holds
+ * fewer than n or is stale (behind a head the producer pushed forward).
+ * Consumer only.
+ */
+static unsigned int spsc_available(spsc_ring_buffer *rb, unsigned int head, unsigned int n){
+   unsigned int avail = spsc_distance(rb, head, rb->tail_cache);
+   if(avail < n || avail > (unsigned int)rb->max_num_values){
+      rb->tail_cache = atomic_load_explicit(&rb->tail, memory_order_acquire);
+      avail = spsc_distance(rb, head, rb->tail_cache);
+   }
+   return avail;
+}
+
+/**
+ * Move head from *head forward by n. Consumer only.
+ *
+ * A plain release store, except in overwrite mode where the producer
+ * may have dropped values meanwhile: then a CAS is used, and on failure
+ * *head is updated to the producer's value and false is returned (the
+ * values just read may have been overwritten).
+ */
+static inline bool spsc_consume(spsc_ring_buffer *rb, unsigned int *head, unsigned int n){
+   unsigned int next = spsc_advance(rb, *head, n);
+   if(rb->overflow_policy == RB_OVERFLOW_OVERWRITE){
+      if(!atomic_compare_exchange_strong_explicit(&rb->head, head, next,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) return false;
+      METRICS_ADD(METRIC_SAMPLES_OUT, n);
+      return true;
+   }
+   // release store orders our reads before the producer reuses the slots
+   atomic_store_explicit(&rb->head, next, memory_order_release);
+   METRICS_ADD(METRIC_SAMPLES_OUT, n);
+   return true;
+}
+
+/**
+ * The typed entry points check the value type: a float access to int16
+ * storage (or the reverse) would stride past the allocation.
+ */
+static inline bool spsc_is_f32(const spsc_ring_buffer *rb){
+   return rb->value_size == sizeof(float32_t);
+}
+
+static inline bool spsc_is_i16(const spsc_ring_buffer *rb){
+   return rb->value_size == sizeof(int16_t);
+}
+
+/**
+ * Write a float value to the tail of the ring buffer. Producer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * value is the float value to be written into the buffer at
+ * the tail location, tail is then published.
+ * return true on successful write, false if the buffer is full or holds int16.
+ */
+bool spsc_ring_buffer_write(spsc_ring_buffer *rb, float32_t value){
+   if(!spsc_is_f32(rb)) return false;
+   // tail is ours, no ordering needed to read it
+   unsigned int tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+   // test if buffer is full, only reload head when the cached copy says so
+   if(spsc_make_room(rb, tail, 1) == 0){
+      spsc_count(&rb->num_rejected, 1);
+      return false;
+   }
+
+   rb->buffer[spsc_slot(rb, tail)] = value;
+   // publish the value, the consumer's acquire load of tail pairs with this
+   atomic_store_explicit(&rb->tail, spsc_advance(rb, tail, 1), memory_order_release);
+   SPSC_METRICS_PUBLISHED(rb, spsc_advance(rb, tail, 1), 1);
+   return true;
+}
+
+/**
+ * Read a value from the head of the ring buffer. Consumer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * result is a pointer to the float value to be read
+ * at head and then function returns true.
+ * If empty (or an int16 ring), returns false
+ */
+bool spsc_ring_buffer_read(spsc_ring_buffer *rb, float32_t *result){
+   if(!spsc_is_f32(rb)) return false;
+   unsigned int head = spsc_consumer_head(rb);
+   float32_t value;
+   do {
+      // test if buffer is empty, only reload tail when the cached copy says so
+      if(spsc_available(rb, head, 1) == 0){
+         return false;
+      }
+      value = rb->buffer[spsc_slot(rb, head)];
+   } while(!spsc_consume(rb, &head, 1)); // only retries in overwrite mode
+
+   *result = value;
+   return true;
+}
+
+/**
+ * Storage address of a slot.
+ */
+static inline uint8_t *spsc_at(const spsc_ring_buffer *rb, unsigned int slot){
+   return (uint8_t *)rb->buffer + (size_t)slot * (size_t)rb->value_size;
+}
+
+/**
+ * Write a block of values of value_size bytes each. Producer only.
+ */
+static int spsc_write_values(spsc_ring_buffer *rb, const uint8_t *values, int n){
+   if(n <= 0) return 0;
+   size_t size = (size_t)rb->value_size;
+   unsigned int cap = (unsigned int)rb->max_num_values;
+   unsigned int tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+   if((unsigned int)n > cap){
+      if(rb->overflow_policy == RB_OVERFLOW_OVERWRITE){
+         // the start of the block would be overwritten by its own end
+         spsc_count(&rb->num_overwritten, (unsigned int)n - cap);
+         values += ((unsigned int)n - cap) * size;
+      } else {
+         spsc_count(&rb->num_rejected, (unsigned int)n - cap);
+      }
+      n = (int)cap;
+   }
+
+   unsigned int space = spsc_make_room(rb, tail, (unsigned int)n);
+   if((unsigned int)n > space){
+      spsc_count(&rb->num_rejected, (unsigned int)n - space);
+      n = (int)space;
+   }
+   if(n == 0) return 0;
+
+   unsigned int slot = spsc_slot(rb, tail);
+   unsigned int first = cap - slot;
+   if(first > (unsigned int)n) first = (unsigned int)n;
+   memcpy(spsc_at(rb, slot), values, size*first);
+   memcpy(spsc_at(rb, 0), values + first*size, size*(n - first));
+
+   // one release store publishes the whole block
+   atomic_store_explicit(&rb->tail, spsc_advance(rb, tail, (unsigned int)n), memory_order_release);
+   SPSC_METRICS_PUBLISHED(rb, spsc_advance(rb, tail, (unsigned int)n), n);
+   return n;
+}
+
+/**
+ * Write a block of values to the tail of the ring buffer. Producer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * values points to n values to be written, copied in at most two
+ * contiguous segments around the end of the storage.
+ * returns the number of values written (less than n if buffer fills).
+ */
+int spsc_ring_buffer_write_n(spsc_ring_buffer *rb, const float32_t *values, int n){
+   if(!spsc_is_f32(rb)) return 0;
+   return spsc_write_values(rb, (const uint8_t *)values, n);
+}
+
+/**
+ * Write a block of int16 values, see spsc_ring_buffer_write_n().
+ */
+int spsc_ring_buffer_write_n_i16(spsc_ring_buffer *rb, const int16_t *values, int n){
+   if(!spsc_is_i16(rb)) return 0;
+   return spsc_write_values(rb, (const uint8_t *)values, n);
+}
+
+/**
+ * Read a block of values of value_size bytes each. Consumer only.
+ */
+static int spsc_read_values(spsc_ring_buffer *rb, uint8_t *result, int n){
+   if(n <= 0) return 0;
+   size_t size = (size_t)rb->value_size;
+   unsigned int cap = (unsigned int)rb->max_num_values;
+   unsigned int head = spsc_consumer_head(rb);
+   unsigned int count;
+   do {
+      // only reload tail if the cached copy does not hold enough values
+      count = spsc_available(rb, head, (unsigned int)n);
+      if(count > (unsigned int)n) count = (unsigned int)n;
+      if(count == 0) return 0;
+
+      unsigned int slot = spsc_slot(rb, head);
+      unsigned int first = cap - slot;
+      if(first > count) first = count;
+      memcpy(result, spsc_at(rb, slot), size*first);
+      memcpy(result + first*size, spsc_at(rb, 0), size*(count - first));
+      // one store hands the whole block back to the producer
+   } while(!spsc_consume(rb, &head, count)); // only retries in overwrite mode
+   return (int)count;
+}
+
+/**
+ * Read a block of values from the head of the ring buffer. Consumer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * result points to storage for at least n values, which are filled
+ * oldest first using at most two contiguous copies.
+ * returns the number of values read (less than n if buffer empties).
+ */
+int spsc_ring_buffer_read_n(spsc_ring_buffer *rb, float32_t *result, int n){
+   if(!spsc_is_f32(rb)) return 0;
+   return spsc_read_values(rb, (uint8_t *)result, n);
+}
+
+/**
+ * Read a block of int16 values, see spsc_ring_buffer_read_n().
+ */
+int spsc_ring_buffer_read_n_i16(spsc_ring_buffer *rb, int16_t *result, int n){
+   if(!spsc_is_i16(rb)) return 0;
+   return spsc_read_values(rb, (uint8_t *)result, n);
+}
+
+/**
+ * Split n values starting at index idx into up to two storage pieces:
+ * first values from slot, the rest from the start of the storage.
+ */
+static unsigned int spsc_split(spsc_ring_buffer *rb, unsigned int idx, unsigned int n,
+                               unsigned int *slot){
+   *slot = spsc_slot(rb, idx);
+   // mirrored storage continues past the end, so one span is enough
+   unsigned int first = rb->mirror_bytes ? n : (unsigned int)rb->max_num_values - *slot;
+   return first > n ? n : first;
+}
+
+/**
+ * Describe n values starting at index idx as up to two storage spans.
+ */
+static void spsc_spans(spsc_ring_buffer *rb, unsigned int idx, unsigned int n,
+                       ring_buffer_span spans[2]){
+   unsigned int slot;
+   unsigned int first = spsc_split(rb, idx, n, &slot);
+   spans[0].ptr = rb->buffer + slot;
+   spans[0].len = (int)first;
+   spans[1].ptr = rb->buffer;
+   spans[1].len = (int)(n - first);
+}
+
+/**
+ * No spans, for a typed call on a ring of the other type.
+ */
+static int spsc_no_spans(ring_buffer_span spans[2]){
+   spans[0].ptr = spans[1].ptr = NULL;
+   spans[0].len = spans[1].len = 0;
+   return 0;
+}
+
+/**
+ * Reserve free space at the tail for in-place writing. Producer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the maximum number of values wanted.
+ * spans receives up to two pieces of free storage starting at tail.
+ * In overwrite mode the oldest values are dropped so n values fit, here
+ * and not at commit: abandoning the reservation does not bring them back.
+ * reserve never blocks.
+ * returns the number of values reserved, new values are published by commit.
+ */
+int spsc_ring_buffer_reserve(spsc_ring_buffer *rb, int n, ring_buffer_span spans[2]){
+   if(!spsc_is_f32(rb)) return spsc_no_spans(spans);
+   if(n < 0) n = 0;
+   if(n > rb->max_num_values) n = rb->max_num_values;
+   unsigned int tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+   unsigned int space;
+   if(rb->overflow_policy == RB_OVERFLOW_BLOCK){
+      // reserve is used from read() loops that must not stall
+      rb->head_cache = atomic_load_explicit(&rb->head, memory_order_acquire);
+      space = (unsigned int)rb->max_num_values - spsc_distance(rb, rb->head_cache, tail);
+   } else {
+      space = spsc_make_room(rb, tail, (unsigned int)n);
+   }
+   if((unsigned int)n > space) n = (int)space;
+   spsc_spans(rb, tail, (unsigned int)n, spans);
+   return n;
+}
+
+/**
+ * Publish n values written into reserved spans. Producer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the number of values written, tail moves forward by n.
+ * returns true on success, false if n does not fit.
+ */
+bool spsc_ring_buffer_commit(spsc_ring_buffer *rb, int n){
+   unsigned int cap = (unsigned int)rb->max_num_values;
+   unsigned int tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+   if(n < 0) return false;
+   if((unsigned int)n > cap - spsc_distance(rb, rb->head_cache, tail)){
+      rb->head_cache = atomic_load_explicit(&rb->head, memory_order_acquire);
+      if((unsigned int)n > cap - spsc_distance(rb, rb->head_cache, tail)) return false;
+   }
+
+   // release store makes the in-place writes visible to the consumer
+   atomic_store_explicit(&rb->tail, spsc_advance(rb, tail, (unsigned int)n), memory_order_release);
+   SPSC_METRICS_PUBLISHED(rb, spsc_advance(rb, tail, (unsigned int)n), n);
+   return true;
+}
+
+/**
+ * Look at the oldest values in place. Consumer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the maximum number of values wanted.
+ * spans receives up to two pieces of storage starting at head.
+ * returns the number of values available, nothing changes until release.
+ */
+int spsc_ring_buffer_peek(spsc_ring_buffer *rb, int n, ring_buffer_span spans[2]){
+   if(!spsc_is_f32(rb)) return spsc_no_spans(spans);
+   if(n < 0) n = 0;
+   unsigned int head = spsc_consumer_head(rb);
+
+   unsigned int avail = spsc_available(rb, head, (unsigned int)n);
+   if((unsigned int)n > avail) n = (int)avail;
+   rb->peek_head = head;
+   spsc_spans(rb, head, (unsigned int)n, spans);
+   return n;
+}
+
+/**
+ * Look at the oldest int16 values in place, see spsc_ring_buffer_peek().
+ */
+int spsc_ring_buffer_peek_i16(spsc_ring_buffer *rb, int n, ring_buffer_span_i16 spans[2]){
+   if(!spsc_is_i16(rb)){
+      spans[0].ptr = spans[1].ptr = NULL;
+      spans[0].len = spans[1].len = 0;
+      return 0;
+   }
+   if(n < 0) n = 0;
+   unsigned int head = spsc_consumer_head(rb);
+
+   unsigned int avail = spsc_available(rb, head, (unsigned int)n);
+   if((unsigned int)n > avail) n = (int)avail;
+   rb->peek_head = head;
+   unsigned int slot;
+   unsigned int first = spsc_split(rb, head, (unsigned int)n, &slot);
+   spans[0].ptr = rb->codes + slot;
+   spans[0].len = (int)first;
+   spans[1].ptr = rb->codes;
+   spans[1].len = (int)(n - first);
+   return n;
+}
+
+/**
+ * Hand n peeked values back to the producer. Consumer only.
+ *
+ * rb is pointer to the ring buffer instance.
+ * n is the number of values consumed, head moves forward by n.
+ * returns true on success, false if fewer than n values are stored
+ * or (overwrite mode) the producer dropped the peeked window.
+ */
+bool spsc_ring_buffer_release(spsc_ring_buffer *rb, int n){
+   if(n < 0) return false;
+   unsigned int head;
+   if(rb->overflow_policy == RB_OVERFLOW_OVERWRITE){
+      // must still be the window the caller peeked at
+      head = rb->peek_head;
+   } else {
+      head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+   }
+   if((unsigned int)n > spsc_available(rb, head, (unsigned int)n)) return false;
+
+   return spsc_consume(rb, &head, (unsigned int)n);
+}
+
+/**
+ * Free the storage init allocated, keep the struct.
+ *
+ * rb is pointer to the ring buffer instance.
+ * return void
+ */
+void spsc_ring_buffer_deinit(spsc_ring_buffer *rb){
+   if (!rb) return;
+
+   if(rb->mirror_bytes){
+      vm_mirror_free(rb->buffer, rb->mirror_bytes);
+   } else if(!rb->external_storage){
+      free(rb->buffer);
+   }
+   rb->buffer = NULL; // safety
+}
+
+/**
+ * Free the allocated memory from the ring buffer.
+ *
+ * rb is pointer to the ring buffer instance.
+ * return void
+ */
+void spsc_ring_buffer_destroy(spsc_ring_buffer *rb){
+   if (!rb) return; // if already null, nothing to do
+
+   spsc_ring_buffer_deinit(rb);
+   free(rb);
+   // same as ring_buffer_destroy, set rb = NULL with SPSC_SAFE_DESTROY
+}
@@ -0,0 +1,295 @@
+/**
+ * stream_sink.c
+ *
+ * Implementation of the shared-memory and UDP output sinks.
+ *
+ * Notes:
+ * - shm objects can only be sized once on macOS, so "replace" is unlink
+ *   then O_CREAT | O_EXCL rather than O_TRUNC.
+ * - The ring's indices count messages and grow forever; a slot is
+ *   index & (num_slots - 1). head is written only by the producer, tail only
+ *   by the consumer, each published with a release store.
+ * - A message's seq is taken when it is published, so one dropped by a
+ *   full ring or a full socket buffer leaves a gap for the consumer.
+ * - Use with stream_sink.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // sendmmsg()
+#endif
+
+#include "stream_sink.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**************************** Shared memory ****************************/
+
+static size_t region_bytes(uint32_t num_slots, uint32_t slot_bytes){
+   return sizeof(stream_shm_region) + (size_t)num_slots * slot_bytes;
+}
+
+static stream_header *slot_header(const stream_shm *s, uint64_t index){
+   stream_shm_region *r = s->region;
+   return (stream_header *)(r->slots + (size_t)(index & (r->num_slots - 1)) * r->slot_bytes);
+}
+
+static bool copy_name(stream_shm *s, const char *name){
+   memset(s, 0, sizeof(*s));
+   size_t len = strlen(name);
+   if(len == 0 || len >= STREAM_SHM_NAME_LEN) return false;
+   memcpy(s->name, name, len + 1);
+   return true;
+}
+
+bool stream_shm_create(stream_shm *s, const char *name, int num_slots, int slot_values){
+   if(!copy_name(s, name) || num_slots < 1 || slot_values < 1) return false;
+   uint32_t slots = 1;
+   while(slots < (uint32_t)num_slots) slots <<= 1;
+   size_t slot_bytes = sizeof(stream_header) + sizeof(float) * (size_t)slot_values;
+   slot_bytes = (slot_bytes + RB_CACHE_LINE_SIZE - 1) / RB_CACHE_LINE_SIZE * RB_CACHE_LINE_SIZE;
+   size_t bytes = region_bytes(slots, (uint32_t)slot_bytes);
+
+   shm_unlink(name); // a ring left behind by an earlier run
+   int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+   if(fd == -1) return false;
+   void *p = MAP_FAILED;
+   if(ftruncate(fd, (off_t)bytes) == 0) p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if(p == MAP_FAILED){
+      shm_unlink(name);
+      return false;
+   }
+   stream_shm_region *r = p;
+   r->num_slots = slots;
+   r->slot_values = (uint32_t)slot_values;
+   r->slot_bytes = (uint32_t)slot_bytes;
+   r->version = STREAM_VERSION;
+   atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+   atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+   // the magic last: a consumer mapping it now sees a finished control block
+   atomic_thread_fence(memory_order_release);
+   r->magic = STREAM_MAGIC;
+   s->region = r;
+   s->bytes = bytes;
+   s->owner = true;
+   return true;
+}
+
+bool stream_shm_open(stream_shm *s, const char *name){
+   if(!copy_name(s, name)) return false;
+   int fd = shm_open(name, O_RDWR, 0);
+   if(fd == -1) return false;
+   struct stat st;
+   void *p = MAP_FAILED;
+   if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(stream_shm_region)){
+      p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   }
+   close(fd);
+   if(p == MAP_FAILED) return false;
+   stream_shm_region *r = p;
+   bool valid = r->magic == STREAM_MAGIC && r->version == STREAM_VERSION && r->num_slots > 0 &&
+                (r->num_slots & (r->num_slots - 1)) == 0 &&
+                region_bytes(r->num_slots, r->slot_bytes) <= (size_t)st.st_size;
+   if(!valid){
+      munmap(p, (size_t)st.st_size);
+      return false;
+   }
+   atomic_thread_fence(memory_order_acquire);
+   s->region = r;
+   s->bytes = (size_t)st.st_size;
+   return true;
+}
+
+float *stream_shm_reserve(stream_shm *s, stream_kind kind, int num_channels, int num_values,
+                          uint64_t time_ns){
+   stream_shm_region *r = s->region;
+   uint32_t seq = r->seq[kind]++;
+   uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+   uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+   if(num_values < 0 || (uint32_t)num_values > r->slot_values || head - tail >= r->num_slots){
+      s->dropped++;
+      return NULL;
+   }
+   stream_header *h = slot_header(s, head);
+   h->magic = STREAM_MAGIC;
+   h->version = STREAM_VERSION;
+   h->kind = (uint8_t)kind;
+   h->num_channels = (uint16_t)num_channels;
+   h->seq = seq;
+   h->num_values = (uint32_t)num_values;
+   h->first_value = 0;
+   h->count = (uint32_t)num_values;
+   h->time_ns = time_ns;
+   s->reserved = true;
+   return (float *)(h + 1);
+}
+
+void stream_shm_commit(stream_shm *s){
+   if(!s->reserved) return;
+   s->reserved = false;
+   stream_shm_region *r = s->region;
+   uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+   atomic_store_explicit(&r->head, head + 1, memory_order_release);
+   s->published++;
+}
+
+const stream_header *stream_shm_peek(stream_shm *s, const float **values){
+   stream_shm_region *r = s->region;
+   uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+   if(tail == atomic_load_explicit(&r->head, memory_order_acquire)) return NULL;
+   const stream_header *h = slot_header(s, tail);
+   *values = (const float *)(h + 1);
+   return h;
+}
+
+void stream_shm_release(stream_shm *s){
+   stream_shm_region *r = s->region;
+   uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+   if(tail == atomic_load_explicit(&r->head, memory_order_acquire)) return;
+   atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+void stream_shm_close(stream_shm *s){
+   if(!s->region) return;
+   munmap(s->region, s->bytes);
+   if(s->owner) shm_unlink(s->name);
+   s->region = NULL;
+}
+
+/******************************** UDP ********************************/
+
+bool stream_udp_open(stream_udp *u, const char *host, int port){
+   memset(u, 0, sizeof(*u));
+   u->fd = -1;
+   if(port < 1 || port > 65535) return false;
+   char service[8];
+   snprintf(service, sizeof(service), "%d", port);
+   struct addrinfo hints, *addr = NULL;
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_DGRAM;
+   if(getaddrinfo(host, service, &hints, &addr) != 0) return false;
+   // connected: the kernel resolves the route once, datagrams carry no address
+   u->fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+   bool ok = u->fd != -1 && connect(u->fd, addr->ai_addr, addr->ai_addrlen) == 0;
+   freeaddrinfo(addr);
+   int flags = ok ? fcntl(u->fd, F_GETFL) : -1;
+   ok = ok && flags != -1 && fcntl(u->fd, F_SETFL, flags | O_NONBLOCK) == 0;
+   u->buffers = ok ? malloc((size_t)STREAM_UDP_MAX_BATCH * STREAM_UDP_DATAGRAM_BYTES) : NULL;
+   if(!u->buffers){
+      if(u->fd != -1) close(u->fd);
+      u->fd = -1;
+      return false;
+   }
+   return true;
+}
+
+void stream_udp_send(stream_udp *u, stream_kind kind, int num_channels, const float *values,
+                     int num_values, uint64_t time_ns){
+   stream_header h;
+   h.magic = STREAM_MAGIC;
+   h.version = STREAM_VERSION;
+   h.kind = (uint8_t)kind;
+   h.num_channels = (uint16_t)num_channels;
+   h.seq = u->seq[kind]++;
+   h.num_values = (uint32_t)num_values;
+   h.time_ns = time_ns;
+   // at least one datagram, a message without values still carries its seq
+   int first = 0;
+   do {
+      int count = num_values - first;
+      if(count > (int)STREAM_UDP_MAX_VALUES) count = (int)STREAM_UDP_MAX_VALUES;
+      if(u->queued == STREAM_UDP_MAX_BATCH) stream_udp_flush(u);
+      uint8_t *buf = u->buffers + (size_t)u->queued * STREAM_UDP_DATAGRAM_BYTES;
+      h.first_value = (uint32_t)first;
+      h.count = (uint32_t)count;
+      memcpy(buf, &h, sizeof(h));
+      memcpy(buf + sizeof(h), values + first, sizeof(float) * (size_t)count);
+      u->lengths[u->queued++] = sizeof(h) + sizeof(float) * (size_t)count;
+      first += count;
+   } while(first < num_values);
+}
+
+int stream_udp_flush(stream_udp *u){
+   int sent = 0;
+#if defined(__linux__)
+   struct iovec iov[STREAM_UDP_MAX_BATCH];
+   struct mmsghdr msgs[STREAM_UDP_MAX_BATCH];
+   memset(msgs, 0, sizeof(msgs[0]) * (size_t)u->queued);
+   for(int i = 0; i < u->queued; i++){
+      iov[i].iov_base = u->buffers + (size_t)i * STREAM_UDP_DATAGRAM_BYTES;
+      iov[i].iov_len = u->lengths[i];
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+   while(sent < u->queued){
+      int n = sendmmsg(u->fd, msgs + sent, (unsigned int)(u->queued - sent), 0);
+      u->send_calls++;
+      if(n > 0){
+         sent += n;
+         continue;
+      }
+      if(n < 0 && errno == EINTR) continue;
+      break; // socket buffer full: the rest of the batch is dropped
+   }
+#else
+   for(int i = 0; i < u->queued; i++){
+      ssize_t n;
+      do {
+         n = send(u->fd, u->buffers + (size_t)i * STREAM_UDP_DATAGRAM_BYTES, u->lengths[i], 0);
+         u->send_calls++;
+      } while(n < 0 && errno == EINTR);
+      if(n >= 0) sent++;
+   }
+#endif
+   u->datagrams_sent += (uint64_t)sent;
+   u->datagrams_dropped += (uint64_t)(u->queued - sent);
+   u->queued = 0;
+   return sent;
+}
+
+void stream_udp_close(stream_udp *u){
+   if(u->fd == -1) return;
+   stream_udp_flush(u);
+   close(u->fd);
+   free(u->buffers);
+   u->fd = -1;
+   u->buffers = NULL;
+}
+
+bool stream_decode(const uint8_t *buf, size_t len, stream_header *header, const uint8_t **values){
+   if(len < sizeof(stream_header)) return false;
+   memcpy(header, buf, sizeof(*header));
+   if(header->magic != STREAM_MAGIC || header->version != STREAM_VERSION ||
+      header->kind >= STREAM_NUM_KINDS) return false;
+   if(len != sizeof(stream_header) + sizeof(float) * (size_t)header->count) return false;
+   if((uint64_t)header->first_value + header->count > header->num_values) return false;
+   *values = buf + sizeof(stream_header);
+   return true;
+}
+
+/******************************* Sinks *******************************/
+
+void stream_sinks_publish(const stream_sinks *sinks, stream_kind kind, int num_channels,
+                          const float *values, int num_values, uint64_t time_ns){
+   if(sinks->shm){
+      float *slot = stream_shm_reserve(sinks->shm, kind, num_channels, num_values, time_ns);
+      if(slot){
+         memcpy(slot, values, sizeof(float) * (size_t)num_values);
+         stream_shm_commit(sinks->shm);
+      }
+   }
+   if(sinks->udp) stream_udp_send(sinks->udp, kind, num_channels, values, num_values, time_ns);
+}
@@ -0,0 +1,285 @@
+/**
+ * telemetry.c
+ *
+ * Implementation of the telemetry queues and the telemetry thread.
+ *
+ * Notes:
+ * - Each channel queue has free-running head/tail counters with a
+ *   power-of-two size, the same scheme as spsc_ring_buffer_init_pow2().
+ * - The telemetry thread runs at the lowest priority the OS gives without
+ *   privileges (QoS utility on macOS, SCHED_IDLE on Linux) and wakes up
+ *   every TELEMETRY_POLL_MS.
+ * - Use with telemetry.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // SCHED_IDLE
+#endif
+
+#include "telemetry.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#if defined(__APPLE__)
+#include <pthread/qos.h>
+#endif
+
+#define TELEMETRY_POLL_MS 50
+#define TELEMETRY_MASK (TELEMETRY_QUEUE_SIZE - 1)
+
+_Static_assert((TELEMETRY_QUEUE_SIZE & TELEMETRY_MASK) == 0,
+               "TELEMETRY_QUEUE_SIZE must be a power of two");
+
+static uint64_t telemetry_now_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void window_reset(telemetry_window *w){
+   memset(w, 0, sizeof(*w));
+}
+
+bool telemetry_init(telemetry *t, FILE *out, int interval_ms){
+   if(!out || interval_ms <= 0) return false;
+   t->num_channels = 0;
+   t->out = out;
+   t->interval_ms = interval_ms;
+   t->running = false;
+   atomic_init(&t->stop, false);
+   t->window_start_ns = telemetry_now_ns();
+   t->logs_this_interval = 0;
+   t->logs_suppressed = 0;
+   return true;
+}
+
+telemetry_channel *telemetry_channel_open(telemetry *t, const char *name){
+   if(t->num_channels >= TELEMETRY_MAX_CHANNELS) return NULL;
+   telemetry_channel *ch = malloc(sizeof(telemetry_channel));
+   if(!ch) return NULL;
+   atomic_init(&ch->head, 0);
+   atomic_init(&ch->tail, 0);
+   atomic_init(&ch->dropped, 0);
+   strncpy(ch->name, name, TELEMETRY_NAME_LEN - 1);
+   ch->name[TELEMETRY_NAME_LEN - 1] = '\0';
+   window_reset(&ch->window);
+   ch->reported_dropped = 0;
+   t->channels[t->num_channels++] = ch;
+   return ch;
+}
+
+/**
+ * Claim the next free record, NULL (and counted) if the queue is full.
+ * The record is published by telemetry_push().
+ */
+static telemetry_record *telemetry_claim(telemetry_channel *ch){
+   unsigned int tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+   unsigned int head = atomic_load_explicit(&ch->head, memory_order_acquire);
+   if(tail - head >= TELEMETRY_QUEUE_SIZE){
+      atomic_store_explicit(&ch->dropped,
+                            atomic_load_explicit(&ch->dropped, memory_order_relaxed) + 1,
+                            memory_order_relaxed);
+      return NULL;
+   }
+   return &ch->records[tail & TELEMETRY_MASK];
+}
+
+static void telemetry_push(telemetry_channel *ch){
+   unsigned int tail = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+   atomic_store_explicit(&ch->tail, tail + 1, memory_order_release);
+}
+
+void telemetry_samples(telemetry_channel *ch, const float *values, int n){
+   if(!ch || n <= 0) return;
+   telemetry_record *r = telemetry_claim(ch);
+   if(!r) return;
+   float lo = values[0];
+   float hi = values[0];
+   double sum = 0.0;
+   for(int i = 0; i < n; i++){
+      if(values[i] < lo) lo = values[i];
+      if(values[i] > hi) hi = values[i];
+      sum += values[i];
+   }
+   r->kind = TELEMETRY_RECORD_SAMPLES;
+   r->count = (uint32_t)n;
+   r->min = lo;
+   r->max = hi;
+   r->sum = sum;
+   telemetry_push(ch);
+}
+
+void telemetry_codes(telemetry_channel *ch, const int16_t *codes, int n, float scale){
+   if(!ch || n <= 0) return;
+   telemetry_record *r = telemetry_claim(ch);
+   if(!r) return;
+   int lo = codes[0];
+   int hi = codes[0];
+   int64_t sum = 0;
+   for(int i = 0; i < n; i++){
+      if(codes[i] < lo) lo = codes[i];
+      if(codes[i] > hi) hi = codes[i];
+      sum += codes[i];
+   }
+   r->kind = TELEMETRY_RECORD_SAMPLES;
+   r->count = (uint32_t)n;
+   // a negative scale swaps the ends
+   r->min = (scale < 0.0f ? hi : lo) * scale;
+   r->max = (scale < 0.0f ? lo : hi) * scale;
+   r->sum = (double)sum * scale;
+   telemetry_push(ch);
+}
+
+void telemetry_count(telemetry_channel *ch, telemetry_counter counter, uint64_t n){
+   if(!ch || n == 0) return;
+   telemetry_record *r = telemetry_claim(ch);
+   if(!r) return;
+   r->kind = TELEMETRY_RECORD_COUNTER;
+   r->counter = counter;
+   r->count = n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+   telemetry_push(ch);
+}
+
+void telemetry_log(telemetry_channel *ch, const char *fmt, ...){
+   if(!ch) return;
+   telemetry_record *r = telemetry_claim(ch);
+   if(!r) return;
+   va_list ap;
+   va_start(ap, fmt);
+   vsnprintf(r->text, TELEMETRY_MESSAGE_LEN, fmt, ap);
+   va_end(ap);
+   r->kind = TELEMETRY_RECORD_MESSAGE;
+   telemetry_push(ch);
+}
+
+uint64_t telemetry_dropped(telemetry_channel *ch){
+   return atomic_load_explicit(&ch->dropped, memory_order_relaxed);
+}
+
+/**
+ * Fold one record into the channel's window, or print it if it is a message.
+ */
+static void telemetry_apply(telemetry *t, telemetry_channel *ch, const telemetry_record *r){
+   telemetry_window *w = &ch->window;
+   switch(r->kind){
+      case TELEMETRY_RECORD_SAMPLES:
+         if(w->samples == 0 || r->min < w->min) w->min = r->min;
+         if(w->samples == 0 || r->max > w->max) w->max = r->max;
+         w->samples += r->count;
+         w->sum += r->sum;
+         break;
+      case TELEMETRY_RECORD_COUNTER:
+         if(r->counter < TELEMETRY_NUM_COUNTERS) w->counters[r->counter] += r->count;
+         break;
+      case TELEMETRY_RECORD_MESSAGE:
+         if(t->logs_this_interval < TELEMETRY_MAX_LOGS_PER_INTERVAL){
+            fprintf(t->out, "[telemetry] %s: %s\n", ch->name, r->text);
+            t->logs_this_interval++;
+         } else {
+            t->logs_suppressed++;
+         }
+         break;
+   }
+}
+
+static void telemetry_drain(telemetry *t, telemetry_channel *ch){
+   unsigned int head = atomic_load_explicit(&ch->head, memory_order_relaxed);
+   unsigned int tail = atomic_load_explicit(&ch->tail, memory_order_acquire);
+   while(head != tail){
+      telemetry_apply(t, ch, &ch->records[head & TELEMETRY_MASK]);
+      head++;
+   }
+   atomic_store_explicit(&ch->head, head, memory_order_release);
+}
+
+static void telemetry_summary(telemetry *t, double seconds){
+   for(int i = 0; i < t->num_channels; i++){
+      telemetry_channel *ch = t->channels[i];
+      telemetry_window *w = &ch->window;
+      double rate = seconds > 0.0 ? w->samples / seconds : 0.0;
+      double mean = w->samples ? w->sum / (double)w->samples : 0.0;
+      uint64_t dropped = telemetry_dropped(ch);
+      fprintf(t->out,
+              "[telemetry] %s: %.1f samples/s, V min %.2f max %.2f mean %.2f, "
+              "packets lost %llu, crc errors %llu, overflow %llu, dropped %llu, filled %llu\n",
+              ch->name, rate, w->samples ? w->min : 0.0f, w->samples ? w->max : 0.0f, mean,
+              (unsigned long long)w->counters[TELEMETRY_PACKETS_LOST],
+              (unsigned long long)w->counters[TELEMETRY_CRC_ERRORS],
+              (unsigned long long)w->counters[TELEMETRY_OVERFLOW],
+              (unsigned long long)(dropped - ch->reported_dropped),
+              (unsigned long long)w->counters[TELEMETRY_FRAMES_FILLED]);
+      window_reset(w);
+      ch->reported_dropped = dropped;
+   }
+   if(t->logs_suppressed){
+      fprintf(t->out, "[telemetry] %llu log messages suppressed\n",
+              (unsigned long long)t->logs_suppressed);
+   }
+   t->logs_this_interval = 0;
+   t->logs_suppressed = 0;
+   fflush(t->out);
+}
+
+void telemetry_poll(telemetry *t, bool force_summary){
+   for(int i = 0; i < t->num_channels; i++){
+      telemetry_drain(t, t->channels[i]);
+   }
+   uint64_t now = telemetry_now_ns();
+   uint64_t elapsed = now - t->window_start_ns;
+   if(force_summary || elapsed >= (uint64_t)t->interval_ms * 1000000u){
+      telemetry_summary(t, elapsed * 1e-9);
+      t->window_start_ns = now;
+   }
+}
+
+/**
+ * Lowest priority available to an unprivileged thread.
+ */
+static void telemetry_lower_priority(void){
+#if defined(__APPLE__)
+   pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined(__linux__)
+   struct sched_param param = { .sched_priority = 0 };
+   pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+static void *telemetry_thread(void *arg){
+   telemetry *t = (telemetry *)arg;
+   telemetry_lower_priority();
+   struct timespec pause = { 0, TELEMETRY_POLL_MS * 1000000L };
+   while(!atomic_load_explicit(&t->stop, memory_order_relaxed)){
+      telemetry_poll(t, false);
+      nanosleep(&pause, NULL);
+   }
+   return NULL;
+}
+
+bool telemetry_start(telemetry *t){
+   if(t->running) return false;
+   atomic_store(&t->stop, false);
+   t->window_start_ns = telemetry_now_ns();
+   if(pthread_create(&t->thread, NULL, telemetry_thread, t) != 0) return false;
+   t->running = true;
+   return true;
+}
+
+void telemetry_stop(telemetry *t){
+   if(t->running){
+      atomic_store(&t->stop, true);
+      pthread_join(t->thread, NULL);
+      t->running = false;
+   }
+   telemetry_poll(t, true);
+   for(int i = 0; i < t->num_channels; i++){
+      free(t->channels[i]);
+      t->channels[i] = NULL;
+   }
+   t->num_channels = 0;
+}
@@ -1 +1,317 @@
-// Visualization/GUI logic (Metal, ImGui, etc.)
+/**
+ * visualization.c
+ *
+ * Implementation of the triple-buffered visualization snapshots.
+ *
+ * Notes:
+ * - The three snapshots are owned by position: back (producer), middle
+ *   (shared, the atomic), front (renderer). Publishing exchanges back with
+ *   middle, acquiring exchanges middle with front; the exchanges are the only
+ *   synchronization (release on publish, acquire on acquire, acq_rel since
+ *   each side hands a snapshot back as well).
+ * - A snapshot that comes back to the producer is up to two publishes
+ *   behind; it is brought up to date from the producer's history with
+ *   viz_ring_delta(), the same copy the renderer does into its GPU objects.
+ * - The pyramid's open buckets (one per level, the samples not in a
+ *   complete bucket yet) are kept apart and only written into the rings on
+ *   publish, merged bottom-up so level l's open bucket covers every sample
+ *   after its last complete bucket. The next complete bucket overwrites it.
+ * - Nothing is allocated after init, pushes and publishes are memcpy and
+ *   compares only.
+ * - Use with visualization.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "visualization.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define VIZ_MAX_WINDOW (1 << 24) // frames or rows, keeps capacities in an int
+
+static int pow2_at_least(int n){
+   int c = 1;
+   while(c < n) c <<= 1;
+   return c;
+}
+
+static uint64_t bucket_frames(int level){
+   uint64_t size = VIZ_LOD_FACTOR;
+   for(int l = 0; l < level; l++) size *= VIZ_LOD_FACTOR;
+   return size;
+}
+
+static uint64_t viz_clock_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// copy positions [seen, end) of planes rings of capacity * stride floats from src to dst
+static void copy_delta(float *dst, const float *src, uint64_t seen, uint64_t end,
+                       int capacity, int stride, int planes){
+   viz_range r[2];
+   int n = viz_ring_delta(seen, end, capacity, r);
+   for(int p = 0; p < planes; p++){
+      size_t plane = (size_t)p * capacity * stride;
+      for(int i = 0; i < n; i++){
+         size_t at = plane + (size_t)r[i].first * stride;
+         memcpy(dst + at, src + at, sizeof(float) * (size_t)r[i].count * stride);
+      }
+   }
+}
+
+static void lod_reset(float *open, int num_channels){
+   for(int ch = 0; ch < num_channels; ch++){
+      open[2 * ch] = INFINITY;
+      open[2 * ch + 1] = -INFINITY;
+   }
+}
+
+bool viz_state_init(viz_state *v, int num_channels, int num_bins, int wave_frames, int psd_rows,
+                    int history_frames, float sample_rate, float bin_hz){
+   if(num_channels < 1 || num_bins < 1 || wave_frames < 2 || psd_rows < 1 || history_frames < 0 ||
+      wave_frames > VIZ_MAX_WINDOW || psd_rows > VIZ_MAX_WINDOW || history_frames > VIZ_MAX_WINDOW){
+      return false;
+   }
+   memset(v, 0, sizeof(*v));
+   v->num_channels = num_channels;
+   v->num_bins = num_bins;
+   v->wave_frames = wave_frames;
+   v->psd_rows = psd_rows;
+   v->wave_capacity = pow2_at_least(2 * wave_frames);
+   v->psd_capacity = pow2_at_least(2 * psd_rows);
+   v->history_frames = history_frames;
+   // levels until one holds the whole history in VIZ_LOD_TOP_BUCKETS
+   for(int l = 0; history_frames > 0 && l < VIZ_LOD_MAX_LEVELS; l++){
+      uint64_t size = bucket_frames(l);
+      int buckets = (int)(((uint64_t)history_frames + size - 1) / size);
+      v->lod_capacity[l] = pow2_at_least(2 * (buckets + 1));
+      v->lod_levels = l + 1;
+      if(buckets <= VIZ_LOD_TOP_BUCKETS) break;
+   }
+   v->sample_rate = sample_rate;
+   v->bin_hz = bin_hz;
+
+   size_t wave_len = (size_t)num_channels * v->wave_capacity;
+   size_t psd_len = (size_t)num_channels * v->psd_capacity * num_bins;
+   v->wave = calloc(wave_len, sizeof(float));
+   v->psd = calloc(psd_len, sizeof(float));
+   bool ok = v->wave && v->psd;
+   for(int i = 0; i < VIZ_NUM_SNAPSHOTS; i++){
+      v->snapshots[i].wave = calloc(wave_len, sizeof(float));
+      v->snapshots[i].psd = calloc(psd_len, sizeof(float));
+      ok = ok && v->snapshots[i].wave && v->snapshots[i].psd;
+   }
+   for(int l = 0; l < v->lod_levels; l++){
+      size_t lod_len = (size_t)num_channels * v->lod_capacity[l] * 2;
+      v->lod[l] = calloc(lod_len, sizeof(float));
+      ok = ok && v->lod[l];
+      for(int i = 0; i < VIZ_NUM_SNAPSHOTS; i++){
+         v->snapshots[i].lod[l] = calloc(lod_len, sizeof(float));
+         ok = ok && v->snapshots[i].lod[l];
+      }
+   }
+   if(v->lod_levels > 0){
+      v->lod_open = malloc(sizeof(float) * 2 * num_channels * v->lod_levels);
+      ok = ok && v->lod_open;
+      for(int l = 0; ok && l < v->lod_levels; l++){
+         lod_reset(v->lod_open + (size_t)l * num_channels * 2, num_channels);
+      }
+   }
+   if(!ok){
+      viz_state_destroy(v);
+      return false;
+   }
+   v->back = 0;
+   atomic_init(&v->middle, 1);
+   v->front = 2;
+   return true;
+}
+
+int viz_ring_delta(uint64_t seen, uint64_t end, int capacity, viz_range ranges[2]){
+   if(end <= seen) return 0;
+   if(end - seen > (uint64_t)capacity) seen = end - (uint64_t)capacity;
+   int first = (int)(seen & (uint64_t)(capacity - 1));
+   int count = (int)(end - seen);
+   int to_wrap = capacity - first;
+   ranges[0].first = first;
+   ranges[0].count = count < to_wrap ? count : to_wrap;
+   ranges[0].start = seen;
+   if(count <= to_wrap) return 1;
+   ranges[1].first = 0;
+   ranges[1].count = count - to_wrap;
+   ranges[1].start = seen + (uint64_t)to_wrap;
+   return 2;
+}
+
+// write level's open bucket as complete, fold it into the next level's
+static void lod_close(viz_state *v, int level){
+   int nch = v->num_channels;
+   float *open = v->lod_open + (size_t)level * nch * 2;
+   int cap = v->lod_capacity[level];
+   size_t at = (size_t)(v->lod_end[level] & (uint64_t)(cap - 1)) * 2;
+   for(int ch = 0; ch < nch; ch++){
+      float *ring = v->lod[level] + (size_t)ch * cap * 2;
+      ring[at] = open[2 * ch];
+      ring[at + 1] = open[2 * ch + 1];
+   }
+   v->lod_end[level]++;
+   if(level + 1 < v->lod_levels){
+      float *up = open + nch * 2;
+      for(int ch = 0; ch < nch; ch++){
+         up[2 * ch] = fminf(up[2 * ch], open[2 * ch]);
+         up[2 * ch + 1] = fmaxf(up[2 * ch + 1], open[2 * ch + 1]);
+      }
+      if(++v->lod_fill[level + 1] == VIZ_LOD_FACTOR) lod_close(v, level + 1);
+   }
+   lod_reset(open, nch);
+   v->lod_fill[level] = 0;
+}
+
+static void lod_push(viz_state *v, float *const *planar, int n){
+   float *open = v->lod_open;
+   for(int i = 0; i < n; i++){
+      for(int ch = 0; ch < v->num_channels; ch++){
+         float x = planar[ch][i];
+         if(x < open[2 * ch]) open[2 * ch] = x;
+         if(x > open[2 * ch + 1]) open[2 * ch + 1] = x;
+      }
+      if(++v->lod_fill[0] == VIZ_LOD_FACTOR) lod_close(v, 0);
+   }
+}
+
+// write every level's open bucket, with the samples of the levels below, at lod_end
+static void lod_write_open(viz_state *v){
+   int nch = v->num_channels;
+   float merged[2 * 64];
+   for(int ch0 = 0; ch0 < nch; ch0 += 64){
+      int chunk = nch - ch0 < 64 ? nch - ch0 : 64;
+      lod_reset(merged, chunk);
+      for(int l = 0; l < v->lod_levels; l++){
+         const float *open = v->lod_open + ((size_t)l * nch + ch0) * 2;
+         for(int c = 0; c < chunk; c++){
+            merged[2 * c] = fminf(merged[2 * c], open[2 * c]);
+            merged[2 * c + 1] = fmaxf(merged[2 * c + 1], open[2 * c + 1]);
+         }
+         if(v->wave_end == v->lod_end[l] * bucket_frames(l)) continue; // nothing open
+         int cap = v->lod_capacity[l];
+         size_t at = (size_t)(v->lod_end[l] & (uint64_t)(cap - 1)) * 2;
+         for(int c = 0; c < chunk; c++){
+            float *ring = v->lod[l] + (size_t)(ch0 + c) * cap * 2;
+            ring[at] = merged[2 * c];
+            ring[at + 1] = merged[2 * c + 1];
+         }
+      }
+   }
+}
+
+void viz_push_wave(viz_state *v, float *const *planar, int n){
+   if(n <= 0) return;
+   uint64_t end = v->wave_end + (uint64_t)n;
+   viz_range r[2];
+   int num = viz_ring_delta(v->wave_end, end, v->wave_capacity, r);
+   for(int ch = 0; ch < v->num_channels; ch++){
+      float *ring = v->wave + (size_t)ch * v->wave_capacity;
+      for(int i = 0; i < num; i++){
+         memcpy(ring + r[i].first, planar[ch] + (r[i].start - v->wave_end), sizeof(float) * r[i].count);
+      }
+   }
+   v->wave_end = end;
+   if(v->lod_levels > 0) lod_push(v, planar, n);
+}
+
+void viz_push_psd(viz_state *v, const float *psd){
+   int row = (int)(v->psd_end & (uint64_t)(v->psd_capacity - 1));
+   for(int ch = 0; ch < v->num_channels; ch++){
+      float *dst = v->psd + ((size_t)ch * v->psd_capacity + row) * v->num_bins;
+      memcpy(dst, psd + (size_t)ch * v->num_bins, sizeof(float) * v->num_bins);
+   }
+   v->psd_end++;
+}
+
+void viz_publish(viz_state *v){
+   viz_snapshot *s = &v->snapshots[v->back];
+   copy_delta(s->wave, v->wave, s->wave_end, v->wave_end, v->wave_capacity, 1, v->num_channels);
+   copy_delta(s->psd, v->psd, s->psd_end, v->psd_end, v->psd_capacity, v->num_bins, v->num_channels);
+   if(v->lod_levels > 0) lod_write_open(v);
+   for(int l = 0; l < v->lod_levels; l++){
+      // from the snapshot's open bucket (complete now, or still open) on
+      uint64_t open = v->wave_end > v->lod_end[l] * bucket_frames(l) ? 1 : 0;
+      copy_delta(s->lod[l], v->lod[l], s->lod_end[l], v->lod_end[l] + open, v->lod_capacity[l], 2,
+                 v->num_channels);
+      s->lod_end[l] = v->lod_end[l];
+   }
+   s->wave_end = v->wave_end;
+   s->psd_end = v->psd_end;
+   s->sequence = ++v->sequence;
+   s->published_ns = viz_clock_ns();
+   unsigned int old = atomic_exchange_explicit(&v->middle, v->back | VIZ_FRESH, memory_order_acq_rel);
+   v->back = old & ~VIZ_FRESH;
+}
+
+const viz_snapshot *viz_acquire(viz_state *v){
+   if(atomic_load_explicit(&v->middle, memory_order_relaxed) & VIZ_FRESH){
+      unsigned int old = atomic_exchange_explicit(&v->middle, v->front, memory_order_acq_rel);
+      v->front = old & ~VIZ_FRESH;
+   }
+   return &v->snapshots[v->front];
+}
+
+int viz_lod_level(const viz_state *v, uint64_t span_frames, int pixels){
+   if(v->lod_levels == 0 || pixels <= 0) return -1;
+   uint64_t per_pixel = span_frames / (uint64_t)pixels;
+   int level = -1;
+   while(level + 1 < v->lod_levels && bucket_frames(level + 1) <= per_pixel) level++;
+   if(level < 0 && span_frames > (uint64_t)v->wave_frames) level = 0; // raw window too short
+   return level;
+}
+
+bool viz_lod_window(const viz_state *v, const viz_snapshot *s, int level, uint64_t span_frames,
+                    viz_lod_span *out){
+   if(level < 0 || level >= v->lod_levels) return false;
+   uint64_t size = bucket_frames(level);
+   if(span_frames > (uint64_t)v->history_frames) span_frames = (uint64_t)v->history_frames;
+   uint64_t end = s->lod_end[level] + (s->wave_end > s->lod_end[level] * size ? 1 : 0);
+   // from the bucket holding the window's first frame
+   uint64_t first = s->wave_end > span_frames ? (s->wave_end - span_frames) / size : 0;
+   if(end - first > (uint64_t)v->lod_capacity[level] / 2) first = end - (uint64_t)v->lod_capacity[level] / 2;
+   out->level = level;
+   out->bucket_frames = (int)size;
+   out->first = first;
+   out->count = (int)(end - first);
+   return true;
+}
+
+const float *viz_latest_psd(const viz_state *v, const viz_snapshot *s, int channel){
+   if(s->psd_end == 0 || channel < 0 || channel >= v->num_channels) return NULL;
+   int row = (int)((s->psd_end - 1) & (uint64_t)(v->psd_capacity - 1));
+   return s->psd + ((size_t)channel * v->psd_capacity + row) * v->num_bins;
+}
+
+void viz_state_destroy(viz_state *v){
+   free(v->wave);
+   free(v->psd);
+   v->wave = NULL;
+   v->psd = NULL;
+   for(int i = 0; i < VIZ_NUM_SNAPSHOTS; i++){
+      free(v->snapshots[i].wave);
+      free(v->snapshots[i].psd);
+      v->snapshots[i].wave = NULL;
+      v->snapshots[i].psd = NULL;
+   }
+   for(int l = 0; l < VIZ_LOD_MAX_LEVELS; l++){
+      free(v->lod[l]);
+      v->lod[l] = NULL;
+      for(int i = 0; i < VIZ_NUM_SNAPSHOTS; i++){
+         free(v->snapshots[i].lod[l]);
+         v->snapshots[i].lod[l] = NULL;
+      }
+   }
+   free(v->lod_open);
+   v->lod_open = NULL;
+   v->lod_levels = 0;
+}
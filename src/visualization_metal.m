@@ -0,0 +1,451 @@
+/**
+ * visualization_metal.m
+ *
+ * Metal renderer of the visualization snapshots: waveform lanes in the top
+ * half, one scrolling spectrogram lane per channel in the bottom half.
+ *
+ * Notes:
+ * - Built on macOS with `make METAL=1` (ARC). The waveform rings live in one
+ *   shared MTLBuffer (unified memory on Apple silicon: an upload is a memcpy
+ *   of the new samples into its contents), the spectrogram rings in an
+ *   R32Float 2D texture array, one slice per channel, width num_bins,
+ *   height psd_capacity, updated row range by row range.
+ * - Windows longer than wave_frames, or with VIZ_LOD_FACTOR or more frames
+ *   per pixel, are drawn from the min/max pyramid: one persistent buffer per
+ *   level, updated with the new buckets like the waveform, drawn as a filled
+ *   min/max band (a triangle strip of two vertices per bucket, at least one
+ *   pixel high) from the level viz_lod_level() picks for the drawable's width.
+ *   The open bucket of each level is rewritten every frame; a frame still on
+ *   the GPU may draw it half updated, which only moves its newest edge.
+ * - Uniforms carry the ring position of the oldest drawn frame and row; the
+ *   vertex shader indexes the waveform ring from there and the fragment
+ *   shader samples the texture with repeat addressing, so scrolling is an
+ *   offset change on the GPU.
+ * - At most VIZ_FRAMES_IN_FLIGHT frames are queued. Positions written for a
+ *   frame are at least capacity - window positions away from anything an
+ *   earlier frame draws (capacities are twice the windows); a jump larger
+ *   than that (renderer stalled) waits for the GPU first.
+ * - Use with visualization.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "visualization.h"
+
+#if defined(__APPLE__) && defined(EEG_METAL)
+
+#import <Foundation/Foundation.h>
+#import <Metal/Metal.h>
+#import <QuartzCore/CAMetalLayer.h>
+#include <pthread.h>
+#include <pthread/qos.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define VIZ_FRAMES_IN_FLIGHT 2
+#define VIZ_WAVE_SCALE 10.0f   // lane heights per volt
+#define VIZ_PSD_FLOOR -14.0f   // log10(V^2/Hz) drawn black
+#define VIZ_PSD_DECADES 6.0f   // log10 range from black to white
+
+// shared with the shaders, keep in the order of viz_uniforms below
+typedef struct {
+   uint32_t wave_start;
+   uint32_t wave_capacity;
+   uint32_t wave_frames;
+   uint32_t psd_start;
+   uint32_t psd_capacity;
+   uint32_t psd_rows;
+   uint32_t num_channels;
+   uint32_t num_bins;
+   uint32_t lod_start;
+   uint32_t lod_capacity;
+   float wave_scale;
+   float psd_floor;
+   float psd_decades;
+   float lod_x0;          // NDC x of the first bucket's center
+   float lod_dx;          // NDC between bucket centers
+   float pixel_ndc;       // NDC height of one pixel
+} viz_uniforms;
+
+static NSString *const viz_shader_source =
+   @"#include <metal_stdlib>\n"
+   "using namespace metal;\n"
+   "struct viz_uniforms {\n"
+   "   uint wave_start, wave_capacity, wave_frames;\n"
+   "   uint psd_start, psd_capacity, psd_rows;\n"
+   "   uint num_channels, num_bins;\n"
+   "   uint lod_start, lod_capacity;\n"
+   "   float wave_scale, psd_floor, psd_decades;\n"
+   "   float lod_x0, lod_dx, pixel_ndc;\n"
+   "};\n"
+   "struct wave_out { float4 position [[position]]; };\n"
+   "vertex wave_out wave_vertex(uint vid [[vertex_id]], uint ch [[instance_id]],\n"
+   "                            constant viz_uniforms &u [[buffer(0)]],\n"
+   "                            const device float *wave [[buffer(1)]]){\n"
+   "   uint at = (u.wave_start + vid) & (u.wave_capacity - 1);\n"
+   "   float v = wave[ch * u.wave_capacity + at];\n"
+   "   float lane = 1.0 / float(u.num_channels);\n"
+   "   float center = 1.0 - (float(ch) + 0.5) * lane;\n"
+   "   wave_out o;\n"
+   "   o.position = float4(float(vid) / float(u.wave_frames - 1) * 2.0 - 1.0,\n"
+   "                       center + clamp(v * u.wave_scale, -0.5, 0.5) * lane, 0.0, 1.0);\n"
+   "   return o;\n"
+   "}\n"
+   "vertex wave_out lod_vertex(uint vid [[vertex_id]], uint ch [[instance_id]],\n"
+   "                           constant viz_uniforms &u [[buffer(0)]],\n"
+   "                           const device float2 *lod [[buffer(1)]]){\n"
+   "   uint at = (u.lod_start + (vid >> 1)) & (u.lod_capacity - 1);\n"
+   "   float2 range = clamp(lod[ch * u.lod_capacity + at] * u.wave_scale, -0.5, 0.5);\n"
+   "   float lane = 1.0 / float(u.num_channels);\n"
+   "   float center = 1.0 - (float(ch) + 0.5) * lane;\n"
+   "   float lo = center + range.x * lane, hi = center + range.y * lane;\n"
+   "   float pad = max(0.0, u.pixel_ndc - (hi - lo)) * 0.5;\n"
+   "   wave_out o;\n"
+   "   o.position = float4(u.lod_x0 + float(vid >> 1) * u.lod_dx, (vid & 1) ? hi + pad : lo - pad, 0.0, 1.0);\n"
+   "   return o;\n"
+   "}\n"
+   "fragment float4 wave_fragment(wave_out in [[stage_in]]){\n"
+   "   return float4(0.35, 0.9, 0.55, 1.0);\n"
+   "}\n"
+   "struct spec_out { float4 position [[position]]; float2 uv; uint ch [[flat]]; };\n"
+   "vertex spec_out spec_vertex(uint vid [[vertex_id]], uint ch [[instance_id]],\n"
+   "                            constant viz_uniforms &u [[buffer(0)]]){\n"
+   "   float2 corner = float2(float(vid & 1), float(vid >> 1));\n"
+   "   float lane = 1.0 / float(u.num_channels);\n"
+   "   spec_out o;\n"
+   "   o.position = float4(corner.x * 2.0 - 1.0, -(float(ch) + 1.0 - corner.y) * lane, 0.0, 1.0);\n"
+   "   o.uv = corner;\n"
+   "   o.ch = ch;\n"
+   "   return o;\n"
+   "}\n"
+   "fragment float4 spec_fragment(spec_out in [[stage_in]], constant viz_uniforms &u [[buffer(0)]],\n"
+   "                              texture2d_array<float> history [[texture(0)]]){\n"
+   "   constexpr sampler s(address::repeat, filter::nearest);\n"
+   "   float row = (float(u.psd_start) + in.uv.x * float(u.psd_rows)) / float(u.psd_capacity);\n"
+   "   float p = history.sample(s, float2(in.uv.y, row), in.ch).r;\n"
+   "   float level = saturate((log10(max(p, 1e-30)) - u.psd_floor) / u.psd_decades);\n"
+   "   return float4(level, level * level, 0.4 * (1.0 - level) + 0.2 * level, 1.0);\n"
+   "}\n";
+
+struct viz_metal {
+   viz_state *state;
+   void *layer;           // CAMetalLayer, retained (bridged)
+   void *device;          // the objects below are retained (bridged) as well
+   void *queue;
+   void *wave_pipeline;
+   void *spec_pipeline;
+   void *lod_pipeline;
+   void *wave_buffer;
+   void *lod_buffers[VIZ_LOD_MAX_LEVELS];
+   void *history;
+   void *last_commands;
+   void *in_flight;       // dispatch_semaphore_t, retained (bridged)
+   uint64_t wave_seen;    // positions already in the GPU objects
+   uint64_t psd_seen;
+   uint64_t lod_seen[VIZ_LOD_MAX_LEVELS];
+   _Atomic uint64_t span_frames; // set by the host, read per frame
+
+   pthread_t thread;
+   int fps;
+   bool running;
+   atomic_bool stop;
+};
+
+#define VIZ_OBJ(type, p) ((__bridge type)(p))
+#define VIZ_SEMAPHORE(m) VIZ_OBJ(dispatch_semaphore_t, (m)->in_flight)
+
+static id<MTLRenderPipelineState> make_pipeline(id<MTLDevice> device, id<MTLLibrary> library,
+                                                NSString *vertex, NSString *fragment,
+                                                MTLPixelFormat format){
+   MTLRenderPipelineDescriptor *desc = [[MTLRenderPipelineDescriptor alloc] init];
+   desc.vertexFunction = [library newFunctionWithName:vertex];
+   desc.fragmentFunction = [library newFunctionWithName:fragment];
+   desc.colorAttachments[0].pixelFormat = format;
+   NSError *error = nil;
+   id<MTLRenderPipelineState> state = [device newRenderPipelineStateWithDescriptor:desc error:&error];
+   if(!state) NSLog(@"visualization: pipeline %@: %@", vertex, error);
+   return state;
+}
+
+viz_metal *viz_metal_create(viz_state *v, void *layer){
+   if(!v || !layer) return NULL;
+   CAMetalLayer *metal_layer = VIZ_OBJ(CAMetalLayer *, layer);
+   id<MTLDevice> device = metal_layer.device ? metal_layer.device : MTLCreateSystemDefaultDevice();
+   if(!device) return NULL;
+   metal_layer.device = device;
+   metal_layer.pixelFormat = MTLPixelFormatBGRA8Unorm;
+
+   NSError *error = nil;
+   id<MTLLibrary> library = [device newLibraryWithSource:viz_shader_source options:nil error:&error];
+   if(!library){
+      NSLog(@"visualization: shaders: %@", error);
+      return NULL;
+   }
+   id<MTLRenderPipelineState> wave = make_pipeline(device, library, @"wave_vertex", @"wave_fragment",
+                                                   metal_layer.pixelFormat);
+   id<MTLRenderPipelineState> spec = make_pipeline(device, library, @"spec_vertex", @"spec_fragment",
+                                                   metal_layer.pixelFormat);
+   id<MTLRenderPipelineState> lod = make_pipeline(device, library, @"lod_vertex", @"wave_fragment",
+                                                  metal_layer.pixelFormat);
+   id<MTLCommandQueue> queue = [device newCommandQueue];
+   id<MTLBuffer> wave_buffer = [device newBufferWithLength:sizeof(float) * v->num_channels * v->wave_capacity
+                                                   options:MTLResourceStorageModeShared];
+   MTLTextureDescriptor *tex = [[MTLTextureDescriptor alloc] init];
+   tex.textureType = MTLTextureType2DArray;
+   tex.pixelFormat = MTLPixelFormatR32Float;
+   tex.width = (NSUInteger)v->num_bins;
+   tex.height = (NSUInteger)v->psd_capacity;
+   tex.arrayLength = (NSUInteger)v->num_channels;
+   tex.usage = MTLTextureUsageShaderRead;
+   tex.storageMode = MTLStorageModeShared;
+   id<MTLTexture> history = [device newTextureWithDescriptor:tex];
+   if(!wave || !spec || !lod || !queue || !wave_buffer || !history) return NULL;
+   NSMutableArray<id<MTLBuffer>> *lod_buffers = [NSMutableArray array];
+   for(int l = 0; l < v->lod_levels; l++){
+      id<MTLBuffer> b = [device newBufferWithLength:sizeof(float) * 2 * v->num_channels * v->lod_capacity[l]
+                                            options:MTLResourceStorageModeShared];
+      if(!b) return NULL;
+      memset(b.contents, 0, b.length);
+      [lod_buffers addObject:b];
+   }
+   // rows and samples not pushed yet draw as silence
+   memset(wave_buffer.contents, 0, wave_buffer.length);
+   NSUInteger row_bytes = sizeof(float) * (NSUInteger)v->num_bins;
+   float *zeros = calloc((size_t)v->num_bins * v->psd_capacity, sizeof(float));
+   if(!zeros) return NULL;
+   for(int ch = 0; ch < v->num_channels; ch++){
+      [history replaceRegion:MTLRegionMake2D(0, 0, (NSUInteger)v->num_bins, (NSUInteger)v->psd_capacity)
+                 mipmapLevel:0
+                       slice:(NSUInteger)ch
+                   withBytes:zeros
+                 bytesPerRow:row_bytes
+               bytesPerImage:row_bytes * (NSUInteger)v->psd_capacity];
+   }
+   free(zeros);
+
+   viz_metal *m = calloc(1, sizeof(viz_metal));
+   if(!m) return NULL;
+   m->state = v;
+   m->layer = (void *)CFBridgingRetain(metal_layer);
+   m->device = (void *)CFBridgingRetain(device);
+   m->queue = (void *)CFBridgingRetain(queue);
+   m->wave_pipeline = (void *)CFBridgingRetain(wave);
+   m->spec_pipeline = (void *)CFBridgingRetain(spec);
+   m->lod_pipeline = (void *)CFBridgingRetain(lod);
+   m->wave_buffer = (void *)CFBridgingRetain(wave_buffer);
+   for(int l = 0; l < v->lod_levels; l++) m->lod_buffers[l] = (void *)CFBridgingRetain(lod_buffers[l]);
+   atomic_init(&m->span_frames, (uint64_t)v->wave_frames);
+   m->history = (void *)CFBridgingRetain(history);
+   m->in_flight = (void *)CFBridgingRetain(dispatch_semaphore_create(VIZ_FRAMES_IN_FLIGHT));
+   atomic_init(&m->stop, false);
+   return m;
+}
+
+// wait for every queued frame, e.g. before rewriting positions they may draw
+static void wait_gpu(viz_metal *m){
+   if(m->last_commands) [VIZ_OBJ(id<MTLCommandBuffer>, m->last_commands) waitUntilCompleted];
+}
+
+static void upload(viz_metal *m, const viz_snapshot *s){
+   viz_state *v = m->state;
+   bool jump = s->wave_end - m->wave_seen > (uint64_t)(v->wave_capacity - v->wave_frames) ||
+               s->psd_end - m->psd_seen > (uint64_t)(v->psd_capacity - v->psd_rows);
+   for(int l = 0; l < v->lod_levels; l++){
+      jump = jump || s->lod_end[l] - m->lod_seen[l] > (uint64_t)v->lod_capacity[l] / 2 - 1;
+   }
+   if(jump) wait_gpu(m);
+
+   viz_range r[2];
+   float *wave = (float *)VIZ_OBJ(id<MTLBuffer>, m->wave_buffer).contents;
+   int n = viz_ring_delta(m->wave_seen, s->wave_end, v->wave_capacity, r);
+   for(int ch = 0; ch < v->num_channels; ch++){
+      size_t plane = (size_t)ch * v->wave_capacity;
+      for(int i = 0; i < n; i++){
+         memcpy(wave + plane + r[i].first, s->wave + plane + r[i].first, sizeof(float) * r[i].count);
+      }
+   }
+   m->wave_seen = s->wave_end;
+
+   id<MTLTexture> history = VIZ_OBJ(id<MTLTexture>, m->history);
+   NSUInteger row_bytes = sizeof(float) * (NSUInteger)v->num_bins;
+   n = viz_ring_delta(m->psd_seen, s->psd_end, v->psd_capacity, r);
+   for(int ch = 0; ch < v->num_channels; ch++){
+      for(int i = 0; i < n; i++){
+         const float *rows = s->psd + ((size_t)ch * v->psd_capacity + r[i].first) * v->num_bins;
+         [history replaceRegion:MTLRegionMake2D(0, (NSUInteger)r[i].first, (NSUInteger)v->num_bins,
+                                                (NSUInteger)r[i].count)
+                    mipmapLevel:0
+                          slice:(NSUInteger)ch
+                      withBytes:rows
+                    bytesPerRow:row_bytes
+                  bytesPerImage:row_bytes * (NSUInteger)r[i].count];
+      }
+   }
+   m->psd_seen = s->psd_end;
+
+   uint64_t size = VIZ_LOD_FACTOR;
+   for(int l = 0; l < v->lod_levels; l++, size *= VIZ_LOD_FACTOR){
+      float *lod = (float *)VIZ_OBJ(id<MTLBuffer>, m->lod_buffers[l]).contents;
+      uint64_t open = s->wave_end > s->lod_end[l] * size ? 1 : 0;
+      int cap = v->lod_capacity[l];
+      n = viz_ring_delta(m->lod_seen[l], s->lod_end[l] + open, cap, r);
+      for(int ch = 0; ch < v->num_channels; ch++){
+         size_t plane = (size_t)ch * cap * 2;
+         for(int i = 0; i < n; i++){
+            memcpy(lod + plane + (size_t)r[i].first * 2, s->lod[l] + plane + (size_t)r[i].first * 2,
+                   sizeof(float) * 2 * r[i].count);
+         }
+      }
+      m->lod_seen[l] = s->lod_end[l]; // the open bucket again next frame
+   }
+}
+
+void viz_metal_set_span(viz_metal *m, uint64_t span_frames){
+   atomic_store(&m->span_frames, span_frames);
+}
+
+bool viz_metal_draw(viz_metal *m){
+   viz_state *v = m->state;
+   dispatch_semaphore_wait(VIZ_SEMAPHORE(m), DISPATCH_TIME_FOREVER);
+   bool drawn = false;
+   @autoreleasepool {
+      const viz_snapshot *s = viz_acquire(v);
+      upload(m, s);
+
+      CAMetalLayer *layer = VIZ_OBJ(CAMetalLayer *, m->layer);
+      id<CAMetalDrawable> drawable = [layer nextDrawable];
+      if(drawable){
+         uint64_t span = atomic_load(&m->span_frames);
+         if(span < 2) span = 2;
+         int pixels = (int)drawable.texture.width;
+         int level = viz_lod_level(v, span, pixels);
+         viz_lod_span lod = {0};
+         if(level >= 0 && !viz_lod_window(v, s, level, span, &lod)) level = -1;
+         if(level < 0 && span > (uint64_t)v->wave_frames) span = (uint64_t)v->wave_frames;
+
+         viz_uniforms u;
+         u.wave_start = (uint32_t)((s->wave_end - span) & (uint64_t)(v->wave_capacity - 1));
+         u.wave_capacity = (uint32_t)v->wave_capacity;
+         u.wave_frames = (uint32_t)span;
+         u.psd_start = (uint32_t)((s->psd_end - (uint64_t)v->psd_rows) & (uint64_t)(v->psd_capacity - 1));
+         u.psd_capacity = (uint32_t)v->psd_capacity;
+         u.psd_rows = (uint32_t)v->psd_rows;
+         u.num_channels = (uint32_t)v->num_channels;
+         u.num_bins = (uint32_t)v->num_bins;
+         u.wave_scale = VIZ_WAVE_SCALE;
+         u.psd_floor = VIZ_PSD_FLOOR;
+         u.psd_decades = VIZ_PSD_DECADES;
+         u.lod_start = level >= 0 ? (uint32_t)(lod.first & (uint64_t)(v->lod_capacity[level] - 1)) : 0;
+         u.lod_capacity = level >= 0 ? (uint32_t)v->lod_capacity[level] : 1;
+         // bucket centers on the frame axis, the window's first frame at x = -1
+         double first_frame = (double)s->wave_end - (double)span;
+         double center = (double)lod.first * lod.bucket_frames + 0.5 * lod.bucket_frames;
+         u.lod_x0 = (float)((center - first_frame) / (double)span * 2.0 - 1.0);
+         u.lod_dx = (float)(2.0 * lod.bucket_frames / (double)span);
+         u.pixel_ndc = 2.0f / (float)drawable.texture.height;
+
+         MTLRenderPassDescriptor *pass = [MTLRenderPassDescriptor renderPassDescriptor];
+         pass.colorAttachments[0].texture = drawable.texture;
+         pass.colorAttachments[0].loadAction = MTLLoadActionClear;
+         pass.colorAttachments[0].storeAction = MTLStoreActionStore;
+         pass.colorAttachments[0].clearColor = MTLClearColorMake(0.05, 0.05, 0.07, 1.0);
+
+         id<MTLCommandBuffer> commands = [VIZ_OBJ(id<MTLCommandQueue>, m->queue) commandBuffer];
+         id<MTLRenderCommandEncoder> enc = [commands renderCommandEncoderWithDescriptor:pass];
+         if(level < 0){
+            [enc setRenderPipelineState:VIZ_OBJ(id<MTLRenderPipelineState>, m->wave_pipeline)];
+            [enc setVertexBytes:&u length:sizeof(u) atIndex:0];
+            [enc setVertexBuffer:VIZ_OBJ(id<MTLBuffer>, m->wave_buffer) offset:0 atIndex:1];
+            [enc drawPrimitives:MTLPrimitiveTypeLineStrip vertexStart:0
+                    vertexCount:(NSUInteger)span instanceCount:(NSUInteger)v->num_channels];
+         } else if(lod.count > 0){
+            [enc setRenderPipelineState:VIZ_OBJ(id<MTLRenderPipelineState>, m->lod_pipeline)];
+            [enc setVertexBytes:&u length:sizeof(u) atIndex:0];
+            [enc setVertexBuffer:VIZ_OBJ(id<MTLBuffer>, m->lod_buffers[level]) offset:0 atIndex:1];
+            [enc drawPrimitives:MTLPrimitiveTypeTriangleStrip vertexStart:0
+                    vertexCount:(NSUInteger)lod.count * 2 instanceCount:(NSUInteger)v->num_channels];
+         }
+         [enc setRenderPipelineState:VIZ_OBJ(id<MTLRenderPipelineState>, m->spec_pipeline)];
+         [enc setVertexBytes:&u length:sizeof(u) atIndex:0];
+         [enc setFragmentBytes:&u length:sizeof(u) atIndex:0];
+         [enc setFragmentTexture:VIZ_OBJ(id<MTLTexture>, m->history) atIndex:0];
+         [enc drawPrimitives:MTLPrimitiveTypeTriangleStrip vertexStart:0
+                 vertexCount:4 instanceCount:(NSUInteger)v->num_channels];
+         [enc endEncoding];
+
+         dispatch_semaphore_t in_flight = VIZ_SEMAPHORE(m);
+         [commands addCompletedHandler:^(id<MTLCommandBuffer> done){
+            (void)done;
+            dispatch_semaphore_signal(in_flight);
+         }];
+         [commands presentDrawable:drawable];
+         [commands commit];
+         if(m->last_commands) CFRelease(m->last_commands);
+         m->last_commands = (void *)CFBridgingRetain(commands);
+         drawn = true;
+      }
+   }
+   if(!drawn) dispatch_semaphore_signal(VIZ_SEMAPHORE(m));
+   return drawn;
+}
+
+static uint64_t viz_clock_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void *render_thread(void *arg){
+   viz_metal *m = (viz_metal *)arg;
+   pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+   uint64_t period = 1000000000u / (uint64_t)m->fps;
+   uint64_t next = viz_clock_ns();
+   while(!atomic_load(&m->stop)){
+      viz_metal_draw(m);
+      next += period;
+      uint64_t now = viz_clock_ns();
+      if(next <= now){
+         next = now; // late, do not try to catch up
+         continue;
+      }
+      struct timespec pause = { (time_t)((next - now) / 1000000000u), (long)((next - now) % 1000000000u) };
+      nanosleep(&pause, NULL);
+   }
+   return NULL;
+}
+
+bool viz_metal_start(viz_metal *m, int fps){
+   if(m->running || fps <= 0) return false;
+   m->fps = fps;
+   atomic_store(&m->stop, false);
+   if(pthread_create(&m->thread, NULL, render_thread, m) != 0) return false;
+   m->running = true;
+   return true;
+}
+
+void viz_metal_stop(viz_metal *m){
+   if(!m->running) return;
+   atomic_store(&m->stop, true);
+   pthread_join(m->thread, NULL);
+   m->running = false;
+}
+
+void viz_metal_destroy(viz_metal *m){
+   if(!m) return;
+   viz_metal_stop(m);
+   wait_gpu(m);
+   void *objects[] = { m->last_commands, m->history, m->wave_buffer, m->lod_pipeline, m->spec_pipeline,
+                       m->wave_pipeline, m->queue, m->device, m->layer, m->in_flight };
+   for(int l = 0; l < VIZ_LOD_MAX_LEVELS; l++){
+      if(m->lod_buffers[l]) CFRelease(m->lod_buffers[l]);
+   }
+   for(size_t i = 0; i < sizeof(objects) / sizeof(objects[0]); i++){
+      if(objects[i]) CFRelease(objects[i]);
+   }
+   free(m);
+}
+
+#endif
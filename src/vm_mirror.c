@@ -0,0 +1,113 @@
+/**
+ * vm_mirror.c
+ *
+ * Implementation of mirrored (double-mapped) memory for ring buffers.
+ *
+ * Notes:
+ * - The mapping is 2*size bytes of address space but only size bytes of
+ *   physical memory.
+ * - On macOS the address right after the first half can be taken by another
+ *   thread between vm_deallocate() and vm_remap(), so the remap is retried.
+ * - Use with vm_mirror.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // memfd_create
+#endif
+
+#include "vm_mirror.h"
+#include <stdint.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/vm_map.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define VM_MIRROR_ATTEMPTS 3
+
+size_t vm_mirror_page_size(void){
+   return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+size_t vm_mirror_round_up(size_t bytes){
+   size_t page = vm_mirror_page_size();
+   return ((bytes + page - 1) / page) * page;
+}
+
+#if defined(__APPLE__)
+
+void *vm_mirror_alloc(size_t size){
+   if(size == 0 || size % vm_mirror_page_size() != 0) return NULL;
+   mach_port_t task = mach_task_self();
+
+   for(int attempt = 0; attempt < VM_MIRROR_ATTEMPTS; attempt++){
+      // reserve both halves so the upper half's address is known to be free
+      vm_address_t base = 0;
+      if(vm_allocate(task, &base, 2*size, VM_FLAGS_ANYWHERE) != KERN_SUCCESS){
+         return NULL;
+      }
+      // give back the upper half and map the lower half's pages there instead
+      if(vm_deallocate(task, base + size, size) != KERN_SUCCESS){
+         vm_deallocate(task, base, size);
+         return NULL;
+      }
+      vm_address_t mirror = base + size;
+      vm_prot_t cur_prot, max_prot;
+      kern_return_t kr = vm_remap(task, &mirror, size, 0, VM_FLAGS_FIXED,
+                                  task, base, FALSE, &cur_prot, &max_prot,
+                                  VM_INHERIT_DEFAULT);
+      if(kr == KERN_SUCCESS && mirror == base + size){
+         return (void *)base;
+      }
+      // someone else took the upper half, start over
+      if(kr == KERN_SUCCESS) vm_deallocate(task, mirror, size);
+      vm_deallocate(task, base, size);
+   }
+   return NULL;
+}
+
+void vm_mirror_free(void *base, size_t size){
+   if(!base) return;
+   vm_deallocate(mach_task_self(), (vm_address_t)base, 2*size);
+}
+
+#else
+
+void *vm_mirror_alloc(size_t size){
+   if(size == 0 || size % vm_mirror_page_size() != 0) return NULL;
+
+   int fd = memfd_create("ring_buffer", MFD_CLOEXEC);
+   if(fd == -1) return NULL;
+   if(ftruncate(fd, (off_t)size) != 0){
+      close(fd);
+      return NULL;
+   }
+
+   // reserve 2*size of address space, then map the file into both halves
+   uint8_t *base = mmap(NULL, 2*size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if(base == MAP_FAILED){
+      close(fd);
+      return NULL;
+   }
+   void *lower = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+   void *upper = mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+   close(fd); // the mappings keep the pages alive
+   if(lower == MAP_FAILED || upper == MAP_FAILED){
+      munmap(base, 2*size);
+      return NULL;
+   }
+   return base;
+}
+
+void vm_mirror_free(void *base, size_t size){
+   if(!base) return;
+   munmap(base, 2*size);
+}
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * work_pool.c
+ *
+ * Implementation of the fork-join worker pool.
+ *
+ * Notes:
+ * - A worker joins a job by incrementing `active` under the lock, claims
+ *   tasks from `next` without it, and leaves under the lock again. The
+ *   caller returns only once all tasks are claimed and no worker is
+ *   active, and writes the next job only then, so a worker never runs a
+ *   task of one job with the fn/ctx of another.
+ * - A worker joins only while the job has unclaimed tasks, checked under
+ *   the lock. One that wakes up after every task was claimed skips the job
+ *   without touching ctx: the caller may already have returned and reset
+ *   `next` for the next job, whose tasks it would otherwise claim and run
+ *   with this job's fn/ctx.
+ * - Use with work_pool.h to access the public API.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include "work_pool.h"
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#endif
+
+static int online_cpus(void){
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+   return n > 0 ? (int)n : 1;
+}
+
+#if defined(__APPLE__)
+
+bool work_pool_init(work_pool *p, int num_threads){
+   memset(p, 0, sizeof(*p));
+   if(num_threads < 0) num_threads = online_cpus() - 1;
+   p->num_threads = num_threads > WORK_POOL_MAX_THREADS ? WORK_POOL_MAX_THREADS : num_threads;
+   return true;
+}
+
+typedef struct {
+   work_pool_fn fn;
+   void *ctx;
+} apply_job;
+
+static void apply_task(void *ctx, size_t i){
+   apply_job *job = (apply_job *)ctx;
+   job->fn(job->ctx, (int)i);
+}
+
+void work_pool_apply(work_pool *p, int count, work_pool_fn fn, void *ctx){
+   if(!p || p->num_threads == 0 || count < 2){
+      for(int i = 0; i < count; i++) fn(ctx, i);
+      return;
+   }
+   apply_job job = { fn, ctx };
+   dispatch_apply_f((size_t)count, DISPATCH_APPLY_AUTO, &job, apply_task);
+}
+
+void work_pool_destroy(work_pool *p){
+   p->num_threads = 0;
+}
+
+#else
+
+// claim and run tasks of the current job until none is left
+static void run_tasks(work_pool *p, work_pool_fn fn, void *ctx, int count){
+   for(;;){
+      int i = atomic_fetch_add_explicit(&p->next, 1, memory_order_relaxed);
+      if(i >= count) return;
+      fn(ctx, i);
+   }
+}
+
+static void *worker(void *arg){
+   work_pool *p = (work_pool *)arg;
+   uint64_t seen = 0;
+   pthread_mutex_lock(&p->lock);
+   for(;;){
+      while(!p->stop && p->generation == seen) pthread_cond_wait(&p->start, &p->lock);
+      if(p->stop) break;
+      seen = p->generation;
+      // all claimed: the caller may be past its wait, do not join
+      if(atomic_load_explicit(&p->next, memory_order_relaxed) >= p->count) continue;
+      p->active++;
+      work_pool_fn fn = p->fn;
+      void *ctx = p->ctx;
+      int count = p->count;
+      pthread_mutex_unlock(&p->lock);
+
+      run_tasks(p, fn, ctx, count);
+
+      pthread_mutex_lock(&p->lock);
+      if(--p->active == 0) pthread_cond_signal(&p->done);
+   }
+   pthread_mutex_unlock(&p->lock);
+   return NULL;
+}
+
+bool work_pool_init(work_pool *p, int num_threads){
+   memset(p, 0, sizeof(*p));
+   if(num_threads < 0) num_threads = online_cpus() - 1;
+   if(num_threads > WORK_POOL_MAX_THREADS) num_threads = WORK_POOL_MAX_THREADS;
+   pthread_mutex_init(&p->lock, NULL);
+   pthread_cond_init(&p->start, NULL);
+   pthread_cond_init(&p->done, NULL);
+   atomic_init(&p->next, 0);
+   for(int i = 0; i < num_threads; i++){
+      if(pthread_create(&p->threads[i], NULL, worker, p) != 0){
+         work_pool_destroy(p);
+         return false;
+      }
+      p->num_threads++;
+   }
+   return true;
+}
+
+void work_pool_apply(work_pool *p, int count, work_pool_fn fn, void *ctx){
+   if(!p || p->num_threads == 0 || count < 2){
+      for(int i = 0; i < count; i++) fn(ctx, i);
+      return;
+   }
+   pthread_mutex_lock(&p->lock);
+   p->fn = fn;
+   p->ctx = ctx;
+   p->count = count;
+   atomic_store_explicit(&p->next, 0, memory_order_relaxed);
+   p->generation++;
+   pthread_cond_broadcast(&p->start);
+   pthread_mutex_unlock(&p->lock);
+
+   run_tasks(p, fn, ctx, count);
+
+   // every task is claimed, wait for the ones still running
+   pthread_mutex_lock(&p->lock);
+   while(p->active > 0) pthread_cond_wait(&p->done, &p->lock);
+   pthread_mutex_unlock(&p->lock);
+}
+
+void work_pool_destroy(work_pool *p){
+   pthread_mutex_lock(&p->lock);
+   p->stop = true;
+   pthread_cond_broadcast(&p->start);
+   pthread_mutex_unlock(&p->lock);
+   for(int i = 0; i < p->num_threads; i++) pthread_join(p->threads[i], NULL);
+   p->num_threads = 0;
+   pthread_mutex_destroy(&p->lock);
+   pthread_cond_destroy(&p->start);
+   pthread_cond_destroy(&p->done);
+}
+
+#endif
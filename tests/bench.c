@@ -0,0 +1,511 @@
+/**
+ * @file bench.c
+ * @brief Microbenchmarks of the ring buffers and DSP kernels with warmup,
+ * repeated samples, percentiles and JSON lines output.
+ *
+ * Benchmarks:
+ * - ring_buffer and spsc_ring_buffer on one thread: scalar write/read vs
+ *   write_n/read_n in blocks, general vs power-of-two init, i.e. modulo or
+ *   compare vs mask index wrapping at the same capacity (ns per value)
+ * - spsc_ring_buffer between a producer and a consumer thread, per block
+ *   size (ns per value moved)
+ * - dsp_fft_power() and one Welch PSD frame (dsp_spectral_window()) per
+ *   FFT size (ns per frame)
+ * - the EEG biquad cascade per channel count (ns per sample)
+ * - a spectral bank per channel count, on the calling thread and on a
+ *   work_pool (ns per multi-channel PSD frame, one hop)
+ * - coherence/PLV of every electrode pair per hop (conn_update()) for a
+ *   19-channel 10-20 montage and 32 channels (ns per update)
+ *
+ * Every benchmark first runs until WARMUP_MS have passed, calibrating the
+ * iterations per sample so one sample takes about SAMPLE_MS, then takes
+ * NUM_SAMPLES timed samples. Reported are min, p50, p90, p99 and mean of
+ * the per-op times over the samples.
+ *
+ * Output: one JSON object per line on stdout (first a "meta" line with the
+ * machine and compiler, then one line per benchmark), a readable summary on
+ * stderr:
+ *
+ *   {"bench":"dsp.fft_power","fft_size":256,"unit":"frame","samples":31,
+ *    "iters_per_sample":4096,"min_ns":812.4,"p50_ns":815.0,...,"ops_per_s":1227000.2}
+ *
+ * Build and run with `make bench` (optimized, asserts off, JSON lines into
+ * BENCH_OUT), arguments with BENCH_ARGS: `-q` for a quick run, other words
+ * select the benchmarks whose name contains one of them, e.g.
+ * `make bench BENCH_ARGS="-q spsc"`.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/utsname.h>
+#include "ring_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "dsp.h"
+#include "work_pool.h"
+#include "connectivity.h"
+
+#define WARMUP_MS 100
+#define SAMPLE_MS 5
+#define NUM_SAMPLES 31
+#define QUICK_WARMUP_MS 20
+#define QUICK_SAMPLES 7
+#define RB_CAPACITY 4096
+#define RB_BATCH 64
+#define XTHREAD_CAPACITY 4096
+#define BIQUAD_FRAMES 256
+#define PSD_SAMPLE_RATE 250.0f
+#define BANK_FFT_SIZE 256
+#define BANK_HOP 64
+
+// runs iters iterations of a benchmark
+typedef void (*bench_fn)(void *ctx, uint64_t iters);
+
+typedef struct {
+   int warmup_ms;
+   int num_samples;
+   int num_filters;
+   char **filters;
+} bench_options;
+
+// keeps the compiler from dropping results
+static volatile float sink;
+
+static uint64_t now_ns(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t time_iters(bench_fn fn, void *ctx, uint64_t iters){
+   uint64_t start = now_ns();
+   fn(ctx, iters);
+   return now_ns() - start;
+}
+
+static int compare_double(const void *a, const void *b){
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of sorted values
+static double percentile(const double *sorted, int n, double p){
+   int rank = (int)(p * n + 0.999999) - 1;
+   if (rank < 0) rank = 0;
+   if (rank >= n) rank = n - 1;
+   return sorted[rank];
+}
+
+static bool selected(const bench_options *opt, const char *name){
+   if (opt->num_filters == 0) return true;
+   for (int i = 0; i < opt->num_filters; i++){
+      if (strstr(name, opt->filters[i])) return true;
+   }
+   return false;
+}
+
+/**
+ * Warm up, calibrate and sample one benchmark, print its results.
+ *
+ * params is a JSON fragment with the benchmark's parameters, e.g.
+ * "\"fft_size\":256", unit names one op and ops_per_iter says how many ops
+ * one iteration does.
+ * returns void
+ */
+static void bench_run(const bench_options *opt, const char *name, const char *params,
+                      const char *unit, double ops_per_iter, bench_fn fn, void *ctx){
+   if (!selected(opt, name)) return;
+
+   // double the iterations until one call takes SAMPLE_MS, keep going until warm
+   uint64_t iters = 1;
+   uint64_t warm_until = now_ns() + (uint64_t)opt->warmup_ms * 1000000u;
+   while (1){
+      uint64_t t = time_iters(fn, ctx, iters);
+      if (t < (uint64_t)SAMPLE_MS * 1000000u && iters < (1ull << 40)){
+         iters *= 2;
+         continue;
+      }
+      if (now_ns() >= warm_until) break;
+   }
+
+   double per_op[NUM_SAMPLES];
+   double sum = 0.0;
+   for (int s = 0; s < opt->num_samples; s++){
+      per_op[s] = (double)time_iters(fn, ctx, iters) / ((double)iters * ops_per_iter);
+      sum += per_op[s];
+   }
+   qsort(per_op, (size_t)opt->num_samples, sizeof(double), compare_double);
+   int n = opt->num_samples;
+   double p50 = percentile(per_op, n, 0.50);
+
+   printf("{\"bench\":\"%s\",%s,\"unit\":\"%s\",\"samples\":%d,\"iters_per_sample\":%llu,"
+          "\"min_ns\":%.3f,\"p50_ns\":%.3f,\"p90_ns\":%.3f,\"p99_ns\":%.3f,\"mean_ns\":%.3f,"
+          "\"ops_per_s\":%.1f}\n",
+          name, params, unit, n, (unsigned long long)iters, per_op[0], p50,
+          percentile(per_op, n, 0.90), percentile(per_op, n, 0.99), sum / n, 1e9 / p50);
+   fflush(stdout);
+   fprintf(stderr, "    %-20s %-28s p50 %10.2f ns/%s  (min %.2f, p99 %.2f)\n",
+           name, params, p50, unit, per_op[0], percentile(per_op, n, 0.99));
+}
+
+/*************************** Ring buffers ***************************/
+
+static void rb_scalar(void *ctx, uint64_t iters){
+   ring_buffer *rb = (ring_buffer *)ctx;
+   float acc = 0.0f, value;
+   for (uint64_t n = 0; n < iters; n++){
+      for (int i = 0; i < RB_BATCH; i++) ring_buffer_write(rb, (float)i);
+      for (int i = 0; i < RB_BATCH; i++){
+         ring_buffer_read(rb, &value);
+         acc += value;
+      }
+   }
+   sink = acc;
+}
+
+static void rb_bulk(void *ctx, uint64_t iters){
+   ring_buffer *rb = (ring_buffer *)ctx;
+   float block[RB_BATCH];
+   for (int i = 0; i < RB_BATCH; i++) block[i] = (float)i;
+   float acc = 0.0f;
+   for (uint64_t n = 0; n < iters; n++){
+      ring_buffer_write_n(rb, block, RB_BATCH);
+      ring_buffer_read_n(rb, block, RB_BATCH);
+      acc += block[n % RB_BATCH];
+   }
+   sink = acc;
+}
+
+static void spsc_scalar(void *ctx, uint64_t iters){
+   spsc_ring_buffer *rb = (spsc_ring_buffer *)ctx;
+   float acc = 0.0f, value;
+   for (uint64_t n = 0; n < iters; n++){
+      for (int i = 0; i < RB_BATCH; i++) spsc_ring_buffer_write(rb, (float)i);
+      for (int i = 0; i < RB_BATCH; i++){
+         spsc_ring_buffer_read(rb, &value);
+         acc += value;
+      }
+   }
+   sink = acc;
+}
+
+static void spsc_bulk(void *ctx, uint64_t iters){
+   spsc_ring_buffer *rb = (spsc_ring_buffer *)ctx;
+   float block[RB_BATCH];
+   for (int i = 0; i < RB_BATCH; i++) block[i] = (float)i;
+   float acc = 0.0f;
+   for (uint64_t n = 0; n < iters; n++){
+      spsc_ring_buffer_write_n(rb, block, RB_BATCH);
+      spsc_ring_buffer_read_n(rb, block, RB_BATCH);
+      acc += block[n % RB_BATCH];
+   }
+   sink = acc;
+}
+
+static void bench_ring_buffers(const bench_options *opt){
+   const char *inits[2] = { "\"init\":\"general\"", "\"init\":\"pow2\"" };
+   for (int pow2 = 0; pow2 < 2; pow2++){
+      ring_buffer *rb = malloc(sizeof(ring_buffer));
+      bool ok = rb && (pow2 ? ring_buffer_init_pow2(rb, RB_CAPACITY) : ring_buffer_init(rb, RB_CAPACITY));
+      if (!ok){
+         fprintf(stderr, "bench: cannot allocate ring_buffer\n");
+         exit(1);
+      }
+      bench_run(opt, "ring_buffer.scalar", inits[pow2], "value", RB_BATCH, rb_scalar, rb);
+      bench_run(opt, "ring_buffer.bulk", inits[pow2], "value", RB_BATCH, rb_bulk, rb);
+      ring_buffer_destroy(rb);
+
+      spsc_ring_buffer *srb = malloc(sizeof(spsc_ring_buffer));
+      ok = srb && (pow2 ? spsc_ring_buffer_init_pow2(srb, RB_CAPACITY) : spsc_ring_buffer_init(srb, RB_CAPACITY));
+      if (!ok){
+         fprintf(stderr, "bench: cannot allocate spsc_ring_buffer\n");
+         exit(1);
+      }
+      bench_run(opt, "spsc.scalar", inits[pow2], "value", RB_BATCH, spsc_scalar, srb);
+      bench_run(opt, "spsc.bulk", inits[pow2], "value", RB_BATCH, spsc_bulk, srb);
+      spsc_ring_buffer_destroy(srb);
+   }
+}
+
+/*********************** SPSC across threads ***********************/
+
+typedef struct {
+   spsc_ring_buffer *rb;
+   int block;
+   uint64_t values;
+} xthread_ctx;
+
+static void *xthread_producer(void *arg){
+   xthread_ctx *x = (xthread_ctx *)arg;
+   float block[XTHREAD_CAPACITY];
+   for (int i = 0; i < x->block; i++) block[i] = (float)i;
+   for (uint64_t sent = 0; sent < x->values; ){
+      int n = x->values - sent < (uint64_t)x->block ? (int)(x->values - sent) : x->block;
+      int w = x->block == 1 ? (spsc_ring_buffer_write(x->rb, block[0]) ? 1 : 0)
+                            : spsc_ring_buffer_write_n(x->rb, block, n);
+      if (w == 0) sched_yield();
+      sent += (uint64_t)w;
+   }
+   return NULL;
+}
+
+// one iteration moves one value from a producer thread to this thread
+static void xthread(void *ctx, uint64_t iters){
+   xthread_ctx *x = (xthread_ctx *)ctx;
+   x->values = iters;
+   pthread_t producer;
+   if (pthread_create(&producer, NULL, xthread_producer, x) != 0){
+      fprintf(stderr, "bench: cannot create producer thread\n");
+      exit(1);
+   }
+   float block[XTHREAD_CAPACITY];
+   float acc = 0.0f;
+   for (uint64_t got = 0; got < iters; ){
+      int r = x->block == 1 ? (spsc_ring_buffer_read(x->rb, block) ? 1 : 0)
+                            : spsc_ring_buffer_read_n(x->rb, block, x->block);
+      if (r == 0){
+         sched_yield();
+         continue;
+      }
+      acc += block[0];
+      got += (uint64_t)r;
+   }
+   pthread_join(producer, NULL);
+   sink = acc;
+}
+
+static void bench_cross_thread(const bench_options *opt){
+   const int blocks[4] = { 1, 16, 64, 256 };
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   if (!rb || !spsc_ring_buffer_init_pow2(rb, XTHREAD_CAPACITY)){
+      fprintf(stderr, "bench: cannot allocate spsc_ring_buffer\n");
+      exit(1);
+   }
+   for (int i = 0; i < 4; i++){
+      xthread_ctx x = { rb, blocks[i], 0 };
+      char params[64];
+      snprintf(params, sizeof(params), "\"block\":%d,\"capacity\":%d", blocks[i], XTHREAD_CAPACITY);
+      bench_run(opt, "spsc.cross_thread", params, "value", 1.0, xthread, &x);
+   }
+   spsc_ring_buffer_destroy(rb);
+}
+
+/****************************** DSP ******************************/
+
+typedef struct {
+   dsp_fft_setup fft;
+   dsp_spectral spectral;
+   int n;
+   float *in, *re, *im, *power;
+} fft_ctx;
+
+static void fft_power(void *ctx, uint64_t iters){
+   fft_ctx *f = (fft_ctx *)ctx;
+   for (uint64_t i = 0; i < iters; i++) dsp_fft_power(&f->fft, f->in, f->re, f->im, f->power);
+   sink = f->power[1];
+}
+
+static void psd_frame(void *ctx, uint64_t iters){
+   fft_ctx *f = (fft_ctx *)ctx;
+   for (uint64_t i = 0; i < iters; i++) dsp_spectral_window(&f->spectral, f->in, f->n, NULL, f->power);
+   sink = f->power[1];
+}
+
+static void bench_fft(const bench_options *opt){
+   const int sizes[5] = { 64, 256, 1024, 2048, 4096 };
+   for (int s = 0; s < 5; s++){
+      int n = sizes[s];
+      fft_ctx f;
+      f.n = n;
+      f.in = malloc(sizeof(float) * (size_t)n);
+      f.re = malloc(sizeof(float) * (size_t)n);
+      f.im = malloc(sizeof(float) * (size_t)n);
+      f.power = malloc(sizeof(float) * (size_t)(n / 2 + 1));
+      if (!f.in || !f.re || !f.im || !f.power || !dsp_fft_setup_init(&f.fft, n) ||
+          !dsp_spectral_init(&f.spectral, n, n / 4, DSP_WINDOW_HANN, 4, PSD_SAMPLE_RATE)){
+         fprintf(stderr, "bench: cannot set up FFT of size %d\n", n);
+         exit(1);
+      }
+      for (int i = 0; i < n; i++) f.in[i] = (float)((i * 7919) % 1000) * 1e-3f - 0.5f;
+      char params[32];
+      snprintf(params, sizeof(params), "\"fft_size\":%d", n);
+      bench_run(opt, "dsp.fft_power", params, "frame", 1.0, fft_power, &f);
+      bench_run(opt, "dsp.psd_frame", params, "frame", 1.0, psd_frame, &f);
+      dsp_spectral_destroy(&f.spectral);
+      dsp_fft_setup_destroy(&f.fft);
+      free(f.in);
+      free(f.re);
+      free(f.im);
+      free(f.power);
+   }
+}
+
+typedef struct {
+   dsp_biquad_cascade cascade;
+   float *frames;
+} biquad_ctx;
+
+static void biquad(void *ctx, uint64_t iters){
+   biquad_ctx *b = (biquad_ctx *)ctx;
+   for (uint64_t i = 0; i < iters; i++){
+      dsp_biquad_cascade_process(&b->cascade, b->frames, b->frames, BIQUAD_FRAMES);
+   }
+   sink = b->frames[0];
+}
+
+static void bench_biquad(const bench_options *opt){
+   const int channels[6] = { 1, 4, 8, 16, 32, 64 };
+   for (int c = 0; c < 6; c++){
+      int nch = channels[c];
+      biquad_ctx b;
+      b.frames = malloc(sizeof(float) * (size_t)(BIQUAD_FRAMES * nch));
+      if (!b.frames || !dsp_biquad_cascade_init_eeg(&b.cascade, nch, PSD_SAMPLE_RATE, 60.0f, 0.5f, 45.0f)){
+         fprintf(stderr, "bench: cannot set up a %d channel cascade\n", nch);
+         exit(1);
+      }
+      for (int i = 0; i < BIQUAD_FRAMES * nch; i++) b.frames[i] = (float)(i % 17) * 0.1f;
+      char params[64];
+      snprintf(params, sizeof(params), "\"channels\":%d,\"sections\":%d", nch, b.cascade.num_sections);
+      bench_run(opt, "dsp.biquad_eeg", params, "sample", (double)(BIQUAD_FRAMES * nch), biquad, &b);
+      dsp_biquad_cascade_destroy(&b.cascade);
+      free(b.frames);
+   }
+}
+
+typedef struct {
+   dsp_spectral_bank bank;
+   spsc_ring_buffer **rings;
+   float *hop;              // BANK_HOP samples written to every channel per frame
+   float *psd;
+} bank_ctx;
+
+static void bank_frame(void *ctx, uint64_t iters){
+   bank_ctx *b = (bank_ctx *)ctx;
+   for (uint64_t i = 0; i < iters; i++){
+      for (int ch = 0; ch < b->bank.num_channels; ch++) spsc_ring_buffer_write_n(b->rings[ch], b->hop, BANK_HOP);
+      dsp_spectral_bank_process(&b->bank, b->rings, b->psd, 1);
+   }
+   sink = b->psd[1];
+}
+
+static void bench_bank(const bench_options *opt){
+   const int channels[3] = { 8, 32, 64 };
+   work_pool pool;
+   if (!work_pool_init(&pool, -1)){
+      fprintf(stderr, "bench: cannot start the work pool\n");
+      exit(1);
+   }
+   for (int c = 0; c < 3; c++){
+      int nch = channels[c];
+      bank_ctx b;
+      b.rings = calloc((size_t)nch, sizeof(spsc_ring_buffer *));
+      b.hop = malloc(sizeof(float) * BANK_HOP);
+      b.psd = malloc(sizeof(float) * (size_t)nch * (BANK_FFT_SIZE / 2 + 1));
+      if (!b.rings || !b.hop || !b.psd ||
+          !dsp_spectral_bank_init(&b.bank, nch, BANK_FFT_SIZE, BANK_HOP, DSP_WINDOW_HANN, 4, PSD_SAMPLE_RATE)){
+         fprintf(stderr, "bench: cannot set up a %d channel spectral bank\n", nch);
+         exit(1);
+      }
+      for (int i = 0; i < BANK_HOP; i++) b.hop[i] = (float)((i * 7919) % 1000) * 1e-3f - 0.5f;
+      for (int ch = 0; ch < nch; ch++){
+         b.rings[ch] = malloc(sizeof(spsc_ring_buffer));
+         if (!b.rings[ch] || !spsc_ring_buffer_init(b.rings[ch], BANK_FFT_SIZE + BANK_HOP)){
+            fprintf(stderr, "bench: cannot allocate the bank's rings\n");
+            exit(1);
+         }
+         // one hop short of a window, every iteration completes one
+         for (int h = 0; h < BANK_FFT_SIZE / BANK_HOP - 1; h++) spsc_ring_buffer_write_n(b.rings[ch], b.hop, BANK_HOP);
+      }
+      for (int p = 0; p < 2; p++){
+         dsp_spectral_bank_set_pool(&b.bank, p ? &pool : NULL);
+         char params[96];
+         snprintf(params, sizeof(params), "\"channels\":%d,\"fft_size\":%d,\"hop\":%d,\"workers\":%d",
+                  nch, BANK_FFT_SIZE, BANK_HOP, p ? pool.num_threads : 0);
+         bench_run(opt, "dsp.spectral_bank", params, "frame", 1.0, bank_frame, &b);
+      }
+      dsp_spectral_bank_destroy(&b.bank);
+      for (int ch = 0; ch < nch; ch++) spsc_ring_buffer_destroy(b.rings[ch]);
+      free(b.rings);
+      free(b.hop);
+      free(b.psd);
+   }
+   work_pool_destroy(&pool);
+}
+
+typedef struct {
+   dsp_spectral_bank bank;
+   conn_engine conn;
+} conn_ctx;
+
+static void conn_step(void *ctx, uint64_t iters){
+   conn_ctx *c = (conn_ctx *)ctx;
+   for (uint64_t i = 0; i < iters; i++) conn_update(&c->conn, c->bank.engines);
+   sink = (float)c->conn.windows;
+}
+
+static void bench_connectivity(const bench_options *opt){
+   const int channels[2] = { 19, 32 };
+   for (int c = 0; c < 2; c++){
+      int nch = channels[c];
+      conn_ctx x;
+      float *in = malloc(sizeof(float) * BANK_FFT_SIZE);
+      float *psd = malloc(sizeof(float) * (BANK_FFT_SIZE / 2 + 1));
+      if (!in || !psd ||
+          !dsp_spectral_bank_init(&x.bank, nch, BANK_FFT_SIZE, BANK_HOP, DSP_WINDOW_HANN, 1, PSD_SAMPLE_RATE) ||
+          !conn_init(&x.conn, nch, BANK_FFT_SIZE, NULL, 0, 0, 0, CONN_AVERAGE_WELCH, 8, 0.0f)){
+         fprintf(stderr, "bench: cannot set up connectivity for %d channels\n", nch);
+         exit(1);
+      }
+      // a different spectrum in every engine's scratch
+      for (int ch = 0; ch < nch; ch++){
+         for (int i = 0; i < BANK_FFT_SIZE; i++) in[i] = (float)(((i + 13 * ch) * 7919) % 1000) * 1e-3f - 0.5f;
+         dsp_spectral_window(&x.bank.engines[ch], in, BANK_FFT_SIZE, NULL, psd);
+      }
+      char params[96];
+      snprintf(params, sizeof(params), "\"channels\":%d,\"pairs\":%d,\"bins\":%d,\"averages\":8",
+               nch, x.conn.num_pairs, x.conn.num_bins);
+      bench_run(opt, "dsp.connectivity", params, "update", 1.0, conn_step, &x);
+      conn_destroy(&x.conn);
+      dsp_spectral_bank_destroy(&x.bank);
+      free(in);
+      free(psd);
+   }
+}
+
+int main(int argc, char **argv){
+   char *filters[16];
+   bench_options opt = { WARMUP_MS, NUM_SAMPLES, 0, filters };
+   for (int i = 1; i < argc; i++){
+      if (strcmp(argv[i], "-q") == 0){
+         opt.warmup_ms = QUICK_WARMUP_MS;
+         opt.num_samples = QUICK_SAMPLES;
+      } else if (opt.num_filters < 16){
+         filters[opt.num_filters++] = argv[i];
+      }
+   }
+
+   struct utsname host;
+   uname(&host);
+   printf("{\"meta\":{\"time\":%lld,\"os\":\"%s\",\"release\":\"%s\",\"machine\":\"%s\","
+          "\"compiler\":\"%s\",\"cache_line\":%d,\"warmup_ms\":%d,\"sample_ms\":%d,\"samples\":%d}}\n",
+          (long long)time(NULL), host.sysname, host.release, host.machine, __VERSION__,
+          RB_CACHE_LINE_SIZE, opt.warmup_ms, SAMPLE_MS, opt.num_samples);
+   fprintf(stderr, "[BENCH] %s %s, %d samples of ~%d ms after %d ms warmup\n",
+           host.sysname, host.machine, opt.num_samples, SAMPLE_MS, opt.warmup_ms);
+
+   bench_ring_buffers(&opt);
+   bench_cross_thread(&opt);
+   bench_fft(&opt);
+   bench_biquad(&opt);
+   bench_bank(&opt);
+   bench_connectivity(&opt);
+   return 0;
+}
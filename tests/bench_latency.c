@@ -0,0 +1,601 @@
+/**
+ * @file bench_latency.c
+ * @brief End-to-end latency benchmark: from the firmware's write of a
+ * packet to the band powers the feedback loop reads, hop by hop, with
+ * percentiles, and the highest sample rate the pipeline sustains.
+ *
+ * The full app pipeline runs on its own threads: serial_reader() on a pipe,
+ * filter, spectral and output stages, and the output stage publishing band
+ * powers and PSD frames to a shared-memory sink (stream_sink.h). In place
+ * of the board, a feeder thread writes protocol packets into the pipe on
+ * the firmware's schedule (absolute deadlines, like serial_source.c) and
+ * notes the send time of every packet under its sequence number, which the
+ * packet carries to the host. In place of the neurofeedback system, a
+ * consumer thread reads the sink, polling every FEEDBACK_POLL_US.
+ *
+ * Packet contents are a synthetic sine mix, or the frames of a raw serial
+ * capture (`replay:<capture>`, the byte stream of a real board) tiled over
+ * the channels of each configuration, re-sent at the benchmark's rate.
+ *
+ * Hops, from the stamps every stage forwards (pipeline_stage_set_trace()):
+ *
+ *   serial_parse        packet written -> its frames in the raw ring
+ *                       (pipe, reader wakeup, parse, int16 ring write)
+ *   <stage>.ring_dwell  upstream wrote the data -> the stage read it
+ *   filter.step         frames read -> filtered frames written
+ *   spectral.step       frames read -> PSD frame written (FFT, Welch)
+ *   output.step         PSD frame read -> band powers published, callback done
+ *   sink.read           band powers published -> read by the feedback side
+ *   end_to_end          packet written -> its band powers read
+ *
+ * Each batch carries the ingest time of its newest data, so every hop is
+ * measured for the newest sample it contains. A sample waits up to
+ * (frames_per_packet - 1) / rate in the firmware before its packet is
+ * sent; that packetization delay is not included.
+ *
+ * Two benchmarks, for 1, 8 and 32 channels:
+ * - e2e.latency: LATENCY_SECONDS at the app's 250 Hz, p50/p99/p99.9/max
+ *   per hop. FFT_HOP is shorter than the app's so a run yields enough PSD
+ *   frames for p99.9; the per-frame work is the same.
+ * - e2e.max_rate: the sample rate is doubled from 250 Hz until a trial of
+ *   RATE_TRIAL_MS fails, then bisected. A trial passes when no ring or sink
+ *   dropped anything and the feeder kept to its schedule (a pipe the
+ *   reader does not empty blocks it). Packets grow with the rate to one
+ *   per RATE_PACKET_US, as a faster board would batch, so the feeder's
+ *   write() calls do not set the limit.
+ *
+ * Output: JSON lines on stdout (a "meta" line, then one line per hop or
+ * rate), a readable summary on stderr:
+ *
+ *   {"bench":"e2e.latency","source":"synth","channels":8,"sample_rate":250.0,...,
+ *    "hop":"filter.step","count":1875,"p50_us":12.1,"p99_us":40.3,"p999_us":88.0,"max_us":91.2}
+ *
+ * Build and run with `make bench-latency` (optimized, asserts off, JSON
+ * lines into BENCH_LATENCY_OUT), arguments with BENCH_LATENCY_ARGS: `-q`
+ * for a quick run, `replay:<capture>` for recorded data, other words select
+ * the benchmarks whose name contains one of them, e.g.
+ * `make bench-latency BENCH_LATENCY_ARGS="-q latency"`.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include "pipeline.h"
+#include "pipeline_stages.h"
+#include "read_serial_data.h"
+#include "serial_protocol.h"
+#include "stream_sink.h"
+#include "work_pool.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 250.0f       // the app's rate
+#define FRAMES_PER_PACKET 8
+#define FFT_SIZE 256
+#define FFT_HOP 16               // one PSD frame every 64 ms at 250 Hz
+#define PSD_AVERAGES 4
+#define RING_FRAMES 4096
+#define PSD_RING_FRAMES 16
+#define FILTER_BLOCK_TIMEOUT_US 10000
+#define POOL_MIN_CHANNELS 16     // as in the app
+#define LINE_FREQ_HZ 60.0f
+#define BAND_LO_HZ 0.5f
+#define BAND_HI_HZ 45.0f
+#define SINK_SLOTS 64
+#define SHM_NAME "/eeg_bench_latency"
+#define FEEDBACK_POLL_US 100
+#define LATENCY_SECONDS 30
+#define QUICK_LATENCY_SECONDS 5
+#define RATE_TRIAL_MS 1000
+#define QUICK_RATE_TRIAL_MS 250
+#define RATE_PACKET_US 1000
+#define RATE_MAX_HZ 4000000.0f
+#define RATE_BISECT_STEPS 4
+#define DRAIN_MS 2000            // longest wait for the reader after the last packet
+#define LATE_SLACK_MS 20         // behind schedule by more than this: not sustained
+#define NUM_CONFIGS 3
+
+static const int channel_configs[NUM_CONFIGS] = { 1, 8, 32 };
+
+typedef struct {
+   int num_filters;
+   char **filters;
+   bool quick;
+   const char *source;       // "synth" or the capture path
+   int16_t *capture;         // frames of the capture, NULL = synthetic
+   int capture_frames;
+   int capture_channels;
+} bench_options;
+
+// stamped batches of one stage, written by the stage thread only
+typedef struct {
+   pipeline_trace *items;
+   int count;
+   int capacity;
+} trace_log;
+
+// one pipeline run
+typedef struct {
+   const bench_options *opt;
+   int num_channels;
+   float rate;
+   int frames_per_packet;
+   uint64_t num_packets;
+   bool trace;
+   // feeder, final once it has been joined
+   int fd;
+   uint64_t *send_ns;        // per packet
+   uint64_t late_ns;         // the last packet went out this late
+   // feedback side
+   stream_shm consumer;
+   atomic_bool stop;
+   uint64_t *published_ns;   // per band power seq, 0 = not seen
+   uint64_t *seen_ns;
+   uint64_t num_seen;
+   uint64_t max_seq;
+   trace_log logs[PIPELINE_MAX_STAGES];
+} run_state;
+
+static uint64_t now_ns(void){
+   return pipeline_now_ns();
+}
+
+static void sleep_until(uint64_t deadline_ns){
+   uint64_t now = now_ns();
+   if (deadline_ns <= now) return;
+   uint64_t left = deadline_ns - now;
+   struct timespec ts = { (time_t)(left / 1000000000u), (long)(left % 1000000000u) };
+   nanosleep(&ts, NULL);
+}
+
+static int compare_double(const void *a, const void *b){
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of sorted values
+static double percentile(const double *sorted, int n, double p){
+   int rank = (int)(p * n + 0.999999) - 1;
+   if (rank < 0) rank = 0;
+   if (rank >= n) rank = n - 1;
+   return sorted[rank];
+}
+
+static bool selected(const bench_options *opt, const char *name){
+   if (opt->num_filters == 0) return true;
+   for (int i = 0; i < opt->num_filters; i++){
+      if (strstr(name, opt->filters[i])) return true;
+   }
+   return false;
+}
+
+static void *alloc_or_die(size_t bytes){
+   void *p = calloc(1, bytes);
+   if (!p){
+      fprintf(stderr, "bench_latency: out of memory\n");
+      exit(1);
+   }
+   return p;
+}
+
+/****************************** Capture ******************************/
+
+static void on_capture_packet(const serial_packet *pkt, void *ctx){
+   bench_options *opt = (bench_options *)ctx;
+   if (opt->capture_channels == 0) opt->capture_channels = pkt->num_channels;
+   if (pkt->num_channels != opt->capture_channels) return;
+   size_t codes = (size_t)pkt->num_frames * (size_t)pkt->num_channels;
+   int16_t *grown = realloc(opt->capture, sizeof(int16_t) * ((size_t)opt->capture_frames *
+                                                              (size_t)opt->capture_channels + codes));
+   if (!grown) return;
+   opt->capture = grown;
+   memcpy(opt->capture + (size_t)opt->capture_frames * (size_t)opt->capture_channels, pkt->codes,
+          sizeof(int16_t) * codes);
+   opt->capture_frames += pkt->num_frames;
+}
+
+// the frames of every valid packet in a raw serial capture
+static bool load_capture(bench_options *opt, const char *path){
+   FILE *f = fopen(path, "rb");
+   if (!f) return false;
+   static serial_parser parser;
+   serial_parser_init(&parser);
+   uint8_t buf[65536];
+   size_t n;
+   while ((n = fread(buf, 1, sizeof(buf), f)) > 0) serial_parser_feed(&parser, buf, n, on_capture_packet, opt);
+   fclose(f);
+   return opt->capture_frames > 0;
+}
+
+/******************************* Feeder *******************************/
+
+// codes of frame index f, channel ch: the capture tiled over the channels, or a sine mix
+static int16_t frame_code(const bench_options *opt, uint64_t f, int ch){
+   if (opt->capture){
+      uint64_t frame = f % (uint64_t)opt->capture_frames;
+      return opt->capture[frame * (uint64_t)opt->capture_channels + (uint64_t)(ch % opt->capture_channels)];
+   }
+   double t = (double)f / SAMPLE_RATE;
+   double v = 0.5 * sin(2.0 * M_PI * 10.0 * t) + 0.2 * sin(2.0 * M_PI * 6.0 * t);
+   return (int16_t)(SERIAL_ADC_MAX_CODE / 2 + lrint(v * (1.0 + 0.25 * ch) / SERIAL_VOLTS_PER_CODE * 0.25));
+}
+
+// the board: one packet per period on absolute deadlines, send time noted per packet
+static void *feeder(void *arg){
+   run_state *r = (run_state *)arg;
+   int nch = r->num_channels, fpp = r->frames_per_packet;
+   uint8_t *packet = alloc_or_die(SERIAL_PROTO_MAX_PACKET);
+   int16_t *codes = alloc_or_die(sizeof(int16_t) * (size_t)nch * (size_t)fpp);
+   double period_ns = fpp * 1e9 / r->rate;
+   uint64_t start = now_ns();
+   uint64_t due = start;
+   for (uint64_t k = 0; k < r->num_packets; k++){
+      for (int f = 0; f < fpp; f++){
+         for (int ch = 0; ch < nch; ch++) codes[f * nch + ch] = frame_code(r->opt, k * (uint64_t)fpp + (uint64_t)f, ch);
+      }
+      size_t len = serial_packet_encode(packet, (uint16_t)k, nch, fpp, codes);
+      due = start + (uint64_t)((double)(k + 1) * period_ns);
+      sleep_until(due);
+      r->send_ns[k] = now_ns();
+      for (size_t off = 0; off < len; ){
+         ssize_t n = write(r->fd, packet + off, len - off);
+         if (n > 0) off += (size_t)n;
+         else if (n < 0 && errno != EINTR) break;
+      }
+   }
+   uint64_t end = now_ns();
+   r->late_ns = end > due ? end - due : 0;
+   // end of file: the reader returns once it has read the pipe empty
+   close(r->fd);
+   free(packet);
+   free(codes);
+   return NULL;
+}
+
+/**************************** Feedback side ****************************/
+
+// the neurofeedback loop: reads every band power message of the sink
+static void *feedback(void *arg){
+   run_state *r = (run_state *)arg;
+   struct timespec poll = { 0, FEEDBACK_POLL_US * 1000L };
+   while (1){
+      bool stop = atomic_load(&r->stop);
+      const float *values;
+      const stream_header *h = stream_shm_peek(&r->consumer, &values);
+      if (!h){
+         if (stop) break;
+         nanosleep(&poll, NULL);
+         continue;
+      }
+      if (h->kind == STREAM_BAND_POWER && r->seen_ns && h->seq < r->max_seq){
+         r->seen_ns[h->seq] = now_ns();
+         r->published_ns[h->seq] = h->time_ns;
+         r->num_seen++;
+      }
+      stream_shm_release(&r->consumer);
+   }
+   return NULL;
+}
+
+static void log_trace(const pipeline_trace *trace, void *ctx){
+   trace_log *log = (trace_log *)ctx;
+   if (log->count < log->capacity) log->items[log->count++] = *trace;
+}
+
+static void on_psd(const float *psd, int num_channels, int num_bins, void *ctx){
+   (void)psd;
+   (void)num_channels;
+   (void)num_bins;
+   (void)ctx;
+}
+
+/******************************** Run ********************************/
+
+/**
+ * Build the app's pipeline for r->num_channels channels, feed it
+ * r->num_packets packets at r->rate, stop it once the feeder is done and
+ * everything is drained.
+ * returns true if no ring or sink dropped anything and the feeder kept to its schedule.
+ */
+static bool run_pipeline(run_state *r){
+   int nch = r->num_channels, bins = FFT_SIZE / 2 + 1;
+   int fds[2];
+   if (pipe(fds) != 0){
+      perror("bench_latency: pipe");
+      exit(1);
+   }
+   r->fd = fds[1];
+   r->send_ns = alloc_or_die(sizeof(uint64_t) * (size_t)r->num_packets);
+   uint64_t frames = r->num_packets * (uint64_t)r->frames_per_packet;
+   r->max_seq = r->trace ? frames / FFT_HOP + 16 : 0;
+   if (r->trace){
+      r->seen_ns = alloc_or_die(sizeof(uint64_t) * (size_t)r->max_seq);
+      r->published_ns = alloc_or_die(sizeof(uint64_t) * (size_t)r->max_seq);
+   }
+
+   mc_ring_buffer raw, filtered, spectra;
+   filter_stage filter;
+   spectral_stage spectral;
+   output_stage output;
+   stream_shm shm;
+   if (!mc_ring_buffer_init_i16(&raw, nch, RING_FRAMES, SERIAL_VOLTS_PER_CODE) ||
+       !mc_ring_buffer_init(&filtered, nch, RING_FRAMES) ||
+       !mc_ring_buffer_init(&spectra, nch * bins, PSD_RING_FRAMES) ||
+       !filter_stage_init(&filter, &raw, &filtered, r->rate, LINE_FREQ_HZ, BAND_LO_HZ, BAND_HI_HZ) ||
+       !spectral_stage_init(&spectral, &filtered, &spectra, FFT_SIZE, FFT_HOP, DSP_WINDOW_HANN,
+                            PSD_AVERAGES, r->rate) ||
+       !output_stage_init(&output, &spectra, nch, on_psd, NULL) ||
+       !stream_shm_create(&shm, SHM_NAME, SINK_SLOTS, nch * bins) ||
+       !stream_shm_open(&r->consumer, SHM_NAME)){
+      fprintf(stderr, "bench_latency: cannot set up the pipeline for %d channels\n", nch);
+      exit(1);
+   }
+   // the app's backpressure policies
+   mc_ring_buffer_set_overflow_policy(&raw, RB_OVERFLOW_OVERWRITE, 0);
+   mc_ring_buffer_set_overflow_policy(&filtered, RB_OVERFLOW_BLOCK, FILTER_BLOCK_TIMEOUT_US);
+   mc_ring_buffer_set_overflow_policy(&spectra, RB_OVERFLOW_REJECT, 0);
+   work_pool pool;
+   bool use_pool = nch >= POOL_MIN_CHANNELS;
+   if (use_pool){
+      if (!work_pool_init(&pool, -1)){
+         fprintf(stderr, "bench_latency: cannot start the work pool\n");
+         exit(1);
+      }
+      spectral_stage_set_pool(&spectral, &pool);
+   }
+   stream_sinks sinks = { &shm, NULL };
+   output_stage_set_sinks(&output, &sinks, r->rate / FFT_SIZE);
+
+   pipeline *pl = alloc_or_die(sizeof(pipeline));
+   pipeline_init(pl);
+   serial_reader_args reader = {0};
+   pipeline_stage_config ingest_cfg = { "ingest", PIPELINE_QOS_USER_INTERACTIVE, 0, NULL, serial_reader, &reader };
+   pipeline_stage_config filter_cfg = { "filter", PIPELINE_QOS_USER_INITIATED, 0, filter_stage_step, NULL, &filter };
+   pipeline_stage_config spectral_cfg = { "spectral", PIPELINE_QOS_UTILITY, 0, spectral_stage_step, NULL, &spectral };
+   pipeline_stage_config output_cfg = { "output", PIPELINE_QOS_USER_INTERACTIVE, 0, output_stage_step, NULL, &output };
+   pipeline_stage *ingest = pipeline_add_stage(pl, &ingest_cfg);
+   pipeline_add_stage(pl, &filter_cfg);
+   pipeline_add_stage(pl, &spectral_cfg);
+   pipeline_add_stage(pl, &output_cfg);
+   for (int i = 0; r->trace && i < pl->num_stages; i++){
+      trace_log *log = &r->logs[i];
+      log->capacity = (int)(i == 0 ? r->num_packets : frames) + 16;
+      log->items = alloc_or_die(sizeof(pipeline_trace) * (size_t)log->capacity);
+      pipeline_stage_set_trace(&pl->stages[i], log_trace, log);
+   }
+   reader.fd = fds[0];
+   reader.num_channels = nch;
+   reader.frames_per_packet = r->frames_per_packet;
+   reader.ring = &raw;
+   // one wakeup per packet, as the app configures the port
+   size_t packet_size = serial_packet_size(nch, r->frames_per_packet);
+   reader.tuning.vmin = packet_size < 255 ? (int)packet_size : 255;
+   reader.tuning.vtime = 1;
+   reader.stop = pipeline_stage_stop_flag(ingest);
+   reader.stage = ingest;
+
+   atomic_init(&r->stop, false);
+   pthread_t feed, fb;
+   if (!pipeline_start(pl) || pthread_create(&fb, NULL, feedback, r) != 0 ||
+       pthread_create(&feed, NULL, feeder, r) != 0){
+      perror("bench_latency: cannot start the threads");
+      exit(1);
+   }
+   pthread_join(feed, NULL);
+   // every frame ingested (or dropped by the raw ring), then the later stages drain their inputs
+   uint64_t give_up = now_ns() + (uint64_t)DRAIN_MS * 1000000u;
+   while (atomic_load(&ingest->stats.frames_in) < frames && now_ns() < give_up) sleep_until(now_ns() + 1000000u);
+   pipeline_stop(pl);
+   atomic_store(&r->stop, true);
+   pthread_join(fb, NULL);
+
+   bool ok = r->late_ns <= (uint64_t)LATE_SLACK_MS * 1000000u + (uint64_t)(2e9 * r->frames_per_packet / r->rate) &&
+             shm.dropped == 0;
+   for (int i = 0; i < pl->num_stages; i++) ok = ok && atomic_load(&pl->stages[i].stats.dropped) == 0;
+
+   if (use_pool) work_pool_destroy(&pool);
+   filter_stage_destroy(&filter);
+   spectral_stage_destroy(&spectral);
+   output_stage_destroy(&output);
+   stream_shm_close(&r->consumer);
+   stream_shm_close(&shm);
+   mc_ring_buffer_deinit(&raw);
+   mc_ring_buffer_deinit(&filtered);
+   mc_ring_buffer_deinit(&spectra);
+   close(fds[0]);
+   free(pl);
+   return ok;
+}
+
+static void free_run(run_state *r){
+   free(r->send_ns);
+   free(r->seen_ns);
+   free(r->published_ns);
+   for (int i = 0; i < PIPELINE_MAX_STAGES; i++) free(r->logs[i].items);
+}
+
+/****************************** Latency ******************************/
+
+// send time of the newest packet ingested at ingest_ns, 0 if unknown
+static uint64_t send_time(const run_state *r, uint64_t ingest_ns){
+   const trace_log *in = &r->logs[0];
+   int lo = 0, hi = in->count - 1;
+   while (lo <= hi){
+      int mid = (lo + hi) / 2;
+      if (in->items[mid].ingest_ns < ingest_ns) lo = mid + 1;
+      else if (in->items[mid].ingest_ns > ingest_ns) hi = mid - 1;
+      else {
+         while (mid + 1 < in->count && in->items[mid + 1].ingest_ns == ingest_ns) mid++;
+         uint64_t packet = (in->items[mid].frame - 1) / (uint64_t)r->frames_per_packet;
+         return packet < r->num_packets ? r->send_ns[packet] : 0;
+      }
+   }
+   return 0;
+}
+
+// sorts the samples (us) of one hop and prints its line
+static void report_hop(const run_state *r, const char *hop, double *us, int n){
+   if (n == 0){
+      fprintf(stderr, "    %-20s no samples\n", hop);
+      return;
+   }
+   qsort(us, (size_t)n, sizeof(double), compare_double);
+   double p50 = percentile(us, n, 0.50), p99 = percentile(us, n, 0.99), p999 = percentile(us, n, 0.999);
+   printf("{\"bench\":\"e2e.latency\",\"source\":\"%s\",\"channels\":%d,\"sample_rate\":%.1f,"
+          "\"frames_per_packet\":%d,\"fft_size\":%d,\"fft_hop\":%d,\"hop\":\"%s\",\"count\":%d,"
+          "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}\n",
+          r->opt->source, r->num_channels, r->rate, r->frames_per_packet, FFT_SIZE, FFT_HOP, hop, n,
+          p50, p99, p999, us[n - 1]);
+   fflush(stdout);
+   fprintf(stderr, "    %-20s %6d  p50 %9.1f us  p99 %9.1f us  p99.9 %9.1f us  max %9.1f us\n",
+           hop, n, p50, p99, p999, us[n - 1]);
+}
+
+static void bench_latency(const bench_options *opt){
+   if (!selected(opt, "e2e.latency")) return;
+   int seconds = opt->quick ? QUICK_LATENCY_SECONDS : LATENCY_SECONDS;
+   const char *stage_names[4] = { "ingest", "filter", "spectral", "output" };
+   for (int c = 0; c < NUM_CONFIGS; c++){
+      run_state r;
+      memset(&r, 0, sizeof(r));
+      r.opt = opt;
+      r.num_channels = channel_configs[c];
+      r.rate = SAMPLE_RATE;
+      r.frames_per_packet = FRAMES_PER_PACKET;
+      r.num_packets = (uint64_t)(seconds * SAMPLE_RATE / FRAMES_PER_PACKET);
+      r.trace = true;
+      fprintf(stderr, "[e2e.latency] %d channels, %.0f Hz, %d frames per packet, %d s of %s\n",
+              r.num_channels, r.rate, r.frames_per_packet, seconds, opt->source);
+      if (!run_pipeline(&r)) fprintf(stderr, "    (frames were dropped or the feeder fell behind)\n");
+
+      int most = (int)(r.num_packets * FRAMES_PER_PACKET) + 16;
+      double *us = alloc_or_die(sizeof(double) * (size_t)most);
+      char hop[32];
+      int n = 0;
+      for (int i = 0; i < r.logs[0].count; i++){
+         uint64_t sent = r.send_ns[(r.logs[0].items[i].frame - 1) / FRAMES_PER_PACKET];
+         us[n++] = (double)(r.logs[0].items[i].produced_ns - sent) * 1e-3;
+      }
+      report_hop(&r, "serial_parse", us, n);
+      for (int s = 1; s < 4; s++){
+         const trace_log *log = &r.logs[s];
+         for (int i = 0; i < log->count; i++) us[i] = (double)(log->items[i].consumed_ns - log->items[i].ready_ns) * 1e-3;
+         snprintf(hop, sizeof(hop), "%s.ring_dwell", stage_names[s]);
+         report_hop(&r, hop, us, log->count);
+         for (int i = 0; i < log->count; i++) us[i] = (double)(log->items[i].produced_ns - log->items[i].consumed_ns) * 1e-3;
+         snprintf(hop, sizeof(hop), "%s.step", stage_names[s]);
+         report_hop(&r, hop, us, log->count);
+      }
+      n = 0;
+      for (uint64_t seq = 0; seq < r.max_seq; seq++){
+         if (r.seen_ns[seq]) us[n++] = (double)(r.seen_ns[seq] - r.published_ns[seq]) * 1e-3;
+      }
+      report_hop(&r, "sink.read", us, n);
+      // output frame k is band power message k - 1
+      n = 0;
+      const trace_log *out = &r.logs[3];
+      for (int i = 0; i < out->count; i++){
+         uint64_t seq = out->items[i].frame - 1;
+         uint64_t sent = send_time(&r, out->items[i].ingest_ns);
+         if (seq < r.max_seq && r.seen_ns[seq] && sent) us[n++] = (double)(r.seen_ns[seq] - sent) * 1e-3;
+      }
+      report_hop(&r, "end_to_end", us, n);
+      free(us);
+      free_run(&r);
+   }
+}
+
+/**************************** Max rate ****************************/
+
+// one short run at rate, packets of RATE_PACKET_US
+static bool rate_trial(const bench_options *opt, int num_channels, float rate, int trial_ms){
+   run_state r;
+   memset(&r, 0, sizeof(r));
+   r.opt = opt;
+   r.num_channels = num_channels;
+   r.rate = rate;
+   int fpp = (int)(rate * RATE_PACKET_US * 1e-6f);
+   if (fpp < FRAMES_PER_PACKET) fpp = FRAMES_PER_PACKET;
+   if (fpp > SERIAL_PROTO_MAX_CODES / num_channels) fpp = SERIAL_PROTO_MAX_CODES / num_channels;
+   r.frames_per_packet = fpp;
+   r.num_packets = (uint64_t)(rate * trial_ms * 1e-3f / (float)fpp) + 1;
+   bool ok = run_pipeline(&r);
+   free_run(&r);
+   return ok;
+}
+
+static void bench_max_rate(const bench_options *opt){
+   if (!selected(opt, "e2e.max_rate")) return;
+   int trial_ms = opt->quick ? QUICK_RATE_TRIAL_MS : RATE_TRIAL_MS;
+   for (int c = 0; c < NUM_CONFIGS; c++){
+      int nch = channel_configs[c];
+      float good = 0.0f, bad = 0.0f;
+      for (float rate = SAMPLE_RATE; rate <= RATE_MAX_HZ; rate *= 2.0f){
+         if (!rate_trial(opt, nch, rate, trial_ms)){
+            bad = rate;
+            break;
+         }
+         good = rate;
+      }
+      for (int step = 0; bad > 0.0f && good > 0.0f && step < RATE_BISECT_STEPS; step++){
+         float mid = 0.5f * (good + bad);
+         if (rate_trial(opt, nch, mid, trial_ms)) good = mid;
+         else bad = mid;
+      }
+      printf("{\"bench\":\"e2e.max_rate\",\"source\":\"%s\",\"channels\":%d,\"fft_size\":%d,\"fft_hop\":%d,"
+             "\"trial_ms\":%d,\"max_rate_hz\":%.1f,\"capped\":%s}\n", opt->source, nch, FFT_SIZE, FFT_HOP,
+             trial_ms, good, bad == 0.0f ? "true" : "false");
+      fflush(stdout);
+      fprintf(stderr, "[e2e.max_rate] %2d channels: %10.0f Hz sustained (%10.0f samples/s)%s\n", nch, good,
+              good * nch, bad == 0.0f ? ", benchmark cap" : "");
+   }
+}
+
+int main(int argc, char **argv){
+   char *filters[16];
+   bench_options opt;
+   memset(&opt, 0, sizeof(opt));
+   opt.filters = filters;
+   opt.source = "synth";
+   for (int i = 1; i < argc; i++){
+      if (strcmp(argv[i], "-q") == 0){
+         opt.quick = true;
+      } else if (strncmp(argv[i], "replay:", 7) == 0){
+         if (!load_capture(&opt, argv[i] + 7)){
+            fprintf(stderr, "bench_latency: no packets in %s\n", argv[i] + 7);
+            return 1;
+         }
+         opt.source = argv[i] + 7;
+      } else if (opt.num_filters < 16){
+         filters[opt.num_filters++] = argv[i];
+      }
+   }
+
+   struct utsname host;
+   uname(&host);
+   printf("{\"meta\":{\"time\":%lld,\"os\":\"%s\",\"release\":\"%s\",\"machine\":\"%s\","
+          "\"compiler\":\"%s\",\"cpus\":%ld,\"source\":\"%s\",\"quick\":%s}}\n",
+          (long long)time(NULL), host.sysname, host.release, host.machine, __VERSION__,
+          sysconf(_SC_NPROCESSORS_ONLN), opt.source, opt.quick ? "true" : "false");
+   fprintf(stderr, "[BENCH] %s %s, %ld CPUs, source %s\n", host.sysname, host.machine,
+           sysconf(_SC_NPROCESSORS_ONLN), opt.source);
+
+   bench_latency(&opt);
+   bench_max_rate(&opt);
+   free(opt.capture);
+   return 0;
+}
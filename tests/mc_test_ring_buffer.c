@@ -0,0 +1,374 @@
+/**
+ * @file mc_test_ring_buffer.c
+ * @brief Unit and cross-thread tests for the mc_ring_buffer library.
+ *
+ * This file contains tests for the multi-channel frame ring buffer, including:
+ * - Initialization and invalid channel count / capacity
+ * - Interleaved frame read/write, full and empty, wraparound
+ * - Planar read: each channel deinterleaved into its own array
+ * - Peek views: per-channel strided spans split at the wrap point
+ * - Reserve/commit of frames written in place
+ * - Overwrite mode drops whole frames
+ * - int16 rings: codes in, scaled floats out (interleaved and planar,
+ *   across the wrap), overwrite, float-only calls refused
+ * - One producer thread and one consumer thread streaming a 19 channel
+ *   (10-20 montage) signal, checking every frame arrives once and in order
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include "mc_ring_buffer.h"
+#include "test_helpers.h"
+
+#define NUM_CHANNELS 19   // 10-20 system
+#define FRAME_CAPACITY 100
+#define NUM_FRAMES 200000
+#define BLOCK_FRAMES 37
+
+// value of a given channel in a given frame, unique per (frame, channel)
+static float sample_value(int frame, int channel){
+   return (float)(frame % 10000) + channel * 0.01f;
+}
+
+static void fill_frames(float *frames, int first, int num_frames, int num_channels){
+   for (int f = 0; f < num_frames; f++){
+      for (int c = 0; c < num_channels; c++){
+         frames[f * num_channels + c] = sample_value(first + f, c);
+      }
+   }
+}
+
+/**
+ * Tests that false is returned for a channel count or capacity <= 0,
+ * and that a valid buffer starts empty.
+ *
+ * returns void
+*/
+void test_mc_init(void){
+   printf("[TEST] MC initialization ... \n");
+   mc_ring_buffer *rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb);
+   assert(mc_ring_buffer_init(rb, 0, 8) == false);
+   assert(mc_ring_buffer_init(rb, 4, 0) == false);
+   assert(mc_ring_buffer_init(rb, -1, 8) == false);
+   assert(mc_ring_buffer_init(rb, 4, -8) == false);
+   assert(mc_ring_buffer_init(rb, NUM_CHANNELS, 8) == true);
+   assert(rb->num_channels == NUM_CHANNELS);
+   assert(rb->max_num_frames == 8);
+   assert(rb->ring->max_num_values == NUM_CHANNELS * 8);
+   assert(mc_ring_buffer_num_frames(rb) == 0);
+   MC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Writes frames until full, reads them back interleaved, several times so
+ * the frames wrap around the end of the storage.
+ *
+ * returns void
+*/
+void test_mc_frames_wraparound(void){
+   printf("[TEST] MC interleaved frames and wraparound ... \n");
+   const int nch = 3;
+   const int cap = 5;
+   mc_ring_buffer *rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb && mc_ring_buffer_init(rb, nch, cap));
+
+   float in[8 * 3];
+   float out[8 * 3];
+   int next_write = 0;
+   int next_read = 0;
+   for (int round = 0; round < 6; round++){
+      // write 3 frames, read 3, so the window moves around the ring
+      fill_frames(in, next_write, 3, nch);
+      assert(mc_ring_buffer_write_frames(rb, in, 3) == 3);
+      next_write += 3;
+      assert(mc_ring_buffer_num_frames(rb) == 3);
+      assert(mc_ring_buffer_read_frames(rb, out, 8) == 3);
+      for (int f = 0; f < 3; f++){
+         for (int c = 0; c < nch; c++){
+            ASSERT_FLOAT_EQ(out[f * nch + c], sample_value(next_read + f, c));
+         }
+      }
+      next_read += 3;
+   }
+
+   // full: only whole frames that fit are written
+   fill_frames(in, 0, 8, nch);
+   assert(mc_ring_buffer_write_frames(rb, in, 8) == cap);
+   assert(mc_ring_buffer_num_frames(rb) == cap);
+   assert(mc_ring_buffer_write_frames(rb, in, 1) == 0);
+   assert(mc_ring_buffer_read_frames(rb, out, 8) == cap);
+   assert(mc_ring_buffer_read_frames(rb, out, 1) == 0);
+   MC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Reads frames that wrap around the storage into one array per channel.
+ *
+ * returns void
+*/
+void test_mc_read_planar(void){
+   printf("[TEST] MC planar read ... \n");
+   const int nch = 4;
+   const int cap = 6;
+   mc_ring_buffer *rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb && mc_ring_buffer_init(rb, nch, cap));
+
+   float in[6 * 4];
+   float scratch[6 * 4];
+   float planar[4][6];
+   float *channels[4] = { planar[0], planar[1], planar[2], planar[3] };
+
+   // move the window 4 frames in so the next 6 frames wrap
+   fill_frames(in, 0, 4, nch);
+   assert(mc_ring_buffer_write_frames(rb, in, 4) == 4);
+   assert(mc_ring_buffer_read_frames(rb, scratch, 4) == 4);
+
+   fill_frames(in, 10, 6, nch);
+   assert(mc_ring_buffer_write_frames(rb, in, 6) == 6);
+   assert(mc_ring_buffer_read_planar(rb, channels, 6) == 6);
+   for (int c = 0; c < nch; c++){
+      for (int f = 0; f < 6; f++){
+         ASSERT_FLOAT_EQ(planar[c][f], sample_value(10 + f, c));
+      }
+   }
+   assert(mc_ring_buffer_num_frames(rb) == 0);
+   assert(mc_ring_buffer_read_planar(rb, channels, 6) == 0);
+   MC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Peeks a window that wraps and walks each channel through its strided spans.
+ * Then checks reserve/commit of frames written in place.
+ *
+ * returns void
+*/
+void test_mc_views(void){
+   printf("[TEST] MC peek views and reserve/commit ... \n");
+   const int nch = 3;
+   const int cap = 8;
+   mc_ring_buffer *rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb && mc_ring_buffer_init(rb, nch, cap));
+
+   float in[8 * 3];
+   float scratch[8 * 3];
+   fill_frames(in, 0, 5, nch);
+   assert(mc_ring_buffer_write_frames(rb, in, 5) == 5);
+   assert(mc_ring_buffer_read_frames(rb, scratch, 5) == 5);
+
+   // reserve 7 frames: 3 up to the end of the storage, 4 from the start
+   mc_ring_buffer_view view;
+   assert(mc_ring_buffer_reserve(rb, 7, &view) == 7);
+   assert(view.num_channels == nch);
+   assert(view.spans[0].num_frames == 3);
+   assert(view.spans[1].num_frames == 4);
+   int frame = 100;
+   for (int s = 0; s < 2; s++){
+      for (int f = 0; f < view.spans[s].num_frames; f++, frame++){
+         for (int c = 0; c < nch; c++){
+            view.spans[s].frames[f * nch + c] = sample_value(frame, c);
+         }
+      }
+   }
+   assert(mc_ring_buffer_commit(rb, 7) == true);
+   assert(mc_ring_buffer_commit(rb, 2) == false); // only 1 frame free
+   assert(mc_ring_buffer_num_frames(rb) == 7);
+
+   // peek and read each channel through its strided view
+   assert(mc_ring_buffer_peek(rb, 8, &view) == 7);
+   for (int c = 0; c < nch; c++){
+      frame = 100;
+      for (int s = 0; s < 2; s++){
+         mc_channel_span ch = mc_ring_buffer_channel(&view, s, c);
+         assert(ch.stride == nch);
+         assert(ch.len == view.spans[s].num_frames);
+         for (int i = 0; i < ch.len; i++, frame++){
+            ASSERT_FLOAT_EQ(ch.ptr[i * ch.stride], sample_value(frame, c));
+         }
+      }
+      assert(frame == 107);
+   }
+   assert(mc_ring_buffer_release(rb, 8) == false);
+   assert(mc_ring_buffer_release(rb, 7) == true);
+   assert(mc_ring_buffer_num_frames(rb) == 0);
+   MC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * In overwrite mode a write to a full buffer drops the oldest whole frames,
+ * also when one write is larger than the capacity.
+ *
+ * returns void
+*/
+void test_mc_overwrite(void){
+   printf("[TEST] MC overwrite drops whole frames ... \n");
+   const int nch = 2;
+   const int cap = 4;
+   mc_ring_buffer *rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb && mc_ring_buffer_init(rb, nch, cap));
+   assert(mc_ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_OVERWRITE, 0));
+
+   float in[10 * 2];
+   float out[10 * 2];
+   fill_frames(in, 0, 3, nch);
+   assert(mc_ring_buffer_write_frames(rb, in, 3) == 3);
+   fill_frames(in, 3, 3, nch);
+   assert(mc_ring_buffer_write_frames(rb, in, 3) == 3);
+   assert(mc_ring_buffer_num_frames(rb) == cap);
+   assert(spsc_ring_buffer_num_overwritten(rb->ring) == 2 * (uint64_t)nch);
+
+   // frames 2..5 are left, each complete
+   assert(mc_ring_buffer_read_frames(rb, out, 10) == cap);
+   for (int f = 0; f < cap; f++){
+      for (int c = 0; c < nch; c++){
+         ASSERT_FLOAT_EQ(out[f * nch + c], sample_value(2 + f, c));
+      }
+   }
+
+   // one write larger than the buffer keeps the newest frames
+   fill_frames(in, 20, 10, nch);
+   assert(mc_ring_buffer_write_frames(rb, in, 10) == cap);
+   assert(mc_ring_buffer_read_frames(rb, out, 10) == cap);
+   for (int f = 0; f < cap; f++){
+      ASSERT_FLOAT_EQ(out[f * nch], sample_value(26 + f, 0));
+   }
+   MC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * An int16 ring stores the codes written and converts them to code * scale
+ * on read, interleaved and planar, also when the read crosses the wrap and
+ * after overwrite dropped frames. The float-only calls get nothing.
+ *
+ * returns void
+*/
+void test_mc_i16(void){
+   printf("[TEST] MC int16 codes converted on read ... \n");
+   const int nch = 3;
+   const int cap = 5;
+   const float scale = 5.0f / 1023.0f;
+   mc_ring_buffer *rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb);
+   assert(mc_ring_buffer_init_i16(rb, 0, cap, scale) == false);
+   assert(mc_ring_buffer_init_i16(rb, nch, cap, scale));
+   assert(rb->sample_type == MC_SAMPLE_I16);
+
+   int16_t codes[8 * 3];
+   for (int i = 0; i < 8 * nch; i++) codes[i] = (int16_t)(i * 37 - 300);
+   float frames[8 * 3];
+   mc_ring_buffer_view view;
+   assert(mc_ring_buffer_write_frames(rb, frames, 1) == 0);
+   assert(mc_ring_buffer_reserve(rb, 1, &view) == 0);
+
+   // 3 frames in, 2 out, 4 in: the last read crosses the wrap
+   assert(mc_ring_buffer_write_codes(rb, codes, 3) == 3);
+   assert(mc_ring_buffer_peek(rb, 1, &view) == 0);
+   assert(mc_ring_buffer_read_frames(rb, frames, 2) == 2);
+   for (int i = 0; i < 2 * nch; i++) ASSERT_FLOAT_EQ(frames[i], codes[i] * scale);
+   assert(mc_ring_buffer_write_codes(rb, codes + 3 * nch, 4) == 4);
+   assert(mc_ring_buffer_write_codes(rb, codes, 1) == 0);
+
+   float planar[3][8];
+   float *channels[3] = { planar[0], planar[1], planar[2] };
+   assert(mc_ring_buffer_read_planar(rb, channels, 8) == cap);
+   for (int f = 0; f < cap; f++){
+      for (int c = 0; c < nch; c++) ASSERT_FLOAT_EQ(planar[c][f], codes[(2 + f) * nch + c] * scale);
+   }
+   assert(mc_ring_buffer_num_frames(rb) == 0);
+
+   // overwrite keeps the newest whole frames of the codes
+   assert(mc_ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_OVERWRITE, 0));
+   assert(mc_ring_buffer_write_codes(rb, codes, 8) == cap);
+   assert(mc_ring_buffer_read_frames(rb, frames, 8) == cap);
+   for (int i = 0; i < cap * nch; i++) ASSERT_FLOAT_EQ(frames[i], codes[3 * nch + i] * scale);
+   MC_SAFE_DESTROY(rb);
+
+   // a float ring refuses codes
+   rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb && mc_ring_buffer_init(rb, nch, cap));
+   assert(mc_ring_buffer_write_codes(rb, codes, 1) == 0);
+   MC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+// producer: writes NUM_FRAMES frames in blocks of BLOCK_FRAMES
+static void *mc_producer(void *arg){
+   mc_ring_buffer *rb = (mc_ring_buffer *)arg;
+   float block[BLOCK_FRAMES * NUM_CHANNELS];
+   int next = 0;
+   while (next < NUM_FRAMES){
+      int n = NUM_FRAMES - next;
+      if (n > BLOCK_FRAMES) n = BLOCK_FRAMES;
+      fill_frames(block, next, n, NUM_CHANNELS);
+      int written = 0;
+      while (written < n){
+         int w = mc_ring_buffer_write_frames(rb, block + written * NUM_CHANNELS, n - written);
+         if (w == 0) sched_yield();
+         written += w;
+      }
+      next += n;
+   }
+   return NULL;
+}
+
+/**
+ * One producer thread and one consumer thread stream NUM_FRAMES 19 channel
+ * frames. The consumer reads planar and checks every channel of every frame.
+ *
+ * returns void
+*/
+void test_mc_two_threads(void){
+   printf("[TEST] MC producer/consumer threads, %d channels ... \n", NUM_CHANNELS);
+   mc_ring_buffer *rb = malloc(sizeof(mc_ring_buffer));
+   assert(rb && mc_ring_buffer_init(rb, NUM_CHANNELS, FRAME_CAPACITY));
+
+   pthread_t producer;
+   assert(pthread_create(&producer, NULL, mc_producer, rb) == 0);
+
+   static float planar[NUM_CHANNELS][FRAME_CAPACITY];
+   float *channels[NUM_CHANNELS];
+   for (int c = 0; c < NUM_CHANNELS; c++) channels[c] = planar[c];
+
+   int next = 0;
+   while (next < NUM_FRAMES){
+      int n = mc_ring_buffer_read_planar(rb, channels, FRAME_CAPACITY);
+      if (n == 0){
+         sched_yield();
+         continue;
+      }
+      for (int f = 0; f < n; f++, next++){
+         for (int c = 0; c < NUM_CHANNELS; c++){
+            ASSERT_FLOAT_EQ(planar[c][f], sample_value(next, c));
+         }
+      }
+   }
+   assert(pthread_join(producer, NULL) == 0);
+   assert(mc_ring_buffer_num_frames(rb) == 0);
+   MC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+int main(){
+   test_mc_init();
+   test_mc_frames_wraparound();
+   test_mc_read_planar();
+   test_mc_views();
+   test_mc_overwrite();
+   test_mc_i16();
+   test_mc_two_threads();
+   return 0;
+}
@@ -0,0 +1,742 @@
+/**
+ * @file spsc_test_ring_buffer.c
+ * @brief Unit and cross-thread tests for the spsc_ring_buffer library.
+ *
+ * This file contains tests for the lock-free single-producer/single-consumer
+ * ring buffer, including:
+ * - Initialization and invalid capacity
+ * - Read/write operations, empty and full state detection
+ * - Index wraparound over the full [0, 2*capacity) range
+ * - Bulk read/write split around the wrap point
+ * - In-place reserve/commit and peek/release spans
+ * - Mirrored storage: windows that wrap are a single span
+ * - Power-of-two capacity with free-running counters, including the 2^32 wrap
+ * - int16 rings: bulk read/write and peek spans around the wrap point; float
+ *   calls on an int16 ring and int16 calls on a float ring are refused
+ * - Overflow policies: reject, overwrite oldest and block with timeout, single
+ *   threaded and with a slow consumer thread
+ * - One producer thread and one consumer thread streaming 1M values,
+ *   checking that every value arrives exactly once and in order
+ *   (scalar and bulk paths)
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "spsc_ring_buffer.h"
+#include "vm_mirror.h"
+#include "test_helpers.h"
+
+#define BUFFER_CAPACITY 1000
+#define NUM_WRITES 1000000
+
+/**
+ * Tests that false is returned if a ring buffer is initialized
+ * with a capacity <= 0, and that a valid buffer starts empty.
+ *
+ * returns void
+*/
+void test_spsc_init(void){
+   printf("[TEST] SPSC initialization ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, 0) == false);
+   assert(spsc_ring_buffer_init(rb, -1) == false);
+   assert(spsc_ring_buffer_init(rb, 4) == true);
+   assert(rb->max_num_values == 4);
+   assert(atomic_load(&rb->head) == 0);
+   assert(atomic_load(&rb->tail) == 0);
+   assert(spsc_ring_buffer_empty(rb) == true);
+   assert(spsc_ring_buffer_full(rb) == false);
+   assert(spsc_ring_buffer_size(rb) == 0);
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Tests that head and tail live on different cache lines.
+ *
+ * returns void
+*/
+void test_spsc_layout(void){
+   printf("[TEST] SPSC head/tail cache line separation ... \n");
+   spsc_ring_buffer rb;
+   char *head = (char *)&rb.head;
+   char *tail = (char *)&rb.tail;
+   assert(tail - head >= RB_CACHE_LINE_SIZE);
+   printf("OK\n");
+}
+
+/**
+ * Writes until full, reads until empty, three times in a row, so head
+ * and tail pass through both halves of the [0, 2*capacity) index range.
+ *
+ * returns void
+*/
+void test_spsc_fill_drain_wraparound(void){
+   printf("[TEST] SPSC fill/drain wraparound ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, 4));
+
+   float value;
+   for (int round = 0; round < 3; round++){
+      for (int i = 0; i < 4; i++){
+         assert(spsc_ring_buffer_write(rb, (float)(round*10 + i)));
+         assert(spsc_ring_buffer_size(rb) == i + 1);
+      }
+      assert(spsc_ring_buffer_full(rb));
+      assert(spsc_ring_buffer_write(rb, 99.0f) == false);
+
+      for (int i = 0; i < 4; i++){
+         assert(spsc_ring_buffer_read(rb, &value));
+         ASSERT_FLOAT_EQ(value, (float)(round*10 + i));
+      }
+      assert(spsc_ring_buffer_empty(rb));
+      assert(spsc_ring_buffer_read(rb, &value) == false);
+   }
+   // 12 writes on capacity 4 -> indices wrapped at 2*capacity = 8
+   assert(atomic_load(&rb->head) == 4);
+   assert(atomic_load(&rb->tail) == 4);
+
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Tests alternating partial fills so head and tail are never equal
+ * while the buffer holds data. Read values are checked for correctness.
+ *
+ * returns void
+*/
+void test_spsc_partial_rw(void){
+   printf("[TEST] SPSC partial read/write ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, 3));
+
+   int next_write = 0;
+   int next_read = 0;
+   float value;
+   for (int i = 0; i < 1000; i++){
+      // write two, read one, drain whenever full
+      for (int w = 0; w < 2; w++){
+         if (spsc_ring_buffer_write(rb, (float)next_write)) next_write++;
+      }
+      assert(spsc_ring_buffer_read(rb, &value));
+      ASSERT_FLOAT_EQ(value, (float)next_read);
+      next_read++;
+      if (spsc_ring_buffer_full(rb)){
+         while (spsc_ring_buffer_read(rb, &value)){
+            ASSERT_FLOAT_EQ(value, (float)next_read);
+            next_read++;
+         }
+      }
+      assert(spsc_ring_buffer_size(rb) == next_write - next_read);
+   }
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Tests bulk writes and reads that are split around the end of the
+ * storage, and that bulk and scalar calls share the same indices.
+ *
+ * returns void
+*/
+void test_spsc_bulk_rw(void){
+   printf("[TEST] SPSC bulk read/write ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, 5));
+
+   float in[7] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+   float out[7];
+   assert(spsc_ring_buffer_write_n(rb, in, 7) == 5);
+   assert(spsc_ring_buffer_write_n(rb, in, 1) == 0);
+   assert(spsc_ring_buffer_read_n(rb, out, 3) == 3);
+   ASSERT_FLOAT_EQ(out[2], 3.0f);
+   assert(spsc_ring_buffer_write_n(rb, in + 4, 3) == 3);
+   assert(spsc_ring_buffer_full(rb));
+   assert(spsc_ring_buffer_read_n(rb, out, 7) == 5);
+   ASSERT_FLOAT_EQ(out[0], 4.0f);
+   ASSERT_FLOAT_EQ(out[1], 5.0f);
+   ASSERT_FLOAT_EQ(out[2], 5.0f);
+   ASSERT_FLOAT_EQ(out[3], 6.0f);
+   ASSERT_FLOAT_EQ(out[4], 7.0f);
+   assert(spsc_ring_buffer_read_n(rb, out, 1) == 0);
+
+   float value;
+   assert(spsc_ring_buffer_write(rb, 8.0f));
+   assert(spsc_ring_buffer_write_n(rb, in, 2) == 2);
+   assert(spsc_ring_buffer_read(rb, &value));
+   ASSERT_FLOAT_EQ(value, 8.0f);
+   assert(spsc_ring_buffer_read_n(rb, out, 2) == 2);
+   ASSERT_FLOAT_EQ(out[1], 2.0f);
+   assert(spsc_ring_buffer_empty(rb));
+
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Tests reserve/commit and peek/release, including windows that wrap.
+ *
+ * returns void
+*/
+void test_spsc_spans(void){
+   printf("[TEST] SPSC reserve/commit and peek/release spans ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, 5));
+   ring_buffer_span spans[2];
+
+   assert(spsc_ring_buffer_reserve(rb, 3, spans) == 3);
+   assert(spans[0].ptr == rb->buffer && spans[0].len == 3 && spans[1].len == 0);
+   for (int i = 0; i < 3; i++) spans[0].ptr[i] = (float)(i + 1);
+   assert(spsc_ring_buffer_empty(rb));
+   assert(spsc_ring_buffer_commit(rb, 3));
+   assert(spsc_ring_buffer_size(rb) == 3);
+
+   assert(spsc_ring_buffer_peek(rb, 2, spans) == 2);
+   ASSERT_FLOAT_EQ(spans[0].ptr[1], 2.0f);
+   assert(spsc_ring_buffer_release(rb, 2));
+
+   assert(spsc_ring_buffer_reserve(rb, 10, spans) == 4);
+   assert(spans[0].ptr == rb->buffer + 3 && spans[0].len == 2);
+   assert(spans[1].ptr == rb->buffer && spans[1].len == 2);
+   spans[0].ptr[0] = 4.0f; spans[0].ptr[1] = 5.0f;
+   spans[1].ptr[0] = 6.0f; spans[1].ptr[1] = 7.0f;
+   assert(spsc_ring_buffer_commit(rb, 5) == false);
+   assert(spsc_ring_buffer_commit(rb, 4));
+   assert(spsc_ring_buffer_full(rb));
+
+   assert(spsc_ring_buffer_peek(rb, 10, spans) == 5);
+   assert(spans[0].len == 3 && spans[1].len == 2);
+   ASSERT_FLOAT_EQ(spans[0].ptr[0], 3.0f);
+   ASSERT_FLOAT_EQ(spans[1].ptr[1], 7.0f);
+   assert(spsc_ring_buffer_release(rb, 6) == false);
+   assert(spsc_ring_buffer_release(rb, 5));
+   assert(spsc_ring_buffer_empty(rb));
+
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Tests that a mirrored buffer hands out wrapped windows as one span.
+ *
+ * returns void
+*/
+void test_spsc_mirrored(void){
+   printf("[TEST] SPSC mirrored storage ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init_mirrored(rb, -5) == false);
+   assert(spsc_ring_buffer_init_mirrored(rb, 1000));
+   int cap = rb->max_num_values;
+   assert(cap >= 1000);
+   assert((cap * sizeof(float)) % vm_mirror_page_size() == 0);
+
+   // advance both indices to 10 values before the end of the storage
+   float dummy[64];
+   for (int done = 0; done < cap - 10; ){
+      int n = cap - 10 - done < 64 ? cap - 10 - done : 64;
+      assert(spsc_ring_buffer_write_n(rb, dummy, n) == n);
+      assert(spsc_ring_buffer_read_n(rb, dummy, n) == n);
+      done += n;
+   }
+
+   ring_buffer_span spans[2];
+   assert(spsc_ring_buffer_reserve(rb, 20, spans) == 20);
+   assert(spans[0].len == 20 && spans[1].len == 0);
+   for (int i = 0; i < 20; i++) spans[0].ptr[i] = (float)i;
+   assert(spsc_ring_buffer_commit(rb, 20));
+
+   assert(spsc_ring_buffer_peek(rb, 20, spans) == 20);
+   assert(spans[0].ptr == rb->buffer + cap - 10 && spans[0].len == 20);
+   ASSERT_FLOAT_EQ(spans[0].ptr[15], 15.0f);
+   ASSERT_FLOAT_EQ(rb->buffer[5], 15.0f);
+   assert(spsc_ring_buffer_release(rb, 20));
+   assert(spsc_ring_buffer_empty(rb));
+
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Tests free-running counters of a power-of-two buffer, starting just
+ * below UINT_MAX so the counters overflow while the buffer holds data.
+ *
+ * returns void
+*/
+void test_spsc_pow2(void){
+   printf("[TEST] SPSC power-of-two free-running counters ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init_pow2(rb, 12) == false);
+   assert(spsc_ring_buffer_init_pow2(rb, 8));
+   assert(rb->pow2 && rb->index_mask == 7);
+
+   // pretend 2^32 - 3 values already went through the buffer
+   unsigned int start = 0xFFFFFFFDu;
+   atomic_store(&rb->head, start);
+   atomic_store(&rb->tail, start);
+   rb->head_cache = start;
+   rb->tail_cache = start;
+   assert(spsc_ring_buffer_empty(rb));
+
+   float in[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+   float out[8];
+   assert(spsc_ring_buffer_write_n(rb, in, 8) == 8);
+   assert(spsc_ring_buffer_full(rb));
+   assert(spsc_ring_buffer_write(rb, 8.0f) == false);
+   assert(atomic_load(&rb->tail) == start + 8u); // wrapped past zero
+   assert(atomic_load(&rb->tail) == 5);
+   assert(spsc_ring_buffer_size(rb) == 8);
+
+   ring_buffer_span spans[2];
+   assert(spsc_ring_buffer_peek(rb, 8, spans) == 8);
+   assert(spans[0].ptr == rb->buffer + (start & 7) && spans[0].len == 3);
+   assert(spans[1].len == 5);
+   assert(spsc_ring_buffer_read_n(rb, out, 8) == 8);
+   for (int i = 0; i < 8; i++) ASSERT_FLOAT_EQ(out[i], in[i]);
+   assert(spsc_ring_buffer_empty(rb));
+
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * An int16 ring moves int16 values in and out around the wrap point, and
+ * its peek spans point into the int16 storage.
+ *
+ * returns void
+*/
+void test_spsc_i16(void){
+   printf("[TEST] SPSC int16 values ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init_i16(rb, 0) == false);
+   assert(spsc_ring_buffer_init_i16(rb, 6));
+   assert(rb->value_size == sizeof(int16_t));
+
+   int16_t in[6] = { -32768, -1, 0, 1, 1023, 32767 };
+   int16_t out[6];
+   assert(spsc_ring_buffer_write_n_i16(rb, in, 4) == 4);
+   assert(spsc_ring_buffer_read_n_i16(rb, out, 3) == 3);
+   for (int i = 0; i < 3; i++) assert(out[i] == in[i]);
+
+   // 1 left at slot 3, 5 more fill the buffer across the wrap point
+   assert(spsc_ring_buffer_write_n_i16(rb, in, 6) == 5);
+   assert(spsc_ring_buffer_full(rb));
+   ring_buffer_span_i16 spans[2];
+   assert(spsc_ring_buffer_peek_i16(rb, 6, spans) == 6);
+   assert(spans[0].ptr == rb->codes + 3 && spans[0].len == 3);
+   assert(spans[1].ptr == rb->codes && spans[1].len == 3);
+   assert(spans[0].ptr[0] == in[3] && spans[0].ptr[1] == in[0] && spans[1].ptr[2] == in[4]);
+   assert(spsc_ring_buffer_release(rb, 6));
+   assert(spsc_ring_buffer_empty(rb));
+
+   assert(spsc_ring_buffer_write_n_i16(rb, in, 6) == 6);
+   assert(spsc_ring_buffer_read_n_i16(rb, out, 6) == 6);
+   for (int i = 0; i < 6; i++) assert(out[i] == in[i]);
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Typed calls on a ring of the other value type do nothing: no value is
+ * written or read, spans are empty, and the ring is unchanged.
+ *
+ * returns void
+*/
+void test_spsc_type_mismatch(void){
+   printf("[TEST] SPSC refuses the other value type ... \n");
+   spsc_ring_buffer *codes = malloc(sizeof(spsc_ring_buffer));
+   spsc_ring_buffer *floats = malloc(sizeof(spsc_ring_buffer));
+   assert(codes && floats);
+   assert(spsc_ring_buffer_init_i16(codes, 8));
+   assert(spsc_ring_buffer_init(floats, 8));
+
+   float32_t f[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+   int16_t c[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+   ring_buffer_span spans[2];
+   ring_buffer_span_i16 spans_i16[2];
+   float32_t value;
+   assert(spsc_ring_buffer_write(codes, 1.0f) == false);
+   assert(spsc_ring_buffer_write_n(codes, f, 8) == 0);
+   assert(spsc_ring_buffer_reserve(codes, 8, spans) == 0);
+   assert(spans[0].len == 0 && spans[1].len == 0 && spans[0].ptr == NULL);
+   assert(spsc_ring_buffer_empty(codes));
+   // with values stored the float reads still see nothing
+   assert(spsc_ring_buffer_write_n_i16(codes, c, 8) == 8);
+   assert(spsc_ring_buffer_read(codes, &value) == false);
+   assert(spsc_ring_buffer_read_n(codes, f, 8) == 0);
+   assert(spsc_ring_buffer_peek(codes, 8, spans) == 0 && spans[0].len == 0);
+   assert(spsc_ring_buffer_size(codes) == 8);
+
+   assert(spsc_ring_buffer_write_n_i16(floats, c, 8) == 0);
+   assert(spsc_ring_buffer_empty(floats));
+   assert(spsc_ring_buffer_write_n(floats, f, 8) == 8);
+   assert(spsc_ring_buffer_read_n_i16(floats, c, 8) == 0);
+   assert(spsc_ring_buffer_peek_i16(floats, 8, spans_i16) == 0 && spans_i16[0].len == 0);
+   assert(spsc_ring_buffer_size(floats) == 8);
+
+   SPSC_SAFE_DESTROY(codes);
+   SPSC_SAFE_DESTROY(floats);
+   printf("OK\n");
+}
+
+/**
+ * Tests reject, overwrite and block policies from a single thread,
+ * including the drop counters.
+ *
+ * returns void
+*/
+void test_spsc_overflow_policy(void){
+   printf("[TEST] SPSC overflow policies and drop counters ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, 4));
+   assert(rb->overflow_policy == RB_OVERFLOW_REJECT);
+   assert(spsc_ring_buffer_set_overflow_policy(rb, (ring_buffer_overflow_policy)42, 0) == false);
+
+   float in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+   float out[10];
+   float value;
+
+   // reject
+   assert(spsc_ring_buffer_write_n(rb, in, 4) == 4);
+   assert(spsc_ring_buffer_write(rb, 4.0f) == false);
+   assert(spsc_ring_buffer_write_n(rb, in, 2) == 0);
+   assert(spsc_ring_buffer_num_rejected(rb) == 3);
+
+   // overwrite
+   assert(spsc_ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_OVERWRITE, 0));
+   assert(spsc_ring_buffer_write(rb, 4.0f));
+   assert(spsc_ring_buffer_write_n(rb, in + 5, 2) == 2);
+   assert(spsc_ring_buffer_num_overwritten(rb) == 3);
+   assert(spsc_ring_buffer_read(rb, &value));
+   ASSERT_FLOAT_EQ(value, 3.0f);
+   assert(spsc_ring_buffer_read_n(rb, out, 10) == 3);
+   ASSERT_FLOAT_EQ(out[0], 4.0f);
+   ASSERT_FLOAT_EQ(out[2], 6.0f);
+   assert(spsc_ring_buffer_write_n(rb, in, 10) == 4);
+   assert(spsc_ring_buffer_num_overwritten(rb) == 3 + 6);
+   assert(spsc_ring_buffer_read_n(rb, out, 10) == 4);
+   ASSERT_FLOAT_EQ(out[0], 6.0f);
+   ASSERT_FLOAT_EQ(out[3], 9.0f);
+
+   // a window dropped between peek and release is reported
+   ring_buffer_span spans[2];
+   assert(spsc_ring_buffer_write_n(rb, in, 4) == 4);
+   assert(spsc_ring_buffer_peek(rb, 2, spans) == 2);
+   assert(spsc_ring_buffer_write(rb, 4.0f)); // drops value 0
+   assert(spsc_ring_buffer_release(rb, 2) == false);
+   assert(spsc_ring_buffer_peek(rb, 2, spans) == 2);
+   ASSERT_FLOAT_EQ(spans[0].ptr[0], 1.0f);
+   assert(spsc_ring_buffer_release(rb, 2));
+   assert(spsc_ring_buffer_size(rb) == 2);
+
+   // reserve drops at once: abandoning it does not bring value 3 back
+   uint64_t overwritten = spsc_ring_buffer_num_overwritten(rb);
+   assert(spsc_ring_buffer_reserve(rb, 3, spans) == 3);
+   assert(spsc_ring_buffer_num_overwritten(rb) == overwritten + 1);
+   assert(spsc_ring_buffer_size(rb) == 1);
+   assert(spsc_ring_buffer_read(rb, &value));
+   ASSERT_FLOAT_EQ(value, 4.0f);
+   assert(spsc_ring_buffer_write_n(rb, in, 2) == 2);
+
+   // block with timeout: waits about 2 ms, then rejects
+   assert(spsc_ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_BLOCK, 2000));
+   assert(spsc_ring_buffer_write_n(rb, in, 2) == 2);
+   uint64_t rejected = spsc_ring_buffer_num_rejected(rb);
+   struct timespec t0, t1;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   assert(spsc_ring_buffer_write(rb, 1.0f) == false);
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   double waited_us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) * 1e-3;
+   assert(waited_us >= 2000.0);
+   assert(spsc_ring_buffer_num_rejected(rb) == rejected + 1);
+
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Producer thread: writes 0 .. NUM_WRITES-1 straight into reserved
+ * spans, up to 64 values at a time.
+ */
+static void *spsc_span_producer(void *arg){
+   spsc_ring_buffer *rb = arg;
+   ring_buffer_span spans[2];
+   int next = 0;
+   while (next < NUM_WRITES){
+      int want = NUM_WRITES - next < 64 ? NUM_WRITES - next : 64;
+      int n = spsc_ring_buffer_reserve(rb, want, spans);
+      if (n == 0){
+         sched_yield();
+         continue;
+      }
+      for (int s = 0; s < 2; s++){
+         for (int i = 0; i < spans[s].len; i++){
+            spans[s].ptr[i] = (float)(next++);
+         }
+      }
+      assert(spsc_ring_buffer_commit(rb, n));
+   }
+   return NULL;
+}
+
+/**
+ * Producer thread: writes 0 .. NUM_WRITES-1, yielding whenever full.
+ */
+static void *spsc_producer(void *arg){
+   spsc_ring_buffer *rb = arg;
+   for (int i = 0; i < NUM_WRITES; i++){
+      while (!spsc_ring_buffer_write(rb, (float)i)){
+         sched_yield();
+      }
+   }
+   return NULL;
+}
+
+/**
+ * Producer thread: writes 0 .. NUM_WRITES-1 in blocks of 97 values,
+ * so blocks straddle the wrap point and are often only partially accepted.
+ */
+static void *spsc_bulk_producer(void *arg){
+   spsc_ring_buffer *rb = arg;
+   float block[97];
+   int next = 0;
+   while (next < NUM_WRITES){
+      int n = NUM_WRITES - next < 97 ? NUM_WRITES - next : 97;
+      for (int i = 0; i < n; i++) block[i] = (float)(next + i);
+      int written = 0;
+      while (written < n){
+         int w = spsc_ring_buffer_write_n(rb, block + written, n - written);
+         if (w == 0) sched_yield();
+         written += w;
+      }
+      next += n;
+   }
+   return NULL;
+}
+
+/**
+ * Streams NUM_WRITES values from a producer thread to the consumer
+ * (this thread) through a small buffer so both full and empty
+ * conditions are hit many times. Every value must arrive in order.
+ *
+ * returns void
+*/
+void test_spsc_two_threads(void){
+   printf("[TEST] SPSC producer/consumer threads ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, BUFFER_CAPACITY));
+
+   pthread_t producer;
+   assert(pthread_create(&producer, NULL, spsc_producer, rb) == 0);
+
+   float value;
+   int empty_polls = 0;
+   for (int i = 0; i < NUM_WRITES; i++){
+      while (!spsc_ring_buffer_read(rb, &value)){
+         empty_polls++;
+         sched_yield();
+      }
+      // floats are exact for integers below 2^24
+      assert(value == (float)i);
+   }
+   assert(pthread_join(producer, NULL) == 0);
+   assert(spsc_ring_buffer_empty(rb));
+
+   printf("    Values streamed: %d\n", NUM_WRITES);
+   printf("    Empty polls    : %d\n", empty_polls);
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Same as test_spsc_two_threads() but both sides move blocks with
+ * spsc_ring_buffer_write_n()/spsc_ring_buffer_read_n().
+ *
+ * returns void
+*/
+void test_spsc_two_threads_bulk(void){
+   printf("[TEST] SPSC bulk producer/consumer threads ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, BUFFER_CAPACITY));
+
+   pthread_t producer;
+   assert(pthread_create(&producer, NULL, spsc_bulk_producer, rb) == 0);
+
+   float block[256];
+   int next = 0;
+   while (next < NUM_WRITES){
+      int n = spsc_ring_buffer_read_n(rb, block, 256);
+      if (n == 0) sched_yield();
+      for (int i = 0; i < n; i++){
+         assert(block[i] == (float)(next + i));
+      }
+      next += n;
+   }
+   assert(pthread_join(producer, NULL) == 0);
+   assert(spsc_ring_buffer_empty(rb));
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Streams NUM_WRITES values with reserve/commit on the producer and
+ * peek/release on the consumer, no copies on either side.
+ *
+ * returns void
+*/
+void test_spsc_two_threads_spans(void){
+   printf("[TEST] SPSC in-place producer/consumer threads ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, BUFFER_CAPACITY));
+
+   pthread_t producer;
+   assert(pthread_create(&producer, NULL, spsc_span_producer, rb) == 0);
+
+   ring_buffer_span spans[2];
+   int next = 0;
+   while (next < NUM_WRITES){
+      int n = spsc_ring_buffer_peek(rb, 256, spans);
+      if (n == 0){
+         sched_yield();
+         continue;
+      }
+      for (int s = 0; s < 2; s++){
+         for (int i = 0; i < spans[s].len; i++){
+            assert(spans[s].ptr[i] == (float)(next++));
+         }
+      }
+      assert(spsc_ring_buffer_release(rb, n));
+   }
+   assert(pthread_join(producer, NULL) == 0);
+   assert(spsc_ring_buffer_empty(rb));
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Producer thread for the policy tests: writes 0 .. NUM_WRITES-1 once,
+ * in blocks of 32, without retrying. The policy decides what happens.
+ */
+static void *spsc_policy_producer(void *arg){
+   spsc_ring_buffer *rb = arg;
+   float block[32];
+   for (int next = 0; next < NUM_WRITES; next += 32){
+      for (int i = 0; i < 32; i++) block[i] = (float)(next + i);
+      spsc_ring_buffer_write_n(rb, block, 32);
+   }
+   return NULL;
+}
+
+/**
+ * Runs spsc_policy_producer against a consumer that is slower than the
+ * producer (it sleeps every 1000 values). Checks that values arrive
+ * strictly increasing and that every value was either read or counted
+ * as dropped.
+ *
+ * returns number of values the consumer read
+*/
+static int run_slow_consumer(spsc_ring_buffer *rb){
+   pthread_t producer;
+   assert(pthread_create(&producer, NULL, spsc_policy_producer, rb) == 0);
+
+   float value;
+   float last = -1.0f;
+   int num_read = 0;
+   while (last < (float)(NUM_WRITES - 1)){
+      if (!spsc_ring_buffer_read(rb, &value)){
+         sched_yield();
+         continue;
+      }
+      assert(value > last);
+      last = value;
+      if (++num_read % 1000 == 0) usleep(10);
+   }
+   assert(pthread_join(producer, NULL) == 0);
+   while (spsc_ring_buffer_read(rb, &value)) num_read++;
+
+   uint64_t dropped = spsc_ring_buffer_num_overwritten(rb) + spsc_ring_buffer_num_rejected(rb);
+   assert((uint64_t)num_read + dropped == NUM_WRITES);
+   return num_read;
+}
+
+/**
+ * Overwrite mode with a slow consumer: data is lost from the old end,
+ * the last value written is always among the values read.
+ *
+ * returns void
+*/
+void test_spsc_overwrite_two_threads(void){
+   printf("[TEST] SPSC overwrite oldest with slow consumer ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, BUFFER_CAPACITY));
+   assert(spsc_ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_OVERWRITE, 0));
+   int num_read = run_slow_consumer(rb);
+   printf("    Values read       : %d\n", num_read);
+   printf("    Values overwritten: %llu\n",
+          (unsigned long long)spsc_ring_buffer_num_overwritten(rb));
+   assert(spsc_ring_buffer_num_rejected(rb) == 0);
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+/**
+ * Block mode without a timeout and a slow consumer: nothing is lost.
+ *
+ * returns void
+*/
+void test_spsc_block_two_threads(void){
+   printf("[TEST] SPSC block with slow consumer ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb);
+   assert(spsc_ring_buffer_init(rb, BUFFER_CAPACITY));
+   assert(spsc_ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_BLOCK, -1));
+   assert(run_slow_consumer(rb) == NUM_WRITES);
+   assert(spsc_ring_buffer_num_overwritten(rb) == 0);
+   assert(spsc_ring_buffer_num_rejected(rb) == 0);
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+int main(){
+   test_spsc_init();
+   test_spsc_layout();
+   test_spsc_fill_drain_wraparound();
+   test_spsc_partial_rw();
+   test_spsc_bulk_rw();
+   test_spsc_spans();
+   test_spsc_mirrored();
+   test_spsc_pow2();
+   test_spsc_i16();
+   test_spsc_type_mismatch();
+   test_spsc_overflow_policy();
+   test_spsc_two_threads();
+   test_spsc_two_threads_bulk();
+   test_spsc_two_threads_spans();
+   test_spsc_overwrite_two_threads();
+   test_spsc_block_two_threads();
+   return 0;
+}
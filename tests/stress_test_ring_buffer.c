@@ -15,6 +15,7 @@
  *    - Backpressure - write faster than reading
  *    - Negative backpressure - read faster than writing
  * - Oscilattion producer/consumer rates
+ * - Bulk (memcpy span) vs scalar read/write throughput
  *
  * Each tests gets its own function which allocates its own ring buffer, runs
  * it's pattern, asserts metrics and frees the buffer. 
@@ -28,12 +29,23 @@
 #include <assert.h>
 #include <math.h>
 #include <unistd.h>
+#include <time.h>
 #include "ring_buffer.h"
 #include "test_helpers.h"
 
 #define BUFFER_CAPACITY 10000
 #define NUM_WRITES 1000000
 #define BURST_SIZE 1000
+#define MAX_FRAME_SIZE 4096
+
+/**
+ * Monotonic wall clock in seconds, used for throughput reports.
+ */
+static double now_seconds(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
 /**
  * void stress_balanced_rw()
@@ -460,6 +472,70 @@ void stress_oscillating_rates(){
 
    printf("OK\n");
 }
+/*
+ * void stress_bulk_throughput()
+ * Moves NUM_WRITES values through the buffer in frames of 256 and 4096
+ * values, like an FFT frame consumer would, once with the scalar
+ * ring_buffer_write/ring_buffer_read path and once with the bulk
+ * ring_buffer_write_n/ring_buffer_read_n path. The buffer capacity is
+ * not a multiple of the frame size so frames are split at the wrap
+ * point. Read values are checked for correctness and the throughput
+ * of both paths is reported.
+ *
+ * input void
+ * returns void
+*/
+void stress_bulk_throughput(){
+   printf("[TEST] Bulk vs scalar throughput ... \n");
+   static float in[MAX_FRAME_SIZE];
+   static float out[MAX_FRAME_SIZE];
+   const int frame_sizes[] = {256, 4096};
+
+   for (size_t f = 0; f < sizeof(frame_sizes)/sizeof(frame_sizes[0]); f++){
+      int frame = frame_sizes[f];
+      int num_frames = NUM_WRITES / frame;
+      double elapsed[2];
+
+      for (int bulk = 0; bulk < 2; bulk++){
+         ring_buffer *rb = malloc(sizeof(ring_buffer));
+         assert(rb);
+         assert(ring_buffer_init(rb, BUFFER_CAPACITY));
+         int next_value = 0;
+         int next_check = 0;
+
+         double start = now_seconds();
+         for (int n = 0; n < num_frames; n++){
+            for (int i = 0; i < frame; i++){
+               in[i] = (float)(next_value++ % 1000000);
+            }
+            if (bulk){
+               assert(ring_buffer_write_n(rb, in, frame) == frame);
+               assert(ring_buffer_read_n(rb, out, frame) == frame);
+            } else {
+               for (int i = 0; i < frame; i++){
+                  assert(ring_buffer_write(rb, in[i]));
+               }
+               for (int i = 0; i < frame; i++){
+                  assert(ring_buffer_read(rb, &out[i]));
+               }
+            }
+            for (int i = 0; i < frame; i++){
+               ASSERT_FLOAT_EQ(out[i], (float)(next_check++ % 1000000));
+            }
+         }
+         elapsed[bulk] = now_seconds() - start;
+         assert(ring_buffer_empty(rb));
+         SAFE_DESTROY(rb);
+      }
+
+      double total = (double)num_frames * frame;
+      printf("    Frame %4d: scalar %7.1f Msamples/s, bulk %7.1f Msamples/s (%.1fx)\n",
+             frame, total / elapsed[0] / 1e6, total / elapsed[1] / 1e6,
+             elapsed[0] / elapsed[1]);
+   }
+   printf("OK\n");
+}
+
 int main(){
    stress_balanced_rw();
    stress_burst_writes();
@@ -469,5 +545,6 @@ int main(){
    stress_backpressure();
    stress_negative_backpressure();
    stress_oscillating_rates();
+   stress_bulk_throughput();
    return 0;
 }
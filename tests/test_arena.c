@@ -0,0 +1,356 @@
+/**
+ * @file test_arena.c
+ * @brief Tests for the startup arena (arena.c) and the buffers placed in it.
+ *
+ * This file contains tests for:
+ * - Alignment, zeroing, exhaustion and the seal: no allocation succeeds
+ *   after arena_seal(), with or without a granted mlock()
+ * - Rings embedded in the caller's memory: ring_buffer and spsc_ring_buffer
+ *   on caller storage, mc_ring_buffer_init_arena() with everything inside
+ *   the region
+ * - A spectral bank and the pipeline stages built in an arena produce the
+ *   same output as their heap versions, and stepping them after the seal
+ *   asks the arena for nothing
+ * - A decimation chain built in an arena: same output as on the heap,
+ *   stages and rings inside the region
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <math.h>
+#include "arena.h"
+#include "ring_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "mc_ring_buffer.h"
+#include "dsp.h"
+#include "pipeline.h"
+#include "pipeline_stages.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 256.0f
+#define NCH 4
+#define FFT 128
+#define HOP 32
+#define BINS (FFT / 2 + 1)
+
+static bool in_arena(const arena *a, const void *p){
+   const uint8_t *b = p;
+   return b >= a->base && b < a->base + a->used;
+}
+
+static void make_frames(float *frames, int first, int n){
+   for (int i = 0; i < n; i++){
+      for (int ch = 0; ch < NCH; ch++){
+         frames[i * NCH + ch] = sinf(2.0f * (float)M_PI * (10.0f + 5.0f * ch) * (first + i) / SAMPLE_RATE);
+      }
+   }
+}
+
+// output stage callback: keeps every PSD frame
+typedef struct {
+   float frames[32][NCH * BINS];
+   int count;
+} psd_capture;
+
+static void capture_psd(const float *psd, int num_channels, int num_bins, void *ctx){
+   psd_capture *c = (psd_capture *)ctx;
+   assert(c->count < 32);
+   memcpy(c->frames[c->count++], psd, sizeof(float) * num_channels * num_bins);
+}
+
+/**
+ * Pieces are cache line aligned, zeroed and in allocation order; a request
+ * that does not fit and any request after the seal return NULL and are
+ * counted. A NULL arena is the heap.
+ *
+ * returns void
+*/
+void test_arena_alloc(void){
+   printf("[TEST] Arena alignment, exhaustion and seal ... \n");
+   arena a;
+   assert(arena_init(&a, 0) == false);
+   assert(arena_init(&a, 3 * 4096 + 1));
+   assert(((uintptr_t)a.base % a.page_size) == 0);
+   assert(a.reserved % a.page_size == 0 && a.reserved > 3 * 4096);
+
+   uint8_t *p = arena_alloc(&a, 1);
+   uint8_t *q = arena_alloc(&a, 100);
+   assert(p && q && q > p);
+   assert(((uintptr_t)p % ARENA_ALIGN) == 0 && ((uintptr_t)q % ARENA_ALIGN) == 0);
+   assert(q - p == ARENA_ALIGN);
+   for (int i = 0; i < 100; i++) assert(q[i] == 0);
+   assert(arena_used(&a) == ARENA_ALIGN + 100);
+   assert(a.allocations == 2);
+
+   assert(arena_alloc(&a, 0) == NULL);
+   assert(arena_alloc(&a, a.reserved) == NULL);
+   assert(a.refused == 2);
+   // the rest of the region still fits exactly
+   size_t start = (arena_used(&a) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+   size_t rest = a.reserved - start;
+   assert(arena_alloc(&a, rest) != NULL);
+   assert(arena_used(&a) == a.reserved);
+   assert(arena_alloc(&a, 1) == NULL);
+
+   assert(arena_seal(&a, false));
+   assert(a.sealed && !a.locked);
+   assert(arena_alloc(&a, 1) == NULL);
+   assert(a.refused == 4);
+   arena_free(&a, q); // no-op
+   arena_destroy(&a);
+   assert(a.base == NULL);
+
+   float *heap = arena_alloc(NULL, sizeof(float) * 16);
+   assert(heap && heap[15] == 0.0f);
+   arena_free(NULL, heap);
+   printf("OK\n");
+}
+
+/**
+ * Sealing with lock = true prefaults and locks the pages in use, or reports
+ * the refusal (RLIMIT_MEMLOCK) and leaves the arena sealed and usable.
+ *
+ * returns void
+*/
+void test_arena_seal_lock(void){
+   printf("[TEST] Arena prefault and lock ... \n");
+   arena a;
+   assert(arena_init(&a, 1 << 20));
+   float *v = arena_alloc(&a, sizeof(float) * 8192);
+   assert(v);
+   bool locked = arena_seal(&a, true);
+   assert(a.sealed);
+   assert(a.locked == locked);
+   if (!locked) printf("   mlock refused, pages prefaulted only\n");
+   // the memory stays writable either way
+   for (int i = 0; i < 8192; i++) v[i] = (float)i;
+   assert(v[8191] == 8191.0f);
+   arena_destroy(&a);
+   assert(!a.locked);
+
+   // an empty arena seals trivially
+   assert(arena_init(&a, 4096));
+   assert(arena_seal(&a, true));
+   arena_destroy(&a);
+   printf("OK\n");
+}
+
+/**
+ * A ring_buffer on the stack over stack storage and an spsc_ring_buffer
+ * over arena storage wrap like their heap versions and leave the storage
+ * alone on deinit; mc_ring_buffer_init_arena() puts the spsc struct and
+ * the frames inside the region.
+ *
+ * returns void
+*/
+void test_arena_embedded_rings(void){
+   printf("[TEST] Rings on caller and arena storage ... \n");
+   float storage[10];
+   ring_buffer rb;
+   assert(ring_buffer_init_with_storage(&rb, NULL, 10) == false);
+   assert(ring_buffer_init_with_storage(&rb, storage, 10));
+   float in[7] = { 1, 2, 3, 4, 5, 6, 7 }, out[7];
+   for (int round = 0; round < 3; round++){
+      assert(ring_buffer_write_n(&rb, in, 7) == 7);
+      assert(ring_buffer_read_n(&rb, out, 7) == 7);
+      assert(memcmp(in, out, sizeof(in)) == 0);
+   }
+   ring_buffer_deinit(&rb);
+   storage[0] = 42.0f; // still ours
+
+   arena a;
+   assert(arena_init(&a, 1 << 20));
+   spsc_ring_buffer *spsc = arena_alloc(&a, sizeof(spsc_ring_buffer));
+   float *spsc_storage = arena_alloc(&a, sizeof(float) * 16);
+   assert(spsc_ring_buffer_init_with_storage(spsc, spsc_storage, 16));
+   assert(spsc->pow2 && spsc->index_mask == 15);
+   for (int round = 0; round < 5; round++){
+      assert(spsc_ring_buffer_write_n(spsc, in, 7) == 7);
+      assert(spsc_ring_buffer_read_n(spsc, out, 7) == 7);
+      assert(memcmp(in, out, sizeof(in)) == 0);
+   }
+   spsc_ring_buffer_deinit(spsc);
+
+   mc_ring_buffer mc;
+   assert(mc_ring_buffer_init_arena(&mc, NCH, 0, &a) == false);
+   assert(mc_ring_buffer_init_arena(&mc, NCH, 100, &a));
+   assert(mc.arena == &a);
+   assert(in_arena(&a, mc.ring) && in_arena(&a, mc.ring->buffer));
+   assert(((uintptr_t)mc.ring % ARENA_ALIGN) == 0);
+   float frames[60 * NCH], back[60 * NCH];
+   for (int round = 0; round < 4; round++){
+      make_frames(frames, round * 60, 60);
+      assert(mc_ring_buffer_write_frames(&mc, frames, 60) == 60);
+      assert(mc_ring_buffer_read_frames(&mc, back, 60) == 60);
+      assert(memcmp(frames, back, sizeof(frames)) == 0);
+   }
+   mc_ring_buffer_deinit(&mc);
+   assert(mc.ring == NULL);
+
+   // NULL arena: the heap, freed by deinit
+   assert(mc_ring_buffer_init_arena(&mc, NCH, 100, NULL));
+   assert(mc.arena == NULL);
+   mc_ring_buffer_deinit(&mc);
+   arena_destroy(&a);
+   printf("OK\n");
+}
+
+/**
+ * A spectral bank in an arena against one on the heap, and the filter ->
+ * spectral -> output stages built in a sealed arena against the same
+ * stages on the heap: identical PSD frames, nothing allocated after the
+ * seal, every buffer inside the region.
+ *
+ * returns void
+*/
+void test_arena_stages(void){
+   printf("[TEST] DSP and stages built in an arena ... \n");
+   arena a;
+   assert(arena_init(&a, 4 << 20));
+
+   // bank: same engines, same frames
+   enum { TOTAL = FFT + 7 * HOP };
+   spsc_ring_buffer *heap_in[NCH], *arena_in[NCH];
+   float samples[TOTAL];
+   for (int ch = 0; ch < NCH; ch++){
+      for (int i = 0; i < TOTAL; i++) samples[i] = sinf(0.3f * (ch + 1) * i) + 0.01f * i;
+      heap_in[ch] = malloc(sizeof(spsc_ring_buffer));
+      arena_in[ch] = arena_alloc(&a, sizeof(spsc_ring_buffer));
+      assert(heap_in[ch] && spsc_ring_buffer_init(heap_in[ch], TOTAL));
+      assert(spsc_ring_buffer_init_with_storage(arena_in[ch], arena_alloc(&a, sizeof(float) * TOTAL), TOTAL));
+      assert(spsc_ring_buffer_write_n(heap_in[ch], samples, TOTAL) == TOTAL);
+      assert(spsc_ring_buffer_write_n(arena_in[ch], samples, TOTAL) == TOTAL);
+   }
+   dsp_spectral_bank heap_bank, arena_bank;
+   assert(dsp_spectral_bank_init(&heap_bank, NCH, FFT, HOP, DSP_WINDOW_HANN, 2, SAMPLE_RATE));
+   assert(dsp_spectral_bank_init_arena(&arena_bank, NCH, FFT, HOP, DSP_WINDOW_HANN, 2, SAMPLE_RATE, &a));
+   assert(in_arena(&a, arena_bank.engines) && in_arena(&a, arena_bank.engines[NCH - 1].history));
+   static float heap_psd[8 * NCH * BINS], arena_psd[8 * NCH * BINS];
+   assert(dsp_spectral_bank_process(&heap_bank, heap_in, heap_psd, 8) == 8);
+   assert(dsp_spectral_bank_process(&arena_bank, arena_in, arena_psd, 8) == 8);
+   assert(memcmp(heap_psd, arena_psd, sizeof(heap_psd)) == 0);
+   dsp_spectral_bank_destroy(&heap_bank);
+   dsp_spectral_bank_destroy(&arena_bank);
+   for (int ch = 0; ch < NCH; ch++){
+      spsc_ring_buffer_destroy(heap_in[ch]);
+      spsc_ring_buffer_deinit(arena_in[ch]);
+   }
+
+   // stages: heap (k = 0) and arena (k = 1) chains on the same input
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   pipeline_stage_config cfg = { "stage", PIPELINE_QOS_DEFAULT, 0, filter_stage_step, NULL, NULL };
+   pipeline_stage *stage = pipeline_add_stage(p, &cfg);
+   mc_ring_buffer raw[2], filtered[2], spectra[2];
+   filter_stage filter[2];
+   spectral_stage spectral[2];
+   output_stage output[2];
+   static psd_capture captured[2];
+   for (int k = 0; k < 2; k++){
+      arena *use = k ? &a : NULL;
+      assert(mc_ring_buffer_init_arena(&raw[k], NCH, 1024, use));
+      assert(mc_ring_buffer_init_arena(&filtered[k], NCH, 1024, use));
+      assert(mc_ring_buffer_init_arena(&spectra[k], NCH * BINS, 32, use));
+      assert(filter_stage_init_arena(&filter[k], &raw[k], &filtered[k], SAMPLE_RATE, 60.0f, 1.0f, 40.0f, use));
+      assert(spectral_stage_init_arena(&spectral[k], &filtered[k], &spectra[k], FFT, HOP, DSP_WINDOW_HANN,
+                                       1, SAMPLE_RATE, use));
+      assert(output_stage_init_arena(&output[k], &spectra[k], NCH, capture_psd, &captured[k], use));
+   }
+   assert(in_arena(&a, filter[1].frames) && in_arena(&a, spectral[1].windows[NCH - 1]->buffer));
+   assert(in_arena(&a, output[1].psd));
+   arena_seal(&a, false);
+   uint64_t allocations = a.allocations;
+
+   float frames[256 * NCH];
+   for (int batch = 0; batch < 3; batch++){
+      make_frames(frames, batch * 256, 256);
+      for (int k = 0; k < 2; k++){
+         assert(mc_ring_buffer_write_frames(&raw[k], frames, 256) == 256);
+         while (filter_stage_step(stage, &filter[k]) > 0){
+         }
+         while (spectral_stage_step(stage, &spectral[k]) > 0){
+         }
+         while (output_stage_step(stage, &output[k]) > 0){
+         }
+      }
+   }
+   assert(captured[0].count > 0 && captured[0].count == captured[1].count);
+   assert(memcmp(captured[0].frames, captured[1].frames, sizeof(captured[0].frames)) == 0);
+   assert(a.allocations == allocations && a.refused == 0);
+
+   for (int k = 0; k < 2; k++){
+      filter_stage_destroy(&filter[k]);
+      spectral_stage_destroy(&spectral[k]);
+      output_stage_destroy(&output[k]);
+      mc_ring_buffer_deinit(&raw[k]);
+      mc_ring_buffer_deinit(&filtered[k]);
+      mc_ring_buffer_deinit(&spectra[k]);
+   }
+   free(p);
+   arena_destroy(&a);
+   printf("OK\n");
+}
+
+/**
+ * A decimation chain in an arena against one on the heap: the same output
+ * samples on every stage, every buffer and ring inside the region, and
+ * pushing after the seal asks the arena for nothing.
+ *
+ * returns void
+*/
+void test_arena_decim_chain(void){
+   printf("[TEST] Decimation chain built in an arena ... \n");
+   enum { TOTAL = 4 * DSP_DECIM_BLOCK + 100 };
+   const int factors[2] = { 2, 4 };
+   arena a;
+   assert(arena_init(&a, 1 << 20));
+   dsp_decim_chain heap_chain, arena_chain;
+   assert(dsp_decim_chain_init(&heap_chain, SAMPLE_RATE, factors, 2, TOTAL));
+   assert(dsp_decim_chain_init_arena(&arena_chain, SAMPLE_RATE, factors, 2, TOTAL, &a));
+   for (int i = 0; i < 2; i++){
+      dsp_decim_stage *st = &arena_chain.stages[i];
+      assert(in_arena(&a, st->dec.coeffs) && in_arena(&a, st->dec.work) && in_arena(&a, st->out));
+      assert(in_arena(&a, st->ring) && in_arena(&a, st->ring->buffer));
+   }
+   arena_seal(&a, false);
+   uint64_t allocations = a.allocations;
+
+   static float x[TOTAL];
+   for (int i = 0; i < TOTAL; i++) x[i] = sinf(0.05f * i) + 0.3f * sinf(1.1f * i);
+   dsp_decim_chain_push(&heap_chain, x, TOTAL);
+   dsp_decim_chain_push(&arena_chain, x, TOTAL);
+   static float heap_out[TOTAL], arena_out[TOTAL];
+   for (int i = 0; i < 2; i++){
+      int n = spsc_ring_buffer_read_n(dsp_decim_chain_ring(&heap_chain, i), heap_out, TOTAL);
+      assert(n > 0);
+      assert(spsc_ring_buffer_read_n(dsp_decim_chain_ring(&arena_chain, i), arena_out, TOTAL) == n);
+      assert(memcmp(heap_out, arena_out, sizeof(float) * (size_t)n) == 0);
+   }
+   assert(a.allocations == allocations && a.refused == 0);
+
+   dsp_decim_chain_destroy(&heap_chain);
+   dsp_decim_chain_destroy(&arena_chain);
+   arena_destroy(&a);
+   printf("OK\n");
+}
+
+int main(){
+   test_arena_alloc();
+   test_arena_seal_lock();
+   test_arena_embedded_rings();
+   test_arena_stages();
+   test_arena_decim_chain();
+   return 0;
+}
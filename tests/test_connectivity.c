@@ -0,0 +1,234 @@
+// Tests for the connectivity engine (coherence, phase locking)
+
+/**
+ * @file test_connectivity.c
+ * @brief Tests for the connectivity engine (connectivity.c).
+ *
+ * This file contains tests for:
+ * - Invalid arguments, the default all-pairs montage and pair lookup
+ * - Coherence and PLV against a direct DFT of the same windows, Welch and
+ *   exponential averaging, a pair subset and a band including DC and Nyquist
+ * - Signals with known coupling: a delayed copy is coherent and phase
+ *   locked, independent noise is not; reset forgets the windows
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "connectivity.h"
+#include "dsp.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 250.0f
+
+static float noise(unsigned int *state){
+   *state = *state * 1103515245u + 12345u;
+   return ((*state >> 8) & 0xffff) / 32768.0f - 1.0f;
+}
+
+// analyze window w (hop apart) of every channel, then accumulate it
+static void analyze(conn_engine *e, dsp_spectral_bank *b, const float *signal, int total, int w){
+   float psd[512]; // >= num_bins of the engines below
+   for (int ch = 0; ch < b->num_channels; ch++){
+      dsp_spectral_window(&b->engines[ch], signal + ch * total + w * b->hop, b->fft_size, NULL, psd);
+   }
+   conn_update(e, b->engines);
+}
+
+/**
+ * Tests argument checks, the all-pairs default and conn_pair_index().
+ *
+ * returns void
+*/
+void test_conn_init(void){
+   printf("[TEST] Connectivity initialization ... \n");
+   conn_engine e;
+   const conn_pair bad[2] = { { 0, 0 }, { 0, 3 } };
+   assert(conn_init(&e, 1, 64, NULL, 0, 0, 0, CONN_AVERAGE_WELCH, 4, 0.0f) == false);
+   assert(conn_init(&e, 3, 60, NULL, 0, 0, 0, CONN_AVERAGE_WELCH, 4, 0.0f) == false);
+   assert(conn_init(&e, 3, 64, bad, 1, 0, 0, CONN_AVERAGE_WELCH, 4, 0.0f) == false);
+   assert(conn_init(&e, 3, 64, bad + 1, 1, 0, 0, CONN_AVERAGE_WELCH, 4, 0.0f) == false);
+   assert(conn_init(&e, 3, 64, NULL, 0, 30, 4, CONN_AVERAGE_WELCH, 4, 0.0f) == false);
+   assert(conn_init(&e, 3, 64, NULL, 0, 0, 0, CONN_AVERAGE_WELCH, 0, 0.0f) == false);
+   assert(conn_init(&e, 3, 64, NULL, 0, 0, 0, CONN_AVERAGE_EXPONENTIAL, 0, 0.0f) == false);
+   assert(conn_init(&e, 3, 64, NULL, 0, 0, 0, CONN_AVERAGE_EXPONENTIAL, 0, 1.5f) == false);
+
+   // 10-20 montage: 19 electrodes, every pair
+   assert(conn_init(&e, 19, 256, NULL, 0, 0, 0, CONN_AVERAGE_WELCH, 8, 0.0f));
+   assert(e.num_pairs == 19 * 18 / 2);
+   assert(e.num_bins == 129);
+   assert(conn_pair_index(&e, 0, 1) == 0);
+   assert(conn_pair_index(&e, 1, 0) == 0);
+   assert(conn_pair_index(&e, 17, 18) == e.num_pairs - 1);
+   assert(conn_pair_index(&e, 4, 4) == -1);
+   float out[129];
+   assert(conn_coherence(&e, 0, out) == false);
+   assert(conn_plv(&e, 0, out) == false);
+   conn_destroy(&e);
+   printf("OK\n");
+}
+
+/**
+ * Both averaging modes against a reference computed with a double
+ * precision DFT of the same windowed samples, for a subset of pairs in
+ * both orientations and every bin from DC to Nyquist.
+ *
+ * returns void
+*/
+void test_conn_reference(void){
+   printf("[TEST] Connectivity vs direct DFT ... \n");
+   enum { NCH = 3, N = 32, HOP = 8, WINDOWS = 14, BINS = N / 2 + 1, AVG = 4 };
+   enum { TOTAL = N + (WINDOWS - 1) * HOP };
+   const conn_pair pairs[2] = { { 0, 2 }, { 2, 1 } };
+   const float alpha = 0.3f;
+
+   float *signal = malloc(sizeof(float) * NCH * TOTAL);
+   assert(signal);
+   unsigned int seed = 3;
+   for (int i = 0; i < TOTAL; i++){
+      float common = sinf(2.0f * (float)M_PI * 5.0f * i / N);
+      for (int ch = 0; ch < NCH; ch++) signal[ch * TOTAL + i] = common * (ch + 1) + 0.7f * noise(&seed);
+   }
+
+   dsp_spectral_bank b;
+   assert(dsp_spectral_bank_init(&b, NCH, N, HOP, DSP_WINDOW_HANN, 1, SAMPLE_RATE));
+   const float *window = b.engines[0].window;
+
+   // per window, channel and bin: the spectrum
+   static double x_re[WINDOWS][NCH][BINS], x_im[WINDOWS][NCH][BINS];
+   for (int w = 0; w < WINDOWS; w++){
+      for (int ch = 0; ch < NCH; ch++){
+         for (int k = 0; k < BINS; k++){
+            double re = 0.0, im = 0.0;
+            for (int i = 0; i < N; i++){
+               double v = (double)signal[ch * TOTAL + w * HOP + i] * window[i];
+               re += v * cos(-2.0 * M_PI * k * i / N);
+               im += v * sin(-2.0 * M_PI * k * i / N);
+            }
+            x_re[w][ch][k] = re;
+            x_im[w][ch][k] = im;
+         }
+      }
+   }
+
+   for (int mode = 0; mode < 2; mode++){
+      conn_engine e;
+      conn_average average = mode == 0 ? CONN_AVERAGE_WELCH : CONN_AVERAGE_EXPONENTIAL;
+      assert(conn_init(&e, NCH, N, pairs, 2, 0, 0, average, AVG, alpha));
+      for (int w = 0; w < WINDOWS; w++) analyze(&e, &b, signal, TOTAL, w);
+      assert(e.windows == WINDOWS);
+
+      for (int p = 0; p < 2; p++){
+         int a = pairs[p].a, c = pairs[p].b;
+         float coh[BINS], plv[BINS];
+         assert(conn_coherence(&e, p, coh));
+         assert(conn_plv(&e, p, plv));
+         for (int k = 0; k < BINS; k++){
+            double saa = 0.0, scc = 0.0, sx = 0.0, sy = 0.0, px = 0.0, py = 0.0;
+            for (int w = 0; w < WINDOWS; w++){
+               double weight;
+               if (mode == 0){
+                  weight = w >= WINDOWS - AVG ? 1.0 / AVG : 0.0;
+               } else {
+                  // first window seeds the average, then (1 - alpha) per newer window
+                  int newer = WINDOWS - 1 - w;
+                  weight = (w == 0 ? 1.0 : alpha) * pow(1.0 - alpha, newer);
+               }
+               double ar = x_re[w][a][k], ai = x_im[w][a][k];
+               double cr = x_re[w][c][k], ci = x_im[w][c][k];
+               double x = ar * cr + ai * ci;
+               double y = ai * cr - ar * ci;
+               double mag = sqrt(x * x + y * y);
+               saa += weight * (ar * ar + ai * ai);
+               scc += weight * (cr * cr + ci * ci);
+               sx += weight * x;
+               sy += weight * y;
+               px += weight * x / mag;
+               py += weight * y / mag;
+            }
+            double expect_coh = (sx * sx + sy * sy) / (saa * scc);
+            double expect_plv = sqrt(px * px + py * py);
+            assert(fabs(coh[k] - expect_coh) < 2e-3);
+            assert(fabs(plv[k] - expect_plv) < 2e-3);
+         }
+      }
+      conn_destroy(&e);
+   }
+   dsp_spectral_bank_destroy(&b);
+   free(signal);
+   printf("OK\n");
+}
+
+/**
+ * Channel 1 is channel 0 delayed by a few samples plus a little noise,
+ * channel 2 is independent noise. Over a band around the sine, 0 and 1
+ * stay coherent and phase locked at the sine's bin; 0 and 2 average to a
+ * low coherence everywhere. Reset empties the averages.
+ *
+ * returns void
+*/
+void test_conn_signals(void){
+   printf("[TEST] Connectivity of coupled and independent channels ... \n");
+   enum { NCH = 3, N = 64, HOP = 32, WINDOWS = 64, SINE_BIN = 10, FIRST = 4, NB = 16 };
+   enum { TOTAL = N + (WINDOWS - 1) * HOP };
+   float *signal = malloc(sizeof(float) * NCH * TOTAL);
+   assert(signal);
+   unsigned int seed = 21;
+   float base[TOTAL + 3];
+   for (int i = 0; i < TOTAL + 3; i++){
+      base[i] = sinf(2.0f * (float)M_PI * SINE_BIN * i / N + 0.4f) + 0.5f * noise(&seed);
+   }
+   for (int i = 0; i < TOTAL; i++){
+      signal[i] = base[i + 3];
+      signal[TOTAL + i] = base[i] + 0.05f * noise(&seed);
+      signal[2 * TOTAL + i] = noise(&seed);
+   }
+
+   dsp_spectral_bank b;
+   assert(dsp_spectral_bank_init(&b, NCH, N, HOP, DSP_WINDOW_HANN, 1, SAMPLE_RATE));
+   conn_engine e;
+   assert(conn_init(&e, NCH, N, NULL, 0, FIRST, NB, CONN_AVERAGE_WELCH, 32, 0.0f));
+   assert(e.num_pairs == 3);
+   for (int w = 0; w < WINDOWS; w++) analyze(&e, &b, signal, TOTAL, w);
+
+   float coh[NB], plv[NB];
+   int coupled = conn_pair_index(&e, 0, 1);
+   assert(conn_coherence(&e, coupled, coh));
+   assert(conn_plv(&e, coupled, plv));
+   assert(coh[SINE_BIN - FIRST] > 0.95f);
+   assert(plv[SINE_BIN - FIRST] > 0.95f);
+
+   int independent = conn_pair_index(&e, 0, 2);
+   assert(conn_coherence(&e, independent, coh));
+   double mean = 0.0;
+   for (int k = 0; k < NB; k++){
+      assert(coh[k] >= 0.0f && coh[k] <= 1.0f);
+      mean += coh[k] / NB;
+   }
+   // 32 independent windows: expected coherence about 1/32
+   assert(mean < 0.15);
+
+   conn_reset(&e);
+   assert(conn_coherence(&e, coupled, coh) == false);
+   conn_destroy(&e);
+   dsp_spectral_bank_destroy(&b);
+   free(signal);
+   printf("OK\n");
+}
+
+int main(){
+   test_conn_init();
+   test_conn_reference();
+   test_conn_signals();
+   return 0;
+}
@@ -1 +1,877 @@
 // Tests for DSP functions (FFT, filters)
+
+/**
+ * @file test_dsp.c
+ * @brief Tests for the DSP library (dsp.c).
+ *
+ * This file contains tests for:
+ * - FFT power against a direct DFT, for several sizes
+ * - Window tables (Hann, Blackman)
+ * - Spectral engine: invalid arguments, PSD scaling (Parseval), peak bin
+ *   of a sine, Welch averaging
+ * - Streaming from an spsc_ring_buffer with overlapping hops, including
+ *   windows that wrap around the ring storage
+ * - Work pool: every task of every job runs exactly once, inline or on
+ *   worker threads; consecutive jobs with shrinking counts and their own
+ *   ctx never run each other's tasks
+ * - Spectral bank: shared FFT tables, channels against independent engines,
+ *   the same frames with and without a worker pool
+ * - Biquad cascade: designs, multi-channel lanes against a reference filter,
+ *   EEG notch/band-pass response
+ * - Decimator: output count and block invariance, pass band and alias
+ *   rejection; decimation chain feeding a spectral engine at the low rate
+ * - Band tracker: invalid arguments, band power of a sine, agreement with a
+ *   direct DFT of the last window, consistent snapshots read by another thread
+ * - Band powers integrated from PSD frames, per channel
+ * - Adjacent bands with no shared bin: their powers add up to their span
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include "dsp.h"
+#include "spsc_ring_buffer.h"
+#include "test_helpers.h"
+#include "work_pool.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 256.0f
+
+// relative comparison for values of any magnitude
+static int close_rel(double a, double b, double tol){
+   double scale = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+   if (scale < 1e-6) return fabs(a - b) < 1e-6;
+   return fabs(a - b) <= tol * scale;
+}
+
+// small deterministic pseudo random numbers in [-1, 1)
+static float noise(unsigned int *state){
+   *state = *state * 1664525u + 1013904223u;
+   return (float)((*state >> 8) & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+/**
+ * Compares dsp_fft_power() with a direct O(n^2) DFT.
+ *
+ * returns void
+*/
+void test_fft_power(void){
+   printf("[TEST] FFT power vs direct DFT ... \n");
+   const int sizes[] = { 8, 16, 64, 256, 1024 };
+   unsigned int seed = 1;
+   for (int t = 0; t < 5; t++){
+      int n = sizes[t];
+      dsp_fft_setup f;
+      assert(dsp_fft_setup_init(&f, n));
+      float *in = malloc(sizeof(float) * n);
+      float *re = malloc(sizeof(float) * n / 2);
+      float *im = malloc(sizeof(float) * n / 2);
+      float *power = malloc(sizeof(float) * (n / 2 + 1));
+      assert(in && re && im && power);
+      for (int i = 0; i < n; i++) in[i] = noise(&seed);
+
+      dsp_fft_power(&f, in, re, im, power);
+      for (int k = 0; k <= n / 2; k++){
+         double xr = 0.0, xi = 0.0;
+         for (int i = 0; i < n; i++){
+            double a = -2.0 * M_PI * (double)k * i / n;
+            xr += in[i] * cos(a);
+            xi += in[i] * sin(a);
+         }
+         assert(close_rel(power[k], xr * xr + xi * xi, 1e-3) ||
+                fabs(power[k] - (xr * xr + xi * xi)) < 1e-3 * n);
+      }
+      free(in); free(re); free(im); free(power);
+      dsp_fft_setup_destroy(&f);
+   }
+
+   dsp_fft_setup f;
+   assert(dsp_fft_setup_init(&f, 0) == false);
+   assert(dsp_fft_setup_init(&f, 4) == false);
+   assert(dsp_fft_setup_init(&f, 100) == false);
+   printf("OK\n");
+}
+
+/**
+ * Checks a few known window coefficients.
+ *
+ * returns void
+*/
+void test_windows(void){
+   printf("[TEST] Window tables ... \n");
+   float w[8];
+   dsp_window_fill(DSP_WINDOW_HANN, 8, w);
+   ASSERT_FLOAT_EQ(w[0], 0.0f);
+   ASSERT_FLOAT_EQ(w[2], 0.5f);
+   ASSERT_FLOAT_EQ(w[4], 1.0f);
+   dsp_window_fill(DSP_WINDOW_BLACKMAN, 8, w);
+   assert(fabs(w[0]) < 1e-6);
+   ASSERT_FLOAT_EQ(w[4], 1.0f);
+   dsp_window_fill(DSP_WINDOW_RECT, 8, w);
+   for (int i = 0; i < 8; i++) ASSERT_FLOAT_EQ(w[i], 1.0f);
+   printf("OK\n");
+}
+
+/**
+ * Tests init arguments, the peak of a sine and Parseval: the PSD integrated
+ * over frequency equals the mean square of the signal.
+ *
+ * returns void
+*/
+void test_spectral_scaling(void){
+   printf("[TEST] Spectral engine PSD scaling ... \n");
+   dsp_spectral s;
+   assert(dsp_spectral_init(&s, 100, 50, DSP_WINDOW_HANN, 1, SAMPLE_RATE) == false);
+   assert(dsp_spectral_init(&s, 256, 0, DSP_WINDOW_HANN, 1, SAMPLE_RATE) == false);
+   assert(dsp_spectral_init(&s, 256, 257, DSP_WINDOW_HANN, 1, SAMPLE_RATE) == false);
+   assert(dsp_spectral_init(&s, 256, 128, DSP_WINDOW_HANN, 0, SAMPLE_RATE) == false);
+   assert(dsp_spectral_init(&s, 256, 128, DSP_WINDOW_HANN, 1, 0.0f) == false);
+
+   const dsp_window_type windows[] = { DSP_WINDOW_RECT, DSP_WINDOW_HANN, DSP_WINDOW_BLACKMAN };
+   for (int w = 0; w < 3; w++){
+      const int n = 256;
+      assert(dsp_spectral_init(&s, n, n / 2, windows[w], 1, SAMPLE_RATE));
+      assert(s.num_bins == n / 2 + 1);
+      ASSERT_FLOAT_EQ(dsp_spectral_bin_hz(&s, 10), 10.0f);
+
+      // 10 Hz sine, amplitude 2, on a bin center: mean square 2
+      float x[256];
+      float psd[129];
+      for (int i = 0; i < n; i++) x[i] = 2.0f * sinf(2.0f * (float)M_PI * 10.0f * i / SAMPLE_RATE);
+      dsp_spectral_window(&s, x, n, NULL, psd);
+
+      int peak = 0;
+      double total = 0.0;
+      for (int k = 0; k < s.num_bins; k++){
+         if (psd[k] > psd[peak]) peak = k;
+         total += psd[k];
+      }
+      double df = SAMPLE_RATE / n;
+      assert(peak == 10);
+      assert(close_rel(total * df, 2.0, 0.01));
+      dsp_spectral_destroy(&s);
+   }
+   printf("OK\n");
+}
+
+/**
+ * Tests that the Welch average of K noise periodograms has lower variance
+ * than a single one, and that reset forgets the history.
+ *
+ * returns void
+*/
+void test_spectral_welch(void){
+   printf("[TEST] Spectral engine Welch averaging ... \n");
+   const int n = 128;
+   dsp_spectral single, welch;
+   assert(dsp_spectral_init(&single, n, n, DSP_WINDOW_HANN, 1, SAMPLE_RATE));
+   assert(dsp_spectral_init(&welch, n, n, DSP_WINDOW_HANN, 16, SAMPLE_RATE));
+
+   unsigned int seed = 7;
+   float x[128];
+   float psd_single[65], psd_welch[65];
+   for (int frame = 0; frame < 16; frame++){
+      for (int i = 0; i < n; i++) x[i] = noise(&seed);
+      dsp_spectral_window(&single, x, n, NULL, psd_single);
+      dsp_spectral_window(&welch, x, n, NULL, psd_welch);
+   }
+   assert(welch.history_count == 16);
+
+   // spread of the bins around their mean (white noise: flat true PSD)
+   double mean_s = 0.0, mean_w = 0.0, var_s = 0.0, var_w = 0.0;
+   for (int k = 1; k < 64; k++){ mean_s += psd_single[k]; mean_w += psd_welch[k]; }
+   mean_s /= 63; mean_w /= 63;
+   for (int k = 1; k < 64; k++){
+      var_s += (psd_single[k] - mean_s) * (psd_single[k] - mean_s);
+      var_w += (psd_welch[k] - mean_w) * (psd_welch[k] - mean_w);
+   }
+   assert(var_w / (mean_w * mean_w) < 0.25 * var_s / (mean_s * mean_s));
+
+   // after reset the next frame equals the single periodogram
+   dsp_spectral_reset(&welch);
+   for (int i = 0; i < n; i++) x[i] = noise(&seed);
+   dsp_spectral_window(&single, x, n, NULL, psd_single);
+   dsp_spectral_window(&welch, x, n, NULL, psd_welch);
+   for (int k = 0; k < 65; k++) ASSERT_FLOAT_EQ(psd_welch[k], psd_single[k]);
+
+   dsp_spectral_destroy(&single);
+   dsp_spectral_destroy(&welch);
+   printf("OK\n");
+}
+
+/**
+ * Streams samples through an spsc_ring_buffer with 75% overlap and checks
+ * the frame count, that each frame matches the frame computed from the
+ * contiguous signal, and that windows split by the ring's wrap are handled.
+ *
+ * returns void
+*/
+void test_spectral_stream(void){
+   printf("[TEST] Spectral engine streaming from a ring buffer ... \n");
+   const int n = 64;
+   const int hop = 16;
+   const int total = 1000;
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb && spsc_ring_buffer_init(rb, 100)); // not a multiple of n or hop
+
+   dsp_spectral stream, ref;
+   assert(dsp_spectral_init(&stream, n, hop, DSP_WINDOW_BLACKMAN, 1, SAMPLE_RATE));
+   assert(dsp_spectral_init(&ref, n, hop, DSP_WINDOW_BLACKMAN, 1, SAMPLE_RATE));
+
+   float *signal = malloc(sizeof(float) * total);
+   assert(signal);
+   unsigned int seed = 3;
+   for (int i = 0; i < total; i++){
+      signal[i] = sinf(2.0f * (float)M_PI * 12.0f * i / SAMPLE_RATE) + 0.1f * noise(&seed);
+   }
+
+   float psd[4][33];
+   float expect[33];
+   int written = 0;
+   int frames = 0;
+   while (written < total){
+      int chunk = total - written < 23 ? total - written : 23;
+      written += spsc_ring_buffer_write_n(rb, signal + written, chunk);
+      int got;
+      while ((got = dsp_spectral_process(&stream, rb, &psd[0][0], 4)) > 0){
+         for (int f = 0; f < got; f++, frames++){
+            dsp_spectral_window(&ref, signal + frames * hop, n, NULL, expect);
+            for (int k = 0; k < 33; k++) assert(close_rel(psd[f][k], expect[k], 1e-4));
+         }
+      }
+   }
+   assert(frames == 1 + (total - n) / hop);
+   // what is left is less than one window, starting at the next hop
+   assert(spsc_ring_buffer_size(rb) == total - frames * hop);
+   assert(spsc_ring_buffer_size(rb) < n);
+
+   free(signal);
+   dsp_spectral_destroy(&stream);
+   dsp_spectral_destroy(&ref);
+   SPSC_SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+#define POOL_TASKS 97
+
+static void count_task(void *ctx, int index){
+   atomic_int *runs = (atomic_int *)ctx;
+   atomic_fetch_add(&runs[index], 1);
+}
+
+/**
+ * Many jobs of different sizes on a pool with threads, one without and no
+ * pool at all: each task runs once per job and the job is done on return.
+ *
+ * returns void
+*/
+void test_work_pool(void){
+   printf("[TEST] Work pool runs every task once ... \n");
+   work_pool pools[2];
+   assert(work_pool_init(&pools[0], 3));
+   assert(pools[0].num_threads == 3);
+   assert(work_pool_init(&pools[1], 0));
+   work_pool *choices[3] = { &pools[0], &pools[1], NULL };
+   static atomic_int runs[POOL_TASKS];
+   for (int c = 0; c < 3; c++){
+      for (int job = 0; job < 500; job++){
+         int count = job % POOL_TASKS;
+         for (int i = 0; i < POOL_TASKS; i++) atomic_store(&runs[i], 0);
+         work_pool_apply(choices[c], count, count_task, runs);
+         for (int i = 0; i < POOL_TASKS; i++) assert(atomic_load(&runs[i]) == (i < count ? 1 : 0));
+      }
+   }
+   work_pool_destroy(&pools[0]);
+   work_pool_destroy(&pools[1]);
+   printf("OK\n");
+}
+
+typedef struct {
+   int count;
+   atomic_int runs[POOL_TASKS];
+   atomic_int out_of_range;   // tasks run with an index past this job's count
+} pool_job;
+
+static void job_task(void *ctx, int index){
+   pool_job *job = (pool_job *)ctx;
+   if (index >= job->count) atomic_fetch_add(&job->out_of_range, 1);
+   else atomic_fetch_add(&job->runs[index], 1);
+}
+
+/**
+ * One pool reused for jobs of decreasing size, each with its own ctx: a
+ * worker that wakes up late for a finished job must not claim tasks of the
+ * next one and run them with the old fn/ctx, so every ctx sees each of its
+ * tasks exactly once, also after the jobs that follow it.
+ *
+ * returns void
+*/
+void test_work_pool_job_handoff(void){
+   printf("[TEST] Work pool keeps consecutive jobs apart ... \n");
+   enum { JOBS = 4 };
+   work_pool pool;
+   assert(work_pool_init(&pool, 3));
+   static pool_job jobs[JOBS];
+   for (int round = 0; round < 2000; round++){
+      for (int j = 0; j < JOBS; j++){
+         jobs[j].count = POOL_TASKS - j * 24 - round % 7;
+         for (int i = 0; i < POOL_TASKS; i++) atomic_store(&jobs[j].runs[i], 0);
+         atomic_store(&jobs[j].out_of_range, 0);
+      }
+      for (int j = 0; j < JOBS; j++) work_pool_apply(&pool, jobs[j].count, job_task, &jobs[j]);
+      // checked after all of them: no late task of an earlier job's ctx
+      for (int j = 0; j < JOBS; j++){
+         assert(atomic_load(&jobs[j].out_of_range) == 0);
+         for (int i = 0; i < POOL_TASKS; i++) assert(atomic_load(&jobs[j].runs[i]) == (i < jobs[j].count ? 1 : 0));
+      }
+   }
+   work_pool_destroy(&pool);
+   printf("OK\n");
+}
+
+/**
+ * A bank of 19 channels (not a multiple of the task size) streamed in
+ * uneven chunks: each channel's frames match an independent engine, the
+ * shared engines use the first one's tables, and a pool gives the same
+ * frames bit for bit.
+ *
+ * returns void
+*/
+void test_spectral_bank(void){
+   printf("[TEST] Spectral bank vs per-channel engines, with and without a pool ... \n");
+   enum { NCH = 19, N = 64, HOP = 16, TOTAL = 1000, BINS = N / 2 + 1 };
+   dsp_spectral_bank serial, parallel;
+   assert(dsp_spectral_bank_init(&serial, 0, N, HOP, DSP_WINDOW_HANN, 3, SAMPLE_RATE) == false);
+   assert(dsp_spectral_bank_init(&serial, NCH, 12, HOP, DSP_WINDOW_HANN, 3, SAMPLE_RATE) == false);
+   assert(dsp_spectral_bank_init(&serial, NCH, N, HOP, DSP_WINDOW_HANN, 3, SAMPLE_RATE));
+   assert(dsp_spectral_bank_init(&parallel, NCH, N, HOP, DSP_WINDOW_HANN, 3, SAMPLE_RATE));
+   for (int ch = 1; ch < NCH; ch++){
+      assert(serial.engines[ch].shared_tables);
+      assert(serial.engines[ch].window == serial.engines[0].window);
+   }
+   assert(!serial.engines[0].shared_tables);
+   dsp_spectral shared;
+   assert(dsp_spectral_init_shared(&shared, &serial.engines[0], 0) == false);
+   assert(dsp_spectral_init_shared(&shared, &serial.engines[0], DSP_MAX_AVERAGES + 1) == false);
+
+   work_pool pool;
+   assert(work_pool_init(&pool, 3));
+   dsp_spectral_bank_set_pool(&parallel, &pool);
+
+   dsp_spectral ref[NCH];
+   spsc_ring_buffer *rings[2][NCH];
+   float *signal = malloc(sizeof(float) * NCH * TOTAL);
+   assert(signal);
+   unsigned int seed = 17;
+   for (int ch = 0; ch < NCH; ch++){
+      assert(dsp_spectral_init(&ref[ch], N, HOP, DSP_WINDOW_HANN, 3, SAMPLE_RATE));
+      for (int i = 0; i < TOTAL; i++){
+         signal[ch * TOTAL + i] = noise(&seed) + sinf(2.0f * (float)M_PI * (ch + 1) * i / N);
+      }
+      for (int b = 0; b < 2; b++){
+         rings[b][ch] = malloc(sizeof(spsc_ring_buffer));
+         assert(rings[b][ch] && spsc_ring_buffer_init(rings[b][ch], N + 40));
+      }
+   }
+
+   static float psd[2][NCH * BINS];
+   float expect[BINS];
+   int written = 0;
+   int frames = 0;
+   while (written < TOTAL){
+      int chunk = TOTAL - written < 37 ? TOTAL - written : 37;
+      for (int b = 0; b < 2; b++){
+         for (int ch = 0; ch < NCH; ch++){
+            assert(spsc_ring_buffer_write_n(rings[b][ch], signal + ch * TOTAL + written, chunk) == chunk);
+         }
+      }
+      written += chunk;
+      for (;;){
+         int got = dsp_spectral_bank_process(&serial, rings[0], psd[0], 1);
+         assert(dsp_spectral_bank_process(&parallel, rings[1], psd[1], 1) == got);
+         if (got == 0) break;
+         assert(memcmp(psd[0], psd[1], sizeof(psd[0])) == 0);
+         for (int ch = 0; ch < NCH; ch++){
+            dsp_spectral_window(&ref[ch], signal + ch * TOTAL + frames * HOP, N, NULL, expect);
+            for (int k = 0; k < BINS; k++) assert(close_rel(psd[0][ch * BINS + k], expect[k], 1e-4));
+         }
+         frames++;
+      }
+   }
+   assert(frames == 1 + (TOTAL - N) / HOP);
+
+   free(signal);
+   for (int ch = 0; ch < NCH; ch++){
+      dsp_spectral_destroy(&ref[ch]);
+      SPSC_SAFE_DESTROY(rings[0][ch]);
+      SPSC_SAFE_DESTROY(rings[1][ch]);
+   }
+   dsp_spectral_bank_destroy(&serial);
+   dsp_spectral_bank_destroy(&parallel);
+   work_pool_destroy(&pool);
+   printf("OK\n");
+}
+
+/**
+ * Tests the cascade against a per-channel reference filter, with
+ * a channel count that is not a multiple of the vector width, uneven blocks,
+ * in place and out of place.
+ *
+ * returns void
+*/
+void test_biquad_cascade(void){
+   printf("[TEST] Biquad cascade vs reference ... \n");
+   dsp_biquad sec[3];
+   assert(dsp_biquad_notch(&sec[0], 250.0f, 0.0f, 30.0f) == false);
+   assert(dsp_biquad_notch(&sec[0], 250.0f, 125.0f, 30.0f) == false);
+   assert(dsp_biquad_lowpass(&sec[0], 250.0f, 40.0f, 0.0f) == false);
+   assert(dsp_biquad_highpass(&sec[0], 0.0f, 1.0f, 0.7f) == false);
+   assert(dsp_biquad_notch(&sec[0], 250.0f, 50.0f, 30.0f));
+   assert(dsp_biquad_highpass(&sec[1], 250.0f, 1.0f, 0.7071f));
+   assert(dsp_biquad_lowpass(&sec[2], 250.0f, 40.0f, 0.7071f));
+
+   dsp_biquad_cascade c;
+   assert(dsp_biquad_cascade_init(&c, 0, sec, 3) == false);
+   assert(dsp_biquad_cascade_init(&c, 4, sec, 0) == false);
+   assert(dsp_biquad_cascade_init(&c, 4, sec, DSP_MAX_SECTIONS + 1) == false);
+
+   enum { NCH = 19, FRAMES = 3000 };
+   assert(dsp_biquad_cascade_init(&c, NCH, sec, 3));
+   float *in = malloc(sizeof(float) * NCH * FRAMES);
+   float *out = malloc(sizeof(float) * NCH * FRAMES);
+   assert(in && out);
+   unsigned int seed = 9;
+   for (int i = 0; i < NCH * FRAMES; i++) in[i] = noise(&seed) + 0.5f * (i % NCH);
+
+   // first half out of place, second half in place
+   int split = FRAMES / 2;
+   for (int f = 0; f < split; f += 100) dsp_biquad_cascade_process(&c, in + f * NCH, out + f * NCH, 100);
+   memcpy(out + split * NCH, in + split * NCH, sizeof(float) * NCH * (FRAMES - split));
+   for (int f = split; f < FRAMES; f += 7){
+      int n = FRAMES - f < 7 ? FRAMES - f : 7;
+      dsp_biquad_cascade_process(&c, out + f * NCH, out + f * NCH, n);
+   }
+
+   for (int ch = 0; ch < NCH; ch++){
+      float z1[3] = {0}, z2[3] = {0};
+      for (int f = 0; f < FRAMES; f++){
+         float x = in[f * NCH + ch];
+         for (int k = 0; k < 3; k++){
+            float y = sec[k].b0 * x + z1[k];
+            z1[k] = sec[k].b1 * x - sec[k].a1 * y + z2[k];
+            z2[k] = sec[k].b2 * x - sec[k].a2 * y;
+            x = y;
+         }
+         assert(fabs(out[f * NCH + ch] - x) < 1e-5);
+      }
+   }
+
+   // reset forgets the state: same input, same output
+   dsp_biquad_cascade_reset(&c);
+   float first[NCH];
+   dsp_biquad_cascade_process(&c, in, first, 1);
+   for (int ch = 0; ch < NCH; ch++) ASSERT_FLOAT_EQ(first[ch], out[ch]);
+
+   free(in);
+   free(out);
+   dsp_biquad_cascade_destroy(&c);
+   printf("OK\n");
+}
+
+// RMS gain of the cascade for a sine after the transient has settled
+static double cascade_gain(dsp_biquad_cascade *c, float fs, float hz){
+   enum { SETTLE = 4000, MEASURE = 2000 };
+   int nch = c->num_channels;
+   float *x = malloc(sizeof(float) * nch * (SETTLE + MEASURE));
+   assert(x);
+   for (int f = 0; f < SETTLE + MEASURE; f++){
+      for (int ch = 0; ch < nch; ch++) x[f * nch + ch] = sinf(2.0f * (float)M_PI * hz * f / fs);
+   }
+   dsp_biquad_cascade_reset(c);
+   dsp_biquad_cascade_process(c, x, x, SETTLE + MEASURE);
+   double sum = 0.0;
+   for (int f = SETTLE; f < SETTLE + MEASURE; f++) sum += (double)x[f * nch] * x[f * nch];
+   free(x);
+   return sqrt(sum / MEASURE) / sqrt(0.5);
+}
+
+/**
+ * Tests the EEG preprocessing response: line noise and its harmonic are
+ * removed, the pass band is kept, drift and high frequencies are attenuated.
+ *
+ * returns void
+*/
+void test_biquad_eeg_response(void){
+   printf("[TEST] Biquad EEG notch/band-pass response ... \n");
+   dsp_biquad_cascade c;
+   assert(dsp_biquad_cascade_init_eeg(&c, 8, 250.0f, 50.0f, 40.0f, 1.0f) == false);
+   assert(dsp_biquad_cascade_init_eeg(&c, 8, 250.0f, 50.0f, 1.0f, 130.0f) == false);
+   assert(dsp_biquad_cascade_init_eeg(&c, 8, 250.0f, 50.0f, 1.0f, 45.0f));
+   assert(c.num_sections == 6); // notches at 50 and 100 Hz
+   assert(cascade_gain(&c, 250.0f, 50.0f) < 0.01);
+   assert(cascade_gain(&c, 250.0f, 100.0f) < 0.01);
+   assert(fabs(cascade_gain(&c, 250.0f, 10.0f) - 1.0) < 0.03);
+   assert(fabs(cascade_gain(&c, 250.0f, 20.0f) - 1.0) < 0.03);
+   assert(cascade_gain(&c, 250.0f, 0.2f) < 0.01);
+   dsp_biquad_cascade_destroy(&c);
+
+   // 60 Hz mains, no harmonic below 0.45 * fs
+   assert(dsp_biquad_cascade_init_eeg(&c, 1, 250.0f, 60.0f, 0.5f, 40.0f));
+   assert(c.num_sections == 5);
+   assert(cascade_gain(&c, 250.0f, 60.0f) < 0.01);
+   dsp_biquad_cascade_destroy(&c);
+   printf("OK\n");
+}
+
+// RMS gain of a decimator for a sine, after the delay line has filled
+static double decimator_gain(int factor, double cycles_per_sample){
+   dsp_decimator d;
+   assert(dsp_decimator_init(&d, factor));
+   enum { N = 8192 };
+   static float in[N], out[N];
+   for (int i = 0; i < N; i++) in[i] = (float)sin(2.0 * M_PI * cycles_per_sample * i);
+   int produced = 0;
+   for (int pos = 0; pos < N; pos += DSP_DECIM_BLOCK){
+      produced += dsp_decimator_process(&d, in + pos, DSP_DECIM_BLOCK, out + produced);
+   }
+   double sum = 0.0;
+   int skip = d.taps; // outputs that still see the zeroed history
+   for (int m = skip; m < produced; m++) sum += (double)out[m] * out[m];
+   dsp_decimator_destroy(&d);
+   return sqrt(sum / (produced - skip)) / sqrt(0.5);
+}
+
+/**
+ * Tests the decimator's output count, that results do not depend on how
+ * the input is split into blocks, and its frequency response.
+ *
+ * returns void
+*/
+void test_decimator(void){
+   printf("[TEST] Polyphase decimator ... \n");
+   dsp_decimator d;
+   assert(dsp_decimator_init(&d, 1) == false);
+   assert(dsp_decimator_init(&d, DSP_MAX_DECIM_FACTOR + 1) == false);
+
+   enum { N = 5000 };
+   float *in = malloc(sizeof(float) * N);
+   float *a = malloc(sizeof(float) * N);
+   float *b = malloc(sizeof(float) * N);
+   assert(in && a && b);
+   unsigned int seed = 21;
+   for (int i = 0; i < N; i++) in[i] = noise(&seed);
+
+   const int factors[] = { 2, 3, 4, 8 };
+   for (int t = 0; t < 4; t++){
+      int m = factors[t];
+      assert(dsp_decimator_init(&d, m));
+      assert(d.taps == DSP_DECIM_TAPS_PER_FACTOR * m + 1);
+      int na = 0;
+      for (int pos = 0; pos < N; pos += DSP_DECIM_BLOCK){
+         na += dsp_decimator_process(&d, in + pos, N - pos < DSP_DECIM_BLOCK ? N - pos : DSP_DECIM_BLOCK, a + na);
+      }
+      assert(na == (N + m - 1) / m);
+
+      dsp_decimator_reset(&d);
+      int nb = 0;
+      for (int pos = 0; pos < N; pos += 13){
+         nb += dsp_decimator_process(&d, in + pos, N - pos < 13 ? N - pos : 13, b + nb);
+      }
+      assert(nb == na);
+      for (int i = 0; i < na; i++) assert(fabs(a[i] - b[i]) < 1e-6);
+
+      // constant input: unity gain once the history is full
+      float one[DSP_DECIM_BLOCK];
+      float out[DSP_DECIM_BLOCK];
+      for (int i = 0; i < DSP_DECIM_BLOCK; i++) one[i] = 1.0f;
+      dsp_decimator_reset(&d);
+      int n = dsp_decimator_process(&d, one, DSP_DECIM_BLOCK, out);
+      assert(fabs(out[n - 1] - 1.0f) < 1e-4);
+      dsp_decimator_destroy(&d);
+   }
+
+   // pass band kept, what would alias into the pass band removed
+   assert(fabs(decimator_gain(2, 0.05) - 1.0) < 0.01);
+   assert(decimator_gain(2, 0.40) < 1e-3);   // would alias to 0.1
+   assert(fabs(decimator_gain(4, 0.02) - 1.0) < 0.01);
+   assert(decimator_gain(4, 0.20) < 1e-3);   // would alias to 0.05
+   free(in); free(a); free(b);
+   printf("OK\n");
+}
+
+/**
+ * Runs a 3 stage 2x chain and analyzes the last substream at fs/8: an
+ * infra-low tone is resolved and a tone far above the final Nyquist does
+ * not alias into the spectrum.
+ *
+ * returns void
+*/
+void test_decim_chain(void){
+   printf("[TEST] Decimation chain to a low-rate spectral engine ... \n");
+   enum { TOTAL = 256 * 80 };
+   const int factors[3] = { 2, 2, 2 };
+   dsp_decim_chain c;
+   assert(dsp_decim_chain_init(&c, SAMPLE_RATE, factors, 0, 1024) == false);
+   assert(dsp_decim_chain_init(&c, SAMPLE_RATE, factors, 3, 0) == false);
+   assert(dsp_decim_chain_init(&c, SAMPLE_RATE, factors, 3, TOTAL));
+   ASSERT_FLOAT_EQ(dsp_decim_chain_rate(&c, 0), 128.0f);
+   ASSERT_FLOAT_EQ(dsp_decim_chain_rate(&c, 2), 32.0f);
+
+   // 0.25 Hz plus 13 Hz (aliases to 3 Hz at fs/8 unless filtered)
+   float *x = malloc(sizeof(float) * TOTAL);
+   assert(x);
+   for (int i = 0; i < TOTAL; i++){
+      float t = i / SAMPLE_RATE;
+      x[i] = sinf(2.0f * (float)M_PI * 0.25f * t) + sinf(2.0f * (float)M_PI * 13.0f * t);
+   }
+   for (int pos = 0; pos < TOTAL; pos += 500){
+      dsp_decim_chain_push(&c, x + pos, TOTAL - pos < 500 ? TOTAL - pos : 500);
+   }
+   assert(spsc_ring_buffer_size(dsp_decim_chain_ring(&c, 0)) == TOTAL / 2);
+   assert(spsc_ring_buffer_size(dsp_decim_chain_ring(&c, 1)) == TOTAL / 4);
+   assert(spsc_ring_buffer_size(dsp_decim_chain_ring(&c, 2)) == TOTAL / 8);
+   assert(c.stages[2].dropped == 0);
+
+   // 512 points at 32 Hz: 0.0625 Hz bins, a 16 s window (8192 points at fs)
+   dsp_spectral s;
+   assert(dsp_spectral_init(&s, 512, 256, DSP_WINDOW_HANN, 4, dsp_decim_chain_rate(&c, 2)));
+   float psd[8][257];
+   int frames = dsp_spectral_process(&s, dsp_decim_chain_ring(&c, 2), &psd[0][0], 8);
+   assert(frames >= 4);
+   float *last = psd[frames - 1];
+   int peak = 0;
+   for (int k = 0; k < 257; k++) if (last[k] > last[peak]) peak = k;
+   assert(peak == 4); // 0.25 Hz
+   // 3 Hz alias suppressed by more than 60 dB relative to the tone
+   assert(last[48] < 1e-6 * last[4]);
+
+   dsp_spectral_destroy(&s);
+   dsp_decim_chain_destroy(&c);
+   free(x);
+   printf("OK\n");
+}
+
+/**
+ * Tests band tracker arguments and bin selection.
+ *
+ * returns void
+*/
+void test_band_tracker_init(void){
+   printf("[TEST] Band tracker initialization ... \n");
+   dsp_band_tracker t;
+   const dsp_band narrow = { 10.2f, 10.8f }; // between bins at 1 Hz resolution
+   const dsp_band reversed = { 8.0f, 4.0f };
+   assert(dsp_band_tracker_init(&t, 1, SAMPLE_RATE, dsp_eeg_bands, 4) == false);
+   assert(dsp_band_tracker_init(&t, 256, 0.0f, dsp_eeg_bands, 4) == false);
+   assert(dsp_band_tracker_init(&t, 256, SAMPLE_RATE, dsp_eeg_bands, 0) == false);
+   assert(dsp_band_tracker_init(&t, 256, SAMPLE_RATE, dsp_eeg_bands, DSP_MAX_BANDS + 1) == false);
+   assert(dsp_band_tracker_init(&t, 256, SAMPLE_RATE, &narrow, 1) == false);
+   assert(dsp_band_tracker_init(&t, 256, SAMPLE_RATE, &reversed, 1) == false);
+
+   // 1 Hz bins: delta 1..3, theta 4..7, alpha 8..12, beta 13..29
+   assert(dsp_band_tracker_init(&t, 256, SAMPLE_RATE, dsp_eeg_bands, DSP_NUM_EEG_BANDS));
+   assert(t.band_bins[0] == 3 && t.band_bins[1] == 4 && t.band_bins[2] == 5 && t.band_bins[3] == 17);
+   assert(t.num_bins == 29);
+   float power[DSP_NUM_EEG_BANDS];
+   uint64_t samples = 1;
+   assert(dsp_band_tracker_read(&t, power, &samples) == DSP_NUM_EEG_BANDS);
+   assert(samples == 0 && power[2] == 0.0f);
+   dsp_band_tracker_destroy(&t);
+   printf("OK\n");
+}
+
+/**
+ * Tests the band power of a sine and compares the tracked bins with a direct
+ * DFT of the last window after a long noisy stream.
+ *
+ * returns void
+*/
+void test_band_tracker_values(void){
+   printf("[TEST] Band tracker band powers ... \n");
+   const int n = 256;
+   dsp_band_tracker t;
+   assert(dsp_band_tracker_init(&t, n, SAMPLE_RATE, dsp_eeg_bands, DSP_NUM_EEG_BANDS));
+
+   // 10 Hz sine of amplitude 2: all of its mean square (2 V^2) is in alpha
+   float power[DSP_NUM_EEG_BANDS];
+   for (int i = 0; i < 4 * n; i++){
+      float x = 2.0f * sinf(2.0f * (float)M_PI * 10.0f * i / SAMPLE_RATE);
+      dsp_band_tracker_push(&t, &x, 1);
+   }
+   uint64_t samples;
+   dsp_band_tracker_read(&t, power, &samples);
+   assert(samples == (uint64_t)(4 * n));
+   assert(close_rel(power[2], 2.0, 0.01));
+   assert(power[0] < 1e-3 && power[1] < 1e-3 && power[3] < 1e-3);
+
+   // a long noisy stream in uneven blocks, then compare with a direct DFT
+   const int total = 50000;
+   float *x = malloc(sizeof(float) * total);
+   assert(x);
+   unsigned int seed = 11;
+   for (int i = 0; i < total; i++){
+      x[i] = sinf(2.0f * (float)M_PI * 6.0f * i / SAMPLE_RATE) + noise(&seed);
+   }
+   for (int pos = 0; pos < total; pos += 37){
+      dsp_band_tracker_push(&t, x + pos, total - pos < 37 ? total - pos : 37);
+   }
+   dsp_band_tracker_read(&t, power, NULL);
+   const float *last = x + total - n;
+   for (int b = 0; b < DSP_NUM_EEG_BANDS; b++){
+      double expect = 0.0;
+      for (int k = 0; k <= n / 2; k++){
+         double f = k * SAMPLE_RATE / n;
+         if (f < dsp_eeg_bands[b].lo_hz || f >= dsp_eeg_bands[b].hi_hz) continue;
+         double xr = 0.0, xi = 0.0;
+         for (int i = 0; i < n; i++){
+            double a = -2.0 * M_PI * (double)k * i / n;
+            xr += last[i] * cos(a);
+            xi += last[i] * sin(a);
+         }
+         expect += 2.0 * (xr * xr + xi * xi) / ((double)n * n);
+      }
+      assert(close_rel(power[b], expect, 1e-3));
+   }
+   free(x);
+   dsp_band_tracker_destroy(&t);
+   printf("OK\n");
+}
+
+#define TRACKER_PUSHES 200000
+
+static void *tracker_reader(void *arg){
+   dsp_band_tracker *t = (dsp_band_tracker *)arg;
+   uint64_t last = 0;
+   float power[2];
+   while (last < TRACKER_PUSHES){
+      uint64_t samples;
+      dsp_band_tracker_read(t, power, &samples);
+      // both bands are the same, a torn snapshot would differ
+      assert(power[0] == power[1]);
+      assert(samples >= last);
+      last = samples;
+   }
+   return NULL;
+}
+
+/**
+ * A reader thread polls the tracker while samples are pushed one at a time.
+ * Snapshots are consistent and the pusher never waits for the reader.
+ *
+ * returns void
+*/
+void test_band_tracker_thread(void){
+   printf("[TEST] Band tracker read from another thread ... \n");
+   const dsp_band same[2] = { { 8.0f, 13.0f }, { 8.0f, 13.0f } };
+   dsp_band_tracker t;
+   assert(dsp_band_tracker_init(&t, 64, SAMPLE_RATE, same, 2));
+   pthread_t reader;
+   assert(pthread_create(&reader, NULL, tracker_reader, &t) == 0);
+   unsigned int seed = 5;
+   for (int i = 0; i < TRACKER_PUSHES; i++){
+      float x = noise(&seed);
+      dsp_band_tracker_push(&t, &x, 1);
+   }
+   assert(pthread_join(reader, NULL) == 0);
+   dsp_band_tracker_destroy(&t);
+   printf("OK\n");
+}
+
+/**
+ * Band powers from a two-channel PSD frame: a flat density integrates to
+ * density * bin width * bins in the band (upper edge excluded), and a single
+ * bin lands only in the bands that contain it.
+ *
+ * returns void
+*/
+void test_psd_band_powers(void){
+   printf("[TEST] Band powers from PSD frames ... \n");
+   enum { BINS = 129 };
+   float bin_hz = SAMPLE_RATE / 256.0f;
+   static float psd[2 * BINS];
+   for (int k = 0; k < BINS; k++){
+      psd[k] = 1e-6f;                  // channel 0: flat
+      psd[BINS + k] = k == 10 ? 1.0f : 0.0f; // channel 1: one bin
+   }
+   float power[2 * DSP_NUM_EEG_BANDS];
+   dsp_psd_band_powers(psd, 2, BINS, bin_hz, dsp_eeg_bands, DSP_NUM_EEG_BANDS, power);
+   for (int b = 0; b < DSP_NUM_EEG_BANDS; b++){
+      int first = (int)ceilf(dsp_eeg_bands[b].lo_hz / bin_hz);
+      int last = (int)ceilf(dsp_eeg_bands[b].hi_hz / bin_hz) - 1;
+      float expected = 1e-6f * bin_hz * (float)(last - first + 1);
+      assert(fabsf(power[b] - expected) < 1e-6f * expected);
+      bool holds = dsp_eeg_bands[b].lo_hz <= 10 * bin_hz && 10 * bin_hz < dsp_eeg_bands[b].hi_hz;
+      assert(power[DSP_NUM_EEG_BANDS + b] == (holds ? bin_hz : 0.0f));
+   }
+   printf("OK\n");
+}
+
+/**
+ * Adjacent bands share no bin: with 1 Hz bins the four EEG band powers add
+ * up to the power over 0.5-30 Hz, from PSD frames and from the band tracker.
+ *
+ * returns void
+*/
+void test_band_edges(void){
+   printf("[TEST] Adjacent bands add up to their span ... \n");
+   enum { BINS = 129 };
+   dsp_band bands[DSP_NUM_EEG_BANDS + 1];
+   memcpy(bands, dsp_eeg_bands, sizeof(dsp_eeg_bands));
+   bands[DSP_NUM_EEG_BANDS] = (dsp_band){ 0.5f, 30.0f };
+
+   static float psd[BINS];
+   unsigned int seed = 17;
+   for (int k = 0; k < BINS; k++) psd[k] = 1.0f + noise(&seed);
+   float power[DSP_NUM_EEG_BANDS + 1];
+   dsp_psd_band_powers(psd, 1, BINS, 1.0f, bands, DSP_NUM_EEG_BANDS + 1, power);
+   double sum = 0.0;
+   for (int b = 0; b < DSP_NUM_EEG_BANDS; b++) sum += power[b];
+   assert(close_rel(sum, power[DSP_NUM_EEG_BANDS], 1e-5));
+
+   dsp_band_tracker t;
+   assert(dsp_band_tracker_init(&t, 256, SAMPLE_RATE, bands, DSP_NUM_EEG_BANDS + 1));
+   assert(t.band_bins[DSP_NUM_EEG_BANDS] == t.band_bins[0] + t.band_bins[1] +
+                                            t.band_bins[2] + t.band_bins[3]);
+   for (int i = 0; i < 1000; i++){
+      float x = noise(&seed);
+      dsp_band_tracker_push(&t, &x, 1);
+   }
+   dsp_band_tracker_read(&t, power, NULL);
+   sum = 0.0;
+   for (int b = 0; b < DSP_NUM_EEG_BANDS; b++) sum += power[b];
+   assert(close_rel(sum, power[DSP_NUM_EEG_BANDS], 1e-4));
+   dsp_band_tracker_destroy(&t);
+   printf("OK\n");
+}
+
+int main(){
+   test_fft_power();
+   test_windows();
+   test_spectral_scaling();
+   test_spectral_welch();
+   test_spectral_stream();
+   test_work_pool();
+   test_work_pool_job_handoff();
+   test_spectral_bank();
+   test_biquad_cascade();
+   test_biquad_eeg_response();
+   test_decimator();
+   test_decim_chain();
+   test_band_tracker_init();
+   test_band_tracker_values();
+   test_band_tracker_thread();
+   test_psd_band_powers();
+   test_band_edges();
+   return 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file test_metrics.c
+ * @brief Tests for the built-in metrics (metrics.c), built with EEG_METRICS.
+ *
+ * This file contains tests for:
+ * - Values in/out/dropped and the high-water mark of spsc_ring_buffer and
+ *   ring_buffer, counted in the calling thread's slot
+ * - One cache-line-aligned slot per thread
+ * - Poller wait counts and latency histograms, pipeline step latencies
+ * - The JSON lines export: per-interval rates and watched rings
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "metrics.h"
+#include "ring_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "io_poll.h"
+#include "pipeline.h"
+
+static uint64_t count(const metrics_slot *slot, metrics_counter c){
+   return atomic_load(&slot->counters[c]);
+}
+
+/**
+ * Tests the counters and high-water mark of an SPSC ring that fills up.
+ *
+ * returns void
+*/
+void test_metrics_spsc(void){
+   printf("[TEST] Metrics of an SPSC ring buffer ... \n");
+   metrics_slot *slot = metrics_thread("spsc");
+   assert(slot && metrics_find("spsc") == slot);
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb && spsc_ring_buffer_init_pow2(rb, 64));
+   float values[64] = {0};
+   assert(spsc_ring_buffer_write_n(rb, values, 40) == 40);
+   assert(spsc_ring_buffer_read_n(rb, values, 10) == 10);
+   assert(spsc_ring_buffer_write_n(rb, values, 40) == 34); // 6 rejected
+   assert(count(slot, METRIC_SAMPLES_IN) == 74);
+   assert(count(slot, METRIC_SAMPLES_OUT) == 10);
+   assert(count(slot, METRIC_DROPS) == 6);
+   assert(atomic_load(&rb->high_water) == 64);
+
+   // in place, and one at a time
+   ring_buffer_span spans[2];
+   assert(spsc_ring_buffer_peek(rb, 20, spans) == 20);
+   assert(spsc_ring_buffer_release(rb, 20));
+   assert(spsc_ring_buffer_reserve(rb, 5, spans) == 5);
+   assert(spsc_ring_buffer_commit(rb, 5));
+   assert(spsc_ring_buffer_write(rb, 1.0f));
+   float v;
+   assert(spsc_ring_buffer_read(rb, &v));
+   assert(count(slot, METRIC_SAMPLES_IN) == 80);
+   assert(count(slot, METRIC_SAMPLES_OUT) == 31);
+   assert(atomic_load(&rb->high_water) == 64);
+   spsc_ring_buffer_destroy(rb);
+   printf("OK\n");
+}
+
+/**
+ * Tests the counters of a single-threaded ring buffer that overwrites.
+ *
+ * returns void
+*/
+void test_metrics_ring_buffer(void){
+   printf("[TEST] Metrics of a ring buffer ... \n");
+   const metrics_slot *slot = metrics_find("spsc"); // same thread
+   uint64_t in = count(slot, METRIC_SAMPLES_IN);
+   uint64_t drops = count(slot, METRIC_DROPS);
+   ring_buffer *rb = malloc(sizeof(ring_buffer));
+   assert(rb && ring_buffer_init(rb, 16));
+   assert(ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_OVERWRITE));
+   float values[24] = {0};
+   assert(ring_buffer_write_n(rb, values, 10) == 10);
+   assert(atomic_load(&rb->high_water) == 10);
+   assert(ring_buffer_write_n(rb, values, 10) == 10); // 4 oldest dropped
+   assert(ring_buffer_read_n(rb, values, 12) == 12);
+   assert(count(slot, METRIC_SAMPLES_IN) == in + 20);
+   assert(count(slot, METRIC_DROPS) == drops + 4);
+   assert(atomic_load(&rb->high_water) == 16);
+   ring_buffer_destroy(rb);
+   printf("OK\n");
+}
+
+typedef struct {
+   int n;
+   bool named;
+   metrics_slot *slot;
+} worker_args;
+
+static void *worker(void *arg){
+   worker_args *w = (worker_args *)arg;
+   if (w->named) METRICS_THREAD("worker");
+   for (int i = 0; i < w->n; i++) METRICS_ADD(METRIC_SAMPLES_IN, 1);
+   w->slot = metrics_current;
+   return NULL;
+}
+
+/**
+ * Tests that threads count in their own slots, on separate cache lines, and
+ * that a thread without METRICS_THREAD() gets a slot on its first metric.
+ *
+ * returns void
+*/
+void test_metrics_threads(void){
+   printf("[TEST] Metrics slots per thread ... \n");
+   worker_args args[2] = { { 100000, true, NULL }, { 250000, false, NULL } };
+   pthread_t threads[2];
+   for (int i = 0; i < 2; i++) assert(pthread_create(&threads[i], NULL, worker, &args[i]) == 0);
+   for (int i = 0; i < 2; i++) assert(pthread_join(threads[i], NULL) == 0);
+   assert(args[0].slot != args[1].slot);
+   for (int i = 0; i < 2; i++){
+      assert((uintptr_t)args[i].slot % RB_CACHE_LINE_SIZE == 0);
+      assert(count(args[i].slot, METRIC_SAMPLES_IN) == (uint64_t)args[i].n);
+   }
+   assert(sizeof(metrics_slot) % RB_CACHE_LINE_SIZE == 0);
+   assert(metrics_find("worker") == args[0].slot);
+   assert(strcmp(args[1].slot->name, "thread") == 0);
+   printf("OK\n");
+}
+
+/**
+ * Tests poller wait counts and the latency histogram.
+ *
+ * returns void
+*/
+void test_metrics_latency(void){
+   printf("[TEST] Metrics wait calls and latency ... \n");
+   metrics_slot *slot = metrics_thread("latency");
+   int fds[2];
+   assert(pipe(fds) == 0);
+   io_poller poller;
+   assert(io_poller_init(&poller));
+   assert(io_poller_add(&poller, fds[0], 1, NULL));
+   void *ready[1];
+   assert(io_poller_wait(&poller, 0, ready, 1) == 0);
+   assert(io_poller_wait(&poller, 0, ready, 1) == 0);
+   assert(count(slot, METRIC_WAIT_CALLS) == 2);
+   io_poller_close(&poller);
+   close(fds[0]);
+   close(fds[1]);
+
+   struct timespec pause = { 0, 2000000L };
+   for (int i = 0; i < 3; i++){
+      METRICS_TIMER_START(t);
+      nanosleep(&pause, NULL);
+      METRICS_TIMER_STOP(t);
+   }
+   assert(atomic_load(&slot->latency_count) == 3);
+   uint64_t in_buckets = 0;
+   int lowest = -1;
+   for (int b = 0; b < METRICS_LATENCY_BUCKETS; b++){
+      uint64_t n = atomic_load(&slot->latency[b]);
+      in_buckets += n;
+      if (n > 0 && lowest < 0) lowest = b;
+   }
+   assert(in_buckets == 3);
+   assert(metrics_bucket_us(lowest) > 2000.0); // upper bound of a 2 ms sleep
+   printf("OK\n");
+}
+
+static int busy_step(pipeline_stage *stage, void *ctx){
+   (void)stage;
+   int *left = (int *)ctx;
+   if (*left == 0) return 0;
+   (*left)--;
+   return 1;
+}
+
+/**
+ * Tests that pipeline stages count under their stage name, one latency per
+ * step that did work.
+ *
+ * returns void
+*/
+void test_metrics_pipeline(void){
+   printf("[TEST] Metrics of pipeline stages ... \n");
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   int steps = 50;
+   pipeline_stage_config cfg = { "busy", PIPELINE_QOS_DEFAULT, 200, busy_step, NULL, &steps };
+   assert(pipeline_add_stage(p, &cfg));
+   assert(pipeline_start(p));
+   struct timespec run = { 0, 20000000L };
+   nanosleep(&run, NULL);
+   pipeline_stop(p);
+   const metrics_slot *slot = metrics_find("busy");
+   assert(slot);
+   assert(atomic_load(&slot->latency_count) == 50);
+   free(p);
+   printf("OK\n");
+}
+
+/**
+ * Tests the JSON lines: one per slot and ring, rates per interval.
+ *
+ * returns void
+*/
+void test_metrics_export(void){
+   printf("[TEST] Metrics JSON lines export ... \n");
+   spsc_ring_buffer *rb = malloc(sizeof(spsc_ring_buffer));
+   assert(rb && spsc_ring_buffer_init_pow2(rb, 128));
+   assert(metrics_watch_ring("watched", &rb->high_water, (unsigned int)rb->max_num_values));
+   metrics_thread("export");
+   float values[100] = {0};
+   assert(spsc_ring_buffer_write_n(rb, values, 100) == 100);
+
+   FILE *out = tmpfile();
+   assert(out);
+   metrics_export(out);
+   long first = ftell(out);
+   struct timespec pause = { 0, 10000000L };
+   nanosleep(&pause, NULL);
+   metrics_export(out); // nothing happened in between
+   char buf[16384];
+   rewind(out);
+   size_t n = fread(buf, 1, sizeof(buf) - 1, out);
+   buf[n] = '\0';
+   fclose(out);
+
+   assert(strstr(buf, "\"thread\":\"export\",\"samples_in_per_s\":"));
+   assert(strstr(buf, "\"thread\":\"busy\""));
+   assert(strstr(buf, "\"ring\":\"watched\",\"capacity\":128,\"high_water\":100}"));
+   char *second = buf + first;
+   char *line = strstr(second, "\"thread\":\"export\"");
+   assert(line);
+   assert(strncmp(strstr(line, "samples_in_per_s"), "samples_in_per_s\":0.0,", 22) == 0);
+   assert(strstr(strstr(buf, "\"thread\":\"latency\""), "\"latency_p50_us\":"));
+   // every line is one object
+   for (char *p = buf; *p; ){
+      char *end = strchr(p, '\n');
+      assert(end && p[0] == '{' && end[-1] == '}');
+      p = end + 1;
+   }
+   spsc_ring_buffer_destroy(rb);
+   printf("OK\n");
+}
+
+int main(){
+   test_metrics_spsc();
+   test_metrics_ring_buffer();
+   test_metrics_threads();
+   test_metrics_latency();
+   test_metrics_pipeline();
+   test_metrics_export();
+   return 0;
+}
@@ -0,0 +1,401 @@
+/**
+ * @file test_pipeline.c
+ * @brief Tests for the pipeline runtime and its stages (pipeline.c, pipeline_stages.c).
+ *
+ * This file contains tests for:
+ * - Stage configuration and limits
+ * - Stamps and latency, including frames dropped by an overwriting ring,
+ *   with the step functions called directly on the test thread
+ * - Traces: ingest and filter report each stamped batch with ordered
+ *   ready/consumed/produced times
+ * - Backpressure: a rejecting output ring counts drops at the stage
+ * - A threaded ingest -> filter -> spectral -> output run: every frame is
+ *   processed before pipeline_stop() returns, the PSD peak is right and
+ *   every stage measured its latency
+ * - The report lines
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include "pipeline.h"
+#include "pipeline_stages.h"
+#include "mc_ring_buffer.h"
+#include "test_helpers.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 256.0f
+#define NCH 4
+#define FFT 256
+#define HOP 64
+#define BINS (FFT / 2 + 1)
+
+static int dummy_step(pipeline_stage *stage, void *ctx){
+   (void)stage;
+   (void)ctx;
+   return 0;
+}
+
+static void *dummy_run(void *ctx){
+   (void)ctx;
+   return NULL;
+}
+
+// frame f of a 10 Hz sine on every channel, scaled by channel
+static void make_frames(float *frames, int first, int n){
+   for (int f = 0; f < n; f++){
+      float x = sinf(2.0f * (float)M_PI * 10.0f * (first + f) / SAMPLE_RATE);
+      for (int ch = 0; ch < NCH; ch++) frames[f * NCH + ch] = x * (ch + 1);
+   }
+}
+
+/**
+ * Tests stage configuration checks and the stage limit.
+ *
+ * returns void
+*/
+void test_pipeline_config(void){
+   printf("[TEST] Pipeline configuration ... \n");
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   assert(pipeline_start(p) == false); // no stages
+
+   pipeline_stage_config both = { "both", PIPELINE_QOS_DEFAULT, 0, dummy_step, dummy_run, NULL };
+   pipeline_stage_config neither = { "neither", PIPELINE_QOS_DEFAULT, 0, NULL, NULL, NULL };
+   pipeline_stage_config unnamed = { NULL, PIPELINE_QOS_DEFAULT, 0, dummy_step, NULL, NULL };
+   assert(pipeline_add_stage(p, &both) == NULL);
+   assert(pipeline_add_stage(p, &neither) == NULL);
+   assert(pipeline_add_stage(p, &unnamed) == NULL);
+
+   pipeline_stage_config ok = { "a_stage_name_longer_than_the_limit", PIPELINE_QOS_UTILITY, 0,
+                                dummy_step, NULL, NULL };
+   for (int i = 0; i < PIPELINE_MAX_STAGES; i++){
+      pipeline_stage *st = pipeline_add_stage(p, &ok);
+      assert(st);
+      assert(st->in_stamps == (i == 0 ? NULL : &p->stages[i - 1].out_stamps));
+      assert(st->idle_us == PIPELINE_IDLE_US);
+   }
+   assert(pipeline_add_stage(p, &ok) == NULL);
+   assert(strlen(p->stages[0].name) == PIPELINE_NAME_LEN - 1);
+
+   // threads start and stop, running twice is refused
+   assert(pipeline_start(p));
+   assert(pipeline_start(p) == false);
+   pipeline_stop(p);
+   assert(p->running == false);
+   free(p);
+   printf("OK\n");
+}
+
+/**
+ * Calls the stages by hand: ingest stamps survive an overwriting ring and
+ * reach the filter, latency is measured once per forwarded stamp.
+ *
+ * returns void
+*/
+void test_pipeline_stamps(void){
+   printf("[TEST] Pipeline stamps and latency ... \n");
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   pipeline_stage_config ingest_cfg = { "ingest", PIPELINE_QOS_DEFAULT, 0, NULL, dummy_run, NULL };
+   pipeline_stage_config filter_cfg = { "filter", PIPELINE_QOS_DEFAULT, 0, filter_stage_step, NULL, NULL };
+   pipeline_stage *ingest = pipeline_add_stage(p, &ingest_cfg);
+   pipeline_stage *filt = pipeline_add_stage(p, &filter_cfg);
+
+   mc_ring_buffer *raw = malloc(sizeof(mc_ring_buffer));
+   mc_ring_buffer *filtered = malloc(sizeof(mc_ring_buffer));
+   assert(raw && filtered);
+   assert(mc_ring_buffer_init(raw, NCH, 64));
+   assert(mc_ring_buffer_init(filtered, NCH, 1024));
+   mc_ring_buffer_set_overflow_policy(raw, RB_OVERFLOW_OVERWRITE, 0);
+   filter_stage filter;
+   assert(filter_stage_init(&filter, raw, filtered, SAMPLE_RATE, 60.0f, 1.0f, 40.0f));
+
+   // nothing to do yet
+   assert(filter_stage_step(filt, &filter) == 0);
+
+   // three batches of 50 frames into a 64 frame ring: 86 overwritten
+   float frames[50 * NCH];
+   for (int b = 0; b < 3; b++){
+      make_frames(frames, b * 50, 50);
+      int written = mc_ring_buffer_write_frames(raw, frames, 50);
+      pipeline_stage_ingested(ingest, written, 50 - written);
+   }
+   assert(atomic_load(&ingest->stats.frames_out) == 150);
+   assert(atomic_load(&ingest->stats.dropped) == 0);
+
+   // the 64 frames left are the end of batch 3: all three stamps are consumed
+   assert(filter_stage_step(filt, &filter) == 64);
+   assert(atomic_load(&filt->stats.frames_in) == 64);
+   assert(atomic_load(&filt->stats.frames_out) == 64);
+   assert(atomic_load(&filt->stats.latency_count) == 1);
+   assert(filt->out_frames == 64);
+   assert(filter_stage_step(filt, &filter) == 0);
+
+   // one more batch, one more stamp
+   make_frames(frames, 150, 40);
+   int written = mc_ring_buffer_write_frames(raw, frames, 40);
+   pipeline_stage_ingested(ingest, written, 40 - written);
+   assert(filter_stage_step(filt, &filter) == 40);
+   assert(atomic_load(&filt->stats.latency_count) == 2);
+   // the filter's stamps describe its own output
+   assert(filt->out_stamps.items[1].frame == 104);
+
+   filter_stage_destroy(&filter);
+   MC_SAFE_DESTROY(raw);
+   MC_SAFE_DESTROY(filtered);
+   free(p);
+   printf("OK\n");
+}
+
+typedef struct {
+   pipeline_trace traces[8];
+   int count;
+} trace_log;
+
+static void log_trace(const pipeline_trace *trace, void *ctx){
+   trace_log *log = (trace_log *)ctx;
+   if (log->count < 8) log->traces[log->count++] = *trace;
+}
+
+/**
+ * Traced ingest and filter stages: one record per stamped batch, the
+ * filter's record carries the ingest stamp and its ring dwell and step
+ * times are in order.
+ *
+ * returns void
+*/
+void test_pipeline_trace(void){
+   printf("[TEST] Pipeline traces ... \n");
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   pipeline_stage_config ingest_cfg = { "ingest", PIPELINE_QOS_DEFAULT, 0, NULL, dummy_run, NULL };
+   pipeline_stage_config filter_cfg = { "filter", PIPELINE_QOS_DEFAULT, 0, filter_stage_step, NULL, NULL };
+   pipeline_stage *ingest = pipeline_add_stage(p, &ingest_cfg);
+   pipeline_stage *filt = pipeline_add_stage(p, &filter_cfg);
+   static trace_log ingest_log, filter_log;
+   pipeline_stage_set_trace(ingest, log_trace, &ingest_log);
+   pipeline_stage_set_trace(filt, log_trace, &filter_log);
+
+   mc_ring_buffer *raw = malloc(sizeof(mc_ring_buffer));
+   mc_ring_buffer *filtered = malloc(sizeof(mc_ring_buffer));
+   assert(raw && filtered);
+   assert(mc_ring_buffer_init(raw, NCH, 256));
+   assert(mc_ring_buffer_init(filtered, NCH, 256));
+   filter_stage filter;
+   assert(filter_stage_init(&filter, raw, filtered, SAMPLE_RATE, 60.0f, 1.0f, 40.0f));
+
+   float frames[32 * NCH];
+   for (int b = 0; b < 2; b++){
+      make_frames(frames, b * 32, 32);
+      pipeline_stage_ingested(ingest, mc_ring_buffer_write_frames(raw, frames, 32), 0);
+   }
+   assert(ingest_log.count == 2);
+   assert(ingest_log.traces[1].frame == 64);
+   assert(ingest_log.traces[1].ready_ns == ingest_log.traces[1].ingest_ns);
+   assert(ingest_log.traces[1].produced_ns == ingest_log.traces[1].ingest_ns);
+
+   // both batches in one step: one record, with the newest ingest stamp
+   assert(filter_stage_step(filt, &filter) == 64);
+   assert(filter_log.count == 1);
+   pipeline_trace t = filter_log.traces[0];
+   assert(t.frame == 64 && t.ingest_ns == ingest_log.traces[1].ingest_ns);
+   assert(t.ready_ns == t.ingest_ns);
+   assert(t.ready_ns <= t.consumed_ns && t.consumed_ns <= t.produced_ns);
+   // the next stage sees when the filter wrote its output
+   assert(filt->out_stamps.items[0].ready_ns == t.produced_ns);
+
+   filter_stage_destroy(&filter);
+   MC_SAFE_DESTROY(raw);
+   MC_SAFE_DESTROY(filtered);
+   free(p);
+   printf("OK\n");
+}
+
+/**
+ * A rejecting output ring: PSD frames that do not fit are counted as
+ * dropped by the spectral stage, which itself never waits.
+ *
+ * returns void
+*/
+void test_pipeline_backpressure(void){
+   printf("[TEST] Pipeline rejecting edge counts drops ... \n");
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   pipeline_stage_config cfg = { "spectral", PIPELINE_QOS_DEFAULT, 0, spectral_stage_step, NULL, NULL };
+   pipeline_stage *stage = pipeline_add_stage(p, &cfg);
+
+   mc_ring_buffer *in = malloc(sizeof(mc_ring_buffer));
+   mc_ring_buffer *out = malloc(sizeof(mc_ring_buffer));
+   assert(in && out);
+   assert(mc_ring_buffer_init(in, NCH, 4096));
+   assert(mc_ring_buffer_init(out, NCH * BINS, 4));
+   mc_ring_buffer_set_overflow_policy(out, RB_OVERFLOW_REJECT, 0);
+   spectral_stage spectral;
+   assert(spectral_stage_init(&spectral, in, in, FFT, HOP, DSP_WINDOW_HANN, 1, SAMPLE_RATE) == false);
+   assert(spectral_stage_init(&spectral, in, out, FFT, HOP, DSP_WINDOW_HANN, 1, SAMPLE_RATE));
+
+   // 256 + 9 hops: 10 PSD frames, 4 fit
+   int total = FFT + 9 * HOP;
+   float *frames = malloc(sizeof(float) * total * NCH);
+   assert(frames);
+   make_frames(frames, 0, total);
+   assert(mc_ring_buffer_write_frames(in, frames, total) == total);
+   while (spectral_stage_step(stage, &spectral) > 0){
+   }
+   assert(mc_ring_buffer_num_frames(out) == 4);
+   assert(atomic_load(&stage->stats.frames_out) == 4);
+   assert(atomic_load(&stage->stats.dropped) == 6);
+
+   free(frames);
+   spectral_stage_destroy(&spectral);
+   MC_SAFE_DESTROY(in);
+   MC_SAFE_DESTROY(out);
+   free(p);
+   printf("OK\n");
+}
+
+#define RUN_FRAMES (FFT + 80 * HOP)
+#define RUN_BATCH 32
+
+typedef struct {
+   mc_ring_buffer *ring;
+   pipeline_stage *stage;
+} producer_ctx;
+
+// ingest stand-in: writes all frames in batches, about one batch per 100 us
+static void *producer_run(void *arg){
+   producer_ctx *ctx = (producer_ctx *)arg;
+   float frames[RUN_BATCH * NCH];
+   struct timespec pause = { 0, 100000L };
+   for (int f = 0; f < RUN_FRAMES; f += RUN_BATCH){
+      make_frames(frames, f, RUN_BATCH);
+      int written = mc_ring_buffer_write_frames(ctx->ring, frames, RUN_BATCH);
+      pipeline_stage_ingested(ctx->stage, written, RUN_BATCH - written);
+      nanosleep(&pause, NULL);
+   }
+   return NULL;
+}
+
+typedef struct {
+   int frames;
+   int peak_ok;
+} psd_check;
+
+static void check_psd(const float *psd, int num_channels, int num_bins, void *ctx){
+   psd_check *check = (psd_check *)ctx;
+   check->frames++;
+   int ok = 1;
+   for (int ch = 0; ch < num_channels; ch++){
+      const float *p = psd + ch * num_bins;
+      int peak = 0;
+      for (int k = 0; k < num_bins; k++) if (p[k] > p[peak]) peak = k;
+      if (peak != 10) ok = 0;
+   }
+   check->peak_ok += ok;
+}
+
+/**
+ * Runs the four stages on their own threads. pipeline_stop() right after
+ * the start still processes every frame: each stage is stopped only after
+ * the one before it has exited, then drains its input.
+ *
+ * returns void
+*/
+void test_pipeline_threads(void){
+   printf("[TEST] Pipeline threads ingest -> filter -> spectral -> output ... \n");
+   mc_ring_buffer *raw = malloc(sizeof(mc_ring_buffer));
+   mc_ring_buffer *filtered = malloc(sizeof(mc_ring_buffer));
+   mc_ring_buffer *spectra = malloc(sizeof(mc_ring_buffer));
+   assert(raw && filtered && spectra);
+   assert(mc_ring_buffer_init(raw, NCH, 1024));
+   assert(mc_ring_buffer_init(filtered, NCH, 1024));
+   assert(mc_ring_buffer_init(spectra, NCH * BINS, 8));
+   // lossless edges, so the counts are exact
+   mc_ring_buffer_set_overflow_policy(raw, RB_OVERFLOW_BLOCK, -1);
+   mc_ring_buffer_set_overflow_policy(filtered, RB_OVERFLOW_BLOCK, -1);
+   mc_ring_buffer_set_overflow_policy(spectra, RB_OVERFLOW_BLOCK, -1);
+
+   filter_stage filter;
+   spectral_stage spectral;
+   output_stage output;
+   psd_check check = { 0, 0 };
+   assert(filter_stage_init(&filter, raw, filtered, SAMPLE_RATE, 60.0f, 1.0f, 40.0f));
+   assert(spectral_stage_init(&spectral, filtered, spectra, FFT, HOP, DSP_WINDOW_HANN, 1, SAMPLE_RATE));
+   assert(output_stage_init(&output, spectra, NCH, check_psd, &check));
+
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   producer_ctx producer = { raw, NULL };
+   pipeline_stage_config cfgs[4] = {
+      { "ingest", PIPELINE_QOS_USER_INTERACTIVE, 0, NULL, producer_run, &producer },
+      { "filter", PIPELINE_QOS_USER_INITIATED, 100, filter_stage_step, NULL, &filter },
+      { "spectral", PIPELINE_QOS_UTILITY, 100, spectral_stage_step, NULL, &spectral },
+      { "output", PIPELINE_QOS_USER_INTERACTIVE, 100, output_stage_step, NULL, &output },
+   };
+   for (int i = 0; i < 4; i++){
+      pipeline_stage *st = pipeline_add_stage(p, &cfgs[i]);
+      assert(st);
+      if (i == 0) producer.stage = st;
+   }
+   assert(pipeline_start(p));
+   pipeline_stop(p);
+
+   int expected = 1 + (RUN_FRAMES - FFT) / HOP;
+   assert(check.frames == expected);
+   // the filter's transient settles within the first windows
+   assert(check.peak_ok >= expected - 4);
+   assert(atomic_load(&p->stages[1].stats.frames_out) == RUN_FRAMES);
+   for (int i = 1; i < 4; i++){
+      assert(atomic_load(&p->stages[i].stats.latency_count) > 0);
+      assert(atomic_load(&p->stages[i].stats.dropped) == 0);
+   }
+
+   // one report line per stage
+   FILE *out = tmpfile();
+   assert(out);
+   pipeline_report(p, out);
+   char buf[2048];
+   rewind(out);
+   size_t n = fread(buf, 1, sizeof(buf) - 1, out);
+   buf[n] = '\0';
+   assert(strstr(buf, "[pipeline] ingest: "));
+   assert(strstr(buf, "[pipeline] spectral: "));
+   assert(strstr(buf, "[pipeline] output: "));
+   assert(strstr(buf, "latency mean "));
+   fclose(out);
+
+   filter_stage_destroy(&filter);
+   spectral_stage_destroy(&spectral);
+   output_stage_destroy(&output);
+   MC_SAFE_DESTROY(raw);
+   MC_SAFE_DESTROY(filtered);
+   MC_SAFE_DESTROY(spectra);
+   free(p);
+   printf("OK\n");
+}
+
+int main(){
+   test_pipeline_config();
+   test_pipeline_stamps();
+   test_pipeline_trace();
+   test_pipeline_backpressure();
+   test_pipeline_threads();
+   return 0;
+}
@@ -0,0 +1,253 @@
+/**
+ * @file test_recording.c
+ * @brief Tests for the session recorder and the memory-mapped reader (recording.c).
+ *
+ * This file contains tests for:
+ * - Round trip: packets pushed on one thread, chunks written by the
+ *   recorder thread, frames read back in place from the mapping
+ * - Gaps: a packet the recorder cannot take is dropped whole and the next
+ *   chunk starts after it
+ * - Seeking by time with the index footer
+ * - An unfinished file (no footer) whose index is rebuilt from the chunks
+ * - Files that are not recordings
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "recording.h"
+
+#define NCH 4
+#define CHUNK 64
+#define PACKET 10
+#define PACKETS 50
+#define RATE 100000.0f   // 10 frames = 100 us, the pause between pushes
+
+static float sample(uint64_t frame, int ch){
+   return (float)frame * 0.5f + (float)ch;
+}
+
+static void make_packet(float *frames, uint64_t first){
+   for (int f = 0; f < PACKET; f++){
+      for (int ch = 0; ch < NCH; ch++) frames[f * NCH + ch] = sample(first + (uint64_t)f, ch);
+   }
+}
+
+// records PACKETS packets, about one per 100 us
+static void record_session(const char *path){
+   recorder r;
+   assert(recorder_open(&r, path, NCH, RATE, CHUNK, 1024));
+   float frames[PACKET * NCH];
+   struct timespec pause = { 0, 100000L };
+   for (int p = 0; p < PACKETS; p++){
+      make_packet(frames, (uint64_t)p * PACKET);
+      assert(recorder_push(&r, frames, PACKET, (uint16_t)p));
+      nanosleep(&pause, NULL);
+   }
+   assert(recorder_close(&r));
+   assert(atomic_load(&r.frames_dropped) == 0);
+   assert(atomic_load(&r.frames_written) == PACKETS * PACKET);
+}
+
+static void temp_path(char *path, size_t size, const char *name){
+   snprintf(path, size, "/tmp/eeg_%s_%d.rec", name, (int)getpid());
+}
+
+/**
+ * Tests that every pushed frame is read back in order from the mapping, in
+ * full chunks except the last.
+ *
+ * returns void
+*/
+void test_recording_round_trip(void){
+   printf("[TEST] Recording round trip ... \n");
+   char path[128];
+   temp_path(path, sizeof(path), "round_trip");
+   record_session(path);
+
+   recording rec;
+   assert(recording_open(&rec, path));
+   assert(rec.finalized);
+   assert(rec.header->num_channels == NCH);
+   assert(rec.header->frames_per_chunk == CHUNK);
+   assert(rec.header->sample_rate == RATE);
+   assert(rec.num_chunks == (PACKETS * PACKET + CHUNK - 1) / CHUNK);
+
+   uint64_t frame = 0;
+   uint64_t last_ts = 0;
+   for (uint64_t c = 0; c < rec.num_chunks; c++){
+      const float *frames;
+      const recording_chunk_header *hdr = recording_chunk(&rec, c, &frames);
+      assert(hdr && hdr->magic == RECORDING_CHUNK_MAGIC);
+      assert(hdr->first_frame == frame);
+      assert(hdr->first_seq == frame / PACKET);
+      assert(hdr->timestamp_ns >= last_ts && hdr->timestamp_ns >= rec.header->start_ns);
+      assert(rec.index[c].timestamp_ns == hdr->timestamp_ns);
+      assert(rec.index[c].first_frame == hdr->first_frame);
+      uint32_t expected = c + 1 < rec.num_chunks ? CHUNK : (PACKETS * PACKET) % CHUNK;
+      assert(hdr->num_frames == expected);
+      for (uint32_t f = 0; f < hdr->num_frames; f++){
+         for (int ch = 0; ch < NCH; ch++) assert(frames[f * NCH + ch] == sample(frame + f, ch));
+      }
+      frame += hdr->num_frames;
+      last_ts = hdr->timestamp_ns;
+   }
+   assert(recording_chunk(&rec, rec.num_chunks, NULL) == NULL);
+   recording_close(&rec);
+   unlink(path);
+   printf("OK\n");
+}
+
+/**
+ * Tests that a packet larger than the recorder's ring is dropped whole and
+ * the recording continues in a new chunk after the gap.
+ *
+ * returns void
+*/
+void test_recording_gap(void){
+   printf("[TEST] Recording gap after a dropped packet ... \n");
+   char path[128];
+   temp_path(path, sizeof(path), "gap");
+   recorder r;
+   assert(!recorder_open(&r, path, 0, RATE, CHUNK, 32));
+   assert(recorder_open(&r, path, NCH, RATE, CHUNK, 32));
+   float frames[40 * NCH];
+   make_packet(frames, 0);
+   assert(recorder_push(&r, frames, PACKET, 0));
+   assert(!recorder_push(&r, frames, 40, 1));  // more than the ring holds
+   make_packet(frames, 50);
+   assert(recorder_push(&r, frames, PACKET, 2));
+   assert(recorder_close(&r));
+   assert(atomic_load(&r.frames_dropped) == 40);
+
+   recording rec;
+   assert(recording_open(&rec, path));
+   assert(rec.num_chunks == 2);
+   const float *data;
+   const recording_chunk_header *hdr = recording_chunk(&rec, 0, &data);
+   assert(hdr->first_frame == 0 && hdr->num_frames == PACKET && hdr->first_seq == 0);
+   hdr = recording_chunk(&rec, 1, &data);
+   assert(hdr->first_frame == 50 && hdr->num_frames == PACKET && hdr->first_seq == 2);
+   assert(data[0] == sample(50, 0));
+   recording_close(&rec);
+   unlink(path);
+   printf("OK\n");
+}
+
+/**
+ * Tests seeking to chunk starts, into a chunk, before the start and past
+ * the end.
+ *
+ * returns void
+*/
+void test_recording_seek(void){
+   printf("[TEST] Recording seek by time ... \n");
+   char path[128];
+   temp_path(path, sizeof(path), "seek");
+   record_session(path);
+   recording rec;
+   assert(recording_open(&rec, path));
+   uint64_t start = rec.header->start_ns;
+   recording_pos pos;
+
+   assert(recording_seek(&rec, 0, &pos));
+   assert(pos.chunk == 0 && pos.frame == 0);
+   for (uint64_t c = 0; c < rec.num_chunks; c++){
+      assert(recording_seek(&rec, rec.index[c].timestamp_ns - start, &pos));
+      assert(pos.chunk == c && pos.frame == 0);
+   }
+   // 5 frames into chunk 2: chunks are several 100 us pushes apart
+   uint64_t t = rec.index[2].timestamp_ns - start + (uint64_t)(5.5e9 / RATE);
+   assert(recording_seek(&rec, t, &pos));
+   assert(pos.chunk == 2 && pos.frame == 5);
+   uint64_t last = rec.index[rec.num_chunks - 1].timestamp_ns - start;
+   assert(!recording_seek(&rec, last + 1000000000ull, &pos));
+   recording_close(&rec);
+   unlink(path);
+   printf("OK\n");
+}
+
+/**
+ * Tests a recording cut off before its footer (and in the middle of a
+ * chunk): the whole chunks are still found.
+ *
+ * returns void
+*/
+void test_recording_unfinished(void){
+   printf("[TEST] Recording without footer ... \n");
+   char path[128], cut[128];
+   temp_path(path, sizeof(path), "full");
+   temp_path(cut, sizeof(cut), "cut");
+   record_session(path);
+
+   recording rec;
+   assert(recording_open(&rec, path));
+   size_t whole = rec.header->header_size + 5 * (size_t)rec.header->chunk_size;
+   size_t len = whole + rec.header->chunk_size / 2;
+   int fd = open(cut, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   assert(fd != -1);
+   assert(write(fd, rec.map, len) == (ssize_t)len);
+   close(fd);
+
+   recording partial;
+   assert(recording_open(&partial, cut));
+   assert(!partial.finalized);
+   assert(partial.num_chunks == 5);
+   for (uint64_t c = 0; c < 5; c++){
+      assert(partial.index[c].timestamp_ns == rec.index[c].timestamp_ns);
+      assert(partial.index[c].first_frame == c * CHUNK);
+   }
+   const float *frames;
+   assert(recording_chunk(&partial, 4, &frames));
+   assert(frames[0] == sample(4 * CHUNK, 0));
+   recording_close(&partial);
+   recording_close(&rec);
+   unlink(path);
+   unlink(cut);
+   printf("OK\n");
+}
+
+/**
+ * Tests that files which are not recordings are refused.
+ *
+ * returns void
+*/
+void test_recording_invalid(void){
+   printf("[TEST] Recording rejects other files ... \n");
+   char path[128];
+   temp_path(path, sizeof(path), "invalid");
+   recording rec;
+   assert(!recording_open(&rec, path)); // does not exist
+
+   uint8_t junk[256];
+   memset(junk, 0x5A, sizeof(junk));
+   int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   assert(fd != -1);
+   assert(write(fd, junk, 16) == 16);  // shorter than a header
+   close(fd);
+   assert(!recording_open(&rec, path));
+   fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   assert(write(fd, junk, sizeof(junk)) == (ssize_t)sizeof(junk));
+   close(fd);
+   assert(!recording_open(&rec, path));
+   unlink(path);
+   printf("OK\n");
+}
+
+int main(){
+   test_recording_round_trip();
+   test_recording_gap();
+   test_recording_seek();
+   test_recording_unfinished();
+   test_recording_invalid();
+   return 0;
+}
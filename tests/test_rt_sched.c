@@ -0,0 +1,192 @@
+/**
+ * @file test_rt_sched.c
+ * @brief Tests for the scheduling policies and jitter histograms (rt_sched.c)
+ * and the per-stage jitter report of the pipeline.
+ *
+ * This file contains tests for:
+ * - Histogram buckets and percentiles
+ * - Applying policies: no-op, invalid, and core pinning on Linux
+ * - Stage threads recording their wakeup latency, a refused policy in the
+ *   report
+ *
+ * Real-time policies may be refused without privileges, so the tests only
+ * require that a refusal is reported, not that the policy is granted.
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE  // sched_getcpu
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "rt_sched.h"
+#include "pipeline.h"
+
+/**
+ * Tests bucket placement and percentiles of the jitter histogram.
+ *
+ * returns void
+*/
+void test_jitter_histogram(void){
+   printf("[TEST] Jitter histogram buckets and percentiles ... \n");
+   rt_jitter j;
+   rt_jitter_snapshot s;
+   rt_jitter_init(&j);
+   rt_jitter_read(&j, &s);
+   assert(s.count == 0);
+   assert(rt_jitter_percentile_us(&s, 99.0) == 0);
+
+   // 90 below 1 us, 9 at 3 us, 1 at 100 us
+   for (int i = 0; i < 90; i++) rt_jitter_record(&j, 500);
+   for (int i = 0; i < 9; i++) rt_jitter_record(&j, 3000);
+   rt_jitter_record(&j, 100000);
+   rt_jitter_read(&j, &s);
+   assert(s.count == 100);
+   assert(s.buckets[0] == 90);
+   assert(s.buckets[2] == 9);   // [2, 4) us
+   assert(s.buckets[7] == 1);   // [64, 128) us
+   assert(s.max_ns == 100000);
+   assert(s.sum_ns == 90 * 500 + 9 * 3000 + 100000);
+   assert(rt_jitter_percentile_us(&s, 50.0) == 1);
+   assert(rt_jitter_percentile_us(&s, 90.0) == 1);
+   assert(rt_jitter_percentile_us(&s, 95.0) == 4);
+   assert(rt_jitter_percentile_us(&s, 99.5) == 128);
+   assert(rt_jitter_percentile_us(&s, 100.0) == 128);
+
+   // the last bucket is open ended and reports the maximum
+   rt_jitter_record(&j, 5000000000ull);
+   rt_jitter_read(&j, &s);
+   assert(s.buckets[RT_JITTER_BUCKETS - 1] == 1);
+   assert(rt_jitter_percentile_us(&s, 100.0) == 5000000);
+   printf("OK\n");
+}
+
+typedef struct {
+   rt_sched_policy policy;
+   bool applied;
+   int cpu;
+} apply_ctx;
+
+static void *apply_thread(void *arg){
+   apply_ctx *ctx = (apply_ctx *)arg;
+   ctx->applied = rt_sched_apply(&ctx->policy);
+#if defined(__linux__)
+   ctx->cpu = sched_getcpu();
+#endif
+   return NULL;
+}
+
+static bool apply_on_thread(apply_ctx *ctx){
+   pthread_t thread;
+   assert(pthread_create(&thread, NULL, apply_thread, ctx) == 0);
+   pthread_join(thread, NULL);
+   return ctx->applied;
+}
+
+/**
+ * Tests that empty policies are no-ops, invalid ones are refused and, on
+ * Linux, that a pinned thread runs on its CPU.
+ *
+ * returns void
+*/
+void test_sched_apply(void){
+   printf("[TEST] Applying scheduling policies ... \n");
+   apply_ctx ctx;
+   memset(&ctx, 0, sizeof(ctx));
+   assert(rt_sched_apply(NULL));
+   assert(apply_on_thread(&ctx));
+   assert(strcmp(rt_sched_name(&ctx.policy), "default") == 0);
+
+   // no CPU time requested (macOS) and a priority out of range (Linux)
+   ctx.policy.realtime = true;
+   ctx.policy.priority = 1000;
+   assert(!apply_on_thread(&ctx));
+   assert(strcmp(rt_sched_name(&ctx.policy), "default") != 0);
+
+#if defined(__linux__)
+   int cpu = sched_getcpu();
+   assert(cpu >= 0);
+   if (cpu < 64){
+      memset(&ctx, 0, sizeof(ctx));
+      ctx.policy.cpu_mask = (uint64_t)1 << cpu;
+      assert(apply_on_thread(&ctx));
+      assert(ctx.cpu == cpu);
+   }
+#endif
+   printf("OK\n");
+}
+
+static int idle_step(pipeline_stage *stage, void *ctx){
+   (void)stage;
+   (void)ctx;
+   return 0;
+}
+
+/**
+ * Runs idle step stages for a while: each sleep is one wakeup in the
+ * stage's histogram, and the report shows both the policy and a refusal.
+ *
+ * returns void
+*/
+void test_pipeline_jitter(void){
+   printf("[TEST] Pipeline stage jitter report ... \n");
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   pipeline_stage_config idle = { "idle", PIPELINE_QOS_DEFAULT, 200, idle_step, NULL, NULL };
+   pipeline_stage_config refused = { "refused", PIPELINE_QOS_UTILITY, 200, idle_step, NULL, NULL };
+   assert(pipeline_add_stage(p, &idle));
+   pipeline_stage *stage = pipeline_add_stage(p, &refused);
+   assert(stage);
+   rt_sched_policy invalid = {0};
+   invalid.realtime = true;
+   invalid.priority = 1000;
+   pipeline_stage_set_sched(stage, &invalid);
+
+   assert(pipeline_start(p));
+   struct timespec run = { 0, 20000000L };
+   nanosleep(&run, NULL);
+   pipeline_stop(p);
+
+   rt_jitter_snapshot s;
+   for (int i = 0; i < 2; i++){
+      rt_jitter_read(&p->stages[i].jitter, &s);
+      assert(s.count > 0);
+      assert(s.max_ns >= s.sum_ns / s.count);
+   }
+   assert(atomic_load(&p->stages[0].sched_ok));
+   assert(!atomic_load(&p->stages[1].sched_ok));
+
+   FILE *out = tmpfile();
+   assert(out);
+   pipeline_report_jitter(p, out);
+   char buf[1024];
+   rewind(out);
+   size_t n = fread(buf, 1, sizeof(buf) - 1, out);
+   buf[n] = '\0';
+   assert(strstr(buf, "[jitter] idle (default): "));
+   assert(strstr(buf, "[jitter] refused ("));
+   assert(strstr(buf, ", refused): "));
+   assert(strstr(buf, " wakeups, p50 < "));
+   fclose(out);
+
+   free(p);
+   printf("OK\n");
+}
+
+int main(){
+   test_jitter_histogram();
+   test_sched_apply();
+   test_pipeline_jitter();
+   return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file test_sample_clock.c
+ * @brief Tests for the sample clock recovery and gap fill (sample_clock.c).
+ *
+ * This file contains tests for:
+ * - Invalid arguments, the nominal rate before the fit has settled, sample
+ *   times on the fitted line
+ * - Sequence tracking: gaps to fill, the 16-bit wrap, gaps too long to
+ *   fill and a board reset (sequence going backwards)
+ * - Rate recovery from batch timestamps with one-sided arrival jitter, for
+ *   a board running fast and one running slow
+ * - Interpolated fill, whole and in pieces
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include "sample_clock.h"
+
+#define NOMINAL_RATE 250.0
+#define FRAMES 32
+
+static unsigned int next_random(unsigned int *state){
+   *state = *state * 1103515245u + 12345u;
+   return (*state >> 8) & 0xffff;
+}
+
+/**
+ * Tests init arguments and that the nominal rate is reported until enough
+ * batches have been seen.
+ *
+ * returns void
+*/
+void test_clock_init(void){
+   printf("[TEST] Sample clock initialization ... \n");
+   sample_clock c;
+   assert(sample_clock_init(&c, 0.0, 10) == false);
+   assert(sample_clock_init(&c, -250.0, 10) == false);
+   assert(sample_clock_init(&c, NOMINAL_RATE, -1) == false);
+   assert(sample_clock_init(&c, NOMINAL_RATE, 0));
+   assert(sample_clock_rate(&c) == NOMINAL_RATE);
+   assert(sample_clock_drift_ppm(&c) == 0.0);
+   uint64_t t;
+   assert(!sample_clock_time_ns(&c, 0, &t));
+
+   // a few exact batches: still nominal below SAMPLE_CLOCK_MIN_OBSERVATIONS
+   for (int i = 0; i < SAMPLE_CLOCK_MIN_OBSERVATIONS - 1; i++){
+      assert(sample_clock_packet(&c, (uint16_t)i, FRAMES) == 0);
+      sample_clock_observe(&c, (uint64_t)((i + 1) * FRAMES * 1e9 / 200.0));
+   }
+   assert(sample_clock_rate(&c) == NOMINAL_RATE);
+   assert(sample_clock_packet(&c, SAMPLE_CLOCK_MIN_OBSERVATIONS - 1, FRAMES) == 0);
+   sample_clock_observe(&c, (uint64_t)(SAMPLE_CLOCK_MIN_OBSERVATIONS * FRAMES * 1e9 / 200.0));
+   assert(fabs(sample_clock_rate(&c) - 200.0) < 1e-6);
+   // on the fitted line: sample 0 was taken at time 0, sample 1000 at 5 s
+   assert(sample_clock_time_ns(&c, 0, &t) && t < 1000);
+   assert(sample_clock_time_ns(&c, 1000, &t) && llabs((long long)t - 5000000000ll) < 1000);
+   printf("OK\n");
+}
+
+/**
+ * Gaps up to max_fill_frames are returned for filling, the sequence wraps
+ * at 65536 without a gap, longer gaps are resyncs that still advance the
+ * index, and a sequence going backwards restarts the index and the fit.
+ *
+ * returns void
+*/
+void test_clock_gaps(void){
+   printf("[TEST] Sample clock gaps and resyncs ... \n");
+   sample_clock c;
+   assert(sample_clock_init(&c, NOMINAL_RATE, 3 * FRAMES));
+   assert(sample_clock_packet(&c, 65533, FRAMES) == 0); // first packet: nothing to fill
+   assert(sample_clock_packet(&c, 65534, FRAMES) == 0);
+   assert(sample_clock_packet(&c, 65535, FRAMES) == 0);
+   assert(sample_clock_packet(&c, 0, FRAMES) == 0);     // wrap
+   assert(c.next_index == 4 * FRAMES);
+
+   // one packet lost, then three
+   assert(sample_clock_packet(&c, 2, FRAMES) == FRAMES);
+   assert(c.next_index == 6 * FRAMES);
+   assert(sample_clock_packet(&c, 6, FRAMES) == 3 * FRAMES);
+   assert(c.gaps == 2 && c.frames_filled == 4 * FRAMES && c.resyncs == 0);
+
+   // four lost: too long, index still moves past them
+   assert(sample_clock_packet(&c, 11, FRAMES) == 0);
+   assert(c.resyncs == 1 && c.gaps == 2);
+   assert(c.next_index == 15 * FRAMES);
+
+   // board reset: back to seq 0, index and fit restart
+   for (int i = 0; i < 2 * SAMPLE_CLOCK_MIN_OBSERVATIONS; i++){
+      sample_clock_observe(&c, (uint64_t)i * 1000000u);
+   }
+   assert(c.observations > 0);
+   assert(sample_clock_packet(&c, 0, FRAMES) == 0);
+   assert(c.resyncs == 2);
+   assert(c.next_index == FRAMES);
+   assert(c.observations == 0);
+   assert(sample_clock_rate(&c) == NOMINAL_RATE);
+   printf("OK\n");
+}
+
+/**
+ * A board whose crystal runs off by a known ppm sends batches of 1..3
+ * packets; every batch timestamp is late by a random 0..4 ms (USB frames,
+ * scheduling). After a few minutes of stream the estimate is within a few
+ * ppm of the true rate, for a fast and a slow board.
+ *
+ * returns void
+*/
+void test_clock_rate(void){
+   printf("[TEST] Sample clock rate recovery ... \n");
+   const double drift_ppm[2] = { 150.0, -420.0 };
+   for (int run = 0; run < 2; run++){
+      double true_rate = NOMINAL_RATE * (1.0 + drift_ppm[run] * 1e-6);
+      sample_clock c;
+      assert(sample_clock_init(&c, NOMINAL_RATE, 0));
+      unsigned int seed = 7 + run;
+      uint64_t start_ns = 123456789000ull; // host clock does not start at 0
+      uint16_t seq = 60000;                // and the sequence wraps on the way
+      for (int batch = 0; batch < 6000; batch++){
+         int packets = 1 + (int)(next_random(&seed) % 3);
+         for (int p = 0; p < packets; p++) assert(sample_clock_packet(&c, seq++, FRAMES) == 0);
+         double sampled_ns = (double)c.next_index * 1e9 / true_rate;
+         double late_ns = (next_random(&seed) / 65536.0) * 4e6;
+         sample_clock_observe(&c, start_ns + (uint64_t)(sampled_ns + late_ns));
+      }
+      double ppm = sample_clock_drift_ppm(&c);
+      assert(fabs(ppm - drift_ppm[run]) < 5.0);
+      assert(fabs(sample_clock_rate(&c) - true_rate) < 5e-6 * NOMINAL_RATE);
+   }
+   printf("OK\n");
+}
+
+/**
+ * The fill is a straight line between the frames around the gap, per
+ * channel, rounded to codes; filling in pieces gives the same frames.
+ *
+ * returns void
+*/
+void test_clock_fill(void){
+   printf("[TEST] Sample clock interpolated fill ... \n");
+   const int16_t before[2] = { 100, 900 };
+   const int16_t after[2] = { 200, 0 };
+   int16_t whole[9 * 2];
+   sample_clock_fill_codes(before, after, 2, 9, 0, 9, whole);
+   for (int f = 0; f < 9; f++){
+      assert(whole[2 * f] == 100 + 10 * (f + 1));
+      assert(whole[2 * f + 1] == 900 - 90 * (f + 1));
+   }
+
+   int16_t pieces[9 * 2];
+   sample_clock_fill_codes(before, after, 2, 9, 0, 4, pieces);
+   sample_clock_fill_codes(before, after, 2, 9, 4, 5, pieces + 4 * 2);
+   for (int i = 0; i < 9 * 2; i++) assert(pieces[i] == whole[i]);
+
+   // a single frame lands half way, rounded
+   int16_t mid[1];
+   const int16_t lo[1] = { 0 }, hi[1] = { 3 };
+   sample_clock_fill_codes(lo, hi, 1, 1, 0, 1, mid);
+   assert(mid[0] == 2);
+   printf("OK\n");
+}
+
+int main(){
+   test_clock_init();
+   test_clock_gaps();
+   test_clock_rate();
+   test_clock_fill();
+   return 0;
+}
@@ -1,14 +1,960 @@
 // Tests/mock for serial data handling
 
-/* tests that will involve mocking serial data (simulating microcontroller input)
-instead of reading real data from the Arduino, we simulate fake EEG-like data streams
-inside the test and pretend i'm receiving bytes from the serial port. This can allow
-testing w/o needing Arduino physically connected. This can also allow testing edge cases
-like noisy data or unexpected behavior. 
+/**
+ * @file test_serial.c
+ * @brief Tests for the framed serial packet protocol (serial_protocol.c),
+ * the serial reader and its byte sources (serial_source.c).
+ *
+ * Packets are encoded in memory the same way the firmware builds them and
+ * fed to the parser in chunks of various sizes, including:
+ * - CRC-16/CCITT-FALSE check value
+ * - Round trip of a packet fed whole and one byte at a time
+ * - Several packets in one chunk
+ * - Garbage before and between packets (resync)
+ * - Corrupted and truncated packets, stray sync words in the garbage
+ * - Sequence number gaps and the 16-bit wraparound
+ * - The poller reporting the ready one of several pipes
+ * - The serial_reader thread on a pipe standing in for the serial port:
+ *   packets split across writes at odd offsets, end of file and stop flag,
+ *   a packet with the wrong frame count dropped
+ * - The synthetic source on a pty at 100x real time: paced, complete,
+ *   hang-up at the end; faults (bursts, gaps, corrupted bytes) counted by
+ *   the reader, and the same bytes on every run; gaps filled by the
+ *   sample clock on an int16 ring
+ * - Replay of a capture file at maximum speed and at 50x the recorded rate
+ * - Replay of a session recording: frames, a recorded gap as lost packets,
+ *   starting at a later chunk; whole packets across chunks that are not a
+ *   multiple of the packet size and from a start inside a chunk
+ * - The multi-device reader on two pipes, one board starting three frames
+ *   after the other: realigned on the boards' clocks, channels merged in
+ *   device order
+ *
+ * The sources stand in for the Arduino: predictable byte sequences,
+ * corrupted data, timeouts and disconnects without a board attached.
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
 
-Will create a mock serial read function that 
-* returns predictable byte sequences
-* returns corrupted or partial data
-* simulates serial timeouts or disconnects
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include "serial_protocol.h"
+#include "io_poll.h"
+#include "read_serial_data.h"
+#include "serial_source.h"
+#include "mc_ring_buffer.h"
+#include "test_helpers.h"
 
+#define NUM_CHANNELS 3
+#define NUM_FRAMES 8
+#define MAX_STREAM 8192
+
+// collects what the parser delivers
+typedef struct {
+   int num_packets;
+   uint16_t seqs[64];
+   int bad_payload; // packets whose codes don't match make_codes()
+} collector;
+
+static void make_codes(int16_t *codes, uint16_t seq){
+   for (int i = 0; i < NUM_CHANNELS * NUM_FRAMES; i++){
+      codes[i] = (int16_t)((seq * 31 + i) % 1024);
+   }
+}
+
+static void collect(const serial_packet *pkt, void *ctx){
+   collector *c = (collector *)ctx;
+   int16_t expected[NUM_CHANNELS * NUM_FRAMES];
+   make_codes(expected, pkt->seq);
+   if (pkt->num_channels != NUM_CHANNELS || pkt->num_frames != NUM_FRAMES ||
+       memcmp(pkt->codes, expected, sizeof(expected)) != 0){
+      c->bad_payload++;
+   }
+   c->seqs[c->num_packets] = pkt->seq;
+   c->num_packets++;
+}
+
+// appends one packet to a byte stream, returns its size
+static size_t append_packet(uint8_t *stream, size_t offset, uint16_t seq){
+   int16_t codes[NUM_CHANNELS * NUM_FRAMES];
+   make_codes(codes, seq);
+   size_t n = serial_packet_encode(stream + offset, seq, NUM_CHANNELS, NUM_FRAMES, codes);
+   assert(n == serial_packet_size(NUM_CHANNELS, NUM_FRAMES));
+   return n;
+}
+
+/**
+ * Tests the CRC against the standard check value of "123456789".
+ *
+ * returns void
+*/
+void test_crc16(void){
+   printf("[TEST] CRC-16/CCITT-FALSE check value ... \n");
+   const uint8_t check[] = "123456789";
+   assert(serial_crc16(check, 9) == 0x29B1);
+   assert(serial_crc16(check, 0) == 0xFFFF);
+   printf("OK\n");
+}
+
+/**
+ * Tests encoding limits and a single packet fed whole, then byte by byte.
+ *
+ * returns void
+*/
+void test_round_trip(void){
+   printf("[TEST] Packet round trip ... \n");
+   static uint8_t stream[MAX_STREAM];
+   int16_t codes[NUM_CHANNELS * NUM_FRAMES];
+   make_codes(codes, 0);
+   assert(serial_packet_encode(stream, 0, 0, NUM_FRAMES, codes) == 0);
+   assert(serial_packet_encode(stream, 0, NUM_CHANNELS, 0, codes) == 0);
+   assert(serial_packet_encode(stream, 0, 2, SERIAL_PROTO_MAX_CODES, codes) == 0);
+
+   size_t n = append_packet(stream, 0, 7);
+   assert(stream[0] == 0x5A && stream[1] == 0xA5);
+   assert(n == SERIAL_PROTO_HEADER_SIZE + 2 * NUM_CHANNELS * NUM_FRAMES + SERIAL_PROTO_CRC_SIZE);
+
+   static serial_parser parser;
+   collector c = {0};
+   serial_parser_init(&parser);
+   assert(serial_parser_feed(&parser, stream, n, collect, &c) == 1);
+   assert(c.num_packets == 1 && c.seqs[0] == 7 && c.bad_payload == 0);
+
+   // one byte per read(), the packet is only delivered on its last byte
+   for (size_t i = 0; i < n; i++){
+      int delivered = serial_parser_feed(&parser, stream + i, 1, collect, &c);
+      assert(delivered == (i == n - 1 ? 1 : 0));
+   }
+   assert(c.num_packets == 2 && c.bad_payload == 0);
+   assert(parser.packets_ok == 2);
+   assert(parser.bytes_skipped == 0 && parser.crc_errors == 0);
+   // 7 then 7 again is a gap of 65535
+   assert(parser.packets_lost == 65535);
+   printf("OK\n");
+}
+
+/**
+ * Tests many packets in one chunk and split at odd chunk sizes.
+ *
+ * returns void
+*/
+void test_stream_chunks(void){
+   printf("[TEST] Packet stream in arbitrary chunks ... \n");
+   static uint8_t stream[MAX_STREAM];
+   size_t len = 0;
+   for (uint16_t seq = 0; seq < 20; seq++) len += append_packet(stream, len, seq);
+
+   const size_t chunk_sizes[] = { len, 1, 3, 17, 64, 255 };
+   for (size_t k = 0; k < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); k++){
+      static serial_parser parser;
+      collector c = {0};
+      serial_parser_init(&parser);
+      for (size_t off = 0; off < len; off += chunk_sizes[k]){
+         size_t n = len - off < chunk_sizes[k] ? len - off : chunk_sizes[k];
+         serial_parser_feed(&parser, stream + off, n, collect, &c);
+      }
+      assert(c.num_packets == 20 && c.bad_payload == 0);
+      for (int i = 0; i < 20; i++) assert(c.seqs[i] == i);
+      assert(parser.packets_lost == 0 && parser.bytes_skipped == 0);
+   }
+   printf("OK\n");
+}
+
+/**
+ * Tests resync after garbage, a flipped byte, a truncated packet and
+ * sync bytes inside the garbage.
+ *
+ * returns void
+*/
+void test_resync(void){
+   printf("[TEST] Resync after garbage and corruption ... \n");
+   static uint8_t stream[MAX_STREAM];
+   size_t len = 0;
+   size_t packet_size = serial_packet_size(NUM_CHANNELS, NUM_FRAMES);
+
+   // garbage including a lone sync word and a sync byte at the end
+   const uint8_t junk[] = { 0x00, 0x5A, 0xA5, 0x13, 0x37, 0xFF, 0x5A };
+   memcpy(stream, junk, sizeof(junk));
+   len += sizeof(junk);
+   len += append_packet(stream, len, 0);
+
+   // seq 1 with a flipped payload byte
+   size_t corrupt = len;
+   len += append_packet(stream, len, 1);
+   stream[corrupt + SERIAL_PROTO_HEADER_SIZE + 5] ^= 0x40;
+
+   len += append_packet(stream, len, 2);
+
+   // seq 3 loses its last 4 bytes on the wire
+   len += append_packet(stream, len, 3) - 4;
+
+   len += append_packet(stream, len, 4);
+   len += append_packet(stream, len, 5);
+
+   static serial_parser parser;
+   collector c = {0};
+   serial_parser_init(&parser);
+   serial_parser_feed(&parser, stream, len, collect, &c);
+
+   // the truncated seq 3 swallows the start of seq 4 and fails its CRC,
+   // the parser then finds seq 4's sync word in the bytes it already has
+   assert(c.bad_payload == 0);
+   assert(c.num_packets == 4);
+   assert(c.seqs[0] == 0 && c.seqs[1] == 2 && c.seqs[2] == 4 && c.seqs[3] == 5);
+   assert(parser.crc_errors == 2);
+   assert(parser.packets_lost == 2);
+   assert(parser.frames_lost == 2 * NUM_FRAMES);
+   // junk, corrupted seq 1 and truncated seq 3 are skipped, nothing else
+   assert(parser.bytes_skipped == sizeof(junk) + packet_size + (packet_size - 4));
+   printf("OK\n");
+}
+
+/**
+ * Tests that the sequence number wraps without counting loss and that a
+ * gap over the wrap is measured correctly.
+ *
+ * returns void
+*/
+void test_sequence(void){
+   printf("[TEST] Sequence numbers, gaps and wraparound ... \n");
+   static uint8_t stream[MAX_STREAM];
+   size_t len = 0;
+   len += append_packet(stream, len, 65534);
+   len += append_packet(stream, len, 65535);
+   len += append_packet(stream, len, 0);
+   len += append_packet(stream, len, 1);
+   len += append_packet(stream, len, 4); // 2 and 3 lost
+
+   static serial_parser parser;
+   collector c = {0};
+   serial_parser_init(&parser);
+   assert(serial_parser_feed(&parser, stream, len, collect, &c) == 5);
+   assert(parser.packets_lost == 2);
+   assert(parser.frames_lost == 2 * NUM_FRAMES);
+
+   // before the first packet nothing is known to be lost
+   serial_parser_init(&parser);
+   len = append_packet(stream, 0, 1000);
+   assert(serial_parser_feed(&parser, stream, len, collect, &c) == 1);
+   assert(parser.packets_lost == 0);
+   printf("OK\n");
+}
+
+/**
+ * Tests the code to volts conversion of the Arduino 10-bit ADC.
+ *
+ * returns void
+*/
+void test_code_to_volts(void){
+   printf("[TEST] ADC code to volts ... \n");
+   ASSERT_FLOAT_EQ(serial_code_to_volts(0), 0.0f);
+   ASSERT_FLOAT_EQ(serial_code_to_volts(SERIAL_ADC_MAX_CODE), SERIAL_ADC_VREF);
+   ASSERT_FLOAT_EQ(serial_code_to_volts(512), 512 * 5.0f / 1023.0f);
+   printf("OK\n");
+}
+
+/**
+ * Tests that the poller times out on idle pipes and reports only the pipe
+ * with data, and a pipe whose writer closed.
+ *
+ * returns void
+*/
+void test_poller(void){
+   printf("[TEST] Poller on several pipes ... \n");
+   int pipes[3][2];
+   int tags[3] = { 0, 1, 2 };
+   io_poller poller;
+   assert(io_poller_init(&poller));
+   for (int i = 0; i < 3; i++){
+      assert(pipe(pipes[i]) == 0);
+      assert(io_poller_add(&poller, pipes[i][0], 1, &tags[i]));
+   }
+   void *ready[3];
+   assert(io_poller_wait(&poller, 10, ready, 3) == 0);
+
+   assert(write(pipes[1][1], "x", 1) == 1);
+   assert(io_poller_wait(&poller, 1000, ready, 3) == 1);
+   assert(ready[0] == &tags[1]);
+   char byte;
+   assert(read(pipes[1][0], &byte, 1) == 1);
+
+   close(pipes[2][1]); // hang up is reported as ready
+   assert(io_poller_wait(&poller, 1000, ready, 3) == 1);
+   assert(ready[0] == &tags[2]);
+
+   // until it is removed; the others are still watched
+   assert(io_poller_remove(&poller, pipes[2][0]));
+   assert(!io_poller_remove(&poller, pipes[2][0]));
+   assert(io_poller_wait(&poller, 10, ready, 3) == 0);
+   assert(write(pipes[0][1], "x", 1) == 1);
+   assert(io_poller_wait(&poller, 1000, ready, 3) == 1);
+   assert(ready[0] == &tags[0]);
+
+   io_poller_close(&poller);
+   for (int i = 0; i < 3; i++){
+      close(pipes[i][0]);
+      if (i != 2) close(pipes[i][1]);
+   }
+   printf("OK\n");
+}
+
+/**
+ * Runs serial_reader on a pipe: 50 packets written in chunks that split
+ * packets at odd offsets, then end of file. Every frame must arrive in the
+ * ring in order with the right voltage, in a float ring and in an int16
+ * ring of codes.
+ *
+ * returns void
+*/
+void test_reader_pipe(void){
+   printf("[TEST] serial_reader on a pipe ... \n");
+   static uint8_t stream[MAX_STREAM * 2];
+   size_t len = 0;
+   for (uint16_t seq = 0; seq < 50; seq++) len += append_packet(stream, len, seq);
+   assert(len <= sizeof(stream));
+
+   for (int i16 = 0; i16 < 2; i16++){
+      int fds[2];
+      assert(pipe(fds) == 0);
+      mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+      assert(ring);
+      if (i16) assert(mc_ring_buffer_init_i16(ring, NUM_CHANNELS, 50 * NUM_FRAMES, SERIAL_VOLTS_PER_CODE));
+      else assert(mc_ring_buffer_init(ring, NUM_CHANNELS, 50 * NUM_FRAMES));
+
+      serial_reader_args args = {0};
+      args.fd = fds[0];
+      args.num_channels = NUM_CHANNELS;
+      args.frames_per_packet = NUM_FRAMES;
+      args.ring = ring;
+      args.tuning.vmin = 1;
+      args.tuning.vtime = 0;
+      pthread_t reader;
+      assert(pthread_create(&reader, NULL, serial_reader, &args) == 0);
+
+      const size_t chunk = 37; // never a multiple of the packet size
+      for (size_t off = 0; off < len; off += chunk){
+         size_t n = len - off < chunk ? len - off : chunk;
+         assert(write(fds[1], stream + off, n) == (ssize_t)n);
+         if ((off / chunk) % 8 == 0) usleep(200); // let some reads see partial packets
+      }
+      close(fds[1]); // end of file stops the reader
+      assert(pthread_join(reader, NULL) == 0);
+
+      assert(args.frames_read == 50 * NUM_FRAMES);
+      assert(args.packets_lost == 0 && args.crc_errors == 0);
+      float frame[NUM_CHANNELS];
+      int16_t codes[NUM_CHANNELS * NUM_FRAMES];
+      for (uint16_t seq = 0; seq < 50; seq++){
+         make_codes(codes, seq);
+         for (int f = 0; f < NUM_FRAMES; f++){
+            assert(mc_ring_buffer_read_frames(ring, frame, 1) == 1);
+            for (int c = 0; c < NUM_CHANNELS; c++){
+               ASSERT_FLOAT_EQ(frame[c], serial_code_to_volts(codes[f * NUM_CHANNELS + c]));
+            }
+         }
+      }
+      assert(mc_ring_buffer_num_frames(ring) == 0);
+      close(fds[0]);
+      MC_SAFE_DESTROY(ring);
+   }
+   printf("OK\n");
+}
+
+/**
+ * A packet with fewer frames than frames_per_packet, between good ones,
+ * is dropped whole by serial_reader: only the other packets' frames reach
+ * the ring, in order.
+ *
+ * returns void
+*/
+void test_reader_frame_count(void){
+   printf("[TEST] serial_reader drops packets with the wrong frame count ... \n");
+   enum { PACKETS = 10, SHORT = 4 };
+   static uint8_t stream[MAX_STREAM];
+   size_t len = 0;
+   for (uint16_t seq = 0; seq < PACKETS; seq++){
+      if (seq != SHORT){
+         len += append_packet(stream, len, seq);
+         continue;
+      }
+      int16_t codes[NUM_CHANNELS * NUM_FRAMES];
+      make_codes(codes, seq);
+      len += serial_packet_encode(stream + len, seq, NUM_CHANNELS, NUM_FRAMES / 2, codes);
+   }
+   assert(len <= sizeof(stream));
+
+   int fds[2];
+   assert(pipe(fds) == 0);
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init(ring, NUM_CHANNELS, PACKETS * NUM_FRAMES));
+   serial_reader_args args = {0};
+   args.fd = fds[0];
+   args.num_channels = NUM_CHANNELS;
+   args.frames_per_packet = NUM_FRAMES;
+   args.ring = ring;
+   args.tuning.vmin = 1;
+   pthread_t reader;
+   assert(pthread_create(&reader, NULL, serial_reader, &args) == 0);
+   assert(write(fds[1], stream, len) == (ssize_t)len);
+   close(fds[1]);
+   assert(pthread_join(reader, NULL) == 0);
+
+   assert(args.frames_read == (PACKETS - 1) * NUM_FRAMES);
+   assert(args.crc_errors == 0);
+   float frame[NUM_CHANNELS];
+   int16_t codes[NUM_CHANNELS * NUM_FRAMES];
+   for (uint16_t seq = 0; seq < PACKETS; seq++){
+      if (seq == SHORT) continue;
+      make_codes(codes, seq);
+      for (int f = 0; f < NUM_FRAMES; f++){
+         assert(mc_ring_buffer_read_frames(ring, frame, 1) == 1);
+         for (int c = 0; c < NUM_CHANNELS; c++){
+            ASSERT_FLOAT_EQ(frame[c], serial_code_to_volts(codes[f * NUM_CHANNELS + c]));
+         }
+      }
+   }
+   assert(mc_ring_buffer_num_frames(ring) == 0);
+   close(fds[0]);
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+/**
+ * Tests that an idle reader returns after the stop flag is set.
+ *
+ * returns void
+*/
+void test_reader_stop(void){
+   printf("[TEST] serial_reader stop flag ... \n");
+   int fds[2];
+   assert(pipe(fds) == 0);
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init(ring, NUM_CHANNELS, 16));
+
+   atomic_bool stop = false;
+   serial_reader_args args = {0};
+   args.fd = fds[0];
+   args.num_channels = NUM_CHANNELS;
+   args.frames_per_packet = NUM_FRAMES;
+   args.ring = ring;
+   args.tuning.vmin = 1;
+   args.tuning.vtime = 1; // 100 ms wait
+   args.stop = &stop;
+   pthread_t reader;
+   assert(pthread_create(&reader, NULL, serial_reader, &args) == 0);
+   usleep(20000);
+
+   struct timespec t0, t1;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   atomic_store(&stop, true);
+   assert(pthread_join(reader, NULL) == 0);
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   double waited_ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) * 1e-6;
+   assert(waited_ms < 1000.0);
+   assert(args.frames_read == 0);
+
+   close(fds[0]);
+   close(fds[1]);
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+typedef struct {
+   serial_reader_args args;
+   double elapsed_ms;       // from the start until the reader returned
+} reader_run;
+
+// runs serial_reader on a source until it hangs up or ends, clock may be NULL
+static void run_reader(reader_run *run, int fd, mc_ring_buffer *ring, int num_channels,
+                       int frames_per_packet, sample_clock *clock){
+   memset(run, 0, sizeof(*run));
+   run->args.clock = clock;
+   run->args.fd = fd;
+   run->args.num_channels = num_channels;
+   run->args.frames_per_packet = frames_per_packet;
+   run->args.ring = ring;
+   run->args.tuning.vmin = 1;
+   run->args.tuning.vtime = 1;
+   struct timespec t0, t1;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   pthread_t reader;
+   assert(pthread_create(&reader, NULL, serial_reader, &run->args) == 0);
+   assert(pthread_join(reader, NULL) == 0);
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   run->elapsed_ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) * 1e-6;
+}
+
+static void synth_config(serial_synth_config *cfg, uint64_t num_packets, float speed){
+   memset(cfg, 0, sizeof(*cfg));
+   cfg->num_channels = NUM_CHANNELS;
+   cfg->frames_per_packet = NUM_FRAMES;
+   cfg->sample_rate = 250.0f;
+   cfg->speed = speed;
+   cfg->num_packets = num_packets;
+   cfg->num_tones = 2;
+   cfg->tone_hz[0] = 10.0f;
+   cfg->tone_v[0] = 0.5f;
+   cfg->tone_hz[1] = 60.0f;
+   cfg->tone_v[1] = 0.1f;
+   cfg->offset_v = 2.5f;
+}
+
+/**
+ * Runs the reader on the synthetic pty source at 100x real time: it takes
+ * at least the paced time, every frame arrives with the generated voltage,
+ * and the hang-up after the last packet ends the reader.
+ *
+ * returns void
 */
+void test_source_synth(void){
+   printf("[TEST] Synthetic pty source at 100x real time ... \n");
+   serial_synth_config cfg;
+   serial_source src;
+   synth_config(&cfg, 100, 0.0f);
+   cfg.num_channels = 0;
+   assert(!serial_source_open_synth(&src, &cfg));
+   synth_config(&cfg, 100, 100.0f);
+
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init(ring, NUM_CHANNELS, 100 * NUM_FRAMES));
+   assert(serial_source_open_synth(&src, &cfg));
+   reader_run run;
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(&src);
+
+   // 800 frames at 250 Hz is 3.2 s of signal
+   double paced_ms = 100.0 * NUM_FRAMES / 250.0 / 100.0 * 1e3;
+   assert(run.elapsed_ms >= 0.9 * paced_ms);
+   assert(run.args.frames_read == 100 * NUM_FRAMES);
+   assert(run.args.packets_lost == 0 && run.args.crc_errors == 0);
+   assert(atomic_load(&src.packets_sent) == 100);
+
+   // noise off: the reader sees the clean signal, quantized to the ADC
+   float frame[NUM_CHANNELS];
+   float lsb = SERIAL_ADC_VREF / SERIAL_ADC_MAX_CODE;
+   for (uint64_t f = 0; f < 100 * NUM_FRAMES; f++){
+      assert(mc_ring_buffer_read_frames(ring, frame, 1) == 1);
+      for (int c = 0; c < NUM_CHANNELS; c++){
+         assert(fabsf(frame[c] - serial_synth_clean_v(&cfg, f, c)) <= 0.5f * lsb + 1e-4f);
+      }
+   }
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+// one max-speed run of the faulty generator, frames left in the ring
+static void run_faulty_synth(mc_ring_buffer *ring, reader_run *run, serial_source *src){
+   serial_synth_config cfg;
+   synth_config(&cfg, 61, 0.0f);
+   cfg.seed = 42;
+   cfg.noise_v = 0.1f;
+   cfg.burst_packets = 4;
+   cfg.drop_every = 10;   // sequence numbers 9, 19, .., 59 never sent
+   cfg.corrupt_every = 7; // packets 6, 13, .., 55 fail their CRC
+   assert(serial_source_open_synth(src, &cfg));
+   run_reader(run, src->fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(src);
+}
+
+/**
+ * Runs the generator with bursts, sequence gaps and corrupted packets at
+ * maximum speed: the reader counts each fault, keeps every good packet,
+ * and a second run with the same seed delivers the same samples.
+ *
+ * returns void
+*/
+void test_source_synth_faults(void){
+   printf("[TEST] Synthetic source faults and repeatability ... \n");
+   mc_ring_buffer *a = malloc(sizeof(mc_ring_buffer));
+   mc_ring_buffer *b = malloc(sizeof(mc_ring_buffer));
+   assert(a && mc_ring_buffer_init(a, NUM_CHANNELS, 61 * NUM_FRAMES));
+   assert(b && mc_ring_buffer_init(b, NUM_CHANNELS, 61 * NUM_FRAMES));
+   serial_source src;
+   reader_run run;
+
+   run_faulty_synth(a, &run, &src);
+   assert(atomic_load(&src.packets_sent) == 61 - 6);
+   // dropped and corrupted packets both show up as sequence gaps
+   assert(run.args.packets_lost == 6 + 8);
+   assert(run.args.crc_errors >= 8);
+   assert(run.args.frames_read == (61 - 6 - 8) * NUM_FRAMES);
+
+   run_faulty_synth(b, &run, &src);
+   assert(run.args.frames_read == (61 - 6 - 8) * NUM_FRAMES);
+   float fa[NUM_CHANNELS], fb[NUM_CHANNELS];
+   for (int f = 0; f < (61 - 6 - 8) * NUM_FRAMES; f++){
+      assert(mc_ring_buffer_read_frames(a, fa, 1) == 1);
+      assert(mc_ring_buffer_read_frames(b, fb, 1) == 1);
+      assert(memcmp(fa, fb, sizeof(fa)) == 0);
+   }
+   MC_SAFE_DESTROY(a);
+   MC_SAFE_DESTROY(b);
+   printf("OK\n");
+}
+
+/**
+ * Runs the noise-free generator with every 10th packet dropped through a
+ * reader with a sample clock: each gap is filled with frames on the line
+ * between its neighbours, so the int16 ring holds every frame of the
+ * stream and the received ones still match the generated voltages.
+ *
+ * returns void
+*/
+void test_source_synth_gap_fill(void){
+   printf("[TEST] Synthetic source gaps filled on the sample grid ... \n");
+   enum { PACKETS = 61, TOTAL = PACKETS * NUM_FRAMES };
+   serial_synth_config cfg;
+   synth_config(&cfg, PACKETS, 0.0f);
+   cfg.drop_every = 10;  // sequence numbers 9, 19, .., 59 never sent
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init_i16(ring, NUM_CHANNELS, TOTAL, SERIAL_VOLTS_PER_CODE));
+   sample_clock clock;
+   assert(sample_clock_init(&clock, cfg.sample_rate, NUM_FRAMES));
+
+   serial_source src;
+   assert(serial_source_open_synth(&src, &cfg));
+   reader_run run;
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, &clock);
+   serial_source_close(&src);
+
+   assert(run.args.packets_lost == 6);
+   assert(run.args.frames_read == (PACKETS - 6) * NUM_FRAMES);
+   assert(run.args.frames_filled == 6 * NUM_FRAMES);
+   assert(clock.gaps == 6 && clock.frames_filled == 6 * NUM_FRAMES && clock.resyncs == 0);
+   assert(clock.next_index == TOTAL);
+   assert(mc_ring_buffer_num_frames(ring) == TOTAL);
+
+   static float v[TOTAL][NUM_CHANNELS];
+   assert(mc_ring_buffer_read_frames(ring, &v[0][0], TOTAL) == TOTAL);
+   float lsb = SERIAL_VOLTS_PER_CODE;
+   for (int f = 0; f < TOTAL; f++){
+      int seq = f / NUM_FRAMES;
+      for (int c = 0; c < NUM_CHANNELS; c++){
+         if (seq % 10 != 9){
+            assert(fabsf(v[f][c] - serial_synth_clean_v(&cfg, (uint64_t)f, c)) <= 0.5f * lsb + 1e-4f);
+            continue;
+         }
+         // on the line from the last frame before the gap to the first after it
+         int before = seq * NUM_FRAMES - 1, after = (seq + 1) * NUM_FRAMES;
+         float t = (float)(f - before) / (float)(after - before);
+         float line = v[before][c] + t * (v[after][c] - v[before][c]);
+         assert(fabsf(v[f][c] - line) <= 0.5f * lsb + 1e-4f);
+      }
+   }
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+/**
+ * Two boards (2 and 1 channels) on pipes, one frame per packet, paced at
+ * 500 Hz; board B starts sampling three frames after board A, so A's
+ * first three frames have nothing to line up with. The multi-device reader
+ * drops exactly those and merges the rest with each pair of frames sampled
+ * at the same time, A's channels first. A ring with the wrong channel
+ * count is refused.
+ *
+ * returns void
+*/
+void test_multi_reader(void){
+   printf("[TEST] Multi-device reader aligns two boards ... \n");
+   enum { FRAMES = 200, DELAY = 3, RATE = 500 };
+   int a[2], b[2];
+   assert(pipe(a) == 0 && pipe(b) == 0);
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init_i16(ring, 3, FRAMES, SERIAL_VOLTS_PER_CODE));
+
+   serial_multi_reader_args *args = calloc(1, sizeof(serial_multi_reader_args));
+   assert(args);
+   args->devices[0].fd = a[0];
+   args->devices[0].num_channels = 2;
+   args->devices[1].fd = b[0];
+   args->devices[1].num_channels = 2; // wrong: 4 channels, the ring has 3
+   args->devices[0].frames_per_packet = 1;
+   args->devices[1].frames_per_packet = 1;
+   args->num_devices = 2;
+   args->sample_rate = RATE;
+   args->queue_frames = 64;
+   args->ring = ring;
+   args->tuning.vmin = 1;
+   args->tuning.vtime = 1;
+   pthread_t reader;
+   assert(pthread_create(&reader, NULL, serial_multi_reader, args) == 0);
+   assert(pthread_join(reader, NULL) == 0);
+   assert(args->frames_aligned == 0);
+
+   args->devices[1].num_channels = 1;
+   assert(pthread_create(&reader, NULL, serial_multi_reader, args) == 0);
+   // board A sample n and board B sample n - DELAY are taken (and sent) together
+   uint8_t packet[64];
+   struct timespec due;
+   clock_gettime(CLOCK_MONOTONIC, &due);
+   for (int n = 0; n < FRAMES; n++){
+      int16_t codes_a[2] = { (int16_t)n, (int16_t)(n + 300) };
+      size_t len = serial_packet_encode(packet, (uint16_t)n, 2, 1, codes_a);
+      assert(write(a[1], packet, len) == (ssize_t)len);
+      if (n >= DELAY){
+         int16_t code_b = (int16_t)(n - DELAY + 600);
+         len = serial_packet_encode(packet, (uint16_t)(n - DELAY), 1, 1, &code_b);
+         assert(write(b[1], packet, len) == (ssize_t)len);
+      }
+      due.tv_nsec += 1000000000 / RATE;
+      if (due.tv_nsec >= 1000000000){
+         due.tv_sec++;
+         due.tv_nsec -= 1000000000;
+      }
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+   }
+   close(a[1]);
+   close(b[1]);
+   assert(pthread_join(reader, NULL) == 0);
+
+   assert(args->devices[0].frames_read == FRAMES);
+   assert(args->devices[1].frames_read == FRAMES - DELAY);
+   assert(args->devices[0].packets_lost == 0 && args->devices[1].crc_errors == 0);
+   assert(args->frames_slipped == DELAY);
+   assert(args->frames_aligned == FRAMES - DELAY);
+   assert(mc_ring_buffer_num_frames(ring) == FRAMES - DELAY);
+   int16_t frame[3];
+   for (int f = 0; f < FRAMES - DELAY; f++){
+      assert(mc_ring_buffer_read_codes(ring, frame, 1) == 1);
+      assert(frame[0] == f + DELAY && frame[1] == f + DELAY + 300);
+      assert(frame[2] == f + 600);
+   }
+   close(a[0]);
+   close(b[0]);
+   free(args);
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+/**
+ * Replays a capture with garbage between packets, once at maximum speed
+ * straight from the file and once paced at 50x the recorded rate.
+ *
+ * returns void
+*/
+void test_source_replay(void){
+   printf("[TEST] Replay of a capture file ... \n");
+   static uint8_t stream[MAX_STREAM * 2];
+   size_t len = 0;
+   for (uint16_t seq = 0; seq < 40; seq++){
+      len += append_packet(stream, len, seq);
+      if (seq == 20){
+         memset(stream + len, 0x5A, 5); // sync-like garbage the parser skips
+         len += 5;
+      }
+   }
+   char path[] = "/tmp/eeg_capture_XXXXXX";
+   int fd = mkstemp(path);
+   assert(fd != -1);
+   assert(write(fd, stream, len) == (ssize_t)len);
+   close(fd);
+
+   serial_replay_config cfg = { NUM_CHANNELS, NUM_FRAMES, 250.0f, 0.0f };
+   serial_source src;
+   assert(!serial_source_open_replay(&src, "/nonexistent/capture", &cfg));
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init(ring, NUM_CHANNELS, 80 * NUM_FRAMES));
+   reader_run run;
+
+   assert(serial_source_open_replay(&src, path, &cfg));
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(&src);
+   assert(run.args.frames_read == 40 * NUM_FRAMES);
+   assert(run.args.packets_lost == 0 && run.args.crc_errors == 0);
+
+   cfg.speed = 50.0f;
+   assert(serial_source_open_replay(&src, path, &cfg));
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(&src);
+   double paced_ms = 40.0 * NUM_FRAMES / 250.0 / 50.0 * 1e3;
+   assert(run.elapsed_ms >= 0.9 * paced_ms);
+   assert(run.args.frames_read == 40 * NUM_FRAMES);
+   assert(mc_ring_buffer_num_frames(ring) == 80 * NUM_FRAMES);
+
+   unlink(path);
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+/**
+ * Tests replaying a session recording through the protocol: every recorded
+ * frame arrives, a gap in the recording shows up as lost packets, and a
+ * start time skips the chunks before it.
+ *
+ * returns void
+*/
+void test_source_recording(void){
+   printf("[TEST] Replay of a session recording ... \n");
+   char path[] = "/tmp/eeg_session_XXXXXX";
+   int fd = mkstemp(path);
+   assert(fd != -1);
+   close(fd);
+   recorder rec;
+   assert(recorder_open(&rec, path, NUM_CHANNELS, 250.0f, 32, 1024));
+   int16_t codes[NUM_CHANNELS * NUM_FRAMES];
+   float volts[NUM_CHANNELS * NUM_FRAMES];
+   float *big = calloc(2000 * NUM_CHANNELS, sizeof(float));
+   assert(big);
+   struct timespec pause = { 0, 1000000L };
+   for (uint16_t seq = 0; seq < 30; seq++){
+      // dropped by the recorder: 250 packets lost, the next one is number 262
+      if (seq == 12) assert(!recorder_push(&rec, big, 2000, 12));
+      make_codes(codes, seq);
+      for (int i = 0; i < NUM_CHANNELS * NUM_FRAMES; i++) volts[i] = serial_code_to_volts(codes[i]);
+      assert(recorder_push(&rec, volts, NUM_FRAMES, seq < 12 ? seq : seq + 250));
+      nanosleep(&pause, NULL);
+   }
+   assert(recorder_close(&rec));
+   free(big);
+
+   serial_recording_config cfg = { NUM_FRAMES, 0.0f, 0 };
+   serial_source src;
+   assert(!serial_source_open_recording(&src, "/nonexistent/session", &cfg));
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init(ring, NUM_CHANNELS, 80 * NUM_FRAMES));
+   reader_run run;
+
+   assert(serial_source_open_recording(&src, path, &cfg));
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(&src);
+   assert(run.args.frames_read == 30 * NUM_FRAMES);
+   assert(run.args.packets_lost == 250 && run.args.crc_errors == 0);
+   float frame[NUM_CHANNELS];
+   float lsb = SERIAL_ADC_VREF / SERIAL_ADC_MAX_CODE;
+   for (uint16_t seq = 0; seq < 30; seq++){
+      make_codes(codes, seq);
+      for (int f = 0; f < NUM_FRAMES; f++){
+         assert(mc_ring_buffer_read_frames(ring, frame, 1) == 1);
+         for (int c = 0; c < NUM_CHANNELS; c++){
+            float expected = serial_code_to_volts(codes[f * NUM_CHANNELS + c]);
+            assert(fabsf(frame[c] - expected) <= 0.5f * lsb);
+         }
+      }
+   }
+
+   // start at the second chunk after the gap
+   recording session;
+   assert(recording_open(&session, path));
+   uint64_t c = 0;
+   while (session.index[c].first_frame < 2000 + 12 * NUM_FRAMES) c++;
+   c++;
+   cfg.start_ns = session.index[c].timestamp_ns - session.header->start_ns;
+   uint64_t expected = 2000 + 30 * NUM_FRAMES - session.index[c].first_frame;
+   recording_close(&session);
+   assert(serial_source_open_recording(&src, path, &cfg));
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(&src);
+   assert(run.args.frames_read == expected);
+   assert(run.args.packets_lost == 0);
+
+   cfg.start_ns = 3600ull * 1000000000ull; // past the end
+   assert(!serial_source_open_recording(&src, path, &cfg));
+   unlink(path);
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+/**
+ * Replays a recording whose chunks (20 frames) are not a multiple of the
+ * packet size (8): every packet arrives whole across chunk boundaries, the
+ * packets lost on the wire while recording are lost on replay, and a start
+ * time inside a chunk starts at the recorded packet holding it, which
+ * begins in the previous chunk.
+ *
+ * returns void
+*/
+void test_source_recording_packets(void){
+   printf("[TEST] Replay of a recording in whole packets ... \n");
+   enum { PACKETS = 40, CHUNK = 20, LOST = 5, RATE = 8000 };
+   char path[] = "/tmp/eeg_session_XXXXXX";
+   int fd = mkstemp(path);
+   assert(fd != -1);
+   close(fd);
+   recorder rec;
+   assert(recorder_open(&rec, path, NUM_CHANNELS, RATE, CHUNK, 1024));
+   int16_t codes[NUM_CHANNELS * NUM_FRAMES];
+   float volts[NUM_CHANNELS * NUM_FRAMES];
+   struct timespec pause = { 0, 1000000L }; // one packet period at RATE
+   for (uint16_t p = 0; p < PACKETS; p++){
+      make_codes(codes, p);
+      for (int i = 0; i < NUM_CHANNELS * NUM_FRAMES; i++) volts[i] = serial_code_to_volts(codes[i]);
+      // packet 20 starts chunk 8, its number shows the loss
+      assert(recorder_push(&rec, volts, NUM_FRAMES, p < 20 ? p : p + LOST));
+      nanosleep(&pause, NULL);
+   }
+   assert(recorder_close(&rec));
+
+   mc_ring_buffer *ring = malloc(sizeof(mc_ring_buffer));
+   assert(ring && mc_ring_buffer_init(ring, NUM_CHANNELS, PACKETS * NUM_FRAMES));
+   serial_recording_config cfg = { NUM_FRAMES, 0.0f, 0 };
+   serial_source src;
+   reader_run run;
+   assert(serial_source_open_recording(&src, path, &cfg));
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(&src);
+   assert(run.args.frames_read == PACKETS * NUM_FRAMES);
+   assert(run.args.packets_lost == LOST && run.args.crc_errors == 0);
+   assert(atomic_load(&src.packets_sent) == PACKETS);
+   float frame[NUM_CHANNELS];
+   float lsb = SERIAL_ADC_VREF / SERIAL_ADC_MAX_CODE;
+   for (uint16_t p = 0; p < PACKETS; p++){
+      make_codes(codes, p);
+      for (int f = 0; f < NUM_FRAMES; f++){
+         assert(mc_ring_buffer_read_frames(ring, frame, 1) == 1);
+         for (int c = 0; c < NUM_CHANNELS; c++){
+            assert(fabsf(frame[c] - serial_code_to_volts(codes[f * NUM_CHANNELS + c])) <= 0.5f * lsb);
+         }
+      }
+   }
+
+   // frame 221 is in chunk 11 (frames 220..239) and packet 27 (216..223)
+   recording session;
+   assert(recording_open(&session, path));
+   cfg.start_ns = session.index[11].timestamp_ns - session.header->start_ns + 1500000000ull / RATE;
+   recording_pos pos;
+   assert(recording_seek(&session, cfg.start_ns, &pos) && pos.chunk == 11 && pos.frame == 1);
+   recording_close(&session);
+   assert(serial_source_open_recording(&src, path, &cfg));
+   run_reader(&run, src.fd, ring, NUM_CHANNELS, NUM_FRAMES, NULL);
+   serial_source_close(&src);
+   assert(run.args.frames_read == (PACKETS - 27) * NUM_FRAMES);
+   assert(run.args.packets_lost == 0 && atomic_load(&src.packets_sent) == PACKETS - 27);
+   make_codes(codes, 27);
+   assert(mc_ring_buffer_read_frames(ring, frame, 1) == 1);
+   assert(fabsf(frame[0] - serial_code_to_volts(codes[0])) <= 0.5f * lsb);
+
+   unlink(path);
+   MC_SAFE_DESTROY(ring);
+   printf("OK\n");
+}
+
+int main(){
+   test_crc16();
+   test_round_trip();
+   test_stream_chunks();
+   test_resync();
+   test_sequence();
+   test_code_to_volts();
+   test_poller();
+   test_reader_pipe();
+   test_reader_frame_count();
+   test_reader_stop();
+   test_source_synth();
+   test_source_synth_faults();
+   test_source_synth_gap_fill();
+   test_source_replay();
+   test_source_recording();
+   test_source_recording_packets();
+   test_multi_reader();
+   return 0;
+}
@@ -0,0 +1,307 @@
+/**
+ * @file test_stream_sink.c
+ * @brief Tests for the output sinks (stream_sink.c).
+ *
+ * This file contains tests for:
+ * - Shared-memory ring: invalid names, a consumer mapping of the
+ *   producer's ring, messages filled and read in place, a full ring
+ *   dropping messages as gaps in seq
+ * - A producer and a consumer thread on two mappings of one ring: every
+ *   message is either received in order or counted as dropped
+ * - UDP on the loopback: messages cut into datagrams and reassembled, one
+ *   system call per batch on Linux, per-kind sequence numbers, malformed
+ *   datagrams rejected
+ * - A sink set publishing to both
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "stream_sink.h"
+
+#define SHM_NAME "/eeg_test_stream"
+#define THREAD_MESSAGES 200000
+
+/**
+ * Tests names, a consumer mapping of the ring, messages written in place
+ * by the producer and read in place by the consumer, and a full ring.
+ *
+ * returns void
+*/
+void test_shm_ring(void){
+   printf("[TEST] Shared-memory ring ... \n");
+   stream_shm prod, cons;
+   assert(!stream_shm_create(&prod, "", 4, 8));
+   assert(!stream_shm_create(&prod, SHM_NAME, 0, 8));
+   char long_name[STREAM_SHM_NAME_LEN + 1];
+   memset(long_name, 'x', sizeof(long_name) - 1);
+   long_name[0] = '/';
+   long_name[STREAM_SHM_NAME_LEN] = '\0';
+   assert(!stream_shm_create(&prod, long_name, 4, 8));
+   assert(!stream_shm_open(&cons, "/eeg_test_no_such_stream"));
+
+   assert(stream_shm_create(&prod, SHM_NAME, 3, 8)); // rounded up to 4 slots
+   assert(prod.region->num_slots == 4);
+   assert(prod.region->slot_bytes % RB_CACHE_LINE_SIZE == 0);
+   assert(stream_shm_open(&cons, SHM_NAME));
+   assert(cons.region != prod.region); // two mappings of the same pages
+   const float *values;
+   assert(stream_shm_peek(&cons, &values) == NULL);
+
+   // too large: dropped, still takes a seq
+   assert(stream_shm_reserve(&prod, STREAM_PSD, 1, 9, 0) == NULL);
+   assert(prod.dropped == 1);
+   for (int m = 0; m < 5; m++){
+      float *slot = stream_shm_reserve(&prod, STREAM_PSD, 2, 8, 1000 + m);
+      if (m == 4){
+         assert(slot == NULL); // four slots, no consumer yet
+         break;
+      }
+      for (int i = 0; i < 8; i++) slot[i] = (float)(m * 10 + i);
+      stream_shm_commit(&prod);
+   }
+   assert(prod.published == 4 && prod.dropped == 2);
+
+   for (int m = 0; m < 4; m++){
+      const stream_header *h = stream_shm_peek(&cons, &values);
+      assert(h && h->magic == STREAM_MAGIC && h->kind == STREAM_PSD);
+      assert(h->seq == (uint32_t)m + 1 && h->num_channels == 2);
+      assert(h->num_values == 8 && h->count == 8 && h->time_ns == 1000u + (uint64_t)m);
+      for (int i = 0; i < 8; i++) assert(values[i] == (float)(m * 10 + i));
+      stream_shm_release(&cons);
+   }
+   assert(stream_shm_peek(&cons, &values) == NULL);
+
+   // the kinds count separately, the gap shows in PSD only
+   float *slot = stream_shm_reserve(&prod, STREAM_BAND_POWER, 1, 1, 0);
+   slot[0] = 1.0f;
+   stream_shm_commit(&prod);
+   slot = stream_shm_reserve(&prod, STREAM_PSD, 1, 1, 0);
+   slot[0] = 2.0f;
+   stream_shm_commit(&prod);
+   const stream_header *h = stream_shm_peek(&cons, &values);
+   assert(h->kind == STREAM_BAND_POWER && h->seq == 0 && values[0] == 1.0f);
+   stream_shm_release(&cons);
+   h = stream_shm_peek(&cons, &values);
+   assert(h->kind == STREAM_PSD && h->seq == 6 && values[0] == 2.0f);
+   stream_shm_release(&cons);
+
+   stream_shm_close(&cons);
+   stream_shm_close(&prod);
+   assert(!stream_shm_open(&cons, SHM_NAME)); // the producer removed the name
+   printf("OK\n");
+}
+
+typedef struct {
+   stream_shm shm;
+   atomic_bool done;
+} producer_state;
+
+static void *shm_producer(void *arg){
+   producer_state *p = (producer_state *)arg;
+   for (int m = 0; m < THREAD_MESSAGES; m++){
+      float *slot = stream_shm_reserve(&p->shm, STREAM_RAW, 1, 4, (uint64_t)m);
+      if (!slot) continue;
+      for (int i = 0; i < 4; i++) slot[i] = (float)m;
+      stream_shm_commit(&p->shm);
+   }
+   atomic_store(&p->done, true);
+   return NULL;
+}
+
+/**
+ * A producer thread publishes into a small ring while the consumer reads
+ * its own mapping: messages arrive in order with their own values, and
+ * received plus dropped is every message.
+ *
+ * returns void
+*/
+void test_shm_threads(void){
+   printf("[TEST] Shared-memory ring across threads ... \n");
+   static producer_state p;
+   stream_shm cons;
+   atomic_init(&p.done, false);
+   assert(stream_shm_create(&p.shm, SHM_NAME, 16, 4));
+   assert(stream_shm_open(&cons, SHM_NAME));
+   pthread_t producer;
+   assert(pthread_create(&producer, NULL, shm_producer, &p) == 0);
+
+   uint64_t received = 0, gaps = 0;
+   int64_t last = -1;
+   while (1){
+      // done is read before the ring: nothing committed after it is missed
+      bool done = atomic_load(&p.done);
+      const float *values;
+      const stream_header *h = stream_shm_peek(&cons, &values);
+      if (!h){
+         if (done) break;
+         continue;
+      }
+      assert((int64_t)h->seq > last);
+      for (int i = 0; i < 4; i++) assert(values[i] == (float)h->seq);
+      gaps += h->seq - (uint64_t)(last + 1);
+      last = h->seq;
+      received++;
+      stream_shm_release(&cons);
+   }
+   assert(pthread_join(producer, NULL) == 0);
+   assert(received == p.shm.published);
+   assert(received + p.shm.dropped == THREAD_MESSAGES);
+   assert(gaps + (uint64_t)(THREAD_MESSAGES - 1 - last) == p.shm.dropped);
+   stream_shm_close(&cons);
+   stream_shm_close(&p.shm);
+   printf("OK\n");
+}
+
+// a receiving socket on the loopback, its port in *port
+static int udp_receiver(int *port){
+   int fd = socket(AF_INET, SOCK_DGRAM, 0);
+   assert(fd != -1);
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+   assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+   socklen_t len = sizeof(addr);
+   assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+   *port = ntohs(addr.sin_port);
+   return fd;
+}
+
+// receives and checks one datagram, returns its header
+static stream_header receive(int fd, float *message){
+   uint8_t buf[STREAM_UDP_DATAGRAM_BYTES];
+   ssize_t n = recv(fd, buf, sizeof(buf), 0);
+   assert(n > 0);
+   stream_header h;
+   const uint8_t *values;
+   assert(stream_decode(buf, (size_t)n, &h, &values));
+   memcpy(message + h.first_value, values, sizeof(float) * h.count);
+   return h;
+}
+
+/**
+ * Sends a PSD-sized message and a band power message over the loopback:
+ * the first is cut into full datagrams and a tail, all sent with one
+ * system call on Linux, and reassembles to the values sent.
+ *
+ * returns void
+*/
+void test_udp(void){
+   printf("[TEST] UDP sender batches and fragments ... \n");
+   stream_udp u;
+   assert(!stream_udp_open(&u, "127.0.0.1", 0));
+   int port;
+   int rx = udp_receiver(&port);
+   assert(stream_udp_open(&u, "127.0.0.1", port));
+
+   enum { VALUES = 8 * 129 };
+   static float psd[VALUES], got[VALUES];
+   for (int i = 0; i < VALUES; i++) psd[i] = (float)i * 0.5f;
+   float bands[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+   stream_udp_send(&u, STREAM_PSD, 8, psd, VALUES, 42);
+   stream_udp_send(&u, STREAM_BAND_POWER, 1, bands, 4, 43);
+   stream_udp_send(&u, STREAM_PSD, 8, psd, VALUES, 44);
+   int per_message = (VALUES + (int)STREAM_UDP_MAX_VALUES - 1) / (int)STREAM_UDP_MAX_VALUES;
+   assert(per_message > 1);
+   assert(u.queued == 2 * per_message + 1);
+   assert(stream_udp_flush(&u) == 2 * per_message + 1);
+#if defined(__linux__)
+   assert(u.send_calls == 1);
+#endif
+   assert(u.datagrams_sent == (uint64_t)(2 * per_message + 1) && u.datagrams_dropped == 0);
+
+   for (int message = 0; message < 3; message++){
+      memset(got, 0, sizeof(got));
+      int parts = message == 1 ? 1 : per_message;
+      uint32_t covered = 0;
+      for (int p = 0; p < parts; p++){
+         stream_header h = receive(rx, got);
+         assert(h.kind == (message == 1 ? STREAM_BAND_POWER : STREAM_PSD));
+         assert(h.seq == (message == 2 ? 1u : 0u));
+         assert(h.time_ns == 42u + (uint64_t)message);
+         assert(h.first_value == covered);
+         covered += h.count;
+      }
+      if (message == 1){
+         assert(covered == 4 && memcmp(got, bands, sizeof(bands)) == 0);
+      } else {
+         assert(covered == VALUES && memcmp(got, psd, sizeof(psd)) == 0);
+      }
+   }
+
+   // malformed datagrams
+   uint8_t buf[64];
+   stream_header h;
+   const uint8_t *values;
+   stream_udp_send(&u, STREAM_RAW, 1, bands, 2, 0);
+   size_t len = u.lengths[0];
+   memcpy(buf, u.buffers, len);
+   assert(stream_decode(buf, len, &h, &values) && h.count == 2);
+   assert(!stream_decode(buf, len - 1, &h, &values));
+   assert(!stream_decode(buf, sizeof(stream_header) - 1, &h, &values));
+   buf[0] ^= 1;
+   assert(!stream_decode(buf, len, &h, &values));
+   stream_udp_close(&u);
+   close(rx);
+   printf("OK\n");
+}
+
+/**
+ * One publish reaches both sinks of a set with the same header fields.
+ *
+ * returns void
+*/
+void test_sinks_publish(void){
+   printf("[TEST] Sink set publishes to shared memory and UDP ... \n");
+   stream_shm prod, cons;
+   stream_udp u;
+   int port;
+   int rx = udp_receiver(&port);
+   assert(stream_shm_create(&prod, SHM_NAME, 4, 16));
+   assert(stream_shm_open(&cons, SHM_NAME));
+   assert(stream_udp_open(&u, "localhost", port));
+   stream_sinks sinks = { &prod, &u };
+   float frame[6] = { 1, 2, 3, 4, 5, 6 };
+   stream_sinks_publish(&sinks, STREAM_RAW, 3, frame, 6, 7);
+   assert(stream_udp_flush(&u) == 1);
+
+   const float *values;
+   const stream_header *h = stream_shm_peek(&cons, &values);
+   assert(h && h->kind == STREAM_RAW && h->num_channels == 3 && h->time_ns == 7);
+   assert(memcmp(values, frame, sizeof(frame)) == 0);
+   float got[6];
+   stream_header d = receive(rx, got);
+   assert(d.kind == STREAM_RAW && d.seq == h->seq && d.num_values == 6);
+   assert(memcmp(got, frame, sizeof(frame)) == 0);
+
+   stream_sinks shm_only = { &prod, NULL };
+   stream_sinks_publish(&shm_only, STREAM_RAW, 3, frame, 6, 8);
+   assert(prod.published == 2 && u.queued == 0);
+   stream_udp_close(&u);
+   stream_shm_close(&cons);
+   stream_shm_close(&prod);
+   close(rx);
+   printf("OK\n");
+}
+
+int main(){
+   test_shm_ring();
+   test_shm_threads();
+   test_udp();
+   test_sinks_publish();
+   return 0;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file test_telemetry.c
+ * @brief Tests for the telemetry queues and summaries (telemetry.c).
+ *
+ * This file contains tests for:
+ * - Initialization and invalid arguments
+ * - Summary line: samples/s, min/max/mean and counters of one interval
+ * - int16 codes summarized in volts, also with a negative scale
+ * - Full queue: records are dropped and counted, never block
+ * - Log rate limiting per interval
+ * - A producer thread streaming records while the telemetry thread runs
+ *
+ * Output goes to a tmpfile() which is read back and checked.
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "telemetry.h"
+
+#define OUTPUT_SIZE 16384
+
+// reads everything written to f so far into buf
+static void read_output(FILE *f, char *buf, size_t size){
+   fflush(f);
+   rewind(f);
+   size_t n = fread(buf, 1, size - 1, f);
+   buf[n] = '\0';
+}
+
+static int count_lines(const char *buf, const char *needle){
+   int count = 0;
+   for (const char *p = strstr(buf, needle); p; p = strstr(p + 1, needle)) count++;
+   return count;
+}
+
+/**
+ * Tests init arguments and channel limits.
+ *
+ * returns void
+*/
+void test_telemetry_init(void){
+   printf("[TEST] Telemetry initialization ... \n");
+   telemetry t;
+   assert(telemetry_init(&t, NULL, 1000) == false);
+   assert(telemetry_init(&t, stderr, 0) == false);
+   assert(telemetry_init(&t, stderr, 1000) == true);
+   for (int i = 0; i < TELEMETRY_MAX_CHANNELS; i++){
+      assert(telemetry_channel_open(&t, "a_channel_name_longer_than_the_limit") != NULL);
+   }
+   assert(telemetry_channel_open(&t, "extra") == NULL);
+   assert(strlen(t.channels[0]->name) == TELEMETRY_NAME_LEN - 1);
+   // NULL channels are ignored by the producer calls
+   float v = 1.0f;
+   telemetry_samples(NULL, &v, 1);
+   telemetry_count(NULL, TELEMETRY_OVERFLOW, 1);
+   telemetry_log(NULL, "nothing %d", 1);
+   FILE *out = tmpfile();
+   assert(out);
+   t.out = out;
+   telemetry_stop(&t);
+   assert(t.num_channels == 0);
+   fclose(out);
+   printf("OK\n");
+}
+
+/**
+ * Tests the aggregated summary of one interval.
+ *
+ * returns void
+*/
+void test_telemetry_summary(void){
+   printf("[TEST] Telemetry summary line ... \n");
+   FILE *out = tmpfile();
+   assert(out);
+   telemetry t;
+   assert(telemetry_init(&t, out, 60000));
+   telemetry_channel *ch = telemetry_channel_open(&t, "serial");
+   assert(ch);
+
+   float a[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+   float b[4] = { 0.5f, 2.5f, 4.5f, 0.5f };
+   telemetry_samples(ch, a, 4);
+   telemetry_samples(ch, b, 4);
+   telemetry_count(ch, TELEMETRY_PACKETS_LOST, 3);
+   telemetry_count(ch, TELEMETRY_CRC_ERRORS, 1);
+   telemetry_count(ch, TELEMETRY_OVERFLOW, 7);
+   telemetry_count(ch, TELEMETRY_OVERFLOW, 0); // not queued
+   telemetry_count(ch, TELEMETRY_FRAMES_FILLED, 64);
+
+   // interval not over: nothing printed yet
+   telemetry_poll(&t, false);
+   char buf[OUTPUT_SIZE];
+   read_output(out, buf, sizeof(buf));
+   assert(buf[0] == '\0');
+
+   telemetry_poll(&t, true);
+   read_output(out, buf, sizeof(buf));
+   assert(strstr(buf, "[telemetry] serial: "));
+   assert(strstr(buf, "V min 0.50 max 4.50 mean 2.25"));
+   assert(strstr(buf, "packets lost 3, crc errors 1, overflow 7, dropped 0, filled 64"));
+
+   // the window restarts after a summary
+   telemetry_stop(&t);
+   read_output(out, buf, sizeof(buf));
+   assert(count_lines(buf, "[telemetry] serial: ") == 2);
+   assert(strstr(buf, "0.0 samples/s, V min 0.00 max 0.00 mean 0.00, packets lost 0"));
+   fclose(out);
+   printf("OK\n");
+}
+
+/**
+ * Tests that ADC codes are summarized as code * scale, and that a negative
+ * scale turns the largest code into the minimum.
+ *
+ * returns void
+*/
+void test_telemetry_codes(void){
+   printf("[TEST] Telemetry of int16 codes ... \n");
+   FILE *out = tmpfile();
+   assert(out);
+   telemetry t;
+   assert(telemetry_init(&t, out, 60000));
+   telemetry_channel *up = telemetry_channel_open(&t, "up");
+   telemetry_channel *down = telemetry_channel_open(&t, "down");
+   assert(up && down);
+
+   const int16_t codes[4] = { 100, 450, 50, 300 };
+   telemetry_codes(up, codes, 4, 0.01f);
+   telemetry_codes(down, codes, 4, -0.01f);
+   telemetry_codes(down, codes, 0, -0.01f); // not queued
+   telemetry_poll(&t, true);
+   char buf[OUTPUT_SIZE];
+   read_output(out, buf, sizeof(buf));
+   assert(strstr(buf, "[telemetry] up: "));
+   assert(strstr(buf, "V min 0.50 max 4.50 mean 2.25"));
+   assert(strstr(buf, "V min -4.50 max -0.50 mean -2.25"));
+   telemetry_stop(&t);
+   fclose(out);
+   printf("OK\n");
+}
+
+/**
+ * Tests that a full queue drops and counts records instead of blocking,
+ * and that the summary reports the drops of its own interval.
+ *
+ * returns void
+*/
+void test_telemetry_full_queue(void){
+   printf("[TEST] Telemetry full queue drops records ... \n");
+   FILE *out = tmpfile();
+   assert(out);
+   telemetry t;
+   assert(telemetry_init(&t, out, 60000));
+   telemetry_channel *ch = telemetry_channel_open(&t, "serial");
+   float v = 1.0f;
+   for (int i = 0; i < TELEMETRY_QUEUE_SIZE + 44; i++) telemetry_samples(ch, &v, 1);
+   assert(telemetry_dropped(ch) == 44);
+
+   telemetry_poll(&t, false);
+   assert(ch->window.samples == TELEMETRY_QUEUE_SIZE);
+   // room again after the drain
+   telemetry_samples(ch, &v, 1);
+   assert(telemetry_dropped(ch) == 44);
+   telemetry_poll(&t, true);
+   char buf[OUTPUT_SIZE];
+   read_output(out, buf, sizeof(buf));
+   char *first = strstr(buf, "dropped 44");
+   assert(first);
+   // the next summary reports only what was dropped since
+   telemetry_poll(&t, true);
+   read_output(out, buf, sizeof(buf));
+   first = strstr(buf, "dropped 44");
+   assert(first && strstr(first, "dropped 0,"));
+   telemetry_stop(&t);
+   fclose(out);
+   printf("OK\n");
+}
+
+/**
+ * Tests that at most TELEMETRY_MAX_LOGS_PER_INTERVAL messages are printed
+ * per interval and the rest are counted.
+ *
+ * returns void
+*/
+void test_telemetry_log_rate_limit(void){
+   printf("[TEST] Telemetry log rate limit ... \n");
+   FILE *out = tmpfile();
+   assert(out);
+   telemetry t;
+   assert(telemetry_init(&t, out, 60000));
+   telemetry_channel *ch = telemetry_channel_open(&t, "serial");
+   for (int i = 0; i < 25; i++) telemetry_log(ch, "event %d", i);
+   telemetry_poll(&t, true);
+
+   char buf[OUTPUT_SIZE];
+   read_output(out, buf, sizeof(buf));
+   assert(count_lines(buf, "[telemetry] serial: event ") == TELEMETRY_MAX_LOGS_PER_INTERVAL);
+   assert(strstr(buf, "serial: event 0\n"));
+   assert(strstr(buf, "serial: event 9\n"));
+   assert(!strstr(buf, "serial: event 10\n"));
+   assert(strstr(buf, "15 log messages suppressed"));
+
+   // a new interval allows new messages
+   telemetry_log(ch, "event %d", 99);
+   telemetry_stop(&t);
+   read_output(out, buf, sizeof(buf));
+   assert(strstr(buf, "serial: event 99\n"));
+   fclose(out);
+   printf("OK\n");
+}
+
+#define PRODUCER_BLOCKS 20000
+#define BLOCK_SIZE 32
+
+static void *block_producer(void *arg){
+   telemetry_channel *ch = (telemetry_channel *)arg;
+   float block[BLOCK_SIZE];
+   for (int i = 0; i < BLOCK_SIZE; i++) block[i] = (float)i;
+   for (int n = 0; n < PRODUCER_BLOCKS; n++) telemetry_samples(ch, block, BLOCK_SIZE);
+   return NULL;
+}
+
+/**
+ * A producer thread queues sample blocks while the telemetry thread drains
+ * them. The producer never blocks, what does not fit is dropped.
+ *
+ * returns void
+*/
+void test_telemetry_thread(void){
+   printf("[TEST] Telemetry thread with a producer thread ... \n");
+   FILE *out = tmpfile();
+   assert(out);
+   telemetry t;
+   assert(telemetry_init(&t, out, 20));
+   telemetry_channel *ch = telemetry_channel_open(&t, "producer");
+   assert(telemetry_start(&t));
+   assert(telemetry_start(&t) == false);
+
+   pthread_t producer;
+   assert(pthread_create(&producer, NULL, block_producer, ch) == 0);
+   assert(pthread_join(producer, NULL) == 0);
+   uint64_t dropped = telemetry_dropped(ch);
+   telemetry_stop(&t);
+
+   // every summary with samples shows the block's range
+   char *buf = malloc(1 << 20);
+   assert(buf);
+   read_output(out, buf, 1 << 20);
+   assert(count_lines(buf, "[telemetry] producer: ") >= 1);
+   assert(strstr(buf, "V min 0.00 max 31.00 mean 15.50"));
+   assert(dropped < PRODUCER_BLOCKS);
+   free(buf);
+   fclose(out);
+   printf("OK\n");
+}
+
+int main(){
+   test_telemetry_init();
+   test_telemetry_summary();
+   test_telemetry_codes();
+   test_telemetry_full_queue();
+   test_telemetry_log_rate_limit();
+   test_telemetry_thread();
+   return 0;
+}
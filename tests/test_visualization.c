@@ -0,0 +1,375 @@
+/**
+ * @file test_visualization.c
+ * @brief Tests for the visualization snapshots (visualization.c).
+ *
+ * This file contains tests for:
+ * - Ring deltas: nothing new, one range, a wrap, more than the capacity
+ * - Publish and acquire: sequence, history contents, latest PSD frame
+ * - A producer and a renderer thread: every acquired snapshot is complete
+ *   and newer than the last one, and a mirror updated with deltas only
+ *   (what the GPU objects get) always equals the snapshot
+ * - The min/max pyramid: every bucket against a brute-force min/max, the
+ *   open buckets, a one-sample spike at every level, level choice per zoom
+ * - The spectral stage publishing its samples and PSD frames
+ *
+ * Tests are grouped into functional blocks and individually run using assert() statements.
+ *
+ * Author: Catherine Bernaciak PhD
+ * Date: October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include "visualization.h"
+#include "pipeline.h"
+#include "pipeline_stages.h"
+#include "mc_ring_buffer.h"
+#include "test_helpers.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define NCH 2
+#define BINS 5
+#define WAVE_FRAMES 100   // capacity 256
+#define PSD_ROWS 10       // capacity 32
+#define THREAD_FRAMES 200000
+
+// exact in a float: frame index below 2^20, channel above
+static float wave_value(uint64_t frame, int ch){
+   return (float)((frame & 0xFFFFF) + ((uint64_t)ch << 20));
+}
+
+static void push_frames(viz_state *v, uint64_t first, int n){
+   float a[512], b[512];
+   float *planar[NCH] = { a, b };
+   assert(n <= 512);
+   for(int i = 0; i < n; i++){
+      a[i] = wave_value(first + i, 0);
+      b[i] = wave_value(first + i, 1);
+   }
+   viz_push_wave(v, planar, n);
+}
+
+static void push_psd_row(viz_state *v, uint64_t row){
+   float psd[NCH * BINS];
+   for(int i = 0; i < NCH * BINS; i++) psd[i] = (float)(row * 100 + i);
+   viz_push_psd(v, psd);
+}
+
+// every position of the snapshot's rings that was pushed holds its value
+static void check_snapshot(const viz_state *v, const viz_snapshot *s){
+   uint64_t lo = s->wave_end > (uint64_t)v->wave_capacity ? s->wave_end - v->wave_capacity : 0;
+   for(uint64_t f = lo; f < s->wave_end; f++){
+      for(int ch = 0; ch < NCH; ch++){
+         assert(s->wave[ch * v->wave_capacity + (f & (v->wave_capacity - 1))] == wave_value(f, ch));
+      }
+   }
+}
+
+/**
+ * Tests the ranges of positions not seen yet.
+ *
+ * returns void
+*/
+void test_viz_ring_delta(void){
+   printf("[TEST] Visualization ring deltas ... \n");
+   viz_range r[2];
+   assert(viz_ring_delta(10, 10, 16, r) == 0);
+   assert(viz_ring_delta(12, 10, 16, r) == 0);
+   assert(viz_ring_delta(3, 10, 16, r) == 1);
+   assert(r[0].first == 3 && r[0].count == 7 && r[0].start == 3);
+   // 14, 15 then 0..3
+   assert(viz_ring_delta(30, 36, 16, r) == 2);
+   assert(r[0].first == 14 && r[0].count == 2 && r[0].start == 30);
+   assert(r[1].first == 0 && r[1].count == 4 && r[1].start == 32);
+   // only the last capacity positions are still there
+   assert(viz_ring_delta(0, 100, 16, r) == 2);
+   assert(r[0].first == 4 && r[0].count == 12 && r[0].start == 84);
+   assert(r[1].first == 0 && r[1].count == 4 && r[1].start == 96);
+   assert(viz_ring_delta(0, 32, 16, r) == 1);
+   assert(r[0].first == 0 && r[0].count == 16 && r[0].start == 16);
+   printf("OK\n");
+}
+
+/**
+ * Tests publishing and acquiring on one thread.
+ *
+ * returns void
+*/
+void test_viz_publish(void){
+   printf("[TEST] Visualization publish and acquire ... \n");
+   viz_state v;
+   assert(viz_state_init(&v, NCH, BINS, 1, PSD_ROWS, 0, 250.0f, 1.0f) == false);
+   assert(viz_state_init(&v, 0, BINS, WAVE_FRAMES, PSD_ROWS, 0, 250.0f, 1.0f) == false);
+   assert(viz_state_init(&v, NCH, BINS, WAVE_FRAMES, PSD_ROWS, 0, 250.0f, 1.0f));
+   assert(v.wave_capacity == 256 && v.psd_capacity == 32);
+
+   const viz_snapshot *s = viz_acquire(&v);
+   assert(s->sequence == 0 && s->wave_end == 0);
+   assert(viz_latest_psd(&v, s, 0) == NULL);
+
+   push_frames(&v, 0, 300); // wraps the ring
+   push_psd_row(&v, 0);
+   push_psd_row(&v, 1);
+   assert(viz_acquire(&v)->sequence == 0); // nothing published yet
+   viz_publish(&v);
+   s = viz_acquire(&v);
+   assert(s->sequence == 1 && s->wave_end == 300 && s->psd_end == 2);
+   check_snapshot(&v, s);
+   const float *latest = viz_latest_psd(&v, s, 1);
+   assert(latest && latest[0] == 100.0f + BINS && latest[BINS - 1] == 100.0f + 2 * BINS - 1);
+   assert(viz_acquire(&v) == s); // same snapshot until the next publish
+
+   // the renderer only sees the newest of several publishes
+   for(int i = 0; i < 3; i++){
+      push_frames(&v, 300 + 50 * i, 50);
+      viz_publish(&v);
+   }
+   s = viz_acquire(&v);
+   assert(s->sequence == 4 && s->wave_end == 450);
+   check_snapshot(&v, s);
+   // a snapshot last filled two publishes ago is brought up to date
+   for(int i = 0; i < 4; i++){
+      push_frames(&v, 450 + 10 * i, 10);
+      push_psd_row(&v, 2 + i);
+      viz_publish(&v);
+      s = viz_acquire(&v);
+      assert(s->sequence == (uint64_t)(5 + i) && s->psd_end == (uint64_t)(3 + i));
+      check_snapshot(&v, s);
+      assert(viz_latest_psd(&v, s, 0)[0] == (float)((2 + i) * 100));
+   }
+   viz_state_destroy(&v);
+   printf("OK\n");
+}
+
+typedef struct {
+   viz_state *v;
+   atomic_bool done;
+} producer_args;
+
+static void *producer(void *arg){
+   producer_args *p = (producer_args *)arg;
+   uint64_t frame = 0;
+   unsigned int seed = 7;
+   struct timespec pause = { 0, 20000L }; // about a DSP step, lets the renderer interleave
+   while(frame < THREAD_FRAMES){
+      int n = 1 + (int)(rand_r(&seed) % 400);
+      push_frames(p->v, frame, n);
+      frame += (uint64_t)n;
+      if(n > 200) push_psd_row(p->v, p->v->psd_end);
+      viz_publish(p->v);
+      nanosleep(&pause, NULL);
+   }
+   atomic_store(&p->done, true);
+   return NULL;
+}
+
+/**
+ * Tests a producer thread against a renderer thread that keeps a mirror of
+ * the rings updated with deltas only.
+ *
+ * returns void
+*/
+void test_viz_threads(void){
+   printf("[TEST] Visualization producer and renderer threads ... \n");
+   viz_state v;
+   assert(viz_state_init(&v, NCH, BINS, WAVE_FRAMES, PSD_ROWS, 4096, 250.0f, 1.0f));
+   float *mirror = calloc((size_t)NCH * v.wave_capacity, sizeof(float));
+   assert(mirror);
+   producer_args args = { &v, false };
+   pthread_t thread;
+   assert(pthread_create(&thread, NULL, producer, &args) == 0);
+
+   uint64_t last_sequence = 0, seen = 0, frames = 0;
+   int acquired = 0;
+   while(1){
+      bool finished = atomic_load(&args.done);
+      const viz_snapshot *s = viz_acquire(&v);
+      assert(s->sequence >= last_sequence && s->wave_end >= frames);
+      if(s->sequence > last_sequence) acquired++;
+      last_sequence = s->sequence;
+      frames = s->wave_end;
+      check_snapshot(&v, s);
+
+      viz_range r[2];
+      int n = viz_ring_delta(seen, s->wave_end, v.wave_capacity, r);
+      for(int ch = 0; ch < NCH; ch++){
+         for(int i = 0; i < n; i++){
+            size_t at = (size_t)ch * v.wave_capacity + r[i].first;
+            memcpy(mirror + at, s->wave + at, sizeof(float) * r[i].count);
+         }
+      }
+      seen = s->wave_end;
+      uint64_t lo = seen > (uint64_t)v.wave_capacity ? seen - v.wave_capacity : 0;
+      for(uint64_t f = lo; f < seen; f++){
+         for(int ch = 0; ch < NCH; ch++){
+            assert(mirror[ch * v.wave_capacity + (f & (v.wave_capacity - 1))] == wave_value(f, ch));
+         }
+      }
+      if(finished) break;
+   }
+   assert(pthread_join(thread, NULL) == 0);
+   assert(frames >= THREAD_FRAMES); // the last acquire came after the last publish
+   assert(acquired > 1);
+   free(mirror);
+   viz_state_destroy(&v);
+   printf("OK\n");
+}
+
+static float lod_sample(uint64_t frame, int ch){
+   float x = sinf((float)frame * 0.01f) + 0.001f * (float)(frame % 7);
+   if(frame == 5003) x = 100.0f;
+   return ch == 0 ? x : -x;
+}
+
+/**
+ * Tests the min/max pyramid against brute force, and the level choice.
+ *
+ * returns void
+*/
+void test_viz_lod(void){
+   printf("[TEST] Visualization min/max pyramid ... \n");
+   viz_state v;
+   assert(viz_state_init(&v, NCH, BINS, WAVE_FRAMES, PSD_ROWS, -1, 250.0f, 1.0f) == false);
+   assert(viz_state_init(&v, NCH, BINS, WAVE_FRAMES, PSD_ROWS, 10000, 250.0f, 1.0f));
+   // 4, 16, 64 frames per bucket: 157 buckets of 64 hold the history
+   assert(v.lod_levels == 3);
+   assert(v.lod_capacity[0] == 8192 && v.lod_capacity[1] == 2048 && v.lod_capacity[2] == 512);
+
+   const uint64_t total = 9999;
+   float a[512], b[512];
+   float *planar[NCH] = { a, b };
+   unsigned int seed = 3;
+   for(uint64_t frame = 0; frame < total; ){
+      int n = 1 + (int)(rand_r(&seed) % 300);
+      if(frame + (uint64_t)n > total) n = (int)(total - frame);
+      for(int i = 0; i < n; i++){
+         a[i] = lod_sample(frame + i, 0);
+         b[i] = lod_sample(frame + i, 1);
+      }
+      viz_push_wave(&v, planar, n);
+      frame += (uint64_t)n;
+      if(rand_r(&seed) % 3 == 0) viz_publish(&v);
+   }
+   viz_publish(&v);
+   const viz_snapshot *s = viz_acquire(&v);
+   assert(s->wave_end == total);
+
+   uint64_t size = VIZ_LOD_FACTOR;
+   for(int l = 0; l < v.lod_levels; l++, size *= VIZ_LOD_FACTOR){
+      assert(s->lod_end[l] == total / size);
+      int cap = v.lod_capacity[l];
+      for(uint64_t bk = 0; bk <= s->lod_end[l]; bk++){ // the open one too
+         for(int ch = 0; ch < NCH; ch++){
+            float lo = INFINITY, hi = -INFINITY;
+            for(uint64_t f = bk * size; f < (bk + 1) * size && f < total; f++){
+               lo = fminf(lo, lod_sample(f, ch));
+               hi = fmaxf(hi, lod_sample(f, ch));
+            }
+            const float *pair = s->lod[l] + ((size_t)ch * cap + (bk & (uint64_t)(cap - 1))) * 2;
+            assert(pair[0] == lo && pair[1] == hi);
+         }
+      }
+      // the spike survives every level
+      const float *spike = s->lod[l] + (size_t)(5003 / size) * 2;
+      assert(spike[1] == 100.0f);
+   }
+
+   // raw samples while they fit and there are fewer than 4 per pixel
+   assert(viz_lod_level(&v, 50, 100) == -1);
+   assert(viz_lod_level(&v, 400, 1000) == 0);
+   assert(viz_lod_level(&v, 10000, 1000) == 0);
+   assert(viz_lod_level(&v, 10000, 100) == 2);
+   // whatever the span, between pixels and 4 * pixels buckets are drawn
+   for(uint64_t span = 2000; span <= 10000; span += 500){
+      int level = viz_lod_level(&v, span, 100);
+      viz_lod_span w;
+      assert(viz_lod_window(&v, s, level, span, &w));
+      assert(w.count >= 100 && w.count <= 4 * 100 + 2);
+      assert(w.first + (uint64_t)w.count == s->lod_end[level] + 1); // ends with the open bucket
+      assert(w.first * (uint64_t)w.bucket_frames <= total - span);
+   }
+   viz_lod_span w;
+   assert(viz_lod_window(&v, s, 3, 1000, &w) == false);
+   viz_state_destroy(&v);
+   printf("OK\n");
+}
+
+/**
+ * Tests that the spectral stage publishes the samples it analyzed and the
+ * PSD frames it wrote.
+ *
+ * returns void
+*/
+void test_viz_spectral_stage(void){
+   printf("[TEST] Visualization from the spectral stage ... \n");
+   const int fft = 64, hop = 16, bins = fft / 2 + 1;
+   pipeline *p = malloc(sizeof(pipeline));
+   assert(p);
+   pipeline_init(p);
+   pipeline_stage_config cfg = { "spectral", PIPELINE_QOS_DEFAULT, 0, spectral_stage_step, NULL, NULL };
+   pipeline_stage *stage = pipeline_add_stage(p, &cfg);
+   mc_ring_buffer *in = malloc(sizeof(mc_ring_buffer));
+   mc_ring_buffer *out = malloc(sizeof(mc_ring_buffer));
+   assert(in && out);
+   assert(mc_ring_buffer_init(in, NCH, 1024));
+   assert(mc_ring_buffer_init(out, NCH * bins, 16));
+   spectral_stage spectral;
+   assert(spectral_stage_init(&spectral, in, out, fft, hop, DSP_WINDOW_HANN, 1, 256.0f));
+   viz_state v, wrong;
+   assert(viz_state_init(&v, NCH, bins, 128, 8, 0, 256.0f, 4.0f));
+   assert(viz_state_init(&wrong, NCH, BINS, 128, 8, 0, 256.0f, 4.0f));
+   assert(spectral_stage_set_viz(&spectral, &wrong) == false);
+   assert(spectral_stage_set_viz(&spectral, &v));
+
+   // 64 + 4 hops: 5 PSD frames
+   int total = fft + 4 * hop;
+   float frames[(64 + 4 * 16) * NCH];
+   for(int i = 0; i < total; i++){
+      frames[i * NCH] = sinf(2.0f * (float)M_PI * 32.0f * i / 256.0f);
+      frames[i * NCH + 1] = 0.5f;
+   }
+   assert(mc_ring_buffer_write_frames(in, frames, total) == total);
+   while(spectral_stage_step(stage, &spectral) > 0){
+   }
+   const viz_snapshot *s = viz_acquire(&v);
+   assert(s->wave_end == (uint64_t)total && s->psd_end == 5);
+   for(int i = 0; i < total; i++){
+      assert(s->wave[i] == frames[i * NCH]);
+      assert(s->wave[v.wave_capacity + i] == 0.5f);
+   }
+   float psd[NCH * 33];
+   for(int i = 0; i < 5; i++) assert(mc_ring_buffer_read_frames(out, psd, 1) == 1);
+   for(int ch = 0; ch < NCH; ch++){
+      assert(memcmp(viz_latest_psd(&v, s, ch), psd + ch * bins, sizeof(float) * bins) == 0);
+   }
+   // 32 Hz at 4 Hz per bin
+   const float *ch0 = viz_latest_psd(&v, s, 0);
+   int peak = 1;
+   for(int k = 2; k < bins; k++) if(ch0[k] > ch0[peak]) peak = k;
+   assert(peak == 8);
+
+   spectral_stage_destroy(&spectral);
+   viz_state_destroy(&v);
+   viz_state_destroy(&wrong);
+   MC_SAFE_DESTROY(in);
+   MC_SAFE_DESTROY(out);
+   free(p);
+   printf("OK\n");
+}
+
+int main(){
+   test_viz_ring_delta();
+   test_viz_publish();
+   test_viz_threads();
+   test_viz_lod();
+   test_viz_spectral_stage();
+   return 0;
+}
@@ -8,6 +8,11 @@
  * - Read/write operations
  * - Empty and full state detection
  * - Basic wrap-around behavior
+ * - Bulk read/write split around the wrap point
+ * - In-place reserve/commit and peek/release spans
+ * - Mirrored storage: page-rounded capacity and single-span windows
+ * - Power-of-two capacity with masked index wrapping
+ * - Overflow policies (reject, overwrite oldest) and drop counters
  * - allocated memory is freed
  *
  * Tests are grouped into functional blocks and individually run using assert() statements.
@@ -25,6 +30,7 @@
 #include <assert.h>
 #include <math.h>
 #include "ring_buffer.h"
+#include "vm_mirror.h"
 #include "test_helpers.h"
 
 //#define EPSILON 0.00001f
@@ -164,6 +170,236 @@ void test_wraparound(ring_buffer *rb){
    printf("OK\n");
 }
 
+void test_bulk_rw(void){
+   printf("[TEST] bulk read/write ... \n");
+   ring_buffer *rb = malloc(sizeof(ring_buffer));
+   assert(ring_buffer_init(rb, 5) == true);
+
+   float in[7] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+   float out[7];
+
+   // only 5 of 7 values fit
+   assert(ring_buffer_write_n(rb, in, 7) == 5);
+   assert(rb->tail == 0);
+   assert(rb->curr_num_values == 5);
+   assert(ring_buffer_write_n(rb, in, 1) == 0);
+
+   // read 3, head moves to 3
+   assert(ring_buffer_read_n(rb, out, 3) == 3);
+   ASSERT_FLOAT_EQ(out[0], 1.0f);
+   ASSERT_FLOAT_EQ(out[2], 3.0f);
+   assert(rb->head == 3);
+
+   // write 3 more, lands in slots 0..2 
+   assert(ring_buffer_write_n(rb, in + 4, 3) == 3);
+   assert(rb->tail == 3);
+   assert(ring_buffer_full(rb) == true);
+
+   // read across the wrap point: slots 3,4 then 0,1,2
+   assert(ring_buffer_read_n(rb, out, 7) == 5);
+   ASSERT_FLOAT_EQ(out[0], 4.0f);
+   ASSERT_FLOAT_EQ(out[1], 5.0f);
+   ASSERT_FLOAT_EQ(out[2], 5.0f);
+   ASSERT_FLOAT_EQ(out[3], 6.0f);
+   ASSERT_FLOAT_EQ(out[4], 7.0f);
+   assert(rb->head == 3);
+   assert(ring_buffer_empty(rb) == true);
+   assert(ring_buffer_read_n(rb, out, 1) == 0);
+
+   // bulk and scalar paths share state
+   assert(ring_buffer_write(rb, 8.0f) == true);
+   assert(ring_buffer_write_n(rb, in, 2) == 2);
+   float value;
+   assert(ring_buffer_read(rb, &value));
+   ASSERT_FLOAT_EQ(value, 8.0f);
+   assert(ring_buffer_read_n(rb, out, 2) == 2);
+   ASSERT_FLOAT_EQ(out[1], 2.0f);
+
+   SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+void test_spans(void){
+   printf("[TEST] reserve/commit and peek/release spans ... \n");
+   ring_buffer *rb = malloc(sizeof(ring_buffer));
+   assert(ring_buffer_init(rb, 5) == true);
+   ring_buffer_span spans[2];
+
+   // reserve 3 in an empty buffer, one contiguous span
+   assert(ring_buffer_reserve(rb, 3, spans) == 3);
+   assert(spans[0].ptr == rb->buffer);
+   assert(spans[0].len == 3);
+   assert(spans[1].len == 0);
+   for (int i = 0; i < 3; i++) spans[0].ptr[i] = (float)(i + 1);
+   // nothing is visible before commit
+   assert(ring_buffer_empty(rb) == true);
+   assert(ring_buffer_commit(rb, 3) == true);
+   assert(rb->tail == 3);
+   assert(rb->curr_num_values == 3);
+
+   // peek 2, release them
+   assert(ring_buffer_peek(rb, 2, spans) == 2);
+   ASSERT_FLOAT_EQ(spans[0].ptr[0], 1.0f);
+   ASSERT_FLOAT_EQ(spans[0].ptr[1], 2.0f);
+   assert(rb->curr_num_values == 3);
+   assert(ring_buffer_release(rb, 2) == true);
+   assert(rb->head == 2);
+
+   // reserve 4 wraps: slots 3,4 then 0,1
+   assert(ring_buffer_reserve(rb, 10, spans) == 4);
+   assert(spans[0].ptr == rb->buffer + 3);
+   assert(spans[0].len == 2);
+   assert(spans[1].ptr == rb->buffer);
+   assert(spans[1].len == 2);
+   spans[0].ptr[0] = 4.0f; spans[0].ptr[1] = 5.0f;
+   spans[1].ptr[0] = 6.0f; spans[1].ptr[1] = 7.0f;
+   assert(ring_buffer_commit(rb, 5) == false); // more than reserved space
+   assert(ring_buffer_commit(rb, 4) == true);
+   assert(ring_buffer_full(rb) == true);
+
+   // peek everything across the wrap point
+   assert(ring_buffer_peek(rb, 10, spans) == 5);
+   assert(spans[0].len == 3);
+   assert(spans[1].len == 2);
+   ASSERT_FLOAT_EQ(spans[0].ptr[0], 3.0f);
+   ASSERT_FLOAT_EQ(spans[0].ptr[2], 5.0f);
+   ASSERT_FLOAT_EQ(spans[1].ptr[1], 7.0f);
+   assert(ring_buffer_release(rb, 6) == false);
+   assert(ring_buffer_release(rb, 5) == true);
+   assert(ring_buffer_empty(rb) == true);
+   assert(rb->head == rb->tail);
+   assert(ring_buffer_peek(rb, 1, spans) == 0);
+
+   SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+void test_mirrored(void){
+   printf("[TEST] mirrored storage ... \n");
+   ring_buffer *rb = malloc(sizeof(ring_buffer));
+   assert(ring_buffer_init_mirrored(rb, 0) == false);
+   assert(ring_buffer_init_mirrored(rb, 100) == true);
+
+   // capacity is rounded up to a whole page
+   int cap = rb->max_num_values;
+   assert(cap >= 100);
+   assert((cap * sizeof(float)) % vm_mirror_page_size() == 0);
+   assert(rb->mirror_bytes == cap * sizeof(float));
+
+   // both halves alias the same memory
+   rb->buffer[3] = 1.25f;
+   ASSERT_FLOAT_EQ(rb->buffer[cap + 3], 1.25f);
+   rb->buffer[cap + 7] = 2.5f;
+   ASSERT_FLOAT_EQ(rb->buffer[7], 2.5f);
+
+   // move head/tail close to the end, then reserve across the wrap point
+   ring_buffer_span spans[2];
+   assert(ring_buffer_reserve(rb, cap - 2, spans) == cap - 2);
+   assert(ring_buffer_commit(rb, cap - 2));
+   assert(ring_buffer_release(rb, cap - 2));
+   assert(ring_buffer_reserve(rb, 5, spans) == 5);
+   assert(spans[0].len == 5);
+   assert(spans[1].len == 0);
+   for (int i = 0; i < 5; i++) spans[0].ptr[i] = (float)i;
+   assert(ring_buffer_commit(rb, 5));
+   assert(rb->tail == 3);
+
+   // the wrapped window is one span, and also readable through the normal path
+   assert(ring_buffer_peek(rb, 5, spans) == 5);
+   assert(spans[0].ptr == rb->buffer + cap - 2);
+   assert(spans[0].len == 5);
+   ASSERT_FLOAT_EQ(spans[0].ptr[4], 4.0f);
+   float out[5];
+   assert(ring_buffer_read_n(rb, out, 5) == 5);
+   ASSERT_FLOAT_EQ(out[2], 2.0f);
+   ASSERT_FLOAT_EQ(rb->buffer[0], 2.0f);
+
+   SAFE_DESTROY(rb); // unmaps instead of free
+   printf("OK\n");
+}
+
+void test_pow2(void){
+   printf("[TEST] power-of-two capacity ... \n");
+   ring_buffer *rb = malloc(sizeof(ring_buffer));
+   assert(ring_buffer_init_pow2(rb, 0) == false);
+   assert(ring_buffer_init_pow2(rb, 6) == false);
+   assert(ring_buffer_init_pow2(rb, 4) == true);
+   assert(rb->pow2 == true);
+   assert(rb->index_mask == 3);
+
+   // same index behavior as the modulo path, over several wraps
+   float value;
+   for (int i = 0; i < 10; i++){
+      assert(ring_buffer_write(rb, (float)i));
+      assert(rb->tail == (i + 1) % 4);
+      assert(ring_buffer_read(rb, &value));
+      ASSERT_FLOAT_EQ(value, (float)i);
+      assert(rb->head == (i + 1) % 4);
+   }
+   for (int i = 0; i < 4; i++) assert(ring_buffer_write(rb, (float)i));
+   assert(ring_buffer_full(rb) == true);
+   assert(ring_buffer_write(rb, 9.0f) == false);
+   assert(rb->head == rb->tail);
+
+   SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
+void test_overflow_policy(void){
+   printf("[TEST] overflow policies and drop counters ... \n");
+   ring_buffer *rb = malloc(sizeof(ring_buffer));
+   assert(ring_buffer_init(rb, 4) == true);
+   assert(rb->overflow_policy == RB_OVERFLOW_REJECT);
+   assert(ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_BLOCK) == false);
+
+   // reject: newest values are lost and counted
+   float in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+   float out[10];
+   assert(ring_buffer_write_n(rb, in, 4) == 4);
+   assert(ring_buffer_write(rb, 4.0f) == false);
+   assert(ring_buffer_write_n(rb, in, 3) == 0);
+   assert(rb->num_rejected == 4);
+   assert(rb->num_overwritten == 0);
+
+   // overwrite: the oldest values make room, head moves with the tail
+   assert(ring_buffer_set_overflow_policy(rb, RB_OVERFLOW_OVERWRITE) == true);
+   assert(ring_buffer_write(rb, 4.0f) == true);
+   assert(rb->num_overwritten == 1);
+   assert(rb->head == 1);
+   assert(rb->tail == 1);
+   assert(ring_buffer_full(rb) == true);
+   assert(ring_buffer_write_n(rb, in + 5, 2) == 2);
+   assert(rb->num_overwritten == 3);
+   assert(ring_buffer_read_n(rb, out, 4) == 4);
+   ASSERT_FLOAT_EQ(out[0], 3.0f);
+   ASSERT_FLOAT_EQ(out[1], 4.0f);
+   ASSERT_FLOAT_EQ(out[2], 5.0f);
+   ASSERT_FLOAT_EQ(out[3], 6.0f);
+
+   // a block bigger than the buffer keeps only its last values
+   assert(ring_buffer_write(rb, 99.0f) == true);
+   assert(ring_buffer_write_n(rb, in, 10) == 4);
+   assert(rb->num_overwritten == 3 + 1 + 6);
+   assert(ring_buffer_read_n(rb, out, 10) == 4);
+   ASSERT_FLOAT_EQ(out[0], 6.0f);
+   ASSERT_FLOAT_EQ(out[3], 9.0f);
+
+   // reserve drops the oldest values as well
+   ring_buffer_span spans[2];
+   assert(ring_buffer_write_n(rb, in, 3) == 3);
+   assert(ring_buffer_reserve(rb, 2, spans) == 2);
+   assert(rb->num_overwritten == 11);
+   assert(rb->curr_num_values == 2);
+   assert(rb->num_rejected == 4);
+   // abandoned without a commit: value 0 stays dropped
+   assert(ring_buffer_read_n(rb, out, 10) == 2);
+   ASSERT_FLOAT_EQ(out[0], 1.0f);
+   ASSERT_FLOAT_EQ(out[1], 2.0f);
+
+   SAFE_DESTROY(rb);
+   printf("OK\n");
+}
+
 void test_destroy(ring_buffer *rb){
    printf("[TEST] memory leak indirectly ... \n");
    SAFE_DESTROY(rb);          // buffer is gone from heap 
@@ -188,4 +424,9 @@ int main() {
    test_destroy(rb);          // buffer is gone from heap and
                               // calling ring_buffer_destory more
                               // than once won't cause problem
+   test_bulk_rw();            // allocates its own buffer
+   test_spans();              // allocates its own buffer
+   test_mirrored();           // allocates its own buffer
+   test_pow2();               // allocates its own buffer
+   test_overflow_policy();    // allocates its own buffer
 }